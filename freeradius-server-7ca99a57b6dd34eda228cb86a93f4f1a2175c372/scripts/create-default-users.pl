@@ -0,0 +1,63 @@
+#!/usr/bin/perl
+
+# Purpose:  create a "users" file with lots of DEFAULT entries
+# keyed on the NAS and the Called-Station-Id, along with
+# requests which match them.  Used to benchmark loading
+# and matching in rlm_files.
+#
+# Load the file with "radiusd -X" to see how long it takes to
+# read and index, and then send the requests with
+#
+#	radclient -f radius.defaults.test -p 100 localhost auth testing123
+
+$defaults = "./radius.defaults";
+$radfile = "./radius.defaults.test";
+
+if($ARGV[0] eq "") {
+	print "\n\tUsage:  $0  <number of DEFAULT entries> [<number of requests>]\n\n";
+	exit(1);
+} else {
+	$numdefaults = $ARGV[0];
+	$numrequests = $ARGV[1] ne "" ? $ARGV[1] : 1000;
+}
+
+open(USERS, ">$defaults") || die "Can't open $defaults";
+open(RAD, ">$radfile") || die "Can't open $radfile";
+
+sub nas_ip {
+	my $num = shift;
+
+	return sprintf("10.%d.%d.%d", ($num >> 16) & 0xff, ($num >> 8) & 0xff, $num & 0xff);
+}
+
+sub called_station_id {
+	my $num = shift;
+
+	return sprintf("00-00-5e-%02x-%02x-%02x", ($num >> 16) & 0xff, ($num >> 8) & 0xff, $num & 0xff);
+}
+
+#
+#  Two thirds of the entries match on the NAS, the rest
+#  on the Called-Station-Id.
+#
+for ($num=0; $num<$numdefaults; $num++) {
+	if ($num % 3) {
+		printf USERS "DEFAULT\tNAS-IP-Address == %s\n", nas_ip($num);
+	} else {
+		printf USERS "DEFAULT\tCalled-Station-Id == \"%s\"\n", called_station_id($num);
+	}
+	printf USERS "\tClass := \"0x%08x\",\n\tFall-Through = yes\n\n", $num;
+}
+
+print USERS "DEFAULT\n\tReply-Message := \"no match\"\n";
+
+for ($num=0; $num<$numrequests; $num++) {
+	$entry = int(rand($numdefaults));
+
+	printf RAD "User-Name = \"user%d\", User-Password = \"password\", NAS-IP-Address = %s, Called-Station-Id = \"%s\"\n\n",
+		$num, nas_ip($entry | 1), called_station_id($entry - ($entry % 3));
+}
+
+close(USERS);
+close(RAD);
+print "\nCreated $numdefaults DEFAULT entries and $numrequests requests\n\n";
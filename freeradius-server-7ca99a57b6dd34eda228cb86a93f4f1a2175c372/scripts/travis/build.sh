@@ -69,7 +69,8 @@ for i in \
     imap-setup.sh \
     mysql-setup.sh \
     ldap-setup.sh \
-    redis-setup.sh; do
+    redis-setup.sh \
+    rest-setup.sh; do
     script="./scripts/travis/$i"
 
     echo "Calling $i"
@@ -0,0 +1,15 @@
+#!/bin/sh -e
+
+#
+#  Start the stand-in HTTP server used by the rlm_rest tests
+#
+PORT="${REST_TEST_SERVER_PORT:-8080}"
+PIDFILE='/tmp/rest-server.pid'
+
+if [ -e "${PIDFILE}" ] && kill -0 "$(cat ${PIDFILE})" 2>/dev/null; then
+    echo "REST test server already running"
+    exit 0
+fi
+
+python3 ./scripts/travis/rest/server.py "${PORT}" &
+echo $! > "${PIDFILE}"
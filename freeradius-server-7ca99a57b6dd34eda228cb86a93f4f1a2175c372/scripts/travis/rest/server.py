@@ -0,0 +1,66 @@
+#!/usr/bin/env python3
+#
+#  Stand-in HTTP server for the rlm_rest module tests.
+#
+#  /delay	- Waits for a short time, then returns 204.
+#  /concurrency	- Returns the peak number of /delay requests which were
+#		  in flight at the same time, then resets the counter.
+#
+import sys
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+DELAY = 0.5
+
+lock = threading.Lock()
+active = 0
+peak = 0
+
+
+class Handler(BaseHTTPRequestHandler):
+	protocol_version = 'HTTP/1.1'
+
+	def reply(self, code, body=b''):
+		self.send_response(code)
+		self.send_header('Content-Type', 'text/plain')
+		self.send_header('Content-Length', str(len(body)))
+		self.end_headers()
+		self.wfile.write(body)
+
+	def delay(self):
+		global active, peak
+
+		with lock:
+			active += 1
+			peak = max(peak, active)
+		time.sleep(DELAY)
+		with lock:
+			active -= 1
+		self.reply(204)
+
+	def concurrency(self):
+		global peak
+
+		with lock:
+			body = str(peak).encode()
+			peak = 0
+		self.reply(200, body)
+
+	def do_GET(self):
+		if self.path.startswith('/delay'):
+			self.delay()
+		elif self.path.startswith('/concurrency'):
+			self.concurrency()
+		else:
+			self.reply(404)
+
+	do_POST = do_GET
+
+	def log_message(self, format, *args):
+		pass
+
+
+if __name__ == '__main__':
+	port = int(sys.argv[1]) if len(sys.argv) > 1 else 8080
+	ThreadingHTTPServer(('127.0.0.1', port), Handler).serve_forever()
@@ -3,6 +3,7 @@ SUBMAKEFILES := \
     radict.mk \
     radiusd.mk \
     radsniff.mk \
+    radspool.mk \
     radwho.mk \
     radsnmp.mk \
     radlast.mk \
@@ -46,7 +46,7 @@ typedef struct REQUEST REQUEST;	/* to shut up warnings about mschap.h */
 
 #include "radclient.h"
 
-#define pair_update_request(_attr, _da) fr_pair_update_by_da(request->packet, _attr, &request->packet->vps, _da)
+#define pair_update_request(_attr, _da) fr_pair_list_update_by_da(request->packet, _attr, &request->packet->vps, _da)
 
 static int retries = 3;
 static fr_time_delta_t timeout = ((fr_time_delta_t) 5) * NSEC;
@@ -190,7 +190,7 @@ static int _rc_request_free(rc_request_t *request)
 	return 0;
 }
 
-static int mschapv1_encode(RADIUS_PACKET *packet, VALUE_PAIR **request,
+static int mschapv1_encode(RADIUS_PACKET *packet, fr_pair_list_t *request,
 			   char const *password)
 {
 	unsigned int		i;
@@ -198,12 +198,12 @@ static int mschapv1_encode(RADIUS_PACKET *packet, VALUE_PAIR **request,
 	VALUE_PAIR		*challenge, *reply;
 	uint8_t			nthash[16];
 
-	fr_pair_delete_by_da(&packet->vps, attr_ms_chap_challenge);
-	fr_pair_delete_by_da(&packet->vps, attr_ms_chap_response);
+	fr_pair_list_delete_by_da(&packet->vps, attr_ms_chap_challenge);
+	fr_pair_list_delete_by_da(&packet->vps, attr_ms_chap_response);
 
 	MEM(challenge = fr_pair_afrom_da(packet, attr_ms_chap_challenge));
 
-	fr_pair_add(request, challenge);
+	fr_pair_list_append(request, challenge);
 	challenge->vp_length = 8;
 	challenge->vp_octets = p = talloc_array(challenge, uint8_t, challenge->vp_length);
 	for (i = 0; i < challenge->vp_length; i++) {
@@ -211,7 +211,7 @@ static int mschapv1_encode(RADIUS_PACKET *packet, VALUE_PAIR **request,
 	}
 
 	MEM(reply = fr_pair_afrom_da(packet, attr_ms_chap_response));
-	fr_pair_add(request, reply);
+	fr_pair_list_append(request, reply);
 	reply->vp_length = 50;
 	reply->vp_octets = p = talloc_array(reply, uint8_t, reply->vp_length);
 	memset(p, 0, reply->vp_length);
@@ -359,6 +359,8 @@ static int radclient_init(TALLOC_CTX *ctx, rc_file_pair_t *files)
 	 *	Loop until the file is done.
 	 */
 	do {
+		VALUE_PAIR *vps = NULL;
+
 		/*
 		 *	Allocate it.
 		 */
@@ -388,7 +390,7 @@ static int radclient_init(TALLOC_CTX *ctx, rc_file_pair_t *files)
 		 *	Read the request VP's.
 		 */
 		if (fr_pair_list_afrom_file(request->packet, dict_radius,
-					    &request->packet->vps, packets, &packets_done) < 0) {
+					    &vps, packets, &packets_done) < 0) {
 			char const *input;
 
 			if ((files->packets[0] == '-') && (files->packets[1] == '\0')) {
@@ -400,11 +402,12 @@ static int radclient_init(TALLOC_CTX *ctx, rc_file_pair_t *files)
 			REDEBUG("Error parsing \"%s\"", input);
 			goto error;
 		}
+		fr_pair_list_append(&request->packet->vps, vps);
 
 		/*
 		 *	Skip empty entries
 		 */
-		if (!request->packet->vps) {
+		if (!fr_pair_list_head(&request->packet->vps)) {
 			WARN("Skipping \"%s\": No Attributes", files->packets);
 			talloc_free(request);
 			continue;
@@ -472,7 +475,7 @@ static int radclient_init(TALLOC_CTX *ctx, rc_file_pair_t *files)
 		/*
 		 *	Process special attributes
 		 */
-		for (vp = fr_cursor_init(&cursor, &request->packet->vps);
+		for (vp = fr_pair_list_cursor_init(&cursor, &request->packet->vps);
 		     vp;
 		     vp = fr_cursor_next(&cursor)) {
 			/*
@@ -834,11 +837,11 @@ static int send_one_packet(rc_request_t *request)
 		if (request->password) {
 			VALUE_PAIR *vp;
 
-			if ((vp = fr_pair_find_by_da(request->packet->vps, attr_user_password, TAG_ANY)) != NULL) {
+			if ((vp = fr_pair_list_find_by_da(&request->packet->vps, attr_user_password, TAG_ANY)) != NULL) {
 				fr_pair_value_strdup(vp, request->password->vp_strvalue);
 
-			} else if ((vp = fr_pair_find_by_da(request->packet->vps,
-							    attr_chap_password, TAG_ANY)) != NULL) {
+			} else if ((vp = fr_pair_list_find_by_da(&request->packet->vps,
+								 attr_chap_password, TAG_ANY)) != NULL) {
 				uint8_t buffer[17];
 
 				fr_radius_encode_chap_password(buffer, request->packet,
@@ -847,7 +850,7 @@ static int send_one_packet(rc_request_t *request)
 							       request->password->vp_length);
 				fr_pair_value_memdup(vp, buffer, sizeof(buffer), false);
 
-			} else if (fr_pair_find_by_da(request->packet->vps, attr_ms_chap_password, TAG_ANY) != NULL) {
+			} else if (fr_pair_list_find_by_da(&request->packet->vps, attr_ms_chap_password, TAG_ANY) != NULL) {
 				mschapv1_encode(request->packet, &request->packet->vps, request->password->vp_strvalue);
 
 			} else {
@@ -1074,9 +1077,12 @@ static int recv_one_packet(fr_time_t wait_time)
 		stats.passed++;
 	} else {
 		VALUE_PAIR const *failed[2];
+		VALUE_PAIR *sorted;
 
-		fr_pair_list_sort(&request->reply->vps, fr_pair_cmp_by_da_tag);
-		if (fr_pair_validate(failed, request->filter, request->reply->vps)) {
+		sorted = fr_pair_list_detach(&request->reply->vps);
+		fr_pair_list_sort(&sorted, fr_pair_cmp_by_da_tag);
+		fr_pair_list_append(&request->reply->vps, sorted);
+		if (fr_pair_validate(failed, request->filter, fr_pair_list_head(&request->reply->vps))) {
 			RDEBUG("%s: Response passed filter", request->name);
 			stats.passed++;
 		} else {
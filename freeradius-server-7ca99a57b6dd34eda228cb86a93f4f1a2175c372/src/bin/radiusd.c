@@ -777,8 +777,11 @@ int main(int argc, char *argv[])
 		schedule->max_workers = config->max_workers;
 		schedule->max_networks = config->max_networks;
 		schedule->stats_interval = config->stats_interval;
+		schedule->cpu_affinity = config->cpu_affinity;
 
 		schedule->network.max_outstanding = config->max_requests;
+		schedule->network.dispatch = config->network_dispatch;
+		schedule->network.max_spill = config->network_max_spill;
 		schedule->worker.max_requests = config->max_requests;
 		schedule->worker.max_request_time = config->max_request_time;
 
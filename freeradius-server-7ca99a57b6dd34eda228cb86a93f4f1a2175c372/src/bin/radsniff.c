@@ -360,7 +360,7 @@ static void rs_packet_print_csv(uint64_t count, rs_status_t status, fr_pcap_t *h
 		VALUE_PAIR *vp;
 
 		for (i = 0; i < conf->list_da_num; i++) {
-			vp = fr_pair_find_by_da(packet->vps, conf->list_da[i], TAG_ANY);
+			vp = fr_pair_list_find_by_da(&packet->vps, conf->list_da[i], TAG_ANY);
 			if (vp && (vp->vp_length > 0)) {
 				if (conf->list_da[i]->type == FR_TYPE_STRING) {
 					*p++ = '"';
@@ -482,9 +482,13 @@ static void rs_packet_print_fancy(uint64_t count, rs_status_t status, fr_pcap_t
 		if (conf->print_packet && (fr_debug_lvl >= L_DBG_LVL_2)) {
 			char vector[(RADIUS_AUTH_VECTOR_LENGTH * 2) + 1];
 
-			if (packet->vps) {
-				fr_pair_list_sort(&packet->vps, fr_pair_cmp_by_da_tag);
-				fr_pair_list_log(&default_log, packet->vps);
+			if (fr_pair_list_head(&packet->vps)) {
+				VALUE_PAIR *sorted;
+
+				sorted = fr_pair_list_detach(&packet->vps);
+				fr_pair_list_sort(&sorted, fr_pair_cmp_by_da_tag);
+				fr_pair_list_append(&packet->vps, sorted);
+				fr_pair_list_log(&default_log, fr_pair_list_head(&packet->vps));
 			}
 
 			fr_bin2hex(&FR_SBUFF_OUT(vector, sizeof(vector)),
@@ -1445,8 +1449,12 @@ static void rs_packet_process(uint64_t count, rs_event_t *event, struct pcap_pkt
 			 *	Now verify the packet passes the attribute filter
 			 */
 			if (conf->filter_response_vps) {
-				fr_pair_list_sort(&packet->vps, fr_pair_cmp_by_da_tag);
-				if (!fr_pair_validate_relaxed(NULL, conf->filter_response_vps, packet->vps)) {
+				VALUE_PAIR *sorted;
+
+				sorted = fr_pair_list_detach(&packet->vps);
+				fr_pair_list_sort(&sorted, fr_pair_cmp_by_da_tag);
+				fr_pair_list_append(&packet->vps, sorted);
+				if (!fr_pair_validate_relaxed(NULL, conf->filter_response_vps, fr_pair_list_head(&packet->vps))) {
 					goto drop_response;
 				}
 			}
@@ -1557,6 +1565,7 @@ static void rs_packet_process(uint64_t count, rs_event_t *event, struct pcap_pkt
 		 */
 		if (conf->decode_attrs) {
 			int ret;
+			VALUE_PAIR *sorted;
 			FILE *log_fp = fr_log_fp;
 
 			fr_log_fp = NULL;
@@ -1570,7 +1579,9 @@ static void rs_packet_process(uint64_t count, rs_event_t *event, struct pcap_pkt
 				return;
 			}
 
-			fr_pair_list_sort(&packet->vps, fr_pair_cmp_by_da_tag);
+			sorted = fr_pair_list_detach(&packet->vps);
+			fr_pair_list_sort(&sorted, fr_pair_cmp_by_da_tag);
+			fr_pair_list_append(&packet->vps, sorted);
 		}
 
 		/*
@@ -1585,9 +1596,9 @@ static void rs_packet_process(uint64_t count, rs_event_t *event, struct pcap_pkt
 		}
 		search.expect->code = packet->code;
 
-		if ((conf->link_da_num > 0) && packet->vps) {
+		if ((conf->link_da_num > 0) && fr_pair_list_head(&packet->vps)) {
 			int ret;
-			ret = rs_get_pairs(packet, &search.link_vps, packet->vps, conf->link_da,
+			ret = rs_get_pairs(packet, &search.link_vps, fr_pair_list_head(&packet->vps), conf->link_da,
 					   conf->link_da_num);
 			if (ret < 0) {
 				ERROR("Failed extracting RTX linking pairs from request");
@@ -1642,7 +1653,7 @@ static void rs_packet_process(uint64_t count, rs_event_t *event, struct pcap_pkt
 		 *	Now verify the packet passes the attribute filter
 		 */
 		if (conf->filter_request_vps) {
-			if (!fr_pair_validate_relaxed(NULL, conf->filter_request_vps, packet->vps)) {
+			if (!fr_pair_validate_relaxed(NULL, conf->filter_request_vps, fr_pair_list_head(&packet->vps))) {
 				goto drop_request;
 			}
 		}
@@ -654,7 +654,7 @@ static int radsnmp_send_recv(radsnmp_conf_t *conf, int fd)
 			ERROR("Failed allocating request");
 			return EXIT_FAILURE;
 		}
-		fr_cursor_init(&cursor, &packet->vps);
+		fr_pair_list_cursor_init(&cursor, &packet->vps);
 
 		NEXT_LINE(line, buffer);
 
@@ -845,7 +845,7 @@ static int radsnmp_send_recv(radsnmp_conf_t *conf, int fd)
 			case RADSNMP_GET:
 			case RADSNMP_GETNEXT:
 				ret = radsnmp_get_response(STDOUT_FILENO, conf->snmp_oid_root,
-							   attr_freeradius_snmp_type, reply->vps);
+							   attr_freeradius_snmp_type, fr_pair_list_head(&reply->vps));
 				switch (ret) {
 				case -1:
 					fr_perror("Failed converting pairs to varbind response");
@@ -862,7 +862,7 @@ static int radsnmp_send_recv(radsnmp_conf_t *conf, int fd)
 				break;
 
 			case RADSNMP_SET:
-				if (radsnmp_set_response(STDOUT_FILENO, attr_freeradius_snmp_failure, reply->vps) < 0) {
+				if (radsnmp_set_response(STDOUT_FILENO, attr_freeradius_snmp_failure, fr_pair_list_head(&reply->vps)) < 0) {
 					fr_perror("Failed writing SET response");
 					return EXIT_FAILURE;
 				}
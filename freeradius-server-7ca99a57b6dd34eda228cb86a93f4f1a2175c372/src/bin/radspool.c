@@ -0,0 +1,495 @@
+/*
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/**
+ * $Id$
+ *
+ * @file radspool.c
+ * @brief Convert between text detail files and binary spool files.
+ *
+ * @copyright 2020 The FreeRADIUS server project
+ */
+RCSID("$Id$")
+
+#include <freeradius-devel/util/base.h>
+#include <freeradius-devel/util/conf.h>
+#include <freeradius-devel/internal/spool.h>
+#include <freeradius-devel/autoconf.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifdef HAVE_GETOPT_H
+#  include <getopt.h>
+#endif
+
+DIAG_OFF(unused-macros)
+#define DEBUG2(fmt, ...)	if (fr_log_fp && (fr_debug_lvl > 2)) fprintf(fr_log_fp , fmt "\n", ## __VA_ARGS__)
+#define DEBUG(fmt, ...)		if (fr_log_fp && (fr_debug_lvl > 1)) fprintf(fr_log_fp , fmt "\n", ## __VA_ARGS__)
+#define INFO(fmt, ...)		if (fr_log_fp && (fr_debug_lvl > 0)) fprintf(fr_log_fp , fmt "\n", ## __VA_ARGS__)
+DIAG_ON(unused-macros)
+
+typedef struct {
+	uint64_t	records;	//!< Entries converted.
+	uint64_t	done;		//!< Entries skipped because they were already processed.
+	uint64_t	bad;		//!< Entries or bytes skipped because they were damaged.
+} radspool_stats_t;
+
+static fr_dict_t *dict_internal;
+static fr_dict_t *dict_protocol;
+static fr_dict_attr_t const *attr_packet_type;
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: radspool [OPTS] <input> <output>\n");
+	fprintf(stderr, "  -D <dictdir>     Set main dictionary directory (defaults to " DICTDIR ").\n");
+	fprintf(stderr, "  -i <format>      Format of the input file, 'detail' (default) or 'spool'.\n");
+	fprintf(stderr, "                   The output file is written in the other format.\n");
+	fprintf(stderr, "  -p <protocol>    Protocol dictionary for detail files (defaults to radius).\n");
+	fprintf(stderr, "  -x               Debugging mode.\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "Convert between text detail files and binary spool files.\n");
+	fprintf(stderr, "Entries which have already been processed are not converted.\n");
+}
+
+/** Write one spool record for a detail file entry
+ *
+ */
+static int spool_write(FILE *out, fr_spool_record_t const *record, VALUE_PAIR **head)
+{
+	uint8_t		*buffer;
+	size_t		buffer_len = 1024;
+	ssize_t		slen;
+
+	for (;;) {
+		fr_cursor_t cursor;
+
+		buffer = talloc_array(NULL, uint8_t, buffer_len);
+		if (!buffer) return -1;
+
+		fr_cursor_init(&cursor, head);
+		slen = fr_spool_record_encode(buffer, buffer_len, record, &cursor, NULL, NULL);
+		if (slen > 0) break;
+
+		talloc_free(buffer);
+		if ((slen < 0) || (buffer_len > FR_SPOOL_MAX_LEN)) return -1;
+		buffer_len *= 2;
+	}
+
+	if (fwrite(buffer, slen, 1, out) != 1) {
+		fr_strerror_printf("Failed writing: %s", fr_syserror(errno));
+		talloc_free(buffer);
+		return -1;
+	}
+
+	talloc_free(buffer);
+	return 0;
+}
+
+/** Convert a text detail file to a binary spool file
+ *
+ */
+static int detail_to_spool(FILE *in, FILE *out, radspool_stats_t *stats)
+{
+	char		*line = NULL;
+	size_t		line_len = 0;
+	ssize_t		len;
+	int		lineno = 0;
+	int		ret = 0;
+	bool		in_entry = false, done = false;
+	VALUE_PAIR	*head = NULL;
+	fr_spool_record_t record = { .dict = dict_protocol };
+
+	for (;;) {
+		char	*p;
+
+		len = getline(&line, &line_len, in);
+		if (len >= 0) lineno++;
+
+		/*
+		 *	A blank line, or EOF, ends the entry.
+		 */
+		if ((len < 0) || (len <= 1) || (line[0] == '\n')) {
+			if (in_entry) {
+				if (done) {
+					stats->done++;
+
+				} else if (spool_write(out, &record, &head) < 0) {
+					fr_perror("radspool: Failed converting entry ending at line %d", lineno);
+					ret = -1;
+					break;
+
+				} else {
+					stats->records++;
+				}
+
+				fr_pair_list_free(&head);
+				in_entry = done = false;
+			}
+
+			if (len < 0) break;
+			continue;
+		}
+
+		if (line[len - 1] == '\n') line[len - 1] = '\0';
+
+		/*
+		 *	The header line starts a new entry.
+		 */
+		if (!in_entry) {
+			if (line[0] == '\t') {
+				fprintf(stderr, "radspool: Malformed header at line %d\n", lineno);
+				ret = -1;
+				break;
+			}
+
+			in_entry = true;
+			record.code = 0;
+			record.timestamp = 0;
+			record.flags = 0;
+			continue;
+		}
+
+		if (line[0] != '\t') {
+			fprintf(stderr, "radspool: Malformed line %d\n", lineno);
+			ret = -1;
+			break;
+		}
+		p = line + 1;
+
+		/*
+		 *	Skip this for backwards compatability.
+		 */
+		if (strncasecmp(p, "Request-Authenticator", 21) == 0) continue;
+
+		if (strncasecmp(p, "Timestamp = ", 12) == 0) {
+			record.timestamp = fr_unix_time_from_sec(strtoull(p + 12, NULL, 10));
+			continue;
+		}
+
+		/*
+		 *	The entry was already processed by a detail
+		 *	file reader.
+		 */
+		if ((strncmp(p, "Done", 4) == 0) || (strncasecmp(p, "Donestamp", 9) == 0)) {
+			done = true;
+			continue;
+		}
+
+		{
+			VALUE_PAIR *vp = NULL;
+
+			if ((fr_pair_list_afrom_str(NULL, dict_protocol, p, &vp) == T_INVALID) || !vp) {
+				fr_perror("radspool: Ignoring line %d", lineno);
+				stats->bad++;
+				continue;
+			}
+
+			if (attr_packet_type && (vp->da == attr_packet_type)) {
+				record.code = vp->vp_uint32;
+				fr_pair_list_free(&vp);
+				continue;
+			}
+
+			fr_pair_add(&head, vp);
+		}
+	}
+
+	fr_pair_list_free(&head);
+	free(line);
+
+	if (ferror(in)) {
+		fprintf(stderr, "radspool: Failed reading input: %s\n", fr_syserror(errno));
+		return -1;
+	}
+
+	return ret;
+}
+
+/** Write one text detail file entry for a spool record
+ *
+ */
+static int detail_write(FILE *out, fr_spool_record_t const *record, VALUE_PAIR *head)
+{
+	char		header[64];
+	time_t		when = fr_unix_time_to_sec(record->timestamp);
+	struct tm	tm;
+	fr_cursor_t	cursor;
+	VALUE_PAIR	*vp;
+
+	if (!localtime_r(&when, &tm) || !strftime(header, sizeof(header), "%a %b %e %H:%M:%S %Y", &tm)) {
+		strlcpy(header, "Thu Jan  1 00:00:00 1970", sizeof(header));
+	}
+	fprintf(out, "%s\n", header);
+
+	if (record->code) {
+		fr_dict_attr_t const	*da = fr_dict_attr_by_name(record->dict, "Packet-Type");
+		char const		*name = NULL;
+
+		if (da) name = fr_dict_enum_name_by_value(da, fr_box_uint32(record->code));
+		if (name) {
+			fprintf(out, "\tPacket-Type = %s\n", name);
+		} else {
+			fprintf(out, "\tPacket-Type = %u\n", record->code);
+		}
+	}
+
+	for (vp = fr_cursor_init(&cursor, &head);
+	     vp;
+	     vp = fr_cursor_next(&cursor)) {
+		fr_token_t op = vp->op;
+
+		vp->op = T_OP_EQ;
+		fr_pair_fprint(out, vp);
+		vp->op = op;
+	}
+
+	fprintf(out, "\tTimestamp = %" PRIu64 "\n\n", fr_unix_time_to_sec(record->timestamp));
+
+	if (ferror(out)) {
+		fr_strerror_printf("Failed writing: %s", fr_syserror(errno));
+		return -1;
+	}
+
+	return 0;
+}
+
+/** Convert a binary spool file to a text detail file
+ *
+ */
+static int spool_to_detail(int fd, FILE *out, radspool_stats_t *stats)
+{
+	struct stat	buf;
+	uint8_t const	*map, *p, *end;
+
+	if (fstat(fd, &buf) < 0) {
+		fprintf(stderr, "radspool: Failed examining input: %s\n", fr_syserror(errno));
+		return -1;
+	}
+
+	if (buf.st_size == 0) return 0;
+
+	map = mmap(NULL, buf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED) {
+		fprintf(stderr, "radspool: Failed mapping input: %s\n", fr_syserror(errno));
+		return -1;
+	}
+	(void) madvise(UNCONST(uint8_t *, map), buf.st_size, MADV_SEQUENTIAL);
+
+	p = map;
+	end = map + buf.st_size;
+	while (p < end) {
+		fr_spool_record_t	record;
+		VALUE_PAIR		*head = NULL;
+		fr_cursor_t		cursor;
+		ssize_t			slen;
+
+		slen = fr_spool_record_length(p, end - p);
+		if (slen == 0) {
+			fprintf(stderr, "radspool: Ignoring truncated record at offset %zu\n", (size_t) (p - map));
+			stats->bad++;
+			break;
+		}
+
+		if (slen < 0) {
+			ssize_t skip = fr_spool_record_sync(p, end - p);
+
+			fr_perror("radspool: Skipping %zd bytes of damaged data at offset %zu", skip, (size_t) (p - map));
+			stats->bad++;
+			p += skip;
+			continue;
+		}
+
+		if (p[FR_SPOOL_FLAGS_OFFSET] & FR_SPOOL_FLAG_DONE) {
+			stats->done++;
+			p += slen;
+			continue;
+		}
+
+		fr_cursor_init(&cursor, &head);
+		if (fr_spool_record_decode(NULL, &cursor, &record, p, slen) < 0) {
+			fr_perror("radspool: Skipping record at offset %zu", (size_t) (p - map));
+			stats->bad++;
+			p += slen;
+			continue;
+		}
+
+		if (detail_write(out, &record, head) < 0) {
+			fr_perror("radspool");
+			fr_pair_list_free(&head);
+			munmap(UNCONST(uint8_t *, map), buf.st_size);
+			return -1;
+		}
+		fr_pair_list_free(&head);
+
+		stats->records++;
+		p += slen;
+	}
+
+	munmap(UNCONST(uint8_t *, map), buf.st_size);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	char const		*dict_dir = DICTDIR;
+	char const		*protocol = "radius";
+	char const		*format = "detail";
+	char			c;
+	int			ret = EXIT_SUCCESS;
+	bool			spool_in;
+	FILE			*in = NULL, *out = NULL;
+	radspool_stats_t	stats = { 0 };
+
+	TALLOC_CTX		*autofree;
+
+	/*
+	 *	Must be called first, so the handler is called last
+	 */
+	fr_thread_local_atexit_setup();
+
+	autofree = talloc_autofree_context();
+
+#ifndef NDEBUG
+	if (fr_fault_setup(autofree, getenv("PANIC_ACTION"), argv[0]) < 0) {
+		fr_perror("radspool");
+		fr_exit(EXIT_FAILURE);
+	}
+#endif
+
+	talloc_set_log_stderr();
+
+	fr_debug_lvl = 1;
+
+	while ((c = getopt(argc, argv, "D:i:p:xh")) != -1) switch (c) {
+		case 'D':
+			dict_dir = optarg;
+			break;
+
+		case 'i':
+			format = optarg;
+			break;
+
+		case 'p':
+			protocol = optarg;
+			break;
+
+		case 'x':
+			fr_log_fp = stdout;
+			fr_debug_lvl++;
+			break;
+
+		case 'h':
+		default:
+			usage();
+			goto finish;
+	}
+	argc -= optind;
+	argv += optind;
+
+	if (argc != 2) {
+		usage();
+		ret = EXIT_FAILURE;
+		goto finish;
+	}
+
+	if (strcmp(format, "detail") == 0) {
+		spool_in = false;
+	} else if (strcmp(format, "spool") == 0) {
+		spool_in = true;
+	} else {
+		fprintf(stderr, "radspool: Unknown format '%s'\n", format);
+		ret = EXIT_FAILURE;
+		goto finish;
+	}
+
+	/*
+	 *	Mismatch between the binary and the libraries it depends on
+	 */
+	if (fr_check_lib_magic(RADIUSD_MAGIC_NUMBER) < 0) {
+		fr_perror("radspool");
+		ret = EXIT_FAILURE;
+		goto finish;
+	}
+
+	if (!fr_dict_global_ctx_init(autofree, dict_dir)) {
+		fr_perror("radspool");
+		ret = EXIT_FAILURE;
+		goto finish;
+	}
+
+	if (fr_dict_internal_afrom_file(&dict_internal, FR_DICTIONARY_INTERNAL_DIR) < 0) {
+		fr_perror("radspool");
+		ret = EXIT_FAILURE;
+		goto finish;
+	}
+
+	INFO("Loading dictionary: %s/%s", dict_dir, protocol);
+
+	if (fr_dict_protocol_afrom_file(&dict_protocol, protocol, NULL) < 0) {
+		fr_perror("radspool");
+		ret = EXIT_FAILURE;
+		goto finish;
+	}
+	attr_packet_type = fr_dict_attr_by_name(dict_protocol, "Packet-Type");
+
+	in = fopen(argv[0], "r");
+	if (!in) {
+		fprintf(stderr, "radspool: Failed opening %s: %s\n", argv[0], fr_syserror(errno));
+		ret = EXIT_FAILURE;
+		goto finish;
+	}
+
+	out = fopen(argv[1], spool_in ? "w" : "wb");
+	if (!out) {
+		fprintf(stderr, "radspool: Failed opening %s: %s\n", argv[1], fr_syserror(errno));
+		ret = EXIT_FAILURE;
+		goto finish;
+	}
+
+	if (spool_in) {
+		if (spool_to_detail(fileno(in), out, &stats) < 0) ret = EXIT_FAILURE;
+	} else {
+		if (detail_to_spool(in, out, &stats) < 0) ret = EXIT_FAILURE;
+	}
+
+	if (fclose(out) != 0) {
+		fprintf(stderr, "radspool: Failed writing %s: %s\n", argv[1], fr_syserror(errno));
+		ret = EXIT_FAILURE;
+	}
+	out = NULL;
+
+	INFO("Converted %" PRIu64 " entries, skipped %" PRIu64 " done, %" PRIu64 " damaged",
+	     stats.records, stats.done, stats.bad);
+
+finish:
+	if (in) fclose(in);
+	if (out) fclose(out);
+
+	/*
+	 *	Release our references on all the dictionaries
+	 */
+	fr_dict_free(&dict_protocol);
+	fr_dict_free(&dict_internal);
+
+	/*
+	 *	Free any autoload dictionaries
+	 */
+	talloc_free(autofree);
+
+	return ret;
+}
@@ -0,0 +1,5 @@
+TARGET		:= radspool
+SOURCES		:= radspool.c
+
+TGT_PREREQS	:= libfreeradius-util.a libfreeradius-internal.a
+TGT_LDLIBS	:= $(LIBS)
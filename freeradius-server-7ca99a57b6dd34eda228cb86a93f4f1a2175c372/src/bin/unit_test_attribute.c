@@ -1442,6 +1442,79 @@ static size_t command_decode_proto(command_result_t *result, command_file_ctx_t
 	RETURN_OK(p - data);
 }
 
+/** Measure how long a protocol decoder takes to decode a packet
+ *
+ * Writes "ok" to the data buffer, and the time per packet to the log.
+ */
+static size_t command_decode_proto_bench(command_result_t *result, command_file_ctx_t *cc,
+					 char *data, size_t data_used, char *in, size_t inlen)
+{
+	fr_test_point_proto_decode_t	*tp = NULL;
+	void		*decoder_ctx = NULL;
+	char		*p, *q;
+	uint8_t		*to_dec;
+	size_t		to_dec_len;
+	VALUE_PAIR	*head = NULL;
+	unsigned long	iterations, i;
+	fr_time_t	start, stop;
+	ssize_t		slen;
+
+	p = in;
+
+	slen = load_test_point_by_command((void **)&tp, in, "tp_decode_proto");
+	if (!tp) {
+		fr_strerror_printf_push("Failed locating decoder testpoint");
+		RETURN_COMMAND_ERROR();
+	}
+
+	p += slen;
+	fr_skip_whitespace(p);
+
+	iterations = strtoul(p, &q, 10);
+	if ((q == p) || (iterations == 0)) {
+		fr_strerror_printf("Missing iteration count");
+		RETURN_PARSE_ERROR(p - in);
+	}
+	p = q;
+	fr_skip_whitespace(p);
+	inlen -= (p - in);
+
+	if (tp->test_ctx && (tp->test_ctx(&decoder_ctx, cc->tmp_ctx) < 0)) {
+		fr_strerror_printf_push("Failed initialising decoder testpoint");
+		RETURN_COMMAND_ERROR();
+	}
+
+	if (*p == '-') {
+		p = data;
+		inlen = data_used;
+	}
+
+	slen = hex_to_bin((uint8_t *)data, COMMAND_OUTPUT_MAX, p, inlen);
+	if (slen <= 0) {
+		CLEAR_TEST_POINT(cc);
+		RETURN_PARSE_ERROR(-(slen));
+	}
+
+	to_dec = (uint8_t *)data;
+	to_dec_len = slen;
+
+	start = fr_time();
+	for (i = 0; i < iterations; i++) {
+		slen = tp->func(cc->tmp_ctx, &head, to_dec, to_dec_len, decoder_ctx);
+		fr_pair_list_free(&head);
+		if (slen <= 0) {
+			CLEAR_TEST_POINT(cc);
+			RETURN_OK_WITH_ERROR();
+		}
+	}
+	stop = fr_time();
+
+	INFO("%zu byte packet, %.0f ns/packet", to_dec_len, (double)(stop - start) / iterations);
+
+	CLEAR_TEST_POINT(cc);
+	RETURN_OK(strlcpy(data, "ok", COMMAND_OUTPUT_MAX));
+}
+
 /** Parse a dictionary attribute, writing "ok" to the data buffer is everything was ok
  *
  */
@@ -1453,6 +1526,79 @@ static size_t command_dictionary_attribute_parse(command_result_t *result, comma
 	RETURN_OK(strlcpy(data, "ok", COMMAND_OUTPUT_MAX));
 }
 
+static void dictionary_bench_names(char const ***names, fr_dict_attr_t const *parent)
+{
+	fr_dict_attr_t const *da;
+
+	if (parent->type == FR_TYPE_GROUP) return;
+
+	for (da = NULL; (da = fr_dict_attr_iterate_children(parent, &da)); ) {
+		size_t len = talloc_array_length(*names);
+
+		MEM(*names = talloc_realloc(NULL, *names, char const *, len + 1));
+		(*names)[len] = da->name;
+
+		dictionary_bench_names(names, da);
+	}
+}
+
+static double dictionary_bench_run(fr_dict_t const *dict, char const **names, unsigned long iterations)
+{
+	fr_time_t	start;
+	size_t		i, num = talloc_array_length(names);
+	unsigned long	j;
+
+	start = fr_time();
+	for (j = 0; j < iterations; j++) {
+		for (i = 0; i < num; i++) {
+			fr_dict_attr_err_t	err;
+			fr_dict_attr_t const	*da;
+			fr_sbuff_t		name = FR_SBUFF_IN(names[i], strlen(names[i]));
+
+			fr_dict_attr_by_name_substr(&err, &da, dict, &name);
+			if (da) (void) fr_dict_attr_child_by_num(da->parent, da->attr);
+		}
+	}
+
+	return ((double) num * iterations * NSEC) / (double) (fr_time() - start);
+}
+
+/** Measure attribute lookups by name, before and after the dictionary is indexed
+ *
+ * Writes "ok" to the data buffer, and the lookup rates to the log.
+ */
+static size_t command_dictionary_bench(command_result_t *result, command_file_ctx_t *cc,
+				       char *data, UNUSED size_t data_used, char *in, UNUSED size_t inlen)
+{
+	fr_dict_t		*dict = cc->active_dict ? cc->active_dict : cc->config->dict;
+	char const		**names = NULL;
+	unsigned long		iterations;
+	char			*q;
+	double			before, after;
+
+	iterations = strtoul(in, &q, 10);
+	if ((q == in) || (iterations == 0)) iterations = 100;
+
+	dictionary_bench_names(&names, fr_dict_root(dict));
+	if (!names) {
+		fr_strerror_printf("Dictionary has no attributes");
+		RETURN_COMMAND_ERROR();
+	}
+
+	before = dictionary_bench_run(dict, names, iterations);
+	if (fr_dict_index_build(dict) < 0) {
+		talloc_free(names);
+		RETURN_COMMAND_ERROR();
+	}
+	after = dictionary_bench_run(dict, names, iterations);
+
+	INFO("%s: %zu attributes, %.0f lookups/s unindexed, %.0f lookups/s indexed",
+	     fr_dict_root(dict)->name, talloc_array_length(names), before, after);
+	talloc_free(names);
+
+	RETURN_OK(strlcpy(data, "ok", COMMAND_OUTPUT_MAX));
+}
+
 /** Print the currently loaded dictionary
  *
  */
@@ -1780,6 +1926,71 @@ static size_t command_encode_proto(command_result_t *result, command_file_ctx_t
 	RETURN_OK(hex_print(data, COMMAND_OUTPUT_MAX, cc->buffer_start, slen));
 }
 
+/** Measure how long a protocol encoder takes to encode a packet
+ *
+ * Writes "ok" to the data buffer, and the time per packet to the log.
+ */
+static size_t command_encode_proto_bench(command_result_t *result, command_file_ctx_t *cc,
+					 char *data, UNUSED size_t data_used, char *in, UNUSED size_t inlen)
+{
+	fr_test_point_proto_encode_t	*tp = NULL;
+
+	void		*encoder_ctx = NULL;
+	ssize_t		slen;
+	char		*p = in, *q;
+	unsigned long	iterations, i;
+	fr_time_t	start, stop;
+
+	VALUE_PAIR	*head = NULL;
+
+	slen = load_test_point_by_command((void **)&tp, p, "tp_encode_proto");
+	if (!tp) {
+		fr_strerror_printf_push("Failed locating encode testpoint");
+		CLEAR_TEST_POINT(cc);
+		RETURN_COMMAND_ERROR();
+	}
+
+	p += ((size_t)slen);
+	fr_skip_whitespace(p);
+
+	iterations = strtoul(p, &q, 10);
+	if ((q == p) || (iterations == 0)) {
+		fr_strerror_printf("Missing iteration count");
+		CLEAR_TEST_POINT(cc);
+		RETURN_PARSE_ERROR(p - in);
+	}
+	p = q;
+	fr_skip_whitespace(p);
+
+	if (tp->test_ctx && (tp->test_ctx(&encoder_ctx, cc->tmp_ctx) < 0)) {
+		fr_strerror_printf_push("Failed initialising encoder testpoint");
+		CLEAR_TEST_POINT(cc);
+		RETURN_COMMAND_ERROR();
+	}
+
+	if (fr_pair_list_afrom_str(cc->tmp_ctx, cc->active_dict ? cc->active_dict : cc->config->dict, p, &head) != T_EOL) {
+		CLEAR_TEST_POINT(cc);
+		RETURN_OK_WITH_ERROR();
+	}
+
+	start = fr_time();
+	for (i = 0; i < iterations; i++) {
+		slen = tp->func(cc->tmp_ctx, head, cc->buffer_start, cc->buffer_end - cc->buffer_start, encoder_ctx);
+		if (slen < 0) {
+			fr_pair_list_free(&head);
+			CLEAR_TEST_POINT(cc);
+			RETURN_OK_WITH_ERROR();
+		}
+	}
+	stop = fr_time();
+	fr_pair_list_free(&head);
+
+	INFO("%zd byte packet, %.0f ns/packet", slen, (double)(stop - start) / iterations);
+
+	CLEAR_TEST_POINT(cc);
+	RETURN_OK(strlcpy(data, "ok", COMMAND_OUTPUT_MAX));
+}
+
 /** Command eof
  *
  * Mark the end of a test file if we're reading from stdin.
@@ -2279,11 +2490,21 @@ static fr_table_ptr_sorted_t	commands[] = {
 					.usage = "decode-proto[.<testpoint_symbol>] (-|<hex string>)",
 					.description = "Decode a packet as attribute value pairs from a binary value using a specified protocol decoder.  Protocol must be loaded with \"load <protocol>\" first",
 				}},
+	{ L("decode-proto-bench"),	&(command_entry_t){
+					.func = command_decode_proto_bench,
+					.usage = "decode-proto-bench[.<testpoint_symbol>] <iterations> (-|<hex string>)",
+					.description = "Decode a packet repeatedly using a specified protocol decoder, writing \"ok\" to the data buffer, and the time taken per packet to the log",
+				}},
 	{ L("dictionary "),	&(command_entry_t){
 					.func = command_dictionary_attribute_parse,
 					.usage = "dictionary <string>",
 					.description = "Parse dictionary attribute definition, writing \"ok\" to the data buffer if successful",
 				}},
+	{ L("dictionary-bench"),	&(command_entry_t){
+					.func = command_dictionary_bench,
+					.usage = "dictionary-bench [<iterations>]",
+					.description = "Measure lookups of every attribute in the active dictionary by name, before and after it's indexed, writing \"ok\" to the data buffer",
+				}},
 	{ L("dictionary-dump"),	&(command_entry_t){
 					.func = command_dictionary_dump,
 					.usage = "dictionary-dump",
@@ -2304,6 +2525,11 @@ static fr_table_ptr_sorted_t	commands[] = {
 					.usage = "encode-proto[.<testpoint_symbol>] (-|<attribute> = <value>[,<attribute = <value>])",
 					.description = "Encode one or more attributes as a packet, writing a hex string to the data buffer.  Protocol must be loaded with \"load <protocol>\" first"
 				}},
+	{ L("encode-proto-bench"),	&(command_entry_t){
+					.func = command_encode_proto_bench,
+					.usage = "encode-proto-bench[.<testpoint_symbol>] <iterations> <attribute> = <value>[,<attribute = <value>]",
+					.description = "Encode attributes as a packet repeatedly using a specified protocol encoder, writing \"ok\" to the data buffer, and the time taken per packet to the log",
+				}},
 	{ L("eof"),		&(command_entry_t){
 					.func = command_eof,
 					.usage = "eof",
@@ -140,7 +140,7 @@ static RADCLIENT *client_alloc(TALLOC_CTX *ctx, char const *ip, char const *name
 
 static REQUEST *request_from_file(TALLOC_CTX *ctx, FILE *fp, fr_event_list_t *el, RADCLIENT *client)
 {
-	VALUE_PAIR	*vp;
+	VALUE_PAIR	*vp, *vps = NULL;
 	REQUEST		*request;
 	fr_cursor_t	cursor;
 
@@ -177,6 +177,12 @@ static REQUEST *request_from_file(TALLOC_CTX *ctx, FILE *fp, fr_event_list_t *el
 		return NULL;
 	}
 
+	/*
+	 *	Index the lists the same way the workers do.
+	 */
+	MEM(fr_pair_list_index_alloc(request->packet, &request->packet->vps) == 0);
+	MEM(fr_pair_list_index_alloc(request->reply, &request->reply->vps) == 0);
+
 	request->client = client;
 
 	request->number = number++;
@@ -191,11 +197,12 @@ static REQUEST *request_from_file(TALLOC_CTX *ctx, FILE *fp, fr_event_list_t *el
 	/*
 	 *	Read packet from fp
 	 */
-	if (fr_pair_list_afrom_file(request->packet, dict_protocol, &request->packet->vps, fp, &filedone) < 0) {
+	if (fr_pair_list_afrom_file(request->packet, dict_protocol, &vps, fp, &filedone) < 0) {
 		fr_perror("%s", main_config->name);
 		talloc_free(request);
 		return NULL;
 	}
+	fr_pair_list_append(&request->packet->vps, vps);
 
 	/*
 	 *	Set the defaults for IPs, etc.
@@ -212,7 +219,7 @@ static REQUEST *request_from_file(TALLOC_CTX *ctx, FILE *fp, fr_event_list_t *el
 	request->packet->dst_ipaddr.addr.v4.s_addr = htonl(INADDR_LOOPBACK);
 	request->packet->dst_port = 1812;
 
-	for (vp = fr_cursor_init(&cursor, &request->packet->vps);
+	for (vp = fr_pair_list_cursor_init(&cursor, &request->packet->vps);
 	     vp;
 	     vp = fr_cursor_next(&cursor)) {
 		/*
@@ -249,7 +256,7 @@ static REQUEST *request_from_file(TALLOC_CTX *ctx, FILE *fp, fr_event_list_t *el
 	}
 
 	if (fr_debug_lvl) {
-		for (vp = fr_cursor_init(&cursor, &request->packet->vps);
+		for (vp = fr_pair_list_cursor_init(&cursor, &request->packet->vps);
 		     vp;
 		     vp = fr_cursor_next(&cursor)) {
 			/*
@@ -277,7 +284,6 @@ static REQUEST *request_from_file(TALLOC_CTX *ctx, FILE *fp, fr_event_list_t *el
 	request->reply->id = request->packet->id;
 	request->reply->code = 0; /* UNKNOWN code */
 	memcpy(request->reply->vector, request->packet->vector, sizeof(request->reply->vector));
-	request->reply->vps = NULL;
 	request->reply->data = NULL;
 	request->reply->data_len = 0;
 
@@ -309,7 +315,7 @@ static void print_packet(FILE *fp, RADIUS_PACKET *packet)
 	dv = fr_dict_enum_by_value(attr_packet_type, fr_box_uint32(packet->code));
 	if (dv) fprintf(fp, "%s\n", dv->name);
 
-	for (vp = fr_cursor_init(&cursor, &packet->vps);
+	for (vp = fr_pair_list_cursor_init(&cursor, &packet->vps);
 	     vp;
 	     vp = fr_cursor_next(&cursor)) {
 		/*
@@ -542,7 +548,8 @@ static REQUEST *request_clone(REQUEST *old)
 	if (!request->reply) request->reply = fr_radius_alloc(request, false);
 
 	memcpy(request->packet, old->packet, sizeof(*request->packet));
-	(void) fr_pair_list_copy(request->packet, &request->packet->vps, old->packet->vps);
+	fr_pair_list_init(&request->packet->vps, FR_PAIR_LIST_DOUBLE);
+	(void) fr_pair_list_append_copy(request->packet, &request->packet->vps, fr_pair_list_head(&old->packet->vps));
 	request->packet->timestamp = fr_time();
 	request->number = old->number++;
 
@@ -986,7 +993,7 @@ int main(int argc, char *argv[])
 		vp->vp_uint32 = request->reply->code;
 
 
-		if (!fr_pair_validate(failed, filter_vps, request->reply->vps)) {
+		if (!fr_pair_validate(failed, filter_vps, fr_pair_list_head(&request->reply->vps))) {
 			fr_pair_validate_debug(request, failed);
 			fr_perror("Output file %s does not match attributes in filter %s",
 				  output_file ? output_file : input_file, filter_file);
@@ -82,6 +82,8 @@ typedef struct {
 	fr_event_timer_t const	*ev;			//!< Multi-Handle timer.
 	uint64_t		transfers;		//!< How many transfers are current in progress.
 	CURLM			*mandle;		//!< The multi handle.
+	bool			multiplex;		//!< Whether requests should wait to be multiplexed
+							///< over an existing connection.
 } fr_curl_handle_t;
 
 /** Structure representing an individual request being passed to curl for processing
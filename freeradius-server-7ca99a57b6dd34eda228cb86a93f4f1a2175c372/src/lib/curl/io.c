@@ -478,6 +478,16 @@ int fr_curl_io_request_enqueue(fr_curl_handle_t *mhandle, REQUEST *request, fr_c
 	 *	private data.  This makes it simple to resume
 	 *	the request in the demux function later...
 	 */
+#ifdef CURLPIPE_MULTIPLEX
+	/*
+	 *	Prefer waiting for an existing connection to be
+	 *	able to multiplex this request, over opening a new
+	 *	connection for every request which arrives while
+	 *	the first connection is being established.
+	 */
+	if (mhandle->multiplex) FR_CURL_REQUEST_SET_OPTION(CURLOPT_PIPEWAIT, 1L);
+#endif
+
 	ret = curl_easy_setopt(randle->candle, CURLOPT_PRIVATE, randle);
 	if (ret != CURLE_OK) {
 		REDEBUG("Request failed: %i - %s", ret, curl_easy_strerror(ret));
@@ -579,6 +589,9 @@ fr_curl_handle_t *fr_curl_io_init(TALLOC_CTX *ctx,
 	MEM(mhandle = talloc_zero(ctx, fr_curl_handle_t));
 	mhandle->el = el;
 	mhandle->mandle = mandle;
+#ifdef CURLPIPE_MULTIPLEX
+	mhandle->multiplex = multiplex;
+#endif
 	talloc_set_destructor(mhandle, _mhandle_free);
 
 	SET_MOPTION(mandle, CURLMOPT_TIMERFUNCTION, _fr_curl_io_timer_modify);
@@ -38,7 +38,7 @@ static bool chbind_build_response(REQUEST *request, CHBIND_REQ *chbind)
 	fr_cursor_t		cursor;
 
 	total = 0;
-	for (vp = fr_cursor_init(&cursor, &request->reply->vps);
+	for (vp = fr_pair_list_cursor_init(&cursor, &request->reply->vps);
 	     vp != NULL;
 	     vp = fr_cursor_next(&cursor)) {
 		/*
@@ -65,7 +65,7 @@ static bool chbind_build_response(REQUEST *request, CHBIND_REQ *chbind)
 	 *	Set the response code.  Default to "fail" if none was
 	 *	specified.
 	 */
-	vp = fr_pair_find_by_da(request->control, attr_chbind_response_code, TAG_ANY);
+	vp = fr_pair_list_find_by_da(&request->control, attr_chbind_response_code, TAG_ANY);
 	if (vp) {
 		ptr[0] = vp->vp_uint32;
 	} else {
@@ -80,13 +80,13 @@ static bool chbind_build_response(REQUEST *request, CHBIND_REQ *chbind)
 	ptr[3] = CHBIND_NSID_RADIUS;
 
 	RDEBUG2("Sending chbind response: code %i", (int )(ptr[0]));
-	log_request_pair_list(L_DBG_LVL_1, request, request->reply->vps, NULL);
+	log_request_pair_list(L_DBG_LVL_1, request, fr_pair_list_head(&request->reply->vps), NULL);
 
 	/* Encode the chbind attributes into the response */
 	ptr += 4;
 	end = ptr + total;
 
-	fr_cursor_init(&cursor, &request->reply->vps);
+	fr_pair_list_cursor_init(&cursor, &request->reply->vps);
 	while ((vp = fr_cursor_current(&cursor)) && (ptr < end)) {
 		/*
 		 *	Skip things which shouldn't be in channel bindings.
@@ -181,13 +181,13 @@ FR_CODE chbind_process(REQUEST *request, CHBIND_REQ *chbind)
 
 	/* Set-up the fake request */
 	fake = request_alloc_fake(request, NULL);
-	MEM(fr_pair_add_by_da(fake->packet, &vp, &fake->packet->vps, attr_freeradius_proxied_to) >= 0);
+	MEM(fr_pair_list_add_by_da(fake->packet, &vp, &fake->packet->vps, attr_freeradius_proxied_to) >= 0);
 	fr_pair_value_from_str(vp, "127.0.0.1", sizeof("127.0.0.1"), '\0', false);
 
 	/* Add the username to the fake request */
 	if (chbind->username) {
 		vp = fr_pair_copy(fake->packet, chbind->username);
-		fr_pair_add(&fake->packet->vps, vp);
+		fr_pair_list_append(&fake->packet->vps, vp);
 	}
 
 	/*
@@ -201,7 +201,7 @@ FR_CODE chbind_process(REQUEST *request, CHBIND_REQ *chbind)
 
 		fr_assert(data_len <= talloc_array_length((uint8_t const *) chbind->request));
 
-		fr_cursor_init(&cursor, &fake->packet->vps);
+		fr_pair_list_cursor_init(&cursor, &fake->packet->vps);
 		while (data_len > 0) {
 			ssize_t attr_len;
 
@@ -239,7 +239,7 @@ rlm_rcode_t eap_compose(eap_session_t *eap_session)
 	 *	Don't add a Message-Authenticator if
 	 *	it's already there.
 	 */
-	vp = fr_pair_find_by_da(request->reply->vps, attr_message_authenticator, TAG_ANY);
+	vp = fr_pair_list_find_by_da(&request->reply->vps, attr_message_authenticator, TAG_ANY);
 	if (!vp) {
 		static uint8_t auth_vector[RADIUS_AUTH_VECTOR_LENGTH] = { 0x00 };
 
@@ -302,7 +302,7 @@ int eap_start(REQUEST *request, rlm_eap_method_t const methods[], bool ignore_un
 	VALUE_PAIR *vp;
 	VALUE_PAIR *eap_msg;
 
-	eap_msg = fr_pair_find_by_da(request->packet->vps, attr_eap_message, TAG_ANY);
+	eap_msg = fr_pair_list_find_by_da(&request->packet->vps, attr_eap_message, TAG_ANY);
 	if (!eap_msg) {
 		RDEBUG2("No EAP-Message, not doing EAP");
 		return RLM_MODULE_NOOP;
@@ -312,7 +312,7 @@ int eap_start(REQUEST *request, rlm_eap_method_t const methods[], bool ignore_un
 	 *	Look for EAP-Type = None (FreeRADIUS specific attribute)
 	 *	this allows you to NOT do EAP for some users.
 	 */
-	vp = fr_pair_find_by_da(request->packet->vps, attr_eap_type, TAG_ANY);
+	vp = fr_pair_list_find_by_da(&request->packet->vps, attr_eap_type, TAG_ANY);
 	if (vp && vp->vp_uint32 == 0) {
 		RDEBUG2("Found EAP-Message, but EAP-Type = None, so we're not doing EAP");
 		return RLM_MODULE_NOOP;
@@ -505,8 +505,8 @@ rlm_rcode_t eap_fail(eap_session_t *eap_session)
 	/*
 	 *	Delete any previous replies.
 	 */
-	fr_pair_delete_by_da(&eap_session->request->reply->vps, attr_eap_message);
-	fr_pair_delete_by_da(&eap_session->request->reply->vps, attr_state);
+	fr_pair_list_delete_by_da(&eap_session->request->reply->vps, attr_eap_message);
+	fr_pair_list_delete_by_da(&eap_session->request->reply->vps, attr_state);
 
 	talloc_free(eap_session->this_round->request);
 	eap_session->this_round->request = talloc_zero(eap_session->this_round, eap_packet_t);
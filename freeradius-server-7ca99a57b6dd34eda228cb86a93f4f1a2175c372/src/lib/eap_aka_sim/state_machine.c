@@ -169,7 +169,7 @@ static bool identity_req_set_by_user(REQUEST *request, eap_aka_sim_session_t *ea
 	 *	then delete them so they don't screw
 	 *	up any of the other code.
 	 */
-	for (vp = fr_cursor_init(&cursor, &request->reply->vps);
+	for (vp = fr_pair_list_cursor_init(&cursor, &request->reply->vps);
 	     vp;
 	     vp = fr_cursor_next(&cursor)) {
 		if (vp->da == attr_eap_aka_sim_permanent_id_req) {
@@ -373,8 +373,7 @@ static int identity_to_permanent_identity(REQUEST *request, VALUE_PAIR *in, eap_
 	 *	fancy, just copy Identity -> Permanent-Identity.
 	 */
 	if (!strip_hint) {
-		MEM(fr_pair_update_by_da(request->state_ctx, &vp,
-					 &request->state, attr_eap_aka_sim_permanent_identity) >= 0);
+		MEM(fr_pair_list_update_by_da(request->state_ctx, &vp, &request->state, attr_eap_aka_sim_permanent_identity) >= 0);
 		fr_pair_value_bstrndup(vp, in->vp_strvalue, in->vp_length, true);
 		return 0;
 	}
@@ -409,8 +408,7 @@ static int identity_to_permanent_identity(REQUEST *request, VALUE_PAIR *in, eap_
 	 */
 	if ((fr_aka_sim_id_type(&our_type, &our_method, in->vp_strvalue, in->vp_length) < 0) ||
 	    (our_type != AKA_SIM_ID_TYPE_PERMANENT)) {
-		MEM(fr_pair_update_by_da(request->state_ctx, &vp,
-					 &request->state, attr_eap_aka_sim_permanent_identity) >= 0);
+		MEM(fr_pair_list_update_by_da(request->state_ctx, &vp, &request->state, attr_eap_aka_sim_permanent_identity) >= 0);
 		fr_pair_value_bstrndup(vp, in->vp_strvalue, in->vp_length, true);
 
 		RDEBUG2("%s has incorrect hint byte, expected '%c', got '%c'.  "
@@ -429,8 +427,7 @@ static int identity_to_permanent_identity(REQUEST *request, VALUE_PAIR *in, eap_
 		 *	Strip off the hint byte, and then add the permanent
 		 *	identity to the output list.
 		 */
-		MEM(fr_pair_update_by_da(request->state_ctx, &vp,
-					 &request->state, attr_eap_aka_sim_permanent_identity) >= 0);
+		MEM(fr_pair_list_update_by_da(request->state_ctx, &vp, &request->state, attr_eap_aka_sim_permanent_identity) >= 0);
 		fr_pair_value_bstrndup(vp, in->vp_strvalue + 1, in->vp_length - 1, true);
 
 		RDEBUG2("Stripping 'hint' byte from %s", attr_eap_aka_sim_permanent_identity->name);
@@ -516,7 +513,7 @@ static rlm_rcode_t pseudonym_store_resume(module_ctx_t const *mctx, REQUEST *req
 
 	pair_delete_request(attr_eap_aka_sim_next_pseudonym);
 
-	vp = fr_pair_find_by_da(request->reply->vps, attr_eap_aka_sim_next_reauth_id, TAG_ANY);
+	vp = fr_pair_list_find_by_da(&request->reply->vps, attr_eap_aka_sim_next_reauth_id, TAG_ANY);
 	if (vp) {
 		/*
 		 *	Generate a random fastauth string
@@ -590,7 +587,7 @@ static rlm_rcode_t pseudonym_store_resume(module_ctx_t const *mctx, REQUEST *req
 		 *	state increment by 1, otherwise, add the
 		 *	attribute and set to zero.
 		 */
-		vp = fr_pair_find_by_da(request->state, attr_eap_aka_sim_counter, TAG_ANY);
+		vp = fr_pair_list_find_by_da(&request->state, attr_eap_aka_sim_counter, TAG_ANY);
 		if (vp) {
 			vp->vp_uint16++;
 		/*
@@ -642,7 +639,7 @@ static rlm_rcode_t session_and_pseudonym_store(module_ctx_t const *mctx,
 
 	request->rcode = RLM_MODULE_NOOP;	/* Needed because we may call resume functions directly */
 
-	vp = fr_pair_find_by_da(request->reply->vps, attr_eap_aka_sim_next_pseudonym, TAG_ANY);
+	vp = fr_pair_list_find_by_da(&request->reply->vps, attr_eap_aka_sim_next_pseudonym, TAG_ANY);
 	if (vp) {
 		/*
 		 *	Generate a random pseudonym string
@@ -837,7 +834,7 @@ static int common_encode(REQUEST *request, eap_session_t *eap_session, uint16_t
 		}
 	}
 
-	fr_cursor_init(&cursor, &request->reply->vps);
+	fr_pair_list_cursor_init(&cursor, &request->reply->vps);
 	fr_cursor_init(&to_encode, &head);
 
 	/*
@@ -931,7 +928,7 @@ static rlm_rcode_t common_failure_notification_send(module_ctx_t const *mctx,
 	 *	- FR_NOTIFICATION_VALUE_NOT_SUBSCRIBED
 	 *	  User has not subscribed to the requested service.
 	 */
-	notification_vp = fr_pair_find_by_da(request->reply->vps, attr_eap_aka_sim_notification, TAG_ANY);
+	notification_vp = fr_pair_list_find_by_da(&request->reply->vps, attr_eap_aka_sim_notification, TAG_ANY);
 
 	/*
 	 *	Change the failure notification depending where
@@ -1121,7 +1118,7 @@ static rlm_rcode_t common_reauthentication_request_compose(module_ctx_t const *m
 {
 	eap_aka_sim_session_t	*eap_aka_sim_session = talloc_get_type_abort(eap_session->opaque,
 									     eap_aka_sim_session_t);
-	VALUE_PAIR		*to_peer = request->reply->vps, *vp;
+	VALUE_PAIR		*to_peer = fr_pair_list_head(&request->reply->vps), *vp;
 
 	VALUE_PAIR		*kdf_id;
 
@@ -1135,11 +1132,11 @@ static rlm_rcode_t common_reauthentication_request_compose(module_ctx_t const *m
 	 *	Not seen any doing this for re-authentication
 	 *	but you never know...
 	 */
-	kdf_id = fr_pair_find_by_da(request->control, attr_eap_aka_sim_kdf_identity, TAG_ANY);
+	kdf_id = fr_pair_list_find_by_da(&request->control, attr_eap_aka_sim_kdf_identity, TAG_ANY);
 	if (kdf_id) {
 		identity_to_crypto_identity(request, eap_aka_sim_session,
 					    (uint8_t const *)kdf_id->vp_strvalue, kdf_id->vp_length);
-		fr_pair_delete_by_da(&request->control, attr_eap_aka_sim_kdf_identity);
+		fr_pair_list_delete_by_da(&request->control, attr_eap_aka_sim_kdf_identity);
 	}
 
 	RDEBUG2("Generating new session keys");
@@ -1151,7 +1148,7 @@ static rlm_rcode_t common_reauthentication_request_compose(module_ctx_t const *m
 	 */
 	case FR_EAP_METHOD_SIM:
 	case FR_EAP_METHOD_AKA:
-		if (fr_aka_sim_vector_gsm_umts_kdf_0_reauth_from_attrs(request, request->state,
+		if (fr_aka_sim_vector_gsm_umts_kdf_0_reauth_from_attrs(request, fr_pair_list_head(&request->state),
 								       &eap_aka_sim_session->keys) != 0) {
 		request_new_id:
 			switch (eap_aka_sim_session->last_id_req) {
@@ -1164,7 +1161,7 @@ static rlm_rcode_t common_reauthentication_request_compose(module_ctx_t const *m
 			case AKA_SIM_ANY_ID_REQ:
 				RDEBUG2("Composing EAP-Request/Reauthentication failed.  Clearing reply attributes and "
 					"requesting additional Identity");
-				fr_pair_list_free(&request->reply->vps);
+				fr_pair_list_clear(&request->reply->vps);
 				eap_aka_sim_session->id_req = AKA_SIM_FULLAUTH_ID_REQ;
 				return common_identity_enter(mctx, request, eap_session);
 
@@ -1183,7 +1180,7 @@ static rlm_rcode_t common_reauthentication_request_compose(module_ctx_t const *m
 	case FR_EAP_METHOD_AKA_PRIME:
 		switch (eap_aka_sim_session->kdf) {
 		case FR_KDF_VALUE_PRIME_WITH_CK_PRIME_IK_PRIME:
-			if (fr_aka_sim_vector_umts_kdf_1_reauth_from_attrs(request, request->state,
+			if (fr_aka_sim_vector_umts_kdf_1_reauth_from_attrs(request, fr_pair_list_head(&request->state),
 									   &eap_aka_sim_session->keys) != 0) {
 				goto request_new_id;
 			}
@@ -1310,7 +1307,7 @@ static rlm_rcode_t aka_challenge_request_compose(module_ctx_t const *mctx,
 						 REQUEST *request, eap_session_t *eap_session)
 {
 	eap_aka_sim_session_t	*eap_aka_sim_session = talloc_get_type_abort(eap_session->opaque, eap_aka_sim_session_t);
-	VALUE_PAIR		*to_peer = request->reply->vps, *vp;
+	VALUE_PAIR		*to_peer = fr_pair_list_head(&request->reply->vps), *vp;
 	fr_aka_sim_vector_src_t	src = AKA_SIM_VECTOR_SRC_AUTO;
 
 	VALUE_PAIR		*kdf_id;
@@ -1322,11 +1319,11 @@ static rlm_rcode_t aka_challenge_request_compose(module_ctx_t const *mctx,
 	 *	implement RFC 4187 correctly and use the
 	 *	wrong identity as input the the PRF/KDF.
 	 */
-	kdf_id = fr_pair_find_by_da(request->control, attr_eap_aka_sim_kdf_identity, TAG_ANY);
+	kdf_id = fr_pair_list_find_by_da(&request->control, attr_eap_aka_sim_kdf_identity, TAG_ANY);
 	if (kdf_id) {
 		identity_to_crypto_identity(request, eap_aka_sim_session,
 					    (uint8_t const *)kdf_id->vp_strvalue, kdf_id->vp_length);
-		fr_pair_delete_by_da(&request->control, attr_eap_aka_sim_kdf_identity);
+		fr_pair_list_delete_by_da(&request->control, attr_eap_aka_sim_kdf_identity);
 	}
 
 	RDEBUG2("Acquiring UMTS vector(s)");
@@ -1361,7 +1358,7 @@ static rlm_rcode_t aka_challenge_request_compose(module_ctx_t const *mctx,
 	 *	Get vectors from attribute or generate
 	 *	them using COMP128-* or Milenage.
 	 */
-	if (fr_aka_sim_vector_umts_from_attrs(request, request->control, &eap_aka_sim_session->keys, &src) != 0) {
+	if (fr_aka_sim_vector_umts_from_attrs(request, fr_pair_list_head(&request->control), &eap_aka_sim_session->keys, &src) != 0) {
 	    	REDEBUG("Failed retrieving UMTS vectors");
 		goto failure;
 	}
@@ -1513,7 +1510,7 @@ static rlm_rcode_t sim_challenge_request_compose(module_ctx_t const *mctx,
 {
 	eap_aka_sim_session_t	*eap_aka_sim_session = talloc_get_type_abort(eap_session->opaque,
 									     eap_aka_sim_session_t);
-	VALUE_PAIR		*to_peer = request->reply->vps, *vp;
+	VALUE_PAIR		*to_peer = fr_pair_list_head(&request->reply->vps), *vp;
 	fr_aka_sim_vector_src_t	src = AKA_SIM_VECTOR_SRC_AUTO;
 
 	VALUE_PAIR		*kdf_id;
@@ -1525,19 +1522,19 @@ static rlm_rcode_t sim_challenge_request_compose(module_ctx_t const *mctx,
 	 *	implement RFC 4187 correctly and use the
 	 *	wrong identity as input the the PRF/KDF.
 	 */
-	kdf_id = fr_pair_find_by_da(request->control, attr_eap_aka_sim_kdf_identity, TAG_ANY);
+	kdf_id = fr_pair_list_find_by_da(&request->control, attr_eap_aka_sim_kdf_identity, TAG_ANY);
 	if (kdf_id) {
 		identity_to_crypto_identity(request, eap_aka_sim_session,
 					    (uint8_t const *)kdf_id->vp_strvalue, kdf_id->vp_length);
-		fr_pair_delete_by_da(&request->control, attr_eap_aka_sim_kdf_identity);
+		fr_pair_list_delete_by_da(&request->control, attr_eap_aka_sim_kdf_identity);
 	}
 
 	RDEBUG2("Acquiring GSM vector(s)");
-	if ((fr_aka_sim_vector_gsm_from_attrs(request, request->control, 0,
+	if ((fr_aka_sim_vector_gsm_from_attrs(request, fr_pair_list_head(&request->control), 0,
 					      &eap_aka_sim_session->keys, &src) != 0) ||
-	    (fr_aka_sim_vector_gsm_from_attrs(request, request->control, 1,
+	    (fr_aka_sim_vector_gsm_from_attrs(request, fr_pair_list_head(&request->control), 1,
 	    				      &eap_aka_sim_session->keys, &src) != 0) ||
-	    (fr_aka_sim_vector_gsm_from_attrs(request, request->control, 2,
+	    (fr_aka_sim_vector_gsm_from_attrs(request, fr_pair_list_head(&request->control), 2,
 	    				      &eap_aka_sim_session->keys, &src) != 0)) {
 	    	REDEBUG("Failed retrieving SIM vectors");
 		return RLM_MODULE_FAIL;
@@ -1712,7 +1709,7 @@ static rlm_rcode_t sim_start_request_send(module_ctx_t const *mctx,
 	 *	If the user provided no versions, then
 	 *      just add the default (1).
 	 */
-	if (!(fr_pair_find_by_da(request->reply->vps, attr_eap_aka_sim_version_list, TAG_ANY))) {
+	if (!(fr_pair_list_find_by_da(&request->reply->vps, attr_eap_aka_sim_version_list, TAG_ANY))) {
 		MEM(pair_add_reply(&vp, attr_eap_aka_sim_version_list) >= 0);
 		vp->vp_uint16 = EAP_SIM_VERSION;
 	}
@@ -1721,7 +1718,7 @@ static rlm_rcode_t sim_start_request_send(module_ctx_t const *mctx,
 	 *	Iterate over the the versions adding them
 	 *      to the version list we use for keying.
 	 */
-	for (vp = fr_cursor_init(&cursor, &request->reply->vps); vp; vp = fr_cursor_next(&cursor)) {
+	for (vp = fr_pair_list_cursor_init(&cursor, &request->reply->vps); vp; vp = fr_cursor_next(&cursor)) {
 		if (vp->da != attr_eap_aka_sim_version_list) continue;
 
 		if ((end - p) < 2) break;
@@ -1809,7 +1806,7 @@ static rlm_rcode_t common_eap_failure_enter(module_ctx_t const *mctx, REQUEST *r
 	/*
 	 *	Free anything we were going to send out...
 	 */
-	fr_pair_list_free(&request->reply->vps);
+	fr_pair_list_clear(&request->reply->vps);
 
 	/*
 	 *	If we're failing, then any identities
@@ -1844,7 +1841,7 @@ static rlm_rcode_t common_failure_notification_enter_resume(module_ctx_t const *
 	/*
 	 *	Free anything we were going to send out...
 	 */
-	fr_pair_list_free(&request->reply->vps);
+	fr_pair_list_clear(&request->reply->vps);
 
 	/*
 	 *	If there's an issue composing the failure
@@ -2017,7 +2014,7 @@ static rlm_rcode_t common_reauthentication_send_resume(module_ctx_t const *mctx,
 			RDEBUG2("Previous section returned (%s), clearing reply attributes and "
 				"requesting additional identity",
 				fr_table_str_by_value(rcode_table, request->rcode, "<INVALID>"));
-			fr_pair_list_free(&request->reply->vps);
+			fr_pair_list_clear(&request->reply->vps);
 			eap_aka_sim_session->id_req = AKA_SIM_FULLAUTH_ID_REQ;
 
 			return common_identity_enter(mctx, request, eap_session);
@@ -2086,7 +2083,7 @@ static rlm_rcode_t session_load_resume(module_ctx_t const *mctx,
 			RDEBUG2("Previous section returned (%s), clearing reply attributes and "
 				"requesting additional identity",
 				fr_table_str_by_value(rcode_table, request->rcode, "<INVALID>"));
-			fr_pair_list_free(&request->reply->vps);
+			fr_pair_list_clear(&request->reply->vps);
 			eap_aka_sim_session->id_req = AKA_SIM_FULLAUTH_ID_REQ;
 			return common_identity_enter(mctx, request, eap_session);
 
@@ -2160,7 +2157,7 @@ static rlm_rcode_t pseudonym_load_resume(module_ctx_t const *mctx,
 			RDEBUG2("Previous section returned (%s), clearing reply attributes and "
 				"requesting additional identity",
 				fr_table_str_by_value(rcode_table, request->rcode, "<INVALID>"));
-			fr_pair_list_free(&request->reply->vps);
+			fr_pair_list_clear(&request->reply->vps);
 			eap_aka_sim_session->id_req = AKA_SIM_FULLAUTH_ID_REQ;
 			return common_identity_enter(mctx, request, eap_session);
 
@@ -2273,7 +2270,7 @@ static rlm_rcode_t aka_challenge_enter(module_ctx_t const *mctx,
 	 	 *	and send it to the peer.
 	 	 */
 		if (inst->network_name &&
-		    !fr_pair_find_by_da(request->reply->vps, attr_eap_aka_sim_kdf_input, TAG_ANY)) {
+		    !fr_pair_list_find_by_da(&request->reply->vps, attr_eap_aka_sim_kdf_input, TAG_ANY)) {
 			MEM(pair_add_reply(&vp, attr_eap_aka_sim_kdf_input) >= 0);
 			fr_pair_value_bstrdup_buffer(vp, inst->network_name, false);
 		}
@@ -2285,7 +2282,7 @@ static rlm_rcode_t aka_challenge_enter(module_ctx_t const *mctx,
 		 *	Use the default bidding value we have configured
 		 */
 		if (eap_aka_sim_session->send_at_bidding_prefer_prime &&
-		    !fr_pair_find_by_da(request->reply->vps, attr_eap_aka_sim_bidding, TAG_ANY)) {
+		    !fr_pair_list_find_by_da(&request->reply->vps, attr_eap_aka_sim_bidding, TAG_ANY)) {
 			MEM(pair_add_reply(&vp, attr_eap_aka_sim_bidding) >= 0);
 			vp->vp_uint16 = FR_BIDDING_VALUE_PREFER_AKA_PRIME;
 		}
@@ -2297,7 +2294,7 @@ static rlm_rcode_t aka_challenge_enter(module_ctx_t const *mctx,
 	 *	Set the defaults for protected result indicator
 	 */
 	if (eap_aka_sim_session->send_result_ind &&
-	    !fr_pair_find_by_da(request->reply->vps, attr_eap_aka_sim_result_ind, TAG_ANY)) {
+	    !fr_pair_list_find_by_da(&request->reply->vps, attr_eap_aka_sim_result_ind, TAG_ANY)) {
 	    	MEM(pair_add_reply(&vp, attr_eap_aka_sim_result_ind) >= 0);
 		vp->vp_bool = true;
 	}
@@ -2350,7 +2347,7 @@ static rlm_rcode_t sim_challenge_enter(module_ctx_t const *mctx,
 	 *	Set the defaults for protected result indicator
 	 */
 	if (eap_aka_sim_session->send_result_ind &&
-	    !fr_pair_find_by_da(request->reply->vps, attr_eap_aka_sim_result_ind, TAG_ANY)) {
+	    !fr_pair_list_find_by_da(&request->reply->vps, attr_eap_aka_sim_result_ind, TAG_ANY)) {
 	    	MEM(pair_add_reply(&vp, attr_eap_aka_sim_result_ind) >= 0);
 		vp->vp_bool = true;
 	}
@@ -2496,7 +2493,7 @@ static rlm_rcode_t common_reauthentication_response_process(module_ctx_t const *
 	uint8_t			calc_mac[AKA_SIM_MAC_DIGEST_SIZE];
 	ssize_t			slen;
 	VALUE_PAIR		*mac, *checkcode;
-	VALUE_PAIR		*from_peer = request->packet->vps;
+	VALUE_PAIR		*from_peer = fr_pair_list_head(&request->packet->vps);
 
 	mac = fr_pair_find_by_da(from_peer, attr_eap_aka_sim_mac, TAG_ANY);
 	if (!mac) {
@@ -2614,7 +2611,7 @@ static rlm_rcode_t aka_challenge_response_process(module_ctx_t const *mctx,
 	uint8_t			calc_mac[AKA_SIM_MAC_DIGEST_SIZE];
 	ssize_t			slen;
 	VALUE_PAIR		*vp = NULL, *mac, *checkcode;
-	VALUE_PAIR		*from_peer = request->packet->vps;
+	VALUE_PAIR		*from_peer = fr_pair_list_head(&request->packet->vps);
 
 	mac = fr_pair_find_by_da(from_peer, attr_eap_aka_sim_mac, TAG_ANY);
 	if (!mac) {
@@ -2743,7 +2740,7 @@ static rlm_rcode_t sim_challenge_response_process(module_ctx_t const *mctx,
 	uint8_t			calc_mac[AKA_SIM_MAC_DIGEST_SIZE];
 	ssize_t			slen;
 	VALUE_PAIR		*mac;
-	VALUE_PAIR		*from_peer = request->packet->vps;
+	VALUE_PAIR		*from_peer = fr_pair_list_head(&request->packet->vps);
 
 	memcpy(p, eap_aka_sim_session->keys.gsm.vector[0].sres, AKA_SIM_VECTOR_GSM_SRES_SIZE);
 	p += AKA_SIM_VECTOR_GSM_SRES_SIZE;
@@ -2823,7 +2820,7 @@ static rlm_rcode_t aka_identity_response_process(module_ctx_t const *mctx,
 									     eap_aka_sim_session_t);
 	bool			user_set_id_req;
 	VALUE_PAIR		*identity_type;
-	VALUE_PAIR		*from_peer = request->packet->vps;
+	VALUE_PAIR		*from_peer = fr_pair_list_head(&request->packet->vps);
 	/*
 	 *	Digest the identity response
 	 */
@@ -3004,7 +3001,7 @@ static rlm_rcode_t sim_start_response_process(module_ctx_t const *mctx,
 	bool			user_set_id_req;
 	VALUE_PAIR		*identity_type;
 
-	VALUE_PAIR		*from_peer = request->packet->vps;
+	VALUE_PAIR		*from_peer = fr_pair_list_head(&request->packet->vps);
 
 	/*
 	 *	See if the user wants us to request another
@@ -3267,7 +3264,7 @@ static rlm_rcode_t aka_synchronization_failure_recv_resume(module_ctx_t const *m
 	 *	We couldn't generate an SQN and the user didn't provide one,
 	 *	so we need to fail.
 	 */
-	vp = fr_pair_find_by_da(request->control, attr_sim_sqn, TAG_ANY);
+	vp = fr_pair_list_find_by_da(&request->control, attr_sim_sqn, TAG_ANY);
 	if (!vp) {
 		REDEBUG("No &control:SQN value provided after resynchronisation, cannot continue");
 		goto failure;
@@ -3335,7 +3332,7 @@ static rlm_rcode_t common_decode(VALUE_PAIR **subtype_vp, VALUE_PAIR **vps,
 
 	int			ret;
 
-	fr_cursor_init(&cursor, &request->packet->vps);
+	fr_pair_list_cursor_init(&cursor, &request->packet->vps);
 	fr_cursor_tail(&cursor);
 
 	ret = fr_aka_sim_decode(request,
@@ -3937,7 +3934,7 @@ static rlm_rcode_t common_eap_identity_resume(module_ctx_t const *mctx, REQUEST
 										     eap_aka_sim_session_t);
 	VALUE_PAIR			*eap_type, *method, *identity_type;
 	fr_aka_sim_method_hint_t	running, hinted;
-	VALUE_PAIR			*from_peer = request->packet->vps;
+	VALUE_PAIR			*from_peer = fr_pair_list_head(&request->packet->vps);
 
 	section_rcode_process(mctx, request, eap_session, eap_aka_sim_session);
 
@@ -3946,7 +3943,7 @@ static rlm_rcode_t common_eap_identity_resume(module_ctx_t const *mctx, REQUEST
 	 *	This must be done before we enter
 	 *	the submodule.
 	 */
-	eap_type = fr_pair_find_by_da(request->control, attr_eap_type, TAG_ANY);
+	eap_type = fr_pair_list_find_by_da(&request->control, attr_eap_type, TAG_ANY);
 	if (eap_type) RWDEBUG("Ignoring &control:EAP-Type, this must be set *before* the EAP module is called");
 
 	method = fr_pair_find_by_da(from_peer, attr_eap_aka_sim_method_hint, TAG_ANY);
@@ -265,6 +265,29 @@ size_t fr_atomic_queue_size(fr_atomic_queue_t *aq)
 	return aq->size;
 }
 
+/** Check if the atomic queue is empty
+ *
+ * This should only be called by the consumer.  A producer may be
+ * part way through a push, in which case the queue is still seen
+ * as empty.
+ *
+ * @param[in] aq	the atomic queue to check.
+ * @return
+ *	- true if there is nothing to pop.
+ *	- false if the next pop will succeed.
+ */
+bool fr_atomic_queue_empty(fr_atomic_queue_t *aq)
+{
+	int64_t			tail, seq;
+	fr_atomic_queue_entry_t	*entry;
+
+	tail = load(aq->tail);
+	entry = &aq->entry[ tail % aq->size ];
+	seq = aquire(entry->seq);
+
+	return ((seq - (tail + 1)) < 0);
+}
+
 #ifdef WITH_VERIFY_PTR
 /** Check the talloc chunk is still valid
  *
@@ -45,9 +45,22 @@ RCSID("$Id$")
 #endif
 
 /*
- *	We disable this until we fix all of the signaling issues...
+ *	Signalling protocol
+ *
+ *	Each end of the channel has a "peer_sleeping" flag.  The
+ *	reader of a queue sets the flag on the writer's end when it
+ *	is about to go idle, and then checks the queue one last time.
+ *	The writer pushes the message onto the queue, and then clears
+ *	the flag.  It only signals the reader if the flag was set.
+ *
+ *	The fences ensure that either the writer sees the flag, and
+ *	signals the reader, or the reader sees the message, and
+ *	doesn't sleep.  So we never lose a wakeup, and we send at most
+ *	one signal each time the reader goes idle.
+ *
+ *	While the reader is busy, it is responsible for polling its
+ *	inbound queues.
  */
-#define ENABLE_SKIPS (0)
 
 typedef enum {
 	TO_RESPONDER = 0,
@@ -62,10 +75,6 @@ static fr_table_num_sorted_t const channel_direction[] = {
 size_t channel_direction_len = NUM_ELEMENTS(channel_direction);
 #endif
 
-#if 0
-#define SIGNAL_INTERVAL (1000000)	//!< The minimum interval between responder signals.
-#endif
-
 /** Size of the atomic queues
  *
  * The queue reader MUST service the queue occasionally,
@@ -118,17 +127,15 @@ typedef struct {
 	fr_channel_recv_callback_t recv;	//!< callback for receiving messages
 	void			*recv_uctx;	//!< context for receiving messages
 
-	bool			must_signal;	//!< we need to signal the other end
-
-
 	uint64_t		sequence;	//!< Sequence number for this channel.
 	uint64_t		ack;		//!< Sequence number of the other end.
 	uint64_t		their_view_of_my_sequence;	//!< Should be clear.
 
-	uint64_t		sequence_at_last_signal;	//!< When we last signaled.
-
 	fr_atomic_queue_t	*aq;		//!< The queue of messages - visible only to this channel.
 
+	atomic_bool		peer_sleeping;	//!< The reader of "aq" is idle, and must be signalled
+						///< when we push a new message.
+
 	atomic_bool		active;		//!< Whether the channel is active.
 
 	fr_channel_stats_t	stats;		//!< channel statistics
@@ -239,11 +246,13 @@ fr_channel_t *fr_channel_create(TALLOC_CTX *ctx, fr_control_t *requestor, fr_con
 	ch->end[TO_RESPONDER].stats.last_read_other = now;
 	ch->end[TO_RESPONDER].stats.last_sent_signal = now;
 	atomic_store(&ch->end[TO_RESPONDER].active, true);
+	atomic_store(&ch->end[TO_RESPONDER].peer_sleeping, true);
 
 	ch->end[TO_REQUESTOR].stats.last_write = now;
 	ch->end[TO_REQUESTOR].stats.last_read_other = now;
 	ch->end[TO_REQUESTOR].stats.last_sent_signal = now;
 	atomic_store(&ch->end[TO_REQUESTOR].active, true);
+	atomic_store(&ch->end[TO_REQUESTOR].peer_sleeping, true);
 
 	return ch;
 }
@@ -275,7 +284,6 @@ static int fr_channel_data_ready(fr_channel_t *ch, fr_time_t when, fr_channel_en
 
 	end->stats.last_sent_signal = when;
 	end->stats.signals++;
-	end->must_signal = false;
 
 	cc.signal = which;
 	cc.ack = end->ack;
@@ -291,6 +299,53 @@ static int fr_channel_data_ready(fr_channel_t *ch, fr_time_t when, fr_channel_en
 #define IALPHA (8)
 #define RTT(_old, _new) ((_new + ((IALPHA - 1) * _old)) / IALPHA)
 
+/** Check if the reader of an end needs to be woken up
+ *
+ * Must be called after the message has been pushed onto the queue.
+ *
+ * @param[in] end	of the channel that the message was written to.
+ * @return
+ *	- true if the reader is sleeping, and we must signal it.
+ *	- false if the reader is running, and will see the message.
+ */
+static inline bool fr_channel_must_signal(fr_channel_end_t *end)
+{
+	atomic_thread_fence(memory_order_seq_cst);
+
+	if (!atomic_load_explicit(&end->peer_sleeping, memory_order_relaxed) ||
+	    !atomic_exchange(&end->peer_sleeping, false)) {
+		end->stats.skipped++;
+		return false;
+	}
+
+	return true;
+}
+
+/** Mark the reader of an end as sleeping
+ *
+ * @param[in] end	of the channel which the caller reads from.
+ * @return
+ *	- true if there are messages in the queue, and the caller MUST NOT sleep.
+ *	- false if the queue is empty, and the caller will be signalled
+ *	  when a new message arrives.
+ */
+static inline bool fr_channel_mark_sleeping(fr_channel_end_t *end)
+{
+	if (atomic_load_explicit(&end->peer_sleeping, memory_order_relaxed)) return false;
+
+	atomic_store(&end->peer_sleeping, true);
+	atomic_thread_fence(memory_order_seq_cst);
+
+	if (fr_atomic_queue_empty(end->aq)) return false;
+
+	/*
+	 *	A message arrived after we last looked.  We're
+	 *	awake, so the writer doesn't need to signal us.
+	 */
+	atomic_store(&end->peer_sleeping, false);
+	return true;
+}
+
 /** Send a request message into the channel
  *
  * The message should be initialized, other than "sequence" and "ack".
@@ -356,34 +411,14 @@ int fr_channel_send_request(fr_channel_t *ch, fr_channel_data_t *cd)
 
 	MPRINT("REQUESTOR requests %"PRIu64", num_outstanding %"PRIu64"\n", requestor->stats.packets, requestor->stats.outstanding);
 
-#if ENABLE_SKIPS
 	/*
-	 *	We just sent the first packet.  There can't possibly be a reply, so don't bother looking.
+	 *	The responder is busy, and will pick up the message
+	 *	when it next polls its queues.
 	 */
-	if (requestor->stats.outstanding == 1) {
-
-		/*
-		 *	There is at least one old packet which is
-		 *	outstanding, look for a reply.
-		 */
-	} else if (requestor->stats.outstanding > 1) {
-		bool has_reply;
-
-		has_reply = fr_channel_recv_reply(ch);
-
-		if (has_reply) while (fr_channel_recv_reply(ch));
-
-		/*
-		 *	There's no reply yet, so we still have packets outstanding.
-		 *	Or, there is a reply, and there are more packets outstanding.
-		 *	Skip the signal.
-		 */
-		if (!requestor->must_signal && (!has_reply || (has_reply && (requestor->stats.outstanding > 1)))) {
-			MPRINT("REQUESTOR SKIPS signal\n");
-			return 0;
-		}
+	if (!fr_channel_must_signal(requestor)) {
+		MPRINT("REQUESTOR SKIPS signal\n");
+		return 0;
 	}
-#endif
 
 	/*
 	 *	Tell the other end that there is new data ready.
@@ -561,48 +596,21 @@ int fr_channel_send_reply(fr_channel_t *ch, fr_channel_data_t *cd)
 	while (fr_channel_recv_request(ch));
 
 	/*
-	 *	No packets outstanding, we HAVE to signal the requestor
-	 *	thread.
+	 *	The requestor is busy, and will pick up the reply
+	 *	when it next polls its queues.
 	 */
-	if (responder->stats.outstanding == 0) {
-		(void) fr_channel_data_ready(ch, when, responder, FR_CHANNEL_SIGNAL_DATA_DONE_RESPONDER);
+	if (!fr_channel_must_signal(responder)) {
+		MPRINT("\tRESPONDER SKIPS signal\n");
 		return 0;
 	}
 
-	MPRINT("\twhen - last_read_other = %"PRIu64" - %"PRIu64" = %"PRIu64"\n", when, responder->stats.last_read_other, when - responder->stats.last_read_other);
-	MPRINT("\twhen - last signal = %"PRIu64" - %"PRIu64" = %"PRIu64"\n", when, responder->stats.last_sent_signal, when - responder->stats.last_sent_signal);
-	MPRINT("\tsequence - ack = %"PRIu64" - %"PRIu64" = %"PRIu64"\n", responder->sequence, responder->their_view_of_my_sequence, responder->sequence - responder->their_view_of_my_sequence);
-
-#ifdef __APPLE__
-	/*
-	 *	If we've sent them a signal since the last ACK, they
-	 *	will receive it, and process the packets.  So we don't
-	 *	need to signal them again.
-	 *
-	 *	But... this doesn't appear to work on the Linux
-	 *	libkqueue implementation.
-	 */
-	if (responder->sequence_at_last_signal > responder->their_view_of_my_sequence) return 0;
-#endif
-
 	/*
-	 *	If we've received a new packet in the last while, OR
-	 *	we've sent a signal in the last while, then we don't
-	 *	need to send a new signal.  But we DO send a signal if
-	 *	we haven't seen an ACK for a few packets.
-	 *
-	 *	FIXME: make these limits configurable, or include
-	 *	predictions about packet processing time?
+	 *	Let the requestor know if we're now idle.
 	 */
-	fr_assert(responder->their_view_of_my_sequence <= responder->sequence);
-#if 0
-	if (((responder->sequence - their_view_of_my_sequence) <= 1000) &&
-	    ((when - responder->stats.last_read_other < SIGNAL_INTERVAL) ||
-	     ((when - responder->stats.last_sent_signal) < SIGNAL_INTERVAL))) {
-		MPRINT("\tRESPONDER SKIPS signal\n");
+	if (responder->stats.outstanding == 0) {
+		(void) fr_channel_data_ready(ch, when, responder, FR_CHANNEL_SIGNAL_DATA_DONE_RESPONDER);
 		return 0;
 	}
-#endif
 
 	MPRINT("\tRESPONDER SIGNALS num_outstanding %"PRIu64"\n", responder->stats.outstanding);
 	(void) fr_channel_data_ready(ch, when, responder, FR_CHANNEL_SIGNAL_DATA_TO_REQUESTOR);
@@ -631,39 +639,45 @@ int fr_channel_null_reply(fr_channel_t *ch)
 
 
 
-/** Signal a channel that the responder is sleeping
+/** Tell a channel that the responder is about to sleep
  *
  * This function should be called from the responders idle loop.
- * i.e. only when it has nothing else to do.
+ * i.e. only when it has nothing else to do.  If it returns true,
+ * the responder MUST drain the channel with fr_channel_recv_request()
+ * instead of sleeping.
  *
- * @param[in] ch	the channel to signal we're no longer listening on.
+ * @param[in] ch	the channel to mark as sleeping.
  * @return
- *	- <0 on error
- *	- 0 on success
+ *	- true if there are requests waiting.
+ *	- false if the responder can sleep, and will be signalled.
  */
-int fr_channel_responder_sleeping(fr_channel_t *ch)
+bool fr_channel_responder_sleeping(fr_channel_t *ch)
 {
-	fr_channel_end_t *responder;
-	fr_channel_control_t cc;
-
-	responder = &(ch->end[TO_REQUESTOR]);
+	if (ch->same_thread) return false;
 
-	/*
-	 *	We don't have any outstanding requests to process for
-	 *	this channel, don't signal the network thread that
-	 *	we're sleeping.  It already knows.
-	 */
-	if (responder->stats.outstanding == 0) return 0;
+	MPRINT("\tRESPONDER SLEEPING num_outstanding %"PRIu64", packets in %"PRIu64", packets out %"PRIu64"\n",
+	       ch->end[TO_REQUESTOR].stats.outstanding,
+	       ch->end[TO_RESPONDER].stats.packets, ch->end[TO_REQUESTOR].stats.packets);
 
-	responder->stats.signals++;
+	return fr_channel_mark_sleeping(&ch->end[TO_RESPONDER]);
+}
 
-	cc.signal = FR_CHANNEL_SIGNAL_RESPONDER_SLEEPING;
-	cc.ack = responder->ack;
-	cc.ch = ch;
+/** Tell a channel that the requestor is about to sleep
+ *
+ * This function should be called from the requestors idle loop.
+ * If it returns true, the requestor MUST drain the channel with
+ * fr_channel_recv_reply() instead of sleeping.
+ *
+ * @param[in] ch	the channel to mark as sleeping.
+ * @return
+ *	- true if there are replies waiting.
+ *	- false if the requestor can sleep, and will be signalled.
+ */
+bool fr_channel_requestor_sleeping(fr_channel_t *ch)
+{
+	if (ch->same_thread) return false;
 
-	MPRINT("\tRESPONDER SLEEPING num_outstanding %"PRIu64", packets in %"PRIu64", packets out %"PRIu64"\n", responder->stats.outstanding,
-	       ch->end[TO_RESPONDER].stats.packets, responder->stats.packets);
-	return fr_control_message_send(responder->control, responder->rb, FR_CONTROL_ID_CHANNEL, &cc, sizeof(cc));
+	return fr_channel_mark_sleeping(&ch->end[TO_REQUESTOR]);
 }
 
 
@@ -680,26 +694,17 @@ int fr_channel_responder_sleeping(fr_channel_t *ch)
  *	- FR_CHANNEL_OPEN when a channel has been opened and sent to us
  *	- FR_CHANNEL_CLOSE when a channel should be closed
  */
-fr_channel_event_t fr_channel_service_message(fr_time_t when, fr_channel_t **p_channel, void const *data, size_t data_size)
+fr_channel_event_t fr_channel_service_message(UNUSED fr_time_t when, fr_channel_t **p_channel,
+					      void const *data, size_t data_size)
 {
-	int rcode;
-#if ENABLE_SKIPS
-	uint64_t ack;
-#endif
 	fr_channel_control_t cc;
 	fr_channel_signal_t cs;
-	fr_channel_event_t ce = FR_CHANNEL_ERROR;
-	fr_channel_end_t *requestor;
-	fr_channel_t *ch;
 
 	fr_assert(data_size == sizeof(cc));
 	memcpy(&cc, data, data_size);
 
 	cs = cc.signal;
-#if ENABLE_SKIPS
-	ack = cc.ack;
-#endif
-	*p_channel = ch = cc.ch;
+	*p_channel = cc.ch;
 
 	switch (cs) {
 	/*
@@ -716,57 +721,23 @@ fr_channel_event_t fr_channel_service_message(fr_time_t when, fr_channel_t **p_c
 		return (fr_channel_event_t) cs;
 
 	/*
-	 *	Only sent by the responder.  Both of these
-	 *	situations are largely the same, except for
-	 *	return codes.
+	 *	Only sent by the responder.  The requestor was
+	 *	sleeping, and there are replies to read.
 	 */
 	case FR_CHANNEL_SIGNAL_DATA_DONE_RESPONDER:
 		MPRINT("channel got data_done_responder\n");
-		ce = FR_CHANNEL_DATA_READY_REQUESTOR;
-		ch->end[TO_RESPONDER].must_signal = true;
-		break;
-
-	case FR_CHANNEL_SIGNAL_RESPONDER_SLEEPING:
-		MPRINT("channel got responder_sleeping\n");
-		ce = FR_CHANNEL_NOOP;
-		ch->end[TO_RESPONDER].must_signal = true;
-		break;
-	}
+		return FR_CHANNEL_DATA_READY_REQUESTOR;
 
 	/*
-	 *	Compare their ACK to the last sequence we
-	 *	sent.  If it's different, we signal the responder
-	 *	to wake up.
+	 *	No longer sent.  Responders mark themselves as
+	 *	sleeping via fr_channel_responder_sleeping().
 	 */
-	requestor = &ch->end[TO_RESPONDER];
-#if ENABLE_SKIPS
-	if (!requestor->must_signal && (ack == requestor->sequence)) {
-		MPRINT("REQUESTOR SKIPS signal AFTER CE %d num_outstanding %"PRIu64"\n", cs, requestor->stats.outstanding);
-		MPRINT("REQUESTOR has ack %"PRIu64", my seq %"PRIu64" my_view %"PRIu64"\n", ack, requestor->sequence, requestor->their_view_of_my_sequence);
-		return ce;
+	case FR_CHANNEL_SIGNAL_RESPONDER_SLEEPING:
+		MPRINT("channel got responder_sleeping\n");
+		return FR_CHANNEL_NOOP;
 	}
 
-	/*
-	 *	The responder is sleeping or done.  There are more
-	 *	packets available, so we signal it to wake up again.
-	 */
-	fr_assert(ack <= requestor->sequence);
-#endif
-
-	/*
-	 *	We're signaling it again...
-	 */
-	requestor->stats.resignals++;
-
-	/*
-	 *	The responder hasn't seen our last few packets.  Signal
-	 *	that there is data ready.
-	 */
-	MPRINT("REQUESTOR SIGNALS AFTER CE %d\n", cs);
-	rcode = fr_channel_data_ready(ch, when, requestor, FR_CHANNEL_SIGNAL_DATA_TO_RESPONDER);
-	if (rcode < 0) return FR_CHANNEL_ERROR;
-
-	return ce;
+	return FR_CHANNEL_ERROR;
 }
 
 
@@ -958,11 +929,32 @@ int fr_channel_signal_open(fr_channel_t *ch)
 	return fr_control_message_send(ch->end[TO_RESPONDER].control, ch->end[TO_RESPONDER].rb, FR_CONTROL_ID_CHANNEL, &cc, sizeof(cc));
 }
 
+/** Get the statistics for the requestor end of a channel
+ *
+ * @param[in] ch	The channel.
+ */
+fr_channel_stats_t const *fr_channel_requestor_stats(fr_channel_t const *ch)
+{
+	return &ch->end[TO_RESPONDER].stats;
+}
+
+/** Get the statistics for the responder end of a channel
+ *
+ * @param[in] ch	The channel.
+ */
+fr_channel_stats_t const *fr_channel_responder_stats(fr_channel_t const *ch)
+{
+	return &ch->end[TO_REQUESTOR].stats;
+}
+
 void fr_channel_stats_log(fr_channel_t const *ch, fr_log_t const *log, char const *file, int line)
 {
 	fr_log(log, L_INFO, file, line, "requestor\n");
 	fr_log(log, L_INFO, file, line, "\tsignals sent = %" PRIu64 "\n", ch->end[TO_RESPONDER].stats.signals);
-	fr_log(log, L_INFO, file, line, "\tsignals re-sent = %" PRIu64 "\n", ch->end[TO_RESPONDER].stats.resignals);
+	fr_log(log, L_INFO, file, line, "\tsignals skipped = %" PRIu64 "\n", ch->end[TO_RESPONDER].stats.skipped);
+	fr_log(log, L_INFO, file, line, "\tsignals per packet = %.3f\n",
+	       ch->end[TO_RESPONDER].stats.packets ?
+	       (double) ch->end[TO_RESPONDER].stats.signals / ch->end[TO_RESPONDER].stats.packets : 0.0);
 	fr_log(log, L_INFO, file, line, "\tkevents checked = %" PRIu64 "\n", ch->end[TO_RESPONDER].stats.kevents);
 	fr_log(log, L_INFO, file, line, "\toutstanding = %" PRIu64 "\n", ch->end[TO_RESPONDER].stats.outstanding);
 	fr_log(log, L_INFO, file, line, "\tpackets processed = %" PRIu64 "\n", ch->end[TO_RESPONDER].stats.packets);
@@ -973,6 +965,10 @@ void fr_channel_stats_log(fr_channel_t const *ch, fr_log_t const *log, char cons
 
 	fr_log(log, L_INFO, file, line, "responder\n");
 	fr_log(log, L_INFO, file, line, "\tsignals sent = %" PRIu64"\n", ch->end[TO_REQUESTOR].stats.signals);
+	fr_log(log, L_INFO, file, line, "\tsignals skipped = %" PRIu64 "\n", ch->end[TO_REQUESTOR].stats.skipped);
+	fr_log(log, L_INFO, file, line, "\tsignals per packet = %.3f\n",
+	       ch->end[TO_REQUESTOR].stats.packets ?
+	       (double) ch->end[TO_REQUESTOR].stats.signals / ch->end[TO_REQUESTOR].stats.packets : 0.0);
 	fr_log(log, L_INFO, file, line, "\tkevents checked = %" PRIu64 "\n", ch->end[TO_REQUESTOR].stats.kevents);
 	fr_log(log, L_INFO, file, line, "\tpackets processed = %" PRIu64 "\n", ch->end[TO_REQUESTOR].stats.packets);
 	fr_log(log, L_INFO, file, line, "\tmessage interval (RTT) = %" PRIu64 "\n", ch->end[TO_REQUESTOR].stats.message_interval);
@@ -0,0 +1,213 @@
+#include <freeradius-devel/util/acutest.h>
+#include <freeradius-devel/io/channel.h>
+#include <freeradius-devel/io/control.h>
+#include <freeradius-devel/util/event.h>
+
+typedef struct {
+	TALLOC_CTX		*ctx;
+	fr_channel_t		*ch;
+	fr_atomic_queue_t	*aq_requestor;		//!< Control-plane queue of the requestor.
+	fr_atomic_queue_t	*aq_responder;		//!< Control-plane queue of the responder.
+
+	int			requests;		//!< Requests seen by the responder.
+	int			replies;		//!< Replies seen by the requestor.
+} test_channel_t;
+
+static void test_recv_request(void *uctx, UNUSED fr_channel_t *ch, UNUSED fr_channel_data_t *cd)
+{
+	test_channel_t *test = uctx;
+
+	test->requests++;
+}
+
+static void test_recv_reply(void *uctx, UNUSED fr_channel_t *ch, UNUSED fr_channel_data_t *cd)
+{
+	test_channel_t *test = uctx;
+
+	test->replies++;
+}
+
+/** Create a channel between two threads, both of which are serviced by the test
+ *
+ */
+static void test_channel_init(test_channel_t *test)
+{
+	fr_event_list_t	*el;
+	fr_control_t	*requestor, *responder;
+
+	memset(test, 0, sizeof(*test));
+
+	test->ctx = talloc_init_const("channel_tests");
+	TEST_CHECK(test->ctx != NULL);
+
+	el = fr_event_list_alloc(test->ctx, NULL, NULL);
+	TEST_CHECK(el != NULL);
+
+	test->aq_requestor = fr_atomic_queue_alloc(test->ctx, FR_CONTROL_MAX_MESSAGES);
+	test->aq_responder = fr_atomic_queue_alloc(test->ctx, FR_CONTROL_MAX_MESSAGES);
+	TEST_CHECK(test->aq_requestor && test->aq_responder);
+
+	requestor = fr_control_create(test->ctx, el, test->aq_requestor);
+	responder = fr_control_create(test->ctx, el, test->aq_responder);
+	TEST_CHECK(requestor && responder);
+
+	test->ch = fr_channel_create(test->ctx, requestor, responder, false);
+	TEST_CHECK(test->ch != NULL);
+	TEST_MSG("%s", fr_strerror());
+
+	TEST_CHECK(fr_channel_set_recv_request(test->ch, test, test_recv_request) == 0);
+	TEST_CHECK(fr_channel_set_recv_reply(test->ch, test, test_recv_reply) == 0);
+}
+
+/** Pop a signal sent by the other end of the channel
+ *
+ * @return
+ *	- FR_CHANNEL_EMPTY if there was no signal.
+ *	- the channel event for the signal.
+ */
+static fr_channel_event_t test_signal_pop(fr_atomic_queue_t *aq)
+{
+	uint32_t	id;
+	uint8_t		data[256];
+	ssize_t		data_size;
+	fr_channel_t	*ch;
+
+	data_size = fr_control_message_pop(aq, &id, data, sizeof(data));
+	if (data_size == 0) return FR_CHANNEL_EMPTY;
+
+	TEST_CHECK(data_size > 0);
+	TEST_CHECK(id == FR_CONTROL_ID_CHANNEL);
+
+	return fr_channel_service_message(fr_time(), &ch, data, data_size);
+}
+
+static void test_send_request(test_channel_t *test, fr_channel_data_t *cd)
+{
+	memset(cd, 0, sizeof(*cd));
+	cd->m.when = fr_time();
+
+	TEST_CHECK(fr_channel_send_request(test->ch, cd) == 0);
+}
+
+static void test_send_reply(test_channel_t *test, fr_channel_data_t *cd)
+{
+	memset(cd, 0, sizeof(*cd));
+	cd->m.when = fr_time();
+
+	TEST_CHECK(fr_channel_send_reply(test->ch, cd) == 0);
+}
+
+static void channel_test_request_signal(void)
+{
+	test_channel_t			test;
+	fr_channel_data_t		cd[3];
+	fr_channel_stats_t const	*stats;
+
+	test_channel_init(&test);
+	stats = fr_channel_requestor_stats(test.ch);
+
+	TEST_CASE("The first request wakes the responder");
+	test_send_request(&test, &cd[0]);
+	TEST_CHECK(stats->signals == 1);
+	TEST_CHECK(test_signal_pop(test.aq_responder) == FR_CHANNEL_DATA_READY_RESPONDER);
+
+	TEST_CASE("Requests sent while the responder is awake are not signalled");
+	test_send_request(&test, &cd[1]);
+	TEST_CHECK(stats->signals == 1);
+	TEST_CHECK(stats->skipped == 1);
+	TEST_CHECK(test_signal_pop(test.aq_responder) == FR_CHANNEL_EMPTY);
+
+	while (fr_channel_recv_request(test.ch));
+	TEST_CHECK(test.requests == 2);
+
+	TEST_CASE("The responder can sleep once it has drained the channel");
+	TEST_CHECK(fr_channel_responder_sleeping(test.ch) == false);
+
+	test_send_request(&test, &cd[2]);
+	TEST_CHECK(stats->signals == 2);
+	TEST_CHECK(stats->skipped == 1);
+	TEST_CHECK(stats->packets == 3);
+	TEST_CHECK(test_signal_pop(test.aq_responder) == FR_CHANNEL_DATA_READY_RESPONDER);
+
+	talloc_free(test.ctx);
+}
+
+static void channel_test_sleep_pending(void)
+{
+	test_channel_t			test;
+	fr_channel_data_t		cd[3];
+	fr_channel_stats_t const	*stats;
+
+	test_channel_init(&test);
+	stats = fr_channel_requestor_stats(test.ch);
+
+	test_send_request(&test, &cd[0]);
+	test_send_request(&test, &cd[1]);
+	TEST_CHECK(test_signal_pop(test.aq_responder) == FR_CHANNEL_DATA_READY_RESPONDER);
+
+	TEST_CASE("The responder can't sleep with requests in the channel");
+	TEST_CHECK(fr_channel_responder_sleeping(test.ch) == true);
+
+	TEST_CASE("The responder stays awake, so isn't signalled");
+	test_send_request(&test, &cd[2]);
+	TEST_CHECK(stats->signals == 1);
+	TEST_CHECK(stats->skipped == 2);
+	TEST_CHECK(test_signal_pop(test.aq_responder) == FR_CHANNEL_EMPTY);
+
+	while (fr_channel_recv_request(test.ch));
+	TEST_CHECK(test.requests == 3);
+
+	talloc_free(test.ctx);
+}
+
+static void channel_test_reply_signal(void)
+{
+	test_channel_t			test;
+	fr_channel_data_t		cd[3], reply[3];
+	fr_channel_stats_t const	*stats;
+
+	test_channel_init(&test);
+	stats = fr_channel_responder_stats(test.ch);
+
+	test_send_request(&test, &cd[0]);
+	while (fr_channel_recv_request(test.ch));
+
+	TEST_CASE("The first reply wakes the requestor");
+	test_send_reply(&test, &reply[0]);
+	TEST_CHECK(stats->signals == 1);
+	TEST_CHECK(test_signal_pop(test.aq_requestor) == FR_CHANNEL_DATA_READY_REQUESTOR);
+
+	test_send_request(&test, &cd[1]);
+	test_send_request(&test, &cd[2]);
+	while (fr_channel_recv_request(test.ch));
+	TEST_CHECK(test.requests == 3);
+
+	TEST_CASE("Replies sent while the requestor is awake are not signalled");
+	test_send_reply(&test, &reply[1]);
+	TEST_CHECK(stats->signals == 1);
+	TEST_CHECK(stats->skipped == 1);
+	TEST_CHECK(test_signal_pop(test.aq_requestor) == FR_CHANNEL_EMPTY);
+
+	while (fr_channel_recv_reply(test.ch));
+	TEST_CHECK(test.replies == 2);
+
+	TEST_CASE("The requestor can sleep once it has drained the channel");
+	TEST_CHECK(fr_channel_requestor_sleeping(test.ch) == false);
+
+	test_send_reply(&test, &reply[2]);
+	TEST_CHECK(stats->signals == 2);
+	TEST_CHECK(stats->skipped == 1);
+	TEST_CHECK(test_signal_pop(test.aq_requestor) == FR_CHANNEL_DATA_READY_REQUESTOR);
+
+	while (fr_channel_recv_reply(test.ch));
+	TEST_CHECK(test.replies == 3);
+
+	talloc_free(test.ctx);
+}
+
+TEST_LIST = {
+	{ "channel_test_request_signal",	channel_test_request_signal	},
+	{ "channel_test_sleep_pending",		channel_test_sleep_pending	},
+	{ "channel_test_reply_signal",		channel_test_reply_signal	},
+	{ NULL }
+};
@@ -41,6 +41,14 @@ struct fr_listen {
 	bool			track_duplicates;	//!< do we track duplicate packets?
 	size_t			default_message_size;	//!< copied from app_io, but may be changed
 	size_t			num_messages;		//!< for the message ring buffer
+	uint32_t		read_batch;		//!< Number of datagrams the app_io may place into
+							///< one read buffer, at default_message_size offsets.
+							///< 0 for one packet per read.
+
+	uint32_t		shard;			//!< Which of the sockets sharing this address we are.
+							///< Also picks the network thread which owns the socket.
+	uint32_t		num_shards;		//!< How many sockets the app_io wants opened on this
+							///< address.  Set by open() for shard 0.
 };
 
 /**
@@ -25,6 +25,7 @@
 RCSID("$Id$")
 
 #include <freeradius-devel/io/load.h>
+#include <freeradius-devel/util/misc.h>
 
 /*
  *	We use *inverse* numbers to avoid numerical calculation issues.
@@ -41,6 +42,22 @@ RCSID("$Id$")
 #define RTTVAR(_rtt, _rttvar, _t) ((((IBETA - 1) * _rttvar) + DIFF(_rtt, _t)) / IBETA)
 #define RTT(_old, _new) ((_new + ((IALPHA - 1) * _old)) / IALPHA)
 
+/*
+ *	Response times are kept in a log-linear histogram, in the style
+ *	of HdrHistogram.  Times below 2^(SUB_BITS + 1) nanoseconds get
+ *	a bucket each.  Above that, each power of two is split into
+ *	2^SUB_BITS buckets, which bounds the error to about 3%.
+ */
+#define LOAD_HIST_SUB_BITS	(5)
+#define LOAD_HIST_HALF		(1 << LOAD_HIST_SUB_BITS)
+#define LOAD_HIST_SIZE		((64 - LOAD_HIST_SUB_BITS + 1) * LOAD_HIST_HALF)
+
+typedef struct {
+	uint64_t		count;			//!< number of samples
+	fr_time_delta_t		max;			//!< largest sample
+	uint32_t		bucket[LOAD_HIST_SIZE];
+} fr_load_hist_t;
+
 typedef enum {
 	FR_LOAD_STATE_INIT = 0,
 	FR_LOAD_STATE_SENDING,
@@ -58,8 +75,16 @@ struct fr_load_s {
 	fr_load_stats_t		stats;			//!< sending statistics
 	fr_time_t		step_start;		//!< when the current step started
 	fr_time_t		step_end;		//!< when the current step will end
+	int			step_sent;
 	int			step_received;
 
+	fr_load_hist_t		hist;			//!< response times for the whole test
+	fr_load_hist_t		step_hist;		//!< response times for the current step
+
+	fr_load_phase_t		*phases;		//!< results of each completed step
+	uint32_t		pass_pps;		//!< highest rate which passed, in search mode
+	uint32_t		fail_pps;		//!< lowest rate which failed, in search mode
+
 	uint32_t		pps;
 	fr_time_delta_t		delta;			//!< between packets
 
@@ -90,6 +115,63 @@ fr_load_t *fr_load_generator_create(TALLOC_CTX *ctx, fr_event_list_t *el, fr_loa
 	return l;
 }
 
+static inline CC_HINT(always_inline) unsigned int load_hist_index(uint64_t t)
+{
+	unsigned int shift;
+
+	if (t < (2 * LOAD_HIST_HALF)) return t;
+
+	shift = fr_high_bit_pos(t) - 1 - LOAD_HIST_SUB_BITS;
+
+	return (shift * LOAD_HIST_HALF) + (t >> shift);
+}
+
+/** Return the largest value which maps to a histogram bucket
+ *
+ */
+static inline CC_HINT(always_inline) fr_time_delta_t load_hist_value(unsigned int idx)
+{
+	unsigned int shift;
+
+	if (idx < (2 * LOAD_HIST_HALF)) return idx;
+
+	shift = (idx / LOAD_HIST_HALF) - 1;
+
+	return ((((uint64_t) (idx - (shift * LOAD_HIST_HALF))) + 1) << shift) - 1;
+}
+
+static void load_hist_add(fr_load_hist_t *hist, fr_time_delta_t t)
+{
+	if (t < 0) t = 0;
+
+	hist->bucket[load_hist_index(t)]++;
+	hist->count++;
+	if (t > hist->max) hist->max = t;
+}
+
+static fr_time_delta_t load_hist_percentile(fr_load_hist_t const *hist, double percentile)
+{
+	uint64_t	target, seen = 0;
+	unsigned int	i;
+
+	if (!hist->count) return 0;
+
+	target = (hist->count * percentile) / 100;
+	if (target < 1) target = 1;
+
+	for (i = 0; i < LOAD_HIST_SIZE; i++) {
+		seen += hist->bucket[i];
+		if (seen >= target) break;
+	}
+
+	/*
+	 *	Don't report more than we've seen.
+	 */
+	if ((i == LOAD_HIST_SIZE) || (load_hist_value(i) > hist->max)) return hist->max;
+
+	return load_hist_value(i);
+}
+
 /** Send one or more packets.
  *
  */
@@ -112,6 +194,99 @@ static void fr_load_generator_send(fr_load_t *l, fr_time_t now, int count)
 	}
 }
 
+/** Record the results of the step which just finished, and pick the rate for the next one
+ *
+ * @return
+ *	- true if the test should continue.
+ *	- false if the test is done.
+ */
+static bool load_step_next(fr_load_t *l, fr_time_t now)
+{
+	fr_load_phase_t	*phase;
+	size_t		num = talloc_array_length(l->phases);
+	fr_time_delta_t	target = ((fr_time_delta_t) l->config->latency_target) * 1000;
+	uint32_t	next;
+
+	phase = talloc_realloc(l, l->phases, fr_load_phase_t, num + 1);
+	if (!phase) return false;
+	l->phases = phase;
+	phase += num;
+
+	*phase = (fr_load_phase_t) {
+		.number = num + 1,
+		.pps = l->pps,
+		.sent = l->stats.sent - l->step_sent,
+		.received = l->stats.received - l->step_received,
+		.p50 = load_hist_percentile(&l->step_hist, 50),
+		.p90 = load_hist_percentile(&l->step_hist, 90),
+		.p99 = load_hist_percentile(&l->step_hist, 99),
+		.p999 = load_hist_percentile(&l->step_hist, 99.9),
+		.max = l->step_hist.max
+	};
+	if (now > l->step_start) phase->pps_accepted = (((uint64_t) phase->received) * NSEC) / (now - l->step_start);
+
+	/*
+	 *	The step passes if replies kept up with at least 95%
+	 *	of the offered rate, and the responses were fast
+	 *	enough.
+	 */
+	phase->passed = (phase->received > 0) && (((uint64_t) phase->pps_accepted * 100) >= ((uint64_t) l->pps * 95)) &&
+			(!target || (phase->p99 <= target));
+
+	memset(&l->step_hist, 0, sizeof(l->step_hist));
+
+	if (l->config->mode != FR_LOAD_MODE_SEARCH) {
+		next = l->pps + l->config->step;
+
+		/*
+		 *	Stop at max PPS, if it's set.  Otherwise
+		 *	continue without limit.
+		 */
+		if (l->config->max_pps && (next > l->config->max_pps)) return false;
+
+		goto done;
+	}
+
+	if (phase->passed) {
+		l->pass_pps = l->pps;
+		l->stats.max_pps = l->pps;
+	} else {
+		l->fail_pps = l->pps;
+	}
+
+	/*
+	 *	Nothing has failed yet, keep doubling the rate.
+	 */
+	if (!l->fail_pps) {
+		if (l->config->max_pps && (l->pps >= l->config->max_pps)) return false;
+
+		next = l->pps * 2;
+		if (l->config->max_pps && (next > l->config->max_pps)) next = l->config->max_pps;
+
+		goto done;
+	}
+
+	/*
+	 *	Bisect until the bounds are close enough.
+	 */
+	if ((l->fail_pps - l->pass_pps) <= l->config->step) return false;
+
+	next = l->pass_pps + ((l->fail_pps - l->pass_pps) / 2);
+	if (!next) return false;
+
+done:
+	l->step_start = l->next;
+	l->step_end = l->next + ((uint64_t) l->config->duration) * NSEC;
+	l->step_sent = l->stats.sent;
+	l->step_received = l->stats.received;
+	l->pps = next;
+	l->stats.pps = l->pps;
+	l->stats.skipped = 0;
+	l->delta = (NSEC * ((uint64_t) l->config->parallel)) / l->pps;
+
+	return true;
+}
+
 static void load_timer(fr_event_list_t *el, fr_time_t now, void *uctx)
 {
 	fr_load_t *l = uctx;
@@ -128,23 +303,9 @@ static void load_timer(fr_event_list_t *el, fr_time_t now, void *uctx)
 	/*
 	 *	If we're done this step, go to the next one.
 	 */
-	if (l->next >= l->step_end) {
-		l->step_start = l->next;
-		l->step_end = l->next + ((uint64_t) l->config->duration) * NSEC;
-		l->step_received = l->stats.received;
-		l->pps += l->config->step;
-		l->stats.pps = l->pps;
-		l->stats.skipped = 0;
-		l->delta = (NSEC * ((uint64_t) l->config->parallel)) / l->pps;
-
-		/*
-		 *	Stop at max PPS, if it's set.  Otherwise
-		 *	continue without limit.
-		 */
-		if (l->config->max_pps && (l->pps > l->config->max_pps)) {
-			l->state = FR_LOAD_STATE_DRAINING;
-			return;
-		}
+	if ((l->next >= l->step_end) && !load_step_next(l, now)) {
+		l->state = FR_LOAD_STATE_DRAINING;
+		return;
 	}
 
 	/*
@@ -218,6 +379,11 @@ int fr_load_generator_start(fr_load_t *l)
 	l->stats.start = fr_time();
 	l->step_start = l->stats.start;
 	l->step_end = l->step_start + ((uint64_t) l->config->duration) * NSEC;
+	l->step_sent = l->stats.sent;
+	l->step_received = l->stats.received;
+
+	l->pass_pps = l->fail_pps = 0;
+	memset(&l->step_hist, 0, sizeof(l->step_hist));
 
 	l->pps = l->config->start_pps;
 	l->stats.pps = l->pps;
@@ -264,6 +430,9 @@ fr_load_reply_t fr_load_generator_have_reply(fr_load_t *l, fr_time_t request_tim
 
 	l->stats.received++;
 
+	load_hist_add(&l->hist, t);
+	load_hist_add(&l->step_hist, t);
+
 	/*
 	 *	t is in nanoseconds.
 	 */
@@ -330,7 +499,7 @@ size_t fr_load_generator_stats_sprint(fr_load_t *l, fr_time_t now, char *buffer,
 
 	if (!l->header) {
 		l->header = true;
-		return snprintf(buffer, buflen, "\"time\",\"last_packet\",\"rtt\",\"rttvar\",\"pps\",\"pps_accepted\",\"sent\",\"received\",\"backlog\",\"max_backlog\",\"<usec\",\"us\",\"10us\",\"100us\",\"ms\",\"10ms\",\"100ms\",\"s\",\"blocked\"\n");
+		return snprintf(buffer, buflen, "\"time\",\"last_packet\",\"rtt\",\"rttvar\",\"pps\",\"pps_accepted\",\"sent\",\"received\",\"backlog\",\"max_backlog\",\"<usec\",\"us\",\"10us\",\"100us\",\"ms\",\"10ms\",\"100ms\",\"s\",\"blocked\",\"p50\",\"p90\",\"p99\",\"p99.9\",\"max\"\n");
 	}
 
 
@@ -357,7 +526,8 @@ size_t fr_load_generator_stats_sprint(fr_load_t *l, fr_time_t now, char *buffer,
 			"%d,%d,"
 			"%d,%d,"
 			"%d,%d,%d,%d,%d,%d,%d,%d,"
-			"%d\n",
+			"%d,"
+			"%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 "\n",
 			now_f, last_send_f,
 			l->stats.rtt, l->stats.rttvar,
 			l->stats.pps, l->stats.pps_accepted,
@@ -365,10 +535,81 @@ size_t fr_load_generator_stats_sprint(fr_load_t *l, fr_time_t now, char *buffer,
 			l->stats.backlog, l->stats.max_backlog,
 			l->stats.times[0], l->stats.times[1], l->stats.times[2], l->stats.times[3],
 			l->stats.times[4], l->stats.times[5], l->stats.times[6], l->stats.times[7],
-			l->stats.blocked);
+			l->stats.blocked,
+			load_hist_percentile(&l->step_hist, 50), load_hist_percentile(&l->step_hist, 90),
+			load_hist_percentile(&l->step_hist, 99), load_hist_percentile(&l->step_hist, 99.9),
+			l->step_hist.max);
 }
 
 fr_load_stats_t const * fr_load_generator_stats(fr_load_t const *l)
 {
 	return &l->stats;
 }
+
+/** Return a response time percentile for the whole test
+ *
+ * @param[in] l			the load generator.
+ * @param[in] percentile	to return, e.g. 99.9.
+ * @return the response time, or 0 if no replies have been received.
+ */
+fr_time_delta_t fr_load_generator_percentile(fr_load_t const *l, double percentile)
+{
+	return load_hist_percentile(&l->hist, percentile);
+}
+
+/** Return the results of each completed step
+ *
+ * @param[in] l		the load generator.
+ * @param[out] num	the number of steps completed.
+ * @return an array of step results, or NULL if no steps have completed.
+ */
+fr_load_phase_t const *fr_load_generator_phases(fr_load_t const *l, size_t *num)
+{
+	*num = talloc_array_length(l->phases);
+
+	return l->phases;
+}
+
+/** Print the results of one step as CSV or JSON
+ *
+ * Response times are printed in microseconds.
+ *
+ * @param[in] phase	to print.
+ * @param[in] format	to print the results in.
+ * @param[in] header	for CSV, print the column names before the results.
+ * @param[out] buffer	to print to.
+ * @param[in] buflen	size of the buffer.
+ * @return the number of bytes printed.
+ */
+size_t fr_load_generator_phase_sprint(fr_load_phase_t const *phase, fr_load_report_t format, bool header,
+				      char *buffer, size_t buflen)
+{
+	size_t len = 0;
+
+	switch (format) {
+	case FR_LOAD_REPORT_CSV:
+		if (header) {
+			len = snprintf(buffer, buflen, "\"step\",\"pps\",\"pps_accepted\",\"sent\",\"received\","
+				       "\"p50\",\"p90\",\"p99\",\"p99.9\",\"max\",\"passed\"\n");
+			if (len >= buflen) return len;
+		}
+
+		return len + snprintf(buffer + len, buflen - len,
+				      "%u,%u,%u,%d,%d,"
+				      "%.1f,%.1f,%.1f,%.1f,%.1f,%d\n",
+				      phase->number, phase->pps, phase->pps_accepted, phase->sent, phase->received,
+				      phase->p50 / 1000.0, phase->p90 / 1000.0, phase->p99 / 1000.0,
+				      phase->p999 / 1000.0, phase->max / 1000.0, phase->passed);
+
+	case FR_LOAD_REPORT_JSON:
+		return snprintf(buffer, buflen,
+				"{\"step\":%u,\"pps\":%u,\"pps_accepted\":%u,\"sent\":%d,\"received\":%d,"
+				"\"p50_usec\":%.1f,\"p90_usec\":%.1f,\"p99_usec\":%.1f,\"p999_usec\":%.1f,"
+				"\"max_usec\":%.1f,\"passed\":%s}\n",
+				phase->number, phase->pps, phase->pps_accepted, phase->sent, phase->received,
+				phase->p50 / 1000.0, phase->p90 / 1000.0, phase->p99 / 1000.0,
+				phase->p999 / 1000.0, phase->max / 1000.0, phase->passed ? "true" : "false");
+	}
+
+	return 0;
+}
@@ -68,6 +68,13 @@ RCSIDH(load_h, "$Id$")
  *  "duration" seconds, even if the maximum backlog is currently
  *  reached.  This increase has the effect of also increasing the
  *  maximum backlog.
+ *
+ *  In "search" mode, the generator instead looks for the highest
+ *  packet rate where the 99th percentile of the response times is
+ *  within "latency_target" microseconds.  The rate is doubled until
+ *  a step fails to meet the target, and then bisected between the
+ *  best passing and worst failing rates until they are within "step"
+ *  packets/s of each other.
  */
 typedef struct {
 	uint32_t       	start_pps;	//!< start PPS
@@ -76,8 +83,45 @@ typedef struct {
 	uint32_t	step;		//!< how much to increase each load test by
 	uint32_t	parallel;	//!< how many packets in parallel to send
 	uint32_t	milliseconds;	//!< how many milliseconds of backlog to top out at
+	uint32_t	mode;		//!< One of #fr_load_mode_t.
+	uint32_t	latency_target;	//!< p99 response time in microseconds, 0 for "no target".
 } fr_load_config_t;
 
+/** How the load generator picks the packet rate for each step
+ *
+ */
+typedef enum {
+	FR_LOAD_MODE_STEP = 0,		//!< increase linearly by "step" until "max_pps".
+	FR_LOAD_MODE_SEARCH		//!< search for the highest rate meeting "latency_target".
+} fr_load_mode_t;
+
+/** Results for one step of the load test
+ *
+ *  Response times are taken from a log-linear histogram, and are
+ *  accurate to within about 3%.
+ */
+typedef struct {
+	uint32_t	number;		//!< step number, starting at 1
+	uint32_t	pps;		//!< offered packets/s
+	uint32_t	pps_accepted;	//!< replies/s received during the step
+	int		sent;		//!< packets sent during the step
+	int		received;	//!< replies received during the step
+	fr_time_delta_t	p50;		//!< median response time
+	fr_time_delta_t	p90;		//!< 90th percentile response time
+	fr_time_delta_t	p99;		//!< 99th percentile response time
+	fr_time_delta_t	p999;		//!< 99.9th percentile response time
+	fr_time_delta_t	max;		//!< slowest response
+	bool		passed;		//!< kept up with the offered rate, and met the latency target
+} fr_load_phase_t;
+
+/** Output formats for per-step reports
+ *
+ */
+typedef enum {
+	FR_LOAD_REPORT_CSV = 0,		//!< one line per step, after a header line.
+	FR_LOAD_REPORT_JSON		//!< one object per step, one per line.
+} fr_load_report_t;
+
 typedef struct {
 	fr_time_t	start;		//! when the test started
 	fr_time_t	end;		//!< when the test ended, due to last reply received
@@ -93,6 +137,7 @@ typedef struct {
 	int		max_backlog;	//!< maximum backlog we saw during the test
 	bool		blocked;	//!< whether or not we're blocked
 	int		times[8];	//!< response time in microseconds to tens of seconds
+	uint32_t	max_pps;	//!< highest rate which passed, in search mode
 } fr_load_stats_t;
 
 typedef struct fr_load_s fr_load_t;
@@ -120,3 +165,10 @@ fr_load_reply_t fr_load_generator_have_reply(fr_load_t *l, fr_time_t request_tim
 size_t fr_load_generator_stats_sprint(fr_load_t *l, fr_time_t now, char *buffer, size_t buflen);
 
 fr_load_stats_t const * fr_load_generator_stats(fr_load_t const *l) CC_HINT(nonnull);
+
+fr_time_delta_t fr_load_generator_percentile(fr_load_t const *l, double percentile) CC_HINT(nonnull);
+
+fr_load_phase_t const *fr_load_generator_phases(fr_load_t const *l, size_t *num) CC_HINT(nonnull);
+
+size_t fr_load_generator_phase_sprint(fr_load_phase_t const *phase, fr_load_report_t format, bool header,
+				      char *buffer, size_t buflen) CC_HINT(nonnull);
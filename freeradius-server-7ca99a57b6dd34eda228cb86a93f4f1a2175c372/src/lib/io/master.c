@@ -397,6 +397,7 @@ static RADCLIENT *radclient_clone(TALLOC_CTX *ctx, RADCLIENT const *parent)
 	DUP_FIELD(nas_type);
 	DUP_FIELD(server);
 	DUP_FIELD(nas_type);
+	client_secret_md5_init(c);
 
 	COPY_FIELD(message_authenticator);
 	/* dynamic MUST be false */
@@ -850,6 +851,7 @@ static RADCLIENT *radclient_alloc(TALLOC_CTX *ctx, int ipproto, fr_io_address_t
 	radclient->longname = radclient->shortname = fr_value_box_asprint(radclient, fr_box_ipaddr(address->src_ipaddr), '\0');
 
 	radclient->secret = radclient->nas_type = talloc_strdup(radclient, "");
+	client_secret_md5_init(radclient);
 
 	radclient->ipaddr = address->src_ipaddr;
 
@@ -1777,6 +1779,7 @@ static int mod_open(fr_listen_t *li)
 	if (inst->app_io->open(thread->child) < 0) return -1;
 
 	li->fd = thread->child->fd;	/* copy this back up */
+	li->read_batch = thread->child->read_batch;
 
 	/*
 	 *	Set the name of the socket.
@@ -2341,6 +2344,7 @@ static ssize_t mod_write(fr_listen_t *li, void *packet_ctx, fr_time_t request_ti
 	DUP_FIELD(shortname);
 	DUP_FIELD(secret);
 	DUP_FIELD(nas_type);
+	client_secret_md5_init(client->radclient);
 
 	COPY_FIELD(ipaddr);
 	COPY_FIELD(message_authenticator);
@@ -2472,6 +2476,22 @@ reread:
 	return buffer_len;
 }
 
+/** Send any writes which the child has queued.
+ *
+ */
+static int mod_flush(fr_listen_t *li)
+{
+	fr_io_instance_t const *inst;
+	fr_io_connection_t *connection;
+	fr_listen_t *child;
+
+	get_inst(li, &inst, NULL, &connection, &child);
+
+	if (!inst->app_io->flush) return 0;
+
+	return inst->app_io->flush(child);
+}
+
 /** Close the socket.
  *
  */
@@ -2838,25 +2858,34 @@ int fr_io_listen_free(fr_listen_t *li)
 	return 0;
 }
 
-int fr_master_io_listen(TALLOC_CTX *ctx, fr_io_instance_t *inst, fr_schedule_t *sc,
-			size_t default_message_size, size_t num_messages)
+/** Open one socket for a listener, and add it to the scheduler
+ *
+ *  Each socket gets its own fr_io_thread_t, and therefore its own
+ *  clients, dynamic clients, and duplicate detection.  That is fine
+ *  for sockets which share an address, because the kernel sends all
+ *  packets with the same source and destination IP / port to the
+ *  same socket (see fr_socket_server_steer()).  Retransmissions
+ *  therefore always arrive at the socket which saw the original
+ *  packet, and track_cmp() uses the full address as part of the key.
+ *
+ * @param[in] ctx		to allocate the listener in.
+ * @param[in] inst		of the master IO handler.
+ * @param[in] sc		scheduler to add the listener to.
+ * @param[in] default_message_size	for the ring buffer.
+ * @param[in] num_messages	for the ring buffer.
+ * @param[in] shard		which socket this is.
+ * @param[in,out] num_shards	how many sockets the app_io wants.  Set from shard 0.
+ * @return
+ *	- 0 on success.
+ *	- -1 on failure.
+ */
+static int master_io_listen_shard(TALLOC_CTX *ctx, fr_io_instance_t *inst, fr_schedule_t *sc,
+				  size_t default_message_size, size_t num_messages,
+				  uint32_t shard, uint32_t *num_shards)
 {
 	fr_listen_t	*li, *child;
 	fr_io_thread_t	*thread;
 
-	/*
-	 *	No IO paths, so we don't initialize them.
-	 */
-	if (!inst->app_io) {
-		fr_assert(!inst->dynamic_clients);
-		return 0;
-	}
-
-	if (!inst->app_io->thread_inst_size) {
-		fr_strerror_printf("IO modules MUST set 'thread_inst_size' when using the master IO handler.");
-		return -1;
-	}
-
 	/*
 	 *	Build the #fr_listen_t.  This describes the complete
 	 *	path data takes from the socket to the decoder and
@@ -2887,6 +2916,9 @@ int fr_master_io_listen(TALLOC_CTX *ctx, fr_io_instance_t *inst, fr_schedule_t *
 	li->default_message_size = default_message_size;
 	li->num_messages = num_messages;
 
+	li->shard = shard;
+	li->num_shards = *num_shards;
+
 	/*
 	 *	Per-socket data lives here.
 	 */
@@ -2962,6 +2994,12 @@ int fr_master_io_listen(TALLOC_CTX *ctx, fr_io_instance_t *inst, fr_schedule_t *
 	}
 
 	li->fd = child->fd;	/* copy this back up */
+	li->read_batch = child->read_batch;
+
+	if (shard == 0) {
+		if (child->num_shards < 1) child->num_shards = 1;
+		*num_shards = li->num_shards = child->num_shards;
+	}
 
 	if (!child->app_io->get_name) {
 		child->name = child->app_io->name;
@@ -2971,9 +3009,10 @@ int fr_master_io_listen(TALLOC_CTX *ctx, fr_io_instance_t *inst, fr_schedule_t *
 	li->name = child->name;
 
 	/*
-	 *	Record which socket we opened.
+	 *	Record which socket we opened.  The other shards
+	 *	share the address on purpose.
 	 */
-	if (child->app_io_addr) {
+	if (child->app_io_addr && (shard == 0)) {
 		fr_listen_t *other;
 
 		other = listen_find_any(thread->child);
@@ -3002,6 +3041,38 @@ int fr_master_io_listen(TALLOC_CTX *ctx, fr_io_instance_t *inst, fr_schedule_t *
 	return 0;
 }
 
+int fr_master_io_listen(TALLOC_CTX *ctx, fr_io_instance_t *inst, fr_schedule_t *sc,
+			size_t default_message_size, size_t num_messages)
+{
+	uint32_t	i, num_shards = 0;
+
+	/*
+	 *	No IO paths, so we don't initialize them.
+	 */
+	if (!inst->app_io) {
+		fr_assert(!inst->dynamic_clients);
+		return 0;
+	}
+
+	if (!inst->app_io->thread_inst_size) {
+		fr_strerror_printf("IO modules MUST set 'thread_inst_size' when using the master IO handler.");
+		return -1;
+	}
+
+	/*
+	 *	The first socket tells us how many sockets the app_io
+	 *	wants on this address.  Each one may end up in a
+	 *	different network thread.
+	 */
+	for (i = 0; (i == 0) || (i < num_shards); i++) {
+		if (master_io_listen_shard(ctx, inst, sc, default_message_size, num_messages, i, &num_shards) < 0) {
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
 
 fr_app_io_t fr_master_app_io = {
 	.magic			= RLM_MODULE_INIT,
@@ -3016,6 +3087,7 @@ fr_app_io_t fr_master_app_io = {
 	.read			= mod_read,
 	.write			= mod_write,
 	.inject			= mod_inject,
+	.flush			= mod_flush,
 
 	.open			= mod_open,
 	.close			= mod_close,
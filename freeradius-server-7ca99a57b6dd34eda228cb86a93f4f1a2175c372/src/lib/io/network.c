@@ -67,11 +67,26 @@ typedef struct {
 
 	bool			blocked;		//!< is this worker blocked?
 
+	fr_time_elapsed_t	processing;		//!< histogram of measured processing time per packet
+	uint32_t		samples;		//!< replies since the estimate was last recalculated
+	fr_time_delta_t		estimate;		//!< expected processing time, derived from the histogram
+
 	fr_channel_t		*channel;		//!< channel to the worker
 	fr_worker_t		*worker;		//!< worker pointer
 	fr_io_stats_t		stats;
 } fr_network_worker_t;
 
+/** Statistics for worker selection
+ *
+ */
+typedef struct {
+	uint64_t		first;			//!< sent to the first choice worker
+	uint64_t		spilled;		//!< sent to another worker after the first choice was full
+	uint64_t		full;			//!< times a chosen worker was at max_outstanding
+	uint64_t		blocked;		//!< times a chosen worker refused the message
+	uint64_t		dropped;		//!< no worker could take the packet
+} fr_network_dispatch_stats_t;
+
 typedef struct {
 	fr_network_t		*nr;			//!< O(N) issues in talloc
 	int			number;			//!< unique ID
@@ -91,6 +106,7 @@ typedef struct {
 
 	fr_channel_data_t	*pending;		//!< the currently pending partial packet
 	fr_heap_t		*waiting;		//!< packets waiting to be written
+	fr_dlist_t		flush_entry;		//!< in the list of sockets with writes to flush
 	fr_io_stats_t		stats;
 } fr_network_socket_t;
 
@@ -125,8 +141,10 @@ struct fr_network_s {
 	fr_event_list_t		*el;			//!< our event list
 
 	fr_heap_t		*replies;		//!< replies from the worker, ordered by priority / origin time
+	fr_dlist_head_t		flush;			//!< sockets which may have queued writes
 
 	fr_io_stats_t		stats;
+	fr_network_dispatch_stats_t dispatch;		//!< how workers were selected
 
 	rbtree_t		*sockets;		//!< list of sockets we're managing, ordered by the listener
 	rbtree_t		*sockets_by_num;       	//!< ordered by number;
@@ -184,6 +202,28 @@ static int socket_num_cmp(void const *one, void const *two)
 	return (a->number > b->number) - (a->number < b->number);
 }
 
+/** How much ring buffer to reserve for one read
+ *
+ *  Batched datagram reads place each packet at a multiple of
+ *  default_message_size, so we reserve room for the whole batch.
+ */
+static inline size_t network_read_size(fr_network_socket_t const *s)
+{
+	if (s->listen->read_batch <= 1) return s->listen->default_message_size;
+
+	return s->listen->default_message_size * s->listen->read_batch;
+}
+
+/** Remember that we've written to a socket which queues writes
+ *
+ */
+static inline void network_flush_mark(fr_network_t *nr, fr_network_socket_t *s)
+{
+	if (!s->listen->app_io->flush || fr_dlist_entry_in_list(&s->flush_entry)) return;
+
+	fr_dlist_insert_tail(&nr->flush, s);
+}
+
 /*
  *	Explicitly cleanup the memory allocated to the ring buffer,
  *	just in case valgrind complains about it.
@@ -422,6 +462,40 @@ static void fr_network_unsuspend(fr_network_t *nr)
 #define IALPHA (8)
 #define RTT(_old, _new) ((_new + ((IALPHA - 1) * _old)) / IALPHA)
 
+/*
+ *	Recalculate the processing time estimate after this many
+ *	replies.  The histogram is then halved, so that old samples
+ *	decay, and the estimate follows changes in the workload.
+ */
+#define ESTIMATE_INTERVAL (64)
+
+/** Update the expected processing time for a worker from its histogram
+ *
+ *  Each bucket of the histogram covers one decade, from "< 1us" to
+ *  ">= 10s".  We take the geometric midpoint of each bucket, and
+ *  calculate the weighted mean.
+ */
+static void worker_estimate_update(fr_network_worker_t *worker)
+{
+	int		i;
+	uint64_t	total = 0;
+	uint64_t	sum = 0;
+	uint64_t	mid = 300;	/* ~sqrt(100 * 1000) ns */
+
+	for (i = 0; i < 8; i++) {
+		total += worker->processing.array[i];
+		sum += worker->processing.array[i] * mid;
+		mid *= 10;
+
+		worker->processing.array[i] >>= 1;
+	}
+
+	if (!total) return;
+
+	worker->estimate = sum / total;
+	if (!worker->estimate) worker->estimate = 1;
+}
+
 /** Callback which handles a message being received on the network side.
  *
  * @param[in] ctx the network
@@ -447,6 +521,12 @@ static void fr_network_recv_reply(void *ctx, fr_channel_t *ch, fr_channel_data_t
 		worker->predicted = RTT(worker->predicted, cd->reply.processing_time);
 	}
 
+	fr_time_elapsed_update(&worker->processing, 0, cd->reply.processing_time);
+	if (!worker->estimate || (++worker->samples >= ESTIMATE_INTERVAL)) {
+		worker->samples = 0;
+		worker_estimate_update(worker);
+	}
+
 	/*
 	 *	Unblock the worker.
 	 */
@@ -525,9 +605,13 @@ static void fr_network_channel_callback(void *ctx, void const *data, size_t data
 				if (i == (nr->num_workers - 1)) break;
 
 				/*
-				 *	Close the hole...
+				 *	Close the hole...  The worker
+				 *	selection code relies on the
+				 *	array being dense.
 				 */
-				memcpy(&nr->workers[i], &nr->workers[i + 1], ((nr->num_workers - i) - 1));
+				memmove(&nr->workers[i], &nr->workers[i + 1],
+					sizeof(nr->workers[0]) * ((nr->num_workers - i) - 1));
+				nr->workers[nr->num_workers - 1] = NULL;
 				break;
 			}
 		}
@@ -537,6 +621,155 @@ static void fr_network_channel_callback(void *ctx, void const *data, size_t data
 	}
 }
 
+#define WORKER_OUTSTANDING(_w) ((_w)->stats.in - (_w)->stats.out)
+
+/** Whether a worker has reached max_outstanding
+ *
+ */
+static inline bool worker_full(fr_network_t const *nr, fr_network_worker_t const *worker)
+{
+	fr_assert(worker->stats.in >= worker->stats.out);
+
+	return (nr->config.max_outstanding &&
+		(WORKER_OUTSTANDING(worker) >= nr->config.max_outstanding));
+}
+
+/** The expected time for a worker to drain its queue, plus one more packet
+ *
+ *  Workers which haven't replied yet have no estimate, and are
+ *  treated as being as cheap as possible.
+ */
+static inline uint64_t worker_load(fr_network_worker_t const *worker)
+{
+	return (WORKER_OUTSTANDING(worker) + 1) * (worker->estimate ? worker->estimate : 1);
+}
+
+/** Find the least loaded worker which we haven't tried yet
+ *
+ * @param[in] nr	the network
+ * @param[in] tried	bitmap of worker indexes to skip
+ * @return
+ *	- <0 if there are no more workers to try.
+ *	- the index of the worker.
+ */
+static int worker_least_loaded(fr_network_t *nr, uint64_t tried)
+{
+	int		i, found = -1;
+	uint64_t	load = UINT64_MAX;
+
+	for (i = 0; i < nr->num_workers; i++) {
+		fr_network_worker_t *worker = nr->workers[i];
+
+		if ((tried & (((uint64_t) 1) << i)) != 0) continue;
+		if (worker->blocked || worker_full(nr, worker)) continue;
+
+		if (worker_load(worker) < load) {
+			load = worker_load(worker);
+			found = i;
+		}
+	}
+
+	return found;
+}
+
+/** Send a message to the worker with the shortest expected queue
+ *
+ *  Pick two workers at random, and choose the one which has the
+ *  least outstanding work, as measured by the number of outstanding
+ *  packets multiplied by the expected processing time.  If that
+ *  worker is full or blocked, spill the packet over to the least
+ *  loaded worker which can still take it.  We only drop the packet
+ *  when there are no more workers to try.
+ *
+ *  Unlike fr_network_send_request(), the caller is responsible for
+ *  freeing the message on failure.
+ *
+ * @param nr the network
+ * @param cd the message we've received
+ * @return
+ *	- <0 if the packet was dropped.
+ *	- 0 on success.
+ */
+static int fr_network_send_request_queue_depth(fr_network_t *nr, fr_channel_data_t *cd)
+{
+	int			i;
+	uint32_t		attempts = 0;
+	uint64_t		tried = 0;
+	fr_network_worker_t	*worker;
+
+	if (nr->num_workers == 0) {
+		nr->dispatch.dropped++;
+		return -1;
+	}
+
+	/*
+	 *	Power of two choices, but only if we have more than
+	 *	one worker.
+	 */
+	i = fr_rand() % nr->num_workers;
+	if (nr->num_workers > 1) {
+		int two;
+
+		do {
+			two = fr_rand() % nr->num_workers;
+		} while (two == i);
+
+		if (nr->workers[i]->blocked ||
+		    (!nr->workers[two]->blocked && (worker_load(nr->workers[two]) < worker_load(nr->workers[i])))) {
+			i = two;
+		}
+	}
+
+	while (i >= 0) {
+		worker = talloc_get_type_abort(nr->workers[i], fr_network_worker_t);
+		tried |= ((uint64_t) 1) << i;
+
+		if (worker->blocked) goto next;
+
+		if (worker_full(nr, worker)) {
+			nr->dispatch.full++;
+			goto next;
+		}
+
+		if (fr_channel_send_request(worker->channel, cd) < 0) {
+			nr->dispatch.blocked++;
+			worker->stats.dropped++;
+			worker->blocked = true;
+			nr->num_blocked++;
+
+			RATE_LIMIT_GLOBAL(PERROR, "Failed sending packet to worker - %u/%u workers are blocked",
+					  nr->num_blocked, nr->num_workers);
+
+			if (nr->num_blocked == nr->num_workers) {
+				fr_network_suspend(nr);
+				break;
+			}
+			goto next;
+		}
+
+		if (attempts == 0) {
+			nr->dispatch.first++;
+		} else {
+			nr->dispatch.spilled++;
+		}
+
+		worker->stats.in++;
+		worker->cpu_time += worker->predicted;
+		return 0;
+
+	next:
+		if (nr->config.max_spill && (attempts >= nr->config.max_spill)) break;
+		attempts++;
+
+		i = worker_least_loaded(nr, tried);
+	}
+
+	nr->dispatch.dropped++;
+	RATE_LIMIT_GLOBAL(ERROR, "Failed sending packet to worker - all %u worker(s) are full or blocked",
+			  nr->num_workers);
+	return -1;
+}
+
 /** Send a message on the "best" channel.
  *
  * @param nr the network
@@ -548,6 +781,8 @@ static int fr_network_send_request(fr_network_t *nr, fr_channel_data_t *cd)
 
 	(void) talloc_get_type_abort(nr, fr_network_t);
 
+	if (nr->config.dispatch == FR_NETWORK_DISPATCH_QUEUE_DEPTH) return fr_network_send_request_queue_depth(nr, cd);
+
 retry:
 	if (nr->num_workers == 1) {
 		worker = nr->workers[0];
@@ -706,10 +941,10 @@ static void fr_network_read(UNUSED fr_event_list_t *el, int sockfd, UNUSED int f
 	DEBUG3("Reading data from FD %u", sockfd);
 
 	if (!s->cd) {
-		cd = (fr_channel_data_t *) fr_message_reserve(s->ms, s->listen->default_message_size);
+		cd = (fr_channel_data_t *) fr_message_reserve(s->ms, network_read_size(s));
 		if (!cd) {
 			ERROR("Failed allocating message size %zd! - Closing socket",
-			      s->listen->default_message_size);
+			      network_read_size(s));
 			fr_network_socket_dead(nr, s);
 			return;
 		}
@@ -723,8 +958,12 @@ next_message:
 	/*
 	 *	Poll this socket, but not too often.  We have to go
 	 *	service other sockets, too.
+	 *
+	 *	The rest of a batch of datagrams is already in our
+	 *	buffer, and the socket won't tell us about it again.
+	 *	So we finish the batch before leaving.
 	 */
-	if (num_messages > 16) {
+	if ((num_messages > 16) && !(s->listen->read_batch && s->leftover)) {
 		s->cd = cd;
 		return;
 	}
@@ -745,6 +984,29 @@ next_message:
 	data_size = s->listen->app_io->read(s->listen, &cd->packet_ctx, &cd->request.recv_time,
 					    cd->m.data, cd->m.rb_size, &s->leftover, &cd->priority, &cd->request.is_dup);
 	if (data_size == 0) {
+		/*
+		 *	The packet at the start of a batch was
+		 *	discarded.  Skip its slot, and go read the
+		 *	next one.
+		 */
+		if (s->listen->read_batch && s->leftover) {
+			next = (fr_channel_data_t *) fr_message_alloc_reserve(s->ms, &cd->m,
+									      s->listen->default_message_size,
+									      s->leftover, s->leftover);
+			fr_message_done(&cd->m);
+			if (!next) {
+				PERROR("Failed reserving batched packets - Closing socket");
+				s->leftover = 0;
+				fr_network_socket_dead(nr, s);
+				return;
+			}
+
+			cd = next;
+			num_messages++;
+			goto next_message;
+		}
+
+
 		/*
 		 *	Cache the message for later.  This is
 		 *	important for stream sockets, which can do
@@ -801,6 +1063,34 @@ next_message:
 		(void) fr_message_alloc(s->ms, &cd->m, data_size);
 		next = NULL;
 
+	} else if (s->listen->read_batch) {
+		/*
+		 *	The rest of the batch follows this packet's
+		 *	slot.  Allocate the whole slot, so that the
+		 *	next packet is at the start of the next
+		 *	message, and then trim this message to the
+		 *	actual packet.
+		 *
+		 *	Only the rest of the batch is reserved.  It's
+		 *	already inside the original reservation, so
+		 *	the reservation is always extended in place,
+		 *	and the packets are never copied, even when
+		 *	the ring buffer wraps.  Once the batch is
+		 *	done, a new full size reservation is made.
+		 */
+		next = (fr_channel_data_t *) fr_message_alloc_reserve(s->ms, &cd->m,
+								      s->leftover ? s->listen->default_message_size : (size_t) data_size,
+								      s->leftover,
+								      s->leftover ? s->leftover : network_read_size(s));
+		if (!next) {
+			PERROR("Failed reserving batched packets - Closing socket");
+			fr_message_done(&cd->m);
+			s->leftover = 0;
+			fr_network_socket_dead(nr, s);
+			return;
+		}
+		cd->m.data_size = data_size;
+
 	} else {
 		/*
 		 *	There are leftover bytes in the buffer, feed
@@ -910,8 +1200,6 @@ static void fr_network_write(UNUSED fr_event_list_t *el, UNUSED int sockfd, UNUS
 
 	(void) talloc_get_type_abort(nr, fr_network_t);
 
-	fr_assert(s->pending != NULL);
-
 	/*
 	 *	@todo - this code is much the same as in
 	 *	fr_network_post_event().  Fix it so we only have one
@@ -995,6 +1283,17 @@ static void fr_network_write(UNUSED fr_event_list_t *el, UNUSED int sockfd, UNUS
 		cd = fr_heap_pop(s->waiting);
 	}
 
+	/*
+	 *	Send the writes which the socket queued.  If they
+	 *	still don't all fit, keep the write callback, and
+	 *	finish them when the socket is writable again.
+	 */
+	if (li->app_io->flush && (li->app_io->flush(li) < 0)) {
+		if (errno == EWOULDBLOCK) return;
+
+		RATE_LIMIT_GLOBAL(PERROR, "Failed flushing writes to socket %d", li->fd);
+	}
+
 	/*
 	 *	We've successfully written all of the packets.  Remove
 	 *	the write callback.
@@ -1017,6 +1316,8 @@ static int _network_socket_free(fr_network_socket_t *s)
 	rbtree_deletebydata(nr->sockets, s);
 	rbtree_deletebydata(nr->sockets_by_num, s);
 
+	if (fr_dlist_entry_in_list(&s->flush_entry)) fr_dlist_remove(&nr->flush, s);
+
 	fr_event_fd_delete(nr->el, s->listen->fd, s->filter);
 
 	if (s->listen->app_io->close) {
@@ -1081,6 +1382,7 @@ static void fr_network_listen_callback(void *ctx, void const *data, size_t data_
 	if (num_messages < 8) num_messages = 8;
 
 	size = s->listen->default_message_size * num_messages;
+	if (size < (network_read_size(s) * 4)) size = network_read_size(s) * 4;
 	if (size < (1 << 17)) size = (1 << 17);
 	if (size > (100 * 1024 * 1024)) size = (100 * 1024 * 1024);
 
@@ -1439,7 +1741,44 @@ static void fr_network_post_event(UNUSED fr_event_list_t *el, UNUSED fr_time_t n
 		 *	As a special case, allow write() to return
 		 *	"0", which means "close the socket".
 		 */
-		if (rcode == 0) fr_network_socket_dead(nr, s);
+		if (rcode == 0) {
+			fr_network_socket_dead(nr, s);
+			continue;
+		}
+
+		network_flush_mark(nr, s);
+	}
+
+	/*
+	 *	Tell the sockets which queue their writes to send
+	 *	everything we've given them.
+	 */
+	{
+		fr_network_socket_t *s;
+
+		while ((s = fr_dlist_pop_head(&nr->flush)) != NULL) {
+			if (s->dead) continue;
+
+			if (s->listen->app_io->flush(s->listen) < 0) {
+				/*
+				 *	The socket buffer is full.  Finish
+				 *	the flush from the write callback.
+				 */
+				if (errno == EWOULDBLOCK) {
+					if (fr_event_fd_insert(nr, nr->el, s->listen->fd,
+							       fr_network_read,
+							       fr_network_write,
+							       fr_network_error,
+							       s) < 0) {
+						PERROR("Failed adding write callback to event loop");
+						fr_network_socket_dead(nr, s);
+					}
+					continue;
+				}
+
+				RATE_LIMIT_GLOBAL(PERROR, "Failed flushing writes to socket %d", s->listen->fd);
+			}
+		}
 	}
 }
 
@@ -1546,6 +1885,41 @@ static void _signal_pipe_read(UNUSED fr_event_list_t *el, int fd, UNUSED int fla
 	fr_network_destroy(nr);
 }
 
+/** Read replies which were sent to us without a signal
+ *
+ *  The workers only signal us when we're sleeping.  While we're
+ *  running, we have to poll the channels ourselves.
+ *
+ * @param[in] nr the network
+ */
+static void fr_network_channels_drain(fr_network_t *nr)
+{
+	int i;
+
+	for (i = 0; i < nr->num_workers; i++) {
+		while (fr_channel_recv_reply(nr->workers[i]->channel));
+	}
+}
+
+/** Tell the workers that we're about to sleep
+ *
+ * @param[in] nr the network
+ * @return
+ *	- true if a reply arrived, and we shouldn't sleep.
+ *	- false if we can sleep.
+ */
+static bool fr_network_channels_sleeping(fr_network_t *nr)
+{
+	int i;
+	bool pending = false;
+
+	for (i = 0; i < nr->num_workers; i++) {
+		if (fr_channel_requestor_sleeping(nr->workers[i]->channel)) pending = true;
+	}
+
+	return pending;
+}
+
 /** The main network worker function.
  *
  * @param[in] nr the network data structure to run.
@@ -1556,12 +1930,20 @@ void fr_network(fr_network_t *nr)
 		bool wait_for_event;
 		int num_events;
 
+		fr_network_channels_drain(nr);
+
 		/*
 		 *	There are runnable requests.  We still service
 		 *	the event loop, but we don't wait for events.
 		 */
 		wait_for_event = (fr_heap_num_elements(nr->replies) == 0);
 
+		/*
+		 *	Replies arrived while we were marking ourselves
+		 *	as sleeping.  Go read them instead of sleeping.
+		 */
+		if (wait_for_event && fr_network_channels_sleeping(nr)) continue;
+
 		/*
 		 *	Check the event list.  If there's an error
 		 *	(e.g. exit), we stop looping and clean up.
@@ -1721,6 +2103,8 @@ fr_network_t *fr_network_create(TALLOC_CTX *ctx, fr_event_list_t *el, char const
 		goto fail2;
 	}
 
+	fr_dlist_init(&nr->flush, fr_network_socket_t, flush_entry);
+
 	if (fr_event_pre_insert(nr->el, fr_network_pre_event, nr) < 0) {
 		fr_strerror_printf("Failed adding pre-check to event list");
 		goto fail2;
@@ -1785,6 +2169,34 @@ static int cmd_stats_self(FILE *fp, UNUSED FILE *fp_err, void *ctx, UNUSED fr_cm
 	fprintf(fp, "count.dup\t%" PRIu64 "\n", nr->stats.dup);
 	fprintf(fp, "count.dropped\t%" PRIu64 "\n", nr->stats.dropped);
 	fprintf(fp, "count.sockets\t%u\n", rbtree_num_elements(nr->sockets));
+	fprintf(fp, "dispatch.first\t%" PRIu64 "\n", nr->dispatch.first);
+	fprintf(fp, "dispatch.spilled\t%" PRIu64 "\n", nr->dispatch.spilled);
+	fprintf(fp, "dispatch.full\t%" PRIu64 "\n", nr->dispatch.full);
+	fprintf(fp, "dispatch.blocked\t%" PRIu64 "\n", nr->dispatch.blocked);
+	fprintf(fp, "dispatch.dropped\t%" PRIu64 "\n", nr->dispatch.dropped);
+
+	return 0;
+}
+
+static int cmd_stats_worker(FILE *fp, UNUSED FILE *fp_err, void *ctx, UNUSED fr_cmd_info_t const *info)
+{
+	fr_network_t const *nr = ctx;
+	int i;
+
+	for (i = 0; i < nr->num_workers; i++) {
+		fr_network_worker_t const *worker = nr->workers[i];
+		char prefix[32];
+
+		fprintf(fp, "worker.%d.outstanding\t%" PRIu64 "\n", i, WORKER_OUTSTANDING(worker));
+		fprintf(fp, "worker.%d.dropped\t%" PRIu64 "\n", i, worker->stats.dropped);
+		fprintf(fp, "worker.%d.blocked\t%s\n", i, worker->blocked ? "yes" : "no");
+		fprintf(fp, "worker.%d.estimate\t%" PRIu64 "\n", i, (uint64_t) worker->estimate);
+		fprintf(fp, "worker.%d.signals\t%" PRIu64 "\n", i, fr_channel_requestor_stats(worker->channel)->signals);
+		fprintf(fp, "worker.%d.signals_skipped\t%" PRIu64 "\n", i, fr_channel_requestor_stats(worker->channel)->skipped);
+
+		snprintf(prefix, sizeof(prefix), "worker.%d.processing", i);
+		fr_time_elapsed_fprint(fp, &worker->processing, prefix, 4);
+	}
 
 	return 0;
 }
@@ -1850,6 +2262,15 @@ fr_cmd_table_t cmd_network_table[] = {
 		.read_only = true
 	},
 
+	{
+		.parent = "stats network",
+		.add_name = true,
+		.name = "worker",
+		.func = cmd_stats_worker,
+		.help = "Show worker selection statistics for a specific network thread.",
+		.read_only = true
+	},
+
 	{
 		.parent = "stats network",
 		.add_name = true,
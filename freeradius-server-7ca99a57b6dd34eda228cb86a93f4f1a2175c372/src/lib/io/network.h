@@ -42,8 +42,21 @@ typedef struct fr_network_s fr_network_t;
 extern "C" {
 #endif
 
+/** How the network thread picks a worker for a new request
+ *
+ */
+typedef enum {
+	FR_NETWORK_DISPATCH_CPU_TIME = 0,		//!< Power of two choices on predicted CPU time.
+	FR_NETWORK_DISPATCH_QUEUE_DEPTH			//!< Power of two choices on outstanding requests
+							///< weighted by measured processing time, with
+							///< spill-over to other workers before dropping.
+} fr_network_dispatch_t;
+
 typedef struct {
-	uint32_t	max_outstanding;
+	uint32_t		max_outstanding;
+	fr_network_dispatch_t	dispatch;		//!< worker selection algorithm
+	uint32_t		max_spill;		//!< how many other workers to try when the
+							///< chosen one is full.  0 means "all of them".
 } fr_network_config_t;
 
 int		fr_network_listen_add(fr_network_t *nr, fr_listen_t *li) CC_HINT(nonnull);
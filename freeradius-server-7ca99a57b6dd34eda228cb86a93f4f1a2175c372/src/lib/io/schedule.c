@@ -29,6 +29,7 @@ RCSID("$Id$")
 #include <freeradius-devel/autoconf.h>
 
 #include <freeradius-devel/io/schedule.h>
+#include <freeradius-devel/io/listen.h>
 #include <freeradius-devel/util/dlist.h>
 #include <freeradius-devel/util/rbtree.h>
 #include <freeradius-devel/util/syserror.h>
@@ -36,6 +37,10 @@ RCSID("$Id$")
 
 #include <pthread.h>
 
+#ifdef __linux__
+#include <sched.h>
+#endif
+
 /*
  *	Other OS's have sem_init, OS X doesn't.
  */
@@ -148,6 +153,13 @@ struct fr_schedule_s {
 	fr_worker_t	*single_worker;		//!< for single-threaded mode
 };
 
+fr_table_num_sorted_t const fr_schedule_cpu_affinity_table[] = {
+	{ L("all"),	FR_SCHEDULE_CPU_AFFINITY_ALL	 },
+	{ L("network"),	FR_SCHEDULE_CPU_AFFINITY_NETWORK },
+	{ L("none"),	FR_SCHEDULE_CPU_AFFINITY_NONE	 }
+};
+size_t fr_schedule_cpu_affinity_table_len = NUM_ELEMENTS(fr_schedule_cpu_affinity_table);
+
 static _Thread_local int worker_id;		//!< Internal ID of the current worker thread.
 
 /** Return the worker id for the current thread
@@ -159,6 +171,53 @@ int fr_schedule_worker_id(void)
 	return worker_id;
 }
 
+/** Pin the calling thread to one CPU
+ *
+ * CPUs are numbered from the ones we're allowed to run on, and wrap
+ * around if there are more threads than CPUs.  Failures aren't
+ * fatal, the thread just runs wherever the OS puts it.
+ *
+ * @param[in] sc	the scheduler.
+ * @param[in] name	of the thread, for logging.
+ * @param[in] index	of the CPU, counting from zero.
+ */
+static void schedule_thread_pin(UNUSED fr_schedule_t *sc, UNUSED char const *name, UNUSED unsigned int index)
+{
+#ifdef __linux__
+	cpu_set_t	allowed, cpus;
+	int		cpu, num;
+
+	CPU_ZERO(&allowed);
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) < 0) {
+		WARN("%s - Failed getting CPU affinity: %s", name, fr_syserror(errno));
+		return;
+	}
+
+	num = CPU_COUNT(&allowed);
+	if (num <= 0) return;
+
+	index %= num;
+
+	for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		if (!CPU_ISSET(cpu, &allowed)) continue;
+
+		if (index == 0) break;
+		index--;
+	}
+
+	CPU_ZERO(&cpus);
+	CPU_SET(cpu, &cpus);
+
+	errno = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+	if (errno != 0) {
+		WARN("%s - Failed pinning thread to CPU %d: %s", name, cpu, fr_syserror(errno));
+		return;
+	}
+
+	DEBUG2("%s - Pinned to CPU %d", name, cpu);
+#endif
+}
+
 /** Entry point for worker threads
  *
  * @param[in] arg	the fr_schedule_worker_t
@@ -185,6 +244,10 @@ static void *fr_schedule_worker_thread(void *arg)
 
 	INFO("%s - Starting", worker_name);
 
+	if (sc->config->cpu_affinity == FR_SCHEDULE_CPU_AFFINITY_ALL) {
+		schedule_thread_pin(sc, worker_name, sc->config->max_networks + sw->id);
+	}
+
 	sw->el = fr_event_list_alloc(ctx, NULL, NULL);
 	if (!sw->el) {
 		PERROR("%s - Failed creating event list", worker_name);
@@ -298,6 +361,8 @@ static void *fr_schedule_network_thread(void *arg)
 
 	INFO("%s - Starting", network_name);
 
+	if (sc->config->cpu_affinity != FR_SCHEDULE_CPU_AFFINITY_NONE) schedule_thread_pin(sc, network_name, sn->id);
+
 	sn->ctx = ctx = talloc_init("%s", network_name);
 	if (!ctx) {
 		ERROR("%s - Failed allocating memory", network_name);
@@ -832,12 +897,20 @@ fr_network_t *fr_schedule_listen_add(fr_schedule_t *sc, fr_listen_t *li)
 		nr = sc->single_network;
 	} else {
 		fr_schedule_network_t *sn;
+		unsigned int i;
 
 		/*
-		 *	@todo - round robin it among the listeners?
-		 *	or maybe add it to the same parent thread?
+		 *	Sockets which share an address are spread
+		 *	across the network threads, so that each one
+		 *	is read by a different thread.  Everything
+		 *	else goes to the first network.
+		 *
+		 *	@todo - round robin the other listeners?
 		 */
 		sn = fr_dlist_head(&sc->networks);
+		for (i = li->shard % fr_dlist_num_elements(&sc->networks); i > 0; i--) {
+			sn = fr_dlist_next(&sc->networks, sn);
+		}
 		nr = sn->nr;
 	}
 
@@ -60,10 +60,25 @@ typedef int (*fr_schedule_thread_instantiate_t)(TALLOC_CTX *ctx, fr_event_list_t
  */
 typedef void (*fr_schedule_thread_detach_t)(void *uctx);
 
+/** Which threads are pinned to a CPU
+ *
+ */
+typedef enum {
+	FR_SCHEDULE_CPU_AFFINITY_NONE = 0,	//!< let the OS place threads.
+	FR_SCHEDULE_CPU_AFFINITY_NETWORK,	//!< network thread N runs on CPU N.
+	FR_SCHEDULE_CPU_AFFINITY_ALL		//!< as above, and workers run on the CPUs after the
+						///< network threads.
+} fr_schedule_cpu_affinity_t;
+
+extern fr_table_num_sorted_t const fr_schedule_cpu_affinity_table[];
+extern size_t fr_schedule_cpu_affinity_table_len;
+
 typedef struct {
 	uint32_t	max_networks;		//!< number of network threads
 	uint32_t	max_workers;		//!< number of network threads
 
+	uint32_t	cpu_affinity;		//!< a fr_schedule_cpu_affinity_t
+
 	fr_worker_config_t worker;		//!< configuration for each worker
 	fr_network_config_t network;		//!< configuration for each network;
 
@@ -107,7 +107,6 @@ struct fr_worker_s {
 	fr_time_delta_t		predicted;	//!< How long we predict a request will take to execute.
 	fr_time_tracking_t	tracking;	//!< how much time the worker has spent doing things.
 
-	bool			was_sleeping;	//!< used to suppress multiple sleep signals in a row
 	bool			exiting;	//!< are we exiting?
 
 	fr_time_t		checked_timeout; //!< when we last checked the tails of the queues
@@ -160,15 +159,12 @@ static void worker_exit(fr_worker_t *worker)
 static void worker_channel_callback(void *ctx, void const *data, size_t data_size, fr_time_t now)
 {
 	int			i;
-	bool			ok, was_sleeping;
+	bool			ok;
 	fr_channel_t		*ch;
 	fr_message_set_t	*ms;
 	fr_channel_event_t	ce;
 	fr_worker_t		*worker = ctx;
 
-	was_sleeping = worker->was_sleeping;
-	worker->was_sleeping = false;
-
 	/*
 	 *	We were woken up by a signal to do something.  We're
 	 *	not sleeping.
@@ -193,10 +189,7 @@ static void worker_channel_callback(void *ctx, void const *data, size_t data_siz
 	case FR_CHANNEL_DATA_READY_RESPONDER:
 		fr_assert(ch != NULL);
 
-		if (!fr_channel_recv_request(ch)) {
-			worker->was_sleeping = was_sleeping;
-
-		} else while (fr_channel_recv_request(ch));
+		while (fr_channel_recv_request(ch));
 		break;
 
 	case FR_CHANNEL_OPEN:
@@ -414,7 +407,9 @@ static void worker_send_reply(fr_worker_t *worker, REQUEST *request, size_t size
 	if (size) {
 		ssize_t slen = 0;
 		fr_listen_t const *listen = request->async->listen;
+		fr_pair_arena_t *prev;
 
+		prev = fr_pair_arena_set(request->pair_arena);
 		if (listen->app->encode) {
 			slen = listen->app->encode(listen->app_instance, request,
 						   reply->m.data, reply->m.rb_size);
@@ -422,6 +417,7 @@ static void worker_send_reply(fr_worker_t *worker, REQUEST *request, size_t size
 			slen = listen->app_io->encode(listen->app_io_instance, request,
 						      reply->m.data, reply->m.rb_size);
 		}
+		fr_pair_arena_set(prev);
 		if (slen < 0) {
 			RPERROR("Failed encoding request");
 			*reply->m.data = 0;
@@ -463,6 +459,13 @@ static void worker_send_reply(fr_worker_t *worker, REQUEST *request, size_t size
 	fr_time_elapsed_update(&worker->cpu_time, now, now + reply->reply.processing_time);
 	fr_time_elapsed_update(&worker->wall_clock, reply->reply.request_time, now);
 
+	if (RDEBUG_ENABLED3 && request->pair_arena) {
+		fr_pair_arena_stats_t const *stats = fr_pair_arena_stats(request->pair_arena);
+
+		RDEBUG3("Allocated %" PRIu64 " pairs from the request's arena, %" PRIu64 " with malloc",
+			stats->pairs, stats->pairs_malloc);
+	}
+
 	RDEBUG("Finished request");
 
 	/*
@@ -657,6 +660,19 @@ static void worker_request_init(fr_worker_t *worker, REQUEST *request, fr_time_t
 	request->reply = fr_radius_alloc(request, false);
 	fr_assert(request->reply != NULL);
 
+	/*
+	 *	Policies look up attributes in the request and
+	 *	reply lists far more often than they modify them.
+	 */
+	MEM(fr_pair_list_index_alloc(request->packet, &request->packet->vps) == 0);
+	MEM(fr_pair_list_index_alloc(request->reply, &request->reply->vps) == 0);
+
+	/*
+	 *	Allocate the pairs in the request's lists from its
+	 *	arena, instead of one malloc per pair.
+	 */
+	MEM(request_pair_arena_init(request) == 0);
+
 	request->number = worker->number++;
 	request->name = itoa_internal(request, request->number);
 
@@ -699,6 +715,7 @@ static void worker_request_bootstrap(fr_worker_t *worker, fr_channel_data_t *cd,
 	REQUEST			*request;
 	TALLOC_CTX		*ctx;
 	fr_listen_t const	*listen;
+	fr_pair_arena_t		*prev;
 
 	if (fr_heap_num_elements(worker->time_order) >= (uint32_t) worker->config.max_requests) goto nak;
 
@@ -733,11 +750,13 @@ static void worker_request_bootstrap(fr_worker_t *worker, fr_channel_data_t *cd,
 	 *
 	 *	Note that this also sets the "async process" function.
 	 */
+	prev = fr_pair_arena_set(request->pair_arena);
 	if (listen->app->decode) {
 		ret = listen->app->decode(listen->app_instance, request, cd->m.data, cd->m.data_size);
 	} else if (listen->app_io->decode) {
 		ret = listen->app_io->decode(listen->app_io_instance, request, cd->m.data, cd->m.data_size);
 	}
+	fr_pair_arena_set(prev);
 
 	if (ret < 0) {
 		talloc_free(ctx);
@@ -864,6 +883,7 @@ static void worker_run_request(fr_worker_t *worker, fr_time_t start)
 	rlm_rcode_t final;
 	REQUEST *request;
 	fr_time_t now;
+	fr_pair_arena_t *prev;
 
 	WORKER_VERIFY;
 
@@ -897,7 +917,9 @@ redo:
 	/*
 	 *	Everything else, run the request.
 	 */
+	prev = fr_pair_arena_set(request->pair_arena);
 	final = request->async->process(&(module_ctx_t){ .instance = request->async->process_inst }, request);
+	fr_pair_arena_set(prev);
 
 	/*
 	 *	Figure out what to do next.
@@ -1157,6 +1179,47 @@ nomem:
 }
 
 
+/** Read requests which were sent to us without a signal
+ *
+ *  The network threads only signal us when we're sleeping.  While
+ *  we're running, we have to poll the channels ourselves.
+ *
+ * @param[in] worker the worker
+ */
+static void worker_channels_drain(fr_worker_t *worker)
+{
+	int i, found = 0;
+
+	for (i = 0; (i < worker->config.max_channels) && (found < worker->num_channels); i++) {
+		if (!worker->channel[i]) continue;
+		found++;
+
+		while (fr_channel_recv_request(worker->channel[i]));
+	}
+}
+
+/** Tell the network threads that we're about to sleep
+ *
+ * @param[in] worker the worker
+ * @return
+ *	- true if a request arrived, and we shouldn't sleep.
+ *	- false if we can sleep.
+ */
+static bool worker_channels_sleeping(fr_worker_t *worker)
+{
+	int i, found = 0;
+	bool pending = false;
+
+	for (i = 0; (i < worker->config.max_channels) && (found < worker->num_channels); i++) {
+		if (!worker->channel[i]) continue;
+		found++;
+
+		if (fr_channel_responder_sleeping(worker->channel[i])) pending = true;
+	}
+
+	return pending;
+}
+
 /** The main loop and entry point of the worker thread.
  *
  * @param[in] worker the worker data structure to manage
@@ -1171,12 +1234,21 @@ void fr_worker(fr_worker_t *worker)
 
 		WORKER_VERIFY;
 
+		worker_channels_drain(worker);
+
 		/*
 		 *	There are runnable requests.  We still service
 		 *	the event loop, but we don't wait for events.
 		 */
 		wait_for_event = (fr_heap_num_elements(worker->runnable) == 0);
 		if (wait_for_event) {
+			/*
+			 *	Requests arrived while we were
+			 *	marking ourselves as sleeping.  Go
+			 *	read them instead of sleeping.
+			 */
+			if (worker_channels_sleeping(worker)) continue;
+
 			DEBUG4("Ready to process requests");
 		}
 
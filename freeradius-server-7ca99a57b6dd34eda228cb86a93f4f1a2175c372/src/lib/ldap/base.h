@@ -12,6 +12,7 @@
 #include <freeradius-devel/server/base.h>
 #include <freeradius-devel/server/connection.h>
 #include <freeradius-devel/server/map.h>
+#include <freeradius-devel/server/trunk.h>
 
 #define LDAP_DEPRECATED 0	/* Quiet warnings about LDAP_DEPRECATED not being defined */
 
@@ -300,6 +301,10 @@ typedef struct {
 
 	fr_ldap_state_t		state;			//!< LDAP connection state machine.
 
+	rbtree_t		*queries;		//!< Queries sent via the trunk, ordered by msgid.
+	fr_dlist_head_t		results;		//!< Results received via the trunk which haven't
+							///< been freed yet.
+
 	void			*uctx;			//!< User data associated with the handle.
 } fr_ldap_connection_t;
 
@@ -352,6 +357,58 @@ typedef enum {
 							//!< exit, and retry the operation with a NULL cookie.
 } fr_ldap_rcode_t;
 
+/** Types of operation which can be sent via a trunk
+ *
+ */
+typedef enum {
+	FR_LDAP_QUERY_SEARCH = 0,			//!< Search for objects.
+	FR_LDAP_QUERY_BIND,				//!< Simple bind, used to check a user's credentials.
+	FR_LDAP_QUERY_EXTENDED				//!< Extended operation.
+} fr_ldap_query_type_t;
+
+/** A result received via a trunk
+ *
+ * Entries in the result must be parsed with the libldap handle of the
+ * connection which received it.  If the connection is closed before the
+ * result is freed, c is set to NULL, and the result can no longer be parsed.
+ */
+typedef struct {
+	LDAPMessage		*msg;			//!< The result.  Freed with this structure.
+	fr_ldap_connection_t	*c;			//!< Connection the result was received on.
+	fr_dlist_t		entry;			//!< Entry in the connection's list of results.
+} fr_ldap_result_t;
+
+/** An LDAP operation sent via a trunk
+ *
+ * Many queries may be in flight on a single connection, responses are
+ * matched to queries using the msgid libldap assigns when they're sent.
+ */
+typedef struct {
+	fr_ldap_query_type_t	type;			//!< What kind of operation this is.
+
+	char const		*dn;			//!< Base DN of the search, or the DN to bind as.
+	int			scope;			//!< Search scope.
+	char const		*filter;		//!< Search filter, should be pre-escaped.
+	char const * const	*attrs;			//!< Attributes to retrieve.  Only needs to remain
+							///< valid until the query has been sent.
+	char const		*password;		//!< Password to bind with.
+	char const		*reqoid;		//!< OID of the extended operation.
+	struct berval		reqdata;		//!< Data for the extended operation.
+
+	LDAPControl		*serverctrls[LDAP_MAX_CONTROLS];	//!< Controls to pass to the server.
+	LDAPControl		*clientctrls[LDAP_MAX_CONTROLS];	//!< Controls to pass to the client (library).
+
+	REQUEST			*request;		//!< The request this query is for.
+	fr_trunk_request_t	*treq;			//!< Trunk request this query is associated with.
+
+	fr_ldap_connection_t	*c;			//!< Connection the query is in flight on.
+	int			msgid;			//!< Assigned by libldap when the query was sent.
+
+	fr_ldap_result_t	*result;		//!< Search or extended operation results.  Freed with
+							///< the query unless the caller takes ownership of them.
+	fr_ldap_rcode_t		ret;			//!< Result of the operation.
+} fr_ldap_query_t;
+
 /*
  *	Tables for resolving strings to LDAP constants
  */
@@ -462,6 +519,11 @@ int		fr_ldap_directory_alloc(TALLOC_CTX *ctx, fr_ldap_directory_t **out, fr_ldap
  */
 int		fr_ldap_edir_get_password(LDAP *ld, char const *dn, char *password, size_t *passlen);
 
+fr_trunk_enqueue_t fr_ldap_edir_get_password_async(fr_ldap_query_t **out, fr_trunk_t *trunk,
+						   REQUEST *request, void *rctx, char const *dn);
+
+int		fr_ldap_edir_get_password_result(fr_ldap_result_t const *result, char *password, size_t *passlen);
+
 char const	*fr_ldap_edir_errstr(int code);
 
 
@@ -495,7 +557,7 @@ fr_ldap_rcode_t	 fr_ldap_sasl_interactive(REQUEST *request,
 fr_ldap_connection_t *fr_ldap_connection_alloc(TALLOC_CTX *ctx);
 
 fr_connection_t	*fr_ldap_connection_state_alloc(TALLOC_CTX *ctx, fr_event_list_t *el,
-					        fr_ldap_config_t const *config, char *log_prefix);
+					        fr_ldap_config_t const *config, char const *log_prefix);
 
 int		fr_ldap_connection_configure(fr_ldap_connection_t *c, fr_ldap_config_t const *config);
 
@@ -503,6 +565,27 @@ int		fr_ldap_connection_timeout_set(fr_ldap_connection_t const *conn, fr_time_de
 
 int		fr_ldap_connection_timeout_reset(fr_ldap_connection_t const *conn);
 
+/*
+ *	trunk.c - Multiplex queries over connections
+ */
+fr_trunk_t	*fr_ldap_trunk_alloc(TALLOC_CTX *ctx, fr_event_list_t *el,
+				     fr_ldap_config_t const *config, fr_trunk_conf_t const *conf,
+				     fr_trunk_request_complete_t request_complete,
+				     fr_trunk_request_fail_t request_fail,
+				     char const *log_prefix, bool delay_start);
+
+fr_trunk_enqueue_t fr_ldap_trunk_search(fr_ldap_query_t **out, fr_trunk_t *trunk, REQUEST *request, void *rctx,
+					char const *dn, int scope, char const *filter, char const * const *attrs,
+					LDAPControl **serverctrls, LDAPControl **clientctrls);
+
+fr_trunk_enqueue_t fr_ldap_trunk_bind(fr_ldap_query_t **out, fr_trunk_t *trunk, REQUEST *request, void *rctx,
+				      char const *dn, char const *password,
+				      LDAPControl **serverctrls, LDAPControl **clientctrls);
+
+fr_trunk_enqueue_t fr_ldap_trunk_extended(fr_ldap_query_t **out, fr_trunk_t *trunk, REQUEST *request, void *rctx,
+					  char const *reqoid, struct berval const *reqdata,
+					  LDAPControl **serverctrls, LDAPControl **clientctrls);
+
 /*
  *	state.c - Connection state machine
  */
@@ -328,8 +328,16 @@ static void _ldap_connection_close(UNUSED fr_event_list_t *el, void *h, UNUSED v
  */
 static int _ldap_connection_free(fr_ldap_connection_t *c)
 {
+	fr_ldap_result_t	*result;
+
 	talloc_free_children(c);	/* Force inverted free order */
 
+	/*
+	 *	Results received on this connection can't
+	 *	be parsed once the handle has been freed.
+	 */
+	while ((result = fr_dlist_pop_head(&c->results))) result->c = NULL;
+
 	fr_ldap_control_clear(c);
 
 	if (!c->handle) return 0;	/* Don't need to do anything else if we don't yet have a handle */
@@ -373,6 +381,7 @@ fr_ldap_connection_t *fr_ldap_connection_alloc(TALLOC_CTX *ctx)
 	 */
 	c = talloc_zero(ctx, fr_ldap_connection_t);
 	if (!c) return NULL;
+	fr_dlist_talloc_init(&c->results, fr_ldap_result_t, entry);
 
 	talloc_set_destructor(c, _ldap_connection_free);
 
@@ -425,11 +434,12 @@ fr_ldap_connection_t *fr_ldap_connection_alloc(TALLOC_CTX *ctx)
  */
 static fr_connection_state_t _ldap_connection_init(void **h, fr_connection_t *conn, void *uctx)
 {
-	fr_ldap_config_t const	*config = talloc_get_type_abort(uctx, fr_ldap_config_t);
+	fr_ldap_config_t const	*config = uctx;		/* Not talloced */
 	fr_ldap_connection_t	*c;
 	fr_ldap_state_t		state;
 
 	c = fr_ldap_connection_alloc(conn);
+	c->conn = conn;
 
 	/*
 	 *	Configure/allocate the libldap handle
@@ -460,7 +470,7 @@ static fr_connection_state_t _ldap_connection_init(void **h, fr_connection_t *co
  * @param[in] log_prefix	to prepend to connection state messages.
  */
 fr_connection_t	*fr_ldap_connection_state_alloc(TALLOC_CTX *ctx, fr_event_list_t *el,
-					        fr_ldap_config_t const *config, char *log_prefix)
+					        fr_ldap_config_t const *config, char const *log_prefix)
 {
 	fr_connection_t *conn;
 
@@ -151,49 +151,29 @@ finish:
 	return err;
 }
 
-/** Attempt to retrieve the universal password from Novell eDirectory
+/** Check and decode the response to a universal password request
  *
- * @param[in] ld LDAP handle.
- * @param[in] dn of user we want to retrieve the password for.
- * @param[out] password Where to write the retrieved password.
- * @param[out] passlen Length of data written to the password buffer.
+ * @param[in] reply_oid		OID of the response.
+ * @param[in] reply_bv		data from the response.
+ * @param[out] password		Where to write the retrieved password.
+ * @param[in,out] passlen	Size of the password buffer on input, length of
+ *				data written to the password buffer on output.
  * @return
  *	- 0 on success.
  *	- < 0 on failure.
  */
-int fr_ldap_edir_get_password(LDAP *ld, char const *dn, char *password, size_t *passlen)
+static int edir_get_password_decode(char const *reply_oid, struct berval *reply_bv, char *password, size_t *passlen)
 {
-	int err = 0;
-	struct berval *request_bv = NULL;
-	char *reply_oid = NULL;
-	struct berval *reply_bv = NULL;
+	int err;
 	int server_version;
 	size_t bufsize;
 	char buffer[256];
 
-	/* Validate  parameters. */
-	if (!dn || !*dn || !passlen || !ld) {
-		return NMAS_E_INVALID_PARAMETER;
-	}
-
-	err = ber_encode_request_data(dn, &request_bv);
-	if (err) goto finish;
-
-	/* Call the ldap_extended_operation (synchronously) */
-	err = ldap_extended_operation_s(ld, NMASLDAP_GET_PASSWORD_REQUEST, request_bv, NULL, NULL, &reply_oid, &reply_bv);
-	if (err) goto finish;
-
 	/* Make sure there is a return OID */
-	if (!reply_oid) {
-		err = NMAS_E_NOT_SUPPORTED;
-		goto finish;
-	}
+	if (!reply_oid) return NMAS_E_NOT_SUPPORTED;
 
 	/* Is this what we were expecting to get back. */
-	if (strcmp(reply_oid, NMASLDAP_GET_PASSWORD_RESPONSE) != 0) {
-		err = NMAS_E_NOT_SUPPORTED;
-		goto finish;
-	}
+	if (strcmp(reply_oid, NMASLDAP_GET_PASSWORD_RESPONSE) != 0) return NMAS_E_NOT_SUPPORTED;
 
 	/* Do we have a good returned berval? */
 	if (!reply_bv) {
@@ -201,28 +181,55 @@ int fr_ldap_edir_get_password(LDAP *ld, char const *dn, char *password, size_t *
 		 *	No; returned berval means we experienced a rather
 		 *	drastic error.  Return operations error.
 		 */
-		err = NMAS_E_SYSTEM_RESOURCES;
-		goto finish;
+		return NMAS_E_SYSTEM_RESOURCES;
 	}
 
 	bufsize = sizeof(buffer);
 	err = ber_decode_login_data(reply_bv, &server_version, buffer, &bufsize);
-	if (err) goto finish;
+	if (err) return err;
 
-	if (server_version != NMAS_LDAP_EXT_VERSION) {
-		err = NMAS_E_INVALID_VERSION;
-		goto finish;
-	}
+	if (server_version != NMAS_LDAP_EXT_VERSION) return NMAS_E_INVALID_VERSION;
 
-	if (bufsize > *passlen) {
-		err = NMAS_E_BUFFER_OVERFLOW;
-		goto finish;
-	}
+	if (bufsize > *passlen) return NMAS_E_BUFFER_OVERFLOW;
 
 	memcpy(password, buffer, bufsize);
 	password[bufsize] = '\0';
 	*passlen = bufsize;
 
+	return 0;
+}
+
+/** Attempt to retrieve the universal password from Novell eDirectory
+ *
+ * @param[in] ld LDAP handle.
+ * @param[in] dn of user we want to retrieve the password for.
+ * @param[out] password Where to write the retrieved password.
+ * @param[out] passlen Length of data written to the password buffer.
+ * @return
+ *	- 0 on success.
+ *	- < 0 on failure.
+ */
+int fr_ldap_edir_get_password(LDAP *ld, char const *dn, char *password, size_t *passlen)
+{
+	int err = 0;
+	struct berval *request_bv = NULL;
+	char *reply_oid = NULL;
+	struct berval *reply_bv = NULL;
+
+	/* Validate  parameters. */
+	if (!dn || !*dn || !passlen || !ld) {
+		return NMAS_E_INVALID_PARAMETER;
+	}
+
+	err = ber_encode_request_data(dn, &request_bv);
+	if (err) goto finish;
+
+	/* Call the ldap_extended_operation (synchronously) */
+	err = ldap_extended_operation_s(ld, NMASLDAP_GET_PASSWORD_REQUEST, request_bv, NULL, NULL, &reply_oid, &reply_bv);
+	if (err) goto finish;
+
+	err = edir_get_password_decode(reply_oid, reply_bv, password, passlen);
+
 finish:
 	if (reply_bv) {
 		ber_bvfree(reply_bv);
@@ -241,6 +248,70 @@ finish:
 	return err;
 }
 
+/** Enqueue a request for the universal password on a trunk
+ *
+ * The trunk's connections must be bound as a user with rights to read
+ * universal passwords.  Once the query completes, the password can be
+ * retrieved from the result with #fr_ldap_edir_get_password_result.
+ *
+ * @param[out] out		The query.
+ * @param[in] trunk		to enqueue the request on.
+ * @param[in] request		the password is being retrieved for.
+ * @param[in] rctx		passed to the request_complete and request_fail callbacks.
+ * @param[in] dn		of user we want to retrieve the password for.
+ * @return One of the FR_TRUNK_ENQUEUE_* values.
+ */
+fr_trunk_enqueue_t fr_ldap_edir_get_password_async(fr_ldap_query_t **out, fr_trunk_t *trunk,
+						   REQUEST *request, void *rctx, char const *dn)
+{
+	struct berval		*request_bv = NULL;
+	fr_trunk_enqueue_t	ret;
+	int			err;
+
+	*out = NULL;
+
+	err = ber_encode_request_data(dn, &request_bv);
+	if (err) {
+		ROPTIONAL(REDEBUG, ERROR, "Failed encoding eDirectory password request: %s",
+			  fr_ldap_edir_errstr(err));
+		return FR_TRUNK_ENQUEUE_FAIL;
+	}
+
+	ret = fr_ldap_trunk_extended(out, trunk, request, rctx, NMASLDAP_GET_PASSWORD_REQUEST, request_bv, NULL, NULL);
+	ber_bvfree(request_bv);		/* The query has its own copy */
+
+	return ret;
+}
+
+/** Retrieve the universal password from the result of a request sent with #fr_ldap_edir_get_password_async
+ *
+ * @param[in] result		of the extended operation.
+ * @param[out] password		Where to write the retrieved password.
+ * @param[in,out] passlen	Size of the password buffer on input, length of
+ *				data written to the password buffer on output.
+ * @return
+ *	- 0 on success.
+ *	- < 0 on failure.
+ */
+int fr_ldap_edir_get_password_result(fr_ldap_result_t const *result, char *password, size_t *passlen)
+{
+	int		err;
+	char		*reply_oid = NULL;
+	struct berval	*reply_bv = NULL;
+
+	if (!result->c) return NMAS_E_SYSTEM_RESOURCES;	/* Connection closed before we could parse the result */
+
+	err = ldap_parse_extended_result(result->c->handle, result->msg, &reply_oid, &reply_bv, 0);
+	if (err) return err;
+
+	err = edir_get_password_decode(reply_oid, reply_bv, password, passlen);
+
+	if (reply_bv) ber_bvfree(reply_bv);
+	if (reply_oid) ldap_memfree(reply_oid);
+
+	return err;
+}
+
 char const *fr_ldap_edir_errstr(int code)
 {
 	switch (code) {
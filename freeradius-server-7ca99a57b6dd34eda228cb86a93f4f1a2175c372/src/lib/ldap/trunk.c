@@ -0,0 +1,657 @@
+/*
+ *   This program is is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or (at
+ *   your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/**
+ * $Id$
+ * @file lib/ldap/trunk.c
+ * @brief Multiplex LDAP searches and binds over trunk connections.
+ *
+ * Connections are brought up by the asynchronous connection state machine
+ * in connection.c.  Once bound, any number of operations can be in flight
+ * on each connection.  Responses are matched to operations using the msgid
+ * libldap assigns when the operation is sent.
+ *
+ * @copyright 2020 The FreeRADIUS server project
+ */
+RCSID("$Id$")
+
+USES_APPLE_DEPRECATED_API
+
+#include <freeradius-devel/ldap/base.h>
+#include <freeradius-devel/util/debug.h>
+
+static fr_table_num_sorted_t const ldap_query_type_table[] = {
+	{ L("Bind"),			FR_LDAP_QUERY_BIND	},
+	{ L("Extended operation"),	FR_LDAP_QUERY_EXTENDED	},
+	{ L("Search"),			FR_LDAP_QUERY_SEARCH	}
+};
+static size_t ldap_query_type_table_len = NUM_ELEMENTS(ldap_query_type_table);
+
+static void _ldap_trunk_readable(UNUSED fr_event_list_t *el, UNUSED int fd, UNUSED int flags, void *uctx)
+{
+	fr_trunk_connection_t	*tconn = talloc_get_type_abort(uctx, fr_trunk_connection_t);
+
+	fr_trunk_connection_signal_readable(tconn);
+}
+
+static void _ldap_trunk_writable(UNUSED fr_event_list_t *el, UNUSED int fd, UNUSED int flags, void *uctx)
+{
+	fr_trunk_connection_t	*tconn = talloc_get_type_abort(uctx, fr_trunk_connection_t);
+
+	fr_trunk_connection_signal_writable(tconn);
+}
+
+static void _ldap_trunk_error(UNUSED fr_event_list_t *el, UNUSED int fd, UNUSED int flags, int fd_errno, void *uctx)
+{
+	fr_trunk_connection_t	*tconn = talloc_get_type_abort(uctx, fr_trunk_connection_t);
+
+	ERROR("Connection failed: %s", fr_syserror(fd_errno));
+	fr_trunk_connection_signal_reconnect(tconn, FR_CONNECTION_FAILED);
+}
+
+/** Order queries by msgid
+ *
+ */
+static int _ldap_query_cmp(void const *one, void const *two)
+{
+	fr_ldap_query_t const	*a = one, *b = two;
+
+	return (a->msgid > b->msgid) - (a->msgid < b->msgid);
+}
+
+/** Stop tracking the query
+ *
+ * Any result we didn't hand off is freed with the query.
+ */
+static int _ldap_query_free(fr_ldap_query_t *query)
+{
+	if (query->c) rbtree_deletebydata(query->c->queries, query);
+
+	return 0;
+}
+
+/** Free the result, and remove it from the list of results received on its connection
+ *
+ */
+static int _ldap_result_free(fr_ldap_result_t *result)
+{
+	if (result->c) fr_dlist_remove(&result->c->results, result);
+	ldap_msgfree(result->msg);
+
+	return 0;
+}
+
+/** Wrap a result, so we can tell if the connection which received it is closed
+ *
+ */
+static fr_ldap_result_t *ldap_result_alloc(TALLOC_CTX *ctx, fr_ldap_connection_t *c, LDAPMessage *msg)
+{
+	fr_ldap_result_t	*result;
+
+	MEM(result = talloc_zero(ctx, fr_ldap_result_t));
+	result->msg = msg;
+	result->c = c;
+	fr_dlist_insert_tail(&c->results, result);
+	talloc_set_destructor(result, _ldap_result_free);
+
+	return result;
+}
+
+/** Allocate a new connection, which will bind as the admin user
+ *
+ */
+static fr_connection_t *_ldap_trunk_connection_alloc(fr_trunk_connection_t *tconn, fr_event_list_t *el,
+						     UNUSED fr_connection_conf_t const *conf,
+						     char const *log_prefix, void *uctx)
+{
+	fr_ldap_config_t const	*config = uctx;		/* Not talloced */
+
+	return fr_ldap_connection_state_alloc(tconn, el, config, log_prefix);
+}
+
+/** Install or remove I/O handlers for the connection's file descriptor
+ *
+ */
+static void _ldap_trunk_connection_notify(fr_trunk_connection_t *tconn, fr_connection_t *conn,
+					  fr_event_list_t *el,
+					  fr_trunk_connection_event_t notify_on, UNUSED void *uctx)
+{
+	fr_ldap_connection_t	*c = talloc_get_type_abort(conn->h, fr_ldap_connection_t);
+	fr_event_fd_cb_t	read_fn = NULL;
+	fr_event_fd_cb_t	write_fn = NULL;
+	int			fd = -1;
+
+	if ((ldap_get_option(c->handle, LDAP_OPT_DESC, &fd) != LDAP_OPT_SUCCESS) || (fd < 0)) {
+		ERROR("Failed retrieving file descriptor from libldap handle");
+		fr_trunk_connection_signal_reconnect(tconn, FR_CONNECTION_FAILED);
+		return;
+	}
+
+	switch (notify_on) {
+	case FR_TRUNK_CONN_EVENT_NONE:
+		(void) fr_event_fd_delete(el, fd, FR_EVENT_FILTER_IO);
+		return;
+
+	case FR_TRUNK_CONN_EVENT_READ:
+		read_fn = _ldap_trunk_readable;
+		break;
+
+	case FR_TRUNK_CONN_EVENT_WRITE:
+		write_fn = _ldap_trunk_writable;
+		break;
+
+	case FR_TRUNK_CONN_EVENT_BOTH:
+		read_fn = _ldap_trunk_readable;
+		write_fn = _ldap_trunk_writable;
+		break;
+	}
+
+	if (fr_event_fd_insert(c, el, fd, read_fn, write_fn, _ldap_trunk_error, tconn) < 0) {
+		PERROR("Failed inserting FD event");
+		fr_trunk_connection_signal_reconnect(tconn, FR_CONNECTION_FAILED);
+	}
+}
+
+/** Send as many pending queries as we can
+ *
+ * libldap doesn't limit the number of outstanding operations on a handle,
+ * so we keep going until the trunk runs out of queries for this connection.
+ */
+static void _ldap_trunk_request_mux(UNUSED fr_event_list_t *el,
+				    fr_trunk_connection_t *tconn, fr_connection_t *conn, UNUSED void *uctx)
+{
+	fr_ldap_connection_t	*c = talloc_get_type_abort(conn->h, fr_ldap_connection_t);
+	fr_trunk_request_t	*treq;
+
+	if (!c->queries) {
+		MEM(c->queries = rbtree_talloc_alloc(c, _ldap_query_cmp, fr_ldap_query_t, NULL, RBTREE_FLAG_NONE));
+	}
+
+	while (fr_trunk_connection_pop_request(&treq, tconn) == 0) {
+		fr_ldap_query_t		*query = talloc_get_type_abort(treq->preq, fr_ldap_query_t);
+		REQUEST			*request = query->request;
+		LDAPControl		*our_serverctrls[LDAP_MAX_CONTROLS];
+		LDAPControl		*our_clientctrls[LDAP_MAX_CONTROLS];
+		int			ret = LDAP_OTHER;
+
+		fr_ldap_control_merge(our_serverctrls, our_clientctrls,
+				      NUM_ELEMENTS(our_serverctrls),
+				      NUM_ELEMENTS(our_clientctrls),
+				      c, query->serverctrls, query->clientctrls);
+
+		switch (query->type) {
+		case FR_LDAP_QUERY_SEARCH:
+		{
+			char **search_attrs;
+
+			/*
+			 *	OpenLDAP library doesn't declare attrs array as const, but
+			 *	it really should be *sigh*.
+			 */
+			memcpy(&search_attrs, &query->attrs, sizeof(search_attrs));
+
+			ret = ldap_search_ext(c->handle, query->dn, query->scope, query->filter, search_attrs,
+					      0, our_serverctrls, our_clientctrls, NULL, 0, &query->msgid);
+		}
+			break;
+
+		case FR_LDAP_QUERY_BIND:
+		{
+			struct berval cred;
+
+			if (query->password) {
+				memcpy(&cred.bv_val, &query->password, sizeof(cred.bv_val));
+				cred.bv_len = talloc_array_length(query->password) - 1;
+			} else {
+				cred.bv_val = NULL;
+				cred.bv_len = 0;
+			}
+
+			/*
+			 *	Yes, confusingly named.  This is the simple version
+			 *	of the SASL bind function that should always be
+			 *	available.
+			 */
+			ret = ldap_sasl_bind(c->handle, query->dn, LDAP_SASL_SIMPLE, &cred,
+					     our_serverctrls, our_clientctrls, &query->msgid);
+		}
+			break;
+
+		case FR_LDAP_QUERY_EXTENDED:
+			ret = ldap_extended_operation(c->handle, query->reqoid,
+						      query->reqdata.bv_val ? &query->reqdata : NULL,
+						      our_serverctrls, our_clientctrls, &query->msgid);
+			break;
+		}
+
+		switch (ret) {
+		case LDAP_SUCCESS:
+			break;
+
+		/*
+		 *	The connection is unusable, the trunk will
+		 *	requeue this query on another connection.
+		 */
+		case LDAP_SERVER_DOWN:
+		case LDAP_CONNECT_ERROR:
+			ERROR("Failed sending query: %s", ldap_err2string(ret));
+			fr_connection_signal_reconnect(conn, FR_CONNECTION_FAILED);
+			return;
+
+		default:
+			ROPTIONAL(REDEBUG, ERROR, "Failed sending query: %s", ldap_err2string(ret));
+			query->ret = LDAP_PROC_ERROR;
+			fr_trunk_request_signal_fail(treq);
+			continue;
+		}
+
+		ROPTIONAL(RDEBUG3, DEBUG3, "Sent query with msgid %i", query->msgid);
+
+		query->c = c;
+		if (!fr_cond_assert(rbtree_insert(c->queries, query))) {
+			query->c = NULL;
+			query->ret = LDAP_PROC_ERROR;
+			fr_trunk_request_signal_fail(treq);
+			continue;
+		}
+
+		fr_trunk_request_signal_sent(treq);
+	}
+}
+
+/** Read all complete responses from the connection, and match them to queries
+ *
+ * With LDAP_RES_ANY and LDAP_MSG_ALL libldap only returns a response once
+ * the final message for that operation (i.e. the searchResultDone) has
+ * been received, so we never see partial search results.
+ */
+static void _ldap_trunk_request_demux(UNUSED fr_trunk_connection_t *tconn, fr_connection_t *conn, UNUSED void *uctx)
+{
+	fr_ldap_connection_t	*c = talloc_get_type_abort(conn->h, fr_ldap_connection_t);
+
+	for (;;) {
+		fr_ldap_query_t		*query, find;
+		LDAPMessage		*result = NULL, *msg;
+		REQUEST			*request;
+		int			ret;
+
+		ret = ldap_result(c->handle, LDAP_RES_ANY, LDAP_MSG_ALL, &fr_time_delta_to_timeval(0), &result);
+		if (ret == 0) return;				/* Nothing more to read */
+		if (ret < 0) {
+			ERROR("Failed reading response: %s", fr_ldap_error_str(c));
+			fr_connection_signal_reconnect(conn, FR_CONNECTION_FAILED);
+			return;
+		}
+
+		/*
+		 *	Responses to abandoned queries and unsolicited
+		 *	notifications are discarded.
+		 */
+		find.msgid = ldap_msgid(result);
+		if (!c->queries || !(query = rbtree_finddata(c->queries, &find))) {
+			DEBUG3("Discarding response with msgid %i", find.msgid);
+			ldap_msgfree(result);
+			continue;
+		}
+
+		rbtree_deletebydata(c->queries, query);
+		query->c = NULL;
+		request = query->request;
+
+		query->ret = LDAP_PROC_SUCCESS;
+		for (msg = ldap_first_message(c->handle, result);
+		     msg;
+		     msg = ldap_next_message(c->handle, msg)) {
+			query->ret = fr_ldap_error_check(NULL, c, msg, query->dn);
+			if (query->ret != LDAP_PROC_SUCCESS) break;
+		}
+
+		switch (query->type) {
+		case FR_LDAP_QUERY_SEARCH:
+			if (query->ret != LDAP_PROC_SUCCESS) break;
+
+			ret = ldap_count_entries(c->handle, result);
+			if (ret < 0) {
+				ROPTIONAL(REDEBUG, ERROR, "Error counting results: %s", fr_ldap_error_str(c));
+				query->ret = LDAP_PROC_ERROR;
+				break;
+			}
+
+			if (ret == 0) {
+				ROPTIONAL(RDEBUG2, DEBUG2, "Search returned no results");
+				query->ret = LDAP_PROC_NO_RESULT;
+				break;
+			}
+
+			query->result = ldap_result_alloc(query, c, result);
+			result = NULL;
+			break;
+
+		/*
+		 *	The response is parsed by the caller, as
+		 *	the data it contains is operation specific.
+		 */
+		case FR_LDAP_QUERY_EXTENDED:
+			if (query->ret != LDAP_PROC_SUCCESS) break;
+
+			query->result = ldap_result_alloc(query, c, result);
+			result = NULL;
+			break;
+
+		case FR_LDAP_QUERY_BIND:
+			break;
+		}
+
+		switch (query->ret) {
+		case LDAP_PROC_SUCCESS:
+		case LDAP_PROC_NO_RESULT:
+			break;
+
+		case LDAP_PROC_BAD_DN:
+			ROPTIONAL(RDEBUG2, DEBUG2, "DN %s does not exist", query->dn);
+			break;
+
+		default:
+			ROPTIONAL(RPEDEBUG, PERROR, "%s failed",
+				  fr_table_str_by_value(ldap_query_type_table, query->type, "<INVALID>"));
+			break;
+		}
+
+		if (result) ldap_msgfree(result);
+
+		fr_trunk_request_signal_complete(query->treq);
+	}
+}
+
+/** Stop tracking a query that's been sent
+ *
+ * Any response the server sends is discarded by the demuxer.  If the query
+ * was cancelled because the request no longer needs the result, we keep the
+ * msgid so that #_ldap_trunk_request_cancel_mux can tell the server.
+ */
+static void _ldap_trunk_request_cancel(UNUSED fr_connection_t *conn, void *preq_to_reset,
+				       fr_trunk_cancel_reason_t reason, UNUSED void *uctx)
+{
+	fr_ldap_query_t		*query = talloc_get_type_abort(preq_to_reset, fr_ldap_query_t);
+
+	if (!query->c) return;
+
+	rbtree_deletebydata(query->c->queries, query);
+	query->c = NULL;
+	if (reason != FR_TRUNK_CANCEL_REASON_SIGNAL) query->msgid = 0;
+}
+
+/** Tell the server to stop processing queries whose results are no longer needed
+ *
+ * Searches are abandoned.  Binds can't be (RFC 4511 section 4.11), and the
+ * identity of the connection is undefined until a bind completes, so the
+ * connection is closed and a new one opened instead.
+ */
+static void _ldap_trunk_request_cancel_mux(fr_trunk_connection_t *tconn, fr_connection_t *conn, UNUSED void *uctx)
+{
+	fr_ldap_connection_t	*c = talloc_get_type_abort(conn->h, fr_ldap_connection_t);
+	fr_trunk_request_t	*treq;
+	bool			reconnect = false;
+
+	while (fr_trunk_connection_pop_cancellation(&treq, tconn) == 0) {
+		fr_ldap_query_t	*query = talloc_get_type_abort(treq->preq, fr_ldap_query_t);
+
+		switch (query->type) {
+		case FR_LDAP_QUERY_SEARCH:
+		case FR_LDAP_QUERY_EXTENDED:
+			DEBUG3("Abandoning query with msgid %i", query->msgid);
+			(void) ldap_abandon_ext(c->handle, query->msgid, NULL, NULL);
+			break;
+
+		case FR_LDAP_QUERY_BIND:
+			reconnect = true;
+			break;
+		}
+		query->msgid = 0;
+
+		/*
+		 *	Abandon has no response, so the
+		 *	cancellation is complete as soon
+		 *	as it's sent.
+		 */
+		fr_trunk_request_signal_cancel_sent(treq);
+		fr_trunk_request_signal_cancel_complete(treq);
+	}
+
+	if (reconnect) {
+		DEBUG2("Bind cancelled, reconnecting");
+		fr_connection_signal_reconnect(conn, FR_CONNECTION_FAILED);
+	}
+}
+
+static void _ldap_trunk_request_free(UNUSED REQUEST *request, void *preq_to_free, UNUSED void *uctx)
+{
+	talloc_free(talloc_get_type_abort(preq_to_free, fr_ldap_query_t));
+}
+
+/** Allocate a trunk of LDAP connections
+ *
+ * Every connection in the trunk is bound as the admin user, so queries sent
+ * via #fr_ldap_trunk_search are always performed with the admin's privileges.
+ *
+ * Queries sent via #fr_ldap_trunk_bind change the identity of the connection,
+ * so the same trunk should not be used for both searches and binds.  As the
+ * identity of a connection is undefined while a bind is in progress, trunks
+ * used for binds should be configured with one request per connection.
+ *
+ * @param[in] ctx		to allocate the trunk in.
+ * @param[in] el		to insert I/O and timer events into.
+ * @param[in] config		used to establish connections.  Must remain valid
+ *				for the lifetime of the trunk.
+ * @param[in] conf		trunk configuration.
+ * @param[in] request_complete	called when a response is received.  The query's
+ *				ret field will contain the result of the operation.
+ * @param[in] request_fail	called if the query couldn't be sent.
+ * @param[in] log_prefix	to prepend to connection state messages.
+ * @param[in] delay_start	don't open any connections until the first query
+ *				is enqueued.
+ * @return
+ *	- A new trunk on success.
+ *	- NULL on failure.
+ */
+fr_trunk_t *fr_ldap_trunk_alloc(TALLOC_CTX *ctx, fr_event_list_t *el,
+				fr_ldap_config_t const *config, fr_trunk_conf_t const *conf,
+				fr_trunk_request_complete_t request_complete,
+				fr_trunk_request_fail_t request_fail,
+				char const *log_prefix, bool delay_start)
+{
+	void	*uctx;
+
+	memcpy(&uctx, &config, sizeof(uctx));
+
+	return fr_trunk_alloc(ctx, el,
+			      &(fr_trunk_io_funcs_t){
+			      	.connection_alloc = _ldap_trunk_connection_alloc,
+			      	.connection_notify = _ldap_trunk_connection_notify,
+			      	.request_mux = _ldap_trunk_request_mux,
+			      	.request_demux = _ldap_trunk_request_demux,
+			      	.request_cancel = _ldap_trunk_request_cancel,
+			      	.request_cancel_mux = _ldap_trunk_request_cancel_mux,
+			      	.request_complete = request_complete,
+			      	.request_fail = request_fail,
+			      	.request_free = _ldap_trunk_request_free
+			      },
+			      conf, log_prefix, uctx, delay_start);
+}
+
+/** Allocate a query associated with a new trunk request
+ *
+ */
+static fr_ldap_query_t *ldap_trunk_query_alloc(fr_trunk_t *trunk, REQUEST *request, fr_ldap_query_type_t type,
+					       char const *dn, LDAPControl **serverctrls, LDAPControl **clientctrls)
+{
+	fr_trunk_request_t	*treq;
+	fr_ldap_query_t		*query;
+	size_t			i;
+
+	treq = fr_trunk_request_alloc(trunk, request);
+	if (!treq) return NULL;
+
+	MEM(query = talloc_zero(treq, fr_ldap_query_t));
+	talloc_set_destructor(query, _ldap_query_free);
+	query->type = type;
+	query->request = request;
+	query->treq = treq;
+	query->ret = LDAP_PROC_ERROR;
+	query->dn = talloc_strdup(query, dn ? dn : "");
+
+	/*
+	 *	Callers usually build control arrays on the stack.
+	 */
+	for (i = 0; serverctrls && serverctrls[i] && (i < (NUM_ELEMENTS(query->serverctrls) - 1)); i++) {
+		query->serverctrls[i] = serverctrls[i];
+	}
+	for (i = 0; clientctrls && clientctrls[i] && (i < (NUM_ELEMENTS(query->clientctrls) - 1)); i++) {
+		query->clientctrls[i] = clientctrls[i];
+	}
+
+	return query;
+}
+
+/** Enqueue a fully populated query
+ *
+ * The trunk may send the query immediately, so this must be called last.
+ */
+static fr_trunk_enqueue_t ldap_trunk_query_enqueue(fr_ldap_query_t **out, fr_trunk_t *trunk, REQUEST *request,
+						   void *rctx, fr_ldap_query_t *query)
+{
+	fr_trunk_request_t	*treq = query->treq;
+	fr_trunk_enqueue_t	ret;
+
+	ret = fr_trunk_request_enqueue(&treq, trunk, request, query, rctx);
+	if (ret < 0) {
+		fr_trunk_request_free(&treq);	/* Frees the query, and returns the treq to the free list */
+		return ret;
+	}
+
+	*out = query;
+
+	return ret;
+}
+
+/** Enqueue a search on the trunk
+ *
+ * @param[out] out		The query.  Its ret and result fields are populated
+ *				before the trunk's request_complete callback is called.
+ * @param[in] trunk		to enqueue the search on.
+ * @param[in] request		the search is being performed for.
+ * @param[in] rctx		passed to the request_complete and request_fail callbacks.
+ * @param[in] dn		to use as base for the search.
+ * @param[in] scope		to use (LDAP_SCOPE_BASE, LDAP_SCOPE_ONE, LDAP_SCOPE_SUB).
+ * @param[in] filter		to use, should be pre-escaped.
+ * @param[in] attrs		to retrieve.  Must remain valid until the search is sent.
+ * @param[in] serverctrls	Search controls to pass to the server.  May be NULL.
+ * @param[in] clientctrls	Search controls for ldap_search.  May be NULL.
+ * @return One of the FR_TRUNK_ENQUEUE_* values.
+ */
+fr_trunk_enqueue_t fr_ldap_trunk_search(fr_ldap_query_t **out, fr_trunk_t *trunk, REQUEST *request, void *rctx,
+					char const *dn, int scope, char const *filter, char const * const *attrs,
+					LDAPControl **serverctrls, LDAPControl **clientctrls)
+{
+	fr_ldap_query_t		*query;
+
+	*out = NULL;
+
+	query = ldap_trunk_query_alloc(trunk, request, FR_LDAP_QUERY_SEARCH, dn, serverctrls, clientctrls);
+	if (!query) return FR_TRUNK_ENQUEUE_FAIL;
+
+	query->scope = scope;
+	if (filter) query->filter = talloc_strdup(query, filter);
+	query->attrs = attrs;
+
+	if (filter) {
+		ROPTIONAL(RDEBUG2, DEBUG2, "Performing search in \"%s\" with filter \"%s\", scope \"%s\"",
+			  query->dn, filter, fr_table_str_by_value(fr_ldap_scope, scope, "<INVALID>"));
+	} else {
+		ROPTIONAL(RDEBUG2, DEBUG2, "Performing unfiltered search in \"%s\", scope \"%s\"",
+			  query->dn, fr_table_str_by_value(fr_ldap_scope, scope, "<INVALID>"));
+	}
+
+	return ldap_trunk_query_enqueue(out, trunk, request, rctx, query);
+}
+
+/** Enqueue a simple bind on the trunk
+ *
+ * @param[out] out		The query.  Its ret field is populated before the
+ *				trunk's request_complete callback is called.
+ * @param[in] trunk		to enqueue the bind on.
+ * @param[in] request		the bind is being performed for.
+ * @param[in] rctx		passed to the request_complete and request_fail callbacks.
+ * @param[in] dn		of the user, may be NULL to bind anonymously.
+ * @param[in] password		of the user, may be NULL if no password is specified.
+ * @param[in] serverctrls	Controls to pass to the server.  May be NULL.
+ * @param[in] clientctrls	Controls to pass to the client (library).  May be NULL.
+ * @return One of the FR_TRUNK_ENQUEUE_* values.
+ */
+fr_trunk_enqueue_t fr_ldap_trunk_bind(fr_ldap_query_t **out, fr_trunk_t *trunk, REQUEST *request, void *rctx,
+				      char const *dn, char const *password,
+				      LDAPControl **serverctrls, LDAPControl **clientctrls)
+{
+	fr_ldap_query_t		*query;
+
+	*out = NULL;
+
+	query = ldap_trunk_query_alloc(trunk, request, FR_LDAP_QUERY_BIND, dn, serverctrls, clientctrls);
+	if (!query) return FR_TRUNK_ENQUEUE_FAIL;
+
+	if (password) query->password = talloc_strdup(query, password);
+
+	ROPTIONAL(RDEBUG2, DEBUG2, "Binding as \"%s\"", *query->dn ? query->dn : "(anonymous)");
+
+	return ldap_trunk_query_enqueue(out, trunk, request, rctx, query);
+}
+
+/** Enqueue an extended operation on the trunk
+ *
+ * @param[out] out		The query.  Its ret and result fields are populated
+ *				before the trunk's request_complete callback is called.
+ *				The result should be parsed with ldap_parse_extended_result.
+ * @param[in] trunk		to enqueue the operation on.
+ * @param[in] request		the operation is being performed for.
+ * @param[in] rctx		passed to the request_complete and request_fail callbacks.
+ * @param[in] reqoid		OID of the extended operation.  Must remain valid until
+ *				the operation is sent.
+ * @param[in] reqdata		to send with the operation.  May be NULL.
+ * @param[in] serverctrls	Controls to pass to the server.  May be NULL.
+ * @param[in] clientctrls	Controls to pass to the client (library).  May be NULL.
+ * @return One of the FR_TRUNK_ENQUEUE_* values.
+ */
+fr_trunk_enqueue_t fr_ldap_trunk_extended(fr_ldap_query_t **out, fr_trunk_t *trunk, REQUEST *request, void *rctx,
+					  char const *reqoid, struct berval const *reqdata,
+					  LDAPControl **serverctrls, LDAPControl **clientctrls)
+{
+	fr_ldap_query_t		*query;
+
+	*out = NULL;
+
+	query = ldap_trunk_query_alloc(trunk, request, FR_LDAP_QUERY_EXTENDED, NULL, serverctrls, clientctrls);
+	if (!query) return FR_TRUNK_ENQUEUE_FAIL;
+
+	query->reqoid = reqoid;
+	if (reqdata) {
+		MEM(query->reqdata.bv_val = talloc_memdup(query, reqdata->bv_val, reqdata->bv_len));
+		query->reqdata.bv_len = reqdata->bv_len;
+	}
+
+	ROPTIONAL(RDEBUG2, DEBUG2, "Performing extended operation \"%s\"", reqoid);
+
+	return ldap_trunk_query_enqueue(out, trunk, request, rctx, query);
+}
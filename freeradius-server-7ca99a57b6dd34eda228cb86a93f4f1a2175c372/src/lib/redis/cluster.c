@@ -157,7 +157,7 @@
 #include "cluster.h"
 #include "crc16.h"
 
-#define KEY_SLOTS		16384			//!< Maximum number of keyslots (should not change).
+#define KEY_SLOTS		FR_REDIS_CLUSTER_KEY_SLOTS	//!< Maximum number of keyslots (should not change).
 
 #define MAX_SLAVES		5			//!< Maximum number of slaves associated
 							//!< with a keyslot.
@@ -481,6 +481,67 @@ static fr_redis_cluster_rcode_t cluster_node_conf_from_redirect(uint16_t *key_sl
 	return FR_REDIS_CLUSTER_RCODE_SUCCESS;
 }
 
+/** Resolve key to key slot
+ *
+ * Used by callers which maintain their own key slot to node mappings.
+ *
+ * @param[in] key	to resolve.
+ * @param[in] key_len	length of key.
+ * @return key slot index for the key.
+ */
+uint16_t fr_redis_cluster_key_hash(uint8_t const *key, size_t key_len)
+{
+	return cluster_key_hash(key, key_len);
+}
+
+/** Parse a -MOVED or -ASK redirect
+ *
+ * @param[out] key_slot		value extracted from redirect string (may be NULL).
+ * @param[out] node_addr	Redis node ipaddr and port extracted from redirect string.
+ * @param[in] redirect		to process.
+ * @return
+ *	- FR_REDIS_CLUSTER_RCODE_SUCCESS on success.
+ *	- FR_REDIS_CLUSTER_RCODE_BAD_INPUT if the server returned an invalid redirect.
+ */
+fr_redis_cluster_rcode_t fr_redis_cluster_redirect_parse(uint16_t *key_slot, fr_socket_addr_t *node_addr,
+							 redisReply *redirect)
+{
+	return cluster_node_conf_from_redirect(key_slot, node_addr, redirect);
+}
+
+/** Copy the current key slot to master node mappings
+ *
+ * Worker threads use this to seed their own key slot maps, which they then
+ * update independently as they receive -MOVED redirects.
+ *
+ * @param[out] nodes	Node addresses indexed by node id.  Must have room for
+ *			UINT8_MAX + 1 entries.  Node ids which aren't in use are
+ *			zeroed.
+ * @param[out] slots	Master node id for each key slot.  Must have room for
+ *			#FR_REDIS_CLUSTER_KEY_SLOTS entries.
+ * @param[in] cluster	to copy the mappings from.
+ * @return the number of node ids (including the reserved node id 0).
+ */
+uint16_t fr_redis_cluster_master_map(fr_socket_addr_t nodes[], uint8_t slots[], fr_redis_cluster_t *cluster)
+{
+	uint16_t	i, num;
+	uint16_t	s;
+
+	pthread_mutex_lock(&cluster->mutex);
+	num = talloc_array_length(cluster->node);
+	for (i = 0; i < num; i++) {
+		if (!cluster->node[i].is_active) {
+			memset(&nodes[i], 0, sizeof(nodes[i]));
+			continue;
+		}
+		nodes[i] = cluster->node[i].addr;
+	}
+	for (s = 0; s < KEY_SLOTS; s++) slots[s] = cluster->key_slot[s].master;
+	pthread_mutex_unlock(&cluster->mutex);
+
+	return num;
+}
+
 /** Apply a cluster map received from a cluster node
  *
  * @note Errors may be retrieved with fr_strerror().
@@ -2202,6 +2263,22 @@ static int _cluster_version_walk(void *data, void *uctx)
 	return 0;
 }
 
+/** Return the configuration the cluster was allocated with
+ *
+ */
+fr_redis_conf_t const *fr_redis_cluster_conf(fr_redis_cluster_t const *cluster)
+{
+	return cluster->conf;
+}
+
+/** Return the log prefix used for messages relating to the cluster
+ *
+ */
+char const *fr_redis_cluster_log_prefix(fr_redis_cluster_t const *cluster)
+{
+	return cluster->log_prefix;
+}
+
 /** Check if members of the cluster are above a certain version
  *
  * @param cluster to perform check on.
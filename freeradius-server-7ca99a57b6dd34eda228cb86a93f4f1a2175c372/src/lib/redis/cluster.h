@@ -35,6 +35,8 @@ RCSIDH(cluster_h, "$Id$")
 extern "C" {
 #endif
 
+#define FR_REDIS_CLUSTER_KEY_SLOTS	16384	//!< Number of key slots in a Redis cluster.
+
 typedef struct fr_redis_cluster fr_redis_cluster_t;
 typedef struct fr_redis_cluster_key_slot_s fr_redis_cluster_key_slot_t;
 typedef struct fr_redis_cluster_node_s fr_redis_cluster_node_t;
@@ -86,6 +88,13 @@ void *fr_redis_cluster_conn_create(TALLOC_CTX *ctx, void *instance, fr_time_t ti
 /*
  *	Functions to resolve a key to a cluster node
  */
+uint16_t fr_redis_cluster_key_hash(uint8_t const *key, size_t key_len);
+
+fr_redis_cluster_rcode_t fr_redis_cluster_redirect_parse(uint16_t *key_slot, fr_socket_addr_t *node_addr,
+							 redisReply *redirect);
+
+uint16_t fr_redis_cluster_master_map(fr_socket_addr_t nodes[], uint8_t slots[], fr_redis_cluster_t *cluster);
+
 fr_redis_cluster_key_slot_t const	*fr_redis_cluster_slot_by_key(fr_redis_cluster_t *cluster, REQUEST *request,
 								      uint8_t const *key, size_t key_len);
 
@@ -123,6 +132,10 @@ int fr_redis_cluster_pool_by_node_addr(fr_pool_t **pool, fr_redis_cluster_t *clu
 ssize_t fr_redis_cluster_node_addr_by_role(TALLOC_CTX *ctx, fr_socket_addr_t *out[],
 					   fr_redis_cluster_t *cluster, bool is_master, bool is_slave);
 
+fr_redis_conf_t const *fr_redis_cluster_conf(fr_redis_cluster_t const *cluster);
+
+char const *fr_redis_cluster_log_prefix(fr_redis_cluster_t const *cluster);
+
 /*
  *	Initialise a new cluster connection, and perform initial mapping.
  */
@@ -60,9 +60,22 @@ static void _redis_disconnected(redisAsyncContext const *ac, UNUSED int status)
 static void _redis_connected(redisAsyncContext const *ac, UNUSED int status)
 {
 	fr_connection_t		*conn = talloc_get_type_abort(ac->data, fr_connection_t);
+	fr_redis_handle_t	*h = conn->h;
 
 	DEBUG4("Signalled by hiredis, connection is open");
 
+	/*
+	 *	These are queued before any commands from
+	 *	the trunk, so they're always processed first.
+	 *
+	 *	There's no callback, so hiredis discards the
+	 *	replies, and they don't consume a response
+	 *	sequence number.  If either fails, the error
+	 *	will be reported by the commands that follow.
+	 */
+	if (h->conf->password) redisAsyncCommand(h->ac, NULL, NULL, "AUTH %s", h->conf->password);
+	if (h->conf->database) redisAsyncCommand(h->ac, NULL, NULL, "SELECT %u", h->conf->database);
+
 	fr_connection_signal_connected(conn);
 }
 
@@ -320,6 +333,7 @@ static fr_connection_state_t _redis_io_connection_init(void **h_out, fr_connecti
 		return FR_CONNECTION_STATE_FAILED;
 	}
 	talloc_set_destructor(h, _redis_handle_free);
+	h->conf = conf;
 
 	h->ac = redisAsyncConnect(host, port);
 	if (!h->ac) {
@@ -73,6 +73,8 @@ typedef struct {
 
 	redisAsyncContext	*ac;			//!< Async handle for hiredis.
 
+	fr_redis_io_conf_t const *conf;		//!< Configuration the connection was opened with.
+
 	fr_dlist_head_t		ignore;			//!< Contains SQNs for responses that should be ignored.
 
 	fr_redis_sqn_t		req_sqn;		//!< Current redis request number.
@@ -107,7 +109,7 @@ static inline void fr_redis_connection_ignore_response(fr_redis_handle_t *h, fr_
 {
 	fr_redis_sqn_ignore_t *ignore;
 
-	fr_assert(sqn <= h->rsp_sqn);
+	fr_assert(sqn >= h->rsp_sqn);		/* Can't ignore a response we've already received */
 
 	MEM(ignore = talloc_zero(h, fr_redis_sqn_ignore_t));
 	ignore->sqn = sqn;
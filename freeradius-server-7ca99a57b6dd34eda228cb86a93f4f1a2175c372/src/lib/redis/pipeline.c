@@ -27,21 +27,36 @@
 
 #include <freeradius-devel/server/connection.h>
 #include <freeradius-devel/server/trunk.h>
+#include <freeradius-devel/util/inet.h>
 
 #include "pipeline.h"
 #include "io.h"
 
-
 /** Thread local state for a cluster
  *
- * MOVE ME TO NEW ASYNC CLUSTER CODE
+ * Each worker thread keeps its own copy of the key slot to node mappings.
+ * This means that redirects can be followed, and the mappings updated,
+ * without taking the cluster mutex, or blocking the thread.
  */
 struct fr_redis_cluster_thread_s {
 	fr_event_list_t			*el;
 	fr_trunk_conf_t	const		*tconf;		//!< Configuration for all trunks in the cluster.
-	char				*log_prefix;	//!< Common log prefix to use for all cluster related
+	char const			*log_prefix;	//!< Common log prefix to use for all cluster related
 							///< messages.
 	bool				delay_start;	//!< Prevent connections from spawning immediately.
+
+	fr_redis_cluster_t		*cluster;	//!< Shared cluster state we seeded our mappings from.
+	fr_redis_conf_t const		*conf;		//!< Redis configuration for the cluster.
+
+	/** @name Thread local cluster state
+	 * @{
+ 	 */
+	fr_redis_trunk_t		*node[UINT8_MAX + 1];		//!< Trunks indexed by node id.
+									///< Trunks are allocated on first use.
+	fr_socket_addr_t		node_addr[UINT8_MAX + 1];	//!< Node addresses indexed by node id.
+	uint16_t			node_num;			//!< How many node ids are available.
+	uint8_t				slot[FR_REDIS_CLUSTER_KEY_SLOTS];	//!< Master node id for each key slot.
+	/** @} */
 };
 
 /** The thread local free list
@@ -70,8 +85,8 @@ struct fr_redis_command_s {
 
 	fr_redis_command_type_t		type;		//!< Redis command type.
 
-	char const			*str;		//!< The command string.
-	size_t				len;		//!< Length of the command string.
+	char const			*str;		//!< The command in RESP format.
+	size_t				len;		//!< Length of the command.
 
 	uint64_t			sqn;		//!< The sequence number of the command.  This is only
 							///< valid for a specific handle, and is unique within
@@ -96,6 +111,10 @@ struct fr_redis_command_set_s {
 	/** @} */
 
 	uint8_t				redirected;	//!< How many times this command set was redirected.
+	bool				asking;		//!< Prefix each command with "ASKING" as we're
+							///< following an -ASK redirect.
+	bool				redirecting;	//!< The treq is being completed because we're
+							///< following a redirect, don't notify the caller.
 
 	/** @name Request state
 	 *
@@ -106,6 +125,7 @@ struct fr_redis_command_set_s {
 	 * @{
  	 */
 	fr_trunk_request_t		*treq;		//!< Trunk request this command set is associated with.
+	fr_redis_trunk_t		*rtrunk;	//!< Trunk the command set is currently enqueued on.
 	REQUEST				*request;	//!< Request this commands set is associated with (if any).
 	void				*rctx;		//!< Resume context to write results to.
 	/** @} */
@@ -180,7 +200,7 @@ static int _redis_command_set_free(fr_redis_command_set_t *cmds)
 	}
 
 	talloc_free_children(cmds);
-	memset(&cmds, 0, sizeof(cmds));
+	memset(cmds, 0, sizeof(*cmds));
 
 	fr_dlist_insert_head(command_set_free_list, cmds);
 
@@ -262,16 +282,76 @@ fr_redis_command_set_t *fr_redis_command_set_alloc(TALLOC_CTX *ctx,
  */
 static int _redis_command_free(fr_redis_command_t *cmd)
 {
-	//if (cmd->result) fr_redis_reply_free(&cmd->result);
+	if (cmd->result) fr_redis_reply_free(&cmd->result);
 
 	return 0;
 }
 
+/** Return the result of a command
+ *
+ * @param[in] cmd	to retrieve the result from.
+ * @return the redisReply, which is still owned by the command.
+ */
 redisReply *fr_redis_command_get_result(fr_redis_command_t *cmd)
 {
 	return cmd->result;
 }
 
+/** Take ownership of the result of a command
+ *
+ * The caller is responsible for freeing the reply with #fr_redis_reply_free.
+ *
+ * @param[in] cmd	to retrieve the result from.
+ * @return the redisReply.
+ */
+redisReply *fr_redis_command_steal_result(fr_redis_command_t *cmd)
+{
+	redisReply *reply = cmd->result;
+
+	cmd->result = NULL;
+
+	return reply;
+}
+
+/** Get the command name from a RESP formatted command
+ *
+ * Commands are sent as an array of bulk strings, the first of
+ * which is the command name, i.e. "*<n>\r\n$<len>\r\n<name>\r\n...".
+ *
+ * @param[out] name_len	Length of the command name.
+ * @param[in] cmd_str	RESP formatted command.
+ * @param[in] cmd_len	Length of cmd_str.
+ * @return
+ *	- The start of the command name.
+ *	- NULL if the command was malformed.
+ */
+static char const *redis_command_name(size_t *name_len, char const *cmd_str, size_t cmd_len)
+{
+	char const	*p = cmd_str, *end = cmd_str + cmd_len;
+	char		*q;
+	unsigned long	len;
+
+	if ((cmd_len < 4) || (*p != '*')) return NULL;
+
+	p = memchr(p, '\n', end - p);
+	if (!p || (++p >= end) || (*p != '$')) return NULL;
+
+	len = strtoul(p + 1, &q, 10);
+	if ((q == (p + 1)) || ((end - q) < 2) || (q[0] != '\r') || (q[1] != '\n')) return NULL;
+	p = q + 2;
+
+	if ((size_t)(end - p) < len) return NULL;
+
+	*name_len = len;
+	return p;
+}
+
+/** Compare a command name against a known command
+ *
+ */
+#define REDIS_COMMAND_IS(_name, _name_len, _cmd) \
+	((_name_len == (sizeof(_cmd) - 1)) && (strncasecmp(_name, _cmd, sizeof(_cmd) - 1) == 0))
+
 /** Add a preformatted/expanded command to the command set
  *
  * The command must either be entirely static, or parented by the command set.
@@ -281,7 +361,8 @@ redisReply *fr_redis_command_get_result(fr_redis_command_t *cmd)
  * 	 things, badly.
  *
  * @param[in] cmds	Command set to add command to.
- * @param[in] cmd_str	A fully expanded/formatted command to send to redis.
+ * @param[in] cmd_str	A fully expanded command in RESP format, as produced
+ *			by redisFormatCommand.
  *			Must be static, or have the same lifetime as the
  *			command set (allocated with the command set as the parent).
  * @param[in] cmd_len	Length of the command.
@@ -295,6 +376,14 @@ fr_redis_pipeline_status_t fr_redis_command_preformatted_add(fr_redis_command_se
 	REQUEST			*request = cmds->request;
 	fr_redis_command_t	*cmd;
 	fr_redis_command_type_t	type = FR_REDIS_COMMAND_NORMAL;
+	char const		*name;
+	size_t			name_len;
+
+	name = redis_command_name(&name_len, cmd_str, cmd_len);
+	if (!name || (name_len == 0)) {
+		ROPTIONAL(ERROR, REDEBUG, "Malformed command");
+		return FR_REDIS_PIPELINE_BAD_CMDS;
+	}
 
 	/*
 	 *	Transaction sanity checks.
@@ -306,15 +395,13 @@ fr_redis_pipeline_status_t fr_redis_command_preformatted_add(fr_redis_command_se
 	 *	We try very hard to do this without incurring a performance penalty
 	 *      for non-transactional commands.
 	 */
-	switch (tolower(cmd_str[0])) {
+	switch (tolower(name[0])) {
 	case 'm':
-		if (tolower(cmd_str[1] != 'u')) break;
-		if (strncasecmp(cmd_str, "multi", sizeof("multi") - 1) != 0) break;
+		if (!REDIS_COMMAND_IS(name, name_len, "multi")) break;
 		/*
-		 *	There should only ever be a difference of
-		 *	1 between txn starts and txn ends.
+		 *	Transaction blocks can't be nested.
 		 */
-		if ((cmds->txn_end < cmds->txn_start) && ((cmds->txn_start - cmds->txn_end) > 1)) {
+		if (cmds->txn_start > cmds->txn_end) {
 			ROPTIONAL(ERROR, REDEBUG, "Too many consecutive \"MULTI\" commands");
 			return FR_REDIS_PIPELINE_BAD_CMDS;
 		}
@@ -323,13 +410,12 @@ fr_redis_pipeline_status_t fr_redis_command_preformatted_add(fr_redis_command_se
 		 *	that's marked as the start of the transaction
 		 *	block.
 		 */
-		type = cmds->txn_watch ? FR_REDIS_COMMAND_TRANSACTION_START : FR_REDIS_COMMAND_NORMAL;
+		type = cmds->txn_watch ? FR_REDIS_COMMAND_NORMAL : FR_REDIS_COMMAND_TRANSACTION_START;
 		cmds->txn_start++;	/* Yes MULTI increments start, not WATCH */
 		break;
 
 	case 'e':
-		if (tolower(cmd_str[1] != 'e')) break;
-		if (strncasecmp(cmd_str, "exec", sizeof("exec") - 1) != 0) break;
+		if (!REDIS_COMMAND_IS(name, name_len, "exec")) break;
 		goto txn_end;
 
 	/*
@@ -338,8 +424,7 @@ fr_redis_pipeline_status_t fr_redis_command_preformatted_add(fr_redis_command_se
 	 *	executing the commands.
 	 */
 	case 'd':
-		if (tolower(cmd_str[1] != 'i')) break;
-		if (strncasecmp(cmd_str, "discard", sizeof("discard") - 1) != 0) break;
+		if (!REDIS_COMMAND_IS(name, name_len, "discard")) break;
 	txn_end:
 		if (cmds->txn_start <= cmds->txn_end) {
 			ROPTIONAL(ERROR, REDEBUG, "Transaction not started, missing \"MULTI\" command");
@@ -347,11 +432,11 @@ fr_redis_pipeline_status_t fr_redis_command_preformatted_add(fr_redis_command_se
 		}
 		type = FR_REDIS_COMMAND_TRANSACTION_END;
 		cmds->txn_end++;
+		cmds->txn_watch = false;
 		break;
 
 	case 'w':
-		if (tolower(cmd_str[1] != 'a')) break;
-		if (strncasecmp(cmd_str, "watch", sizeof("watch") - 1) != 0) break;
+		if (!REDIS_COMMAND_IS(name, name_len, "watch")) break;
 		if (cmds->txn_watch) {
 			ROPTIONAL(ERROR, REDEBUG, "Too many consecutive \"WATCH\" commands");
 			return FR_REDIS_PIPELINE_BAD_CMDS;
@@ -360,7 +445,9 @@ fr_redis_pipeline_status_t fr_redis_command_preformatted_add(fr_redis_command_se
 			ROPTIONAL(ERROR, REDEBUG, "\"WATCH\" can only be used before \"MULTI\"");
 			return FR_REDIS_PIPELINE_BAD_CMDS;
 		}
-		FALL_THROUGH;
+		type = FR_REDIS_COMMAND_TRANSACTION_START;
+		cmds->txn_watch = true;
+		break;
 
 	default:
 		break;
@@ -377,6 +464,67 @@ fr_redis_pipeline_status_t fr_redis_command_preformatted_add(fr_redis_command_se
 	return FR_REDIS_PIPELINE_OK;
 }
 
+/** Format and add a command to the command set
+ *
+ * Accepts the same format strings as redisCommand, so arguments which may
+ * contain spaces or binary data should be passed with %s or %b, not
+ * expanded into the format string.
+ *
+ * @param[in] cmds	Command set to add command to.
+ * @param[in] fmt	redisCommand style format string.
+ * @param[in] ...	Arguments for the format string.
+ * @return
+ *	- FR_REDIS_PIPELINE_BAD_CMDS if the command couldn't be formatted, or
+ *	  would result in a bad command sequence.
+ *	- FR_REDIS_PIPELINE_OK if command was enqueued successfully.
+ */
+fr_redis_pipeline_status_t fr_redis_command_add(fr_redis_command_set_t *cmds, char const *fmt, ...)
+{
+	REQUEST				*request = cmds->request;
+	va_list				ap;
+	char				*buff, *cmd_str;
+	int				len;
+	fr_redis_pipeline_status_t	ret;
+
+	va_start(ap, fmt);
+	len = redisvFormatCommand(&buff, fmt, ap);
+	va_end(ap);
+	if (len < 0) {
+		ROPTIONAL(ERROR, REDEBUG, "Failed formatting command");
+		return FR_REDIS_PIPELINE_BAD_CMDS;
+	}
+
+	MEM(cmd_str = talloc_memdup(cmds, buff, (size_t)len));
+	redisFreeCommand(buff);
+
+	ret = fr_redis_command_preformatted_add(cmds, cmd_str, (size_t)len);
+	if (ret != FR_REDIS_PIPELINE_OK) talloc_free(cmd_str);
+
+	return ret;
+}
+
+/** Return a command set to its initial state so it can be sent again
+ *
+ * Any results received are freed, and all commands are placed back
+ * in the pending list in their original order.
+ *
+ * @param[in] cmds	to reset.
+ */
+static void redis_command_set_reset(fr_redis_command_set_t *cmds)
+{
+	fr_redis_command_t	*cmd;
+
+	fr_dlist_move(&cmds->completed, &cmds->sent);
+	fr_dlist_move(&cmds->completed, &cmds->pending);
+	fr_dlist_move(&cmds->pending, &cmds->completed);
+
+	for (cmd = fr_dlist_head(&cmds->pending);
+	     cmd;
+	     cmd = fr_dlist_next(&cmds->pending, cmd)) {
+		if (cmd->result) fr_redis_reply_free(&cmd->result);
+	}
+}
+
 /** Enqueue a command set on a specific trunk
  *
  * The command set may be passed around several trunks before it is complete.
@@ -389,13 +537,17 @@ fr_redis_pipeline_status_t fr_redis_command_preformatted_add(fr_redis_command_se
  *	- FR_REDIS_PIPELINE_DST_UNAVAILABLE if the REDIS host is unreachable.
  *	- FR_REDIS_PIPELINE_FAIL any other general error.
  */
-fr_redis_pipeline_status_t redis_command_set_enqueue(fr_redis_trunk_t *rtrunk, fr_redis_command_set_t *cmds)
+fr_redis_pipeline_status_t fr_redis_trunk_command_set_enqueue(fr_redis_trunk_t *rtrunk, fr_redis_command_set_t *cmds)
 {
+	REQUEST	*request = cmds->request;
+
 	if (cmds->txn_start != cmds->txn_end) {
-		ERROR("Refusing to enqueue - Unbalanced transaction start/stop commands");
+		ROPTIONAL(ERROR, REDEBUG, "Refusing to enqueue - Unbalanced transaction start/stop commands");
 		return FR_REDIS_PIPELINE_BAD_CMDS;
 	}
 
+	cmds->rtrunk = rtrunk;
+
 	switch (fr_trunk_request_enqueue(&cmds->treq, rtrunk->trunk, cmds->request, cmds, cmds->rctx)) {
 	case FR_TRUNK_ENQUEUE_OK:
 	case FR_TRUNK_ENQUEUE_IN_BACKLOG:
@@ -409,6 +561,184 @@ fr_redis_pipeline_status_t redis_command_set_enqueue(fr_redis_trunk_t *rtrunk, f
 	}
 }
 
+/** Get the trunk for a node, allocating it if required
+ *
+ * @param[in] cluster_thread	the node belongs to.
+ * @param[in] id		of the node.
+ * @return
+ *	- The trunk for the node.
+ *	- NULL if the node isn't active, or we failed allocating the trunk.
+ */
+static fr_redis_trunk_t *redis_cluster_node_trunk(fr_redis_cluster_thread_t *cluster_thread, uint8_t id)
+{
+	fr_redis_io_conf_t	*io_conf;
+	fr_socket_addr_t	*addr = &cluster_thread->node_addr[id];
+	fr_redis_conf_t const	*conf = cluster_thread->conf;
+	char			buffer[FR_IPADDR_STRLEN];
+
+	if (cluster_thread->node[id]) return cluster_thread->node[id];
+
+	if (addr->ipaddr.af == AF_UNSPEC) return NULL;	/* Not an active node */
+
+	fr_inet_ntop(buffer, sizeof(buffer), &addr->ipaddr);
+
+	MEM(io_conf = talloc_zero(cluster_thread, fr_redis_io_conf_t));
+	MEM(io_conf->hostname = talloc_typed_strdup(io_conf, buffer));
+	io_conf->port = addr->port;
+	io_conf->database = conf->database;
+	io_conf->password = conf->password;
+	io_conf->connection_timeout = conf->connection_timeout;
+	io_conf->reconnection_delay = conf->reconnection_delay;
+	io_conf->log_prefix = cluster_thread->log_prefix;
+
+	cluster_thread->node[id] = fr_redis_trunk_alloc(cluster_thread, io_conf);
+	if (!cluster_thread->node[id]) {
+		ERROR("%s - Failed allocating trunk for node %s:%u", cluster_thread->log_prefix,
+		      buffer, addr->port);
+		talloc_free(io_conf);
+		return NULL;
+	}
+	talloc_steal(cluster_thread->node[id], io_conf);
+
+	return cluster_thread->node[id];
+}
+
+/** Find the node id for an address, or assign it one if we've not seen it before
+ *
+ * @param[out] id		of the node.
+ * @param[in] cluster_thread	to search in.
+ * @param[in] addr		of the node.
+ * @return
+ *	- 0 on success.
+ *	- -1 if there are no free node ids.
+ */
+static int redis_cluster_node_id_by_addr(uint8_t *id, fr_redis_cluster_thread_t *cluster_thread,
+					 fr_socket_addr_t const *addr)
+{
+	uint16_t	i, free_id = 0;
+
+	/*
+	 *	Node 0 is reserved, and never active.
+	 */
+	for (i = 1; i < cluster_thread->node_num; i++) {
+		fr_socket_addr_t const *node_addr = &cluster_thread->node_addr[i];
+
+		if (node_addr->ipaddr.af == AF_UNSPEC) {
+			if (!free_id) free_id = i;
+			continue;
+		}
+
+		if ((node_addr->port == addr->port) && (fr_ipaddr_cmp(&node_addr->ipaddr, &addr->ipaddr) == 0)) {
+			*id = i;
+			return 0;
+		}
+	}
+
+	if (!free_id) return -1;
+
+	cluster_thread->node_addr[free_id] = *addr;
+	*id = free_id;
+
+	return 0;
+}
+
+/** Check if a reply is a -MOVED or -ASK redirect
+ *
+ */
+static inline fr_redis_rcode_t redis_reply_redirect(redisReply const *reply)
+{
+	if (!reply || (reply->type != REDIS_REPLY_ERROR)) return REDIS_RCODE_SUCCESS;
+
+	if (strncmp(REDIS_ERROR_MOVED_STR, reply->str, sizeof(REDIS_ERROR_MOVED_STR) - 1) == 0) {
+		return REDIS_RCODE_MOVE;
+	}
+
+	if (strncmp(REDIS_ERROR_ASK_STR, reply->str, sizeof(REDIS_ERROR_ASK_STR) - 1) == 0) {
+		return REDIS_RCODE_ASK;
+	}
+
+	return REDIS_RCODE_SUCCESS;
+}
+
+/** Follow a -MOVED or -ASK redirect
+ *
+ * The command set is completed on its current trunk (without notifying the
+ * caller), reset, and enqueued on the trunk for the node the redirect
+ * pointed to.  No blocking operations are performed, so the worker thread
+ * continues processing other requests whilst the command set is resent.
+ *
+ * As the command set is resent in its entirety, all keys in a command set
+ * must map to the same key slot.
+ *
+ * @param[in] cmds	to redirect.
+ * @param[in] redirect	The -MOVED or -ASK reply.
+ * @param[in] rcode	REDIS_RCODE_MOVE or REDIS_RCODE_ASK.
+ * @return
+ *	- true if the command set was redirected (or failed and was freed).
+ *	- false if the redirect couldn't be followed, in which case the
+ *	  caller should complete the command set as normal.
+ */
+static bool redis_command_set_redirect(fr_redis_command_set_t *cmds, redisReply *redirect, fr_redis_rcode_t rcode)
+{
+	fr_redis_cluster_thread_t	*cluster_thread = cmds->rtrunk->cluster;
+	REQUEST				*request = cmds->request;
+	fr_socket_addr_t		node_addr;
+	uint16_t			key_slot;
+	uint8_t				id;
+	fr_redis_trunk_t		*rtrunk;
+
+	if (fr_redis_cluster_redirect_parse(&key_slot, &node_addr, redirect) != FR_REDIS_CLUSTER_RCODE_SUCCESS) {
+		ROPTIONAL(RPERROR, PERROR, "Failed parsing redirect");
+		return false;
+	}
+
+	if (redis_cluster_node_id_by_addr(&id, cluster_thread, &node_addr) < 0) {
+		ROPTIONAL(REDEBUG, ERROR, "Can't follow redirect, maximum number of cluster nodes reached");
+		return false;
+	}
+
+	rtrunk = redis_cluster_node_trunk(cluster_thread, id);
+	if (!rtrunk) return false;
+
+	/*
+	 *	-MOVED means the key slot has been permanently
+	 *	reassigned, so future command sets should be
+	 *	sent directly to the new node.
+	 *
+	 *	-ASK is a one off redirect whilst the slot is
+	 *	being migrated.
+	 */
+	if (rcode == REDIS_RCODE_MOVE) {
+		ROPTIONAL(RDEBUG2, DEBUG2, "Key slot %u moved to node %u", key_slot, id);
+		cluster_thread->slot[key_slot] = id;
+		cmds->asking = false;
+	} else {
+		ROPTIONAL(RDEBUG2, DEBUG2, "Key slot %u being migrated, asking node %u", key_slot, id);
+		cmds->asking = true;
+	}
+	cmds->redirected++;
+
+	redis_command_set_reset(cmds);
+
+	/*
+	 *	Release the treq on the old trunk.
+	 *	The complete and free callbacks are
+	 *	no-ops whilst redirecting is set.
+	 */
+	cmds->redirecting = true;
+	fr_trunk_request_signal_complete(cmds->treq);
+	cmds->redirecting = false;
+	cmds->treq = NULL;
+
+	if (fr_redis_trunk_command_set_enqueue(rtrunk, cmds) != FR_REDIS_PIPELINE_OK) {
+		ROPTIONAL(REDEBUG, ERROR, "Failed enqueueing redirected commands");
+		if (cmds->fail) cmds->fail(request, &cmds->completed, cmds->rctx);
+		talloc_free(cmds);
+	}
+
+	return true;
+}
+
 /** Callback for for receiving Redis replies
  *
  * This is called by hiredis for each response is receives.  privData is set to the
@@ -430,7 +760,19 @@ static void _redis_pipeline_demux(struct redisAsyncContext *ac, void *vreply, vo
 	fr_redis_command_set_t	*cmds;
 	fr_connection_t		*conn = talloc_get_type_abort(ac->ev.data, fr_connection_t);
 	fr_redis_handle_t	*h = talloc_get_type_abort(conn->h, fr_redis_handle_t);
+	fr_redis_conf_t const	*conf;
 	redisReply		*reply = vreply;
+
+	/*
+	 *	hiredis calls all outstanding callbacks with
+	 *	a NULL reply when the connection is torn down.
+	 *
+	 *	The trunk will already have cancelled (and
+	 *	possibly freed) the command sets, so privdata
+	 *	can't be trusted.
+	 */
+	if (!reply) return;
+
 	/*
 	 *	First check if we should ignore the response
 	 */
@@ -440,11 +782,6 @@ static void _redis_pipeline_demux(struct redisAsyncContext *ac, void *vreply, vo
 		return;
 	}
 
-	/*
-	 *	FIXME - Need to check TRYAGAIN, MOVED etc...
-	 *	I guess we might want to wait for the end of
-	 *	the command set to do that.
-	 */
 	cmd = talloc_get_type_abort(privdata, fr_redis_command_t);
 	cmds = cmd->cmds;
 	cmd->result = reply;
@@ -453,12 +790,32 @@ static void _redis_pipeline_demux(struct redisAsyncContext *ac, void *vreply, vo
 	fr_dlist_insert_tail(&cmds->completed, cmd);
 
 	/*
-	 *	Check is the command set is complete,
-	 *	and if it is, tell the trunk the treq
-	 *	is complete.
+	 *	Wait until we have responses for all
+	 *	commands in the set.
+	 */
+	if ((fr_dlist_num_elements(&cmds->pending) != 0) ||
+	    (fr_dlist_num_elements(&cmds->sent) != 0)) return;
+
+	/*
+	 *	Check for redirects.  If we're out of
+	 *	redirects the caller gets the -MOVED or
+	 *	-ASK error as the result.
 	 */
-	if ((fr_dlist_num_elements(&cmds->pending) == 0) &&
-	    (fr_dlist_num_elements(&cmds->sent) == 0)) fr_trunk_request_signal_complete(cmds->treq);
+	conf = cmds->rtrunk->cluster->conf;
+	if (conf && (cmds->redirected < conf->max_redirects)) {
+		for (cmd = fr_dlist_head(&cmds->completed);
+		     cmd;
+		     cmd = fr_dlist_next(&cmds->completed, cmd)) {
+			fr_redis_rcode_t rcode = redis_reply_redirect(cmd->result);
+
+			if (rcode == REDIS_RCODE_SUCCESS) continue;
+
+			if (redis_command_set_redirect(cmds, cmd->result, rcode)) return;
+			break;
+		}
+	}
+
+	fr_trunk_request_signal_complete(cmds->treq);
 }
 
 static fr_connection_t *_redis_pipeline_connection_alloc(fr_trunk_connection_t *tconn, fr_event_list_t *el,
@@ -472,58 +829,88 @@ static fr_connection_t *_redis_pipeline_connection_alloc(fr_trunk_connection_t *
 
 /** Enqueue one or more command sets onto a redis handle
  *
- * Because the trunk is in always writable mode, _redis_pipeline_mux
- * will be called any time fr_trunk_request_enqueue is called, so there'll only
- * ever be one command to dequeue.
+ * All command sets the trunk has assigned to the connection are written
+ * back to back.  hiredis buffers them and flushes them in as few writes as
+ * possible, so commands from concurrent requests are pipelined on the
+ * connection.
  *
+ * @param[in] el		Event list.  Unused.
  * @param[in] tconn		Trunk connection holding the commands to enqueue.
  * @param[in] conn		Connection handle containing the fr_redis_handle_t.
- * @param[in] uctx		fr_redis_cluster_t.  Unused.
+ * @param[in] uctx		fr_redis_trunk_t.  Unused.
  */
-static void _redis_pipeline_mux(fr_trunk_connection_t *tconn, fr_connection_t *conn, UNUSED void *uctx)
+static void _redis_pipeline_mux(UNUSED fr_event_list_t *el,
+				fr_trunk_connection_t *tconn, fr_connection_t *conn, UNUSED void *uctx)
 {
 	fr_trunk_request_t	*treq;
-	fr_redis_command_set_t 	*cmds;
-	fr_redis_command_t	*cmd;
 	fr_redis_handle_t	*h = talloc_get_type_abort(conn->h, fr_redis_handle_t);
-	REQUEST			*request;
-
-	treq = fr_trunk_connection_pop_request(&request, (void *)&cmds, NULL, tconn);
-	while ((cmd = fr_dlist_head(&cmds->pending))) {
-		/*
-		 *	If this fails it probably means the connection
-		 *	is disconnecting, but if that's happening then
-		 *	we shouldn't be enqueueing new requests?
-		 */
-		if (unlikely(redisAsyncCommand(h->ac, _redis_pipeline_demux, cmd, "%s", cmd->str) != REDIS_OK)) {
-			ROPTIONAL(ERROR, REDEBUG, "Unexpected error queueing REDIS command");
 
-			while ((cmd = fr_dlist_head(&cmds->sent))) {
-				fr_redis_connection_ignore_response(h, cmd->sqn);
-				fr_dlist_remove(&cmds->sent, cmd);
-				fr_dlist_insert_tail(&cmds->pending, cmd);
+	while (fr_trunk_connection_pop_request(&treq, tconn) == 0) {
+		fr_redis_command_set_t 	*cmds = talloc_get_type_abort(treq->preq, fr_redis_command_set_t);
+		fr_redis_command_t	*cmd;
+		REQUEST			*request = treq->request;
+
+		while ((cmd = fr_dlist_head(&cmds->pending))) {
+			/*
+			 *	ASKING has no callback, so it doesn't
+			 *	consume a response sequence number.
+			 */
+			if (cmds->asking &&
+			    unlikely(redisAsyncCommand(h->ac, NULL, NULL, "ASKING") != REDIS_OK)) goto error;
+
+			/*
+			 *	If this fails it probably means the connection
+			 *	is disconnecting, but if that's happening then
+			 *	we shouldn't be enqueueing new requests?
+			 */
+			if (unlikely(redisAsyncFormattedCommand(h->ac, _redis_pipeline_demux, cmd,
+								cmd->str, cmd->len) != REDIS_OK)) {
+			error:
+				ROPTIONAL(REDEBUG, ERROR, "Unexpected error queueing REDIS command");
+
+				for (cmd = fr_dlist_head(&cmds->sent);
+				     cmd;
+				     cmd = fr_dlist_next(&cmds->sent, cmd)) {
+					fr_redis_connection_ignore_response(h, cmd->sqn);
+				}
+				fr_trunk_request_signal_fail(treq);
+				goto next;
 			}
-			fr_trunk_request_signal_fail(treq);
-			return;
+			cmd->sqn = fr_redis_connection_sent_request(h);
+			fr_dlist_remove(&cmds->pending, cmd);
+			fr_dlist_insert_tail(&cmds->sent, cmd);
 		}
-		cmd->sqn = fr_redis_connection_sent_request(h);
-		fr_dlist_remove(&cmds->pending, cmd);
-		fr_dlist_insert_tail(&cmds->sent, cmd);
+		fr_trunk_request_signal_sent(treq);
+	next:
+		continue;
 	}
-	fr_trunk_request_signal_sent(treq);
 }
 
 /** Deal with cancellation of sent requests
  *
- * We can't actually signal redis to not process the request, so depending
- * on why the commands were cancelled, we either tell the handle to ignore
- * them, or move them back into the pending list.
+ * We can't actually signal redis to not process the request, so we tell the
+ * handle to ignore any responses to commands already sent, and depending on
+ * why the commands were cancelled, we either leave the command set to be
+ * freed, or put it back into the state it was in before it was sent.
  */
-static void _redis_pipeline_command_set_cancel(fr_connection_t *conn, UNUSED fr_trunk_request_t *treq, void *preq,
+static void _redis_pipeline_command_set_cancel(fr_connection_t *conn, void *preq,
 					       fr_trunk_cancel_reason_t reason, UNUSED void *uctx)
 {
 	fr_redis_command_set_t	*cmds = talloc_get_type_abort(preq, fr_redis_command_set_t);
-	fr_redis_handle_t	*h = conn->h;
+	fr_redis_handle_t	*h = talloc_get_type_abort(conn->h, fr_redis_handle_t);
+	fr_redis_command_t	*cmd;
+
+	/*
+	 *	Responses for commands already sent
+	 *	will reference commands which either
+	 *	no longer exist, or will be sent
+	 *	again on another connection.
+	 */
+	for (cmd = fr_dlist_head(&cmds->sent);
+	     cmd;
+	     cmd = fr_dlist_next(&cmds->sent, cmd)) {
+		fr_redis_connection_ignore_response(h, cmd->sqn);
+	}
 
 	/*
 	 *	How we cancel is very different depending
@@ -531,39 +918,22 @@ static void _redis_pipeline_command_set_cancel(fr_connection_t *conn, UNUSED fr_
 	 */
 	switch (reason) {
 	/*
-	 *	Cancel is only called for requests that
-	 *	have been sent, and only when the connection
-	 *	is about to be closed for some reason.
-	 *
-	 *	We don't need to tell the handle to ignore
-	 *	the responses, we just need to get the
-	 *	command set back into the correct state for
-	 *	execution by another handle.
+	 *	The command set is going to be sent
+	 *	again, either on this connection or
+	 *	another one, so get it back into the
+	 *	correct state for execution.
 	 */
 	case FR_TRUNK_CANCEL_REASON_MOVE:
-		fr_dlist_move(&cmds->pending, &cmds->sent);
+	case FR_TRUNK_CANCEL_REASON_REQUEUE:
+		redis_command_set_reset(cmds);
 		return;
 
 	/*
-	 *	If the request was cancelled due to a signal
-	 *	we'll have a response coming back for a
-	 *	request, pctx and rctx that no longer exist.
-	 *	Tell the handle to signal that the response
-	 *	should be ignored when it's received.
-	 *
-	 *      Free will take care of cleaning up the
-	 *	pending commands.
+	 *	Free will take care of cleaning up the
+	 *	command set.
 	 */
 	case FR_TRUNK_CANCEL_REASON_SIGNAL:
-	{
-		fr_redis_command_t	*cmd;
-
-		for (cmd = fr_dlist_head(&cmds->sent);
-		     cmd;
-		     cmd = fr_dlist_next(&cmds->sent, cmd)) {
-			fr_redis_connection_ignore_response(h, cmd->sqn);
-		}
-	}
+		return;
 
 	case FR_TRUNK_CANCEL_REASON_NONE:
 		fr_assert(0);
@@ -579,6 +949,8 @@ static void _redis_pipeline_command_set_complete(UNUSED REQUEST *request, void *
 {
 	fr_redis_command_set_t	*cmds = talloc_get_type_abort(preq, fr_redis_command_set_t);
 
+	if (cmds->redirecting) return;
+
 	if (cmds->complete) cmds->complete(cmds->request, &cmds->completed, cmds->rctx);
 }
 
@@ -586,7 +958,8 @@ static void _redis_pipeline_command_set_complete(UNUSED REQUEST *request, void *
  *
  */
 static void _redis_pipeline_command_set_fail(UNUSED REQUEST *request, void *preq,
-					     UNUSED void *rctx, UNUSED void *uctx)
+					     UNUSED void *rctx, UNUSED fr_trunk_request_state_t state,
+					     UNUSED void *uctx)
 {
 	fr_redis_command_set_t	*cmds = talloc_get_type_abort(preq, fr_redis_command_set_t);
 
@@ -601,9 +974,62 @@ static void _redis_pipeline_command_set_free(UNUSED REQUEST *request, void *preq
 {
 	fr_redis_command_set_t	*cmds = talloc_get_type_abort(preq, fr_redis_command_set_t);
 
+	if (cmds->redirecting) return;
+
 	talloc_free(cmds);
 }
 
+/** Cancel a command set
+ *
+ * Should be called by the API client from its signal handler if the
+ * request the command set was enqueued for is cancelled.  Any responses
+ * to commands already sent will be ignored, and the command set is freed.
+ *
+ * @note The complete and fail callbacks will not be called.
+ *
+ * @param[in] cmds	to cancel.
+ */
+void fr_redis_command_set_signal_cancel(fr_redis_command_set_t *cmds)
+{
+	if (!cmds->treq) {
+		talloc_free(cmds);
+		return;
+	}
+
+	fr_trunk_request_signal_cancel(cmds->treq);
+}
+
+/** Enqueue a command set on the cluster node responsible for a key
+ *
+ * @param[in] cluster_thread	to enqueue the command set on.
+ * @param[in] cmds		Command set to enqueue.  All keys in the command
+ *				set must map to the same key slot.
+ * @param[in] key		used to determine the node to send the commands to.
+ * @param[in] key_len		Length of the key.
+ * @return
+ *	- FR_REDIS_PIPELINE_OK if commands were immediately enqueued or placed in the backlog.
+ *	- FR_REDIS_PIPELINE_DST_UNAVAILABLE if the REDIS host is unreachable.
+ *	- FR_REDIS_PIPELINE_FAIL any other general error.
+ */
+fr_redis_pipeline_status_t fr_redis_command_set_enqueue(fr_redis_cluster_thread_t *cluster_thread,
+							fr_redis_command_set_t *cmds,
+							uint8_t const *key, size_t key_len)
+{
+	REQUEST			*request = cmds->request;
+	uint16_t		key_slot = fr_redis_cluster_key_hash(key, key_len);
+	fr_redis_trunk_t	*rtrunk;
+
+	rtrunk = redis_cluster_node_trunk(cluster_thread, cluster_thread->slot[key_slot]);
+	if (!rtrunk) {
+		ROPTIONAL(REDEBUG, ERROR, "No active node for key slot %u", key_slot);
+		return FR_REDIS_PIPELINE_DST_UNAVAILABLE;
+	}
+
+	ROPTIONAL(RDEBUG3, DEBUG3, "Key slot %u mapped to node %u", key_slot, cluster_thread->slot[key_slot]);
+
+	return fr_redis_trunk_command_set_enqueue(rtrunk, cmds);
+}
+
 /** Allocate a new trunk
  *
  * @param[in] cluster_thread	to allocate the trunk for.
@@ -627,6 +1053,7 @@ fr_redis_trunk_t *fr_redis_trunk_alloc(fr_redis_cluster_thread_t *cluster_thread
 
 	MEM(rtrunk = talloc_zero(cluster_thread, fr_redis_trunk_t));
 	rtrunk->io_conf = io_conf;
+	rtrunk->cluster = cluster_thread;
 	rtrunk->trunk = fr_trunk_alloc(rtrunk, cluster_thread->el,
 				       &io_funcs, cluster_thread->tconf, cluster_thread->log_prefix, rtrunk,
 				       cluster_thread->delay_start);
@@ -643,8 +1070,22 @@ fr_redis_trunk_t *fr_redis_trunk_alloc(fr_redis_cluster_thread_t *cluster_thread
  * This structure represents all the connections for a given thread for a given cluster.
  * The structures holds the trunk connections to talk to each cluster member.
  *
+ * The key slot to node mappings are copied from the shared cluster, after which
+ * they're maintained independently by each thread as redirects are received.
+ * Trunks to individual nodes are allocated the first time a command set is
+ * enqueued for that node.
+ *
+ * @param[in] ctx	to allocate the thread cluster state in.
+ * @param[in] el	to use for I/O and timers.
+ * @param[in] cluster	to seed the key slot mappings from.  May be NULL if
+ *			trunks will only be allocated with #fr_redis_trunk_alloc,
+ *			in which case redirects are not followed.
+ * @param[in] tconf	Trunk configuration for all trunks in the cluster.
+ * @return
+ *	- A new fr_redis_cluster_thread_t.
  */
-fr_redis_cluster_thread_t *fr_redis_cluster_thread_alloc(TALLOC_CTX *ctx, fr_event_list_t *el, fr_trunk_conf_t const *tconf)
+fr_redis_cluster_thread_t *fr_redis_cluster_thread_alloc(TALLOC_CTX *ctx, fr_event_list_t *el,
+							 fr_redis_cluster_t *cluster, fr_trunk_conf_t const *tconf)
 {
 	fr_redis_cluster_thread_t *cluster_thread;
 	fr_trunk_conf_t *our_tconf;
@@ -655,8 +1096,13 @@ fr_redis_cluster_thread_t *fr_redis_cluster_thread_alloc(TALLOC_CTX *ctx, fr_eve
 
 	cluster_thread->el = el;
 	cluster_thread->tconf = our_tconf;
+	cluster_thread->cluster = cluster;
+	if (!cluster) return cluster_thread;
+
+	cluster_thread->conf = fr_redis_cluster_conf(cluster);
+	cluster_thread->log_prefix = fr_redis_cluster_log_prefix(cluster);
+	cluster_thread->node_num = fr_redis_cluster_master_map(cluster_thread->node_addr, cluster_thread->slot,
+							       cluster);
 
 	return cluster_thread;
 }
-
-
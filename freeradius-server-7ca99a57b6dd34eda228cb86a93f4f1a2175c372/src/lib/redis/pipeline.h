@@ -32,6 +32,7 @@ RCSIDH(redis_pipeline_h, "$Id$")
 #include <freeradius-devel/server/request.h>
 #include <freeradius-devel/server/trunk.h>
 #include <freeradius-devel/redis/io.h>
+#include <freeradius-devel/redis/cluster.h>
 #include <hiredis/async.h>
 
 #ifdef __cplusplus
@@ -66,12 +67,11 @@ typedef void (*fr_redis_command_set_fail_t)(REQUEST *request, fr_dlist_head_t *c
 fr_redis_pipeline_status_t	fr_redis_command_preformatted_add(fr_redis_command_set_t *cmds,
 							     	  char const *cmd_str, size_t cmd_len);
 
-/*
- *	TEMPORARY
- */
-fr_redis_pipeline_status_t redis_command_set_enqueue(fr_redis_trunk_t *rtrunk, fr_redis_command_set_t *cmds);
+fr_redis_pipeline_status_t	fr_redis_command_add(fr_redis_command_set_t *cmds, char const *fmt, ...);
+
+redisReply			*fr_redis_command_get_result(fr_redis_command_t *cmd);
 
-redisReply *fr_redis_command_get_result(fr_redis_command_t *cmd);
+redisReply			*fr_redis_command_steal_result(fr_redis_command_t *cmd);
 
 fr_redis_command_set_t		*fr_redis_command_set_alloc(TALLOC_CTX *ctx,
 							    REQUEST *request,
@@ -79,10 +79,20 @@ fr_redis_command_set_t		*fr_redis_command_set_alloc(TALLOC_CTX *ctx,
 							    fr_redis_command_set_fail_t fail,
 							    void *rctx);
 
-fr_redis_trunk_t		*fr_redis_trunk_alloc(fr_redis_cluster_thread_t *rtcluster,
-						      fr_redis_io_conf_t const *conf);
+void				fr_redis_command_set_signal_cancel(fr_redis_command_set_t *cmds);
+
+fr_redis_pipeline_status_t	fr_redis_command_set_enqueue(fr_redis_cluster_thread_t *cluster_thread,
+							     fr_redis_command_set_t *cmds,
+							     uint8_t const *key, size_t key_len);
+
+fr_redis_pipeline_status_t	fr_redis_trunk_command_set_enqueue(fr_redis_trunk_t *rtrunk,
+								   fr_redis_command_set_t *cmds);
+
+fr_redis_trunk_t		*fr_redis_trunk_alloc(fr_redis_cluster_thread_t *cluster_thread,
+						      fr_redis_io_conf_t const *io_conf);
 
 fr_redis_cluster_thread_t	*fr_redis_cluster_thread_alloc(TALLOC_CTX *ctx, fr_event_list_t *el,
+							       fr_redis_cluster_t *cluster,
 							       fr_trunk_conf_t const *tconf);
 
 #ifdef __cplusplus
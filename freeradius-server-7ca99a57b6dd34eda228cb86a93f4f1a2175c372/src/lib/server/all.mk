@@ -1,3 +1,4 @@
 SUBMAKEFILES := \
 	libfreeradius-server.mk \
-	trunk_tests.mk
+	trunk_tests.mk \
+	state_tests.mk
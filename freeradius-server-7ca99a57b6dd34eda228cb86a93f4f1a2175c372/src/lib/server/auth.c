@@ -51,14 +51,14 @@ rlm_rcode_t rad_virtual_server(REQUEST *request)
 	rlm_rcode_t final;
 
 	RDEBUG("Virtual server %s received request", cf_section_name2(request->server_cs));
-	log_request_pair_list(L_DBG_LVL_1, request, request->packet->vps, NULL);
+	log_request_pair_list(L_DBG_LVL_1, request, fr_pair_list_head(&request->packet->vps), NULL);
 
-	username = fr_pair_find_by_num(request->packet->vps, 0, FR_STRIPPED_USER_NAME, TAG_ANY);
-	if (!username) username = fr_pair_find_by_num(request->packet->vps, 0, FR_USER_NAME, TAG_ANY);
+	username = fr_pair_find_by_num(fr_pair_list_head(&request->packet->vps), 0, FR_STRIPPED_USER_NAME, TAG_ANY);
+	if (!username) username = fr_pair_find_by_num(fr_pair_list_head(&request->packet->vps), 0, FR_USER_NAME, TAG_ANY);
 
 	if (request->parent) {
-		parent_username = fr_pair_find_by_num(request->parent->packet->vps, 0, FR_STRIPPED_USER_NAME, TAG_ANY);
-		if (!parent_username) parent_username = fr_pair_find_by_num(request->parent->packet->vps, 0, FR_USER_NAME, TAG_ANY);
+		parent_username = fr_pair_find_by_num(fr_pair_list_head(&request->parent->packet->vps), 0, FR_STRIPPED_USER_NAME, TAG_ANY);
+		if (!parent_username) parent_username = fr_pair_find_by_num(fr_pair_list_head(&request->parent->packet->vps), 0, FR_USER_NAME, TAG_ANY);
 	}
 
 	/*
@@ -69,7 +69,7 @@ rlm_rcode_t rad_virtual_server(REQUEST *request)
 		 *	Look at the full User-Name with realm.
 		 */
 		if (parent_username->da->attr == FR_STRIPPED_USER_NAME) {
-			vp = fr_pair_find_by_num(request->parent->packet->vps, 0, FR_USER_NAME, TAG_ANY);
+			vp = fr_pair_find_by_num(fr_pair_list_head(&request->parent->packet->vps), 0, FR_USER_NAME, TAG_ANY);
 			if (!vp) goto runit;
 		} else {
 			vp = parent_username;
@@ -219,8 +219,8 @@ void common_packet_debug(REQUEST *request, RADIUS_PACKET *packet, bool received)
 		       packet->data_len);
 
 	if (received) {
-		log_request_pair_list(L_DBG_LVL_1, request, packet->vps, NULL);
+		log_request_pair_list(L_DBG_LVL_1, request, fr_pair_list_head(&packet->vps), NULL);
 	} else {
-		log_request_proto_pair_list(L_DBG_LVL_1, request, packet->vps, NULL);
+		log_request_proto_pair_list(L_DBG_LVL_1, request, fr_pair_list_head(&packet->vps), NULL);
 	}
 }
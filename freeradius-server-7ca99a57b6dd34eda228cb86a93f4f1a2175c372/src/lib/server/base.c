@@ -53,6 +53,11 @@ int server_init(CONF_SECTION *cs)
 	 */
 	if (password_init() < 0) return -1;
 
+	/*
+	 *	Set up attributes for exfile statistics
+	 */
+	if (exfile_global_init() < 0) return -1;
+
 	/*
 	 *	Initialize Auth-Type, etc. in the virtual servers
 	 *	before loading the modules.  Some modules need those
@@ -97,6 +102,11 @@ void server_free(void)
 	 */
 	password_free();
 
+	/*
+	 *	Free exfile dictionaries
+	 */
+	exfile_global_free();
+
 	/*
 	 *	Free xlat instance data, and call any detach methods
 	 */
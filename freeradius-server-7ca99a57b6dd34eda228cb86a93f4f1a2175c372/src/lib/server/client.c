@@ -879,6 +879,8 @@ RADCLIENT *client_afrom_cs(TALLOC_CTX *ctx, CONF_SECTION *cs, CONF_SECTION *serv
 	}
 #endif
 
+	client_secret_md5_init(c);
+
 	if ((c->proto == IPPROTO_TCP) || (c->proto == IPPROTO_IP)) {
 		if ((c->limit.idle_timeout > 0) && (c->limit.idle_timeout < 5))
 			c->limit.idle_timeout = 5;
@@ -933,9 +935,30 @@ RADCLIENT *client_afrom_query(TALLOC_CTX *ctx, char const *identifier, char cons
 	if (server) c->server = talloc_typed_strdup(c, server);
 	c->message_authenticator = require_ma;
 
+	client_secret_md5_init(c);
+
 	return c;
 }
 
+/** Pre-hash the client's shared secret
+ *
+ * User-Password and Tunnel-Password hiding both start with MD5(secret + ...),
+ * so the state after hashing the secret is calculated once here, and
+ * cloned for each packet.
+ *
+ * MUST be called whenever the secret changes.
+ *
+ * @param[in] client	to update.
+ */
+void client_secret_md5_init(RADCLIENT *client)
+{
+	fr_md5_state_init(&client->secret_md5);
+	if (!client->secret) return;
+
+	fr_md5_state_update(&client->secret_md5, (uint8_t const *) client->secret,
+			    talloc_array_length(client->secret) - 1);
+}
+
 /** Create a new client, consuming all attributes in the control list of the request
  *
  * @param ctx the talloc context
@@ -961,12 +984,12 @@ RADCLIENT *client_afrom_request(TALLOC_CTX *ctx, REQUEST *request)
 
 	cs = cf_section_alloc(ctx, NULL, "client", buffer);
 
-	fr_cursor_init(&cursor, &request->control);
+	fr_pair_list_cursor_init(&cursor, &request->control);
 
 	RDEBUG2("Converting &request:control to client {...} section");
 	RINDENT();
 
-	for (vp = fr_cursor_init(&cursor, &request->control);
+	for (vp = fr_pair_list_cursor_init(&cursor, &request->control);
 	     vp != NULL;
 	     vp = fr_cursor_next(&cursor)) {
 		CONF_PAIR	*cp = NULL;
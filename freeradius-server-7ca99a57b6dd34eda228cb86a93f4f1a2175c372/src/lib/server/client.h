@@ -70,6 +70,7 @@ typedef int (*client_value_cb_t)(char **out, CONF_PAIR const *cp, void *data);
 #include <freeradius-devel/server/socket.h>
 #include <freeradius-devel/server/stats.h>
 #include <freeradius-devel/util/inet.h>
+#include <freeradius-devel/util/md5.h>
 
 /** Describes a host allowed to send packets to the server
  *
@@ -83,6 +84,9 @@ struct rad_client {
 	char const		*shortname;		//!< Client nickname.
 
 	char const		*secret;		//!< Secret PSK.
+	fr_md5_state_t		secret_md5;		//!< MD5 state with the secret already hashed in.
+							///< Cloned for each packet which hides passwords.
+							///< Set by #client_secret_md5_init.
 
 	bool			message_authenticator;	//!< Require RADIUS message authenticator in requests.
 	bool			dynamic;		//!< Whether the client was dynamically defined.
@@ -127,6 +131,8 @@ void		client_delete(RADCLIENT_LIST *clients, RADCLIENT *client);
 
 RADCLIENT	*client_afrom_request(TALLOC_CTX *ctx, REQUEST *request);
 
+void		client_secret_md5_init(RADCLIENT *client) CC_HINT(nonnull);
+
 int		client_map_section(CONF_SECTION *out, CONF_SECTION const *map, client_value_cb_t func, void *data);
 
 RADCLIENT	*client_afrom_cs(TALLOC_CTX *ctx, CONF_SECTION *cs, CONF_SECTION *server_cs);
@@ -236,8 +236,17 @@ static int cond_do_regex(REQUEST *request, fr_cond_t const *c,
 	default:
 		if (!fr_cond_assert(rhs && rhs->type == FR_TYPE_STRING)) return -1;
 		if (!fr_cond_assert(rhs && rhs->vb_strvalue)) return -1;
+		/*
+		 *	Expanded patterns are usually the same across
+		 *	requests, so reuse the compiled version.
+		 */
+#if defined(HAVE_REGEX_PCRE) || defined(HAVE_REGEX_PCRE2)
+		slen = regex_compile_cached(&rreg, rhs->vb_strvalue, rhs->datum.length,
+					    &tmpl_regex_flags(map->rhs), true);
+#else
 		slen = regex_compile(request, &rreg, rhs->vb_strvalue, rhs->datum.length,
 				     &tmpl_regex_flags(map->rhs), true, true);
+#endif
 		if (slen <= 0) {
 			REMARKER(rhs->vb_strvalue, -slen, "%s", fr_strerror());
 			EVAL_DEBUG("FAIL %d", __LINE__);
@@ -277,7 +286,9 @@ static int cond_do_regex(REQUEST *request, fr_cond_t const *c,
 	}
 
 	talloc_free(regmatch);	/* free if not consumed */
+#if !defined(HAVE_REGEX_PCRE) && !defined(HAVE_REGEX_PCRE2)
 	if (preg) talloc_free(rreg);
+#endif
 
 	return ret;
 }
@@ -351,7 +362,7 @@ static int cond_cmp_values(REQUEST *request, fr_cond_t const *c, fr_value_box_t
 
 		fr_value_box_copy(vp, &vp->data, rhs);
 
-		rcode = paircmp(request, request->packet->vps, vp, NULL);
+		rcode = paircmp(request, fr_pair_list_head(&request->packet->vps), vp, NULL);
 		rcode = (rcode == 0) ? 1 : 0;
 		talloc_free(vp);
 		goto finish;
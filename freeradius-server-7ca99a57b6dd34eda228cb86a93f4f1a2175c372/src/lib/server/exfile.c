@@ -30,7 +30,21 @@
 #include <freeradius-devel/util/misc.h>
 
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <sched.h>
+#include <signal.h>
+
+#ifdef HAVE_STDATOMIC_H
+#  include <stdatomic.h>
+#else
+#  include <freeradius-devel/util/stdatomic.h>
+#endif
+
+#ifndef IOV_MAX
+#  define IOV_MAX 1024
+#endif
 
 typedef struct {
 	int			fd;			//!< File descriptor associated with an entry.
@@ -39,8 +53,27 @@ typedef struct {
 	dev_t			st_dev;			//!< device inode
 	ino_t			st_ino;			//!< inode number
 	char			*filename;		//!< Filename.
+	bool			dirty;			//!< Written to since the last fsync.
 } exfile_entry_t;
 
+typedef struct exfile_record_s exfile_record_t;
+
+/** A formatted record waiting for the writer thread
+ *
+ * Records are allocated with malloc() as they're created by one thread
+ * and freed by another.
+ */
+struct exfile_record_s {
+	_Atomic(exfile_record_t *) next;		//!< Next record in the queue.
+	char const		*filename;		//!< File to append the record to.
+	uint32_t		hash;			//!< Hash of the filename.
+	mode_t			permissions;		//!< To use if the file is created.
+	gid_t			gid;			//!< Group to set on the file, or -1.
+	fr_time_t		enqueued;		//!< When the record was queued.
+	size_t			len;			//!< Length of the record data.
+	uint8_t			*data;			//!< Record data.
+};
+
 
 struct exfile_s {
 	uint32_t		max_entries;		//!< How many file descriptors we keep track of.
@@ -52,8 +85,72 @@ struct exfile_s {
 	CONF_SECTION		*conf;			//!< Conf section to search for triggers.
 	char const		*trigger_prefix;	//!< Trigger path in the global trigger section.
 	VALUE_PAIR		*trigger_args;		//!< Arguments to pass to trigger.
+
+	struct {
+		exfile_async_conf_t	conf;		//!< Writer thread configuration.
+		bool			running;	//!< Whether the writer thread was started.
+		bool			stop;		//!< Drain the queue and exit.  Protected by mutex.
+		pthread_t		thread;		//!< Writer thread.
+
+		pthread_mutex_t		mutex;		//!< Protects the condition variables.
+		pthread_cond_t		work;		//!< Signalled when the queue becomes non-empty.
+		pthread_cond_t		space;		//!< Signalled when the writer has drained records.
+		uint32_t		blocked;	//!< Producers waiting for space.  Protected by mutex.
+
+		atomic_uint_fast32_t	pending;	//!< Records reserved but not yet written.
+		_Atomic(exfile_record_t *) head;	//!< Producers append records here.
+		exfile_record_t		*tail;		//!< Only touched by the writer thread.
+		exfile_record_t		stub;		//!< Sentinel so the queue is never empty.
+
+		fr_time_t		last_sync;	//!< When dirty files were last fsynced.
+
+		atomic_uint_fast64_t	records;	//!< Records written.
+		atomic_uint_fast64_t	bytes;		//!< Bytes written.
+		atomic_uint_fast64_t	batches;	//!< Calls to writev().
+		atomic_uint_fast64_t	failed;		//!< Records the writer failed to write.
+		atomic_uint_fast64_t	dropped;	//!< Records rejected because the queue was full.
+		atomic_uint_fast64_t	latency_last;	//!< Enqueue to write latency of the last record.
+		atomic_uint_fast64_t	latency_max;	//!< Highest enqueue to write latency.
+		atomic_uint_fast64_t	latency_total;	//!< Sum of all enqueue to write latencies.
+	} async;
+};
+
+CONF_PARSER const exfile_async_config[] = {
+	{ FR_CONF_OFFSET("enable", FR_TYPE_BOOL, exfile_async_conf_t, enabled), .dflt = "no" },
+	{ FR_CONF_OFFSET("queue_size", FR_TYPE_UINT32, exfile_async_conf_t, queue_size), .dflt = "8192" },
+	{ FR_CONF_OFFSET("max_wait", FR_TYPE_TIME_DELTA, exfile_async_conf_t, max_wait), .dflt = "0.1" },
+	{ FR_CONF_OFFSET("fsync_interval", FR_TYPE_TIME_DELTA, exfile_async_conf_t, fsync_interval), .dflt = "0" },
+	CONF_PARSER_TERMINATOR
 };
 
+static fr_dict_t const *dict_freeradius;
+
+extern fr_dict_autoload_t exfile_dict[];
+fr_dict_autoload_t exfile_dict[] = {
+	{ .out = &dict_freeradius, .proto = "freeradius" },
+	{ NULL }
+};
+
+static fr_dict_attr_t const *attr_exfile_queue_depth;
+static fr_dict_attr_t const *attr_exfile_records_written;
+static fr_dict_attr_t const *attr_exfile_records_dropped;
+static fr_dict_attr_t const *attr_exfile_write_latency;
+static fr_dict_attr_t const *attr_exfile_write_latency_max;
+static fr_dict_attr_t const *attr_exfile_write_latency_avg;
+
+extern fr_dict_attr_autoload_t exfile_dict_attr[];
+fr_dict_attr_autoload_t exfile_dict_attr[] = {
+	{ .out = &attr_exfile_queue_depth, .name = "Exfile-Queue-Depth", .type = FR_TYPE_UINT32, .dict = &dict_freeradius },
+	{ .out = &attr_exfile_records_written, .name = "Exfile-Records-Written", .type = FR_TYPE_UINT64, .dict = &dict_freeradius },
+	{ .out = &attr_exfile_records_dropped, .name = "Exfile-Records-Dropped", .type = FR_TYPE_UINT64, .dict = &dict_freeradius },
+	{ .out = &attr_exfile_write_latency, .name = "Exfile-Write-Latency", .type = FR_TYPE_UINT64, .dict = &dict_freeradius },
+	{ .out = &attr_exfile_write_latency_max, .name = "Exfile-Write-Latency-Max", .type = FR_TYPE_UINT64, .dict = &dict_freeradius },
+	{ .out = &attr_exfile_write_latency_avg, .name = "Exfile-Write-Latency-Avg", .type = FR_TYPE_UINT64, .dict = &dict_freeradius },
+	{ NULL }
+};
+
+#define EXFILE_BATCH_MAX 256		//!< Most records the writer thread dequeues at once.
+
 #define MAX_TRY_LOCK 4			//!< How many times we attempt to acquire a lock
 					//!< before giving up.
 
@@ -99,9 +196,13 @@ static inline void exfile_trigger_exec(exfile_t *ef, REQUEST *request, exfile_en
 
 static void exfile_cleanup_entry(exfile_t *ef, REQUEST *request, exfile_entry_t *entry)
 {
-	if (entry->fd >= 0) close(entry->fd);
+	if (entry->fd >= 0) {
+		if (entry->dirty) (void) fsync(entry->fd);
+		close(entry->fd);
+	}
 
 	entry->hash = 0;
+	entry->dirty = false;
 	entry->fd = -1;
 
 	/*
@@ -116,10 +217,20 @@ static void exfile_cleanup_entry(exfile_t *ef, REQUEST *request, exfile_entry_t
 }
 
 
+static void exfile_async_stop(exfile_t *ef);
+
 static int _exfile_free(exfile_t *ef)
 {
 	uint32_t i;
 
+	/*
+	 *	Let the writer thread flush everything that
+	 *	was queued before we close the files.
+	 */
+	if (ef->async.running) exfile_async_stop(ef);
+
+	if (!ef->entries) return 0;
+
 	pthread_mutex_lock(&ef->mutex);
 
 	for (i = 0; i < ef->max_entries; i++) {
@@ -134,6 +245,22 @@ static int _exfile_free(exfile_t *ef)
 	return 0;
 }
 
+/** Allocate the file descriptor cache
+ *
+ */
+static int exfile_entries_alloc(exfile_t *ef)
+{
+	ef->entries = talloc_zero_array(ef, exfile_entry_t, ef->max_entries);
+	if (!ef->entries) return -1;
+
+	if (pthread_mutex_init(&ef->mutex, NULL) != 0) {
+		TALLOC_FREE(ef->entries);
+		return -1;
+	}
+
+	return 0;
+}
+
 /** Initialize a way for multiple threads to log to one or more files.
  *
  * @param ctx The talloc context
@@ -157,6 +284,8 @@ exfile_t *exfile_init(TALLOC_CTX *ctx, uint32_t max_entries, uint32_t max_idle,
 	ef->max_idle = max_idle;
 	ef->locking = locking;
 
+	talloc_set_destructor(ef, _exfile_free);
+
 	/*
 	 *	If we're not locking the files, just return the
 	 *	handle.  Each call to exfile_open() will just open a
@@ -164,19 +293,11 @@ exfile_t *exfile_init(TALLOC_CTX *ctx, uint32_t max_entries, uint32_t max_idle,
 	 */
 	if (!ef->locking) return ef;
 
-	ef->entries = talloc_zero_array(ef, exfile_entry_t, max_entries);
-	if (!ef->entries) {
-		talloc_free(ef);
-		return NULL;
-	}
-
-	if (pthread_mutex_init(&ef->mutex, NULL) != 0) {
+	if (exfile_entries_alloc(ef) < 0) {
 		talloc_free(ef);
 		return NULL;
 	}
 
-	talloc_set_destructor(ef, _exfile_free);
-
 	return ef;
 }
 
@@ -284,9 +405,9 @@ int exfile_open(exfile_t *ef, REQUEST *request, char const *filename, mode_t per
 	if (!ef || !filename) return -1;
 
 	/*
-	 *	No locking: just return a new FD.
+	 *	No FD cache: just return a new FD.
 	 */
-	if (!ef->locking) {
+	if (!ef->entries) {
 		found = exfile_open_mkdir(ef, filename, permissions);
 		if (found < 0) return -1;
 
@@ -404,16 +525,21 @@ reopen:
 	exfile_trigger_exec(ef, request, &ef->entries[i], "open");
 
 try_lock:
+	/*
+	 *	The FD cache is also used without locking when
+	 *	there's a writer thread.  In that case the writer
+	 *	thread is the only thing writing to the file, and
+	 *	the inode checks above and below take care of
+	 *	rotation.
+	 */
+	if (!ef->locking) goto check;
+
 	/*
 	 *	Lock from the start of the file.
 	 */
 	if (lseek(ef->entries[i].fd, 0, SEEK_SET) < 0) {
 		fr_strerror_printf("Failed to seek in file %s: %s", filename, fr_syserror(errno));
-
-	error:
-		exfile_cleanup_entry(ef, request, &ef->entries[i]);
-		pthread_mutex_unlock(&(ef->mutex));
-		return -1;
+		goto error;
 	}
 
 	/*
@@ -443,6 +569,8 @@ try_lock:
 		goto error;
 	}
 
+check:
+
 	/*
 	 *	Maybe someone deleted the file while we were waiting
 	 *	for the lock.  If so, re-open it.
@@ -506,6 +634,11 @@ try_lock:
 
 	/* coverity[missing_unlock] */
 	return ef->entries[i].fd;
+
+error:
+	exfile_cleanup_entry(ef, request, &ef->entries[i]);
+	pthread_mutex_unlock(&(ef->mutex));
+	return -1;
 }
 
 /** Close the log file.  Really just return it to the pool.
@@ -526,9 +659,9 @@ int exfile_close(exfile_t *ef, REQUEST *request, int fd)
 	uint32_t i;
 
 	/*
-	 *	No locking: just close the file.
+	 *	No FD cache: just close the file.
 	 */
-	if (!ef->locking) {
+	if (!ef->entries) {
 		close(fd);
 		return 0;
 	}
@@ -539,8 +672,10 @@ int exfile_close(exfile_t *ef, REQUEST *request, int fd)
 	for (i = 0; i < ef->max_entries; i++) {
 		if (ef->entries[i].fd != fd) continue;
 
-		(void) lseek(ef->entries[i].fd, 0, SEEK_SET);
-		(void) rad_unlockfd(ef->entries[i].fd, 0);
+		if (ef->locking) {
+			(void) lseek(ef->entries[i].fd, 0, SEEK_SET);
+			(void) rad_unlockfd(ef->entries[i].fd, 0);
+		}
 		pthread_mutex_unlock(&(ef->mutex));
 
 		exfile_trigger_exec(ef, request, &ef->entries[i], "release");
@@ -552,3 +687,576 @@ int exfile_close(exfile_t *ef, REQUEST *request, int fd)
 	fr_strerror_printf("Attempt to unlock file which is not tracked");
 	return -1;
 }
+
+/** Write out a complete vector, retrying on short writes
+ *
+ */
+static ssize_t exfile_writev(int fd, struct iovec *vector, int vector_len)
+{
+	ssize_t total = 0;
+
+	while (vector_len > 0) {
+		ssize_t slen;
+
+		slen = writev(fd, vector, vector_len > IOV_MAX ? IOV_MAX : vector_len);
+		if (slen < 0) {
+			if (errno == EINTR) continue;
+			return -1;
+		}
+		total += slen;
+
+		while ((vector_len > 0) && ((size_t)slen >= vector->iov_len)) {
+			slen -= vector->iov_len;
+			vector++;
+			vector_len--;
+		}
+
+		if (slen > 0) {
+			vector->iov_base = ((uint8_t *)vector->iov_base) + slen;
+			vector->iov_len -= slen;
+		}
+	}
+
+	return total;
+}
+
+/** Add a record to the queue
+ *
+ * Multiple producers, single consumer.  Producers swap themselves in
+ * as the new head, then link the previous head to the new record.
+ */
+static inline void exfile_async_push(exfile_t *ef, exfile_record_t *rec)
+{
+	exfile_record_t *prev;
+
+	atomic_store_explicit(&rec->next, NULL, memory_order_relaxed);
+	prev = atomic_exchange_explicit(&ef->async.head, rec, memory_order_acq_rel);
+	atomic_store_explicit(&prev->next, rec, memory_order_release);
+}
+
+/** Remove the oldest record from the queue
+ *
+ * Must only be called by the writer thread.
+ *
+ * @return
+ *	- The oldest record.
+ *	- NULL if the queue is empty, or a producer is part way
+ *	  through adding a record.
+ */
+static exfile_record_t *exfile_async_pop(exfile_t *ef)
+{
+	exfile_record_t *tail = ef->async.tail;
+	exfile_record_t *next = atomic_load_explicit(&tail->next, memory_order_acquire);
+
+	if (tail == &ef->async.stub) {
+		if (!next) return NULL;
+
+		ef->async.tail = tail = next;
+		next = atomic_load_explicit(&tail->next, memory_order_acquire);
+	}
+
+	if (next) {
+		ef->async.tail = next;
+		return tail;
+	}
+
+	/*
+	 *	A producer has swapped in a new head, but hasn't
+	 *	linked it to this record yet.
+	 */
+	if (tail != atomic_load_explicit(&ef->async.head, memory_order_acquire)) return NULL;
+
+	/*
+	 *	This is the last record.  Put the stub back so
+	 *	there's always something for producers to link to.
+	 */
+	exfile_async_push(ef, &ef->async.stub);
+
+	next = atomic_load_explicit(&tail->next, memory_order_acquire);
+	if (next) {
+		ef->async.tail = next;
+		return tail;
+	}
+
+	return NULL;
+}
+
+/** Convert a delay into an absolute time for pthread_cond_timedwait()
+ *
+ */
+static void exfile_async_deadline(struct timespec *ts, fr_time_delta_t delay)
+{
+	clock_gettime(CLOCK_REALTIME, ts);
+
+	ts->tv_sec += delay / NSEC;
+	ts->tv_nsec += delay % NSEC;
+	if (ts->tv_nsec >= NSEC) {
+		ts->tv_sec++;
+		ts->tv_nsec -= NSEC;
+	}
+}
+
+/** Reserve space in the queue for a record
+ *
+ * If the queue is full, wait up to max_wait for the writer thread
+ * to drain it.  This pushes back on the workers when the disk can't
+ * keep up, instead of letting the queue grow without bound.
+ */
+static int exfile_async_reserve(exfile_t *ef, REQUEST *request)
+{
+	uint_fast32_t	pending;
+	bool		waited = false;
+
+	pending = atomic_load_explicit(&ef->async.pending, memory_order_relaxed);
+	for (;;) {
+		struct timespec deadline;
+
+		if (pending < ef->async.conf.queue_size) {
+			if (atomic_compare_exchange_weak_explicit(&ef->async.pending, &pending, pending + 1,
+								  memory_order_acq_rel, memory_order_relaxed)) break;
+			continue;
+		}
+
+		if (waited || !ef->async.conf.max_wait) {
+			atomic_fetch_add_explicit(&ef->async.dropped, 1, memory_order_relaxed);
+			ROPTIONAL(RERROR, ERROR, "Write queue full (%u records), discarding record",
+				  ef->async.conf.queue_size);
+			return -1;
+		}
+
+		exfile_async_deadline(&deadline, ef->async.conf.max_wait);
+
+		pthread_mutex_lock(&ef->async.mutex);
+		ef->async.blocked++;
+		while (atomic_load_explicit(&ef->async.pending, memory_order_relaxed) >= ef->async.conf.queue_size) {
+			if (pthread_cond_timedwait(&ef->async.space, &ef->async.mutex, &deadline) == ETIMEDOUT) break;
+		}
+		ef->async.blocked--;
+		pthread_mutex_unlock(&ef->async.mutex);
+
+		waited = true;
+		pending = atomic_load_explicit(&ef->async.pending, memory_order_relaxed);
+	}
+
+	/*
+	 *	Only the producer which makes the queue non-empty
+	 *	needs to wake the writer thread.  The writer checks
+	 *	pending with the mutex held before sleeping, so the
+	 *	wakeup can't be lost.
+	 */
+	if (pending == 0) {
+		pthread_mutex_lock(&ef->async.mutex);
+		pthread_cond_signal(&ef->async.work);
+		pthread_mutex_unlock(&ef->async.mutex);
+	}
+
+	return 0;
+}
+
+/** Write all records in a batch which are for the same file
+ *
+ * Records for the same file are written with a single writev() call,
+ * in the order they were queued.
+ *
+ * @param[in] ef	to write to.
+ * @param[in] batch	of records.  Records which are written are removed.
+ * @param[in] start	First record to write.
+ * @param[in] count	Number of records in the batch.
+ */
+static void exfile_async_write_file(exfile_t *ef, exfile_record_t **batch, int start, int count)
+{
+	struct iovec	vector[EXFILE_BATCH_MAX];
+	exfile_record_t	*group[EXFILE_BATCH_MAX];
+	exfile_record_t	*first = batch[start];
+	int		fd, i, num = 0;
+	ssize_t		slen = -1;
+	fr_time_t	now;
+
+	for (i = start; i < count; i++) {
+		if (!batch[i] || (batch[i]->hash != first->hash) ||
+		    (strcmp(batch[i]->filename, first->filename) != 0)) continue;
+
+		vector[num].iov_base = batch[i]->data;
+		vector[num].iov_len = batch[i]->len;
+		group[num++] = batch[i];
+		batch[i] = NULL;
+	}
+
+	fd = exfile_open(ef, NULL, first->filename, first->permissions);
+	if (fd < 0) {
+		PERROR("Failed opening %s", first->filename);
+		goto done;
+	}
+
+	if ((first->gid != (gid_t)-1) && (fchown(fd, -1, first->gid) < 0)) {
+		DEBUG2("Unable to change system group of \"%s\": %s", first->filename, fr_syserror(errno));
+	}
+
+	slen = exfile_writev(fd, vector, num);
+	if (slen < 0) {
+		ERROR("Failed writing to \"%s\": %s", first->filename, fr_syserror(errno));
+	} else if (ef->async.conf.fsync_interval) {
+		for (i = 0; i < (int)ef->max_entries; i++) {
+			if (ef->entries[i].fd != fd) continue;
+
+			ef->entries[i].dirty = true;
+			break;
+		}
+	}
+
+	exfile_close(ef, NULL, fd);
+
+done:
+	if (slen < 0) {
+		atomic_fetch_add_explicit(&ef->async.failed, num, memory_order_relaxed);
+	} else {
+		atomic_fetch_add_explicit(&ef->async.records, num, memory_order_relaxed);
+		atomic_fetch_add_explicit(&ef->async.bytes, slen, memory_order_relaxed);
+		atomic_fetch_add_explicit(&ef->async.batches, 1, memory_order_relaxed);
+	}
+
+	now = fr_time();
+	for (i = 0; i < num; i++) {
+		uint64_t latency = now - group[i]->enqueued;
+
+		atomic_store_explicit(&ef->async.latency_last, latency, memory_order_relaxed);
+		atomic_fetch_add_explicit(&ef->async.latency_total, latency, memory_order_relaxed);
+		if (latency > atomic_load_explicit(&ef->async.latency_max, memory_order_relaxed)) {
+			atomic_store_explicit(&ef->async.latency_max, latency, memory_order_relaxed);
+		}
+
+		free(group[i]);
+	}
+}
+
+/** fsync() every file that has been written to since the last call
+ *
+ */
+static void exfile_async_sync(exfile_t *ef)
+{
+	uint32_t i;
+
+	pthread_mutex_lock(&ef->mutex);
+	for (i = 0; i < ef->max_entries; i++) {
+		if (!ef->entries[i].filename || !ef->entries[i].dirty) continue;
+
+		if (fsync(ef->entries[i].fd) < 0) {
+			ERROR("Failed syncing \"%s\": %s", ef->entries[i].filename, fr_syserror(errno));
+		}
+		ef->entries[i].dirty = false;
+	}
+	pthread_mutex_unlock(&ef->mutex);
+
+	ef->async.last_sync = fr_time();
+}
+
+/** Drain the queue, coalescing records into one write per file
+ *
+ */
+static void *exfile_async_thread(void *arg)
+{
+	exfile_t	*ef = talloc_get_type_abort(arg, exfile_t);
+	exfile_record_t	*batch[EXFILE_BATCH_MAX];
+	fr_time_delta_t	idle = ef->async.conf.fsync_interval ? ef->async.conf.fsync_interval : NSEC;
+	sigset_t	sigset;
+
+	/*
+	 *	Signals are for the main thread.
+	 */
+	sigfillset(&sigset);
+	pthread_sigmask(SIG_BLOCK, &sigset, NULL);
+
+	for (;;) {
+		struct timespec	deadline;
+		int		count, i;
+
+		for (count = 0; count < EXFILE_BATCH_MAX; count++) {
+			batch[count] = exfile_async_pop(ef);
+			if (!batch[count]) break;
+		}
+
+		if (count > 0) {
+			for (i = 0; i < count; i++) {
+				if (batch[i]) exfile_async_write_file(ef, batch, i, count);
+			}
+
+			atomic_fetch_sub_explicit(&ef->async.pending, count, memory_order_acq_rel);
+
+			pthread_mutex_lock(&ef->async.mutex);
+			if (ef->async.blocked) pthread_cond_broadcast(&ef->async.space);
+			pthread_mutex_unlock(&ef->async.mutex);
+		}
+
+		if (ef->async.conf.fsync_interval &&
+		    ((fr_time() - ef->async.last_sync) >= ef->async.conf.fsync_interval)) exfile_async_sync(ef);
+
+		if (count == EXFILE_BATCH_MAX) continue;
+
+		/*
+		 *	A producer has reserved space but hasn't
+		 *	finished adding its record.
+		 */
+		if ((count == 0) && (atomic_load_explicit(&ef->async.pending, memory_order_acquire) > 0)) {
+			sched_yield();
+			continue;
+		}
+
+		exfile_async_deadline(&deadline, idle);
+
+		pthread_mutex_lock(&ef->async.mutex);
+		if (atomic_load_explicit(&ef->async.pending, memory_order_acquire) == 0) {
+			if (ef->async.stop) {
+				pthread_mutex_unlock(&ef->async.mutex);
+				break;
+			}
+			pthread_cond_timedwait(&ef->async.work, &ef->async.mutex, &deadline);
+		}
+		pthread_mutex_unlock(&ef->async.mutex);
+	}
+
+	if (ef->async.conf.fsync_interval) exfile_async_sync(ef);
+
+	return NULL;
+}
+
+/** Hand writes off to a dedicated writer thread
+ *
+ * Once started, exfile_write() copies each record into a queue and
+ * returns immediately.  The writer thread appends queued records to
+ * their files, combining records for the same file into one writev()
+ * call.  Rotation and locking are handled as with exfile_open().
+ *
+ * @param[in] ef	to start the writer thread for.
+ * @param[in] conf	for the writer thread.
+ * @return
+ *	- 0 on success.
+ *	- -1 on failure.
+ */
+int exfile_async_start(exfile_t *ef, exfile_async_conf_t const *conf)
+{
+	int ret;
+
+	if (ef->async.running) return 0;
+
+	/*
+	 *	The writer thread always keeps its files open,
+	 *	even if we're not locking them.
+	 */
+	if (!ef->entries && (exfile_entries_alloc(ef) < 0)) {
+		fr_strerror_printf("Failed allocating file descriptor cache");
+		return -1;
+	}
+
+	ef->async.conf = *conf;
+	if (ef->async.conf.queue_size == 0) ef->async.conf.queue_size = 1;
+
+	ef->async.stop = false;
+	ef->async.blocked = 0;
+	atomic_init(&ef->async.pending, 0);
+	atomic_init(&ef->async.stub.next, NULL);
+	atomic_init(&ef->async.head, &ef->async.stub);
+	ef->async.tail = &ef->async.stub;
+	ef->async.last_sync = fr_time();
+
+	pthread_mutex_init(&ef->async.mutex, NULL);
+	pthread_cond_init(&ef->async.work, NULL);
+	pthread_cond_init(&ef->async.space, NULL);
+
+	ret = pthread_create(&ef->async.thread, NULL, exfile_async_thread, ef);
+	if (ret != 0) {
+		fr_strerror_printf("Failed creating writer thread: %s", fr_syserror(ret));
+		pthread_cond_destroy(&ef->async.space);
+		pthread_cond_destroy(&ef->async.work);
+		pthread_mutex_destroy(&ef->async.mutex);
+		return -1;
+	}
+
+	ef->async.running = true;
+
+	return 0;
+}
+
+/** Flush the queue and stop the writer thread
+ *
+ */
+static void exfile_async_stop(exfile_t *ef)
+{
+	pthread_mutex_lock(&ef->async.mutex);
+	ef->async.stop = true;
+	pthread_cond_signal(&ef->async.work);
+	pthread_mutex_unlock(&ef->async.mutex);
+
+	pthread_join(ef->async.thread, NULL);
+
+	pthread_cond_destroy(&ef->async.space);
+	pthread_cond_destroy(&ef->async.work);
+	pthread_mutex_destroy(&ef->async.mutex);
+
+	ef->async.running = false;
+}
+
+/** Append a record to a file
+ *
+ * If the writer thread is running, the record is copied into the
+ * queue and written later.  Otherwise it is written immediately.
+ *
+ * @param[in] ef		The logfile context returned from exfile_init().
+ * @param[in] request		The current request.
+ * @param[in] filename		the file to append to.
+ * @param[in] permissions	to use if the file is created.
+ * @param[in] gid		Group to set on the file, or -1 to leave it unchanged.
+ * @param[in] vector		Record data.
+ * @param[in] vector_len	Number of elements in vector.
+ * @return
+ *	- 0 on success.
+ *	- -1 on failure, including when the queue is full.
+ */
+int exfile_write(exfile_t *ef, REQUEST *request, char const *filename, mode_t permissions, gid_t gid,
+		 struct iovec const *vector, int vector_len)
+{
+	exfile_record_t	*rec;
+	size_t		len = 0, name_len;
+	uint8_t		*p;
+	int		i;
+
+	if (!ef->async.running) {
+		struct iovec	*vector_s;
+		int		fd;
+		ssize_t		slen;
+
+		fd = exfile_open(ef, request, filename, permissions);
+		if (fd < 0) return -1;
+
+		if ((gid != (gid_t)-1) && (fchown(fd, -1, gid) < 0)) {
+			ROPTIONAL(RDEBUG2, DEBUG2, "Unable to change system group of \"%s\": %s",
+				  filename, fr_syserror(errno));
+		}
+
+		/*
+		 *	exfile_writev() adjusts the vector on short writes.
+		 */
+		MEM(vector_s = talloc_memdup(NULL, vector, sizeof(*vector) * vector_len));
+		slen = exfile_writev(fd, vector_s, vector_len);
+		if (slen < 0) fr_strerror_printf("Failed writing to \"%s\": %s", filename, fr_syserror(errno));
+		talloc_free(vector_s);
+
+		exfile_close(ef, request, fd);
+
+		return (slen < 0) ? -1 : 0;
+	}
+
+	for (i = 0; i < vector_len; i++) len += vector[i].iov_len;
+	name_len = strlen(filename) + 1;
+
+	rec = malloc(sizeof(*rec) + len + name_len);
+	if (!rec) {
+		fr_strerror_printf("Out of memory");
+		return -1;
+	}
+
+	p = (uint8_t *)(rec + 1);
+	rec->data = p;
+	rec->len = len;
+	for (i = 0; i < vector_len; i++) {
+		memcpy(p, vector[i].iov_base, vector[i].iov_len);
+		p += vector[i].iov_len;
+	}
+
+	memcpy(p, filename, name_len);
+	rec->filename = (char const *)p;
+	rec->hash = fr_hash_string(filename);
+	rec->permissions = permissions;
+	rec->gid = gid;
+
+	if (exfile_async_reserve(ef, request) < 0) {
+		free(rec);
+		fr_strerror_printf("Write queue full");
+		return -1;
+	}
+
+	rec->enqueued = fr_time();
+	exfile_async_push(ef, rec);
+
+	return 0;
+}
+
+/** Return statistics for the writer thread
+ *
+ * @param[out] out	Where to write the statistics.
+ * @param[in] ef	to get statistics for.
+ */
+void exfile_stats(exfile_stats_t *out, exfile_t *ef)
+{
+	memset(out, 0, sizeof(*out));
+
+	if (!ef->async.running) return;
+
+	out->queue_depth = atomic_load_explicit(&ef->async.pending, memory_order_relaxed);
+	out->records = atomic_load_explicit(&ef->async.records, memory_order_relaxed);
+	out->bytes = atomic_load_explicit(&ef->async.bytes, memory_order_relaxed);
+	out->batches = atomic_load_explicit(&ef->async.batches, memory_order_relaxed);
+	out->failed = atomic_load_explicit(&ef->async.failed, memory_order_relaxed);
+	out->dropped = atomic_load_explicit(&ef->async.dropped, memory_order_relaxed);
+	out->latency_last = atomic_load_explicit(&ef->async.latency_last, memory_order_relaxed);
+	out->latency_max = atomic_load_explicit(&ef->async.latency_max, memory_order_relaxed);
+	if (out->records + out->failed) {
+		out->latency_avg = atomic_load_explicit(&ef->async.latency_total, memory_order_relaxed) /
+				   (out->records + out->failed);
+	}
+}
+
+/** Add the writer thread statistics to the request list
+ *
+ * Latencies are added in microseconds.
+ *
+ * @param[in] request	to add the attributes to.
+ * @param[in] ef	to get statistics for.
+ */
+void exfile_stats_to_pairs(REQUEST *request, exfile_t *ef)
+{
+	exfile_stats_t	stats;
+	VALUE_PAIR	*vp;
+
+	exfile_stats(&stats, ef);
+
+	MEM(pair_update_request(&vp, attr_exfile_queue_depth) >= 0);
+	vp->vp_uint32 = stats.queue_depth;
+
+	MEM(pair_update_request(&vp, attr_exfile_records_written) >= 0);
+	vp->vp_uint64 = stats.records;
+
+	MEM(pair_update_request(&vp, attr_exfile_records_dropped) >= 0);
+	vp->vp_uint64 = stats.dropped;
+
+	MEM(pair_update_request(&vp, attr_exfile_write_latency) >= 0);
+	vp->vp_uint64 = fr_time_delta_to_usec(stats.latency_last);
+
+	MEM(pair_update_request(&vp, attr_exfile_write_latency_max) >= 0);
+	vp->vp_uint64 = fr_time_delta_to_usec(stats.latency_max);
+
+	MEM(pair_update_request(&vp, attr_exfile_write_latency_avg) >= 0);
+	vp->vp_uint64 = fr_time_delta_to_usec(stats.latency_avg);
+}
+
+/** Load the dictionary attributes used for statistics
+ *
+ */
+int exfile_global_init(void)
+{
+	if (fr_dict_autoload(exfile_dict) < 0) {
+		PERROR("%s", __FUNCTION__);
+		return -1;
+	}
+	if (fr_dict_attr_autoload(exfile_dict_attr) < 0) {
+		PERROR("%s", __FUNCTION__);
+		fr_dict_autofree(exfile_dict);
+		return -1;
+	}
+
+	return 0;
+}
+
+void exfile_global_free(void)
+{
+	fr_dict_autofree(exfile_dict);
+}
@@ -25,7 +25,11 @@
  */
 RCSIDH(exfile_h, "$Id$")
 
+#include <freeradius-devel/server/cf_parse.h>
 #include <freeradius-devel/server/request.h>
+#include <freeradius-devel/util/time.h>
+
+#include <sys/uio.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -35,6 +39,33 @@ extern "C" {
  */
 typedef struct exfile_s exfile_t;
 
+/** Configuration for the exfile writer thread
+ *
+ */
+typedef struct {
+	bool			enabled;		//!< Whether writes are handed off to a writer thread.
+	uint32_t		queue_size;		//!< Maximum number of records waiting to be written.
+	fr_time_delta_t		max_wait;		//!< How long a worker waits for space in a full queue.
+	fr_time_delta_t		fsync_interval;		//!< How often files are flushed to disk.  0 disables.
+} exfile_async_conf_t;
+
+/** Counters for the exfile writer thread
+ *
+ */
+typedef struct {
+	uint32_t		queue_depth;		//!< Records waiting to be written.
+	uint64_t		records;		//!< Records written.
+	uint64_t		bytes;			//!< Bytes written.
+	uint64_t		batches;		//!< writev() calls made by the writer thread.
+	uint64_t		failed;			//!< Records the writer thread failed to write.
+	uint64_t		dropped;		//!< Records discarded because the queue was full.
+	fr_time_delta_t		latency_last;		//!< Queue to disk latency of the last record.
+	fr_time_delta_t		latency_max;		//!< Highest queue to disk latency.
+	fr_time_delta_t		latency_avg;		//!< Mean queue to disk latency.
+} exfile_stats_t;
+
+extern CONF_PARSER const exfile_async_config[];
+
 exfile_t	*exfile_init(TALLOC_CTX *ctx, uint32_t entries, uint32_t idle, bool locking);
 
 void		exfile_enable_triggers(exfile_t *ef, CONF_SECTION *cs, char const *trigger_prefix,
@@ -45,6 +76,19 @@ int		exfile_open(exfile_t *lf, REQUEST *request, char const *filename,
 
 int		exfile_close(exfile_t *lf, REQUEST *request, int fd);
 
+int		exfile_async_start(exfile_t *ef, exfile_async_conf_t const *conf);
+
+int		exfile_write(exfile_t *ef, REQUEST *request, char const *filename, mode_t permissions, gid_t gid,
+			     struct iovec const *vector, int vector_len);
+
+void		exfile_stats(exfile_stats_t *out, exfile_t *ef);
+
+void		exfile_stats_to_pairs(REQUEST *request, exfile_t *ef);
+
+int		exfile_global_init(void);
+
+void		exfile_global_free(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -37,6 +37,9 @@ RCSID("$Id$")
 #include <freeradius-devel/server/util.h>
 #include <freeradius-devel/server/virtual_servers.h>
 
+#include <freeradius-devel/io/network.h>
+#include <freeradius-devel/io/schedule.h>
+
 #include <freeradius-devel/util/conf.h>
 #include <freeradius-devel/util/dict.h>
 #include <freeradius-devel/util/file.h>
@@ -158,12 +161,27 @@ static const CONF_PARSER resources[] = {
 	CONF_PARSER_TERMINATOR
 };
 
+static fr_table_num_sorted_t const network_dispatch_table[] = {
+	{ L("cpu_time"),	FR_NETWORK_DISPATCH_CPU_TIME	},
+	{ L("queue_depth"),	FR_NETWORK_DISPATCH_QUEUE_DEPTH	}
+};
+static size_t network_dispatch_table_len = NUM_ELEMENTS(network_dispatch_table);
+
 static const CONF_PARSER thread_config[] = {
 	{ FR_CONF_OFFSET("num_networks", FR_TYPE_UINT32, main_config_t, max_networks), .dflt = STRINGIFY(1),
 	  .func = num_networks_parse },
 	{ FR_CONF_OFFSET("num_workers", FR_TYPE_UINT32, main_config_t, max_workers), .dflt = STRINGIFY(4),
 	  .func = num_workers_parse },
 
+	{ FR_CONF_OFFSET("dispatch", FR_TYPE_UINT32, main_config_t, network_dispatch), .dflt = "cpu_time",
+	  .func = cf_table_parse_uint32,
+	  .uctx = &(cf_table_parse_ctx_t){ .table = network_dispatch_table, .len = &network_dispatch_table_len } },
+	{ FR_CONF_OFFSET("max_spill", FR_TYPE_UINT32, main_config_t, network_max_spill), .dflt = "0" },
+
+	{ FR_CONF_OFFSET("cpu_affinity", FR_TYPE_UINT32, main_config_t, cpu_affinity), .dflt = "none",
+	  .func = cf_table_parse_uint32,
+	  .uctx = &(cf_table_parse_ctx_t){ .table = fr_schedule_cpu_affinity_table, .len = &fr_schedule_cpu_affinity_table_len } },
+
 	{ FR_CONF_OFFSET("stats_interval | FR_TYPE_HIDDEN", FR_TYPE_TIME_DELTA, main_config_t, stats_interval), },
 
 	CONF_PARSER_TERMINATOR
@@ -436,7 +454,8 @@ static int num_networks_parse(TALLOC_CTX *ctx, void *out, void *parent,
 
 	memcpy(&value, out, sizeof(value));
 
-	FR_INTEGER_BOUND_CHECK("thread.num_networks", value, ==, 1);
+	FR_INTEGER_BOUND_CHECK("thread.num_networks", value, >=, 1);
+	FR_INTEGER_BOUND_CHECK("thread.num_networks", value, <=, 64);
 
 	memcpy(out, &value, sizeof(value));
 
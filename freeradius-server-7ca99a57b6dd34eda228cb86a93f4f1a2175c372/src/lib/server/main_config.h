@@ -137,6 +137,9 @@ struct main_config_s {
 							//!< Only applicable in single threaded mode.
 	uint32_t	max_networks;			//!< for the scheduler
 	uint32_t	max_workers;			//!< for the scheduler
+	uint32_t	network_dispatch;		//!< how network threads pick workers.
+	uint32_t	network_max_spill;		//!< how many workers to try before dropping.
+	uint32_t	cpu_affinity;			//!< which threads are pinned to CPUs.
 	fr_time_delta_t	stats_interval;			//!< for the scheduler
 
 };
@@ -817,7 +817,7 @@ static int map_exec_to_vp(TALLOC_CTX *ctx, VALUE_PAIR **out, REQUEST *request, v
 	int result;
 	char *expanded = NULL;
 	char answer[1024];
-	VALUE_PAIR **input_pairs = NULL;
+	fr_pair_list_t *input_pairs = NULL;
 	VALUE_PAIR *output_pairs = NULL;
 
 	*out = NULL;
@@ -841,7 +841,7 @@ static int map_exec_to_vp(TALLOC_CTX *ctx, VALUE_PAIR **out, REQUEST *request, v
 	 */
 	result = radius_exec_program(ctx, answer, sizeof(answer),
 				     tmpl_is_list(map->lhs) ? &output_pairs : NULL,
-				     request, map->rhs->name, input_pairs ? *input_pairs : NULL,
+				     request, map->rhs->name, input_pairs ? fr_pair_list_head(input_pairs) : NULL,
 				     true, true, fr_time_delta_from_sec(EXEC_TIMEOUT));
 	talloc_free(expanded);
 	if (result != 0) {
@@ -921,14 +921,14 @@ int map_to_vp(TALLOC_CTX *ctx, VALUE_PAIR **out, REQUEST *request, vp_map_t cons
 	 *	the op.
 	 */
 	if (tmpl_is_list(map->lhs) && tmpl_is_list(map->rhs)) {
-		VALUE_PAIR **from = NULL;
+		fr_pair_list_t *from = NULL;
 
 		if (radius_request(&context, tmpl_request(map->rhs)) == 0) {
 			from = radius_list(context, tmpl_list(map->rhs));
 		}
 		if (!from) return 0;
 
-		if (fr_pair_list_copy(ctx, &found, *from) < 0) return -1;
+		if (fr_pair_list_copy(ctx, &found, fr_pair_list_head(from)) < 0) return -1;
 
 		/*
 		 *	List to list copy is empty if the src list has no attributes.
@@ -1148,6 +1148,23 @@ do {\
 	}\
 } while (0)
 
+/** Advance a cursor to the first pair at or after vp matching the tag of a #tmpl_t
+ *
+ * The cursor should have been initialised with #fr_pair_list_cursor_by_da_init
+ * so only the tag needs checking here.
+ *
+ * @param[in] cursor	positioned at vp.
+ * @param[in] vp	to start checking at.
+ * @param[in] vpt	to match.
+ * @return the matching pair, or NULL if there are no more.
+ */
+static inline VALUE_PAIR *map_cursor_next_by_tmpl(fr_cursor_t *cursor, VALUE_PAIR *vp, tmpl_t const *vpt)
+{
+	while (vp && !ATTR_TAG_MATCH(vp, tmpl_tag(vpt))) vp = fr_cursor_next(cursor);
+
+	return vp;
+}
+
 /** Convert #vp_map_t to #VALUE_PAIR (s) and add them to a #REQUEST.
  *
  * Takes a single #vp_map_t, resolves request and list identifiers
@@ -1169,10 +1186,12 @@ int map_to_request(REQUEST *request, vp_map_t const *map, radius_map_getvalue_t
 {
 	int			rcode = 0;
 	int			num;
-	VALUE_PAIR		**list, *vp, *dst, *head = NULL;
+	fr_pair_list_t		*list;
+	VALUE_PAIR		*vp, *dst, *head = NULL;
 	REQUEST			*context, *tmp_ctx = NULL;
 	TALLOC_CTX		*parent;
-	vp_cursor_t		dst_list, src_list;
+	fr_cursor_t		dst_list;
+	vp_cursor_t		src_list;
 
 	bool			found = false;
 
@@ -1320,13 +1339,13 @@ int map_to_request(REQUEST *request, vp_map_t const *map, radius_map_getvalue_t
 			fr_assert(!head);
 
 			/* Clear the entire dst list */
-			fr_pair_list_free(list);
+			fr_pair_list_clear(list);
 			goto finish;
 
 		case T_OP_SET:
 			if (tmpl_is_list(map->rhs)) {
-				fr_pair_list_free(list);
-				*list = head;
+				fr_pair_list_clear(list);
+				fr_pair_list_append(list, head);
 				head = NULL;
 			} else {
 				FALL_THROUGH;
@@ -1354,13 +1373,12 @@ int map_to_request(REQUEST *request, vp_map_t const *map, radius_map_getvalue_t
 	 *	being NULL (no attribute at that index).
 	 */
 	num = tmpl_num(map->lhs);
-	(void) fr_pair_cursor_init(&dst_list, list);
+	dst = map_cursor_next_by_tmpl(&dst_list,
+				      fr_pair_list_cursor_by_da_init(&dst_list, list, tmpl_da(map->lhs)), map->lhs);
 	if ((num != NUM_ALL) && (num != NUM_ANY)) {
-		while ((dst = fr_pair_cursor_next_by_da(&dst_list, tmpl_da(map->lhs), tmpl_tag(map->lhs)))) {
-			if (num-- == 0) break;
+		while (dst && (num-- > 0)) {
+			dst = map_cursor_next_by_tmpl(&dst_list, fr_cursor_next(&dst_list), map->lhs);
 		}
-	} else {
-		dst = fr_pair_cursor_next_by_da(&dst_list, tmpl_da(map->lhs), tmpl_tag(map->lhs));
 	}
 	fr_assert(!dst || (tmpl_da(map->lhs) == dst->da));
 
@@ -1383,15 +1401,16 @@ int map_to_request(REQUEST *request, vp_map_t const *map, radius_map_getvalue_t
 		 *	Wildcard: delete all of the matching ones, based on tag.
 		 */
 		if (tmpl_num(map->lhs) == NUM_ANY) {
-			fr_pair_delete_by_child_num(list, tmpl_da(map->lhs)->parent,
-						    tmpl_da(map->lhs)->attr, tmpl_tag(map->lhs));
-			dst = NULL;
+			while (dst) {
+				talloc_free(fr_cursor_remove(&dst_list));
+				dst = map_cursor_next_by_tmpl(&dst_list, fr_cursor_current(&dst_list), map->lhs);
+			}
 		/*
 		 *	We've found the Nth one.  Delete it, and only it.
 		 */
 		} else {
-			dst = fr_pair_cursor_remove(&dst_list);
-			fr_pair_list_free(&dst);
+			talloc_free(fr_cursor_remove(&dst_list));
+			dst = NULL;
 		}
 
 		/*
@@ -1427,9 +1446,9 @@ int map_to_request(REQUEST *request, vp_map_t const *map, radius_map_getvalue_t
 				head->op = T_OP_CMP_EQ;
 				rcode = paircmp_pairs(request, vp, dst);
 				if (rcode == 0) {
-					dst = fr_pair_cursor_remove(&dst_list);
-					fr_pair_list_free(&dst);
+					talloc_free(fr_cursor_remove(&dst_list));
 					found = true;
+					break;
 				}
 			}
 			rcode = 0;
@@ -1441,20 +1460,22 @@ int map_to_request(REQUEST *request, vp_map_t const *map, radius_map_getvalue_t
 		/*
 		 *	All instances[*] delete
 		 */
-		for (dst = fr_pair_cursor_current(&dst_list);
-		     dst;
-		     dst = fr_pair_cursor_next_by_da(&dst_list, tmpl_da(map->lhs), tmpl_tag(map->lhs))) {
+		while (dst) {
 			for (vp = fr_pair_cursor_head(&src_list);
 			     vp;
 			     vp = fr_pair_cursor_next(&src_list)) {
 				head->op = T_OP_CMP_EQ;
 				rcode = paircmp_pairs(request, vp, dst);
-				if (rcode == 0) {
-					dst = fr_pair_cursor_remove(&dst_list);
-					fr_pair_list_free(&dst);
-					found = true;
-				}
+				if (rcode == 0) break;
 			}
+
+			if (vp) {
+				talloc_free(fr_cursor_remove(&dst_list));
+				found = true;
+				dst = map_cursor_next_by_tmpl(&dst_list, fr_cursor_current(&dst_list), map->lhs);
+				continue;
+			}
+			dst = map_cursor_next_by_tmpl(&dst_list, fr_cursor_next(&dst_list), map->lhs);
 		}
 		rcode = 0;
 		fr_pair_list_free(&head);
@@ -1486,7 +1507,7 @@ int map_to_request(REQUEST *request, vp_map_t const *map, radius_map_getvalue_t
 
 		/* Insert first instance (if multiple) */
 		fr_pair_cursor_head(&src_list);
-		fr_pair_cursor_append(&dst_list, fr_pair_cursor_remove(&src_list));
+		fr_pair_list_append(list, fr_pair_cursor_remove(&src_list));
 		/* Free any we didn't insert */
 		fr_pair_list_free(&head);
 		break;
@@ -1499,10 +1520,10 @@ int map_to_request(REQUEST *request, vp_map_t const *map, radius_map_getvalue_t
 		fr_pair_cursor_tail(&src_list);
 		if (dst) {
 			DEBUG_OVERWRITE(dst, fr_pair_cursor_current(&src_list));
-			dst = fr_pair_cursor_replace(&dst_list, fr_pair_cursor_remove(&src_list));
+			dst = fr_cursor_replace(&dst_list, fr_pair_cursor_remove(&src_list));
 			talloc_free(dst);
 		} else {
-			fr_pair_cursor_append(&dst_list, fr_pair_cursor_remove(&src_list));
+			fr_pair_list_append(list, fr_pair_cursor_remove(&src_list));
 		}
 		/* Free any we didn't insert */
 		fr_pair_list_free(&head);
@@ -1513,7 +1534,7 @@ int map_to_request(REQUEST *request, vp_map_t const *map, radius_map_getvalue_t
 	 */
 	case T_OP_ADD:
 		/* Insert all the instances! (if multiple) */
-		fr_pair_add(list, head);
+		fr_pair_list_append(list, head);
 		head = NULL;
 		break;
 
@@ -1527,19 +1548,26 @@ int map_to_request(REQUEST *request, vp_map_t const *map, radius_map_getvalue_t
 	case T_OP_LE:
 	case T_OP_LT:
 	{
-		VALUE_PAIR *a, *b;
+		VALUE_PAIR	*a, *b, *sorted;
+		vp_cursor_t	sorted_list;
+
+		/*
+		 *	Sorting re-orders the whole destination list,
+		 *	so do it on the bare chain and re-link it after.
+		 */
+		sorted = fr_pair_list_detach(list);
 
 		fr_pair_list_sort(&head, fr_pair_cmp_by_da_tag);
-		fr_pair_list_sort(list, fr_pair_cmp_by_da_tag);
+		fr_pair_list_sort(&sorted, fr_pair_cmp_by_da_tag);
 
-		fr_pair_cursor_head(&dst_list);
+		fr_pair_cursor_init(&sorted_list, &sorted);
 
 		for (b = fr_pair_cursor_head(&src_list);
 		     b;
 		     b = fr_pair_cursor_next(&src_list)) {
-			for (a = fr_pair_cursor_current(&dst_list);
+			for (a = fr_pair_cursor_current(&sorted_list);
 			     a;
-			     a = fr_pair_cursor_next(&dst_list)) {
+			     a = fr_pair_cursor_next(&sorted_list)) {
 				int8_t cmp;
 
 				cmp = fr_pair_cmp_by_da_tag(a, b);	/* attribute and tag match */
@@ -1548,12 +1576,13 @@ int map_to_request(REQUEST *request, vp_map_t const *map, radius_map_getvalue_t
 
 				cmp = (fr_value_box_cmp_op(map->op, &a->data, &b->data) == 0);
 				if (cmp != 0) {
-					a = fr_pair_cursor_remove(&dst_list);
+					a = fr_pair_cursor_remove(&sorted_list);
 					talloc_free(a);
 				}
 			}
 			if (!a) break;	/* end of the list */
 		}
+		fr_pair_list_append(list, sorted);
 		fr_pair_list_free(&head);
 	}
 		break;
@@ -196,10 +196,10 @@ static inline vp_list_mod_t *list_mod_empty_string_afrom_map(TALLOC_CTX *ctx,
  *	- true if destination list is OK.
  *	- false if destination list is invalid.
  */
-static inline VALUE_PAIR **map_check_src_or_dst(REQUEST *request, vp_map_t const *map, tmpl_t const *src_dst)
+static inline fr_pair_list_t *map_check_src_or_dst(REQUEST *request, vp_map_t const *map, tmpl_t const *src_dst)
 {
 	REQUEST		*context = request;
-	VALUE_PAIR	**list;
+	fr_pair_list_t	*list;
 
 	if (radius_request(&context, tmpl_request(src_dst)) < 0) {
 		REDEBUG("Mapping \"%.*s\" -> \"%.*s\" invalid in this context",
@@ -347,7 +347,7 @@ int map_to_list_mod(TALLOC_CTX *ctx, vp_list_mod_t **out,
 	if (tmpl_is_list(mutated->lhs) && tmpl_is_list(mutated->rhs)) {
 		fr_cursor_t	to;
 		fr_cursor_t	from;
-		VALUE_PAIR	**list = NULL;
+		fr_pair_list_t	*list = NULL;
 		VALUE_PAIR	*vp = NULL;
 
 		/*
@@ -356,7 +356,7 @@ int map_to_list_mod(TALLOC_CTX *ctx, vp_list_mod_t **out,
 		list = map_check_src_or_dst(request, mutated, mutated->rhs);
 		if (!list) goto error;
 
-		vp = fr_cursor_init(&from, list);
+		vp = fr_pair_list_cursor_init(&from, list);
 		/*
 		 *	No attributes found on LHS.
 		 */
@@ -923,7 +923,8 @@ int map_list_mod_apply(REQUEST *request, vp_list_mod_t const *vlm)
 	int			rcode = 0;
 
 	vp_map_t const		*map = vlm->map, *mod;
-	VALUE_PAIR		**vp_list, *found;
+	fr_pair_list_t		*vp_list;
+	VALUE_PAIR		*found;
 	REQUEST			*context;
 	TALLOC_CTX		*parent;
 
@@ -980,12 +981,12 @@ int map_list_mod_apply(REQUEST *request, vp_list_mod_t const *vlm)
 	if (tmpl_is_list(map->lhs)) {
 		switch (mod->op) {
 		case T_OP_CMP_FALSE:
-			fr_pair_list_free(vp_list);				/* Clear the entire list */
+			fr_pair_list_clear(vp_list);				/* Clear the entire list */
 			goto finish;
 
 		case T_OP_SET:
-			fr_pair_list_free(vp_list);				/* Clear the existing list */
-			*vp_list = map_list_mod_to_vps(parent, vlm);		/* Replace with a new list */
+			fr_pair_list_clear(vp_list);				/* Clear the existing list */
+			fr_pair_list_append(vp_list, map_list_mod_to_vps(parent, vlm));	/* Replace with a new list */
 			goto finish;
 
 		/*
@@ -1003,7 +1004,7 @@ int map_list_mod_apply(REQUEST *request, vp_list_mod_t const *vlm)
 
 			fr_cursor_init(&from, &vp_from);
 			fr_cursor_init(&to_insert, &vp_to_insert);
-			fr_cursor_init(&to, vp_list);
+			fr_pair_list_cursor_init(&to, vp_list);
 
 			while ((vp = fr_cursor_remove(&from))) {
 				for (vp_to = fr_cursor_head(&to);
@@ -1032,7 +1033,7 @@ int map_list_mod_apply(REQUEST *request, vp_list_mod_t const *vlm)
 			vp_from = map_list_mod_to_vps(parent, vlm);
 			fr_assert(vp_from);
 
-			fr_cursor_init(&to, vp_list);
+			fr_pair_list_cursor_init(&to, vp_list);
 			fr_cursor_tail(&to);
 
 			fr_cursor_init(&from, &vp_from);
@@ -1148,7 +1149,7 @@ int map_list_mod_apply(REQUEST *request, vp_list_mod_t const *vlm)
 		vp_from = map_list_mod_to_vps(parent, vlm);
 		if (!vp_from) goto finish;
 
-		fr_cursor_init(&to, vp_list);
+		fr_pair_list_cursor_init(&to, vp_list);
 		fr_cursor_tail(&to);		/* Insert after the last instance */
 
 		fr_cursor_init(&from, &vp_from);
@@ -33,7 +33,7 @@ RCSIDH(server_pair_h, "$Id$")
  *	- 0 on success.
  *	- -1 on failure.
  */
-#define pair_add_request(_attr, _da) fr_pair_add_by_da(request->packet, _attr, &request->packet->vps, _da)
+#define pair_add_request(_attr, _da) fr_pair_list_add_by_da(request->packet, _attr, &request->packet->vps, _da)
 
 /** Allocate a VALUE_PAIR in the reply list
  *
@@ -43,7 +43,7 @@ RCSIDH(server_pair_h, "$Id$")
  *	- 0 on success.
  *	- -1 on failure.
  */
-#define pair_add_reply(_attr, _da) fr_pair_add_by_da(request->reply, _attr, &request->reply->vps, _da)
+#define pair_add_reply(_attr, _da) fr_pair_list_add_by_da(request->reply, _attr, &request->reply->vps, _da)
 
 /** Allocate a VALUE_PAIR in the control list
  *
@@ -53,7 +53,7 @@ RCSIDH(server_pair_h, "$Id$")
  *	- 0 on success.
  *	- -1 on failure.
  */
-#define pair_add_control(_attr, _da) fr_pair_add_by_da(request, _attr, &request->control, _da)
+#define pair_add_control(_attr, _da) fr_pair_list_add_by_da(request, _attr, &request->control, _da)
 
 /** Allocate a VALUE_PAIR in the session-state list
  *
@@ -63,7 +63,7 @@ RCSIDH(server_pair_h, "$Id$")
  *	- 0 on success.
  *	- -1 on failure.
  */
-#define pair_add_session_state(_attr, _da) fr_pair_add_by_da(request->state_ctx, _attr, &request->state, _da)
+#define pair_add_session_state(_attr, _da) fr_pair_list_add_by_da(request->state_ctx, _attr, &request->state, _da)
 
 /** Return or allocate a VALUE_PAIR in the request list
  *
@@ -74,7 +74,7 @@ RCSIDH(server_pair_h, "$Id$")
  *	- 0 if we allocated a new attribute.
  *	- -1 on failure.
  */
-#define pair_update_request(_attr, _da) fr_pair_update_by_da(request->packet, _attr, &request->packet->vps, _da)
+#define pair_update_request(_attr, _da) fr_pair_list_update_by_da(request->packet, _attr, &request->packet->vps, _da)
 
 /** Return or allocate a VALUE_PAIR in the reply list
  *
@@ -85,7 +85,7 @@ RCSIDH(server_pair_h, "$Id$")
  *	- 0 if we allocated a new attribute.
  *	- -1 on failure.
  */
-#define pair_update_reply(_attr, _da) fr_pair_update_by_da(request->reply, _attr, &request->reply->vps, _da)
+#define pair_update_reply(_attr, _da) fr_pair_list_update_by_da(request->reply, _attr, &request->reply->vps, _da)
 
 /** Return or allocate a VALUE_PAIR in the control list
  *
@@ -96,7 +96,7 @@ RCSIDH(server_pair_h, "$Id$")
  *	- 0 if we allocated a new attribute.
  *	- -1 on failure.
  */
-#define pair_update_control(_attr, _da) fr_pair_update_by_da(request, _attr, &request->control, _da)
+#define pair_update_control(_attr, _da) fr_pair_list_update_by_da(request, _attr, &request->control, _da)
 
 /** Return or allocate a VALUE_PAIR in the session_state list
  *
@@ -107,7 +107,7 @@ RCSIDH(server_pair_h, "$Id$")
  *	- 0 if we allocated a new attribute.
  *	- -1 on failure.
  */
-#define pair_update_session_state(_attr, _da) fr_pair_update_by_da(request->state_ctx, _attr, &request->state, _da)
+#define pair_update_session_state(_attr, _da) fr_pair_list_update_by_da(request->state_ctx, _attr, &request->state, _da)
 
 /** Delete a VALUE_PAIR in a list
  *
@@ -121,6 +121,18 @@ RCSIDH(server_pair_h, "$Id$")
 		 VALUE_PAIR *			: fr_pair_delete(_list, (VALUE_PAIR const *)_pair)		\
 	)
 
+/** Delete a VALUE_PAIR in a #fr_pair_list_t
+ *
+ * @param[in] _list	to delete the pair from.
+ * @param[in] _pair	May be a VALUE_PAIR or fr_dict_attr_t.
+ */
+#define pair_list_delete(_list, _pair) \
+	_Generic((_pair), \
+		 fr_dict_attr_t const *		: fr_pair_list_delete_by_da(_list, (fr_dict_attr_t const *)_pair),	\
+		 fr_dict_attr_t *		: fr_pair_list_delete_by_da(_list, (fr_dict_attr_t const *)_pair),	\
+		 VALUE_PAIR *			: fr_pair_list_delete(_list, (VALUE_PAIR *)_pair)			\
+	)
+
 /** Delete a VALUE_PAIR in the request list
  *
  * @param[in] _pair	#fr_dict_attr_t of the pair(s) to be deleted.
@@ -128,7 +140,7 @@ RCSIDH(server_pair_h, "$Id$")
  *	- >0 the number of pairs deleted.
  *	- 0 if no pairs were deleted.
  */
-#define pair_delete_request(_pair) pair_delete(&request->packet->vps, _pair)
+#define pair_delete_request(_pair) pair_list_delete(&request->packet->vps, _pair)
 
 
 /** Delete a VALUE_PAIR in the reply list
@@ -138,7 +150,7 @@ RCSIDH(server_pair_h, "$Id$")
  *	- >0 the number of pairs deleted.
  *	- 0 if no pairs were deleted.
  */
-#define pair_delete_reply(_pair) pair_delete(&request->reply->vps, _pair)
+#define pair_delete_reply(_pair) pair_list_delete(&request->reply->vps, _pair)
 
 /** Delete a VALUE_PAIR in the control list
  *
@@ -147,7 +159,7 @@ RCSIDH(server_pair_h, "$Id$")
  *	- >0 the number of pairs deleted.
  *	- 0 if no pairs were deleted.
  */
-#define pair_delete_control(_pair) pair_delete(&request->control, _pair)
+#define pair_delete_control(_pair) pair_list_delete(&request->control, _pair)
 
 /** Delete a VALUE_PAIR in the session_state list
  *
@@ -156,5 +168,5 @@ RCSIDH(server_pair_h, "$Id$")
  *	- >0 the number of pairs deleted.
  *	- 0 if no pairs were deleted.
  */
-#define pair_delete_session_state(_pair) pair_delete(&request->state, _pair)
+#define pair_delete_session_state(_pair) pair_list_delete(&request->state, _pair)
 
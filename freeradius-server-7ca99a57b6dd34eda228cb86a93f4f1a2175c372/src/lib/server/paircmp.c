@@ -118,7 +118,7 @@ static int prefix_suffix_cmp(UNUSED void *instance,
 			     VALUE_PAIR *req,
 			     VALUE_PAIR *check,
 			     VALUE_PAIR *check_list,
-			     UNUSED VALUE_PAIR **reply_list)
+			     UNUSED fr_pair_list_t *reply_list)
 {
 	VALUE_PAIR	*vp;
 	char const	*name;
@@ -129,8 +129,8 @@ static int prefix_suffix_cmp(UNUSED void *instance,
 
 	if (!request) return -1;
 
-	username = fr_pair_find_by_da(request->packet->vps, attr_stripped_user_name, TAG_ANY);
-	if (!username) username = fr_pair_find_by_da(request->packet->vps, attr_user_name, TAG_ANY);
+	username = fr_pair_list_find_by_da(&request->packet->vps, attr_stripped_user_name, TAG_ANY);
+	if (!username) username = fr_pair_list_find_by_da(&request->packet->vps, attr_user_name, TAG_ANY);
 	if (!username) return -1;
 
 	VP_VERIFY(check);
@@ -187,7 +187,7 @@ static int packet_cmp(UNUSED void *instance,
 		      UNUSED VALUE_PAIR *req,
 		      VALUE_PAIR *check,
 		      UNUSED VALUE_PAIR *check_list,
-		      UNUSED VALUE_PAIR **reply_list)
+		      UNUSED fr_pair_list_t *reply_list)
 {
 	VP_VERIFY(check);
 
@@ -204,7 +204,7 @@ static int generic_cmp(UNUSED void *instance,
 		       VALUE_PAIR *req,
 		       VALUE_PAIR *check,
 		       UNUSED VALUE_PAIR *check_list,
-		       UNUSED VALUE_PAIR **reply_list)
+		       UNUSED fr_pair_list_t *reply_list)
 {
 	VP_VERIFY(check);
 
@@ -319,7 +319,7 @@ int paircmp_pairs(UNUSED REQUEST *request, VALUE_PAIR *check, VALUE_PAIR *vp)
 		ssize_t		slen;
 		regex_t		*preg = NULL;
 		uint32_t	subcaptures;
-		fr_regmatch_t	*regmatch;
+		fr_regmatch_t	*regmatch = NULL;
 
 		char *expr = NULL, *value = NULL;
 		char const *expr_p, *value_p;
@@ -340,7 +340,10 @@ int paircmp_pairs(UNUSED REQUEST *request, VALUE_PAIR *check, VALUE_PAIR *vp)
 			REDEBUG("Error stringifying operand for regular expression");
 
 		regex_error:
+#if !defined(HAVE_REGEX_PCRE) && !defined(HAVE_REGEX_PCRE2)
 			talloc_free(preg);
+#endif
+			talloc_free(regmatch);
 			talloc_free(expr);
 			talloc_free(value);
 			return -2;
@@ -349,8 +352,12 @@ int paircmp_pairs(UNUSED REQUEST *request, VALUE_PAIR *check, VALUE_PAIR *vp)
 		/*
 		 *	Include substring matches.
 		 */
+#if defined(HAVE_REGEX_PCRE) || defined(HAVE_REGEX_PCRE2)
+		slen = regex_compile_cached(&preg, expr_p, talloc_array_length(expr_p) - 1, NULL, true);
+#else
 		slen = regex_compile(request, &preg, expr_p, talloc_array_length(expr_p) - 1,
 				     NULL, true, true);
+#endif
 		if (slen <= 0) {
 			REMARKER(expr_p, -slen, "%s", fr_strerror());
 
@@ -382,7 +389,9 @@ int paircmp_pairs(UNUSED REQUEST *request, VALUE_PAIR *check, VALUE_PAIR *vp)
 		}
 
 		talloc_free(regmatch);
+#if !defined(HAVE_REGEX_PCRE) && !defined(HAVE_REGEX_PCRE2)
 		talloc_free(preg);
+#endif
 		talloc_free(expr);
 		talloc_free(value);
 
@@ -516,7 +525,7 @@ static int paircmp_func(REQUEST *request,
 			VALUE_PAIR *request_list,
 			VALUE_PAIR *check,
 			VALUE_PAIR *check_list,
-			VALUE_PAIR **reply_list)
+			fr_pair_list_t *reply_list)
 {
 	paircmp_t *c;
 
@@ -558,7 +567,7 @@ static int paircmp_func(REQUEST *request,
 int paircmp(REQUEST *request,
 	    VALUE_PAIR *request_list,
 	    VALUE_PAIR *check,
-	    VALUE_PAIR **reply_list)
+	    fr_pair_list_t *reply_list)
 {
 	fr_cursor_t		cursor;
 	VALUE_PAIR		*check_item;
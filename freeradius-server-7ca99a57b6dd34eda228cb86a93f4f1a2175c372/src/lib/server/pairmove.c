@@ -42,11 +42,11 @@ RCSID("$Id$")
  *	only fr_pair_list_copy() those attributes that we're really going to
  *	use.
  */
-void radius_pairmove(REQUEST *request, VALUE_PAIR **to, VALUE_PAIR *from, bool do_xlat)
+void radius_pairmove(REQUEST *request, fr_pair_list_t *to, VALUE_PAIR *from, bool do_xlat)
 {
 	int		i, j, count, from_count, to_count, tailto;
 	fr_cursor_t	cursor;
-	VALUE_PAIR	*vp, *next, **last;
+	VALUE_PAIR	*vp, *next, *head = NULL, **last;
 	VALUE_PAIR	**from_list, **to_list;
 	VALUE_PAIR	*append, **append_tail;
 	VALUE_PAIR 	*to_copy = NULL;
@@ -78,7 +78,7 @@ void radius_pairmove(REQUEST *request, VALUE_PAIR **to, VALUE_PAIR *from, bool d
 	for (vp = fr_cursor_init(&cursor, &from); vp; vp = fr_cursor_next(&cursor)) count++;
 	from_list = talloc_array(request, VALUE_PAIR *, count);
 
-	for (vp = fr_cursor_init(&cursor, to); vp; vp = fr_cursor_next(&cursor)) count++;
+	for (vp = fr_pair_list_cursor_init(&cursor, to); vp; vp = fr_cursor_next(&cursor)) count++;
 	to_list = talloc_array(request, VALUE_PAIR *, count);
 
 	append = NULL;
@@ -96,8 +96,8 @@ void radius_pairmove(REQUEST *request, VALUE_PAIR **to, VALUE_PAIR *from, bool d
 	}
 
 	to_count = 0;
-	ctx = talloc_parent(*to);
-	MEM(fr_pair_list_copy(ctx, &to_copy, *to) >= 0);
+	ctx = talloc_parent(fr_pair_list_head(to));
+	MEM(fr_pair_list_copy(ctx, &to_copy, fr_pair_list_head(to)) >= 0);
 	for (vp = to_copy; vp != NULL; vp = next) {
 		next = vp->next;
 		to_list[to_count++] = vp;
@@ -292,8 +292,8 @@ void radius_pairmove(REQUEST *request, VALUE_PAIR **to, VALUE_PAIR *from, bool d
 	/*
 	 *	Re-chain the "to" list.
 	 */
-	fr_pair_list_free(to);
-	last = to;
+	fr_pair_list_clear(to);
+	last = &head;
 
 	for (i = 0; i < tailto; i++) {
 		if (!to_list[i]) continue;
@@ -319,6 +319,7 @@ void radius_pairmove(REQUEST *request, VALUE_PAIR **to, VALUE_PAIR *from, bool d
 	 *	the tail of the "to" list.
 	 */
 	*last = append;
+	fr_pair_list_append(to, head);
 
 	fr_assert(request->packet != NULL);
 
@@ -860,7 +860,7 @@ int password_normalise_and_replace(REQUEST *request, bool normify)
 	int		replaced = 0;
 	VALUE_PAIR	*known_good, *new;
 
-	for (known_good = fr_cursor_iter_by_ancestor_init(&cursor, &request->control, attr_password_root);
+	for (known_good = fr_pair_list_cursor_by_ancestor_init(&cursor, &request->control, attr_password_root);
 	     known_good;
 	     known_good = fr_cursor_next(&cursor)) {
 		if (!fr_cond_assert(known_good->da->attr < NUM_ELEMENTS(password_info))) return -1;
@@ -956,7 +956,7 @@ VALUE_PAIR *password_find(bool *ephemeral, TALLOC_CTX *ctx, REQUEST *request,
 	fr_cursor_t	cursor;
 	VALUE_PAIR	*known_good;
 
-	for (known_good = fr_cursor_iter_by_ancestor_init(&cursor, &request->control, attr_password_root);
+	for (known_good = fr_pair_list_cursor_by_ancestor_init(&cursor, &request->control, attr_password_root);
 	     known_good;
 	     known_good = fr_cursor_next(&cursor)) {
 		password_info_t		*info;
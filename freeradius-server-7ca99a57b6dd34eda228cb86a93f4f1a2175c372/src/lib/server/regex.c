@@ -82,10 +82,13 @@ void regex_sub_to_request(REQUEST *request, regex_t **preg, fr_regmatch_t **regm
 	MEM(new_rc = talloc(request, fr_regcapture_t));
 
 	/*
-	 *	Steal runtime pregs, leave precompiled ones
+	 *	Steal runtime pregs, reference cached ones so they
+	 *	survive eviction, leave precompiled ones
 	 */
 #if defined(HAVE_REGEX_PCRE) || defined(HAVE_REGEX_PCRE2)
-	if (!(*preg)->precompiled) {
+	if ((*preg)->cached) {
+		MEM(new_rc->preg = talloc_reference(new_rc, *preg));
+	} else if (!(*preg)->precompiled) {
 		new_rc->preg = talloc_steal(new_rc, *preg);
 		*preg = NULL;
 	} else {
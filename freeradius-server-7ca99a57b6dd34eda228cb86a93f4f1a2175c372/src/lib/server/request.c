@@ -34,6 +34,15 @@ RCSID("$Id$")
  */
 static _Thread_local fr_dlist_head_t *request_free_list; /* macro */
 
+/*
+ *	Pairs in a request's lists, and their value buffers, are
+ *	allocated from an arena while a worker is processing it.
+ *	Reserve space for a typical request's worth of those.
+ *	Anything which doesn't fit is allocated with malloc as usual.
+ */
+#define REQUEST_ARENA_PAIRS	(128)	//!< How many pairs we pre-alloc for.
+#define REQUEST_ARENA_PAIR_DATA	(64)	//!< Average value buffer size we pre-alloc for each pair.
+
 #ifndef NDEBUG
 static int _state_ctx_free(TALLOC_CTX *state)
 {
@@ -68,6 +77,19 @@ static void request_init(char const *file, int line, REQUEST *request)
 	 */
 	request_data_list_init(&request->data);
 
+	/*
+	 *	Initialise the control list.  It's searched
+	 *	far more often than it's written, so index it.
+	 */
+	fr_pair_list_init(&request->control, FR_PAIR_LIST_DOUBLE);
+	MEM(fr_pair_list_index_alloc(request, &request->control) == 0);
+
+	/*
+	 *	The session-state list is handed back and forth
+	 *	between state entries as a chain, so no index.
+	 */
+	fr_pair_list_init(&request->state, FR_PAIR_LIST_DOUBLE);
+
 	/*
 	 *	Initialise the state_ctx
 	 */
@@ -134,6 +156,7 @@ static int _request_free(REQUEST *request)
 	 */
 	if (fr_dlist_num_elements(request_free_list) <= 256) {
 		TALLOC_CTX		*state_ctx;
+		fr_pair_arena_t		*pair_arena;
 		fr_dlist_head_t		*free_list;
 
 		/*
@@ -145,6 +168,7 @@ static int _request_free(REQUEST *request)
 			fr_assert(!request->parent || (request->state_ctx != request->parent->state_ctx));
 			talloc_free_children(request->state_ctx);
 		}
+		pair_arena = request->pair_arena;
 		free_list = request_free_list;
 
 		/*
@@ -154,6 +178,8 @@ static int _request_free(REQUEST *request)
 		memset(request, 0, sizeof(*request));
 		request->component = "free_list";
 		request->state_ctx = state_ctx;		/* Use the old, now cleared, state_ctx */
+		request->pair_arena = pair_arena;	/* Pool is reset by talloc when its pairs are freed */
+		if (pair_arena) fr_pair_arena_reset(pair_arena);
 
 		/*
 		 *	Reinsert into the free list
@@ -200,6 +226,12 @@ really_free:
 		talloc_free(request->state_ctx);
 	}
 
+	/*
+	 *	Parented separately, so it can be kept when
+	 *	the request is returned to the free list.
+	 */
+	talloc_free(request->pair_arena);
+
 #ifndef NDEBUG
 	request->magic = 0x01020304;	/* set the request to be nonsense */
 #endif
@@ -346,6 +378,12 @@ static REQUEST *request_init_fake(char const *file, int line, REQUEST *request,
 		return NULL;
 	}
 
+	if ((fr_pair_list_index_alloc(fake->packet, &fake->packet->vps) < 0) ||
+	    (fr_pair_list_index_alloc(fake->reply, &fake->reply->vps) < 0)) {
+		talloc_free(fake);
+		return NULL;
+	}
+
 	fake->master_state = REQUEST_ACTIVE;
 
 	/*
@@ -498,6 +536,34 @@ int request_detach(REQUEST *fake, bool will_free)
 	return 0;
 }
 
+/** Allocate pairs added to the request's lists from its arena
+ *
+ * Pairs are only allocated from the arena while it's set as the current
+ * arena with #fr_pair_arena_set.  The arena is kept when the request is
+ * returned to the free list.
+ *
+ * @param[in] request	whose packets have been allocated.
+ * @return
+ *	- 0 on success.
+ *	- -1 on failure.
+ */
+int request_pair_arena_init(REQUEST *request)
+{
+	if (!request->pair_arena) {
+		request->pair_arena = fr_pair_arena_alloc(NULL, REQUEST_ARENA_PAIRS,
+							  REQUEST_ARENA_PAIRS * REQUEST_ARENA_PAIR_DATA);
+		if (!request->pair_arena) return -1;
+	} else {
+		fr_pair_arena_reset(request->pair_arena);
+	}
+
+	if ((fr_pair_arena_owner_add(request->pair_arena, request) < 0) ||
+	    (request->packet && (fr_pair_arena_owner_add(request->pair_arena, request->packet) < 0)) ||
+	    (request->reply && (fr_pair_arena_owner_add(request->pair_arena, request->reply) < 0))) return -1;
+
+	return 0;
+}
+
 #ifdef WITH_VERIFY_PTR
 /*
  *	Verify a packet.
@@ -523,9 +589,9 @@ static void packet_verify(char const *file, int line, REQUEST const *request, RA
 
 	PACKET_VERIFY(packet);
 
-	if (!packet->vps) return;
+	if (!fr_pair_list_head(&packet->vps)) return;
 
-	fr_pair_list_verify(file, line, packet, packet->vps);
+	fr_pair_list_verify(file, line, packet, fr_pair_list_head(&packet->vps));
 }
 
 /*
@@ -545,8 +611,8 @@ void request_verify(char const *file, int line, REQUEST const *request)
 			    "CONSISTENCY CHECK FAILED %s[%i]: expected REQUEST size of %zu bytes, got %zu bytes",
 			    file, line, sizeof(REQUEST), talloc_get_size(request));
 
-	fr_pair_list_verify(file, line, request, request->control);
-	fr_pair_list_verify(file, line, request->state_ctx, request->state);
+	fr_pair_list_verify(file, line, request, fr_pair_list_head(&request->control));
+	fr_pair_list_verify(file, line, request->state_ctx, fr_pair_list_head(&request->state));
 
 	fr_assert(request->server_cs != NULL);
 
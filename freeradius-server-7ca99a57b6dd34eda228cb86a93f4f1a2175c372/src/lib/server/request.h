@@ -103,16 +103,19 @@ struct fr_request_s {
 	RADIUS_PACKET		*packet;	//!< Incoming request.
 	RADIUS_PACKET		*reply;		//!< Outgoing response.
 
-	VALUE_PAIR		*control;	//!< #VALUE_PAIR (s) used to set per request parameters
+	fr_pair_list_t		control;	//!< #VALUE_PAIR (s) used to set per request parameters
 						//!< for modules and the server core at runtime.
 
 	uint64_t		seq_start;	//!< State sequence ID.  Stable identifier for a sequence of requests
 						//!< and responses.
 	TALLOC_CTX		*state_ctx;	//!< for request->state
-	VALUE_PAIR		*state;		//!< #VALUE_PAIR (s) available over the lifetime of the authentication
+	fr_pair_list_t		state;		//!< #VALUE_PAIR (s) available over the lifetime of the authentication
 						//!< attempt. Useful where the attempt involves a sequence of
 						//!< many request/challenge packets, like OTP, and EAP.
 
+	fr_pair_arena_t		*pair_arena;	//!< Pairs in the request's lists are allocated from this
+						//!< while a worker is processing the request.
+
 	rad_master_state_t	master_state;	//!< Set by the master thread to signal the child that's currently
 						//!< working with the request, to do something.
 
@@ -193,6 +196,8 @@ REQUEST		*_request_alloc_detachable(char const *file, int line, REQUEST *request
 
 int		request_detach(REQUEST *fake, bool will_free);
 
+int		request_pair_arena_init(REQUEST *request);
+
 #ifdef WITH_VERIFY_PTR
 void		request_verify(char const *file, int line, REQUEST const *request);	/* only for special debug builds */
 #endif
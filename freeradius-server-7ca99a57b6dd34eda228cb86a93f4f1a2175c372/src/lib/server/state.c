@@ -55,6 +55,12 @@ RCSID("$Id$")
 #include <freeradius-devel/util/misc.h>
 #include <freeradius-devel/util/rand.h>
 
+#ifdef HAVE_STDATOMIC_H
+#  include <stdatomic.h>
+#else
+#  include <freeradius-devel/util/stdatomic.h>
+#endif
+
 /** Holds a state value, and associated VALUE_PAIRs and data
  *
  */
@@ -112,28 +118,59 @@ typedef struct {
 	REQUEST			*thawed;			//!< The request that thawed this entry.
 } fr_state_entry_t;
 
+/** One shard of the state tree
+ *
+ * Each shard has its own lock, lookup table and expiry list.  An
+ * entry lives in the shard picked by the hash of its state value,
+ * so workers handling different sessions rarely touch the same lock.
+ */
+typedef struct {
+	pthread_mutex_t		mutex;				//!< Synchronisation mutex.
+	fr_hash_table_t		*ht;				//!< Lookup by state value.
+	fr_dlist_head_t		to_expire;			//!< Entries ordered by cleanup time.
+
+	uint64_t		created;			//!< Number of entries inserted into this shard.
+	uint64_t		timed_out;			//!< Number of entries cleaned up due to timeout.
+	uint64_t		rejected;			//!< Number of entries refused because we were
+								//!< at max_sessions.
+	uint32_t		high_water;			//!< Most entries this shard has held at once.
+} fr_state_shard_t;
+
 struct fr_state_tree_s {
-	uint64_t		id;				//!< Next ID to assign.
-	uint64_t		timed_out;			//!< Number of states that were cleaned up due to
-								//!< timeout.
 	uint32_t		max_sessions;			//!< Maximum number of sessions we track.
-	rbtree_t		*tree;				//!< rbtree used to lookup state value.
-	fr_dlist_head_t		to_expire;			//!< Linked list of entries to free.
+	atomic_uint_fast32_t	tracked;			//!< Number of entries in all shards.
+	atomic_uint_fast64_t	id;				//!< Next ID to assign, unique across all shards.
 
 	uint32_t		timeout;			//!< How long to wait before cleaning up state entires.
 
-	bool			thread_safe;			//!< Whether we lock the tree whilst modifying it.
-	pthread_mutex_t		mutex;				//!< Synchronisation mutex.
+	bool			thread_safe;			//!< Whether we lock the shards whilst modifying them.
 
 	uint8_t			server_id;			//!< ID to use for load balancing.
 
 	fr_dict_attr_t const	*da;				//!< State attribute used.
+
+	uint32_t		num_shards;			//!< Always a power of two.
+	fr_state_shard_t	*shard;				//!< Array of shards.
 };
 
+/** How many shards a thread safe tree has
+ *
+ * Must be a power of two, and no more than 256.
+ */
+#define STATE_NUM_SHARDS	(32)
+
 #define PTHREAD_MUTEX_LOCK if (state->thread_safe) pthread_mutex_lock
 #define PTHREAD_MUTEX_UNLOCK if (state->thread_safe) pthread_mutex_unlock
 
-static void state_entry_unlink(fr_state_tree_t *state, fr_state_entry_t *entry);
+/** Hash an entry based on its state value
+ *
+ */
+static uint32_t state_entry_hash(void const *data)
+{
+	fr_state_entry_t const *entry = data;
+
+	return fr_hash(entry->state, sizeof(entry->state));
+}
 
 /** Compare two fr_state_entry_t based on their state value i.e. the value of the attribute
  *
@@ -145,27 +182,139 @@ static int state_entry_cmp(void const *one, void const *two)
 	return memcmp(a->state, b->state, sizeof(a->state));
 }
 
-/** Free the state tree
+/** Find the shard which holds a particular state value
  *
+ * The hash table uses the low bits of the hash, so we pick the shard
+ * from the high bits.  Otherwise each shard would only ever use a
+ * fraction of its buckets.
  */
-static int _state_tree_free(fr_state_tree_t *state)
+static inline fr_state_shard_t *state_shard(fr_state_tree_t *state, fr_state_entry_t const *entry)
 {
-	fr_state_entry_t *entry;
+	return &state->shard[(state_entry_hash(entry) >> 24) & (state->num_shards - 1)];
+}
+
+/** Unlink an entry and remove it from its shard
+ *
+ * @note Called with the shard mutex held.
+ */
+static void state_entry_unlink(fr_state_tree_t *state, fr_state_shard_t *shard, fr_state_entry_t *entry)
+{
+	/*
+	 *	Check the memory is still valid
+	 */
+	(void) talloc_get_type_abort(entry, fr_state_entry_t);
 
-	if (state->thread_safe) pthread_mutex_destroy(&state->mutex);
+	fr_dlist_remove(&shard->to_expire, entry);
 
-	DEBUG4("Freeing state tree %p", state);
+	(void) fr_hash_table_yank(shard->ht, entry);
+
+	atomic_fetch_sub_explicit(&state->tracked, 1, memory_order_relaxed);
 
-	while ((entry = fr_dlist_head(&state->to_expire))) {
-		DEBUG4("Freeing state entry %p (%"PRIu64")", entry, entry->id);
-		state_entry_unlink(state, entry);
+	DEBUG4("State ID %" PRIu64 " unlinked", entry->id);
+}
+
+/** Put back an entry which was unlinked by state_entry_unlink()
+ *
+ * The entry gets a fresh timeout, so it can go at the end of the
+ * expiry list.
+ *
+ * @note Called with no mutex held.
+ */
+static void state_entry_relink(fr_state_tree_t *state, fr_state_entry_t *entry)
+{
+	fr_state_shard_t	*shard = state_shard(state, entry);
+
+	PTHREAD_MUTEX_LOCK(&shard->mutex);
+	if (!fr_hash_table_insert(shard->ht, entry)) {
+		PTHREAD_MUTEX_UNLOCK(&shard->mutex);
 		talloc_free(entry);
+		return;
 	}
 
-	/*
-	 *	Free the rbtree
-	 */
-	talloc_free(state->tree);
+	entry->cleanup = time(NULL) + state->timeout;
+	fr_dlist_insert_tail(&shard->to_expire, entry);
+	atomic_fetch_add_explicit(&state->tracked, 1, memory_order_relaxed);
+	PTHREAD_MUTEX_UNLOCK(&shard->mutex);
+
+	DEBUG4("State ID %" PRIu64 " relinked", entry->id);
+}
+
+/** Unlink all of the entries in a shard which have expired
+ *
+ * Entries all have the same lifetime, so the expiry list is ordered
+ * by cleanup time, and we only ever look at the head of it.
+ *
+ * @note Called with the shard mutex held.
+ *
+ * @param[in] state	tree the shard belongs to.
+ * @param[in] shard	to clean up.
+ * @param[out] to_free	expired entries, to be freed once the mutex is released.
+ * @param[in] now	the current time.
+ * @return the number of entries which expired.
+ */
+static uint64_t state_shard_expire(fr_state_tree_t *state, fr_state_shard_t *shard, fr_dlist_head_t *to_free, time_t now)
+{
+	fr_state_entry_t	*entry;
+	uint64_t		timed_out = 0;
+
+	while ((entry = fr_dlist_head(&shard->to_expire)) != NULL) {
+		(void)talloc_get_type_abort(entry, fr_state_entry_t);	/* Allow examination */
+
+		if (entry->cleanup >= now) break;
+
+		state_entry_unlink(state, shard, entry);
+		fr_dlist_insert_tail(to_free, entry);
+		timed_out++;
+	}
+
+	shard->timed_out += timed_out;
+
+	return timed_out;
+}
+
+/** Free a list of unlinked entries
+ *
+ * We do it outside of the mutex, as freeing may involve significantly
+ * more work than just freeing the data.  If there's request data that
+ * was persisted it will now be freed also, and it may have complex
+ * destructors associated with it.
+ */
+static void state_entry_list_free(fr_dlist_head_t *to_free)
+{
+	fr_state_entry_t *entry;
+
+	while ((entry = fr_dlist_head(to_free)) != NULL) {
+		fr_dlist_remove(to_free, entry);
+		talloc_free(entry);
+	}
+}
+
+/** Free the state tree
+ *
+ */
+static int _state_tree_free(fr_state_tree_t *state)
+{
+	fr_state_entry_t	*entry;
+	uint32_t		i;
+
+	DEBUG4("Freeing state tree %p", state);
+
+	for (i = 0; i < state->num_shards; i++) {
+		fr_state_shard_t *shard = &state->shard[i];
+
+		if (state->thread_safe) pthread_mutex_destroy(&shard->mutex);
+
+		while ((entry = fr_dlist_head(&shard->to_expire))) {
+			DEBUG4("Freeing state entry %p (%"PRIu64")", entry, entry->id);
+			state_entry_unlink(state, shard, entry);
+			talloc_free(entry);
+		}
+
+		/*
+		 *	Free the hash table
+		 */
+		fr_hash_table_free(shard->ht);
+	}
 
 	return 0;
 }
@@ -175,6 +324,8 @@ static int _state_tree_free(fr_state_tree_t *state)
  * @param[in] ctx		to link the lifecycle of the state tree to.
  * @param[in] da		Attribute used to store and retrieve state from.
  * @param[in] thread_safe		Whether we should mutex protect the state tree.
+ *				Thread safe trees are split into #STATE_NUM_SHARDS
+ *				shards, each with their own mutex.
  * @param[in] max_sessions	we track state for.
  * @param[in] timeout		How long to wait before cleaning up entries.
  * @param[in] server_id		ID byte to use in load-balancing operations.
@@ -186,12 +337,15 @@ fr_state_tree_t *fr_state_tree_init(TALLOC_CTX *ctx, fr_dict_attr_t const *da, b
 				    uint32_t max_sessions, uint32_t timeout, uint8_t server_id)
 {
 	fr_state_tree_t *state;
+	uint32_t	i;
 
 	state = talloc_zero(NULL, fr_state_tree_t);
 	if (!state) return 0;
 
 	state->max_sessions = max_sessions;
 	state->timeout = timeout;
+	atomic_init(&state->tracked, 0);
+	atomic_init(&state->id, 0);
 
 	/*
 	 *	Create a break in the contexts.
@@ -202,23 +356,39 @@ fr_state_tree_t *fr_state_tree_init(TALLOC_CTX *ctx, fr_dict_attr_t const *da, b
 	 */
 	talloc_link_ctx(ctx, state);
 
-	if (thread_safe && (pthread_mutex_init(&state->mutex, NULL) != 0)) {
+	state->num_shards = thread_safe ? STATE_NUM_SHARDS : 1;
+	state->shard = talloc_zero_array(state, fr_state_shard_t, state->num_shards);
+	if (!state->shard) {
 		talloc_free(state);
 		return NULL;
 	}
 
-	fr_dlist_talloc_init(&state->to_expire, fr_state_entry_t, list);
+	for (i = 0; i < state->num_shards; i++) {
+		fr_state_shard_t *shard = &state->shard[i];
 
-	/*
-	 *	We need to do controlled freeing of the
-	 *	rbtree, so that all the state entries
-	 *	are freed before it's destroyed.  Hence
-	 *	it being parented from the NULL ctx.
-	 */
-	state->tree = rbtree_talloc_alloc(NULL, state_entry_cmp, fr_state_entry_t, NULL, 0);
-	if (!state->tree) {
-		talloc_free(state);
-		return NULL;
+		if (thread_safe && (pthread_mutex_init(&shard->mutex, NULL) != 0)) {
+		error:
+			while (i-- > 0) {
+				if (thread_safe) pthread_mutex_destroy(&state->shard[i].mutex);
+				fr_hash_table_free(state->shard[i].ht);
+			}
+			talloc_free(state);
+			return NULL;
+		}
+
+		fr_dlist_talloc_init(&shard->to_expire, fr_state_entry_t, list);
+
+		/*
+		 *	We need to do controlled freeing of the
+		 *	hash table, so that all the state entries
+		 *	are freed before it's destroyed.  Hence
+		 *	it being parented from the NULL ctx.
+		 */
+		shard->ht = fr_hash_table_create(NULL, state_entry_hash, state_entry_cmp, NULL);
+		if (!shard->ht) {
+			if (thread_safe) pthread_mutex_destroy(&shard->mutex);
+			goto error;
+		}
 	}
 	talloc_set_destructor(state, _state_tree_free);
 
@@ -229,23 +399,6 @@ fr_state_tree_t *fr_state_tree_init(TALLOC_CTX *ctx, fr_dict_attr_t const *da, b
 	return state;
 }
 
-/** Unlink an entry and remove if from the tree
- *
- */
-static void state_entry_unlink(fr_state_tree_t *state, fr_state_entry_t *entry)
-{
-	/*
-	 *	Check the memory is still valid
-	 */
-	(void) talloc_get_type_abort(entry, fr_state_entry_t);
-
-	fr_dlist_remove(&state->to_expire, entry);
-
-	rbtree_deletebydata(state->tree, entry);
-
-	DEBUG4("State ID %" PRIu64 " unlinked", entry->id);
-}
-
 /** Frees any data associated with a state
  *
  */
@@ -286,117 +439,31 @@ static int _state_entry_free(fr_state_entry_t *entry)
 
 /** Create a new state entry
  *
- * @note Called with the mutex held.
+ * The entry isn't in any shard yet.  The caller fills it in, and
+ * then calls state_entry_insert().
+ *
+ * @note Called with no mutex held.
+ *
+ * @param[in] state	tree the entry will go into.
+ * @param[in] request	the entry is for.
+ * @param[in] packet	to add the State attribute to.
+ * @param[in] old_state	State value of the previous round, or NULL.
+ * @param[in] old_tries	How many rounds the previous entry had seen.
  */
 static fr_state_entry_t *state_entry_create(fr_state_tree_t *state, REQUEST *request,
-					    RADIUS_PACKET *packet, fr_state_entry_t *old)
+					    RADIUS_PACKET *packet, uint8_t const *old_state, int old_tries)
 {
 	size_t			i;
 	uint32_t		x;
 	time_t			now = time(NULL);
 	VALUE_PAIR		*vp;
-	fr_state_entry_t	*entry, *next;
-
-	uint8_t			old_state[sizeof(old->state)];
-	int			old_tries = 0;
-	uint64_t		timed_out = 0;
-	bool			too_many = false;
-	fr_dlist_head_t		to_free;
-
-	fr_dlist_init(&to_free, fr_state_entry_t, list);
-
-	/*
-	 *	Clean up old entries.
-	 */
-	for (entry = fr_dlist_head(&state->to_expire);
-	     entry != NULL;
-	     entry = next) {
-		(void)talloc_get_type_abort(entry, fr_state_entry_t);	/* Allow examination */
-		next = fr_dlist_next(&state->to_expire, entry);		/* Advance *before* potential unlinking */
-
-		if (entry == old) continue;
-
-		/*
-		 *	Too old, we can delete it.
-		 */
-		if (entry->cleanup < now) {
-			state_entry_unlink(state, entry);
-			fr_dlist_insert_tail(&to_free, entry);
-			timed_out++;
-			continue;
-		}
-
-		break;
-	}
-
-	state->timed_out += timed_out;
-
-	if (!old && (rbtree_num_elements(state->tree) >= (uint32_t) state->max_sessions)) too_many = true;
-
-	/*
-	 *	Record the information from the old state, we may base the
-	 *	new state off the old one.
-	 *
-	 *	Once we release the mutex, the state of old becomes indeterminate
-	 *	so we have to grab the values now.
-	 */
-	if (old) {
-		old_tries = old->tries;
-
-		memcpy(old_state, old->state, sizeof(old_state));
-
-		/*
-		 *	The old one isn't used any more, so we can free it.
-		 */
-		if (fr_dlist_empty(&old->data)) {
-			state_entry_unlink(state, old);
-			fr_dlist_insert_tail(&to_free, old);
-		}
-	}
-	PTHREAD_MUTEX_UNLOCK(&state->mutex);
-
-	if (timed_out > 0) RWDEBUG("Cleaning up %"PRIu64" timed out state entries", timed_out);
-
-	/*
-	 *	Now free the unlinked entries.
-	 *
-	 *	We do it here as freeing may involve significantly more
-	 *	work than just freeing the data.
-	 *
-	 *	If there's request data that was persisted it will now
-	 *	be freed also, and it may have complex destructors associated
-	 *	with it.
-	 */
-	while ((entry = fr_dlist_head(&to_free)) != NULL) {
-		fr_dlist_remove(&to_free, entry);
-		talloc_free(entry);
-	}
-
-	/*
-	 *	Have to do this post-cleanup, else we end up returning with
-	 *	a list full of entries to free with none of them being
-	 *	freed which is bad...
-	 */
-	if (too_many) {
-		RERROR("Failed inserting state entry - At maximum ongoing session limit (%u)",
-		       state->max_sessions);
-		PTHREAD_MUTEX_LOCK(&state->mutex);	/* Caller expects this to be locked */
-		return NULL;
-	}
+	fr_state_entry_t	*entry;
 
-	/*
-	 *	Allocation doesn't need to occur inside the critical region
-	 *	and would add significantly to contention.
-	 */
 	entry = talloc_zero(NULL, fr_state_entry_t);
-	if (!entry) {
-		PTHREAD_MUTEX_LOCK(&state->mutex);	/* Caller expects this to be locked */
-		return NULL;
-	}
+	if (!entry) return NULL;
 
 	request_data_list_init(&entry->data);
 	talloc_set_destructor(entry, _state_entry_free);
-	entry->id = state->id++;
 
 	/*
 	 *	Limit the lifetime of this entry based on how long the
@@ -412,7 +479,7 @@ static fr_state_entry_t *state_entry_create(fr_state_tree_t *state, REQUEST *req
 	 *	int the reply, we use that in preference to the
 	 *	old state.
 	 */
-	vp = fr_pair_find_by_da(packet->vps, state->da, TAG_ANY);
+	vp = fr_pair_list_find_by_da(&packet->vps, state->da, TAG_ANY);
 	if (vp) {
 		if (DEBUG_ENABLED && (vp->vp_length > sizeof(entry->state))) {
 			WARN("State too long, will be truncated.  Expected <= %zd bytes, got %zu bytes",
@@ -445,7 +512,7 @@ static fr_state_entry_t *state_entry_create(fr_state_tree_t *state, REQUEST *req
 		 *	16 octets of randomness should be enough to
 		 *	have a globally unique state.
 		 */
-		if (old) {
+		if (old_state) {
 			memcpy(entry->state, old_state, sizeof(entry->state));
 			entry->tries = old_tries + 1;
 		/*
@@ -477,13 +544,11 @@ static fr_state_entry_t *state_entry_create(fr_state_tree_t *state, REQUEST *req
 
 		MEM(vp = fr_pair_afrom_da(packet, state->da));
 		fr_pair_value_memdup(vp, entry->state, sizeof(entry->state), false);
-		fr_pair_add(&packet->vps, vp);
+		fr_pair_list_append(&packet->vps, vp);
 	}
 
-	DEBUG4("State ID %" PRIu64 " created, value 0x%pH, expires %" PRIu64 "s",
-	       entry->id, fr_box_octets(entry->state, sizeof(entry->state)), (uint64_t)entry->cleanup - now);
-
-	PTHREAD_MUTEX_LOCK(&state->mutex);
+	DEBUG4("State value 0x%pH created, expires %" PRIu64 "s",
+	       fr_box_octets(entry->state, sizeof(entry->state)), (uint64_t)entry->cleanup - now);
 
 	/*
 	 *	XOR the server hash with four bytes of random data.
@@ -493,57 +558,145 @@ static fr_state_entry_t *state_entry_create(fr_state_tree_t *state, REQUEST *req
 	 */
 	*((uint32_t *)(&entry->state_comp.server_hash)) ^= fr_hash_string(cf_section_name2(request->server_cs));
 
-	if (!rbtree_insert(state->tree, entry)) {
+	return entry;
+}
+
+/** Insert a new entry into its shard
+ *
+ * Expired entries in the shard are cleaned up first.  If we're at
+ * max_sessions, we also clean up the other shards before giving up.
+ *
+ * @note Called with no mutex held.
+ *
+ * @param[in] state	tree to insert the entry into.
+ * @param[in] request	the entry is for.
+ * @param[in] entry	to insert.
+ * @param[in] continued	true if this entry replaces one from a previous round.
+ *			These are always allowed, even at max_sessions.
+ * @return
+ *	- 0 on success.
+ *	- -1 on failure.  The caller still owns the entry.
+ */
+static int state_entry_insert(fr_state_tree_t *state, REQUEST *request, fr_state_entry_t *entry, bool continued)
+{
+	fr_state_shard_t	*shard = state_shard(state, entry);
+	time_t			now = time(NULL);
+	uint64_t		timed_out;
+	uint32_t		tracked, num;
+	fr_dlist_head_t		to_free;
+
+	fr_dlist_init(&to_free, fr_state_entry_t, list);
+
+	PTHREAD_MUTEX_LOCK(&shard->mutex);
+	timed_out = state_shard_expire(state, shard, &to_free, now);
+
+	if (!continued && (atomic_load_explicit(&state->tracked, memory_order_relaxed) >= state->max_sessions)) {
+		uint32_t i;
+
+		PTHREAD_MUTEX_UNLOCK(&shard->mutex);
+
+		/*
+		 *	Other shards may have expired entries which
+		 *	nothing has cleaned up yet.
+		 */
+		for (i = 0; i < state->num_shards; i++) {
+			fr_state_shard_t *other = &state->shard[i];
+
+			if (other == shard) continue;
+
+			PTHREAD_MUTEX_LOCK(&other->mutex);
+			timed_out += state_shard_expire(state, other, &to_free, now);
+			PTHREAD_MUTEX_UNLOCK(&other->mutex);
+		}
+
+		PTHREAD_MUTEX_LOCK(&shard->mutex);
+		if (atomic_load_explicit(&state->tracked, memory_order_relaxed) >= state->max_sessions) {
+			shard->rejected++;
+			PTHREAD_MUTEX_UNLOCK(&shard->mutex);
+
+			if (timed_out > 0) RWDEBUG("Cleaning up %"PRIu64" timed out state entries", timed_out);
+			state_entry_list_free(&to_free);
+
+			RERROR("Failed inserting state entry - At maximum ongoing session limit (%u)",
+			       state->max_sessions);
+			return -1;
+		}
+	}
+
+	if (!fr_hash_table_insert(shard->ht, entry)) {
+		PTHREAD_MUTEX_UNLOCK(&shard->mutex);
+
+		if (timed_out > 0) RWDEBUG("Cleaning up %"PRIu64" timed out state entries", timed_out);
+		state_entry_list_free(&to_free);
+
 		RERROR("Failed inserting state entry - Insertion into state tree failed");
-		fr_pair_delete_by_da(&packet->vps, state->da);
-		talloc_free(entry);
-		return NULL;
+		return -1;
 	}
 
+	entry->id = atomic_fetch_add_explicit(&state->id, 1, memory_order_relaxed);
+	shard->created++;
+
 	/*
 	 *	Link it to the end of the list, which is implicitely
 	 *	ordered by cleanup time.
 	 */
-	fr_dlist_insert_tail(&state->to_expire, entry);
+	fr_dlist_insert_tail(&shard->to_expire, entry);
 
-	return entry;
+	tracked = atomic_fetch_add_explicit(&state->tracked, 1, memory_order_relaxed);
+	num = fr_hash_table_num_elements(shard->ht);
+	if (num > shard->high_water) shard->high_water = num;
+	PTHREAD_MUTEX_UNLOCK(&shard->mutex);
+
+	DEBUG4("State ID %" PRIu64 " inserted, %u entries tracked", entry->id, tracked + 1);
+
+	if (timed_out > 0) RWDEBUG("Cleaning up %"PRIu64" timed out state entries", timed_out);
+	state_entry_list_free(&to_free);
+
+	return 0;
 }
 
-/** Find the entry, based on the State attribute
+/** Build the key used to look up an entry, based on the State attribute
  *
  */
-static fr_state_entry_t *state_entry_find(fr_state_tree_t *state, REQUEST *request, fr_value_box_t const *vb)
+static void state_entry_key(fr_state_entry_t *my_entry, REQUEST *request, fr_value_box_t const *vb)
 {
-	fr_state_entry_t *entry, my_entry;
-
 	/*
 	 *	Assume our own State first.
 	 */
-	if (vb->vb_length == sizeof(my_entry.state)) {
-		memcpy(my_entry.state, vb->vb_octets, sizeof(my_entry.state));
+	if (vb->vb_length == sizeof(my_entry->state)) {
+		memcpy(my_entry->state, vb->vb_octets, sizeof(my_entry->state));
 
 		/*
 		 *	Too big?  Get the MD5 hash, in order
 		 *	to depend on the entire contents of State.
 		 */
-	} else if (vb->vb_length > sizeof(my_entry.state)) {
-		fr_md5_calc(my_entry.state, vb->vb_octets, vb->vb_length);
+	} else if (vb->vb_length > sizeof(my_entry->state)) {
+		fr_md5_calc(my_entry->state, vb->vb_octets, vb->vb_length);
 
 		/*
 		 *	Too small?  Use the whole thing, and
 		 *	set the rest of my_entry.state to zero.
 		 */
 	} else {
-		memcpy(my_entry.state, vb->vb_octets, vb->vb_length);
-		memset(&my_entry.state[vb->vb_length], 0, sizeof(my_entry.state) - vb->vb_length);
+		memcpy(my_entry->state, vb->vb_octets, vb->vb_length);
+		memset(&my_entry->state[vb->vb_length], 0, sizeof(my_entry->state) - vb->vb_length);
 	}
 
 	/*
 	 *	Make it unique for different virtual servers handling the same request
 	 */
-	my_entry.state_comp.server_hash ^= fr_hash_string(cf_section_name2(request->server_cs));
+	my_entry->state_comp.server_hash ^= fr_hash_string(cf_section_name2(request->server_cs));
+}
+
+/** Find the entry, based on the key from state_entry_key()
+ *
+ * @note Called with the shard mutex held.
+ */
+static fr_state_entry_t *state_entry_find(fr_state_shard_t *shard, fr_state_entry_t const *my_entry)
+{
+	fr_state_entry_t *entry;
 
-	entry = rbtree_finddata(state->tree, &my_entry);
+	entry = fr_hash_table_finddata(shard->ht, my_entry);
 
 	if (entry) (void) talloc_get_type_abort(entry, fr_state_entry_t);
 
@@ -555,20 +708,24 @@ static fr_state_entry_t *state_entry_find(fr_state_tree_t *state, REQUEST *reque
  */
 void fr_state_discard(fr_state_tree_t *state, REQUEST *request)
 {
-	fr_state_entry_t	*entry;
+	fr_state_entry_t	*entry, my_entry;
+	fr_state_shard_t	*shard;
 	VALUE_PAIR		*vp;
 
-	vp = fr_pair_find_by_da(request->packet->vps, state->da, TAG_ANY);
+	vp = fr_pair_list_find_by_da(&request->packet->vps, state->da, TAG_ANY);
 	if (!vp) return;
 
-	PTHREAD_MUTEX_LOCK(&state->mutex);
-	entry = state_entry_find(state, request, &vp->data);
+	state_entry_key(&my_entry, request, &vp->data);
+	shard = state_shard(state, &my_entry);
+
+	PTHREAD_MUTEX_LOCK(&shard->mutex);
+	entry = state_entry_find(shard, &my_entry);
 	if (!entry) {
-		PTHREAD_MUTEX_UNLOCK(&state->mutex);
+		PTHREAD_MUTEX_UNLOCK(&shard->mutex);
 		return;
 	}
-	state_entry_unlink(state, entry);
-	PTHREAD_MUTEX_UNLOCK(&state->mutex);
+	state_entry_unlink(state, shard, entry);
+	PTHREAD_MUTEX_UNLOCK(&shard->mutex);
 
 	/*
 	 *	If fr_state_to_request was never called, this ensures
@@ -586,8 +743,8 @@ void fr_state_discard(fr_state_tree_t *state, REQUEST *request)
 	 *	stupid like add additional session-state attributes
 	 *	in  one of the later sections.
 	 */
+	(void)fr_pair_list_detach(&request->state);
 	TALLOC_FREE(request->state_ctx);
-	request->state = NULL;
 
 	MEM(request->state_ctx = talloc_init_const("session-state"));
 
@@ -605,29 +762,33 @@ void fr_state_discard(fr_state_tree_t *state, REQUEST *request)
  */
 void fr_state_to_request(fr_state_tree_t *state, REQUEST *request)
 {
-	fr_state_entry_t	*entry;
+	fr_state_entry_t	*entry, my_entry;
+	fr_state_shard_t	*shard;
 	TALLOC_CTX		*old_ctx = NULL;
 	VALUE_PAIR		*vp;
 
-	fr_assert(request->state == NULL);
+	fr_assert(fr_pair_list_head(&request->state) == NULL);
 
 	/*
 	 *	No State, don't do anything.
 	 */
-	vp = fr_pair_find_by_da(request->packet->vps, state->da, TAG_ANY);
+	vp = fr_pair_list_find_by_da(&request->packet->vps, state->da, TAG_ANY);
 	if (!vp) {
 		RDEBUG3("No &request:State attribute, can't restore &session-state");
 		if (request->seq_start == 0) request->seq_start = request->number;	/* Need check for fake requests */
 		return;
 	}
 
-	PTHREAD_MUTEX_LOCK(&state->mutex);
-	entry = state_entry_find(state, request, &vp->data);
+	state_entry_key(&my_entry, request, &vp->data);
+	shard = state_shard(state, &my_entry);
+
+	PTHREAD_MUTEX_LOCK(&shard->mutex);
+	entry = state_entry_find(shard, &my_entry);
 	if (entry) {
 		(void)talloc_get_type_abort(entry, fr_state_entry_t);
 		if (entry->thawed) {
 			REDEBUG("State entry has already been thawed by a request %"PRIu64, entry->thawed->number);
-			PTHREAD_MUTEX_UNLOCK(&state->mutex);
+			PTHREAD_MUTEX_UNLOCK(&shard->mutex);
 			return;
 		}
 		if (request->state_ctx) old_ctx = request->state_ctx;	/* Store for later freeing */
@@ -636,18 +797,18 @@ void fr_state_to_request(fr_state_tree_t *state, REQUEST *request)
 
 		request->seq_start = entry->seq_start;
 		request->state_ctx = entry->ctx;
-		request->state = entry->vps;
+		fr_pair_list_append(&request->state, entry->vps);
 		request_data_restore(request, &entry->data);
 
 		entry->ctx = NULL;
 		entry->vps = NULL;
 		entry->thawed = request;
 	}
-	PTHREAD_MUTEX_UNLOCK(&state->mutex);
+	PTHREAD_MUTEX_UNLOCK(&shard->mutex);
 
-	if (request->state) {
+	if (fr_pair_list_head(&request->state)) {
 		RDEBUG2("Restored &session-state");
-		log_request_pair_list(L_DBG_LVL_2, request, request->state, "&session-state:");
+		log_request_pair_list(L_DBG_LVL_2, request, fr_pair_list_head(&request->state), "&session-state:");
 	}
 
 	/*
@@ -671,30 +832,66 @@ void fr_state_to_request(fr_state_tree_t *state, REQUEST *request)
  */
 int fr_request_to_state(fr_state_tree_t *state, REQUEST *request)
 {
-	fr_state_entry_t	*entry, *old = NULL;
+	fr_state_entry_t	*entry, *old = NULL, my_entry;
 	fr_dlist_head_t		data;
 	VALUE_PAIR		*vp;
+	uint8_t			old_state[sizeof(my_entry.state)];
+	int			old_tries = 0;
+	bool			continued = false;
 
 	request_data_list_init(&data);
 	request_data_by_persistance(&data, request, true);
 
-	if (!request->state && fr_dlist_empty(&data)) return 0;
+	if (!fr_pair_list_head(&request->state) && fr_dlist_empty(&data)) return 0;
 
-	if (request->state) {
+	if (fr_pair_list_head(&request->state)) {
 		RDEBUG2("Saving &session-state");
-		log_request_pair_list(L_DBG_LVL_2, request, request->state, "&session-state:");
+		log_request_pair_list(L_DBG_LVL_2, request, fr_pair_list_head(&request->state), "&session-state:");
 	}
 
-	vp = fr_pair_find_by_da(request->packet->vps, state->da, TAG_ANY);
+	vp = fr_pair_list_find_by_da(&request->packet->vps, state->da, TAG_ANY);
+	if (vp) {
+		fr_state_shard_t *shard;
+
+		state_entry_key(&my_entry, request, &vp->data);
+		shard = state_shard(state, &my_entry);
 
-	PTHREAD_MUTEX_LOCK(&state->mutex);
-	if (vp) old = state_entry_find(state, request, &vp->data);
+		/*
+		 *	Record the information from the old state, we
+		 *	may base the new state off the old one.
+		 *
+		 *	Once we release the mutex, the state of old
+		 *	becomes indeterminate so we have to grab the
+		 *	values now.
+		 */
+		PTHREAD_MUTEX_LOCK(&shard->mutex);
+		old = state_entry_find(shard, &my_entry);
+		if (old) {
+			continued = true;
+			old_tries = old->tries;
+			memcpy(old_state, old->state, sizeof(old_state));
 
-	entry = state_entry_create(state, request, request->reply, old);
+			/*
+			 *	The old one isn't used any more.  Take it
+			 *	out of the tree, but only free it once the
+			 *	new entry is in, so that the session isn't
+			 *	lost if the insertion fails.
+			 */
+			if (fr_dlist_empty(&old->data)) {
+				state_entry_unlink(state, shard, old);
+			} else {
+				old = NULL;
+			}
+		}
+		PTHREAD_MUTEX_UNLOCK(&shard->mutex);
+	}
+
+	entry = state_entry_create(state, request, request->reply, continued ? old_state : NULL, old_tries);
 	if (!entry) {
-		PTHREAD_MUTEX_UNLOCK(&state->mutex);
+	error:
 		RERROR("Creating state entry failed");
 		request_data_restore(request, &data);	/* Put it back again */
+		if (old) state_entry_relink(state, old);
 		return -1;
 	}
 
@@ -703,13 +900,30 @@ int fr_request_to_state(fr_state_tree_t *state, REQUEST *request)
 
 	entry->seq_start = request->seq_start;
 	entry->ctx = request->state_ctx;
-	entry->vps = request->state;
+	entry->vps = fr_pair_list_detach(&request->state);
 	fr_dlist_move(&entry->data, &data);
 
-	request->state_ctx = NULL;
-	request->state = NULL;
+	if (state_entry_insert(state, request, entry, continued) < 0) {
+		/*
+		 *	Give everything back to the request, and
+		 *	don't send a State value we won't recognise.
+		 */
+		fr_dlist_move(&data, &entry->data);
+		fr_pair_list_append(&request->state, entry->vps);
+		entry->ctx = NULL;
+		entry->vps = NULL;
+		talloc_free(entry);
+
+		fr_pair_list_delete_by_da(&request->reply->vps, state->da);
+		goto error;
+	}
+
+	/*
+	 *	Free this outside of the mutex for less contention.
+	 */
+	if (old) talloc_free(old);
 
-	PTHREAD_MUTEX_UNLOCK(&state->mutex);
+	request->state_ctx = NULL;
 
 	RDEBUG3("RADIUS State - saved");
 	REQUEST_VERIFY(request);
@@ -737,7 +951,7 @@ void fr_state_store_in_parent(REQUEST *request, void const *unique_ptr, int uniq
 	 *	it easier to store/restore the
 	 *	whole lot...
 	 */
-	if (request->state) {
+	if (fr_pair_list_head(&request->state)) {
 		/*
 		 *	If parent and child share a state_ctx
 		 *	which they usually should do, then just
@@ -745,8 +959,7 @@ void fr_state_store_in_parent(REQUEST *request, void const *unique_ptr, int uniq
 		 *	and don't bother copying.
 		 */
 		request_data_talloc_add(request, (void *)fr_state_store_in_parent, 0, VALUE_PAIR,
-					request->state, true, false, true);
-		request->state = NULL;
+					fr_pair_list_detach(&request->state), true, false, true);
 	}
 
 	/*
@@ -755,7 +968,7 @@ void fr_state_store_in_parent(REQUEST *request, void const *unique_ptr, int uniq
 	 *	fr_state_store_in_parent and fr_state_restore_to_child.
 	 */
 	if (request_data_store_in_parent(request, unique_ptr, unique_int) < 0) {
-		request->state = request_data_get(request, (void *)fr_state_store_in_parent, 0);
+		fr_pair_list_append(&request->state, request_data_get(request, (void *)fr_state_store_in_parent, 0));
 		return;
 	}
 }
@@ -785,7 +998,7 @@ void fr_state_restore_to_child(REQUEST *request, void const *unique_ptr, int uni
 	/*
 	 *	Get the state vps back
 	 */
-	request->state = request_data_get(request, (void *)fr_state_store_in_parent, 0);
+	fr_pair_list_append(&request->state, request_data_get(request, (void *)fr_state_store_in_parent, 0));
 }
 
 /** Move all request data and session-state VPs into a new state_ctx
@@ -809,7 +1022,7 @@ void fr_state_detach(REQUEST *request, bool will_free)
 	if (unlikely(request->parent == NULL)) return;
 
 	if (will_free) {
-		fr_pair_list_free(&request->state);
+		fr_pair_list_clear(&request->state);
 
 		/*
 		 *	The non-persistable stuff is
@@ -830,10 +1043,10 @@ void fr_state_detach(REQUEST *request, bool will_free)
 	request_data_by_persistance_reparent(new_state_ctx, NULL, request, true);
 	request_data_by_persistance_reparent(new_state_ctx, NULL, request, false);
 
-	(void) fr_pair_list_copy(new_state_ctx, &vps, request->state);
-	fr_pair_list_free(&request->state);
+	(void) fr_pair_list_copy(new_state_ctx, &vps, fr_pair_list_head(&request->state));
+	fr_pair_list_clear(&request->state);
 
-	request->state = vps;
+	fr_pair_list_append(&request->state, vps);
 
 	/*
 	 *	...again, should probably
@@ -849,7 +1062,7 @@ void fr_state_detach(REQUEST *request, bool will_free)
  */
 uint64_t fr_state_entries_created(fr_state_tree_t *state)
 {
-	return state->id;
+	return atomic_load_explicit(&state->id, memory_order_relaxed);
 }
 
 /** Return number of entries that timed out
@@ -857,7 +1070,18 @@ uint64_t fr_state_entries_created(fr_state_tree_t *state)
  */
 uint64_t fr_state_entries_timeout(fr_state_tree_t *state)
 {
-	return state->timed_out;
+	uint64_t	timed_out = 0;
+	uint32_t	i;
+
+	for (i = 0; i < state->num_shards; i++) {
+		fr_state_shard_t *shard = &state->shard[i];
+
+		PTHREAD_MUTEX_LOCK(&shard->mutex);
+		timed_out += shard->timed_out;
+		PTHREAD_MUTEX_UNLOCK(&shard->mutex);
+	}
+
+	return timed_out;
 }
 
 /** Return number of entries we're currently tracking
@@ -865,5 +1089,63 @@ uint64_t fr_state_entries_timeout(fr_state_tree_t *state)
  */
 uint32_t fr_state_entries_tracked(fr_state_tree_t *state)
 {
-	return (uint32_t)rbtree_num_elements(state->tree);
+	return atomic_load_explicit(&state->tracked, memory_order_relaxed);
 }
+
+static int cmd_stats_state(FILE *fp, UNUSED FILE *fp_err, void *ctx, UNUSED fr_cmd_info_t const *info)
+{
+	fr_state_tree_t	*state = ctx;
+	uint32_t	i;
+
+	fprintf(fp, "max_sessions\t%u\n", state->max_sessions);
+	fprintf(fp, "tracked\t%u\n", fr_state_entries_tracked(state));
+	fprintf(fp, "created\t%" PRIu64 "\n", fr_state_entries_created(state));
+	fprintf(fp, "timeout\t%" PRIu64 "\n", fr_state_entries_timeout(state));
+
+	for (i = 0; i < state->num_shards; i++) {
+		fr_state_shard_t	*shard = &state->shard[i];
+		int			tracked;
+		uint32_t		high_water;
+		uint64_t		created, timed_out, rejected;
+
+		/*
+		 *	Take a snapshot, so we don't hold the lock
+		 *	whilst writing to the socket.
+		 */
+		PTHREAD_MUTEX_LOCK(&shard->mutex);
+		tracked = fr_hash_table_num_elements(shard->ht);
+		high_water = shard->high_water;
+		created = shard->created;
+		timed_out = shard->timed_out;
+		rejected = shard->rejected;
+		PTHREAD_MUTEX_UNLOCK(&shard->mutex);
+
+		fprintf(fp, "shard.%u.tracked\t%d\n", i, tracked);
+		fprintf(fp, "shard.%u.high_water\t%u\n", i, high_water);
+		fprintf(fp, "shard.%u.created\t%" PRIu64 "\n", i, created);
+		fprintf(fp, "shard.%u.timeout\t%" PRIu64 "\n", i, timed_out);
+		fprintf(fp, "shard.%u.rejected\t%" PRIu64 "\n", i, rejected);
+	}
+
+	return 0;
+}
+
+fr_cmd_table_t cmd_state_table[] = {
+	{
+		.parent = "stats",
+		.name = "state",
+		.help = "Statistics for multi-round session state.",
+		.read_only = true
+	},
+
+	{
+		.parent = "stats state",
+		.add_name = true,
+		.name = "self",
+		.func = cmd_stats_state,
+		.help = "Show occupancy of the state shards for a virtual server.",
+		.read_only = true
+	},
+
+	CMD_TABLE_END
+};
@@ -31,6 +31,7 @@ extern "C" {
 #endif
 
 #include <freeradius-devel/util/dict.h>
+#include <freeradius-devel/server/command.h>
 #include <freeradius-devel/server/request.h>
 
 typedef struct fr_state_tree_s fr_state_tree_t;
@@ -53,6 +54,8 @@ uint64_t fr_state_entries_created(fr_state_tree_t *state);
 uint64_t fr_state_entries_timeout(fr_state_tree_t *state);
 uint32_t fr_state_entries_tracked(fr_state_tree_t *state);
 
+extern fr_cmd_table_t cmd_state_table[];
+
 #ifdef __cplusplus
 }
 #endif
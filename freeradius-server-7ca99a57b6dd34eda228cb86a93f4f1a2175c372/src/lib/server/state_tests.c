@@ -0,0 +1,319 @@
+#include <freeradius-devel/util/acutest.h>
+
+#include "state.c"
+
+#define STATE_TEST_ENTRIES	(1024)		//!< Enough that every shard should get a few.
+#define STATE_TEST_THREADS	(4)
+#define STATE_TEST_PER_THREAD	(512)
+
+typedef struct {
+	fr_state_tree_t		*state;			//!< Tree shared by all the threads.
+	REQUEST			*request;		//!< Only used for logging.
+	uint32_t		first;			//!< First state value this thread creates.
+	uint32_t		inserted;		//!< Entries inserted by this thread.
+	uint32_t		found;			//!< Entries this thread found again straight away.
+	uint32_t		misplaced;		//!< Entries found under a state value that wasn't theirs.
+} state_test_thread_t;
+
+/** Produce a unique state value for a number
+ *
+ * The number is multiplied by an odd constant, so no two numbers give
+ * the same first word, and the rest of the value is filled in so the
+ * hash, and so the shard, varies.
+ */
+static void state_test_key(uint8_t *out, size_t outlen, uint32_t n)
+{
+	size_t i;
+
+	for (i = 0; i < outlen; i += sizeof(uint32_t)) {
+		uint32_t word = (n * 2654435761U) ^ (uint32_t)i;
+
+		memcpy(out + i, &word, sizeof(word));
+	}
+}
+
+/** Allocate an entry the same way state_entry_create() does, but with a known state value
+ *
+ */
+static fr_state_entry_t *state_test_entry(uint32_t n, time_t cleanup)
+{
+	fr_state_entry_t *entry;
+
+	entry = talloc_zero(NULL, fr_state_entry_t);
+	request_data_list_init(&entry->data);
+	talloc_set_destructor(entry, _state_entry_free);
+
+	state_test_key(entry->state, sizeof(entry->state), n);
+	entry->cleanup = cleanup;
+
+	return entry;
+}
+
+/** Look up the entry for a number, using only the shard state_shard() picks for it
+ *
+ */
+static fr_state_entry_t *state_test_find(fr_state_tree_t *state, uint32_t n)
+{
+	fr_state_entry_t	my_entry;
+	fr_state_shard_t	*shard;
+	fr_state_entry_t	*entry;
+
+	state_test_key(my_entry.state, sizeof(my_entry.state), n);
+	shard = state_shard(state, &my_entry);
+
+	PTHREAD_MUTEX_LOCK(&shard->mutex);
+	entry = state_entry_find(shard, &my_entry);
+	PTHREAD_MUTEX_UNLOCK(&shard->mutex);
+
+	return entry;
+}
+
+/** Check the number of entries in each shard agrees with the tree
+ *
+ */
+static void state_test_check_shards(fr_state_tree_t *state, uint32_t expected)
+{
+	uint32_t	i;
+	uint32_t	total = 0;
+
+	for (i = 0; i < state->num_shards; i++) {
+		fr_state_shard_t *shard = &state->shard[i];
+
+		TEST_CHECK((size_t)fr_hash_table_num_elements(shard->ht) == fr_dlist_num_elements(&shard->to_expire));
+		total += fr_hash_table_num_elements(shard->ht);
+	}
+
+	TEST_CHECK(total == expected);
+	TEST_MSG("Expected %u entries in the shards, got %u", expected, total);
+
+	TEST_CHECK(fr_state_entries_tracked(state) == expected);
+	TEST_MSG("Expected %u entries tracked, got %u", expected, fr_state_entries_tracked(state));
+}
+
+/** Entries should be spread over all the shards, and only ever be in the one state_shard() picks
+ *
+ */
+static void test_shard_placement(void)
+{
+	TALLOC_CTX		*ctx = talloc_init_const("state_tests");
+	REQUEST			*request = talloc_zero(ctx, REQUEST);
+	fr_state_tree_t		*state;
+	uint32_t		per_shard[STATE_NUM_SHARDS] = { 0 };
+	uint32_t		i, j, used = 0;
+	time_t			cleanup = time(NULL) + 60;
+
+	state = fr_state_tree_init(ctx, NULL, true, STATE_TEST_ENTRIES, 60, 0);
+	TEST_CHECK(state != NULL);
+	TEST_CHECK(state->num_shards == STATE_NUM_SHARDS);
+
+	for (i = 0; i < STATE_TEST_ENTRIES; i++) {
+		fr_state_entry_t *entry = state_test_entry(i, cleanup);
+
+		TEST_CHECK(state_entry_insert(state, request, entry, false) == 0);
+		per_shard[state_shard(state, entry) - state->shard]++;
+	}
+
+	TEST_CHECK(fr_state_entries_created(state) == STATE_TEST_ENTRIES);
+	state_test_check_shards(state, STATE_TEST_ENTRIES);
+
+	for (i = 0; i < state->num_shards; i++) {
+		TEST_CHECK((uint32_t)fr_hash_table_num_elements(state->shard[i].ht) == per_shard[i]);
+		TEST_MSG("Shard %u: expected %u entries, got %i", i, per_shard[i],
+			 fr_hash_table_num_elements(state->shard[i].ht));
+		if (per_shard[i]) used++;
+	}
+	TEST_CHECK(used == state->num_shards);
+	TEST_MSG("Only %u of %u shards used", used, state->num_shards);
+
+	for (i = 0; i < STATE_TEST_ENTRIES; i++) {
+		fr_state_entry_t	my_entry;
+		fr_state_entry_t	*entry;
+		fr_state_shard_t	*shard;
+
+		entry = state_test_find(state, i);
+		TEST_CHECK(entry != NULL);
+		TEST_MSG("State %u not found", i);
+		if (!entry) continue;
+
+		state_test_key(my_entry.state, sizeof(my_entry.state), i);
+		TEST_CHECK(memcmp(entry->state, my_entry.state, sizeof(my_entry.state)) == 0);
+
+		/*
+		 *	It mustn't also be in any of the other shards.
+		 */
+		shard = state_shard(state, &my_entry);
+		for (j = 0; j < state->num_shards; j++) {
+			if (&state->shard[j] == shard) continue;
+
+			TEST_CHECK(fr_hash_table_finddata(state->shard[j].ht, &my_entry) == NULL);
+			TEST_MSG("State %u found in shard %u", i, j);
+		}
+	}
+
+	talloc_free(ctx);
+}
+
+/** Expiring entries should only remove the ones which are due, and leave the rest findable
+ *
+ */
+static void test_shard_expiry(void)
+{
+	TALLOC_CTX		*ctx = talloc_init_const("state_tests");
+	REQUEST			*request = talloc_zero(ctx, REQUEST);
+	fr_state_tree_t		*state;
+	uint32_t		i;
+	uint64_t		timed_out = 0;
+	time_t			now = time(NULL);
+	fr_dlist_head_t		to_free;
+
+	state = fr_state_tree_init(ctx, NULL, true, STATE_TEST_ENTRIES, 60, 0);
+	TEST_CHECK(state != NULL);
+
+	/*
+	 *	The expiry lists are ordered by insertion, so all
+	 *	of the early entries have to go in first.
+	 */
+	for (i = 0; i < STATE_TEST_ENTRIES; i++) {
+		fr_state_entry_t *entry = state_test_entry(i, now + ((i < (STATE_TEST_ENTRIES / 2)) ? 50 : 100));
+
+		TEST_CHECK(state_entry_insert(state, request, entry, false) == 0);
+	}
+	state_test_check_shards(state, STATE_TEST_ENTRIES);
+
+	fr_dlist_init(&to_free, fr_state_entry_t, list);
+	for (i = 0; i < state->num_shards; i++) {
+		fr_state_shard_t *shard = &state->shard[i];
+
+		PTHREAD_MUTEX_LOCK(&shard->mutex);
+		timed_out += state_shard_expire(state, shard, &to_free, now + 51);
+		PTHREAD_MUTEX_UNLOCK(&shard->mutex);
+	}
+	TEST_CHECK(fr_dlist_num_elements(&to_free) == (STATE_TEST_ENTRIES / 2));
+	state_entry_list_free(&to_free);
+
+	TEST_CHECK(timed_out == (STATE_TEST_ENTRIES / 2));
+	TEST_CHECK(fr_state_entries_timeout(state) == (STATE_TEST_ENTRIES / 2));
+	state_test_check_shards(state, STATE_TEST_ENTRIES / 2);
+
+	for (i = 0; i < STATE_TEST_ENTRIES; i++) {
+		fr_state_entry_t *entry = state_test_find(state, i);
+
+		if (i < (STATE_TEST_ENTRIES / 2)) {
+			TEST_CHECK(entry == NULL);
+			TEST_MSG("State %u should have expired", i);
+		} else {
+			TEST_CHECK(entry != NULL);
+			TEST_MSG("State %u should not have expired", i);
+		}
+	}
+
+	/*
+	 *	Now everything is due.
+	 */
+	for (i = 0; i < state->num_shards; i++) {
+		fr_state_shard_t *shard = &state->shard[i];
+
+		PTHREAD_MUTEX_LOCK(&shard->mutex);
+		(void) state_shard_expire(state, shard, &to_free, now + 101);
+		PTHREAD_MUTEX_UNLOCK(&shard->mutex);
+	}
+	state_entry_list_free(&to_free);
+
+	TEST_CHECK(fr_state_entries_timeout(state) == STATE_TEST_ENTRIES);
+	state_test_check_shards(state, 0);
+
+	for (i = 0; i < STATE_TEST_ENTRIES; i++) TEST_CHECK(state_test_find(state, i) == NULL);
+
+	talloc_free(ctx);
+}
+
+static void *state_test_thread(void *uctx)
+{
+	state_test_thread_t	*t = uctx;
+	uint32_t		i;
+	time_t			cleanup = time(NULL) + 60;
+
+	for (i = 0; i < STATE_TEST_PER_THREAD; i++) {
+		uint32_t		n = t->first + i;
+		fr_state_entry_t	*entry = state_test_entry(n, cleanup);
+		fr_state_entry_t	my_entry;
+		fr_state_entry_t	*found;
+
+		if (state_entry_insert(t->state, t->request, entry, false) < 0) {
+			talloc_free(entry);
+			continue;
+		}
+		t->inserted++;
+
+		/*
+		 *	Look it up again whilst the other threads
+		 *	are inserting into the same shards.
+		 */
+		found = state_test_find(t->state, n);
+		if (found == entry) t->found++;
+
+		/*
+		 *	And one belonging to another thread, which
+		 *	may or may not be there yet.
+		 */
+		n = (n + STATE_TEST_PER_THREAD) % (STATE_TEST_THREADS * STATE_TEST_PER_THREAD);
+		found = state_test_find(t->state, n);
+		if (found) {
+			state_test_key(my_entry.state, sizeof(my_entry.state), n);
+			if (memcmp(found->state, my_entry.state, sizeof(my_entry.state)) != 0) t->misplaced++;
+		}
+	}
+
+	return NULL;
+}
+
+/** Insert and look up from several threads at once
+ *
+ */
+static void test_shard_concurrent(void)
+{
+	TALLOC_CTX		*ctx = talloc_init_const("state_tests");
+	fr_state_tree_t		*state;
+	pthread_t		thread[STATE_TEST_THREADS];
+	state_test_thread_t	t[STATE_TEST_THREADS];
+	uint32_t		i;
+
+	state = fr_state_tree_init(ctx, NULL, true, STATE_TEST_THREADS * STATE_TEST_PER_THREAD, 60, 0);
+	TEST_CHECK(state != NULL);
+
+	for (i = 0; i < STATE_TEST_THREADS; i++) {
+		t[i] = (state_test_thread_t) {
+			.state = state,
+			.request = talloc_zero(ctx, REQUEST),
+			.first = i * STATE_TEST_PER_THREAD
+		};
+		TEST_CHECK(pthread_create(&thread[i], NULL, state_test_thread, &t[i]) == 0);
+	}
+
+	for (i = 0; i < STATE_TEST_THREADS; i++) {
+		TEST_CHECK(pthread_join(thread[i], NULL) == 0);
+
+		TEST_CHECK(t[i].inserted == STATE_TEST_PER_THREAD);
+		TEST_MSG("Thread %u: inserted %u of %u", i, t[i].inserted, STATE_TEST_PER_THREAD);
+		TEST_CHECK(t[i].found == t[i].inserted);
+		TEST_MSG("Thread %u: found %u of %u", i, t[i].found, t[i].inserted);
+		TEST_CHECK(t[i].misplaced == 0);
+	}
+
+	TEST_CHECK(fr_state_entries_created(state) == STATE_TEST_THREADS * STATE_TEST_PER_THREAD);
+	state_test_check_shards(state, STATE_TEST_THREADS * STATE_TEST_PER_THREAD);
+
+	for (i = 0; i < STATE_TEST_THREADS * STATE_TEST_PER_THREAD; i++) {
+		TEST_CHECK(state_test_find(state, i) != NULL);
+		TEST_MSG("State %u not found", i);
+	}
+
+	talloc_free(ctx);
+}
+
+TEST_LIST = {
+	{ "Shard placement",		test_shard_placement },
+	{ "Shard expiry",		test_shard_expiry },
+	{ "Concurrent insert and lookup", test_shard_concurrent },
+	{ NULL }
+};
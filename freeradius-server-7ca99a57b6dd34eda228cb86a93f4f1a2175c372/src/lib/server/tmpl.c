@@ -195,17 +195,17 @@ size_t radius_list_name(pair_list_t *out, char const *name, pair_list_t def)
 
 /** Resolve attribute #pair_list_t value to an attribute list.
  *
- * The value returned is a pointer to the pointer of the HEAD of a #VALUE_PAIR list in the
- * #REQUEST. If the head of the list changes, the pointer will still be valid.
+ * The value returned is a pointer to the #fr_pair_list_t in the #REQUEST.
+ * If the head of the list changes, the pointer will still be valid.
  *
  * @param[in] request containing the target lists.
  * @param[in] list #pair_list_t value to resolve to #VALUE_PAIR list. Will be NULL if list
  *	name couldn't be resolved.
- * @return a pointer to the HEAD of a list in the #REQUEST.
+ * @return a pointer to a list in the #REQUEST.
  *
  * @see tmpl_cursor_init
  */
-VALUE_PAIR **radius_list(REQUEST *request, pair_list_t list)
+fr_pair_list_t *radius_list(REQUEST *request, pair_list_t list)
 {
 	if (!request) return NULL;
 
@@ -2959,7 +2959,8 @@ static void *_tmpl_cursor_next(void **prev, void *curr, void *ctx)
  */
 VALUE_PAIR *tmpl_cursor_init(int *err, fr_cursor_t *cursor, REQUEST *request, tmpl_t const *vpt)
 {
-	VALUE_PAIR	**vps, *vp = NULL;
+	fr_pair_list_t	*vps;
+	VALUE_PAIR	*vp = NULL;
 
 	TMPL_VERIFY(vpt);
 
@@ -2985,7 +2986,7 @@ VALUE_PAIR *tmpl_cursor_init(int *err, fr_cursor_t *cursor, REQUEST *request, tm
 		return NULL;
 	}
 
-	vp = fr_cursor_talloc_iter_init(cursor, vps, _tmpl_cursor_next, vpt, VALUE_PAIR);
+	vp = _fr_pair_list_cursor_init(cursor, vps, _tmpl_cursor_next, vpt);
 	if (!vp) {
 		if (err) {
 			*err = -1;
@@ -3069,6 +3070,28 @@ int tmpl_find_vp(VALUE_PAIR **out, REQUEST *request, tmpl_t const *vpt)
 
 	int err;
 
+	/*
+	 *	Bare attribute references are the bulk of policy
+	 *	lookups.  If the list is indexed, go straight to
+	 *	the first instance instead of walking the list.
+	 */
+	if (tmpl_is_attr(vpt) && (tmpl_num(vpt) == NUM_ANY) && (tmpl_list(vpt) != PAIR_LIST_UNKNOWN)) {
+		REQUEST		*context = request;
+		fr_pair_list_t	*list;
+
+		if ((radius_request(&context, tmpl_request(vpt)) == 0) &&
+		    (list = radius_list(context, tmpl_list(vpt))) && list->index) {
+			vp = fr_pair_list_find_by_da(list, tmpl_da(vpt),
+						     tmpl_da(vpt)->flags.has_tag ? tmpl_tag(vpt) : TAG_ANY);
+			if (out) *out = vp;
+			if (!vp) {
+				fr_strerror_printf("No matching \"%s\" pairs found", tmpl_da(vpt)->name);
+				return -1;
+			}
+			return 0;
+		}
+	}
+
 	vp = tmpl_cursor_init(&err, &cursor, request, vpt);
 	if (out) *out = vp;
 
@@ -3107,7 +3130,7 @@ int tmpl_find_or_add_vp(VALUE_PAIR **out, REQUEST *request, tmpl_t const *vpt)
 	case -1:
 	{
 		TALLOC_CTX	*ctx;
-		VALUE_PAIR	**head;
+		fr_pair_list_t	*head;
 
 		RADIUS_LIST_AND_CTX(ctx, head, request, tmpl_request(vpt), tmpl_list(vpt));
 
@@ -500,7 +500,7 @@ void tmpl_verify(char const *file, int line, tmpl_t const *vpt);
  * Example:
  @code{.c}
    TALLOC_CTX *ctx;
-   VALUE_PAIR **head;
+   fr_pair_list_t *head;
    fr_value_box_t value;
 
    RADIUS_LIST_AND_CTX(ctx, head, request, CURRENT_REQUEST, PAIR_LIST_REQUEST);
@@ -592,7 +592,7 @@ typedef enum {
 #define tmpl_aexpand_type(_ctx, _out, _type, _request, _vpt, _escape, _escape_ctx) \
 			  _tmpl_to_atype(_ctx, (void *)(_out), _request, _vpt, _escape, _escape_ctx, _type)
 
-VALUE_PAIR		**radius_list(REQUEST *request, pair_list_t list);
+fr_pair_list_t		*radius_list(REQUEST *request, pair_list_t list);
 
 RADIUS_PACKET		*radius_packet(REQUEST *request, pair_list_t list_name);
 
@@ -204,7 +204,7 @@ static rlm_rcode_t trigger_process(module_ctx_t const *mctx, REQUEST *request)
 		/*
 		 *	Bootstrap these for simpliciy.
 		 */
-		(void) fr_pair_list_copy(request->packet, &request->packet->vps, ctx->vps);
+		(void) fr_pair_list_append_copy(request->packet, &request->packet->vps, ctx->vps);
 
 		unlang_interpret_push_instruction(request, NULL, RLM_MODULE_REJECT, UNLANG_TOP_FRAME);
 
@@ -395,8 +395,8 @@ int trigger_exec(REQUEST *request, CONF_SECTION const *cs, char const *name, boo
 	ctx->name = talloc_strdup(ctx, value);
 
 	if (request) {
-		if (request->packet->vps) {
-			(void) fr_pair_list_copy(ctx, &ctx->vps, request->packet->vps);
+		if (fr_pair_list_head(&request->packet->vps)) {
+			(void) fr_pair_list_copy(ctx, &ctx->vps, fr_pair_list_head(&request->packet->vps));
 		}
 
 		fake->log = request->log;
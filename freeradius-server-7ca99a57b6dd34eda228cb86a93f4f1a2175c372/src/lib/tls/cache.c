@@ -287,7 +287,7 @@ int fr_tls_cache_write(REQUEST *request, fr_tls_session_t *tls_session)
 	RINDENT();
 	RDEBUG2("&session-state:%pP", vp);
 	REXDENT();
-	fr_pair_add(&request->state, vp);
+	fr_pair_list_append(&request->state, vp);
 
 	/*
 	 *	Call the virtual server to write the session
@@ -306,7 +306,7 @@ int fr_tls_cache_write(REQUEST *request, fr_tls_session_t *tls_session)
 	/*
 	 *	Ensure that the session data can't be used by anyone else.
 	 */
-	fr_pair_delete_by_da(&request->state, attr_tls_session_data);
+	fr_pair_list_delete_by_da(&request->state, attr_tls_session_data);
 
 	return ret;
 }
@@ -361,7 +361,7 @@ static SSL_SESSION *fr_tls_cache_read(SSL *ssl,
 		return NULL;
 	}
 
-	vp = fr_pair_find_by_da(request->state, attr_tls_session_data, TAG_ANY);
+	vp = fr_pair_list_find_by_da(&request->state, attr_tls_session_data, TAG_ANY);
 	if (!vp) {
 		RWDEBUG("No cached session found");
 		return NULL;
@@ -407,7 +407,7 @@ static SSL_SESSION *fr_tls_cache_read(SSL *ssl,
 	/*
 	 *	Ensure that the session data can't be used by anyone else.
 	 */
-	fr_pair_delete_by_da(&request->state, attr_tls_session_data);
+	fr_pair_list_delete_by_da(&request->state, attr_tls_session_data);
 
 	return sess;
 }
@@ -537,7 +537,7 @@ int fr_tls_cache_disable_cb(SSL *ssl,
 	 */
 	if (!session->allow_session_resumption) goto disable;
 
-	vp = fr_pair_find_by_da(request->control, attr_allow_session_resumption, TAG_ANY);
+	vp = fr_pair_list_find_by_da(&request->control, attr_allow_session_resumption, TAG_ANY);
 	if (vp && (vp->vp_uint32 == 0)) {
 		RDEBUG2("&control:Allow-Session-Resumption == no, disabling session resumption");
 	disable:
@@ -1440,7 +1440,7 @@ int fr_tls_session_handshake(REQUEST *request, fr_tls_session_t *session)
 		vp = fr_pair_afrom_num(request->state_ctx, 0, FR_TLS_SESSION_CIPHER_SUITE);
 		if (vp) {
 			fr_pair_value_strdup(vp,  SSL_CIPHER_get_name(cipher));
-			fr_pair_add(&request->state, vp);
+			fr_pair_list_append(&request->state, vp);
 			RINDENT();
 			RDEBUG2("&session-state:%pP", vp);
 			REXDENT();
@@ -1456,7 +1456,7 @@ int fr_tls_session_handshake(REQUEST *request, fr_tls_session_t *session)
 		vp = fr_pair_afrom_num(request->state_ctx, 0, FR_TLS_SESSION_VERSION);
 		if (vp) {
 			fr_pair_value_strdup(vp, version);
-			fr_pair_add(&request->state, vp);
+			fr_pair_list_append(&request->state, vp);
 			RINDENT();
 			RDEBUG2("&session-state:TLS-Session-Version := \"%s\"", version);
 			REXDENT();
@@ -1768,7 +1768,7 @@ fr_tls_session_t *fr_tls_session_init_server(TALLOC_CTX *ctx, fr_tls_conf_t *con
 	/*
 	 *	Add the session certificate to the session.
 	 */
-	vp = fr_pair_find_by_da(request->control, attr_tls_session_cert_file, TAG_ANY);
+	vp = fr_pair_list_find_by_da(&request->control, attr_tls_session_cert_file, TAG_ANY);
 	if (vp) {
 		RDEBUG2("Loading TLS session certificate \"%pV\"", &vp->data);
 
@@ -1840,7 +1840,7 @@ fr_tls_session_t *fr_tls_session_init_server(TALLOC_CTX *ctx, fr_tls_conf_t *con
 	 *	just too much.
 	 */
 	session->mtu = conf->fragment_size;
-	vp = fr_pair_find_by_da(request->packet->vps, attr_framed_mtu, TAG_ANY);
+	vp = fr_pair_list_find_by_da(&request->packet->vps, attr_framed_mtu, TAG_ANY);
 	if (vp && (vp->vp_uint32 > 100) && (vp->vp_uint32 < session->mtu)) {
 		RDEBUG2("Setting fragment_len to %u from &Framed-MTU", vp->vp_uint32);
 		session->mtu = vp->vp_uint32;
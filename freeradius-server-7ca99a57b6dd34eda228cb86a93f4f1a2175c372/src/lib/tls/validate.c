@@ -165,7 +165,7 @@ int fr_tls_validate_cert_cb(int ok, X509_STORE_CTX *x509_ctx)
 			 *	cert_vps have a different talloc parent, so we
 			 *	can't just reference them.
 			 */
-			MEM(fr_pair_list_copy(request->state_ctx, &request->state, cert_vps) >= 0);
+			MEM(fr_pair_list_append_copy(request->state_ctx, &request->state, cert_vps) >= 0);
 			fr_pair_list_free(&cert_vps);
 		}
 	}
@@ -308,7 +308,7 @@ int fr_tls_validate_cert_cb(int ok, X509_STORE_CTX *x509_ctx)
 
 		RDEBUG2("Verifying client certificate with cmd");
 		if (radius_exec_program(request, NULL, 0, NULL, request, conf->verify_client_cert_cmd,
-					request->packet->vps, true, true, fr_time_delta_from_sec(EXEC_TIMEOUT)) != 0) {
+					fr_pair_list_head(&request->packet->vps), true, true, fr_time_delta_from_sec(EXEC_TIMEOUT)) != 0) {
 			REDEBUG("Client certificate CN \"%s\" failed external verification", common_name);
 			my_ok = 0;
 		} else {
@@ -189,15 +189,15 @@ static unlang_action_t unlang_call(REQUEST *request, rlm_rcode_t *presult)
 	 *	Note that we do NOT copy the Session-State list!  That
 	 *	contains state information for the parent.
 	 */
-	if ((fr_pair_list_copy(child->packet,
-			       &child->packet->vps,
-			       request->packet->vps) < 0) ||
-	    (fr_pair_list_copy(child->reply,
-			       &child->reply->vps,
-			       request->reply->vps) < 0) ||
-	    (fr_pair_list_copy(child,
-			       &child->control,
-			       request->control) < 0)) {
+	if ((fr_pair_list_append_copy(child->packet,
+				      &child->packet->vps,
+				      fr_pair_list_head(&request->packet->vps)) < 0) ||
+	    (fr_pair_list_append_copy(child->reply,
+				      &child->reply->vps,
+				      fr_pair_list_head(&request->reply->vps)) < 0) ||
+	    (fr_pair_list_append_copy(child,
+				      &child->control,
+				      fr_pair_list_head(&request->control)) < 0)) {
 		REDEBUG("failed copying lists to child");
 
 		*presult = RLM_MODULE_FAIL;
@@ -169,7 +169,7 @@ static unlang_action_t unlang_subrequest_start(REQUEST *request, rlm_rcode_t *pr
 							     state->session.unique_int);
 
 	RDEBUG2("Creating subrequest (%s)", child->name);
-	log_request_pair_list(L_DBG_LVL_1, request, child->packet->vps, NULL);
+	log_request_pair_list(L_DBG_LVL_1, request, fr_pair_list_head(&child->packet->vps), NULL);
 
 	frame->interpret = unlang_subrequest_process;
 	return unlang_subrequest_process(request, presult);
@@ -224,7 +224,7 @@ static unlang_action_t unlang_subrequest_state_init(REQUEST *request, rlm_rcode_
 	 */
 	MEM(vp = fr_pair_afrom_da(child->packet, g->attr_packet_type));
 	child->packet->code = vp->vp_uint32 = g->type_enum->value->vb_uint32;
-	fr_pair_add(&child->packet->vps, vp);
+	fr_pair_list_append(&child->packet->vps, vp);
 
 	/*
 	 *	Push the first instruction the child's
@@ -277,7 +277,7 @@ int unlang_detached_child_init(REQUEST *request)
 	/*
 	 *	Set Request Lifetime
 	 */
-	vp = fr_pair_find_by_da(request->control, attr_request_lifetime, TAG_ANY);
+	vp = fr_pair_list_find_by_da(&request->control, attr_request_lifetime, TAG_ANY);
 	if (!vp || (vp->vp_uint32 > 0)) {
 		fr_time_delta_t when = 0;
 		const fr_event_timer_t **ev_p;
@@ -334,6 +334,8 @@ void _xlat_async_thread_instantiate_set(xlat_t const *xlat,
 				        xlat_thread_detach_t thread_detach,
 					void *uctx);
 
+void		xlat_pure_set(xlat_t const *xlat);
+
 void		xlat_unregister(char const *name);
 void		xlat_unregister_module(void *instance);
 int		xlat_register_legacy_redundant(CONF_SECTION *cs);
@@ -471,6 +471,24 @@ void _xlat_async_thread_instantiate_set(xlat_t const *xlat,
 	c->thread_uctx = uctx;
 }
 
+/** Mark an async xlat as pure
+ *
+ * A pure function has no side effects, and its output depends only
+ * on its arguments.  Calls with constant arguments are evaluated once
+ * when the xlat is bootstrapped, and results are reused within a
+ * request when the function is called again with the same arguments.
+ *
+ * @param[in] xlat	to mark as pure.
+ */
+void xlat_pure_set(xlat_t const *xlat)
+{
+	xlat_t *c;
+
+	memcpy(&c, &xlat, sizeof(c));
+
+	c->pure = true;
+}
+
 
 /** Unregister an xlat function
  *
@@ -2860,7 +2878,7 @@ static xlat_action_t xlat_func_sub_regex(TALLOC_CTX *ctx, fr_cursor_t *out,
 	/*
 	 *	Process the substitution
 	 */
-	if (regex_compile(NULL, &pattern, regex, regex_len, &flags, false, true) <= 0) {
+	if (regex_compile_cached(&pattern, regex, regex_len, &flags, false) <= 0) {
 		RPEDEBUG("Failed compiling regex");
 		return XLAT_ACTION_FAIL;
 	}
@@ -2870,15 +2888,12 @@ static xlat_action_t xlat_func_sub_regex(TALLOC_CTX *ctx, fr_cursor_t *out,
 			     subject, subject_len, rep, rep_len, NULL) < 0) {
 		RPEDEBUG("Failed performing substitution");
 		talloc_free(vb);
-		talloc_free(pattern);
 		return XLAT_ACTION_FAIL;
 	}
 	fr_value_box_bstrdup_buffer_shallow(NULL, vb, NULL, buff, (*in)->tainted);
 
 	fr_cursor_append(out, vb);
 
-	talloc_free(pattern);
-
 	return XLAT_ACTION_DONE;
 }
 #endif
@@ -3310,6 +3325,8 @@ static xlat_action_t xlat_func_urlunquote(TALLOC_CTX *ctx, fr_cursor_t *out,
  */
 int xlat_init(void)
 {
+	xlat_t const	*xlat;
+
 	if (xlat_root) return 0;
 
 	/*
@@ -3346,54 +3363,61 @@ int xlat_init(void)
 	xlat_register_legacy(NULL, "trigger", trigger_xlat, NULL, NULL, 0, 0);	/* On behalf of trigger.c */
 	XLAT_REGISTER(xlat);
 
+	/*
+	 *	Functions whose output depends only on their
+	 *	arguments.  Calls to these may be folded into
+	 *	literals, or have their results reused.
+	 */
+#define XLAT_REGISTER_PURE(_name, _func) \
+	if ((xlat = xlat_register(NULL, _name, _func, false))) xlat_pure_set(xlat)
 
-	xlat_register(NULL, "base64", xlat_func_base64_encode, false);
-	xlat_register(NULL, "base64decode", xlat_func_base64_decode, false);
-	xlat_register(NULL, "bin", xlat_func_bin, false);
-	xlat_register(NULL, "concat", xlat_func_concat, false);
-	xlat_register(NULL, "hex", xlat_func_hex, false);
-	xlat_register(NULL, "hmacmd5", xlat_func_hmac_md5, false);
-	xlat_register(NULL, "hmacsha1", xlat_func_hmac_sha1, false);
-	xlat_register(NULL, "length", xlat_func_length, false);
-	xlat_register(NULL, "md4", xlat_func_md4, false);
-	xlat_register(NULL, "md5", xlat_func_md5, false);
+	XLAT_REGISTER_PURE("base64", xlat_func_base64_encode);
+	XLAT_REGISTER_PURE("base64decode", xlat_func_base64_decode);
+	XLAT_REGISTER_PURE("bin", xlat_func_bin);
+	XLAT_REGISTER_PURE("concat", xlat_func_concat);
+	XLAT_REGISTER_PURE("hex", xlat_func_hex);
+	XLAT_REGISTER_PURE("hmacmd5", xlat_func_hmac_md5);
+	XLAT_REGISTER_PURE("hmacsha1", xlat_func_hmac_sha1);
+	XLAT_REGISTER_PURE("length", xlat_func_length);
+	XLAT_REGISTER_PURE("md4", xlat_func_md4);
+	XLAT_REGISTER_PURE("md5", xlat_func_md5);
 	xlat_register(NULL, "module", xlat_func_module, false);
-	xlat_register(NULL, "pack", xlat_func_pack, false);
+	XLAT_REGISTER_PURE("pack", xlat_func_pack);
 	xlat_register(NULL, "pairs", xlat_func_pairs, false);
 	xlat_register(NULL, "rand", xlat_func_rand, false);
 	xlat_register(NULL, "randstr", xlat_func_randstr, false);
 #if defined(HAVE_REGEX_PCRE) || defined(HAVE_REGEX_PCRE2)
 	xlat_register(NULL, "regex", xlat_func_regex, false);
 #endif
-	xlat_register(NULL, "sha1", xlat_func_sha1, false);
+	XLAT_REGISTER_PURE("sha1", xlat_func_sha1);
 
 #ifdef HAVE_OPENSSL_EVP_H
-	xlat_register(NULL, "sha2_224", xlat_func_sha2_224, false);
-	xlat_register(NULL, "sha2_256", xlat_func_sha2_256, false);
-	xlat_register(NULL, "sha2_384", xlat_func_sha2_384, false);
-	xlat_register(NULL, "sha2_512", xlat_func_sha2_512, false);
+	XLAT_REGISTER_PURE("sha2_224", xlat_func_sha2_224);
+	XLAT_REGISTER_PURE("sha2_256", xlat_func_sha2_256);
+	XLAT_REGISTER_PURE("sha2_384", xlat_func_sha2_384);
+	XLAT_REGISTER_PURE("sha2_512", xlat_func_sha2_512);
 
 #  if OPENSSL_VERSION_NUMBER >= 0x10100000L
-	xlat_register(NULL, "blake2s_256", xlat_func_blake2s_256, false);
-	xlat_register(NULL, "blake2b_512", xlat_func_blake2b_512, false);
+	XLAT_REGISTER_PURE("blake2s_256", xlat_func_blake2s_256);
+	XLAT_REGISTER_PURE("blake2b_512", xlat_func_blake2b_512);
 #  endif
 
 #  if OPENSSL_VERSION_NUMBER >= 0x10101000L
-	xlat_register(NULL, "sha3_224", xlat_func_sha3_224, false);
-	xlat_register(NULL, "sha3_256", xlat_func_sha3_256, false);
-	xlat_register(NULL, "sha3_384", xlat_func_sha3_384, false);
-	xlat_register(NULL, "sha3_512", xlat_func_sha3_512, false);
+	XLAT_REGISTER_PURE("sha3_224", xlat_func_sha3_224);
+	XLAT_REGISTER_PURE("sha3_256", xlat_func_sha3_256);
+	XLAT_REGISTER_PURE("sha3_384", xlat_func_sha3_384);
+	XLAT_REGISTER_PURE("sha3_512", xlat_func_sha3_512);
 #  endif
 #endif
 
-	xlat_register(NULL, "string", xlat_func_string, false);
-	xlat_register(NULL, "strlen", xlat_func_strlen, false);
-	xlat_register(NULL, "sub", xlat_func_sub, false);
+	XLAT_REGISTER_PURE("string", xlat_func_string);
+	XLAT_REGISTER_PURE("strlen", xlat_func_strlen);
+	XLAT_REGISTER_PURE("sub", xlat_func_sub);
 	xlat_register(NULL, "tag", xlat_func_tag, false);
-	xlat_register(NULL, "tolower", xlat_func_tolower, false);
-	xlat_register(NULL, "toupper", xlat_func_toupper, false);
-	xlat_register(NULL, "urlquote", xlat_func_urlquote, false);
-	xlat_register(NULL, "urlunquote", xlat_func_urlunquote, false);
+	XLAT_REGISTER_PURE("tolower", xlat_func_tolower);
+	XLAT_REGISTER_PURE("toupper", xlat_func_toupper);
+	XLAT_REGISTER_PURE("urlquote", xlat_func_urlquote);
+	XLAT_REGISTER_PURE("urlunquote", xlat_func_urlunquote);
 
 	return 0;
 }
@@ -230,6 +230,171 @@ static inline void xlat_debug_log_result(REQUEST *request, fr_value_box_t const
 	RDEBUG2("  --> %pM", result);
 }
 
+/** Maximum number of results we'll remember for a single request
+ */
+#define XLAT_MEMO_MAX	64
+
+/** Results of pure xlat functions, remembered for the lifetime of a request
+ *
+ * Policies often call the same function on the same attributes many
+ * times, e.g. %{tolower:%{User-Name}}.  As the output of a pure function
+ * depends only on its arguments, and the arguments are the values of the
+ * input attributes, we can reuse the previous result until those values
+ * change.
+ */
+typedef struct {
+	rbtree_t		*tree;		//!< Of #xlat_memo_entry_t, keyed on function and arguments.
+	uint64_t		hits;		//!< Calls answered from the tree.
+	uint64_t		misses;		//!< Calls which had to be evaluated.
+} xlat_memo_t;
+
+typedef struct {
+	xlat_t const		*func;		//!< Function the result is for.
+	fr_value_box_t		*args;		//!< Arguments the function was called with.
+	fr_value_box_t		*result;	//!< What the function produced.
+} xlat_memo_entry_t;
+
+/** Compare two memoized results by function, then by arguments
+ *
+ * Calls to the same function from different places in the
+ * configuration share results.
+ */
+static int xlat_memo_cmp(void const *one, void const *two)
+{
+	xlat_memo_entry_t const	*a = one, *b = two;
+	fr_value_box_t const	*vb_a, *vb_b;
+	int			ret;
+
+	ret = (a->func > b->func) - (a->func < b->func);
+	if (ret != 0) return ret;
+
+	for (vb_a = a->args, vb_b = b->args;
+	     vb_a && vb_b;
+	     vb_a = vb_a->next, vb_b = vb_b->next) {
+		ret = (vb_a->type > vb_b->type) - (vb_a->type < vb_b->type);
+		if (ret != 0) return ret;
+
+		ret = (vb_a->tainted > vb_b->tainted) - (vb_a->tainted < vb_b->tainted);
+		if (ret != 0) return ret;
+
+		ret = fr_value_box_cmp(vb_a, vb_b);
+		if (ret != 0) return ret;
+	}
+
+	return (vb_a != NULL) - (vb_b != NULL);
+}
+
+/** Return the memoization table for a request, if the call can be memoized
+ *
+ * @param[in] request	The current request.
+ * @param[in] node	Function call being evaluated.
+ * @param[in] args	Expanded arguments.
+ * @return
+ *	- The memoization table.
+ *	- NULL if the result of the call can't be memoized.
+ */
+static xlat_memo_t *xlat_memo_get(REQUEST *request, xlat_exp_t const *node, fr_value_box_t const *args)
+{
+	xlat_memo_t		*memo;
+	fr_value_box_t const	*vb;
+
+	if (!node->xlat->pure) return NULL;
+
+	/*
+	 *	Only leaf values can be compared.
+	 */
+	for (vb = args; vb; vb = vb->next) {
+		switch (vb->type) {
+		case FR_TYPE_NON_VALUES:
+			return NULL;
+
+		default:
+			break;
+		}
+	}
+
+	memo = request_data_reference(request, (void *)xlat_memo_get, 0);
+	if (memo) return memo;
+
+	MEM(memo = talloc_zero(request, xlat_memo_t));
+	MEM(memo->tree = rbtree_talloc_alloc(memo, xlat_memo_cmp, xlat_memo_entry_t, NULL, RBTREE_FLAG_NONE));
+	if (request_data_talloc_add(request, (void *)xlat_memo_get, 0, xlat_memo_t, memo, true, false, false) < 0) {
+		talloc_free(memo);
+		return NULL;
+	}
+
+	return memo;
+}
+
+/** Append a previous result of a function call to the output list
+ *
+ * @param[in] ctx	to allocate value boxes in.
+ * @param[out] out	a list of #fr_value_box_t to append to.
+ * @param[in] memo	table to search.
+ * @param[in] node	Function call being evaluated.
+ * @param[in] args	Expanded arguments.
+ * @return
+ *	- true if a previous result was found.
+ *	- false if the function needs to be called.
+ */
+static bool xlat_memo_find(TALLOC_CTX *ctx, fr_cursor_t *out, xlat_memo_t *memo,
+			   xlat_exp_t const *node, fr_value_box_t *args)
+{
+	xlat_memo_entry_t	*found;
+	fr_value_box_t		*result = NULL, *vb;
+
+	found = rbtree_finddata(memo->tree, &(xlat_memo_entry_t){ .func = node->xlat, .args = args });
+	if (!found) {
+		memo->misses++;
+		return false;
+	}
+	memo->hits++;
+
+	if (found->result && (fr_value_box_list_acopy(ctx, &result, found->result) < 0)) return false;
+
+	while ((vb = result)) {
+		result = vb->next;
+		vb->next = NULL;
+		fr_cursor_append(out, vb);
+	}
+
+	return true;
+}
+
+/** Remember the result of a function call
+ *
+ * @param[in] memo	table to insert into.
+ * @param[in] node	Function call that was evaluated.
+ * @param[in] args	Arguments the function was called with, allocated
+ *			in the memo ctx.  Will be consumed or freed.
+ * @param[in] result	First value box the function produced.
+ */
+static void xlat_memo_insert(xlat_memo_t *memo, xlat_exp_t const *node,
+			     fr_value_box_t *args, fr_value_box_t const *result)
+{
+	xlat_memo_entry_t	*entry;
+
+	if (rbtree_num_elements(memo->tree) >= XLAT_MEMO_MAX) {
+	error:
+		talloc_list_free(&args);
+		return;
+	}
+
+	MEM(entry = talloc_zero(memo, xlat_memo_entry_t));
+	entry->func = node->xlat;
+	entry->args = args;
+	if (result && (fr_value_box_list_acopy(memo, &entry->result, result) < 0)) {
+		talloc_free(entry);
+		goto error;
+	}
+
+	if (!rbtree_insert(memo->tree, entry)) {
+		talloc_list_free(&entry->result);
+		talloc_free(entry);
+		goto error;
+	}
+}
+
 /** One letter expansions
  *
  * @param[in] ctx	to allocate boxed value, and buffers in.
@@ -826,17 +991,35 @@ xlat_action_t xlat_frame_eval_repeat(TALLOC_CTX *ctx, fr_cursor_t *out,
 			xlat_action_t		xa;
 			xlat_thread_inst_t	*thread_inst;
 			fr_value_box_t		*result_copy = NULL;
+			fr_value_box_t		*memo_args = NULL;
+			xlat_memo_t		*memo;
 
 			thread_inst = xlat_thread_instance_find(node);
 
 			XLAT_DEBUG("** [%i] %s(func-async) - %%{%s:%pM}", unlang_interpret_stack_depth(request), __FUNCTION__,
 				   node->fmt, result);
 
+			/*
+			 *	Pure functions called with the same
+			 *	arguments produce the same output, so
+			 *	reuse any previous result.
+			 */
+			memo = xlat_memo_get(request, node, *result);
+			if (memo && xlat_memo_find(ctx, out, memo, node, *result)) {
+				xlat_debug_log_expansion(request, *in, *result);
+				RDEBUG2("   -- MEMOIZED (%" PRIu64 " hits, %" PRIu64 " misses)", memo->hits, memo->misses);
+				talloc_list_free(result);		/* Not passed to the function, so free them here */
+				fr_cursor_next(out);
+				xlat_debug_log_result(request, fr_cursor_current(out));
+				break;
+			}
+
 			/*
 			 *	Need to copy the input list in case
 			 *	the async function mucks with it.
 			 */
 			if (RDEBUG_ENABLED2) fr_value_box_list_acopy(NULL, &result_copy, *result);
+			if (memo && (fr_value_box_list_acopy(memo, &memo_args, *result) < 0)) memo = NULL;
 
 			if (*result) (void) talloc_list_get_type_abort(*result, fr_value_box_t);
 			xa = node->xlat->func.async(ctx, out, request, node->inst->data, thread_inst->data, result);
@@ -846,6 +1029,21 @@ xlat_action_t xlat_frame_eval_repeat(TALLOC_CTX *ctx, fr_cursor_t *out,
 				xlat_debug_log_expansion(request, *in, result_copy);
 				talloc_list_free(&result_copy);
 			}
+
+			/*
+			 *	Pure functions can't yield, and there's
+			 *	nothing to remember if they failed.
+			 */
+			if (memo) {
+				if (xa == XLAT_ACTION_DONE) {
+					RDEBUG3("   -- MEMOIZING (%" PRIu64 " hits, %" PRIu64 " misses)",
+						memo->hits, memo->misses);
+					xlat_memo_insert(memo, node, memo_args, fr_cursor_next_peek(out));
+				} else {
+					talloc_list_free(&memo_args);
+				}
+			}
+
 			switch (xa) {
 			case XLAT_ACTION_FAIL:
 				return xa;
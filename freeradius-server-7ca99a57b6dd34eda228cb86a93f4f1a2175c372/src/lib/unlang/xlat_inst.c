@@ -420,6 +420,169 @@ int xlat_instantiate(void)
 	return rbtree_walk(xlat_inst_tree, RBTREE_PRE_ORDER, _xlat_instantiate_walker, NULL);
 }
 
+/** Merge any literals following a literal node into it
+ *
+ * "foo%%bar" is tokenized as three literals, which would otherwise
+ * be three value boxes every time the expansion is evaluated.
+ *
+ * @param[in] node	Literal to merge the following literals into.
+ */
+static void xlat_fold_literals(xlat_exp_t *node)
+{
+	xlat_exp_t	*next;
+	char		*fmt;
+
+	fr_assert(node->type == XLAT_LITERAL);
+
+	while ((next = node->next) && (next->type == XLAT_LITERAL)) {
+		MEM(fmt = talloc_bstrndup(node, node->fmt, talloc_array_length(node->fmt) - 1));
+		MEM(fmt = talloc_bstr_append(node, fmt, next->fmt, talloc_array_length(next->fmt) - 1));
+
+		DEBUG4("Folding literals \"%s\" and \"%s\"", node->fmt, next->fmt);
+
+		node->fmt = fmt;
+		node->len += next->len;
+
+		/*
+		 *	Only unlink the merged node.  The tokenizer
+		 *	parents the rest of the list (and their
+		 *	format strings) off of it, so it's freed
+		 *	along with the rest of the tree.
+		 */
+		node->next = next->next;
+	}
+}
+
+/** Evaluate a call to a pure function whose arguments are all literals
+ *
+ * If the function produces a single string, the node is converted
+ * into a literal, so it doesn't need to be evaluated again.
+ *
+ * @param[in] node	Function call to fold.
+ * @return
+ *	- true if the node was converted to a literal.
+ *	- false if the node must be evaluated at runtime.
+ */
+static bool xlat_fold_func(xlat_exp_t *node)
+{
+	xlat_exp_t const	*arg;
+	REQUEST			*request;
+	fr_value_box_t		*args = NULL, *result = NULL, *vb;
+	fr_cursor_t		cursor;
+	xlat_action_t		xa;
+	bool			folded = false;
+
+	fr_assert(node->type == XLAT_FUNC);
+
+	/*
+	 *	Functions with instance data can't be called
+	 *	until after they've been instantiated.
+	 */
+	if ((node->xlat->type != XLAT_FUNC_NORMAL) || !node->xlat->pure ||
+	    node->xlat->inst_size || node->xlat->thread_inst_size) return false;
+
+	for (arg = node->child; arg; arg = arg->next) if (arg->type != XLAT_LITERAL) return false;
+
+	/*
+	 *	Functions log against the request, so
+	 *	give them one.
+	 */
+	request = request_alloc(NULL);
+
+	fr_cursor_talloc_init(&cursor, &args, fr_value_box_t);
+	for (arg = node->child; arg; arg = arg->next) {
+		MEM(vb = fr_value_box_alloc_null(request));
+		fr_value_box_bstrdup_buffer(vb, vb, NULL, arg->fmt, false);
+		fr_cursor_append(&cursor, vb);
+	}
+
+	fr_cursor_talloc_init(&cursor, &result, fr_value_box_t);
+	xa = node->xlat->func.async(request, &cursor, request, NULL, NULL, &args);
+
+	/*
+	 *	Only fold results which look exactly like a literal
+	 *	would.  Anything else, including failures, is left
+	 *	to be evaluated (and reported) at runtime.
+	 *
+	 *	The legacy xlat code unescapes its arguments, so
+	 *	backslashes can't be represented as literals.
+	 */
+	if ((xa != XLAT_ACTION_DONE) || !result || result->next || (result->type != FR_TYPE_STRING) ||
+	    !result->vb_length || memchr(result->vb_strvalue, '\0', result->vb_length) ||
+	    memchr(result->vb_strvalue, '\\', result->vb_length)) goto finish;
+
+	DEBUG2("Folding %%{%s:...} into literal \"%pV\"", node->xlat->name, result);
+
+	/*
+	 *	The argument nodes are left for the tree's
+	 *	ctx to free, as other nodes may be parented
+	 *	off them.
+	 */
+	node->type = XLAT_LITERAL;
+	MEM(node->fmt = talloc_bstrndup(node, result->vb_strvalue, result->vb_length));
+	node->len = result->vb_length;
+	node->async_safe = true;
+	node->child = NULL;
+	node->xlat = NULL;
+	folded = true;
+
+finish:
+	talloc_free(request);
+
+	return folded;
+}
+
+/** Perform constant folding on an xlat tree
+ *
+ * Calls to pure functions with literal arguments are evaluated once,
+ * here, and adjacent literals are merged, so that the work isn't
+ * repeated every time the expansion is evaluated.
+ *
+ * @param[in] head	of the list of nodes to fold.
+ * @param[in] merge	whether adjacent literals in this list may be merged.
+ *			This isn't the case for function arguments, as
+ *			functions may care about how their arguments are
+ *			split up.
+ * @return the number of nodes which were folded.
+ */
+static int xlat_fold(xlat_exp_t *head, bool merge)
+{
+	xlat_exp_t	*node;
+	int		folded = 0;
+
+	for (node = head; node; node = node->next) {
+		switch (node->type) {
+		case XLAT_FUNC:
+			if (node->child) folded += xlat_fold(node->child, false);
+			if (xlat_fold_func(node)) folded++;
+			break;
+
+		case XLAT_ALTERNATE:
+			folded += xlat_fold(node->child, true);
+			folded += xlat_fold(node->alternate, true);
+			break;
+
+		case XLAT_CHILD:
+			folded += xlat_fold(node->child, true);
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	if (!merge) return folded;
+
+	for (node = head; node; node = node->next) {
+		if ((node->type == XLAT_LITERAL) && node->next && (node->next->type == XLAT_LITERAL)) {
+			xlat_fold_literals(node);
+			folded++;
+		}
+	}
+
+	return folded;
+}
+
 /** Callback for creating "permanent" instance data for a #xlat_exp_t
  *
  * This function records the #xlat_exp_t requiring instantiation but does
@@ -471,6 +634,13 @@ int xlat_bootstrap(xlat_exp_t *root)
 
 	if (!xlat_inst_tree) xlat_instantiate_init();
 
+	/*
+	 *	Fold constant expressions first, so that
+	 *	we don't create instance data for nodes
+	 *	which will never be evaluated.
+	 */
+	(void) xlat_fold(root, true);
+
 	return xlat_eval_walk(root, _xlat_bootstrap_walker, XLAT_FUNC, NULL);
 }
 
@@ -71,6 +71,9 @@ typedef struct xlat_s {
 	void			*thread_uctx;			//!< uctx to pass to instantiation functions.
 
 	bool			async_safe;			//!< If true, is async safe
+	bool			pure;				//!< Output depends only on the arguments, so calls
+								///< with constant arguments may be folded, and
+								///< results may be reused within a request.
 
 	size_t			buf_len;			//!< Length of output buffer to pre-allocate.
 	void			*mod_inst;			//!< Module instance passed to xlat
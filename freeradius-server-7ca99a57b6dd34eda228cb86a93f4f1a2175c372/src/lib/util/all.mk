@@ -1,6 +1,12 @@
 SUBMAKEFILES := \
+	crc32_tests.mk \
 	dbuff_tests.mk \
 	heap_tests.mk \
 	libfreeradius-util.mk \
-	sbuff_tests.mk
+	md5_tests.mk \
+	pair_list_tests.mk \
+	regex_tests.mk \
+	sbuff_tests.mk \
+	swiss_tests.mk \
+	udp_tests.mk
 
@@ -68,6 +68,7 @@ RCSIDH(libradius_h, "$Id$")
 #include <freeradius-devel/util/snprintf.h>
 #include <freeradius-devel/util/socket.h>
 #include <freeradius-devel/util/strerror.h>
+#include <freeradius-devel/util/swiss.h>
 #include <freeradius-devel/util/syserror.h>
 #include <freeradius-devel/util/table.h>
 #include <freeradius-devel/util/table.h>
@@ -0,0 +1,49 @@
+#include <freeradius-devel/util/acutest.h>
+#include <freeradius-devel/util/crc32.h>
+
+#include <string.h>
+
+/** Known answers, from RFC 3720 Appendix B.4 and the usual check value
+ *
+ */
+static void crc32_test_known(void)
+{
+	uint8_t	buff[32];
+
+	TEST_CASE("Check value");
+	TEST_CHECK(fr_crc32c(0, "123456789", 9) == 0xe3069283);
+	TEST_MSG("got 0x%08x", fr_crc32c(0, "123456789", 9));
+
+	TEST_CASE("No data");
+	TEST_CHECK(fr_crc32c(0, "", 0) == 0);
+
+	TEST_CASE("32 bytes of zeros");
+	memset(buff, 0, sizeof(buff));
+	TEST_CHECK(fr_crc32c(0, buff, sizeof(buff)) == 0x8a9136aa);
+	TEST_MSG("got 0x%08x", fr_crc32c(0, buff, sizeof(buff)));
+
+	TEST_CASE("32 bytes of ones");
+	memset(buff, 0xff, sizeof(buff));
+	TEST_CHECK(fr_crc32c(0, buff, sizeof(buff)) == 0x62a8ab43);
+	TEST_MSG("got 0x%08x", fr_crc32c(0, buff, sizeof(buff)));
+}
+
+/** Updating a checksum in pieces gives the same result as one call
+ *
+ */
+static void crc32_test_update(void)
+{
+	char const	*data = "123456789";
+	size_t		i;
+
+	for (i = 0; i <= 9; i++) {
+		TEST_CHECK(fr_crc32c(fr_crc32c(0, data, i), data + i, 9 - i) == 0xe3069283);
+		TEST_MSG("split at %zu", i);
+	}
+}
+
+TEST_LIST = {
+	{ "crc32_test_known",		crc32_test_known	},
+	{ "crc32_test_update",		crc32_test_update	},
+	{ NULL }
+};
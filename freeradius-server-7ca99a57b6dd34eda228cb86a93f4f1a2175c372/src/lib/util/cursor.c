@@ -277,6 +277,7 @@ void CC_HINT(hot) fr_cursor_prepend(fr_cursor_t *cursor, void *v)
 
 		*NEXT_PTR(v) = NULL;				/* Only insert one at a time */
 
+		if (cursor->insert) cursor->insert(cursor->list, NULL, v);
 		return;
 	}
 
@@ -287,6 +288,8 @@ void CC_HINT(hot) fr_cursor_prepend(fr_cursor_t *cursor, void *v)
 	*cursor->head = v;
 	*NEXT_PTR(v) = old;
 
+	if (cursor->insert) cursor->insert(cursor->list, NULL, v);
+
 	if (!cursor->prev) cursor->prev = v;
 }
 
@@ -310,6 +313,7 @@ void CC_HINT(hot) fr_cursor_append(fr_cursor_t *cursor, void *v)
 		*cursor->head = v;
 		*NEXT_PTR(v) = NULL;				/* Only insert one at a time */
 
+		if (cursor->insert) cursor->insert(cursor->list, NULL, v);
 		return;
 	}
 
@@ -330,6 +334,8 @@ void CC_HINT(hot) fr_cursor_append(fr_cursor_t *cursor, void *v)
 	*NEXT_PTR(cursor->tail) = v;
 	*NEXT_PTR(v) = old;
 
+	if (cursor->insert) cursor->insert(cursor->list, cursor->tail, v);
+
 	cursor->tail = v;
 }
 
@@ -355,6 +361,8 @@ void fr_cursor_insert(fr_cursor_t *cursor, void *v)
 	*NEXT_PTR(cursor->current) = v;
 	*NEXT_PTR(v) = old;
 
+	if (cursor->insert) cursor->insert(cursor->list, cursor->current, v);
+
 	if (cursor->tail == cursor->current) cursor->tail = v;	/* Advance the tail */
 }
 
@@ -607,6 +615,8 @@ void * CC_HINT(hot) fr_cursor_remove(fr_cursor_t *cursor)
 	}
 	cursor->prev = NULL;
 
+	if (cursor->remove) cursor->remove(cursor->list, v);
+
 	/*
 	 *	Fixup append pointer.
 	 */
@@ -682,6 +692,9 @@ void * CC_HINT(hot) fr_cursor_replace(fr_cursor_t *cursor, void *r)
 		*NEXT_PTR(r) = *NEXT_PTR(v);
 	}
 
+	if (cursor->remove) cursor->remove(cursor->list, v);
+	if (cursor->insert) cursor->insert(cursor->list, (*cursor->head == r) ? NULL : p, r);
+
 	/*
 	 *	Fixup current pointer.
 	 */
@@ -741,6 +754,30 @@ void fr_cursor_free_list(fr_cursor_t *cursor)
  */
 void * CC_HINT(hot) _fr_cursor_init(fr_cursor_t *cursor, void * const *head, size_t offset,
 				    fr_cursor_iter_t iter, void const *uctx, char const *type)
+{
+	return _fr_cursor_list_init(cursor, head, offset, iter, uctx, type, NULL, NULL, NULL);
+}
+
+/** Setup a cursor over a list which tracks its items outside of the next pointers
+ *
+ * The insert and remove callbacks are called after the cursor has linked or
+ * unlinked an item, so the owner of the list can keep any other structures
+ * (tail pointers, indexes) in sync with the chain.
+ *
+ * @param[in] cursor	Where to initialise the cursor (uses existing structure).
+ * @param[in] head	to start from.
+ * @param[in] offset	offsetof next ptr in the structure we're iterating over.
+ * @param[in] iter	Iterator callback.
+ * @param[in] uctx	to pass to iterator function.
+ * @param[in] type	if iterating over talloced memory.
+ * @param[in] insert	called for every item added to the list.  May be NULL.
+ * @param[in] remove	called for every item removed from the list.  May be NULL.
+ * @param[in] list	passed to the insert and remove callbacks.
+ * @return the attribute pointed to by v.
+ */
+void * CC_HINT(hot) _fr_cursor_list_init(fr_cursor_t *cursor, void * const *head, size_t offset,
+					 fr_cursor_iter_t iter, void const *uctx, char const *type,
+					 fr_cursor_insert_t insert, fr_cursor_remove_t remove, void *list)
 {
 	void **v;
 
@@ -752,6 +789,9 @@ void * CC_HINT(hot) _fr_cursor_init(fr_cursor_t *cursor, void * const *head, siz
 	cursor->iter = iter;
 	cursor->offset = offset;
 	cursor->type = type;
+	cursor->insert = insert;
+	cursor->remove = remove;
+	cursor->list = list;
 	memcpy(&cursor->uctx, &uctx, sizeof(cursor->uctx));
 
 	if (*head) return fr_cursor_next(cursor);	/* Initialise current */
@@ -58,6 +58,25 @@ typedef void *(*fr_cursor_iter_t)(void **prev, void *to_eval, void *uctx);
  */
 typedef bool (*fr_cursor_eval_t)(void *item, void *uctx);
 
+/** Called after the cursor links an item into the list
+ *
+ * Allows lists with additional structure, such as an index, to be
+ * modified with a cursor.
+ *
+ * @param[in] list	passed to #_fr_cursor_list_init.
+ * @param[in] prev	item the new item was inserted after.
+ *			NULL if the new item is now the head of the list.
+ * @param[in] item	which was inserted.
+ */
+typedef void (*fr_cursor_insert_t)(void *list, void *prev, void *item);
+
+/** Called after the cursor unlinks an item from the list
+ *
+ * @param[in] list	passed to #_fr_cursor_list_init.
+ * @param[in] item	which was removed.
+ */
+typedef void (*fr_cursor_remove_t)(void *list, void *item);
+
 typedef struct {
 	void			**head;		//!< First item in the list.
 	void			*tail;		//!< Used for efficient fr_cursor_append.
@@ -68,6 +87,10 @@ typedef struct {
 	fr_cursor_iter_t	iter;		//!< Iterator function.
 	void			*uctx;		//!< to pass to iterator function.
 	char const		*type;		//!< If set, used for explicit runtime type safety checks.
+
+	fr_cursor_insert_t	insert;		//!< Called after an item is linked into the list.
+	fr_cursor_remove_t	remove;		//!< Called after an item is unlinked from the list.
+	void			*list;		//!< to pass to the insert and remove callbacks.
 } fr_cursor_t;
 
 void fr_cursor_copy(fr_cursor_t *out, fr_cursor_t const *in) CC_HINT(nonnull);
@@ -165,6 +188,10 @@ void fr_cursor_free_list(fr_cursor_t *cursor) CC_HINT(nonnull);
 void *_fr_cursor_init(fr_cursor_t *cursor, void * const *head, size_t offset,
 		      fr_cursor_iter_t iter, void const *ctx, char const *type);
 
+void *_fr_cursor_list_init(fr_cursor_t *cursor, void * const *head, size_t offset,
+			   fr_cursor_iter_t iter, void const *uctx, char const *type,
+			   fr_cursor_insert_t insert, fr_cursor_remove_t remove, void *list);
+
 /** talloc_free the current item
  *
  * @param[in] cursor	to free items from.
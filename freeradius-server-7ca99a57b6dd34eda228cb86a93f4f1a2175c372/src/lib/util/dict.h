@@ -127,6 +127,8 @@ struct dict_attr_s {
 		struct {
 			fr_dict_attr_t const	*vendor;	//!< ancestor which has type FR_TYPE_VENDOR
 			fr_dict_attr_t const	**children;	//!< Children of this attribute.
+			fr_dict_attr_t const	**children_by_num;	//!< Dense array of children indexed by
+									///< number.  Built by fr_dict_index_build().
 		};
 		fr_dict_attr_t const	*ref;			//!< reference
 	};
@@ -449,6 +451,8 @@ int			fr_dict_global_ctx_dir_set(char const *dict_dir);
 
 void			fr_dict_global_read_only(void);
 
+int			fr_dict_index_build(fr_dict_t *dict);
+
 char const		*fr_dict_global_dir(void);
 
 fr_dict_t		*fr_dict_unconst(fr_dict_t const *dict);
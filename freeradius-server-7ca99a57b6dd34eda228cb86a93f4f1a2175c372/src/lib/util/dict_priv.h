@@ -29,6 +29,7 @@ extern "C" {
 
 #include <freeradius-devel/util/dict.h>
 #include <freeradius-devel/util/hash.h>
+#include <freeradius-devel/util/swiss.h>
 #include <freeradius-devel/util/dl.h>
 #include <freeradius-devel/protocol/base.h>
 
@@ -75,6 +76,8 @@ struct fr_dict {
 	fr_hash_table_t		*vendors_by_num;	//!< Lookup vendor by PEN.
 
 	fr_hash_table_t		*attributes_by_name;	//!< Allow attribute lookup by unique name.
+	fr_swiss_table_t	*attributes_by_name_index;	//!< Read only copy of attributes_by_name,
+							///< built by fr_dict_index_build().
 
 	fr_hash_table_t		*attributes_combo;	//!< Lookup variants of polymorphic attributes.
 
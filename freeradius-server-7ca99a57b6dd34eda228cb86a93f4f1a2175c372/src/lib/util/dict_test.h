@@ -0,0 +1,69 @@
+#pragma once
+/*
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Lesser General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2.1 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *   Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/** Dictionary setup shared by the unit tests
+ *
+ * Only include this from *_tests.c files.
+ *
+ * @file src/lib/util/dict_test.h
+ *
+ * @copyright 2020 The FreeRADIUS server project
+ */
+RCSIDH(dict_test_h, "$Id$")
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <freeradius-devel/util/conf.h>
+#include <freeradius-devel/util/dict.h>
+#include <freeradius-devel/util/strerror.h>
+
+#include <stdlib.h>
+
+/** Load the internal dictionary, and optionally a protocol dictionary
+ *
+ * The dictionary directory can be set with FR_DICTIONARY_DIR, and
+ * defaults to the one in the source tree.  There's nothing a test can
+ * do without its dictionaries, so this exits on failure.
+ *
+ * @param[in] ctx		to allocate the global dictionary context in.
+ * @param[in] name		of the test, for the error message.
+ * @param[out] dict_internal	Where to write the internal dictionary.
+ * @param[out] dict_proto	Where to write the protocol dictionary.
+ *				May be NULL if proto is NULL.
+ * @param[in] proto		name of the protocol dictionary to load, or NULL.
+ */
+static inline void fr_dict_test_init(TALLOC_CTX *ctx, char const *name,
+				     fr_dict_t **dict_internal, fr_dict_t **dict_proto, char const *proto)
+{
+	char const	*dict_dir;
+
+	dict_dir = getenv("FR_DICTIONARY_DIR");
+	if (!dict_dir) dict_dir = "share/dictionary";
+
+	if (!fr_dict_global_ctx_init(ctx, dict_dir) ||
+	    (fr_dict_internal_afrom_file(dict_internal, FR_DICTIONARY_INTERNAL_DIR) < 0) ||
+	    (proto && (fr_dict_protocol_afrom_file(dict_proto, proto, NULL) < 0))) {
+		fr_perror("%s", name);
+		exit(EXIT_FAILURE);
+	}
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -626,6 +626,11 @@ int dict_attr_child_add(fr_dict_attr_t *parent, fr_dict_attr_t *child)
 		return false;
 	}
 
+	/*
+	 *	Any dense index of the children is now out of date.
+	 */
+	TALLOC_FREE(parent->children_by_num);
+
 	/*
 	 *	We only allocate the pointer array *if* the parent has children.
 	 */
@@ -704,6 +709,15 @@ int dict_attr_child_add(fr_dict_attr_t *parent, fr_dict_attr_t *child)
  */
 int dict_attr_add_by_name(fr_dict_t *dict, fr_dict_attr_t *da)
 {
+	/*
+	 *	The read only index is out of date, and will be
+	 *	rebuilt the next time fr_dict_index_build() is called.
+	 */
+	if (dict->attributes_by_name_index) {
+		talloc_free(dict->attributes_by_name_index);
+		dict->attributes_by_name_index = NULL;
+	}
+
 	/*
 	 *	Insert the attribute, only if it's not a duplicate.
 	 */
@@ -1748,7 +1762,7 @@ ssize_t fr_dict_attr_by_name_substr(fr_dict_attr_err_t *err, fr_dict_attr_t cons
 		return -(FR_DICT_ATTR_MAX_NAME_LEN);
 	}
 
-	da = fr_hash_table_finddata(dict->attributes_by_name, &(fr_dict_attr_t){ .name = buffer });
+	da = dict_attr_by_name(dict, buffer);
 	if (!da) {
 		if (err) *err = FR_DICT_ATTR_NOTFOUND;
 		fr_strerror_printf("Unknown attribute '%s'", buffer);
@@ -1770,6 +1784,10 @@ fr_dict_attr_t *dict_attr_by_name(fr_dict_t const *dict, char const *name)
 
 	if (!name) return NULL;
 
+	if (dict->attributes_by_name_index) {
+		return fr_swiss_table_finddata(dict->attributes_by_name_index, &(fr_dict_attr_t) { .name = name });
+	}
+
 	return fr_hash_table_finddata(dict->attributes_by_name, &(fr_dict_attr_t) { .name = name });
 }
 
@@ -2019,6 +2037,7 @@ fr_dict_attr_t const *fr_dict_attr_child_by_da(fr_dict_attr_t const *parent, fr_
 inline fr_dict_attr_t *dict_attr_child_by_num(fr_dict_attr_t const *parent, unsigned int attr)
 {
 	fr_dict_attr_t const *bin;
+	fr_dict_attr_t *out;
 
 	DA_VERIFY(parent);
 
@@ -2030,6 +2049,19 @@ inline fr_dict_attr_t *dict_attr_child_by_num(fr_dict_attr_t const *parent, unsi
 	 */
 	if (parent->type == FR_TYPE_GROUP) parent = parent->ref;
 
+	/*
+	 *	Frozen dictionaries have a dense array, so
+	 *	we don't need to walk the bin.
+	 */
+	if (parent->children_by_num) {
+		if (attr >= talloc_array_length(parent->children_by_num)) return NULL;
+
+		bin = parent->children_by_num[attr];
+		memcpy(&out, &bin, sizeof(bin));
+
+		return out;
+	}
+
 	/*
 	 *	Child arrays may be trimmed back to save memory.
 	 *	Check that so we don't SEGV.
@@ -2040,8 +2072,6 @@ inline fr_dict_attr_t *dict_attr_child_by_num(fr_dict_attr_t const *parent, unsi
 	for (;;) {
 		if (!bin) return NULL;
 		if (bin->attr == attr) {
-			fr_dict_attr_t *out;
-
 			memcpy(&out, &bin, sizeof(bin));
 
 			return out;
@@ -2752,6 +2782,14 @@ void fr_dict_global_read_only(void)
 	for (dict = fr_hash_table_iter_init(dict_gctx->protocol_by_num, &iter);
 	     dict;
 	     dict = fr_hash_table_iter_next(dict_gctx->protocol_by_num, &iter)) {
+		/*
+		 *	Build the indexes before the memory
+		 *	limit stops us allocating them.
+		 */
+		if (fr_dict_index_build(dict) < 0) {
+			fr_perror("Failed building index for %s dictionary", dict->root->name);
+		}
+
 		talloc_set_memlimit(dict, talloc_get_size(dict));
 		dict->read_only = true;
 	}
@@ -2760,6 +2798,124 @@ void fr_dict_global_read_only(void)
 	dict_gctx->read_only = true;
 }
 
+/** Only index children if the array would be reasonably dense
+ *
+ * RADIUS style attribute spaces (1-255) always qualify.  Sparse
+ * spaces such as Diameter or enterprise numbers continue to use
+ * the bins.
+ */
+#define DICT_INDEX_MAX_ATTR	(UINT16_MAX)
+#define DICT_INDEX_MAX_SPARSE	(16)
+
+/** Build a dense array of the children of an attribute, indexed by number
+ *
+ */
+static int dict_index_children(fr_dict_attr_t *da)
+{
+	fr_dict_attr_t const	*bin;
+	fr_dict_attr_t const	**children;
+	unsigned int		max = 0, num = 0;
+	size_t			i;
+
+	if ((da->type == FR_TYPE_GROUP) || !da->children || da->children_by_num) return 0;
+
+	for (i = 0; i < talloc_array_length(da->children); i++) {
+		for (bin = da->children[i]; bin; bin = bin->next) {
+			if (bin->attr > max) max = bin->attr;
+			num++;
+		}
+	}
+
+	if ((num == 0) || (max > DICT_INDEX_MAX_ATTR) || ((max + 1) > (num * DICT_INDEX_MAX_SPARSE))) return 0;
+
+	children = talloc_zero_array(da, fr_dict_attr_t const *, max + 1);
+	if (!children) {
+		fr_strerror_printf("Out of memory");
+		return -1;
+	}
+
+	/*
+	 *	The first matching entry in the bin wins, which
+	 *	mirrors the priorities in dict_attr_child_add().
+	 */
+	for (i = 0; i < talloc_array_length(da->children); i++) {
+		for (bin = da->children[i]; bin; bin = bin->next) {
+			if (!children[bin->attr]) children[bin->attr] = bin;
+		}
+	}
+
+	da->children_by_num = children;
+
+	return 0;
+}
+
+static int _dict_index_attr(void *ctx, void *data)
+{
+	fr_swiss_table_t	*index = ctx;
+	fr_dict_attr_t		*da = data;
+
+	if (index && !fr_swiss_table_insert(index, da)) {
+		fr_strerror_printf("Failed indexing attribute \"%s\"", da->name);
+		return -1;
+	}
+
+	return dict_index_children(da);
+}
+
+/** Build read only lookup indexes for a dictionary
+ *
+ * Once a dictionary has been loaded, name lookups go through an open
+ * addressing table sized for the final number of attributes, and
+ * child lookups by number go through a dense array (for attributes
+ * whose children are numbered densely enough), instead of walking
+ * hash chains and bins.
+ *
+ * The indexes are discarded if the dictionary is modified later, and
+ * this function can be called again to rebuild them.
+ *
+ * @param[in] dict	to index.
+ * @return
+ *	- 0 on success.
+ *	- -1 on failure.  Lookups continue to work without the indexes.
+ */
+int fr_dict_index_build(fr_dict_t *dict)
+{
+	fr_swiss_table_t *index;
+
+	if (unlikely(dict->read_only)) {
+		fr_strerror_printf("%s dictionary has been marked as read only", fr_dict_root(dict)->name);
+		return -1;
+	}
+
+	if (!dict->attributes_by_name_index) {
+		index = fr_swiss_table_create(dict, dict_attr_name_hash, dict_attr_name_cmp, NULL);
+		if (!index) {
+		oom:
+			fr_strerror_printf("Out of memory");
+			return -1;
+		}
+
+		if (fr_swiss_table_reserve(index, fr_hash_table_num_elements(dict->attributes_by_name)) < 0) {
+			talloc_free(index);
+			goto oom;
+		}
+		dict->attributes_by_name_index = index;
+	} else {
+		index = NULL;
+	}
+
+	if ((dict_index_children(dict->root) < 0) ||
+	    (fr_hash_table_walk(dict->attributes_by_name, _dict_index_attr, index) < 0)) {
+		if (index) {
+			talloc_free(index);
+			dict->attributes_by_name_index = NULL;
+		}
+		return -1;
+	}
+
+	return 0;
+}
+
 /** Coerce to non-const
  *
  */
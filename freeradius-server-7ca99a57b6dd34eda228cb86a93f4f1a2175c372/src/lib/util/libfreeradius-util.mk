@@ -9,6 +9,7 @@ SOURCES		:= \
 		   ascend.c \
 		   base64.c \
 		   cap.c \
+		   crc32.c \
 		   cursor.c \
 		   debug.c \
 		   dict_print.c \
@@ -59,6 +60,7 @@ SOURCES		:= \
 		   strlcat.c \
 		   strlcpy.c \
 		   struct.c \
+		   swiss.c \
 		   syserror.c \
 		   table.c \
 		   talloc.c \
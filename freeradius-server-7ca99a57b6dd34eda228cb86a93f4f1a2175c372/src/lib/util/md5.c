@@ -180,12 +180,7 @@ static void fr_md5_openssl_final(uint8_t out[static MD5_DIGEST_LENGTH], fr_md5_c
 }
 #endif
 
-#  define MD5_BLOCK_LENGTH 64
-typedef struct {
-	uint32_t state[4];			//!< State.
-	uint32_t count[2];			//!< Number of bits, mod 2^64.
-	uint8_t buffer[MD5_BLOCK_LENGTH];	//!< Input buffer.
-} fr_md5_ctx_local_t;
+typedef fr_md5_state_t fr_md5_ctx_local_t;
 
 
 /*
@@ -338,19 +333,106 @@ static void fr_md5_local_transform(uint32_t state[static 4], uint8_t const block
 	state[3] += d;
 }
 
+/** Initialise a stack allocated MD5 state
+ *
+ * @param[out] s	to initialise.
+ */
+void fr_md5_state_init(fr_md5_state_t *s)
+{
+	s->count[0] = 0;
+	s->count[1] = 0;
+	s->state[0] = 0x67452301;
+	s->state[1] = 0xefcdab89;
+	s->state[2] = 0x98badcfe;
+	s->state[3] = 0x10325476;
+}
+
+/** Ingest plaintext into a stack allocated MD5 state
+ *
+ * @param[in] s		To ingest data into.
+ * @param[in] in	Data to ingest.
+ * @param[in] inlen	Length of data to ingest.
+ */
+void fr_md5_state_update(fr_md5_state_t *s, uint8_t const *in, size_t inlen)
+{
+	size_t have, need;
+
+	/*
+	 *	Needed so we can calculate the zero
+	 *	length md5 hash correctly.
+	 *	ubsan doesn't like arithmetic on
+	 *	NULL pointers.
+	 */
+	if (!in) in = (uint8_t[]){ 0x00 };
+
+	/* Check how many bytes we already have and how many more we need. */
+	have = (size_t)((s->count[0] >> 3) & (MD5_BLOCK_LENGTH - 1));
+	need = MD5_BLOCK_LENGTH - have;
+
+	/* Update bitcount */
+/*	s->count += (uint64_t)inlen << 3;*/
+	if ((s->count[0] += ((uint32_t)inlen << 3)) < (uint32_t)inlen) {
+	/* Overflowed s->count[0] */
+		s->count[1]++;
+	}
+	s->count[1] += ((uint32_t)inlen >> 29);
+
+	if (inlen >= need) {
+		if (have != 0) {
+			memcpy(s->buffer + have, in, need);
+			fr_md5_local_transform(s->state, s->buffer);
+			in += need;
+			inlen -= need;
+			have = 0;
+		}
+
+		/* Process data in MD5_BLOCK_LENGTH-byte chunks. */
+		while (inlen >= MD5_BLOCK_LENGTH) {
+			fr_md5_local_transform(s->state, in);
+			in += MD5_BLOCK_LENGTH;
+			inlen -= MD5_BLOCK_LENGTH;
+		}
+	}
+
+	/* Handle any remaining bytes of data. */
+	memcpy(s->buffer + have, in, inlen);
+}
+
+/** Finalise a stack allocated MD5 state, producing the digest
+ *
+ * @param[out] out	The MD5 digest.
+ * @param[in] s		To finalise.
+ */
+void fr_md5_state_final(uint8_t out[static MD5_DIGEST_LENGTH], fr_md5_state_t *s)
+{
+	uint8_t			count[8];
+	size_t			padlen;
+	int			i;
+
+	/* Convert count to 8 bytes in little endian order. */
+	PUT_64BIT_LE(count, s->count);
+
+	/* Pad out to 56 mod 64. */
+	padlen = MD5_BLOCK_LENGTH -
+	    ((s->count[0] >> 3) & (MD5_BLOCK_LENGTH - 1));
+	if (padlen < 1 + 8)
+		padlen += MD5_BLOCK_LENGTH;
+	fr_md5_state_update(s, PADDING, padlen - 8); /* padlen - 8 <= 64 */
+	fr_md5_state_update(s, count, 8);
+
+	if (out != NULL) {
+		for (i = 0; i < 4; i++)
+			PUT_32BIT_LE(out + i * 4, s->state[i]);
+	}
+	memset(s, 0, sizeof(*s));	/* in case it's sensitive */
+}
+
 /** @copydoc fr_md5_ctx_reset
  *
  */
 static void fr_md5_local_ctx_reset(fr_md5_ctx_t *ctx)
 {
-	fr_md5_ctx_local_t	*ctx_local = talloc_get_type_abort(ctx, fr_md5_ctx_local_t);
-
-	ctx_local->count[0] = 0;
-	ctx_local->count[1] = 0;
-	ctx_local->state[0] = 0x67452301;
-	ctx_local->state[1] = 0xefcdab89;
-	ctx_local->state[2] = 0x98badcfe;
-	ctx_local->state[3] = 0x10325476;
+	fr_md5_state_init(talloc_get_type_abort(ctx, fr_md5_ctx_local_t));
 }
 
 /** @copydoc fr_md5_ctx_copy
@@ -450,49 +532,7 @@ static void fr_md5_local_ctx_free(fr_md5_ctx_t **ctx)
  */
 static void fr_md5_local_update(fr_md5_ctx_t *ctx, uint8_t const *in, size_t inlen)
 {
-	fr_md5_ctx_local_t	*ctx_local = talloc_get_type_abort(ctx, fr_md5_ctx_local_t);
-
-	size_t have, need;
-
-	/*
-	 *	Needed so we can calculate the zero
-	 *	length md5 hash correctly.
-	 *	ubsan doesn't like arithmetic on
-	 *	NULL pointers.
-	 */
-	if (!in) in = (uint8_t[]){ 0x00 };
-
-	/* Check how many bytes we already have and how many more we need. */
-	have = (size_t)((ctx_local->count[0] >> 3) & (MD5_BLOCK_LENGTH - 1));
-	need = MD5_BLOCK_LENGTH - have;
-
-	/* Update bitcount */
-/*	ctx_local->count += (uint64_t)inlen << 3;*/
-	if ((ctx_local->count[0] += ((uint32_t)inlen << 3)) < (uint32_t)inlen) {
-	/* Overflowed ctx_local->count[0] */
-		ctx_local->count[1]++;
-	}
-	ctx_local->count[1] += ((uint32_t)inlen >> 29);
-
-	if (inlen >= need) {
-		if (have != 0) {
-			memcpy(ctx_local->buffer + have, in, need);
-			fr_md5_local_transform(ctx_local->state, ctx_local->buffer);
-			in += need;
-			inlen -= need;
-			have = 0;
-		}
-
-		/* Process data in MD5_BLOCK_LENGTH-byte chunks. */
-		while (inlen >= MD5_BLOCK_LENGTH) {
-			fr_md5_local_transform(ctx_local->state, in);
-			in += MD5_BLOCK_LENGTH;
-			inlen -= MD5_BLOCK_LENGTH;
-		}
-	}
-
-	/* Handle any remaining bytes of data. */
-	memcpy(ctx_local->buffer + have, in, inlen);
+	fr_md5_state_update(talloc_get_type_abort(ctx, fr_md5_ctx_local_t), in, inlen);
 }
 
 /** @copydoc fr_md5_final
@@ -500,27 +540,7 @@ static void fr_md5_local_update(fr_md5_ctx_t *ctx, uint8_t const *in, size_t inl
  */
 static void fr_md5_local_final(uint8_t out[static MD5_DIGEST_LENGTH], fr_md5_ctx_t *ctx)
 {
-	fr_md5_ctx_local_t	*ctx_local = talloc_get_type_abort(ctx, fr_md5_ctx_local_t);
-	uint8_t			count[8];
-	size_t			padlen;
-	int			i;
-
-	/* Convert count to 8 bytes in little endian order. */
-	PUT_64BIT_LE(count, ctx_local->count);
-
-	/* Pad out to 56 mod 64. */
-	padlen = MD5_BLOCK_LENGTH -
-	    ((ctx_local->count[0] >> 3) & (MD5_BLOCK_LENGTH - 1));
-	if (padlen < 1 + 8)
-		padlen += MD5_BLOCK_LENGTH;
-	fr_md5_update(ctx_local, PADDING, padlen - 8); /* padlen - 8 <= 64 */
-	fr_md5_update(ctx_local, count, 8);
-
-	if (out != NULL) {
-		for (i = 0; i < 4; i++)
-			PUT_32BIT_LE(out + i * 4, ctx_local->state[i]);
-	}
-	memset(ctx_local, 0, sizeof(*ctx_local));	/* in case it's sensitive */
+	fr_md5_state_final(out, talloc_get_type_abort(ctx, fr_md5_ctx_local_t));
 }
 
 /*
@@ -541,10 +561,9 @@ fr_md5_final_t fr_md5_final = fr_md5_local_final;
  */
 void fr_md5_calc(uint8_t out[static MD5_DIGEST_LENGTH], uint8_t const *in, size_t inlen)
 {
-	fr_md5_ctx_t *ctx;
+	fr_md5_state_t s;
 
-	ctx = fr_md5_ctx_alloc(true);
-	fr_md5_update(ctx, in, inlen);
-	fr_md5_final(out, ctx);
-	fr_md5_ctx_free(&ctx);
+	fr_md5_state_init(&s);
+	fr_md5_state_update(&s, in, inlen);
+	fr_md5_state_final(out, &s);
 }
@@ -25,8 +25,23 @@ extern "C" {
 #  define MD5_DIGEST_LENGTH 16
 #endif
 
+#define MD5_BLOCK_LENGTH 64
+
 typedef void fr_md5_ctx_t;
 
+/** MD5 state for the local implementation
+ *
+ * Unlike #fr_md5_ctx_t this may be declared on the stack, and needs no
+ * allocation or free.  It can be copied with a structure assignment, so
+ * a state which has ingested a shared secret can be kept, and cloned
+ * each time the secret is used as a prefix.
+ */
+typedef struct {
+	uint32_t	state[4];			//!< State.
+	uint32_t	count[2];			//!< Number of bits, mod 2^64.
+	uint8_t		buffer[MD5_BLOCK_LENGTH];	//!< Input buffer.
+} fr_md5_state_t;
+
 /* md5.c */
 
 /** Reset the ctx to allow reuse
@@ -84,6 +99,12 @@ extern		fr_md5_final_t		fr_md5_final;
  */
 void		fr_md5_calc(uint8_t out[static MD5_DIGEST_LENGTH], uint8_t const *in, size_t inlen);
 
+void		fr_md5_state_init(fr_md5_state_t *s);
+
+void		fr_md5_state_update(fr_md5_state_t *s, uint8_t const *in, size_t inlen);
+
+void		fr_md5_state_final(uint8_t out[static MD5_DIGEST_LENGTH], fr_md5_state_t *s);
+
 /* hmac.c */
 void		fr_hmac_md5(uint8_t digest[static MD5_DIGEST_LENGTH], uint8_t const *in, size_t inlen,
 			    uint8_t const *key, size_t key_len);
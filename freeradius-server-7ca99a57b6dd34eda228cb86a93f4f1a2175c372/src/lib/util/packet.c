@@ -48,6 +48,7 @@ RADIUS_PACKET *fr_radius_alloc(TALLOC_CTX *ctx, bool new_vector)
 		return NULL;
 	}
 	rp->id = -1;
+	fr_pair_list_init(&rp->vps, FR_PAIR_LIST_DOUBLE);
 
 	if (new_vector) {
 		fr_rand_buffer(rp->vector, sizeof(rp->vector));
@@ -87,7 +88,6 @@ RADIUS_PACKET *fr_radius_alloc_reply(TALLOC_CTX *ctx, RADIUS_PACKET *packet)
 	reply->code = 0; /* UNKNOWN code */
 	memset(reply->vector, 0,
 	       sizeof(reply->vector));
-	reply->vps = NULL;
 	reply->data = NULL;
 	reply->data_len = 0;
 	reply->proto = packet->proto;
@@ -108,7 +108,7 @@ void fr_radius_packet_free(RADIUS_PACKET **packet_p)
 
 	PACKET_VERIFY(packet);
 
-	fr_pair_list_free(&packet->vps);
+	fr_pair_list_clear(&packet->vps);
 
 	talloc_free(packet);
 	*packet_p = NULL;
@@ -125,7 +125,8 @@ void fr_radius_packet_free(RADIUS_PACKET **packet_p)
  */
 RADIUS_PACKET *fr_radius_copy(TALLOC_CTX *ctx, RADIUS_PACKET const *in)
 {
-	RADIUS_PACKET *packet;
+	RADIUS_PACKET	*packet;
+	VALUE_PAIR	*vps = NULL;
 
 	packet = fr_radius_alloc(ctx, false);
 	if (!packet) return NULL;
@@ -143,10 +144,12 @@ RADIUS_PACKET *fr_radius_copy(TALLOC_CTX *ctx, RADIUS_PACKET const *in)
 	packet->data = NULL;
 	packet->data_len = 0;
 
-	if (fr_pair_list_copy(packet, &packet->vps, in->vps) < 0) {
+	fr_pair_list_init(&packet->vps, FR_PAIR_LIST_DOUBLE);
+	if (fr_pair_list_copy(packet, &vps, fr_pair_list_head(&in->vps)) < 0) {
 		talloc_free(packet);
 		return NULL;
 	}
+	fr_pair_list_append(&packet->vps, vps);
 
 	return packet;
 }
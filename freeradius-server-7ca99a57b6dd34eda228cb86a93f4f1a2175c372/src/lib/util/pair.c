@@ -57,7 +57,69 @@ static int _fr_pair_free(NDEBUG_UNUSED VALUE_PAIR *vp)
 	return 0;
 }
 
+#define PAIR_ARENA_MAX_OWNERS	(4)	//!< How many contexts an arena can allocate pairs for.
+#define PAIR_ARENA_CHUNK_HDR	(128)	//!< Upper bound on talloc's overhead for each pair.
+
+/** An arena pairs are bump allocated from
+ *
+ * Pairs are allocated from a talloc pool, then stolen into the context
+ * they were requested in.  Value buffers are children of their pair, so
+ * talloc allocates them from the same pool.
+ *
+ * The pool is reset by talloc when the last chunk allocated from it
+ * is freed.
+ */
+struct fr_pair_arena_s {
+	TALLOC_CTX		*pool;				//!< Pool pairs are allocated from.
+	uint8_t const		*start;				//!< Start of the pool's memory.
+	uint8_t const		*end;				//!< End of the pool's memory.
+
+	TALLOC_CTX const	*owner[PAIR_ARENA_MAX_OWNERS];	//!< Contexts whose pairs come from the arena.
+	int			num_owners;			//!< How many owners there are.
+
+	fr_pair_arena_stats_t	stats;				//!< Allocation counters.
+};
+
+/** The arena of the request this thread is currently processing
+ *
+ */
+static _Thread_local fr_pair_arena_t *pair_arena;
+
+/** Allocate a pair from an arena
+ *
+ * @param[in] arena	to allocate from.
+ * @param[in] ctx	to steal the pair into.
+ * @return
+ *	- A new #VALUE_PAIR.
+ *	- NULL on error.
+ */
+static inline VALUE_PAIR *pair_arena_alloc(fr_pair_arena_t *arena, TALLOC_CTX *ctx)
+{
+	VALUE_PAIR *vp;
+
+	vp = talloc_zero(arena->pool, VALUE_PAIR);
+	if (!vp) return NULL;
+
+	/*
+	 *	talloc falls back to malloc when the pool is
+	 *	full, and the pool is one block, so this is
+	 *	exact.
+	 */
+	if (((uint8_t *)vp > arena->start) && ((uint8_t *)vp < arena->end)) {
+		arena->stats.pairs++;
+	} else {
+		arena->stats.pairs_malloc++;
+	}
+
+	talloc_steal(ctx, vp);
+
+	return vp;
+}
+
 /** Dynamically allocate a new attribute
+ *
+ * If the current thread has an arena set with #fr_pair_arena_set, and
+ * ctx is one of its owners, the pair is allocated from the arena.
  *
  * @param[in] ctx	Talloc ctx to allocate the pair in.
  * @return
@@ -66,9 +128,22 @@ static int _fr_pair_free(NDEBUG_UNUSED VALUE_PAIR *vp)
  */
 VALUE_PAIR *fr_pair_alloc(TALLOC_CTX *ctx)
 {
-	VALUE_PAIR *vp;
+	VALUE_PAIR	*vp;
+	fr_pair_arena_t	*arena = pair_arena;
+	int		i;
+
+	if (arena && ctx) {
+		for (i = 0; i < arena->num_owners; i++) {
+			if (arena->owner[i] != ctx) continue;
+
+			vp = pair_arena_alloc(arena, ctx);
+			goto done;
+		}
+	}
 
 	vp = talloc_zero(ctx, VALUE_PAIR);
+
+done:
 	if (!vp) {
 		fr_strerror_printf("Out of memory");
 		return NULL;
@@ -83,6 +158,116 @@ VALUE_PAIR *fr_pair_alloc(TALLOC_CTX *ctx)
 	return vp;
 }
 
+/** Don't leave a dangling pointer to a freed arena
+ *
+ */
+static int _pair_arena_free(fr_pair_arena_t *arena)
+{
+	if (pair_arena == arena) pair_arena = NULL;
+
+	return 0;
+}
+
+/** Allocate an arena to bump allocate pairs from
+ *
+ * Allocating pairs from an arena is much cheaper than allocating
+ * each one, and its value buffers, with malloc.  The arena is
+ * only used while it's set as the current arena with
+ * #fr_pair_arena_set, and then only for pairs allocated in one of
+ * its owners.  Anything which doesn't fit is allocated with malloc
+ * as usual.
+ *
+ * @param[in] ctx		to allocate the arena in.
+ * @param[in] num_pairs		to reserve space for.
+ * @param[in] data_size		to reserve for value buffers, and other
+ *				children of the pairs.
+ * @return
+ *	- A new arena.
+ *	- NULL on error.
+ */
+fr_pair_arena_t *fr_pair_arena_alloc(TALLOC_CTX *ctx, size_t num_pairs, size_t data_size)
+{
+	fr_pair_arena_t	*arena;
+	size_t		size;
+
+	arena = talloc_zero(ctx, fr_pair_arena_t);
+	if (!arena) {
+	oom:
+		fr_strerror_printf("Out of memory");
+		return NULL;
+	}
+
+	size = (num_pairs * (sizeof(VALUE_PAIR) + PAIR_ARENA_CHUNK_HDR)) + data_size;
+	arena->pool = talloc_pool(arena, size);
+	if (!arena->pool) {
+		talloc_free(arena);
+		goto oom;
+	}
+	arena->start = arena->pool;
+	arena->end = arena->start + size;
+	talloc_set_destructor(arena, _pair_arena_free);
+
+	return arena;
+}
+
+/** Add a context pairs should be allocated from the arena for
+ *
+ * @param[in] arena	to add the owner to.
+ * @param[in] owner	ctx to allocate pairs for.
+ * @return
+ *	- 0 on success.
+ *	- -1 if the arena has too many owners.
+ */
+int fr_pair_arena_owner_add(fr_pair_arena_t *arena, TALLOC_CTX const *owner)
+{
+	if (arena->num_owners >= PAIR_ARENA_MAX_OWNERS) {
+		fr_strerror_printf("Too many owners for pair arena");
+		return -1;
+	}
+
+	arena->owner[arena->num_owners++] = owner;
+
+	return 0;
+}
+
+/** Remove the owners of an arena and clear its counters
+ *
+ * The pool itself is reset by talloc when the last chunk allocated from it is freed.
+ *
+ * @param[in] arena	to reset.
+ */
+void fr_pair_arena_reset(fr_pair_arena_t *arena)
+{
+	memset(arena->owner, 0, sizeof(arena->owner));
+	arena->num_owners = 0;
+	memset(&arena->stats, 0, sizeof(arena->stats));
+}
+
+/** Set the arena pairs are allocated from by this thread
+ *
+ * @param[in] arena	to allocate pairs from, or NULL to allocate them
+ *			with malloc.
+ * @return the previous arena.
+ */
+fr_pair_arena_t *fr_pair_arena_set(fr_pair_arena_t *arena)
+{
+	fr_pair_arena_t *prev = pair_arena;
+
+	pair_arena = arena;
+
+	return prev;
+}
+
+/** Return the allocation counters for an arena
+ *
+ * @param[in] arena	to return the counters of.
+ * @return the counters.
+ */
+fr_pair_arena_stats_t const *fr_pair_arena_stats(fr_pair_arena_t const *arena)
+{
+	return &arena->stats;
+}
+
 /** Dynamically allocate a new attribute and fill in the da field
  *
  * Allocates a new attribute and a new dictionary attr if no DA is provided.
@@ -467,6 +652,16 @@ fr_pair_list_t *fr_pair_group_get_sublist(VALUE_PAIR *head)
 	return (fr_pair_list_t *) &head->vp_group;
 }
 
+/** Return the group pair which contains a child list
+ *
+ * Group lists are only ever obtained from #fr_pair_group_get_sublist, so
+ * the pair is found by its offset.  New children are allocated in it.
+ */
+static inline CC_HINT(always_inline) VALUE_PAIR *pair_group_parent(fr_pair_list_t *head)
+{
+	return (VALUE_PAIR *)(((uint8_t *) head) - offsetof(VALUE_PAIR, children));
+}
+
 /** Find the pair with the matching DAs in a group
  *
  * @param[in] head VP which MUST be of FR_TYPE_GROUP
@@ -475,7 +670,7 @@ fr_pair_list_t *fr_pair_group_get_sublist(VALUE_PAIR *head)
  */
 VALUE_PAIR *fr_pair_group_find_by_da(fr_pair_list_t *head, fr_dict_attr_t const *da, int8_t tag)
 {
-	return fr_pair_find_by_da((VALUE_PAIR *) head, da, tag);
+	return fr_pair_list_find_by_da(head, da, tag);
 }
 
 
@@ -488,7 +683,24 @@ VALUE_PAIR *fr_pair_group_find_by_da(fr_pair_list_t *head, fr_dict_attr_t const
  */
 VALUE_PAIR *fr_pair_group_find_by_num(fr_pair_list_t *head, unsigned int vendor, unsigned int attr, int8_t tag)
 {
-	return fr_pair_find_by_num((VALUE_PAIR *) head, vendor, attr, tag);
+	VALUE_PAIR *vp;
+
+	if (head->type == FR_PAIR_LIST_SINGLE) return fr_pair_find_by_num(head->slist, vendor, attr, tag);
+
+	for (vp = fr_pair_list_head(head); vp; vp = fr_pair_list_next(head, vp)) {
+		if (!fr_dict_attr_is_top_level(vp->da)) continue;
+
+		if (vendor > 0) {
+			fr_dict_vendor_t const *dv;
+
+			dv = fr_dict_vendor_by_da(vp->da);
+			if (!dv || (dv->pen != vendor)) continue;
+		}
+
+		if ((attr == vp->da->attr) && TAG_EQ(tag, vp->tag)) return vp;
+	}
+
+	return NULL;
 }
 
 /** Add a VP to the end of the FR_TYPE_GROUP.
@@ -500,7 +712,9 @@ VALUE_PAIR *fr_pair_group_find_by_num(fr_pair_list_t *head, unsigned int vendor,
  */
 void fr_pair_group_add(fr_pair_list_t *head, VALUE_PAIR *add)
 {
-	fr_pair_add((VALUE_PAIR **) &head, add);
+	if (!add) return;
+
+	fr_pair_list_append(head, add);
 }
 
 
@@ -516,7 +730,18 @@ void fr_pair_group_add(fr_pair_list_t *head, VALUE_PAIR *add)
  */
 int fr_pair_group_add_by_da(VALUE_PAIR **out, fr_pair_list_t *head, fr_dict_attr_t const *da)
 {
-	return fr_pair_add_by_da(head, out, (VALUE_PAIR **) &head, da);
+	VALUE_PAIR *vp;
+
+	vp = fr_pair_afrom_da(pair_group_parent(head), da);
+	if (unlikely(!vp)) {
+		if (out) *out = NULL;
+		return -1;
+	}
+
+	fr_pair_list_prepend(head, vp);
+	if (out) *out = vp;
+
+	return 0;
 }
 
 /** Return the first fr_pair_list_t matching the #fr_dict_attr_t or alloc a new fr_pair_list_t (and prepend)
@@ -532,7 +757,16 @@ int fr_pair_group_add_by_da(VALUE_PAIR **out, fr_pair_list_t *head, fr_dict_attr
  */
 int fr_pair_group_update_by_da(VALUE_PAIR **out, fr_pair_list_t *head, fr_dict_attr_t const *da)
 {
-	return fr_pair_update_by_da(head, out, (VALUE_PAIR **) &head, da);
+	VALUE_PAIR *vp;
+
+	vp = fr_pair_list_find_by_da(head, da, TAG_ANY);
+	if (vp) {
+		VP_VERIFY(vp);
+		if (out) *out = vp;
+		return 1;
+	}
+
+	return fr_pair_group_add_by_da(out, head, da);
 }
 
 /** Delete matching pairs from the specified list
@@ -545,7 +779,569 @@ int fr_pair_group_update_by_da(VALUE_PAIR **out, fr_pair_list_t *head, fr_dict_a
  */
 int fr_pair_group_delete_by_da(fr_pair_list_t *head, fr_dict_attr_t const *da)
 {
-	return fr_pair_delete_by_da((VALUE_PAIR **) &head, da);
+	return fr_pair_list_delete_by_da(head, da);
+}
+
+/*
+ *	The index is an open addressed hash table keyed on the
+ *	attribute pointer.  Attributes are never removed from it.
+ *	Instead, the slot's pair is set to NULL when the last pair
+ *	for that attribute leaves the list.
+ */
+typedef struct {
+	fr_dict_attr_t const	*da;				//!< Attribute this slot is for.
+	VALUE_PAIR		*vp;				//!< First pair in the list with this attribute.
+} fr_pair_index_slot_t;
+
+struct fr_pair_index_s {
+	uint32_t		size;				//!< Number of slots.  Always a power of 2.
+	uint32_t		used;				//!< Number of slots with an attribute.
+	fr_pair_index_slot_t	*slot;
+};
+
+#define PAIR_INDEX_SIZE_INIT	(32)
+
+static inline CC_HINT(always_inline) uint32_t pair_index_hash(fr_dict_attr_t const *da)
+{
+	return (((uint64_t)(uintptr_t) da) * UINT64_C(0x9e3779b97f4a7c15)) >> 32;
+}
+
+/** Find the slot for an attribute, optionally adding one
+ *
+ * @return
+ *	- The slot for the attribute.
+ *	- NULL if it wasn't found, or we failed growing the table.
+ */
+static fr_pair_index_slot_t *pair_index_slot(fr_pair_index_t *index, fr_dict_attr_t const *da, bool create)
+{
+	uint32_t		mask, i;
+
+	mask = index->size - 1;
+	for (i = pair_index_hash(da) & mask; index->slot[i].da; i = (i + 1) & mask) {
+		if (index->slot[i].da == da) return &index->slot[i];
+	}
+
+	if (!create) return NULL;
+
+	/*
+	 *	Keep the load factor below 1/2, so probe
+	 *	sequences stay short.
+	 */
+	if (((index->used + 1) * 2) > index->size) {
+		fr_pair_index_slot_t	*old = index->slot;
+		uint32_t		old_size = index->size, j;
+
+		index->slot = talloc_zero_array(index, fr_pair_index_slot_t, old_size * 2);
+		if (!index->slot) {
+			index->slot = old;
+			return NULL;
+		}
+		index->size = old_size * 2;
+		mask = index->size - 1;
+
+		for (j = 0; j < old_size; j++) {
+			if (!old[j].da) continue;
+
+			for (i = pair_index_hash(old[j].da) & mask; index->slot[i].da; i = (i + 1) & mask);
+			index->slot[i] = old[j];
+		}
+		talloc_free(old);
+
+		for (i = pair_index_hash(da) & mask; index->slot[i].da; i = (i + 1) & mask);
+	}
+
+	index->used++;
+	index->slot[i].da = da;
+
+	return &index->slot[i];
+}
+
+/** Record a pair which was linked into an indexed list
+ *
+ * If the index can't be updated, it's discarded, and lookups fall back
+ * to walking the list.
+ *
+ * @param[in] list	the pair was linked into.
+ * @param[in] prev	pair vp was linked after.  NULL if vp is the head.
+ * @param[in] vp	which was linked.
+ */
+static void pair_index_add(fr_pair_list_t *list, VALUE_PAIR *prev, VALUE_PAIR *vp)
+{
+	fr_pair_index_slot_t	*slot;
+	VALUE_PAIR		*p;
+
+	slot = pair_index_slot(list->index, vp->da, true);
+	if (!slot) {
+		TALLOC_FREE(list->index);
+		return;
+	}
+
+	if (!slot->vp) {
+		slot->vp = vp;
+		return;
+	}
+
+	/*
+	 *	Walk backwards looking for an earlier pair with
+	 *	the same attribute.  For appends that's usually
+	 *	the first pair we look at, or there's no existing
+	 *	pair at all.
+	 */
+	for (p = prev; p; p = fr_dlist_prev(&list->dlist, p)) if (p->da == vp->da) return;
+
+	slot->vp = vp;
+}
+
+/** Forget a pair which is about to be unlinked from an indexed list
+ *
+ * If this was the first pair for the attribute, the next one with the
+ * same attribute becomes the first.
+ */
+static void pair_index_remove(fr_pair_list_t *list, VALUE_PAIR *vp)
+{
+	fr_pair_index_slot_t	*slot;
+	VALUE_PAIR		*next = vp;
+
+	slot = pair_index_slot(list->index, vp->da, false);
+	if (!slot || (slot->vp != vp)) return;
+
+	while ((next = fr_dlist_next(&list->dlist, next)) && (next->da != vp->da));
+	slot->vp = next;
+}
+
+/** Link a pair into the dlist and index of a doubly linked list
+ *
+ * The next pointers must already have been updated.
+ */
+static inline CC_HINT(always_inline) void pair_dlist_linked(fr_pair_list_t *list, VALUE_PAIR *prev, VALUE_PAIR *vp)
+{
+	fr_dlist_insert_after(&list->dlist, prev, vp);
+	if (list->index) pair_index_add(list, prev, vp);
+}
+
+/** Unlink a pair from the dlist and index of a doubly linked list
+ *
+ * The next pointers must already have been updated.
+ */
+static inline CC_HINT(always_inline) void pair_dlist_unlinked(fr_pair_list_t *list, VALUE_PAIR *vp)
+{
+	if (list->index) pair_index_remove(list, vp);
+	fr_dlist_remove(&list->dlist, vp);
+}
+
+/** Link a pair into a doubly linked list after prev
+ *
+ * @param[in] list	to link vp into.
+ * @param[in] prev	pair to link vp after.  NULL to make vp the head.
+ * @param[in] vp	to link.  Must not be in another list.
+ */
+static void pair_dlist_link(fr_pair_list_t *list, VALUE_PAIR *prev, VALUE_PAIR *vp)
+{
+	if (prev) {
+		vp->next = prev->next;
+		prev->next = vp;
+	} else {
+		vp->next = list->slist;
+		list->slist = vp;
+	}
+
+	pair_dlist_linked(list, prev, vp);
+}
+
+/** Unlink a pair from a doubly linked list
+ *
+ */
+static void pair_dlist_unlink(fr_pair_list_t *list, VALUE_PAIR *vp)
+{
+	VALUE_PAIR *prev;
+
+	prev = fr_dlist_prev(&list->dlist, vp);
+	if (prev) {
+		prev->next = vp->next;
+	} else {
+		list->slist = vp->next;
+	}
+	vp->next = NULL;
+
+	pair_dlist_unlinked(list, vp);
+}
+
+/** Keep the dlist and index in sync with pairs inserted by a cursor
+ *
+ */
+static void _pair_list_cursor_insert(void *list, void *prev, void *vp)
+{
+	pair_dlist_linked(list, prev, vp);
+}
+
+/** Keep the dlist and index in sync with pairs removed by a cursor
+ *
+ */
+static void _pair_list_cursor_remove(void *list, void *vp)
+{
+	pair_dlist_unlinked(list, vp);
+}
+
+/** Initialise a pair list
+ *
+ * @param[out] list	to initialise.
+ * @param[in] type	of list.  #FR_PAIR_LIST_DOUBLE lists append in constant time.
+ */
+void fr_pair_list_init(fr_pair_list_t *list, fr_pair_list_type_t type)
+{
+	memset(list, 0, sizeof(*list));
+
+	list->type = type;
+	if (type == FR_PAIR_LIST_DOUBLE) fr_dlist_talloc_init(&list->dlist, VALUE_PAIR, entry);
+}
+
+/** Add an index of the first pair for each attribute to a list
+ *
+ * Lists which are searched repeatedly, such as the request, reply and
+ * control lists, benefit from an index.  Lists which are only built
+ * and then encoded don't.
+ *
+ * @param[in] ctx	to allocate the index in.
+ * @param[in] list	to index.  Must be a #FR_PAIR_LIST_DOUBLE list.
+ * @return
+ *	- 0 on success.
+ *	- -1 on failure.
+ */
+int fr_pair_list_index_alloc(TALLOC_CTX *ctx, fr_pair_list_t *list)
+{
+	VALUE_PAIR *vp, *prev = NULL;
+
+	if (list->type != FR_PAIR_LIST_DOUBLE) {
+		fr_strerror_printf("Only doubly linked pair lists can be indexed");
+		return -1;
+	}
+
+	if (list->index) return 0;
+
+	list->index = talloc_zero(ctx, fr_pair_index_t);
+	if (!list->index) {
+	oom:
+		fr_strerror_printf("Out of memory");
+		return -1;
+	}
+
+	list->index->size = PAIR_INDEX_SIZE_INIT;
+	list->index->slot = talloc_zero_array(list->index, fr_pair_index_slot_t, list->index->size);
+	if (!list->index->slot) {
+		TALLOC_FREE(list->index);
+		goto oom;
+	}
+
+	for (vp = list->slist; vp; vp = vp->next) {
+		pair_index_add(list, prev, vp);
+		if (!list->index) goto oom;
+		prev = vp;
+	}
+
+	return 0;
+}
+
+/** Return the number of pairs in a list
+ *
+ */
+size_t fr_pair_list_num_elements(fr_pair_list_t const *list)
+{
+	VALUE_PAIR	*vp;
+	size_t		count = 0;
+
+	if (list->type == FR_PAIR_LIST_DOUBLE) return fr_dlist_num_elements(&list->dlist);
+
+	for (vp = list->slist; vp; vp = vp->next) count++;
+
+	return count;
+}
+
+/** Add a pair, or a chain of pairs, to the end of a list
+ *
+ * This is constant time per pair for #FR_PAIR_LIST_DOUBLE lists.
+ *
+ * @param[in] list	to add the pairs to.
+ * @param[in] vp	to add.  May be NULL.  Must not be in another list.
+ */
+void fr_pair_list_append(fr_pair_list_t *list, VALUE_PAIR *vp)
+{
+	VALUE_PAIR *next;
+
+	if (!vp) return;
+
+	if (list->type == FR_PAIR_LIST_SINGLE) {
+		fr_pair_add(&list->slist, vp);
+		return;
+	}
+
+	for (; vp; vp = next) {
+		VP_VERIFY(vp);
+
+		next = vp->next;
+		vp->next = NULL;
+		pair_dlist_link(list, fr_dlist_tail(&list->dlist), vp);
+	}
+}
+
+/** Add a pair to the start of a list
+ *
+ * @param[in] list	to add the pair to.
+ * @param[in] vp	to add.  Must not be in another list.
+ */
+void fr_pair_list_prepend(fr_pair_list_t *list, VALUE_PAIR *vp)
+{
+	VP_VERIFY(vp);
+
+	if (list->type == FR_PAIR_LIST_SINGLE) {
+		vp->next = list->slist;
+		list->slist = vp;
+		return;
+	}
+
+	pair_dlist_link(list, NULL, vp);
+}
+
+/** Remove a pair from a list, without freeing it
+ *
+ * This is constant time for #FR_PAIR_LIST_DOUBLE lists.
+ *
+ * @param[in] list	to remove the pair from.
+ * @param[in] vp	to remove.
+ * @return
+ *	- The pair which was removed.
+ *	- NULL if the pair wasn't in the list.
+ */
+VALUE_PAIR *fr_pair_list_remove(fr_pair_list_t *list, VALUE_PAIR *vp)
+{
+	if (list->type == FR_PAIR_LIST_SINGLE) {
+		VALUE_PAIR **last;
+
+		for (last = &list->slist; *last; last = &(*last)->next) {
+			if (*last != vp) continue;
+
+			*last = vp->next;
+			vp->next = NULL;
+			return vp;
+		}
+
+		return NULL;
+	}
+
+	if (!fr_dlist_entry_in_list(&vp->entry)) return NULL;
+
+	pair_dlist_unlink(list, vp);
+
+	return vp;
+}
+
+/** Remove a pair from a list and free it
+ *
+ * @param[in] list	to remove the pair from.
+ * @param[in] vp	to free.
+ */
+void fr_pair_list_delete(fr_pair_list_t *list, VALUE_PAIR *vp)
+{
+	if (!fr_pair_list_remove(list, vp)) return;
+
+	talloc_free(vp);
+}
+
+/** Remove all pairs from a list, returning them as a singly linked chain
+ *
+ * Allows lists to be passed to the functions which still operate on
+ * `VALUE_PAIR **`.  The result can be added back with #fr_pair_list_append.
+ *
+ * @param[in] list	to empty.  Any index is kept.
+ * @return the pairs which were in the list.
+ */
+VALUE_PAIR *fr_pair_list_detach(fr_pair_list_t *list)
+{
+	VALUE_PAIR	*head = list->slist;
+	uint32_t	i;
+
+	list->slist = NULL;
+	if (list->type == FR_PAIR_LIST_SINGLE) return head;
+
+	while (fr_dlist_head(&list->dlist)) fr_dlist_remove(&list->dlist, fr_dlist_head(&list->dlist));
+
+	if (list->index) for (i = 0; i < list->index->size; i++) list->index->slot[i].vp = NULL;
+
+	return head;
+}
+
+/** Duplicate a chain of pairs, and add the copies to the end of a list
+ *
+ * @param[in] ctx	for new #VALUE_PAIR (s) to be allocated in.
+ * @param[in] to	list to append the copies to.
+ * @param[in] from	whence to copy #VALUE_PAIR (s).
+ * @return
+ *	- >0 the number of attributes copied.
+ *	- 0 if no attributes copied.
+ *	- -1 on error.
+ */
+int fr_pair_list_append_copy(TALLOC_CTX *ctx, fr_pair_list_t *to, VALUE_PAIR *from)
+{
+	VALUE_PAIR	*head = NULL;
+	int		cnt;
+
+	cnt = fr_pair_list_copy(ctx, &head, from);
+	if (cnt < 0) return -1;
+
+	fr_pair_list_append(to, head);
+
+	return cnt;
+}
+
+/** Setup a cursor to iterate over, and modify, a #fr_pair_list_t
+ *
+ * @param[in] cursor	to initialise.
+ * @param[in] list	to iterate over.
+ * @param[in] iter	Iterator callback.  May be NULL.
+ * @param[in] uctx	to pass to iterator function.
+ * @return
+ *	- The first pair returned by the iterator.
+ *	- NULL if the list is empty or no pairs match.
+ */
+VALUE_PAIR *_fr_pair_list_cursor_init(fr_cursor_t *cursor, fr_pair_list_t const *list,
+				      fr_cursor_iter_t iter, void const *uctx)
+{
+	fr_pair_list_t *our_list;
+
+	memcpy(&our_list, &list, sizeof(our_list));	/* const issues */
+
+	if (our_list->type == FR_PAIR_LIST_SINGLE) {
+		return _fr_cursor_init(cursor, (void * const *)&our_list->slist, offsetof(VALUE_PAIR, next),
+				       iter, uctx, "VALUE_PAIR");
+	}
+
+	return _fr_cursor_list_init(cursor, (void * const *)&our_list->slist, offsetof(VALUE_PAIR, next),
+				    iter, uctx, "VALUE_PAIR",
+				    _pair_list_cursor_insert, _pair_list_cursor_remove, our_list);
+}
+
+/** Find the first pair with a matching attribute and tag in a list
+ *
+ * This is constant time for indexed lists, unless a tag is given.
+ *
+ * @param[in] list	to search.
+ * @param[in] da	to search for.
+ * @param[in] tag	to search for.
+ * @return
+ *	- The first matching pair.
+ *	- NULL if no pairs matched.
+ */
+VALUE_PAIR *fr_pair_list_find_by_da(fr_pair_list_t const *list, fr_dict_attr_t const *da, int8_t tag)
+{
+	VALUE_PAIR *vp;
+
+	if (!list->index) return fr_pair_find_by_da(list->slist, da, tag);
+
+	if (!da) return NULL;
+
+	{
+		fr_pair_index_slot_t *slot;
+
+		slot = pair_index_slot(list->index, da, false);
+		if (!slot) return NULL;
+
+		vp = slot->vp;
+	}
+
+	for (; vp; vp = vp->next) {
+		if ((da == vp->da) && TAG_EQ(tag, vp->tag)) return vp;
+	}
+
+	return NULL;
+}
+
+/** Alloc a new pair and prepend it to a list
+ *
+ * @param[in] ctx	to allocate the new #VALUE_PAIR in.
+ * @param[out] out	Pair we allocated.  May be NULL.
+ * @param[in] list	to prepend the pair to.
+ * @param[in] da	of the attribute to alloc.
+ * @return
+ *	- 0 on success.
+ *	- -1 on failure.
+ */
+int fr_pair_list_add_by_da(TALLOC_CTX *ctx, VALUE_PAIR **out, fr_pair_list_t *list, fr_dict_attr_t const *da)
+{
+	VALUE_PAIR *vp;
+
+	vp = fr_pair_afrom_da(ctx, da);
+	if (unlikely(!vp)) {
+		if (out) *out = NULL;
+		return -1;
+	}
+
+	fr_pair_list_prepend(list, vp);
+	if (out) *out = vp;
+
+	return 0;
+}
+
+/** Return the first pair matching the #fr_dict_attr_t or alloc a new one (and prepend)
+ *
+ * @param[in] ctx	to allocate any new #VALUE_PAIR in.
+ * @param[out] out	Pair we allocated or found.  May be NULL.
+ * @param[in] list	to search for attributes in or prepend attributes to.
+ * @param[in] da	of attribute to locate or alloc.
+ * @return
+ *	- 1 if attribute already existed.
+ *	- 0 if we allocated a new attribute.
+ *	- -1 on failure.
+ */
+int fr_pair_list_update_by_da(TALLOC_CTX *ctx, VALUE_PAIR **out, fr_pair_list_t *list, fr_dict_attr_t const *da)
+{
+	VALUE_PAIR *vp;
+
+	vp = fr_pair_list_find_by_da(list, da, TAG_ANY);
+	if (vp) {
+		VP_VERIFY(vp);
+		if (out) *out = vp;
+		return 1;
+	}
+
+	return fr_pair_list_add_by_da(ctx, out, list, da);
+}
+
+/** Delete and free all pairs with a matching attribute
+ *
+ * @param[in] list	to delete pairs from.
+ * @param[in] da	to match.
+ * @return
+ *	- >0 the number of pairs deleted.
+ *	- 0 if no pairs were deleted.
+ */
+int fr_pair_list_delete_by_da(fr_pair_list_t *list, fr_dict_attr_t const *da)
+{
+	VALUE_PAIR	*vp, *next;
+	int		cnt = 0;
+
+	if (list->type == FR_PAIR_LIST_SINGLE) return fr_pair_delete_by_da(&list->slist, da);
+
+	for (vp = fr_pair_list_find_by_da(list, da, TAG_ANY); vp; vp = next) {
+		next = vp->next;
+		if (vp->da != da) continue;
+
+		pair_dlist_unlink(list, vp);
+		talloc_free(vp);
+		cnt++;
+	}
+
+	return cnt;
+}
+
+/** Free all pairs in a list
+ *
+ * The list remains initialised, and any index is kept.
+ */
+void fr_pair_list_clear(fr_pair_list_t *list)
+{
+	VALUE_PAIR *head;
+
+	head = fr_pair_list_detach(list);
+	fr_pair_list_free(&head);
 }
 
 /** Add a VP to the end of the list.
@@ -1475,10 +2271,8 @@ void fr_pair_value_clear(VALUE_PAIR *vp)
 		{
 			VALUE_PAIR	*vpc = NULL;
 
-			while ((vpc = fr_dlist_next(&vp->children.dlist, vpc))) {
-				fr_pair_value_clear(vpc);
-				talloc_free(vpc);
-			}
+			while ((vpc = fr_dlist_next(&vp->children.dlist, vpc))) fr_pair_value_clear(vpc);
+			fr_pair_list_clear(&vp->children);
 		}
 			break;
 		}
@@ -2008,6 +2802,39 @@ int fr_pair_value_memdup_buffer_shallow(VALUE_PAIR *vp, uint8_t const *src, bool
 	return 0;
 }
 
+/** Point an "octets" type value pair at part of a talloced buffer, without copying it
+ *
+ * A reference to the buffer is added from the pair, so the buffer stays
+ * valid for as long as the pair does.  The value is copied into a buffer
+ * owned by the pair if it's modified.
+ *
+ * @param[in] vp 	to assign the value to.
+ * @param[in] owner	talloced buffer containing the value.
+ * @param[in] src 	start of the value within owner.
+ * @param[in] len	of the value.
+ * @param[in] tainted	Whether the value came from a trusted source.
+ * @return
+ *	- 0 on success.
+ *	- -1 on failure.
+ */
+int fr_pair_value_memdup_borrowed(VALUE_PAIR *vp, uint8_t const *owner, uint8_t const *src, size_t len, bool tainted)
+{
+	if (!fr_cond_assert(vp->da->type == FR_TYPE_OCTETS)) return -1;
+	if (!fr_cond_assert((src >= owner) && ((src + len) <= (owner + talloc_array_length(owner))))) return -1;
+
+	if (!talloc_reference(vp, owner)) {
+		fr_strerror_printf("Out of memory");
+		return -1;
+	}
+
+	fr_value_box_clear(&vp->data);
+	fr_value_box_memdup_borrowed(&vp->data, vp->da, src, len, tainted);
+	vp->type = VT_DATA;
+	VP_VERIFY(vp);
+
+	return 0;
+}
+
 
 /** Append bytes from a buffer to an existing "octets" type value pair
  *
@@ -2450,6 +3277,8 @@ void fr_pair_verify(char const *file, int line, VALUE_PAIR const *vp)
 		size_t len;
 		TALLOC_CTX *parent;
 
+		if (vp->data.borrowed) break;
+
 		if (!talloc_get_type(vp->vp_ptr, uint8_t)) {
 			fr_fatal_assert_fail("CONSISTENCY CHECK FAILED %s[%u]: VALUE_PAIR \"%s\" data buffer type should be "
 					     "uint8_t but is %s\n", file, line, vp->da->name, talloc_get_name(vp->vp_ptr));
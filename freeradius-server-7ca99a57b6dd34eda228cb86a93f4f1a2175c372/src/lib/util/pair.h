@@ -72,15 +72,36 @@ typedef enum {
 	FR_PAIR_LIST_DOUBLE,					//!< Doubly linked list.
 } fr_pair_list_type_t;
 
-/** Placeholder structure to represent lists of pairs
+typedef struct fr_pair_index_s fr_pair_index_t;
+
+typedef struct fr_pair_arena_s fr_pair_arena_t;
+
+/** Allocation counters for a #fr_pair_arena_t
  *
- * Should have additional fields added later.
  */
 typedef struct {
-	union {
-		VALUE_PAIR	        *slist;			//!< The head of the list.
-		fr_dlist_head_t		dlist;			//!< Doubly linked list head.
-	};
+	uint64_t		pairs;				//!< Pairs allocated from the arena.
+	uint64_t		pairs_malloc;			//!< Pairs which didn't fit, and needed their own malloc.
+} fr_pair_arena_stats_t;
+
+/** Structure to represent lists of pairs
+ *
+ * Singly linked lists are the legacy representation, and `slist` can be
+ * passed to any function taking a `VALUE_PAIR **`.
+ *
+ * Doubly linked lists must only be modified with the fr_pair_list_*
+ * functions, or with a cursor from #fr_pair_list_cursor_init.  They
+ * append and remove in constant time, and may have an index of the first
+ * pair for each attribute, which makes lookups by #fr_dict_attr_t constant
+ * time too.  The next pointers are kept in sync with the dlist, so `slist`
+ * can still be read as a normal chain of pairs.
+ */
+typedef struct {
+	VALUE_PAIR	        *slist;				//!< The head of the list.
+	fr_dlist_head_t		dlist;				//!< Doubly linked list head.
+								///< Only used for doubly linked lists.
+	fr_pair_index_t		*index;				//!< First pair for each attribute.
+								///< Only used for doubly linked lists.
 	fr_pair_list_type_t type;				//!< What type of list this is.
 } fr_pair_list_t;
 
@@ -95,6 +116,7 @@ struct value_pair_s {
 								//!< number, vendor and type of the attribute.
 
 	VALUE_PAIR		*next;
+	fr_dlist_t		entry;				//!< Entry in a #FR_PAIR_LIST_DOUBLE list.
 
 	/*
 	 *	Legacy stuff that needs to die.
@@ -204,6 +226,16 @@ void		fr_pair_list_verify(char const *file, int line, TALLOC_CTX const *expected
 /* Allocation and management */
 VALUE_PAIR	*fr_pair_alloc(TALLOC_CTX *ctx);
 
+fr_pair_arena_t	*fr_pair_arena_alloc(TALLOC_CTX *ctx, size_t num_pairs, size_t data_size);
+
+int		fr_pair_arena_owner_add(fr_pair_arena_t *arena, TALLOC_CTX const *owner);
+
+void		fr_pair_arena_reset(fr_pair_arena_t *arena);
+
+fr_pair_arena_t	*fr_pair_arena_set(fr_pair_arena_t *arena);
+
+fr_pair_arena_stats_t const *fr_pair_arena_stats(fr_pair_arena_t const *arena);
+
 VALUE_PAIR	*fr_pair_afrom_da(TALLOC_CTX *ctx, fr_dict_attr_t const *da);
 
 
@@ -257,6 +289,52 @@ static inline VALUE_PAIR *fr_cursor_iter_by_ancestor_init(fr_cursor_t *cursor,
 	return fr_cursor_talloc_iter_init(cursor, list, fr_pair_iter_next_by_ancestor, da, VALUE_PAIR);
 }
 
+VALUE_PAIR	*_fr_pair_list_cursor_init(fr_cursor_t *cursor, fr_pair_list_t const *list,
+					   fr_cursor_iter_t iter, void const *uctx) CC_HINT(nonnull(1,2));
+
+/** Initialise a cursor over a #fr_pair_list_t
+ *
+ * Any pairs added or removed with the cursor are also added to, or removed
+ * from, the list's dlist and index.
+ *
+ * @param[in] _cursor	to initialise.
+ * @param[in] _list	to iterate over.
+ * @return
+ *	- NULL if the list is empty.
+ *	- The first pair in the list.
+ */
+#define		fr_pair_list_cursor_init(_cursor, _list) _fr_pair_list_cursor_init(_cursor, _list, NULL, NULL)
+
+/** Initialise a cursor over a #fr_pair_list_t that will return only attributes matching the specified #fr_dict_attr_t
+ *
+ * @param[in] cursor	to initialise.
+ * @param[in] list	to iterate over.
+ * @param[in] da	to search for.
+ * @return
+ *	- The first matching pair.
+ *	- NULL if no pairs match.
+ */
+static inline VALUE_PAIR *fr_pair_list_cursor_by_da_init(fr_cursor_t *cursor,
+							 fr_pair_list_t const *list, fr_dict_attr_t const *da)
+{
+	return _fr_pair_list_cursor_init(cursor, list, fr_pair_iter_next_by_da, da);
+}
+
+/** Initialise a cursor over a #fr_pair_list_t that will return only attributes descended from the specified #fr_dict_attr_t
+ *
+ * @param[in] cursor	to initialise.
+ * @param[in] list	to iterate over.
+ * @param[in] da	who's decentness to search for.
+ * @return
+ *	- The first matching pair.
+ *	- NULL if no pairs match.
+ */
+static inline VALUE_PAIR *fr_pair_list_cursor_by_ancestor_init(fr_cursor_t *cursor,
+							       fr_pair_list_t const *list, fr_dict_attr_t const *da)
+{
+	return _fr_pair_list_cursor_init(cursor, list, fr_pair_iter_next_by_ancestor, da);
+}
+
 VALUE_PAIR	*fr_pair_find_by_da(VALUE_PAIR *head, fr_dict_attr_t const *da, int8_t tag);
 
 VALUE_PAIR	*fr_pair_find_by_num(VALUE_PAIR *head, unsigned int vendor, unsigned int attr, int8_t tag);
@@ -294,6 +372,60 @@ int		fr_pair_group_update_by_da(VALUE_PAIR **out, fr_pair_list_t *head, fr_dict_
 
 int		fr_pair_group_delete_by_da(fr_pair_list_t *head, fr_dict_attr_t const *da);
 
+/* Pair lists */
+void		fr_pair_list_init(fr_pair_list_t *list, fr_pair_list_type_t type) CC_HINT(nonnull);
+
+int		fr_pair_list_index_alloc(TALLOC_CTX *ctx, fr_pair_list_t *list) CC_HINT(nonnull(2));
+
+/** Return the first pair in a list
+ *
+ * @param[in] list	to return the head of.
+ * @return
+ *	- The first pair.
+ *	- NULL if the list is empty.
+ */
+static inline VALUE_PAIR *fr_pair_list_head(fr_pair_list_t const *list)
+{
+	return list->slist;
+}
+
+/** Return the pair after vp in a list
+ *
+ * @param[in] list	vp is in.
+ * @param[in] vp	to return the next pair for.  If NULL, the head of the list
+ *			is returned.
+ */
+static inline VALUE_PAIR *fr_pair_list_next(fr_pair_list_t const *list, VALUE_PAIR const *vp)
+{
+	return vp ? vp->next : list->slist;
+}
+
+size_t		fr_pair_list_num_elements(fr_pair_list_t const *list) CC_HINT(nonnull);
+
+void		fr_pair_list_append(fr_pair_list_t *list, VALUE_PAIR *vp) CC_HINT(nonnull(1));
+
+void		fr_pair_list_prepend(fr_pair_list_t *list, VALUE_PAIR *vp) CC_HINT(nonnull);
+
+VALUE_PAIR	*fr_pair_list_remove(fr_pair_list_t *list, VALUE_PAIR *vp) CC_HINT(nonnull);
+
+void		fr_pair_list_delete(fr_pair_list_t *list, VALUE_PAIR *vp) CC_HINT(nonnull);
+
+VALUE_PAIR	*fr_pair_list_detach(fr_pair_list_t *list) CC_HINT(nonnull);
+
+int		fr_pair_list_append_copy(TALLOC_CTX *ctx, fr_pair_list_t *to, VALUE_PAIR *from) CC_HINT(nonnull(2));
+
+VALUE_PAIR	*fr_pair_list_find_by_da(fr_pair_list_t const *list, fr_dict_attr_t const *da, int8_t tag) CC_HINT(nonnull(1));
+
+int		fr_pair_list_add_by_da(TALLOC_CTX *ctx, VALUE_PAIR **out,
+				       fr_pair_list_t *list, fr_dict_attr_t const *da) CC_HINT(nonnull(3));
+
+int		fr_pair_list_update_by_da(TALLOC_CTX *ctx, VALUE_PAIR **out,
+					  fr_pair_list_t *list, fr_dict_attr_t const *da) CC_HINT(nonnull(3));
+
+int		fr_pair_list_delete_by_da(fr_pair_list_t *list, fr_dict_attr_t const *da) CC_HINT(nonnull);
+
+void		fr_pair_list_clear(fr_pair_list_t *list) CC_HINT(nonnull);
+
 #define	fr_pair_group2_find_by_da fr_pair_find_by_da
 #define	fr_pair_group2_find_by_num fr_pair_find_by_num
 #define fr_pair_group2_add(_head, _vp) fr_pair_add(&(_head), _vp)
@@ -391,6 +523,9 @@ int		fr_pair_value_memdup_shallow(VALUE_PAIR *vp, uint8_t const *src, size_t len
 
 int		fr_pair_value_memdup_buffer_shallow(VALUE_PAIR *vp, uint8_t const *src, bool tainted);
 
+int		fr_pair_value_memdup_borrowed(VALUE_PAIR *vp, uint8_t const *owner,
+					      uint8_t const *src, size_t len, bool tainted);
+
 int		fr_pair_value_mem_append(VALUE_PAIR *vp, uint8_t *src, size_t len, bool tainted);
 
 int		fr_pair_value_mem_append_buffer(VALUE_PAIR *vp, uint8_t *src, bool tainted);
@@ -740,13 +740,20 @@ error:
  *
  * @see radius_pairmove
  */
-void fr_pair_list_move(VALUE_PAIR **to, VALUE_PAIR **from)
+void fr_pair_list_move(fr_pair_list_t *to_list, VALUE_PAIR **from)
 {
 	VALUE_PAIR *i, *found;
 	VALUE_PAIR *head_new, **tail_new;
 	VALUE_PAIR **tail_from;
+	VALUE_PAIR *to_head, **to = &to_head;
 
-	if (!to || !from || !*from) return;
+	if (!to_list || !from || !*from) return;
+
+	/*
+	 *	The edits below overwrite and unlink pairs in place,
+	 *	so work on the bare chain and re-link it afterwards.
+	 */
+	to_head = fr_pair_list_detach(to_list);
 
 	/*
 	 *	We're editing the "to" list while we're adding new
@@ -862,4 +869,5 @@ void fr_pair_list_move(VALUE_PAIR **to, VALUE_PAIR **from)
 	 *	Take the "new" list, and append it to the "to" list.
 	 */
 	fr_pair_add(to, head_new);
+	fr_pair_list_append(to_list, to_head);
 }
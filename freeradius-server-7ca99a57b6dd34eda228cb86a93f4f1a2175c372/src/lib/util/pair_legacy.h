@@ -46,7 +46,7 @@ fr_token_t	fr_pair_list_afrom_str(TALLOC_CTX *ctx, fr_dict_t const *dict,
 int		fr_pair_list_afrom_file(TALLOC_CTX *ctx, fr_dict_t const *dict,
 					VALUE_PAIR **out, FILE *fp, bool *pfiledone);
 
-void		fr_pair_list_move(VALUE_PAIR **to, VALUE_PAIR **from);
+void		fr_pair_list_move(fr_pair_list_t *to, VALUE_PAIR **from);
 
 #ifdef __cplusplus
 }
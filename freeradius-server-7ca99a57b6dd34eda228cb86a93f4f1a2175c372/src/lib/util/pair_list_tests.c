@@ -0,0 +1,373 @@
+#include <freeradius-devel/util/acutest.h>
+#include <freeradius-devel/util/conf.h>
+#include <freeradius-devel/util/dict_test.h>
+#include <freeradius-devel/util/pair.h>
+#include <freeradius-devel/util/time.h>
+
+/*
+ *	Roughly the number of attributes in a large accounting packet.
+ */
+#define PAIR_LIST_NUM_ATTRS	(60)
+
+/*
+ *	Roughly the number of attribute lookups a large policy
+ *	makes per request.
+ */
+#define PAIR_LIST_LOOKUPS	(20)
+
+#define PAIR_LIST_ROUNDS	(20000)
+
+static TALLOC_CTX		*autofree;
+static fr_dict_t		*test_dict;
+static fr_dict_attr_t const	*test_da[PAIR_LIST_NUM_ATTRS];
+static VALUE_PAIR		*test_vp[PAIR_LIST_NUM_ATTRS];
+
+/** Load the internal dictionary, and pick some attributes from it
+ *
+ */
+static void test_init(void)
+{
+	unsigned int	attr;
+	int		i = 0;
+
+	if (autofree) return;
+
+	autofree = talloc_autofree_context();
+	fr_dict_test_init(autofree, "pair_list_tests", &test_dict, NULL, NULL);
+
+	for (attr = 1; (i < PAIR_LIST_NUM_ATTRS) && (attr < 65536); attr++) {
+		fr_dict_attr_t const *da;
+
+		da = fr_dict_attr_child_by_num(fr_dict_root(test_dict), attr);
+		if (!da || (da->type == FR_TYPE_TLV) || (da->type == FR_TYPE_GROUP)) continue;
+
+		test_da[i] = da;
+		test_vp[i] = fr_pair_afrom_da(autofree, da);
+		i++;
+	}
+
+	if (i < PAIR_LIST_NUM_ATTRS) {
+		fprintf(stderr, "pair_list_tests: Not enough attributes in the internal dictionary\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+static void pair_list_test_basic(void)
+{
+	fr_pair_list_t	list;
+	VALUE_PAIR	*a, *b, *c, *vp;
+
+	test_init();
+
+	fr_pair_list_init(&list, FR_PAIR_LIST_DOUBLE);
+	TEST_CHECK(fr_pair_list_index_alloc(autofree, &list) == 0);
+
+	a = fr_pair_afrom_da(NULL, test_da[0]);
+	b = fr_pair_afrom_da(NULL, test_da[1]);
+	c = fr_pair_afrom_da(NULL, test_da[0]);
+
+	fr_pair_list_append(&list, a);
+	fr_pair_list_append(&list, b);
+	fr_pair_list_append(&list, c);
+	TEST_CHECK(fr_pair_list_num_elements(&list) == 3);
+
+	TEST_CASE("Order is preserved");
+	vp = fr_pair_list_head(&list);
+	TEST_CHECK(vp == a);
+	vp = fr_pair_list_next(&list, vp);
+	TEST_CHECK(vp == b);
+	vp = fr_pair_list_next(&list, vp);
+	TEST_CHECK(vp == c);
+	TEST_CHECK(fr_pair_list_next(&list, vp) == NULL);
+
+	TEST_CASE("Lookups return the first matching pair");
+	TEST_CHECK(fr_pair_list_find_by_da(&list, test_da[0], TAG_ANY) == a);
+	TEST_CHECK(fr_pair_list_find_by_da(&list, test_da[1], TAG_ANY) == b);
+	TEST_CHECK(fr_pair_list_find_by_da(&list, test_da[2], TAG_ANY) == NULL);
+
+	TEST_CASE("Removing the first pair updates the index");
+	TEST_CHECK(fr_pair_list_remove(&list, a) == a);
+	TEST_CHECK(fr_pair_list_find_by_da(&list, test_da[0], TAG_ANY) == c);
+	TEST_CHECK(fr_pair_list_remove(&list, a) == NULL);
+
+	TEST_CASE("Prepending updates the index");
+	fr_pair_list_prepend(&list, a);
+	TEST_CHECK(fr_pair_list_head(&list) == a);
+	TEST_CHECK(fr_pair_list_find_by_da(&list, test_da[0], TAG_ANY) == a);
+
+	TEST_CASE("Tags are matched");
+	c->tag = 3;
+	TEST_CHECK(fr_pair_list_find_by_da(&list, test_da[0], 3) == c);
+
+	TEST_CASE("Deleting removes all matching pairs");
+	TEST_CHECK(fr_pair_list_delete_by_da(&list, test_da[0]) == 2);
+	TEST_CHECK(fr_pair_list_find_by_da(&list, test_da[0], TAG_ANY) == NULL);
+	TEST_CHECK(fr_pair_list_num_elements(&list) == 1);
+
+	fr_pair_list_clear(&list);
+	TEST_CHECK(fr_pair_list_num_elements(&list) == 0);
+	TEST_CHECK(fr_pair_list_find_by_da(&list, test_da[1], TAG_ANY) == NULL);
+
+	talloc_free(list.index);
+}
+
+static void pair_list_test_cursor(void)
+{
+	fr_pair_list_t	list;
+	fr_cursor_t	cursor;
+	VALUE_PAIR	*a, *b, *c, *d, *vp;
+
+	test_init();
+
+	fr_pair_list_init(&list, FR_PAIR_LIST_DOUBLE);
+	TEST_CHECK(fr_pair_list_index_alloc(autofree, &list) == 0);
+
+	a = fr_pair_afrom_da(NULL, test_da[0]);
+	b = fr_pair_afrom_da(NULL, test_da[1]);
+	c = fr_pair_afrom_da(NULL, test_da[0]);
+	d = fr_pair_afrom_da(NULL, test_da[2]);
+
+	TEST_CASE("Appending with a cursor updates the list");
+	fr_pair_list_cursor_init(&cursor, &list);
+	fr_cursor_append(&cursor, a);
+	fr_cursor_append(&cursor, b);
+	fr_cursor_append(&cursor, c);
+	TEST_CHECK(fr_pair_list_num_elements(&list) == 3);
+	TEST_CHECK(fr_pair_list_head(&list) == a);
+	TEST_CHECK(fr_pair_list_find_by_da(&list, test_da[0], TAG_ANY) == a);
+
+	TEST_CASE("Removing with a cursor updates the index");
+	vp = fr_pair_list_cursor_init(&cursor, &list);
+	TEST_CHECK(vp == a);
+	TEST_CHECK(fr_cursor_remove(&cursor) == a);
+	TEST_CHECK(fr_pair_list_head(&list) == b);
+	TEST_CHECK(fr_pair_list_find_by_da(&list, test_da[0], TAG_ANY) == c);
+	TEST_CHECK(fr_pair_list_num_elements(&list) == 2);
+
+	TEST_CASE("Replacing with a cursor updates the index");
+	vp = fr_pair_list_cursor_by_da_init(&cursor, &list, test_da[0]);
+	TEST_CHECK(vp == c);
+	TEST_CHECK(fr_cursor_replace(&cursor, d) == c);
+	TEST_CHECK(fr_pair_list_find_by_da(&list, test_da[0], TAG_ANY) == NULL);
+	TEST_CHECK(fr_pair_list_find_by_da(&list, test_da[2], TAG_ANY) == d);
+	TEST_CHECK(fr_pair_list_next(&list, b) == d);
+
+	TEST_CASE("Detaching returns the chain, and it can be added back");
+	vp = fr_pair_list_detach(&list);
+	TEST_CHECK(vp == b);
+	TEST_CHECK(fr_pair_list_num_elements(&list) == 0);
+	TEST_CHECK(fr_pair_list_find_by_da(&list, test_da[1], TAG_ANY) == NULL);
+	fr_pair_list_append(&list, vp);
+	TEST_CHECK(fr_pair_list_num_elements(&list) == 2);
+	TEST_CHECK(fr_pair_list_find_by_da(&list, test_da[2], TAG_ANY) == d);
+
+	talloc_free(a);
+	talloc_free(c);
+	fr_pair_list_clear(&list);
+	talloc_free(list.index);
+}
+
+static void pair_list_test_single(void)
+{
+	fr_pair_list_t	list;
+	VALUE_PAIR	*a, *b;
+
+	test_init();
+
+	fr_pair_list_init(&list, FR_PAIR_LIST_SINGLE);
+	TEST_CHECK(fr_pair_list_index_alloc(autofree, &list) < 0);
+
+	a = fr_pair_afrom_da(NULL, test_da[0]);
+	b = fr_pair_afrom_da(NULL, test_da[1]);
+
+	fr_pair_list_append(&list, a);
+	fr_pair_list_prepend(&list, b);
+	TEST_CHECK(list.slist == b);
+	TEST_CHECK(fr_pair_list_num_elements(&list) == 2);
+	TEST_CHECK(fr_pair_list_find_by_da(&list, test_da[0], TAG_ANY) == a);
+	TEST_CHECK(fr_pair_list_remove(&list, b) == b);
+	TEST_CHECK(list.slist == a);
+
+	talloc_free(b);
+	fr_pair_list_clear(&list);
+	TEST_CHECK(list.slist == NULL);
+}
+
+static void pair_list_test_arena(void)
+{
+	fr_pair_arena_t			*arena;
+	fr_pair_arena_stats_t const	*stats;
+	TALLOC_CTX			*owner, *other;
+	VALUE_PAIR			*vp;
+	int				i;
+
+	test_init();
+
+	owner = talloc_new(autofree);
+	other = talloc_new(autofree);
+
+	arena = fr_pair_arena_alloc(autofree, 4, 0);
+	TEST_CHECK(arena != NULL);
+	TEST_CHECK(fr_pair_arena_owner_add(arena, owner) == 0);
+	stats = fr_pair_arena_stats(arena);
+
+	TEST_CASE("Pairs are only allocated from the current arena");
+	vp = fr_pair_afrom_da(owner, test_da[0]);
+	TEST_CHECK(vp != NULL);
+	TEST_CHECK((stats->pairs == 0) && (stats->pairs_malloc == 0));
+
+	TEST_CASE("Pairs in an owner are allocated from the arena");
+	TEST_CHECK(fr_pair_arena_set(arena) == NULL);
+	vp = fr_pair_afrom_da(owner, test_da[0]);
+	TEST_CHECK(vp != NULL);
+	TEST_CHECK(talloc_parent(vp) == owner);
+	TEST_CHECK(stats->pairs == 1);
+
+	TEST_CASE("Pairs in other contexts are not");
+	vp = fr_pair_afrom_da(other, test_da[0]);
+	TEST_CHECK(vp != NULL);
+	TEST_CHECK((stats->pairs == 1) && (stats->pairs_malloc == 0));
+
+	TEST_CASE("Pairs which don't fit are counted");
+	for (i = 0; i < 16; i++) TEST_CHECK(fr_pair_afrom_da(owner, test_da[0]) != NULL);
+	TEST_CHECK(stats->pairs_malloc > 0);
+	TEST_CHECK((stats->pairs + stats->pairs_malloc) == 17);
+
+	TEST_CASE("Freeing the arena clears the current arena");
+	talloc_free(arena);
+	TEST_CHECK(fr_pair_arena_set(NULL) == NULL);
+
+	talloc_free(owner);
+	talloc_free(other);
+}
+
+static void pair_list_bench(void)
+{
+	fr_pair_list_t	list, indexed;
+	VALUE_PAIR	*head;
+	fr_cursor_t	cursor;
+	fr_time_t	start, end;
+	int		i, j, found;
+
+	test_init();
+	fr_time_start();
+
+	/*
+	 *	Building lists, as a decoder does.
+	 */
+	TEST_CASE("Decode");
+	start = fr_time();
+	for (i = 0; i < PAIR_LIST_ROUNDS; i++) {
+		head = NULL;
+		for (j = 0; j < PAIR_LIST_NUM_ATTRS; j++) {
+			test_vp[j]->next = NULL;
+			fr_pair_add(&head, test_vp[j]);
+		}
+	}
+	end = fr_time();
+	printf("\n%-10s %-16s %8.1fns/attr\n", "decode", "fr_pair_add",
+	       (double)(end - start) / (PAIR_LIST_ROUNDS * PAIR_LIST_NUM_ATTRS));
+
+	start = fr_time();
+	for (i = 0; i < PAIR_LIST_ROUNDS; i++) {
+		head = NULL;
+		fr_cursor_init(&cursor, &head);
+		for (j = 0; j < PAIR_LIST_NUM_ATTRS; j++) {
+			test_vp[j]->next = NULL;
+			fr_cursor_append(&cursor, test_vp[j]);
+		}
+	}
+	end = fr_time();
+	printf("%-10s %-16s %8.1fns/attr\n", "decode", "fr_cursor_append",
+	       (double)(end - start) / (PAIR_LIST_ROUNDS * PAIR_LIST_NUM_ATTRS));
+	for (j = 0; j < PAIR_LIST_NUM_ATTRS; j++) test_vp[j]->next = NULL;
+
+	start = fr_time();
+	for (i = 0; i < PAIR_LIST_ROUNDS; i++) {
+		fr_pair_list_init(&list, FR_PAIR_LIST_DOUBLE);
+		for (j = 0; j < PAIR_LIST_NUM_ATTRS; j++) fr_pair_list_append(&list, test_vp[j]);
+	}
+	end = fr_time();
+	printf("%-10s %-16s %8.1fns/attr\n", "decode", "fr_pair_list",
+	       (double)(end - start) / (PAIR_LIST_ROUNDS * PAIR_LIST_NUM_ATTRS));
+	TEST_CHECK(fr_pair_list_num_elements(&list) == PAIR_LIST_NUM_ATTRS);
+	(void) fr_pair_list_detach(&list);
+
+	/*
+	 *	Decoders append to the packet list, which the
+	 *	workers index.
+	 */
+	fr_pair_list_init(&indexed, FR_PAIR_LIST_DOUBLE);
+	TEST_CHECK(fr_pair_list_index_alloc(autofree, &indexed) == 0);
+
+	start = fr_time();
+	for (i = 0; i < PAIR_LIST_ROUNDS; i++) {
+		(void) fr_pair_list_detach(&indexed);
+		for (j = 0; j < PAIR_LIST_NUM_ATTRS; j++) fr_pair_list_append(&indexed, test_vp[j]);
+	}
+	end = fr_time();
+	printf("%-10s %-16s %8.1fns/attr\n", "decode", "indexed",
+	       (double)(end - start) / (PAIR_LIST_ROUNDS * PAIR_LIST_NUM_ATTRS));
+	TEST_CHECK(fr_pair_list_num_elements(&indexed) == PAIR_LIST_NUM_ATTRS);
+	(void) fr_pair_list_detach(&indexed);
+
+	/*
+	 *	Looking up attributes, as a policy does.  Lookups are
+	 *	spread across the list.
+	 */
+	TEST_CASE("Policy lookup");
+	head = NULL;
+	for (j = 0; j < PAIR_LIST_NUM_ATTRS; j++) test_vp[j]->next = NULL;
+	for (j = 0; j < PAIR_LIST_NUM_ATTRS; j++) fr_pair_add(&head, test_vp[j]);
+
+	start = fr_time();
+	for (i = 0, found = 0; i < PAIR_LIST_ROUNDS; i++) {
+		for (j = 0; j < PAIR_LIST_LOOKUPS; j++) {
+			if (fr_pair_find_by_da(head, test_da[(j * 7) % PAIR_LIST_NUM_ATTRS], TAG_ANY)) found++;
+		}
+	}
+	end = fr_time();
+	TEST_CHECK(found == (PAIR_LIST_ROUNDS * PAIR_LIST_LOOKUPS));
+	printf("\n%-10s %-16s %8.1fns/lookup\n", "lookup", "fr_pair_find",
+	       (double)(end - start) / (PAIR_LIST_ROUNDS * PAIR_LIST_LOOKUPS));
+
+	/*
+	 *	The pairs can only be in one doubly linked list at a time.
+	 */
+	fr_pair_list_init(&list, FR_PAIR_LIST_DOUBLE);
+	for (j = 0; j < PAIR_LIST_NUM_ATTRS; j++) fr_pair_list_append(&list, test_vp[j]);
+
+	start = fr_time();
+	for (i = 0, found = 0; i < PAIR_LIST_ROUNDS; i++) {
+		for (j = 0; j < PAIR_LIST_LOOKUPS; j++) {
+			if (fr_pair_list_find_by_da(&list, test_da[(j * 7) % PAIR_LIST_NUM_ATTRS], TAG_ANY)) found++;
+		}
+	}
+	end = fr_time();
+	TEST_CHECK(found == (PAIR_LIST_ROUNDS * PAIR_LIST_LOOKUPS));
+	printf("%-10s %-16s %8.1fns/lookup\n", "lookup", "fr_pair_list",
+	       (double)(end - start) / (PAIR_LIST_ROUNDS * PAIR_LIST_LOOKUPS));
+
+	(void) fr_pair_list_detach(&list);
+	for (j = 0; j < PAIR_LIST_NUM_ATTRS; j++) fr_pair_list_append(&indexed, test_vp[j]);
+
+	start = fr_time();
+	for (i = 0, found = 0; i < PAIR_LIST_ROUNDS; i++) {
+		for (j = 0; j < PAIR_LIST_LOOKUPS; j++) {
+			if (fr_pair_list_find_by_da(&indexed, test_da[(j * 7) % PAIR_LIST_NUM_ATTRS], TAG_ANY)) found++;
+		}
+	}
+	end = fr_time();
+	TEST_CHECK(found == (PAIR_LIST_ROUNDS * PAIR_LIST_LOOKUPS));
+	printf("%-10s %-16s %8.1fns/lookup\n", "lookup", "indexed",
+	       (double)(end - start) / (PAIR_LIST_ROUNDS * PAIR_LIST_LOOKUPS));
+}
+
+TEST_LIST = {
+	{ "pair_list_test_basic",	pair_list_test_basic	},
+	{ "pair_list_test_cursor",	pair_list_test_cursor	},
+	{ "pair_list_test_single",	pair_list_test_single	},
+	{ "pair_list_test_arena",	pair_list_test_arena	},
+	{ "pair_list_bench",		pair_list_bench		},
+	{ NULL }
+};
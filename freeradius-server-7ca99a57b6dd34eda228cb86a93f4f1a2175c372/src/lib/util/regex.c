@@ -41,6 +41,21 @@ RCSID("$Id$")
 #endif
 #endif
 
+#if defined(HAVE_REGEX_PCRE) || defined(HAVE_REGEX_PCRE2)
+#include <freeradius-devel/util/dlist.h>
+#include <freeradius-devel/util/rbtree.h>
+
+#ifndef FR_REGEX_CACHE_SIZE
+#  define FR_REGEX_CACHE_SIZE	(256)
+#endif
+#endif
+
+#ifdef HAVE_REGEX_PCRE2
+#ifndef FR_PCRE2_MATCH_DATA_POOL
+#  define FR_PCRE2_MATCH_DATA_POOL	(32)
+#endif
+#endif
+
 /*
  *######################################
  *#      FUNCTIONS FOR LIBPCRE2        #
@@ -68,6 +83,9 @@ typedef struct {
 	pcre2_jit_stack		*jit_stack;	//!< Jit stack for executing jit'd patterns.
 	bool			do_jit;		//!< Whether we have runtime JIT support.
 #endif
+	pcre2_match_data	*match_data[FR_PCRE2_MATCH_DATA_POOL];	//!< Match data returned by
+									///< freed #fr_regmatch_t.
+	unsigned int		match_data_used;	//!< How many entries in the pool are in use.
 } fr_pcre2_tls_t;
 
 /** Thread local storage for pcre2
@@ -101,6 +119,8 @@ static void _pcre2_talloc_free(void *to_free, UNUSED void *uctx)
  */
 static int _pcre2_tls_free(fr_pcre2_tls_t *tls)
 {
+	while (tls->match_data_used > 0) pcre2_match_data_free(tls->match_data[--tls->match_data_used]);
+
 	if (tls->gcontext) pcre2_general_context_free(tls->gcontext);
 	if (tls->ccontext) pcre2_compile_context_free(tls->ccontext);
 	if (tls->mcontext) pcre2_match_context_free(tls->mcontext);
@@ -171,6 +191,50 @@ static int fr_pcre2_tls_init(void)
 	return 0;
 }
 
+/** Get match data with at least count slots, reusing pooled match data if possible
+ *
+ * Conditions are evaluated many times per request, and allocating
+ * (and freeing) match data for each evaluation is a significant
+ * part of the cost of a simple match.
+ *
+ * @param[in] count	Minimum number of ovector pairs.
+ * @return
+ *	- Match data.
+ *	- NULL on error.
+ */
+static pcre2_match_data *fr_pcre2_match_data_get(uint32_t count)
+{
+	fr_pcre2_tls_t	*tls = fr_pcre2_tls;
+	unsigned int	i;
+
+	for (i = tls->match_data_used; i > 0; i--) {
+		pcre2_match_data *match_data = tls->match_data[i - 1];
+
+		if (pcre2_get_ovector_count(match_data) < count) continue;
+
+		tls->match_data[i - 1] = tls->match_data[--tls->match_data_used];
+		return match_data;
+	}
+
+	return pcre2_match_data_create(count, tls->gcontext);
+}
+
+/** Return match data to the pool, or free it if the pool is full
+ *
+ * @param[in] match_data	to release.
+ */
+static void fr_pcre2_match_data_release(pcre2_match_data *match_data)
+{
+	fr_pcre2_tls_t	*tls = fr_pcre2_tls;
+
+	if (!tls || (tls->match_data_used >= NUM_ELEMENTS(tls->match_data))) {
+		pcre2_match_data_free(match_data);
+		return;
+	}
+
+	tls->match_data[tls->match_data_used++] = match_data;
+}
+
 /** Free regex_t structure
  *
  * Calls libpcre specific free functions for the expression and study.
@@ -363,7 +427,7 @@ int regex_exec(regex_t *preg, char const *subject, size_t len, fr_regmatch_t *re
 	 *	fails when passed NULL match data.
 	 */
 	if (!regmatch) {
-		match_data = pcre2_match_data_create_from_pattern(preg->compiled, fr_pcre2_tls->gcontext);
+		match_data = fr_pcre2_match_data_get(1);
 		if (!match_data) {
 			fr_strerror_printf("Failed allocating temporary match data");
 			return -1;
@@ -382,7 +446,7 @@ int regex_exec(regex_t *preg, char const *subject, size_t len, fr_regmatch_t *re
 		ret = pcre2_match(preg->compiled, (PCRE2_SPTR8)subject, len, 0, options,
 				  match_data, fr_pcre2_tls->mcontext);
 	}
-	if (!regmatch) pcre2_match_data_free(match_data);
+	if (!regmatch) fr_pcre2_match_data_release(match_data);
 	if (ret < 0) {
 		PCRE2_UCHAR	errbuff[128];
 
@@ -592,7 +656,7 @@ uint32_t regex_subcapture_count(regex_t const *preg)
  */
 static int _pcre2_match_data_free(fr_regmatch_t *regmatch)
 {
-	pcre2_match_data_free(regmatch->match_data);
+	fr_pcre2_match_data_release(regmatch->match_data);
 	return 0;
 }
 
@@ -620,7 +684,7 @@ fr_regmatch_t *regex_match_data_alloc(TALLOC_CTX *ctx, uint32_t count)
 		return NULL;
 	}
 
-	regmatch->match_data = pcre2_match_data_create(count, fr_pcre2_tls->gcontext);
+	regmatch->match_data = fr_pcre2_match_data_get(count);
 	if (!regmatch->match_data) {
 		talloc_free(regmatch);
 		goto oom;
@@ -1220,6 +1284,175 @@ fr_regmatch_t *regex_match_data_alloc(TALLOC_CTX *ctx, uint32_t count)
  *########################################
  */
 
+#if defined(HAVE_REGEX_PCRE) || defined(HAVE_REGEX_PCRE2)
+/** A pattern compiled at runtime, kept so it can be reused
+ *
+ */
+typedef struct {
+	char const		*pattern;	//!< Pattern text.  May contain embedded \0s.
+	size_t			len;		//!< Length of the pattern.
+	fr_regex_flags_t	flags;		//!< Flags the pattern was compiled with.
+	bool			subcaptures;	//!< Whether subcapture data is stored.
+	regex_t			*preg;		//!< The compiled pattern.
+	fr_dlist_t		entry;		//!< Entry in the LRU list.
+} fr_regex_cache_entry_t;
+
+/** Per-thread cache of patterns compiled at runtime
+ *
+ */
+typedef struct {
+	rbtree_t		*tree;		//!< Entries keyed on pattern, flags and subcaptures.
+	fr_dlist_head_t		lru;		//!< Most recently used entries at the head.
+} fr_regex_cache_t;
+
+static _Thread_local fr_regex_cache_t *fr_regex_cache;
+
+/** Compare two cache entries by pattern, flags and subcaptures
+ *
+ */
+static int _regex_cache_entry_cmp(void const *one, void const *two)
+{
+	fr_regex_cache_entry_t const	*a = one, *b = two;
+	int				ret;
+
+	ret = (a->len > b->len) - (a->len < b->len);
+	if (ret != 0) return ret;
+
+	ret = memcmp(a->pattern, b->pattern, a->len);
+	if (ret != 0) return ret;
+
+#define CMP_FLAG(_f) \
+	if (a->flags._f != b->flags._f) return (a->flags._f > b->flags._f) - (a->flags._f < b->flags._f)
+
+	CMP_FLAG(global);
+	CMP_FLAG(ignore_case);
+	CMP_FLAG(multiline);
+	CMP_FLAG(dot_all);
+	CMP_FLAG(unicode);
+	CMP_FLAG(extended);
+#undef CMP_FLAG
+
+	return (a->subcaptures > b->subcaptures) - (a->subcaptures < b->subcaptures);
+}
+
+/** Release the compiled pattern held by a cache entry
+ *
+ * Requests may still hold a reference to the pattern for subcapture
+ * expansions, in which case it's freed when they're done with it.
+ */
+static int _regex_cache_entry_free(fr_regex_cache_entry_t *entry)
+{
+	talloc_unlink(entry, entry->preg);
+
+	return 0;
+}
+
+static void _regex_cache_free_on_exit(void *arg)
+{
+	talloc_free(arg);
+}
+
+/** Compile a pattern, reusing a previous compilation of the same pattern
+ *
+ * Dynamically expanded patterns are usually the same for every request.
+ * Compiling them is much more expensive than matching against them, so
+ * the compiled patterns are kept in a per-thread LRU cache.  As they're
+ * reused, they're also run through the JIT where available.
+ *
+ * @note The compiled expression is owned by the cache and must not be freed.
+ *	It remains valid until the next call to this function.
+ *
+ * @param[out] out		Where to write out a pointer to the compiled expression.
+ * @param[in] pattern		to compile.
+ * @param[in] len		of pattern.
+ * @param[in] flags		controlling matching. May be NULL.
+ * @param[in] subcaptures	Whether to compile the regular expression to store subcapture
+ *				data.
+ * @return
+ *	- >= 1 on success.
+ *	- <= 0 on error. Negative value is offset of parse error.
+ */
+ssize_t regex_compile_cached(regex_t **out, char const *pattern, size_t len,
+			     fr_regex_flags_t const *flags, bool subcaptures)
+{
+	fr_regex_cache_t	*cache = fr_regex_cache;
+	fr_regex_cache_entry_t	*entry;
+	fr_regex_flags_t	no_flags = { 0 };
+	regex_t			*preg;
+	ssize_t			slen;
+
+	*out = NULL;
+
+	if (!flags) flags = &no_flags;
+
+	if (unlikely(!cache)) {
+		cache = talloc_zero(NULL, fr_regex_cache_t);
+		if (!cache) {
+		oom:
+			fr_strerror_printf("Out of memory");
+			return 0;
+		}
+
+		cache->tree = rbtree_talloc_alloc(cache, _regex_cache_entry_cmp, fr_regex_cache_entry_t,
+						  NULL, RBTREE_FLAG_NONE);
+		if (!cache->tree) {
+			talloc_free(cache);
+			goto oom;
+		}
+		fr_dlist_talloc_init(&cache->lru, fr_regex_cache_entry_t, entry);
+
+		fr_thread_local_set_destructor(fr_regex_cache, _regex_cache_free_on_exit, cache);
+	}
+
+	entry = rbtree_finddata(cache->tree, &(fr_regex_cache_entry_t){ .pattern = pattern, .len = len,
+									 .flags = *flags,
+									 .subcaptures = subcaptures });
+	if (entry) {
+		fr_dlist_remove(&cache->lru, entry);
+		fr_dlist_insert_head(&cache->lru, entry);
+
+		*out = entry->preg;
+		return len;
+	}
+
+	slen = regex_compile(NULL, &preg, pattern, len, flags, subcaptures, false);
+	if (slen <= 0) return slen;
+
+	if (fr_dlist_num_elements(&cache->lru) >= FR_REGEX_CACHE_SIZE) {
+		fr_regex_cache_entry_t *oldest = fr_dlist_tail(&cache->lru);
+
+		fr_dlist_remove(&cache->lru, oldest);
+		rbtree_deletebydata(cache->tree, oldest);
+		talloc_free(oldest);
+	}
+
+	entry = talloc_zero(cache, fr_regex_cache_entry_t);
+	if (!entry) {
+		talloc_free(preg);
+		goto oom;
+	}
+	entry->pattern = talloc_memdup(entry, pattern, len);
+	if (!entry->pattern) {
+		talloc_free(entry);
+		talloc_free(preg);
+		goto oom;
+	}
+	entry->len = len;
+	entry->flags = *flags;
+	entry->subcaptures = subcaptures;
+	entry->preg = talloc_steal(entry, preg);
+	preg->cached = true;
+	talloc_set_destructor(entry, _regex_cache_entry_free);
+
+	rbtree_insert(cache->tree, entry);
+	fr_dlist_insert_head(&cache->lru, entry);
+
+	*out = preg;
+
+	return slen;
+}
+#endif
+
 /** Parse a string containing one or more regex flags
  *
  * @param[out] err		May be NULL. If not NULL will be set to:
@@ -67,6 +67,7 @@ typedef struct {
 	bool			precompiled;	//!< Whether this regex was precompiled,
 						///< or compiled for one off evaluation.
 	bool			jitd;		//!< Whether JIT data is available.
+	bool			cached;		//!< Owned by the thread's pattern cache.
 } regex_t;
 /*
  *######################################
@@ -112,6 +113,7 @@ typedef struct {
 
 	bool			precompiled;	//!< Whether this regex was precompiled, or compiled for one off evaluation.
 	bool			jitd;		//!< Whether JIT data is available.
+	bool			cached;		//!< Owned by the thread's pattern cache.
 } regex_t;
 /*
  *######################################
@@ -173,6 +175,10 @@ size_t		regex_flags_snprint(char *out, size_t outlen,
 ssize_t		regex_compile(TALLOC_CTX *ctx, regex_t **out, char const *pattern, size_t len,
 			      fr_regex_flags_t const *flags, bool subcaptures, bool runtime);
 int		regex_exec(regex_t *preg, char const *subject, size_t len, fr_regmatch_t *regmatch);
+#if defined(HAVE_REGEX_PCRE) || defined(HAVE_REGEX_PCRE2)
+ssize_t		regex_compile_cached(regex_t **out, char const *pattern, size_t len,
+				     fr_regex_flags_t const *flags, bool subcaptures);
+#endif
 #ifdef HAVE_REGEX_PCRE2
 int		regex_substitute(TALLOC_CTX *ctx, char **out, size_t max_out, regex_t *preg, fr_regex_flags_t *flags,
 		     		 char const *subject, size_t subject_len,
@@ -0,0 +1,189 @@
+#include <freeradius-devel/util/acutest.h>
+#include <freeradius-devel/util/regex.h>
+#include <freeradius-devel/util/time.h>
+
+#if defined(HAVE_REGEX_PCRE) || defined(HAVE_REGEX_PCRE2)
+/*
+ *	Roughly the number of regex conditions a large policy
+ *	evaluates per request, multiplied out to a few thousand
+ *	requests.
+ */
+#define REGEX_ROUNDS		(65536)
+
+#define CALLED_STATION_PATTERN	"^([0-9a-f]{2}-){5}[0-9a-f]{2}:(.+)$"
+#define CALLED_STATION_SUBJECT	"00-11-22-33-44-55:eduroam"
+
+#define USER_NAME_PATTERN	"^([^@]+)@(example\\.(com|org))$"
+#define USER_NAME_SUBJECT	"bob@example.org"
+
+#define STRL(_s)		_s, sizeof(_s) - 1
+
+static void regex_test_basic(void)
+{
+	regex_t		*preg;
+	fr_regmatch_t	*regmatch;
+
+	TEST_CHECK(regex_compile(NULL, &preg, STRL(USER_NAME_PATTERN), NULL, true, false) > 0);
+	TEST_CHECK(regex_subcapture_count(preg) == 4);
+
+	regmatch = regex_match_data_alloc(NULL, regex_subcapture_count(preg));
+	TEST_CHECK(regmatch != NULL);
+
+	TEST_CHECK(regex_exec(preg, STRL(USER_NAME_SUBJECT), regmatch) == 1);
+	TEST_CHECK(regex_exec(preg, STRL("bob@example.net"), regmatch) == 0);
+	TEST_CHECK(regex_exec(preg, STRL(USER_NAME_SUBJECT), NULL) == 1);
+	TEST_CHECK(regex_exec(preg, STRL("bob"), NULL) == 0);
+
+	talloc_free(regmatch);
+	talloc_free(preg);
+}
+
+static void regex_test_match_data(void)
+{
+	fr_regmatch_t	*regmatch;
+	int		i;
+
+	/*
+	 *	Exercise the per-thread pool, with match data
+	 *	released in a different order to allocation.
+	 */
+	for (i = 0; i < 128; i++) {
+		fr_regmatch_t	*small, *large;
+
+		small = regex_match_data_alloc(NULL, 1);
+		large = regex_match_data_alloc(NULL, 16);
+		TEST_CHECK(small != NULL);
+		TEST_CHECK(large != NULL);
+
+		talloc_free(small);
+		talloc_free(large);
+	}
+
+	regmatch = regex_match_data_alloc(NULL, 8);
+	TEST_CHECK(regmatch != NULL);
+	TEST_CHECK(regmatch->used == 0);
+	talloc_free(regmatch);
+}
+
+static void regex_test_cached(void)
+{
+	regex_t			*a, *b, *c;
+	fr_regex_flags_t	flags = { .ignore_case = true };
+	char			buff[64];
+	int			i;
+
+	TEST_CHECK(regex_compile_cached(&a, STRL(CALLED_STATION_PATTERN), NULL, true) > 0);
+	TEST_CHECK(regex_compile_cached(&b, STRL(CALLED_STATION_PATTERN), NULL, true) > 0);
+	TEST_CHECK(a == b);
+	TEST_CHECK(a->cached);
+
+	/*
+	 *	Different flags and subcapture settings must not
+	 *	share a compiled pattern.
+	 */
+	TEST_CHECK(regex_compile_cached(&c, STRL(CALLED_STATION_PATTERN), &flags, true) > 0);
+	TEST_CHECK(c != a);
+	TEST_CHECK(regex_compile_cached(&c, STRL(CALLED_STATION_PATTERN), NULL, false) > 0);
+	TEST_CHECK(c != a);
+
+	TEST_CHECK(regex_exec(a, STRL(CALLED_STATION_SUBJECT), NULL) == 1);
+	TEST_CHECK(regex_exec(a, STRL("00-11-22-33-44:eduroam"), NULL) == 0);
+
+	/*
+	 *	Errors are reported, and not cached.
+	 */
+	TEST_CHECK(regex_compile_cached(&c, STRL("(unterminated"), NULL, true) <= 0);
+	TEST_CHECK(c == NULL);
+
+	/*
+	 *	Push the original pattern out of the cache (which
+	 *	holds fewer entries than this), and check it's
+	 *	compiled again when next requested.
+	 */
+	for (i = 0; i < 1024; i++) {
+		size_t len;
+
+		len = snprintf(buff, sizeof(buff), "^user-%i@", i);
+		TEST_CHECK(regex_compile_cached(&c, buff, len, NULL, true) > 0);
+		TEST_CHECK(regex_exec(c, buff + 1, len - 1, NULL) == 1);
+	}
+
+	TEST_CHECK(regex_compile_cached(&b, STRL(CALLED_STATION_PATTERN), NULL, true) > 0);
+	TEST_CHECK(regex_exec(b, STRL(CALLED_STATION_SUBJECT), NULL) == 1);
+}
+
+static void regex_bench_pattern(char const *name, char const *pattern, size_t len, char const *subject, size_t subject_len)
+{
+	regex_t		*static_preg, *preg;
+	fr_regmatch_t	*regmatch;
+	fr_time_t	start, compiled, cached, precompiled;
+	int		i, hits = 0;
+
+	TEST_CHECK(regex_compile(NULL, &static_preg, pattern, len, NULL, true, false) > 0);
+
+	/*
+	 *	Dynamic pattern compiled on every request
+	 */
+	start = fr_time();
+	for (i = 0; i < REGEX_ROUNDS; i++) {
+		if (regex_compile(NULL, &preg, pattern, len, NULL, true, true) <= 0) break;
+		regmatch = regex_match_data_alloc(NULL, regex_subcapture_count(preg));
+		hits += regex_exec(preg, subject, subject_len, regmatch);
+		talloc_free(regmatch);
+		talloc_free(preg);
+	}
+	compiled = fr_time();
+
+	/*
+	 *	Dynamic pattern found in the thread's cache
+	 */
+	for (i = 0; i < REGEX_ROUNDS; i++) {
+		if (regex_compile_cached(&preg, pattern, len, NULL, true) <= 0) break;
+		regmatch = regex_match_data_alloc(NULL, regex_subcapture_count(preg));
+		hits += regex_exec(preg, subject, subject_len, regmatch);
+		talloc_free(regmatch);
+	}
+	cached = fr_time();
+
+	/*
+	 *	Static pattern compiled on startup
+	 */
+	for (i = 0; i < REGEX_ROUNDS; i++) {
+		regmatch = regex_match_data_alloc(NULL, regex_subcapture_count(static_preg));
+		hits += regex_exec(static_preg, subject, subject_len, regmatch);
+		talloc_free(regmatch);
+	}
+	precompiled = fr_time();
+
+	TEST_CHECK(hits == (REGEX_ROUNDS * 3));
+	printf("\n%-16s runtime %8.1fns  cached %8.1fns  precompiled %8.1fns\n", name,
+	       (double)(compiled - start) / REGEX_ROUNDS,
+	       (double)(cached - compiled) / REGEX_ROUNDS,
+	       (double)(precompiled - cached) / REGEX_ROUNDS);
+
+	talloc_free(static_preg);
+}
+
+static void regex_bench(void)
+{
+	fr_time_start();
+
+	TEST_CASE("Called-Station-Id");
+	regex_bench_pattern("Called-Station-Id", STRL(CALLED_STATION_PATTERN), STRL(CALLED_STATION_SUBJECT));
+
+	TEST_CASE("User-Name");
+	regex_bench_pattern("User-Name", STRL(USER_NAME_PATTERN), STRL(USER_NAME_SUBJECT));
+}
+
+TEST_LIST = {
+	{ "regex_test_basic",		regex_test_basic	},
+	{ "regex_test_match_data",	regex_test_match_data	},
+	{ "regex_test_cached",		regex_test_cached	},
+	{ "regex_bench",		regex_bench		},
+	{ NULL }
+};
+#else
+TEST_LIST = {
+	{ NULL }
+};
+#endif
@@ -44,6 +44,16 @@
 
 #include <ifaddrs.h>
 
+#ifdef __linux__
+#  include <linux/filter.h>
+#endif
+
+fr_table_num_sorted_t const fr_socket_steer_table[] = {
+	{ L("client"),	FR_SOCKET_STEER_CLIENT	},
+	{ L("flow"),	FR_SOCKET_STEER_FLOW	}
+};
+size_t fr_socket_steer_table_len = NUM_ELEMENTS(fr_socket_steer_table);
+
 /** Resolve a named service to a port
  *
  * @param[in] proto	The protocol. Either IPPROTO_TCP or IPPROTO_UDP.
@@ -1051,3 +1061,97 @@ done:
 #endif
 	return 0;
 }
+
+/** Set how the kernel picks between sockets which share an address
+ *
+ * All of the sockets bound to the same address and port with
+ * SO_REUSEPORT are in one group.  By default, the kernel picks a
+ * socket from the group by hashing the source and destination
+ * addresses and ports of the packet.  That is
+ * #FR_SOCKET_STEER_FLOW, and needs no work here.
+ *
+ * For #FR_SOCKET_STEER_CLIENT we attach a small classic BPF program
+ * to the group, which hashes the source IP address.  All packets
+ * from a client then go to the same socket, no matter which source
+ * port the client uses.
+ *
+ * The program is attached to the group, and not to the socket, so
+ * it only needs to be set on one socket.  Sockets are numbered in
+ * the order that they were bound.  If the program returns an index
+ * for a socket which doesn't exist, the kernel falls back to its
+ * own hash.
+ *
+ * @param[in] sockfd	a bound socket.
+ * @param[in] af	address family of the socket.
+ * @param[in] steer	how packets are distributed.
+ * @param[in] num	the number of sockets in the group.
+ * @return
+ *	- 0 on success.
+ *	- -1 on failure, or when the steering policy isn't supported.
+ */
+int fr_socket_server_steer(UNUSED int sockfd, UNUSED int af, fr_socket_steer_t steer, uint32_t num)
+{
+#if defined(SO_ATTACH_REUSEPORT_CBPF) && defined(SKF_NET_OFF)
+	struct sock_filter	code[16];
+	struct sock_fprog	prog;
+	unsigned int		i = 0;
+
+	if ((steer == FR_SOCKET_STEER_FLOW) || (num < 2)) return 0;
+
+	/*
+	 *	The program runs with the packet data pointing at the
+	 *	UDP payload.  So we load the source IP using offsets
+	 *	from the network header.
+	 */
+	switch (af) {
+	case AF_INET:
+		code[i++] = (struct sock_filter) BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_NET_OFF + 12);
+		break;
+
+	case AF_INET6:
+		/*
+		 *	XOR the four words of the source address together.
+		 */
+		code[i++] = (struct sock_filter) BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_NET_OFF + 8);
+		code[i++] = (struct sock_filter) BPF_STMT(BPF_MISC | BPF_TAX, 0);
+		code[i++] = (struct sock_filter) BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_NET_OFF + 12);
+		code[i++] = (struct sock_filter) BPF_STMT(BPF_ALU | BPF_XOR | BPF_X, 0);
+		code[i++] = (struct sock_filter) BPF_STMT(BPF_MISC | BPF_TAX, 0);
+		code[i++] = (struct sock_filter) BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_NET_OFF + 16);
+		code[i++] = (struct sock_filter) BPF_STMT(BPF_ALU | BPF_XOR | BPF_X, 0);
+		code[i++] = (struct sock_filter) BPF_STMT(BPF_MISC | BPF_TAX, 0);
+		code[i++] = (struct sock_filter) BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_NET_OFF + 20);
+		code[i++] = (struct sock_filter) BPF_STMT(BPF_ALU | BPF_XOR | BPF_X, 0);
+		break;
+
+	default:
+		fr_strerror_printf("Cannot steer packets for address family %d", af);
+		return -1;
+	}
+
+	/*
+	 *	Fold the high bits into the low ones, so that clients
+	 *	in the same subnet are spread across the sockets.
+	 */
+	code[i++] = (struct sock_filter) BPF_STMT(BPF_MISC | BPF_TAX, 0);
+	code[i++] = (struct sock_filter) BPF_STMT(BPF_ALU | BPF_RSH | BPF_K, 16);
+	code[i++] = (struct sock_filter) BPF_STMT(BPF_ALU | BPF_XOR | BPF_X, 0);
+	code[i++] = (struct sock_filter) BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, num);
+	code[i++] = (struct sock_filter) BPF_STMT(BPF_RET | BPF_A, 0);
+
+	prog.len = i;
+	prog.filter = code;
+
+	if (setsockopt(sockfd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) < 0) {
+		fr_strerror_printf("Failed attaching steering program: %s", fr_syserror(errno));
+		return -1;
+	}
+
+	return 0;
+#else
+	if ((steer == FR_SOCKET_STEER_FLOW) || (num < 2)) return 0;
+
+	fr_strerror_printf("Steering packets by client is not supported on this platform");
+	return -1;
+#endif
+}
@@ -34,6 +34,7 @@ extern "C" {
 #include <freeradius-devel/build.h>
 #include <freeradius-devel/missing.h>
 #include <freeradius-devel/util/inet.h>
+#include <freeradius-devel/util/table.h>
 #include <freeradius-devel/util/time.h>
 
 #include <stdbool.h>
@@ -55,6 +56,19 @@ extern "C" {
 #  define SUN_LEN(su)  (sizeof(*(su)) - sizeof((su)->sun_path) + strlen((su)->sun_path))
 #endif
 
+/** How the kernel picks one of many sockets bound to the same address with SO_REUSEPORT
+ *
+ */
+typedef enum {
+	FR_SOCKET_STEER_FLOW = 0,			//!< Kernel hash of the source and destination
+							///< addresses and ports.
+	FR_SOCKET_STEER_CLIENT,				//!< Hash of the source IP address, so that all
+							///< packets from one client go to one socket.
+} fr_socket_steer_t;
+
+extern fr_table_num_sorted_t const fr_socket_steer_table[];
+extern size_t fr_socket_steer_table_len;
+
 bool		fr_socket_is_valid_proto(int proto);
 int		fr_socket_client_unix(char const *path, bool async);
 int		fr_socket_client_udp(fr_ipaddr_t *src_ipaddr, uint16_t *src_port, fr_ipaddr_t const *dst_ipaddr,
@@ -66,6 +80,7 @@ int		fr_socket_wait_for_connect(int sockfd, fr_time_delta_t timeout);
 int		fr_socket_server_udp(fr_ipaddr_t const *ipaddr, uint16_t *port, char const *port_name, bool async);
 int		fr_socket_server_tcp(fr_ipaddr_t const *ipaddr, uint16_t *port, char const *port_name, bool async);
 int		fr_socket_bind(int sockfd, fr_ipaddr_t const *ipaddr, uint16_t *port, char const *interface);
+int		fr_socket_server_steer(int sockfd, int af, fr_socket_steer_t steer, uint32_t num);
 
 #ifdef __cplusplus
 }
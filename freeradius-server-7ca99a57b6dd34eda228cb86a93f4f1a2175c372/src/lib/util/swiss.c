@@ -0,0 +1,517 @@
+/*
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/** Open addressing hash tables
+ *
+ * A "Swiss table" style hash table.  Slots are arranged into groups
+ * of 16, and each slot has a one byte control entry holding either
+ * an empty / deleted marker, or the low 7 bits of the hash of the
+ * data in that slot.
+ *
+ * A lookup hashes the key once, picks a group from the high bits of
+ * the hash, and then compares all 16 control bytes of the group
+ * against the low 7 bits in one operation.  Only slots with matching
+ * control bytes have their (stored) hash and data compared.  Where
+ * SSE2 is available the group comparison is a single vector compare,
+ * otherwise it's a simple loop the compiler is free to vectorise.
+ *
+ * Unlike fr_hash_table_t there is no per-entry allocation, and no
+ * chasing pointers through bucket chains.  The API mirrors
+ * fr_hash_table_t, so callers can switch between the two.
+ *
+ * @file src/lib/util/swiss.c
+ *
+ * @copyright 2020 The FreeRADIUS server project
+ */
+RCSID("$Id$")
+
+#include <freeradius-devel/util/swiss.h>
+#include <freeradius-devel/util/talloc.h>
+
+#include <string.h>
+
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
+
+#define SWISS_GROUP_SIZE	(16)
+#define SWISS_NUM_GROUPS	(4)	//!< Initial number of groups.  Must be a power of two.
+
+#define CTRL_EMPTY		((uint8_t) 0x80)
+#define CTRL_DELETED		((uint8_t) 0xfe)
+
+#define H1(_hash)		((_hash) >> 7)
+#define H2(_hash)		((uint8_t) ((_hash) & 0x7f))
+
+typedef struct {
+	void			*data;
+	uint32_t		hash;		//!< Cached so we don't re-hash on compare or grow.
+} fr_swiss_slot_t;
+
+struct fr_swiss_table_s {
+	uint32_t		num_elements;
+	uint32_t		num_deleted;	//!< Tombstones, which still lengthen probe sequences.
+	uint32_t		num_groups;	//!< Power of 2.
+	uint32_t		mask;		//!< num_groups - 1.
+	uint32_t		growth_left;	//!< Empty slots we can use before we have to rehash.
+
+	fr_hash_table_free_t	free;
+	fr_hash_table_hash_t	hash;
+	fr_hash_table_cmp_t	cmp;
+
+	uint8_t			*ctrl;		//!< One control byte per slot.
+	fr_swiss_slot_t		*slots;
+};
+
+/** Return a bitmask of the slots in a group whose control byte matches
+ *
+ */
+static inline uint32_t group_match(uint8_t const *ctrl, uint8_t c)
+{
+#ifdef __SSE2__
+	__m128i group = _mm_loadu_si128((__m128i const *) ctrl);
+
+	return (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8((char) c), group));
+#else
+	uint32_t	mask = 0;
+	int		i;
+
+	for (i = 0; i < SWISS_GROUP_SIZE; i++) mask |= (uint32_t) (ctrl[i] == c) << i;
+
+	return mask;
+#endif
+}
+
+/** Return a bitmask of the slots in a group which are empty or deleted
+ *
+ */
+static inline uint32_t group_match_free(uint8_t const *ctrl)
+{
+#ifdef __SSE2__
+	return (uint32_t) _mm_movemask_epi8(_mm_loadu_si128((__m128i const *) ctrl));
+#else
+	uint32_t	mask = 0;
+	int		i;
+
+	for (i = 0; i < SWISS_GROUP_SIZE; i++) mask |= (uint32_t) (ctrl[i] >> 7) << i;
+
+	return mask;
+#endif
+}
+
+/** Maximum number of elements before we need to rehash
+ *
+ * Load factor is 7/8.
+ */
+static inline uint32_t swiss_max_load(uint32_t num_groups)
+{
+	uint32_t capacity = num_groups * SWISS_GROUP_SIZE;
+
+	return capacity - (capacity >> 3);
+}
+
+/** Find the slot containing data
+ *
+ * Probes groups with triangular steps, which visits every group
+ * exactly once when num_groups is a power of 2.  A group containing
+ * an empty slot terminates the probe, as an insert would have used it.
+ */
+static fr_swiss_slot_t *swiss_find(fr_swiss_table_t *ht, void const *data, uint32_t hash, uint32_t *idx)
+{
+	uint32_t	group = H1(hash) & ht->mask;
+	uint32_t	step = 0;
+	uint8_t		h2 = H2(hash);
+
+	for (;;) {
+		uint8_t const	*ctrl = ht->ctrl + (group * SWISS_GROUP_SIZE);
+		uint32_t	match;
+
+		for (match = group_match(ctrl, h2); match; match &= match - 1) {
+			uint32_t	i = (group * SWISS_GROUP_SIZE) + __builtin_ctz(match);
+			fr_swiss_slot_t	*slot = &ht->slots[i];
+
+			if (slot->hash != hash) continue;
+			if (ht->cmp && (ht->cmp(data, slot->data) != 0)) continue;
+
+			*idx = i;
+			return slot;
+		}
+
+		if (group_match(ctrl, CTRL_EMPTY)) return NULL;
+
+		if (++step > ht->mask) return NULL;
+		group = (group + step) & ht->mask;
+	}
+}
+
+/** Find the first empty or deleted slot in the probe sequence for hash
+ *
+ * There's always at least one, as growth_left is never allowed to reach zero
+ * with an insert pending.
+ */
+static uint32_t swiss_find_free(uint8_t const *ctrl, uint32_t mask, uint32_t hash)
+{
+	uint32_t	group = H1(hash) & mask;
+	uint32_t	step = 0;
+
+	for (;;) {
+		uint32_t	match = group_match_free(ctrl + (group * SWISS_GROUP_SIZE));
+
+		if (match) return (group * SWISS_GROUP_SIZE) + __builtin_ctz(match);
+
+		step++;
+		group = (group + step) & mask;
+	}
+}
+
+/** Move all entries into a freshly allocated set of groups, dropping tombstones
+ *
+ */
+static int swiss_resize(fr_swiss_table_t *ht, uint32_t num_groups)
+{
+	uint8_t		*ctrl;
+	fr_swiss_slot_t	*slots;
+	uint32_t	i, capacity, mask;
+
+	capacity = num_groups * SWISS_GROUP_SIZE;
+	mask = num_groups - 1;
+
+	ctrl = talloc_array(ht, uint8_t, capacity);
+	if (!ctrl) return -1;
+	memset(ctrl, CTRL_EMPTY, capacity);
+
+	slots = talloc_array(ht, fr_swiss_slot_t, capacity);
+	if (!slots) {
+		talloc_free(ctrl);
+		return -1;
+	}
+
+	for (i = 0; i < ht->num_groups * SWISS_GROUP_SIZE; i++) {
+		uint32_t j;
+
+		if (ht->ctrl[i] & 0x80) continue;	/* empty or deleted */
+
+		j = swiss_find_free(ctrl, mask, ht->slots[i].hash);
+		ctrl[j] = ht->ctrl[i];
+		slots[j] = ht->slots[i];
+	}
+
+	talloc_free(ht->ctrl);
+	talloc_free(ht->slots);
+
+	ht->ctrl = ctrl;
+	ht->slots = slots;
+	ht->num_groups = num_groups;
+	ht->mask = mask;
+	ht->num_deleted = 0;
+	ht->growth_left = swiss_max_load(num_groups) - ht->num_elements;
+
+	return 0;
+}
+
+/** Make room for at least one more insert
+ *
+ * If most of the used slots are tombstones, rehash in place
+ * instead of growing.
+ */
+static int swiss_grow(fr_swiss_table_t *ht)
+{
+	if (ht->num_elements <= (swiss_max_load(ht->num_groups) >> 1)) return swiss_resize(ht, ht->num_groups);
+
+	return swiss_resize(ht, ht->num_groups << 1);
+}
+
+/** Call the free function for every entry, when the table is freed
+ *
+ */
+static int _fr_swiss_table_free(fr_swiss_table_t *ht)
+{
+	uint32_t i;
+
+	if (!ht->free) return 0;
+
+	for (i = 0; i < ht->num_groups * SWISS_GROUP_SIZE; i++) {
+		if (ht->ctrl[i] & 0x80) continue;
+
+		ht->free(ht->slots[i].data);
+	}
+
+	return 0;
+}
+
+/** Create an open addressing hash table
+ *
+ * @param[in] ctx	to link the table's lifetime to.
+ * @param[in] hashNode	function to hash data.
+ * @param[in] cmpNode	function to compare data.  If NULL, data with
+ *			identical hashes is considered identical.
+ * @param[in] freeNode	called for each entry when it's deleted, replaced,
+ *			or when the table is freed, either explicitly or
+ *			along with ctx.
+ * @return
+ *	- A new table.
+ *	- NULL on error.
+ */
+fr_swiss_table_t *fr_swiss_table_create(TALLOC_CTX *ctx,
+					fr_hash_table_hash_t hashNode,
+					fr_hash_table_cmp_t cmpNode,
+					fr_hash_table_free_t freeNode)
+{
+	fr_swiss_table_t *ht;
+
+	if (!hashNode) return NULL;
+
+	ht = talloc_zero(NULL, fr_swiss_table_t);
+	if (!ht) return NULL;
+	talloc_set_destructor(ht, _fr_swiss_table_free);
+	talloc_link_ctx(ctx, ht);
+
+	ht->free = freeNode;
+	ht->hash = hashNode;
+	ht->cmp = cmpNode;
+
+	if (swiss_resize(ht, SWISS_NUM_GROUPS) < 0) {
+		talloc_set_destructor(ht, NULL);
+		talloc_free(ht);
+		return NULL;
+	}
+
+	return ht;
+}
+
+/** Free a table, calling the free function for every entry
+ *
+ */
+void fr_swiss_table_free(fr_swiss_table_t *ht)
+{
+	if (!ht) return;
+
+	talloc_free(ht);
+}
+
+/** Pre-size the table so num elements can be inserted without rehashing
+ *
+ * @param[in] ht	to resize.
+ * @param[in] num	total number of elements expected.
+ * @return
+ *	- 0 on success.
+ *	- -1 on allocation failure.
+ */
+int fr_swiss_table_reserve(fr_swiss_table_t *ht, uint32_t num)
+{
+	uint32_t num_groups;
+
+	if (!ht) return -1;
+
+	for (num_groups = ht->num_groups; swiss_max_load(num_groups) < num; num_groups <<= 1);
+
+	if (num_groups == ht->num_groups) return 0;
+
+	return swiss_resize(ht, num_groups);
+}
+
+/** Insert data
+ *
+ * @return
+ *	- 1 on success.
+ *	- 0 if the data already exists, or on allocation failure.
+ */
+int fr_swiss_table_insert(fr_swiss_table_t *ht, void const *data)
+{
+	uint32_t	hash, i;
+
+	if (!ht || !data) return 0;
+
+	hash = ht->hash(data);
+
+	if (swiss_find(ht, data, hash, &i)) return 0;
+
+	if ((ht->growth_left == 0) && (swiss_grow(ht) < 0)) return 0;
+
+	i = swiss_find_free(ht->ctrl, ht->mask, hash);
+	if (ht->ctrl[i] == CTRL_DELETED) {
+		ht->num_deleted--;
+	} else {
+		ht->growth_left--;
+	}
+
+	ht->ctrl[i] = H2(hash);
+	memcpy(&ht->slots[i].data, &data, sizeof(ht->slots[i].data));
+	ht->slots[i].hash = hash;
+	ht->num_elements++;
+
+	return 1;
+}
+
+/** Replace old data with new data, OR insert if there is no old
+ *
+ */
+int fr_swiss_table_replace(fr_swiss_table_t *ht, void const *data)
+{
+	fr_swiss_slot_t	*slot;
+	uint32_t	i;
+
+	if (!ht || !data) return 0;
+
+	slot = swiss_find(ht, data, ht->hash(data), &i);
+	if (!slot) return fr_swiss_table_insert(ht, data);
+
+	if (ht->free) ht->free(slot->data);
+
+	memcpy(&slot->data, &data, sizeof(slot->data));
+
+	return 1;
+}
+
+/** Find data from a template
+ *
+ */
+void *fr_swiss_table_finddata(fr_swiss_table_t *ht, void const *data)
+{
+	fr_swiss_slot_t	*slot;
+	uint32_t	i;
+
+	if (!ht) return NULL;
+
+	slot = swiss_find(ht, data, ht->hash(data), &i);
+	if (!slot) return NULL;
+
+	return slot->data;
+}
+
+/** Yank an entry from the table, without freeing the data
+ *
+ */
+void *fr_swiss_table_yank(fr_swiss_table_t *ht, void const *data)
+{
+	fr_swiss_slot_t	*slot;
+	uint32_t	i;
+
+	if (!ht) return NULL;
+
+	slot = swiss_find(ht, data, ht->hash(data), &i);
+	if (!slot) return NULL;
+
+	/*
+	 *	If the group still has an empty slot, no probe
+	 *	sequence has ever continued past it, so we can
+	 *	mark this slot empty rather than leave a tombstone.
+	 */
+	if (group_match(ht->ctrl + (i & ~(SWISS_GROUP_SIZE - 1)), CTRL_EMPTY)) {
+		ht->ctrl[i] = CTRL_EMPTY;
+		ht->growth_left++;
+	} else {
+		ht->ctrl[i] = CTRL_DELETED;
+		ht->num_deleted++;
+	}
+	ht->num_elements--;
+
+	return slot->data;
+}
+
+/** Delete a piece of data from the table
+ *
+ */
+int fr_swiss_table_delete(fr_swiss_table_t *ht, void const *data)
+{
+	void *old;
+
+	old = fr_swiss_table_yank(ht, data);
+	if (!old) return 0;
+
+	if (ht->free) ht->free(old);
+
+	return 1;
+}
+
+/** Count number of elements
+ *
+ */
+int fr_swiss_table_num_elements(fr_swiss_table_t *ht)
+{
+	if (!ht) return 0;
+
+	return ht->num_elements;
+}
+
+/** Walk over the entries
+ *
+ * @note The callback may delete the current entry, but must not insert,
+ *	as an insert may rehash the table.
+ */
+int fr_swiss_table_walk(fr_swiss_table_t *ht,
+			fr_hash_table_walk_t callback,
+			void *ctx)
+{
+	uint32_t	i;
+	int		rcode;
+
+	if (!ht || !callback) return 0;
+
+	for (i = 0; i < ht->num_groups * SWISS_GROUP_SIZE; i++) {
+		if (ht->ctrl[i] & 0x80) continue;
+
+		rcode = callback(ctx, ht->slots[i].data);
+		if (rcode != 0) return rcode;
+	}
+
+	return 0;
+}
+
+/** Iterate over entries in a table
+ *
+ * @note If the table is modified the iterator should be considered invalidated.
+ *
+ * @param[in] ht	to iterate over.
+ * @param[in] iter	Pointer to an iterator struct, used to maintain
+ *			state between calls.
+ * @return
+ *	- User data.
+ *	- NULL if at the end of the table.
+ */
+void *fr_swiss_table_iter_next(fr_swiss_table_t *ht, fr_swiss_iter_t *iter)
+{
+	if (unlikely(!ht)) return NULL;
+
+	while (iter->slot < (ht->num_groups * SWISS_GROUP_SIZE)) {
+		uint32_t i = iter->slot++;
+
+		if (ht->ctrl[i] & 0x80) continue;
+
+		return ht->slots[i].data;
+	}
+
+	return NULL;
+}
+
+/** Initialise an iterator
+ *
+ * @note If the table is modified the iterator should be considered invalidated.
+ *
+ * @param[in] ht	to iterate over.
+ * @param[in] iter	to initialise.
+ * @return
+ *	- The first entry in the table.
+ *	- NULL if the table is empty.
+ */
+void *fr_swiss_table_iter_init(fr_swiss_table_t *ht, fr_swiss_iter_t *iter)
+{
+	if (unlikely(!ht)) return NULL;
+
+	iter->slot = 0;
+
+	return fr_swiss_table_iter_next(ht, iter);
+}
@@ -0,0 +1,82 @@
+#pragma once
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/** Structures and prototypes for open addressing hash tables
+ *
+ * @file src/lib/util/swiss.h
+ *
+ * @copyright 2020 The FreeRADIUS server project
+ */
+RCSIDH(swiss_h, "$Id$")
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <freeradius-devel/build.h>
+#include <freeradius-devel/missing.h>
+#include <freeradius-devel/util/hash.h>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <talloc.h>
+
+/** Stores the state of the current iteration operation
+ *
+ */
+typedef struct {
+	uint32_t		slot;		//!< Next slot to examine.
+} fr_swiss_iter_t;
+
+typedef struct fr_swiss_table_s fr_swiss_table_t;
+
+/*
+ *	The callback types are shared with fr_hash_table_t, so that
+ *	either table can be used with the same hash/cmp/free functions.
+ */
+fr_swiss_table_t *fr_swiss_table_create(TALLOC_CTX *ctx,
+					fr_hash_table_hash_t hashNode,
+					fr_hash_table_cmp_t cmpNode,
+					fr_hash_table_free_t freeNode);
+
+void		fr_swiss_table_free(fr_swiss_table_t *ht);
+
+int		fr_swiss_table_insert(fr_swiss_table_t *ht, void const *data);
+
+int		fr_swiss_table_delete(fr_swiss_table_t *ht, void const *data);
+
+void		*fr_swiss_table_yank(fr_swiss_table_t *ht, void const *data);
+
+int		fr_swiss_table_replace(fr_swiss_table_t *ht, void const *data);
+
+void		*fr_swiss_table_finddata(fr_swiss_table_t *ht, void const *data);
+
+int		fr_swiss_table_num_elements(fr_swiss_table_t *ht);
+
+int		fr_swiss_table_reserve(fr_swiss_table_t *ht, uint32_t num);
+
+int		fr_swiss_table_walk(fr_swiss_table_t *ht,
+				    fr_hash_table_walk_t callback,
+				    void *ctx);
+
+void		*fr_swiss_table_iter_next(fr_swiss_table_t *ht, fr_swiss_iter_t *iter);
+
+void		*fr_swiss_table_iter_init(fr_swiss_table_t *ht, fr_swiss_iter_t *iter);
+
+#ifdef __cplusplus
+}
+#endif
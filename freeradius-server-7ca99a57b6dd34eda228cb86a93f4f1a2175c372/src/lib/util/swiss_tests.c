@@ -0,0 +1,251 @@
+#include <freeradius-devel/util/acutest.h>
+#include <freeradius-devel/util/time.h>
+
+#include "swiss.c"
+
+/*
+ *	Roughly the number of attributes in a large protocol dictionary.
+ */
+#define SWISS_DICT_SIZE		(4096)
+
+/*
+ *	Roughly the number of in-flight packets a busy listener tracks.
+ */
+#define SWISS_CONN_SIZE		(262144)
+
+#define SWISS_ROUNDS		(8)
+
+typedef struct {
+	char		name[32];
+} dict_thing;
+
+typedef struct {
+	uint32_t	src_ip;
+	uint16_t	src_port;
+	uint8_t		id;
+	uint8_t		code;
+} conn_thing;
+
+static uint32_t dict_hash(void const *data)
+{
+	dict_thing const *a = data;
+
+	return fr_hash_string(a->name);
+}
+
+static int dict_cmp(void const *one, void const *two)
+{
+	dict_thing const *a = one, *b = two;
+
+	return strcmp(a->name, b->name);
+}
+
+static uint32_t conn_hash(void const *data)
+{
+	return fr_hash(data, sizeof(conn_thing));
+}
+
+static int conn_cmp(void const *one, void const *two)
+{
+	return memcmp(one, two, sizeof(conn_thing));
+}
+
+static void *dict_array(int num)
+{
+	dict_thing	*array;
+	int		i;
+
+	array = calloc(num, sizeof(*array));
+	for (i = 0; i < num; i++) snprintf(array[i].name, sizeof(array[i].name), "Attr-%u.%u", i >> 8, i & 0xff);
+
+	return array;
+}
+
+static void *conn_array(int num)
+{
+	conn_thing	*array;
+	int		i;
+
+	array = calloc(num, sizeof(*array));
+	for (i = 0; i < num; i++) {
+		array[i].src_ip = htonl(0x0a000000 | (i >> 8));
+		array[i].src_port = 1024 + (i & 0xff);
+		array[i].id = i & 0xff;
+		array[i].code = 1;
+	}
+
+	return array;
+}
+
+static void swiss_test_basic(void)
+{
+	fr_swiss_table_t	*ht;
+	fr_swiss_iter_t		iter;
+	conn_thing		*array, *p;
+	int			i, ret, count;
+
+	array = conn_array(SWISS_CONN_SIZE);
+
+	ht = fr_swiss_table_create(NULL, conn_hash, conn_cmp, NULL);
+	TEST_CHECK(ht != NULL);
+
+	TEST_CASE("insertions");
+	for (i = 0; i < SWISS_CONN_SIZE; i++) {
+		TEST_CHECK((ret = fr_swiss_table_insert(ht, &array[i])) == 1);
+		TEST_MSG("insert %i failed", i);
+	}
+	TEST_CHECK(fr_swiss_table_num_elements(ht) == SWISS_CONN_SIZE);
+
+	TEST_CASE("duplicates");
+	TEST_CHECK(fr_swiss_table_insert(ht, &array[0]) == 0);
+
+	TEST_CASE("lookups");
+	for (i = 0; i < SWISS_CONN_SIZE; i++) {
+		conn_thing key = array[i];
+
+		TEST_CHECK(fr_swiss_table_finddata(ht, &key) == &array[i]);
+		TEST_MSG("element %i not found", i);
+	}
+
+	TEST_CASE("iteration");
+	for (p = fr_swiss_table_iter_init(ht, &iter), count = 0; p; p = fr_swiss_table_iter_next(ht, &iter)) count++;
+	TEST_CHECK(count == SWISS_CONN_SIZE);
+	TEST_MSG("expected %i got %i", SWISS_CONN_SIZE, count);
+
+	TEST_CASE("deletions");
+	for (i = 0; i < SWISS_CONN_SIZE; i += 2) {
+		TEST_CHECK(fr_swiss_table_delete(ht, &array[i]) == 1);
+		TEST_MSG("element %i removal failed", i);
+	}
+	TEST_CHECK(fr_swiss_table_num_elements(ht) == SWISS_CONN_SIZE / 2);
+
+	for (i = 0; i < SWISS_CONN_SIZE; i++) {
+		p = fr_swiss_table_finddata(ht, &array[i]);
+		if (i & 0x01) {
+			TEST_CHECK(p == &array[i]);
+		} else {
+			TEST_CHECK(p == NULL);
+		}
+		TEST_MSG("element %i in wrong state", i);
+	}
+
+	TEST_CASE("churn");
+	for (i = 0; i < SWISS_CONN_SIZE; i++) {
+		if (i & 0x01) {
+			TEST_CHECK(fr_swiss_table_yank(ht, &array[i]) == &array[i]);
+		} else {
+			TEST_CHECK(fr_swiss_table_insert(ht, &array[i]) == 1);
+		}
+	}
+	TEST_CHECK(fr_swiss_table_num_elements(ht) == SWISS_CONN_SIZE / 2);
+
+	talloc_free(ht);
+	free(array);
+}
+
+static int swiss_freed;
+
+static void conn_free(UNUSED void *data)
+{
+	swiss_freed++;
+}
+
+static void swiss_test_free(void)
+{
+	TALLOC_CTX		*ctx;
+	fr_swiss_table_t	*ht;
+	conn_thing		*array;
+	int			i;
+
+	array = conn_array(100);
+
+	TEST_CASE("freed explicitly");
+	swiss_freed = 0;
+	ht = fr_swiss_table_create(NULL, conn_hash, conn_cmp, conn_free);
+	for (i = 0; i < 100; i++) fr_swiss_table_insert(ht, &array[i]);
+	fr_swiss_table_free(ht);
+	TEST_CHECK(swiss_freed == 100);
+	TEST_MSG("expected 100 got %i", swiss_freed);
+
+	TEST_CASE("freed with its parent");
+	swiss_freed = 0;
+	ctx = talloc_init_const("swiss_test_free");
+	ht = fr_swiss_table_create(ctx, conn_hash, conn_cmp, conn_free);
+	for (i = 0; i < 100; i++) fr_swiss_table_insert(ht, &array[i]);
+	TEST_CHECK(fr_swiss_table_delete(ht, &array[0]) == 1);
+	TEST_CHECK(swiss_freed == 1);
+	talloc_free(ctx);
+	TEST_CHECK(swiss_freed == 100);
+	TEST_MSG("expected 100 got %i", swiss_freed);
+
+	free(array);
+}
+
+/*
+ *	Run the same workload against fr_hash_table_t and fr_swiss_table_t,
+ *	printing the time taken for each phase.
+ */
+#define BENCH(_type, _name, _array, _size, _hash, _cmp) \
+static void _type ## _bench_ ## _name(void) \
+{ \
+	_type ## _t	*ht; \
+	fr_time_t	start, inserted, found, missed; \
+	int		i, j, hits = 0; \
+	ht = _type ## _create(NULL, _hash, _cmp, NULL); \
+	TEST_CHECK(ht != NULL); \
+	start = fr_time(); \
+	for (i = 0; i < (_size); i++) _type ## _insert(ht, &(_array)[i]); \
+	inserted = fr_time(); \
+	for (j = 0; j < SWISS_ROUNDS; j++) { \
+		for (i = 0; i < (_size); i++) if (_type ## _finddata(ht, &(_array)[i])) hits++; \
+	} \
+	found = fr_time(); \
+	for (j = 0; j < SWISS_ROUNDS; j++) { \
+		for (i = (_size); i < ((_size) << 1); i++) if (_type ## _finddata(ht, &(_array)[i])) hits++; \
+	} \
+	missed = fr_time(); \
+	TEST_CHECK(hits == ((_size) * SWISS_ROUNDS)); \
+	printf("\n%-16s %-5s insert %6.1fns  hit %6.1fns  miss %6.1fns\n", #_type, #_name, \
+			(double)(inserted - start) / (_size), \
+			(double)(found - inserted) / ((_size) * SWISS_ROUNDS), \
+			(double)(missed - found) / ((_size) * SWISS_ROUNDS)); \
+	talloc_free(ht); \
+}
+
+static dict_thing	*dict_keys;
+static conn_thing	*conn_keys;
+
+BENCH(fr_hash_table, dict, dict_keys, SWISS_DICT_SIZE, dict_hash, dict_cmp)
+BENCH(fr_swiss_table, dict, dict_keys, SWISS_DICT_SIZE, dict_hash, dict_cmp)
+BENCH(fr_hash_table, conn, conn_keys, SWISS_CONN_SIZE, conn_hash, conn_cmp)
+BENCH(fr_swiss_table, conn, conn_keys, SWISS_CONN_SIZE, conn_hash, conn_cmp)
+
+static void swiss_bench(void)
+{
+	fr_time_start();
+
+	/*
+	 *	Twice as many keys as we insert, so the second
+	 *	half can be used for negative lookups.
+	 */
+	dict_keys = dict_array(SWISS_DICT_SIZE << 1);
+	conn_keys = conn_array(SWISS_CONN_SIZE << 1);
+
+	TEST_CASE("dictionary sized");
+	fr_hash_table_bench_dict();
+	fr_swiss_table_bench_dict();
+
+	TEST_CASE("connection tracking sized");
+	fr_hash_table_bench_conn();
+	fr_swiss_table_bench_conn();
+
+	free(dict_keys);
+	free(conn_keys);
+}
+
+TEST_LIST = {
+	{ "swiss_test_basic",		swiss_test_basic	},
+	{ "swiss_test_free",		swiss_test_free		},
+	{ "swiss_bench",		swiss_bench		},
+	{ NULL }
+};
@@ -36,6 +36,12 @@ RCSID("$Id$")
 #define UDP_UNUSED UNUSED
 #endif
 
+#ifdef HAVE_RECVMMSG
+#define RECVMMSG_UNUSED
+#else
+#define RECVMMSG_UNUSED UNUSED
+#endif
+
 #define FR_DEBUG_STRERROR_PRINTF if (fr_debug_lvl) fr_strerror_printf
 
 /** Send a packet via a UDP socket.
@@ -256,3 +262,418 @@ done:
 
 	return received;
 }
+
+/*
+ *	Enough room for IP_PKTINFO / IPV6_PKTINFO, and SO_TIMESTAMP.
+ */
+#define UDP_BATCH_CBUF_SIZE	(256)
+
+typedef struct {
+	struct sockaddr_storage	addr;			//!< Where the packet came from, or is going to.
+	struct iovec		iov;			//!< Packet data.
+	uint8_t			cbuf[UDP_BATCH_CBUF_SIZE];	//!< Control messages for udpfromto.
+} udp_batch_entry_t;
+
+struct fr_udp_batch_s {
+	unsigned int		num;			//!< Maximum number of packets in a batch.
+	size_t			max_packet_size;	//!< Largest packet we can queue for sending.
+
+	struct mmsghdr		*recv;			//!< Headers for recvmmsg().
+	udp_batch_entry_t	*recv_entry;		//!< Addresses etc. of received packets.
+	unsigned int		recv_count;		//!< Packets returned by the last call to recvmmsg().
+	unsigned int		recv_next;		//!< Next packet to give to the caller.
+	fr_time_t		recv_time;		//!< When recvmmsg() returned.
+
+	struct sockaddr_storage	local;			//!< The address the socket is bound to.
+	socklen_t		local_len;		//!< 0 if we haven't looked yet.
+
+	struct mmsghdr		*send;			//!< Headers for sendmmsg().
+	udp_batch_entry_t	*send_entry;		//!< Addresses etc. of queued packets.
+	uint8_t			*send_buffer;		//!< Copies of the queued packets.
+	unsigned int		send_count;		//!< Number of queued packets.
+};
+
+/** Allocate a structure for receiving and sending multiple packets per system call
+ *
+ * @param[in] ctx		to allocate the batch in.
+ * @param[in] num		maximum number of packets to receive, or to queue
+ *				for sending, with one system call.
+ * @param[in] max_packet_size	largest packet which can be queued for sending.
+ * @return
+ *	- NULL on error.
+ *	- a new batch structure on success.
+ */
+fr_udp_batch_t *udp_batch_alloc(TALLOC_CTX *ctx, unsigned int num, size_t max_packet_size)
+{
+	fr_udp_batch_t *batch;
+
+	if (!num) num = 1;
+
+	batch = talloc_zero(ctx, fr_udp_batch_t);
+	if (!batch) {
+	oom:
+		fr_strerror_printf("Out of memory");
+		talloc_free(batch);
+		return NULL;
+	}
+
+	batch->num = num;
+	batch->max_packet_size = max_packet_size;
+
+	batch->recv = talloc_zero_array(batch, struct mmsghdr, num);
+	if (!batch->recv) goto oom;
+
+	batch->recv_entry = talloc_zero_array(batch, udp_batch_entry_t, num);
+	if (!batch->recv_entry) goto oom;
+
+	batch->send = talloc_zero_array(batch, struct mmsghdr, num);
+	if (!batch->send) goto oom;
+
+	batch->send_entry = talloc_zero_array(batch, udp_batch_entry_t, num);
+	if (!batch->send_entry) goto oom;
+
+	batch->send_buffer = talloc_array(batch, uint8_t, num * max_packet_size);
+	if (!batch->send_buffer) goto oom;
+
+	return batch;
+}
+
+/** Read one UDP packet, receiving many at once where possible
+ *
+ * The first call reads as many packets as will fit into the buffer
+ * with one call to recvmmsg().  Each packet is placed at a multiple
+ * of "stride" bytes from the start of the buffer, so that the caller
+ * can use the buffer in place.
+ *
+ * Nothing here copies the packets, but the caller has to keep the
+ * rest of the batch where it is.  e.g. the network side reserves
+ * exactly "leftover" bytes for the next message, so that its ring
+ * buffer never moves them, even when it wraps.
+ *
+ * The first packet is returned, and "leftover" is set to the number
+ * of bytes in the buffer which follow that packet's slot.  The
+ * caller should then consume "stride" bytes of the buffer, and call
+ * this function again with the remaining data at the start of the
+ * buffer, and the same "leftover" value.  The next packet will then
+ * be returned without a system call.
+ *
+ * When "leftover" is zero, the batch is complete, and the next call
+ * will read from the socket.
+ *
+ * @note This function only works for unconnected sockets.
+ *
+ * @param[in] batch		as allocated by udp_batch_alloc().
+ * @param[in] sockfd		we're reading from.
+ * @param[in] buffer		where packets will be written.
+ * @param[in] buffer_len	length of buffer.
+ * @param[in] stride		distance between packets in the buffer.
+ * @param[in,out] leftover	bytes of unread packets in the buffer.
+ * @param[out] src_ipaddr	of the packet.
+ * @param[out] src_port		of the packet.
+ * @param[out] dst_ipaddr	of the packet.
+ * @param[out] dst_port		of the packet.
+ * @param[out] if_index		of the interface that received the packet.
+ * @param[out] when		the packet was received.
+ * @return
+ *	- > 0 on success (number of bytes in the packet).
+ *	- 0 on no data, or the packet was discarded.  "leftover" may be
+ *	  non-zero, in which case the packet's slot is still consumed.
+ *	- < 0 on failure.
+ */
+ssize_t udp_batch_recv(RECVMMSG_UNUSED fr_udp_batch_t *batch, int sockfd,
+		       uint8_t *buffer, size_t buffer_len, RECVMMSG_UNUSED size_t stride, size_t *leftover,
+		       fr_ipaddr_t *src_ipaddr, uint16_t *src_port,
+		       fr_ipaddr_t *dst_ipaddr, uint16_t *dst_port, int *if_index,
+		       fr_time_t *when)
+{
+#ifndef HAVE_RECVMMSG
+	*leftover = 0;
+	return udp_recv(sockfd, buffer, buffer_len, 0, src_ipaddr, src_port,
+			dst_ipaddr, dst_port, if_index, when);
+#else
+	struct mmsghdr		*mmsg;
+	udp_batch_entry_t	*entry;
+	unsigned int		i, slots;
+	int			received;
+	uint16_t		port;
+
+	if (when) *when = 0;
+	if (if_index) *if_index = 0;
+
+	/*
+	 *	The rest of the previous batch is in the buffer.
+	 */
+	if (*leftover) {
+		if (!fr_cond_assert(batch->recv_next < batch->recv_count)) {
+			*leftover = 0;
+			return 0;
+		}
+		goto next;
+	}
+
+	batch->recv_count = batch->recv_next = 0;
+
+	slots = buffer_len / stride;
+	if (slots > batch->num) slots = batch->num;
+	if (!slots) {
+		slots = 1;
+		stride = buffer_len;
+	}
+
+	for (i = 0; i < slots; i++) {
+		mmsg = &batch->recv[i];
+		entry = &batch->recv_entry[i];
+
+		entry->iov.iov_base = buffer + (i * stride);
+		entry->iov.iov_len = stride;
+
+		memset(&mmsg->msg_hdr, 0, sizeof(mmsg->msg_hdr));
+		mmsg->msg_hdr.msg_name = &entry->addr;
+		mmsg->msg_hdr.msg_namelen = sizeof(entry->addr);
+		mmsg->msg_hdr.msg_iov = &entry->iov;
+		mmsg->msg_hdr.msg_iovlen = 1;
+		mmsg->msg_hdr.msg_control = entry->cbuf;
+		mmsg->msg_hdr.msg_controllen = sizeof(entry->cbuf);
+		mmsg->msg_len = 0;
+	}
+
+	received = recvmmsg(sockfd, batch->recv, slots, 0, NULL);
+	if (received < 0) {
+		if ((errno == EWOULDBLOCK) || (errno == EAGAIN) || (errno == EINTR)) return 0;
+
+		fr_strerror_printf("Failed reading socket: %s", fr_syserror(errno));
+		return -1;
+	}
+	if (received == 0) return 0;
+
+	batch->recv_count = received;
+	batch->recv_time = fr_time();
+
+	/*
+	 *	recvmmsg() doesn't give us the port the packet was
+	 *	sent to, so we have to get it ourselves.
+	 */
+	if (dst_ipaddr && !batch->local_len) {
+		batch->local_len = sizeof(batch->local);
+		if (getsockname(sockfd, (struct sockaddr *) &batch->local, &batch->local_len) < 0) {
+			batch->local_len = 0;
+			fr_strerror_printf("Failed getting socket name: %s", fr_syserror(errno));
+			return -1;
+		}
+	}
+
+next:
+	i = batch->recv_next++;
+	mmsg = &batch->recv[i];
+	entry = &batch->recv_entry[i];
+
+	*leftover = (batch->recv_count - batch->recv_next) * stride;
+
+	if (fr_ipaddr_from_sockaddr(&entry->addr, mmsg->msg_hdr.msg_namelen, src_ipaddr, &port) < 0) {
+		FR_DEBUG_STRERROR_PRINTF("Unknown address family");
+		return 0;
+	}
+	*src_port = port;
+
+	if (dst_ipaddr) {
+		struct sockaddr_storage	dst;
+		socklen_t		sizeof_dst;
+
+		dst = batch->local;
+		sizeof_dst = batch->local_len;
+
+#ifdef WITH_UDPFROMTO
+		(void) udpfromto_recvmsg_parse(&mmsg->msg_hdr, (struct sockaddr *) &dst, &sizeof_dst, if_index, when);
+#endif
+
+		fr_ipaddr_from_sockaddr(&dst, sizeof_dst, dst_ipaddr, &port);
+		*dst_port = port;
+	}
+
+	if (when && !*when) *when = batch->recv_time;
+
+	return mmsg->msg_len;
+#endif
+}
+
+/** Queue a UDP packet to be sent by udp_batch_flush()
+ *
+ * The packet is copied, so the caller can free it.  If the queue is
+ * full, it is flushed first.  If the socket can't take any of the
+ * queued packets, this one isn't queued, and errno is set to
+ * EWOULDBLOCK.
+ *
+ * @note This function only works for unconnected sockets.
+ *
+ * @param[in] batch		as allocated by udp_batch_alloc().
+ * @param[in] sockfd		we're writing to.
+ * @param[in] data		pointer to data to send
+ * @param[in] data_len		length of data to send
+ * @param[in] src_ipaddr	of the packet.
+ * @param[in] src_port		of the packet.
+ * @param[in] if_index		of the packet.
+ * @param[in] dst_ipaddr	of the packet.
+ * @param[in] dst_port		of the packet.
+ * @return
+ *	- 0 on success.
+ *	- < 0 on failure.
+ */
+int udp_batch_send(fr_udp_batch_t *batch, int sockfd, void const *data, size_t data_len,
+		   UDP_UNUSED fr_ipaddr_t const *src_ipaddr, UDP_UNUSED uint16_t src_port, UDP_UNUSED int if_index,
+		   fr_ipaddr_t const *dst_ipaddr, uint16_t dst_port)
+{
+	struct mmsghdr		*mmsg;
+	udp_batch_entry_t	*entry;
+	socklen_t		sizeof_dst;
+
+	/*
+	 *	Too big for the queue.  Flush the queue so that the
+	 *	packets go out in order, and send this one directly.
+	 */
+	if (data_len > batch->max_packet_size) {
+		void *packet;
+
+		if ((udp_batch_flush(batch, sockfd) < 0) && (errno == EWOULDBLOCK)) return -1;
+
+		memcpy(&packet, &data, sizeof(packet)); /* const issues */
+
+		return (udp_send(sockfd, packet, data_len, 0,
+				 src_ipaddr, src_port, if_index, dst_ipaddr, dst_port) < 0) ? -1 : 0;
+	}
+
+	/*
+	 *	The queue is full.  Flush it, and only refuse this
+	 *	packet if the socket didn't take any of the others.
+	 *	udp_batch_flush() has already set errno.
+	 */
+	if (batch->send_count == batch->num) {
+		(void) udp_batch_flush(batch, sockfd);
+		if (batch->send_count == batch->num) return -1;
+	}
+
+	mmsg = &batch->send[batch->send_count];
+	entry = &batch->send_entry[batch->send_count];
+
+	memset(&mmsg->msg_hdr, 0, sizeof(mmsg->msg_hdr));
+	mmsg->msg_len = 0;
+
+	if (fr_ipaddr_to_sockaddr(dst_ipaddr, dst_port, &entry->addr, &sizeof_dst) < 0) return -1;
+
+#ifdef WITH_UDPFROMTO
+	/*
+	 *	And if they don't specify a source IP address, don't
+	 *	use udpfromto.
+	 */
+	if ((src_ipaddr->af != AF_UNSPEC) && (dst_ipaddr->af != AF_UNSPEC) &&
+	    !fr_ipaddr_is_inaddr_any(src_ipaddr)) {
+		struct sockaddr_storage	src;
+		socklen_t		sizeof_src;
+
+		fr_ipaddr_to_sockaddr(src_ipaddr, src_port, &src, &sizeof_src);
+
+		if (udpfromto_sendmsg_init(sockfd, &mmsg->msg_hdr, entry->cbuf, sizeof(entry->cbuf),
+					   (struct sockaddr *) &src, sizeof_src, if_index) < 0) {
+			fr_strerror_printf("Failed setting source address: %s", fr_syserror(errno));
+			return -1;
+		}
+	}
+#endif
+
+	entry->iov.iov_base = batch->send_buffer + (batch->send_count * batch->max_packet_size);
+	entry->iov.iov_len = data_len;
+	memcpy(entry->iov.iov_base, data, data_len);
+
+	mmsg->msg_hdr.msg_name = &entry->addr;
+	mmsg->msg_hdr.msg_namelen = sizeof_dst;
+	mmsg->msg_hdr.msg_iov = &entry->iov;
+	mmsg->msg_hdr.msg_iovlen = 1;
+
+	batch->send_count++;
+
+	return 0;
+}
+
+/** Move packets which haven't been sent to the front of the queue
+ *
+ * The headers point to their entry and to their slot in the send
+ * buffer, so those have to move, too.
+ */
+static void udp_batch_shift(fr_udp_batch_t *batch, unsigned int sent)
+{
+	unsigned int i;
+
+	if (!sent) return;
+
+	for (i = 0; (i + sent) < batch->send_count; i++) {
+		struct mmsghdr		*mmsg = &batch->send[i];
+		udp_batch_entry_t	*entry = &batch->send_entry[i];
+		uint8_t			*slot = batch->send_buffer + (i * batch->max_packet_size);
+
+		*mmsg = batch->send[i + sent];
+		*entry = batch->send_entry[i + sent];
+		memcpy(slot, entry->iov.iov_base, entry->iov.iov_len);
+
+		entry->iov.iov_base = slot;
+		mmsg->msg_hdr.msg_name = &entry->addr;
+		mmsg->msg_hdr.msg_iov = &entry->iov;
+		if (mmsg->msg_hdr.msg_control) mmsg->msg_hdr.msg_control = entry->cbuf;
+	}
+
+	batch->send_count -= sent;
+}
+
+/** Send all queued UDP packets
+ *
+ * Packets which get a hard error are discarded.  This is UDP, so the
+ * other end will retransmit.  If the socket buffer is full, the
+ * packets which haven't been sent stay queued, and should be flushed
+ * again when the socket is writable.
+ *
+ * @param[in] batch		as allocated by udp_batch_alloc().
+ * @param[in] sockfd		we're writing to.
+ * @return
+ *	- 0 on success.
+ *	- < 0 with errno set to EWOULDBLOCK if packets are still queued.
+ *	- < 0 if one or more packets could not be sent, and were discarded.
+ */
+int udp_batch_flush(fr_udp_batch_t *batch, int sockfd)
+{
+	unsigned int	sent = 0;
+	int		rcode = 0;
+
+	while (sent < batch->send_count) {
+		int ret;
+
+		ret = sendmmsg(sockfd, batch->send + sent, batch->send_count - sent, 0);
+		if (ret > 0) {
+			sent += ret;
+			continue;
+		}
+
+		if ((ret < 0) && (errno == EINTR)) continue;
+
+		/*
+		 *	There's no room in the socket buffer.  Keep
+		 *	the rest of the packets for the next flush.
+		 */
+		if ((ret == 0) || (errno == EWOULDBLOCK) || (errno == EAGAIN) || (errno == ENOBUFS)) {
+			udp_batch_shift(batch, sent);
+			fr_strerror_printf("udp_sendmmsg would block with %u packets queued", batch->send_count);
+			errno = EWOULDBLOCK;
+			return -1;
+		}
+
+		fr_strerror_printf("udp_sendmmsg failed: %s", fr_syserror(errno));
+		rcode = -1;
+
+		/*
+		 *	Errors are only returned for the first packet.
+		 *	Skip it, and send the rest.
+		 */
+		sent++;
+	}
+
+	batch->send_count = 0;
+
+	return rcode;
+}
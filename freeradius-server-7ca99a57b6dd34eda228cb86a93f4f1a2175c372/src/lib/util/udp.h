@@ -33,6 +33,7 @@ extern "C" {
 #  include <freeradius-devel/util/udpfromto.h>
 #endif
 #include <freeradius-devel/util/inet.h>
+#include <freeradius-devel/util/talloc.h>
 #include <freeradius-devel/util/time.h>
 
 #define UDP_FLAGS_NONE		(0)
@@ -52,6 +53,25 @@ ssize_t udp_recv(int sockfd, void *data, size_t data_len, int flags,
 		 fr_ipaddr_t *dst_ipaddr, uint16_t *dst_port, int *if_index,
 		 fr_time_t *when);
 
+/** Packets received, or queued for sending, with one system call
+ *
+ */
+typedef struct fr_udp_batch_s fr_udp_batch_t;
+
+fr_udp_batch_t *udp_batch_alloc(TALLOC_CTX *ctx, unsigned int num, size_t max_packet_size);
+
+ssize_t udp_batch_recv(fr_udp_batch_t *batch, int sockfd,
+		       uint8_t *buffer, size_t buffer_len, size_t stride, size_t *leftover,
+		       fr_ipaddr_t *src_ipaddr, uint16_t *src_port,
+		       fr_ipaddr_t *dst_ipaddr, uint16_t *dst_port, int *if_index,
+		       fr_time_t *when);
+
+int udp_batch_send(fr_udp_batch_t *batch, int sockfd, void const *data, size_t data_len,
+		   fr_ipaddr_t const *src_ipaddr, uint16_t src_port, int if_index,
+		   fr_ipaddr_t const *dst_ipaddr, uint16_t dst_port);
+
+int udp_batch_flush(fr_udp_batch_t *batch, int sockfd);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,348 @@
+#include <freeradius-devel/util/acutest.h>
+
+/*
+ *	Replace sendmmsg(), so that the tests decide how many packets
+ *	the socket takes, and can see what was sent, and in which order.
+ */
+#define sendmmsg udp_test_sendmmsg
+#include "udp.c"
+#undef sendmmsg
+
+#include <fcntl.h>
+
+#define UDP_TEST_MAX_PACKETS	(16)
+#define UDP_TEST_PACKET_SIZE	(64)
+
+static int		udp_test_room;			//!< Packets the socket takes before it's full, -1 for no limit.
+static int		udp_test_calls;			//!< Calls to sendmmsg().
+static unsigned int	udp_test_num_sent;		//!< Packets the socket has taken.
+static uint8_t		udp_test_sent[UDP_TEST_MAX_PACKETS][UDP_TEST_PACKET_SIZE];
+static size_t		udp_test_sent_len[UDP_TEST_MAX_PACKETS];
+static uint16_t		udp_test_sent_port[UDP_TEST_MAX_PACKETS];
+
+int udp_test_sendmmsg(UNUSED int sockfd, struct mmsghdr *msgvec, unsigned int vlen, UNUSED int flags)
+{
+	unsigned int i;
+
+	udp_test_calls++;
+
+	for (i = 0; i < vlen; i++) {
+		struct iovec		*iov = msgvec[i].msg_hdr.msg_iov;
+		struct sockaddr_in	*sin = msgvec[i].msg_hdr.msg_name;
+
+		if (udp_test_room == 0) break;
+		if (udp_test_room > 0) udp_test_room--;
+
+		if (!TEST_CHECK(udp_test_num_sent < UDP_TEST_MAX_PACKETS)) break;
+		if (!TEST_CHECK(iov->iov_len <= UDP_TEST_PACKET_SIZE)) break;
+
+		memcpy(udp_test_sent[udp_test_num_sent], iov->iov_base, iov->iov_len);
+		udp_test_sent_len[udp_test_num_sent] = iov->iov_len;
+		udp_test_sent_port[udp_test_num_sent] = ntohs(sin->sin_port);
+		udp_test_num_sent++;
+
+		msgvec[i].msg_len = iov->iov_len;
+	}
+
+	if (i == 0) {
+		errno = EWOULDBLOCK;
+		return -1;
+	}
+
+	return i;
+}
+
+static void udp_test_init(int room)
+{
+	udp_test_room = room;
+	udp_test_calls = 0;
+	udp_test_num_sent = 0;
+	memset(udp_test_sent, 0, sizeof(udp_test_sent));
+	memset(udp_test_sent_len, 0, sizeof(udp_test_sent_len));
+	memset(udp_test_sent_port, 0, sizeof(udp_test_sent_port));
+}
+
+/** Queue packet "n", which is "n + 1" bytes of "n", going to port 1000 + n
+ *
+ */
+static int udp_test_queue(fr_udp_batch_t *batch, uint8_t n)
+{
+	uint8_t		packet[UDP_TEST_PACKET_SIZE];
+	fr_ipaddr_t	src = { .af = AF_UNSPEC };
+	fr_ipaddr_t	dst = { .af = AF_INET, .addr.v4.s_addr = htonl(INADDR_LOOPBACK), .prefix = 32 };
+
+	memset(packet, n, sizeof(packet));
+
+	return udp_batch_send(batch, -1, packet, n + 1, &src, 0, 0, &dst, 1000 + n);
+}
+
+/** Check that the socket took packet "n" as its "i"th packet
+ *
+ */
+static void udp_test_check_sent(unsigned int i, uint8_t n)
+{
+	size_t j;
+
+	TEST_CHECK(udp_test_sent_len[i] == (size_t) (n + 1));
+	TEST_MSG("packet %u: expected length %u, got %zu", i, n + 1, udp_test_sent_len[i]);
+
+	TEST_CHECK(udp_test_sent_port[i] == 1000 + n);
+	TEST_MSG("packet %u: expected port %u, got %u", i, 1000 + n, udp_test_sent_port[i]);
+
+	for (j = 0; j < udp_test_sent_len[i]; j++) {
+		if (!TEST_CHECK(udp_test_sent[i][j] == n)) {
+			TEST_MSG("packet %u: byte %zu is %u, expected %u", i, j, udp_test_sent[i][j], n);
+			break;
+		}
+	}
+}
+
+/** Queued packets go out in the order they were queued, with one system call
+ *
+ */
+static void udp_test_flush_order(void)
+{
+	fr_udp_batch_t	*batch;
+	uint8_t		i;
+
+	udp_test_init(-1);
+
+	batch = udp_batch_alloc(NULL, 8, UDP_TEST_PACKET_SIZE);
+	TEST_CHECK(batch != NULL);
+
+	for (i = 0; i < 5; i++) TEST_CHECK(udp_test_queue(batch, i) == 0);
+	TEST_CHECK(udp_test_calls == 0);
+	TEST_CHECK(batch->send_count == 5);
+
+	TEST_CHECK(udp_batch_flush(batch, -1) == 0);
+	TEST_CHECK(udp_test_calls == 1);
+	TEST_CHECK(udp_test_num_sent == 5);
+	TEST_CHECK(batch->send_count == 0);
+
+	for (i = 0; i < 5; i++) udp_test_check_sent(i, i);
+
+	/*
+	 *	Nothing left to send.
+	 */
+	TEST_CHECK(udp_batch_flush(batch, -1) == 0);
+	TEST_CHECK(udp_test_calls == 1);
+
+	talloc_free(batch);
+}
+
+/** A partial sendmmsg() keeps the rest of the packets queued, and sends them on the next flush
+ *
+ */
+static void udp_test_flush_partial(void)
+{
+	fr_udp_batch_t	*batch;
+	uint8_t		i;
+
+	udp_test_init(2);
+
+	batch = udp_batch_alloc(NULL, 6, UDP_TEST_PACKET_SIZE);
+	TEST_CHECK(batch != NULL);
+
+	for (i = 0; i < 6; i++) TEST_CHECK(udp_test_queue(batch, i) == 0);
+
+	/*
+	 *	The socket takes two, and then reports EWOULDBLOCK.
+	 */
+	errno = 0;
+	TEST_CHECK(udp_batch_flush(batch, -1) < 0);
+	TEST_CHECK(errno == EWOULDBLOCK);
+	TEST_CHECK(udp_test_calls == 2);
+	TEST_CHECK(udp_test_num_sent == 2);
+	TEST_CHECK(batch->send_count == 4);
+	TEST_MSG("expected 4 packets queued, got %u", batch->send_count);
+
+	/*
+	 *	The socket is writable again.
+	 */
+	udp_test_room = -1;
+	TEST_CHECK(udp_batch_flush(batch, -1) == 0);
+	TEST_CHECK(udp_test_num_sent == 6);
+	TEST_CHECK(batch->send_count == 0);
+
+	for (i = 0; i < 6; i++) udp_test_check_sent(i, i);
+
+	talloc_free(batch);
+}
+
+/** Queueing into a full batch flushes it, and refuses the new packet if the socket is full
+ *
+ */
+static void udp_test_send_requeue(void)
+{
+	fr_udp_batch_t	*batch;
+	uint8_t		i;
+
+	udp_test_init(0);
+
+	batch = udp_batch_alloc(NULL, 3, UDP_TEST_PACKET_SIZE);
+	TEST_CHECK(batch != NULL);
+
+	for (i = 0; i < 3; i++) TEST_CHECK(udp_test_queue(batch, i) == 0);
+
+	/*
+	 *	The batch is full, and so is the socket.
+	 */
+	errno = 0;
+	TEST_CHECK(udp_test_queue(batch, 3) < 0);
+	TEST_CHECK(errno == EWOULDBLOCK);
+	TEST_CHECK(udp_test_num_sent == 0);
+	TEST_CHECK(batch->send_count == 3);
+
+	/*
+	 *	The socket takes one, which makes room for the
+	 *	caller to queue the packet again.
+	 */
+	udp_test_room = 1;
+	TEST_CHECK(udp_test_queue(batch, 3) == 0);
+	TEST_CHECK(udp_test_num_sent == 1);
+	TEST_CHECK(batch->send_count == 3);
+
+	udp_test_room = -1;
+	TEST_CHECK(udp_batch_flush(batch, -1) == 0);
+	TEST_CHECK(udp_test_num_sent == 4);
+
+	for (i = 0; i < 4; i++) udp_test_check_sent(i, i);
+
+	talloc_free(batch);
+}
+
+/** Packets which weren't sent move to the front of the queue, along with their data and addresses
+ *
+ */
+static void udp_test_shift(void)
+{
+	fr_udp_batch_t	*batch;
+	unsigned int	i;
+
+	udp_test_init(3);
+
+	batch = udp_batch_alloc(NULL, 5, UDP_TEST_PACKET_SIZE);
+	TEST_CHECK(batch != NULL);
+
+	for (i = 0; i < 5; i++) TEST_CHECK(udp_test_queue(batch, i) == 0);
+
+	TEST_CHECK(udp_batch_flush(batch, -1) < 0);
+	TEST_CHECK(batch->send_count == 2);
+
+	/*
+	 *	The headers have to point at their own entry and
+	 *	slot, not at the ones they were copied from.
+	 */
+	for (i = 0; i < batch->send_count; i++) {
+		struct mmsghdr		*mmsg = &batch->send[i];
+		udp_batch_entry_t	*entry = &batch->send_entry[i];
+		uint8_t			*slot = batch->send_buffer + (i * batch->max_packet_size);
+
+		TEST_CHECK(mmsg->msg_hdr.msg_name == &entry->addr);
+		TEST_CHECK(mmsg->msg_hdr.msg_iov == &entry->iov);
+		TEST_CHECK(entry->iov.iov_base == slot);
+		TEST_CHECK(entry->iov.iov_len == i + 3 + 1);
+		TEST_CHECK(slot[0] == i + 3);
+		TEST_CHECK(ntohs(((struct sockaddr_in *) &entry->addr)->sin_port) == 1000 + i + 3);
+	}
+
+	/*
+	 *	Packets queued after the shift go after the ones
+	 *	which were left over.
+	 */
+	TEST_CHECK(udp_test_queue(batch, 5) == 0);
+	TEST_CHECK(batch->send_count == 3);
+
+	udp_test_room = -1;
+	TEST_CHECK(udp_batch_flush(batch, -1) == 0);
+	TEST_CHECK(udp_test_num_sent == 6);
+
+	for (i = 0; i < 6; i++) udp_test_check_sent(i, i);
+
+	talloc_free(batch);
+}
+
+#ifdef HAVE_RECVMMSG
+/** Packets are received into consecutive slots of the caller's buffer, and handed out one at a time
+ *
+ */
+static void udp_test_recv(void)
+{
+	fr_udp_batch_t		*batch;
+	struct sockaddr_in	addr;
+	socklen_t		addr_len = sizeof(addr);
+	int			rx, tx;
+	uint8_t			buffer[4 * UDP_TEST_PACKET_SIZE];
+	uint8_t			packet[UDP_TEST_PACKET_SIZE];
+	uint8_t			*p = buffer;
+	size_t			leftover = 0;
+	ssize_t			slen;
+	unsigned int		i;
+	fr_ipaddr_t		src_ipaddr, dst_ipaddr;
+	uint16_t		src_port, dst_port;
+	int			if_index;
+	fr_time_t		when;
+
+	batch = udp_batch_alloc(NULL, 4, UDP_TEST_PACKET_SIZE);
+	TEST_CHECK(batch != NULL);
+
+	rx = socket(AF_INET, SOCK_DGRAM, 0);
+	tx = socket(AF_INET, SOCK_DGRAM, 0);
+	TEST_CHECK((rx >= 0) && (tx >= 0));
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	TEST_CHECK(bind(rx, (struct sockaddr *) &addr, sizeof(addr)) == 0);
+	TEST_CHECK(getsockname(rx, (struct sockaddr *) &addr, &addr_len) == 0);
+	TEST_CHECK(fcntl(rx, F_SETFL, O_NONBLOCK) == 0);
+
+	for (i = 0; i < 3; i++) {
+		memset(packet, i, sizeof(packet));
+		TEST_CHECK(sendto(tx, packet, i + 1, 0, (struct sockaddr *) &addr, sizeof(addr)) == (ssize_t) (i + 1));
+	}
+
+	/*
+	 *	One system call reads all three, and the caller walks
+	 *	through them by consuming one slot at a time.
+	 */
+	for (i = 0; i < 3; i++) {
+		slen = udp_batch_recv(batch, rx, p, sizeof(buffer) - (p - buffer), UDP_TEST_PACKET_SIZE, &leftover,
+				      &src_ipaddr, &src_port, &dst_ipaddr, &dst_port, &if_index, &when);
+		TEST_CHECK(slen == (ssize_t) (i + 1));
+		TEST_MSG("packet %u: expected %u bytes, got %zd", i, i + 1, slen);
+
+		TEST_CHECK(p[0] == i);
+		TEST_CHECK(leftover == (2 - i) * UDP_TEST_PACKET_SIZE);
+		TEST_MSG("packet %u: expected %u bytes leftover, got %zu", i, (2 - i) * UDP_TEST_PACKET_SIZE, leftover);
+
+		TEST_CHECK(dst_port == ntohs(addr.sin_port));
+		TEST_CHECK(when != 0);
+
+		p += UDP_TEST_PACKET_SIZE;
+	}
+	TEST_CHECK(batch->recv_count == 3);
+
+	/*
+	 *	The batch is done, and there's nothing else to read.
+	 */
+	TEST_CHECK(udp_batch_recv(batch, rx, buffer, sizeof(buffer), UDP_TEST_PACKET_SIZE, &leftover,
+				  &src_ipaddr, &src_port, &dst_ipaddr, &dst_port, &if_index, &when) == 0);
+	TEST_CHECK(leftover == 0);
+
+	close(rx);
+	close(tx);
+	talloc_free(batch);
+}
+#endif
+
+TEST_LIST = {
+	{ "udp_test_flush_order",	udp_test_flush_order	},
+	{ "udp_test_flush_partial",	udp_test_flush_partial	},
+	{ "udp_test_send_requeue",	udp_test_send_requeue	},
+	{ "udp_test_shift",		udp_test_shift		},
+#ifdef HAVE_RECVMMSG
+	{ "udp_test_recv",		udp_test_recv		},
+#endif
+	{ NULL }
+};
@@ -37,9 +37,16 @@ extern "C" {
 #include <netinet/in.h>
 #include <stddef.h>
 #include <stdlib.h>
+#include <sys/socket.h>
 
 int	udpfromto_init(int s);
 
+int	udpfromto_recvmsg_parse(struct msghdr *msgh, struct sockaddr *to, socklen_t *to_len,
+				int *if_index, fr_time_t *when);
+
+int	udpfromto_sendmsg_init(int fd, struct msghdr *msgh, void *cbuf, size_t cbuf_len,
+			       struct sockaddr *from, socklen_t from_len, int if_index);
+
 int	recvfromto(int s, void *buf, size_t len, int flags,
 	       	   struct sockaddr *from, socklen_t *fromlen,
 		   struct sockaddr *to, socklen_t *tolen,
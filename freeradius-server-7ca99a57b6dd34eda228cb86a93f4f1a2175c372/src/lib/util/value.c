@@ -380,6 +380,7 @@ static inline void fr_value_box_copy_meta(fr_value_box_t *dst, fr_value_box_t co
 
 	dst->enumv = src->enumv;
 	dst->type = src->type;
+	dst->borrowed = false;
 	dst->tainted = src->tainted;
 	dst->next = NULL;	/* copy one */
 }
@@ -3291,7 +3292,8 @@ inline void fr_value_box_clear_value(fr_value_box_t *data)
 	switch (data->type) {
 	case FR_TYPE_OCTETS:
 	case FR_TYPE_STRING:
-		talloc_free(data->datum.ptr);
+		if (!data->borrowed) talloc_free(data->datum.ptr);
+		data->borrowed = false;
 		break;
 
 	case FR_TYPE_STRUCTURAL:
@@ -3431,6 +3433,22 @@ void fr_value_box_copy_shallow(TALLOC_CTX *ctx, fr_value_box_t *dst, fr_value_bo
 
 	case FR_TYPE_STRING:
 	case FR_TYPE_OCTETS:
+		/*
+		 *	Borrowed buffers can't be referenced, so
+		 *	if the copy needs to keep the buffer alive,
+		 *	it gets its own.
+		 */
+		if (src->borrowed) {
+			if (ctx) {
+				(void) fr_value_box_copy(ctx, dst, src);
+				break;
+			}
+			dst->datum.ptr = src->datum.ptr;
+			fr_value_box_copy_meta(dst, src);
+			dst->borrowed = true;
+			break;
+		}
+
 		dst->datum.ptr = ctx ? talloc_reference(ctx, src->datum.ptr) : src->datum.ptr;
 		fr_value_box_copy_meta(dst, src);
 		break;
@@ -3450,6 +3468,11 @@ int fr_value_box_steal(TALLOC_CTX *ctx, fr_value_box_t *dst, fr_value_box_t cons
 {
 	if (!fr_cond_assert(src->type != FR_TYPE_INVALID)) return -1;
 
+	/*
+	 *	Borrowed buffers aren't ours to steal.
+	 */
+	if (src->borrowed) return fr_value_box_copy(ctx, dst, src);
+
 	switch (src->type) {
 	default:
 		return fr_value_box_copy(ctx, dst, src);
@@ -3487,6 +3510,32 @@ int fr_value_box_steal(TALLOC_CTX *ctx, fr_value_box_t *dst, fr_value_box_t cons
 	}
 }
 
+/** Give a box its own copy of a borrowed buffer
+ *
+ * Must be called before a borrowed buffer is modified.  The functions
+ * which modify buffers in place call this themselves.
+ *
+ * @param[in] ctx	to allocate the new buffer in.
+ * @param[in] vb	to give its own buffer.  If the buffer isn't
+ *			borrowed, this does nothing.
+ * @return
+ *	- 0 on success.
+ *	- -1 on failure.
+ */
+int fr_value_box_own(TALLOC_CTX *ctx, fr_value_box_t *vb)
+{
+	fr_value_box_t tmp;
+
+	if (!vb->borrowed) return 0;
+
+	if (fr_value_box_copy(ctx, &tmp, vb) < 0) return -1;
+	tmp.next = vb->next;
+
+	memcpy(vb, &tmp, sizeof(*vb));
+
+	return 0;
+}
+
 /** Copy a nul terminated string to a #fr_value_box_t
  *
  * @param[in] ctx 	to allocate any new buffers in.
@@ -3936,6 +3985,8 @@ int fr_value_box_mem_realloc(TALLOC_CTX *ctx, uint8_t **out, fr_value_box_t *dst
 
 	fr_assert(dst->type == FR_TYPE_OCTETS);
 
+	if (fr_value_box_own(ctx, dst) < 0) return -1;
+
 	memcpy(&cbin, &dst->vb_octets, sizeof(cbin));
 
 	clen = talloc_array_length(dst->vb_octets);
@@ -4059,6 +4110,26 @@ void fr_value_box_memdup_buffer_shallow(TALLOC_CTX *ctx, fr_value_box_t *dst, fr
 	dst->datum.length = talloc_array_length(src);
 }
 
+/** Assign a buffer owned by something else to a box, copying it only if it's modified
+ *
+ * The buffer isn't freed when the box is cleared.  The caller must
+ * ensure the buffer outlives the box, or call #fr_value_box_own.
+ *
+ * @param[in] dst 	to assign buffer to.
+ * @param[in] enumv	Aliases for values.
+ * @param[in] src	buffer to borrow.
+ * @param[in] len	of data in the buffer.
+ * @param[in] tainted	Whether the value came from a trusted source.
+ */
+void fr_value_box_memdup_borrowed(fr_value_box_t *dst, fr_dict_attr_t const *enumv,
+				  uint8_t const *src, size_t len, bool tainted)
+{
+	fr_value_box_init(dst, FR_TYPE_OCTETS, enumv, tainted);
+	dst->vb_octets = src;
+	dst->datum.length = len;
+	dst->borrowed = true;
+}
+
 /** Append data to an existing fr_value_box_t
  *
  * @param[in] ctx	Where to allocate any talloc buffers required.
@@ -4084,6 +4155,8 @@ int fr_value_box_mem_append(TALLOC_CTX *ctx, fr_value_box_t *dst, uint8_t const
 		return -1;
 	}
 
+	if (fr_value_box_own(ctx, dst) < 0) return -1;
+
 	memcpy(&ptr, &dst->datum.ptr, sizeof(ptr));	/* defeat const */
 	if (!fr_cond_assert(ptr)) return -1;
 
@@ -158,6 +158,9 @@ struct value_box_s {
 
 	bool				tainted;		//!< i.e. did it come from an untrusted source
 
+	bool				borrowed;		//!< Buffer belongs to someone else, e.g. a received
+								///< packet, and is copied before being modified.
+
 	fr_value_box_t			*next;			//!< Next in a series of value_box.
 };
 
@@ -624,6 +627,8 @@ void		fr_value_box_copy_shallow(TALLOC_CTX *ctx, fr_value_box_t *dst,
 					  const fr_value_box_t *src);
 
 int		fr_value_box_steal(TALLOC_CTX *ctx, fr_value_box_t *dst, fr_value_box_t const *src);
+
+int		fr_value_box_own(TALLOC_CTX *ctx, fr_value_box_t *vb);
 /** @} */
 
 /** @name Assign and manipulate binary-unsafe C strings
@@ -694,6 +699,9 @@ void		fr_value_box_memdup_shallow(fr_value_box_t *dst, fr_dict_attr_t const *enu
 void		fr_value_box_memdup_buffer_shallow(TALLOC_CTX *ctx, fr_value_box_t *dst, fr_dict_attr_t const *enumv,
 						   uint8_t const *src, bool tainted);
 
+void		fr_value_box_memdup_borrowed(fr_value_box_t *dst, fr_dict_attr_t const *enumv,
+					     uint8_t const *src, size_t len, bool tainted);
+
 int		fr_value_box_mem_append(TALLOC_CTX *ctx, fr_value_box_t *dst,
 				       uint8_t const *src, size_t len, bool tainted);
 
@@ -67,6 +67,7 @@ static int mod_decode(UNUSED void const *instance, REQUEST *request, uint8_t *co
 {
 //	proto_arp_t const	*inst = talloc_get_type_abort_const(instance, proto_arp_t);
 	fr_arp_packet_t	const	*arp;
+	VALUE_PAIR		*vps = NULL;
 
 	/*
 	 *	Set the request dictionary so that we can do
@@ -75,10 +76,12 @@ static int mod_decode(UNUSED void const *instance, REQUEST *request, uint8_t *co
 	 */
 	request->dict = dict_arp;
 
-	if (fr_arp_decode(request->packet, data, data_len, &request->packet->vps) < 0) {
+	if (fr_arp_decode(request->packet, data, data_len, &vps) < 0) {
 		RPEDEBUG("Failed decoding packet");
+		fr_pair_list_free(&vps);
 		return -1;
 	}
+	fr_pair_list_append(&request->packet->vps, vps);
 
 	arp = (fr_arp_packet_t const *) data;
 	request->packet->code = (arp->op[0] << 8) | arp->op[1];
@@ -95,7 +98,7 @@ static int mod_decode(UNUSED void const *instance, REQUEST *request, uint8_t *co
 		       fr_arp_packet_codes[request->packet->code],
 		       request->async->listen->name);
 
-		log_request_pair_list(L_DBG_LVL_1, request, request->packet->vps, "");
+		log_request_pair_list(L_DBG_LVL_1, request, fr_pair_list_head(&request->packet->vps), "");
 	}
 
 	return 0;
@@ -127,7 +130,7 @@ static ssize_t mod_encode(void const *instance, REQUEST *request, uint8_t *buffe
 		return 1;
 	}
 
-	slen = fr_arp_encode(buffer, buffer_len, request->packet->data, request->reply->vps);
+	slen = fr_arp_encode(buffer, buffer_len, request->packet->data, fr_pair_list_head(&request->reply->vps));
 	if (slen <= 0) {
 		RPEDEBUG("Failed encoding reply");
 		return -1;
@@ -146,7 +149,7 @@ static ssize_t mod_encode(void const *instance, REQUEST *request, uint8_t *buffe
 		       request->reply->code,
 		       request->async->listen->name);
 
-		log_request_pair_list(L_DBG_LVL_1, request, request->reply->vps, "");
+		log_request_pair_list(L_DBG_LVL_1, request, fr_pair_list_head(&request->reply->vps), "");
 	}
 
 	return slen;
@@ -72,7 +72,7 @@ static rlm_rcode_t mod_process(UNUSED module_ctx_t const *mctx, REQUEST *request
 	case REQUEST_INIT:
 		if (request->parent && RDEBUG_ENABLED) {
 			RDEBUG("Received ARP %s", fr_arp_packet_codes[request->packet->code]);
-			log_request_pair_list(L_DBG_LVL_1, request, request->packet->vps, "");
+			log_request_pair_list(L_DBG_LVL_1, request, fr_pair_list_head(&request->packet->vps), "");
 		}
 
 		request->component = "arp";
@@ -109,7 +109,7 @@ static rlm_rcode_t mod_process(UNUSED module_ctx_t const *mctx, REQUEST *request
 		 *	Allow the admin to explicitly set the reply
 		 *	type.
 		 */
-		vp = fr_pair_find_by_da(request->reply->vps, attr_arp_operation, TAG_ANY);
+		vp = fr_pair_list_find_by_da(&request->reply->vps, attr_arp_operation, TAG_ANY);
 		if (vp) {
 			request->reply->code = vp->vp_uint8;
 		} else switch (rcode) {
@@ -205,7 +205,7 @@ static rlm_rcode_t mod_process(UNUSED module_ctx_t const *mctx, REQUEST *request
 
 		if (request->parent && RDEBUG_ENABLED) {
 			RDEBUG("Sending %s", fr_arp_packet_codes[request->reply->code]);
-			log_request_pair_list(L_DBG_LVL_1, request, request->reply->vps, "");
+			log_request_pair_list(L_DBG_LVL_1, request, fr_pair_list_head(&request->reply->vps), "");
 		}
 		break;
 
@@ -24,6 +24,7 @@
  */
 #include <freeradius-devel/server/base.h>
 #include <freeradius-devel/radius/radius.h>
+#include <freeradius-devel/internal/spool.h>
 #include <freeradius-devel/io/listen.h>
 #include <freeradius-devel/io/schedule.h>
 #include <freeradius-devel/io/application.h>
@@ -45,6 +46,12 @@ static int transport_parse(TALLOC_CTX *ctx, void *out, UNUSED void *parent, CONF
 #define MPRINT(x, ...)
 #endif
 
+static fr_table_num_sorted_t const proto_detail_format_table[] = {
+	{ L("detail"),	PROTO_DETAIL_FORMAT_TEXT	},
+	{ L("spool"),	PROTO_DETAIL_FORMAT_SPOOL	}
+};
+static size_t proto_detail_format_table_len = NUM_ELEMENTS(proto_detail_format_table);
+
 /** How to parse a Detail listen section
  *
  */
@@ -56,6 +63,11 @@ static CONF_PARSER const proto_detail_config[] = {
 	{ FR_CONF_OFFSET("transport", FR_TYPE_VOID, proto_detail_t, io_submodule),
 	  .func = transport_parse },
 
+	{ FR_CONF_OFFSET("format", FR_TYPE_UINT32, proto_detail_t, format),
+	  .func = cf_table_parse_uint32,
+	  .uctx = &(cf_table_parse_ctx_t){ .table = proto_detail_format_table, .len = &proto_detail_format_table_len },
+	  .dflt = "detail" },
+
 	/*
 	 *	Add this as a synonym so normal humans can understand it.
 	 */
@@ -230,6 +242,75 @@ static int transport_parse(TALLOC_CTX *ctx, void *out, UNUSED void *parent,
 	return dl_module_instance(ctx, out, transport_cs, parent_inst, name, DL_MODULE_TYPE_SUBMODULE);
 }
 
+/** Set the original src/dst ip/port, and protocol from a decoded attribute
+ *
+ */
+static int decode_packet_fields(REQUEST *request, VALUE_PAIR *vp)
+{
+	if ((vp->da == attr_packet_src_ip_address) ||
+	    (vp->da == attr_packet_src_ipv6_address)) {
+		request->packet->src_ipaddr = vp->vp_ip;
+	} else if ((vp->da == attr_packet_dst_ip_address) ||
+		   (vp->da == attr_packet_dst_ipv6_address)) {
+		request->packet->dst_ipaddr = vp->vp_ip;
+	} else if (vp->da == attr_packet_src_port) {
+		request->packet->src_port = vp->vp_uint16;
+	} else if (vp->da == attr_packet_dst_port) {
+		request->packet->dst_port = vp->vp_uint16;
+	} else if (vp->da == attr_protocol) {
+		request->dict = fr_dict_by_protocol_num(vp->vp_uint32);
+		if (!request->dict) {
+			REDEBUG("Invalid protocol: %pP", vp);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/** Decode a binary spool record
+ *
+ * The attributes are already in the internal format, so there's no
+ * tokenizing to do.
+ */
+static int decode_spool(REQUEST *request, uint8_t const *data, size_t data_len)
+{
+	fr_spool_record_t	record;
+	VALUE_PAIR		*head = NULL, *vp;
+	fr_cursor_t		cursor;
+
+	fr_cursor_init(&cursor, &head);
+	if (fr_spool_record_decode(request->packet, &cursor, &record, data, data_len) < 0) {
+		RPEDEBUG("Malformed spool record");
+		return -1;
+	}
+
+	request->dict = record.dict;
+
+	for (vp = fr_cursor_head(&cursor);
+	     vp;
+	     vp = fr_cursor_next(&cursor)) {
+		if (decode_packet_fields(request, vp) < 0) {
+			fr_pair_list_free(&head);
+			return -1;
+		}
+	}
+
+	/*
+	 *	The original time at which we received the packet.
+	 */
+	vp = fr_pair_afrom_da(request->packet, attr_packet_original_timestamp);
+	if (vp) {
+		vp->vp_date = record.timestamp;
+		vp->type = VT_DATA;
+		fr_cursor_append(&cursor, vp);
+	}
+
+	fr_pair_list_append(&request->packet->vps, head);
+
+	return 0;
+}
+
 /** Decode the packet, and set the request->process function
  *
  */
@@ -257,6 +338,11 @@ static int mod_decode(void const *instance, REQUEST *request, uint8_t *const dat
 	request->reply->src_ipaddr = request->packet->src_ipaddr;
 	request->reply->dst_ipaddr = request->packet->src_ipaddr;
 
+	if (inst->format == PROTO_DETAIL_FORMAT_SPOOL) {
+		if (decode_spool(request, data, data_len) < 0) return -1;
+		goto done;
+	}
+
 	end = data + data_len;
 
 	MPRINT("HEADER %s", data);
@@ -274,7 +360,7 @@ static int mod_decode(void const *instance, REQUEST *request, uint8_t *const dat
 	}
 
 	lineno = 1;
-	fr_cursor_init(&cursor, &request->packet->vps);
+	fr_pair_list_cursor_init(&cursor, &request->packet->vps);
 	fr_cursor_tail(&cursor);	/* Ensure we only free what we add on error */
 
 	/*
@@ -351,31 +437,14 @@ static int mod_decode(void const *instance, REQUEST *request, uint8_t *const dat
 		/*
 		 *	Set the original src/dst ip/port
 		 */
-		if (vp) {
-			if ((vp->da == attr_packet_src_ip_address) ||
-			    (vp->da == attr_packet_src_ipv6_address)) {
-				request->packet->src_ipaddr = vp->vp_ip;
-			} else if ((vp->da == attr_packet_dst_ip_address) ||
-				   (vp->da == attr_packet_dst_ipv6_address)) {
-				request->packet->dst_ipaddr = vp->vp_ip;
-			} else if (vp->da == attr_packet_src_port) {
-				request->packet->src_port = vp->vp_uint16;
-			} else if (vp->da == attr_packet_dst_port) {
-				request->packet->dst_port = vp->vp_uint16;
-			} else if (vp->da == attr_protocol) {
-				request->dict = fr_dict_by_protocol_num(vp->vp_uint32);
-				if (!request->dict) {
-					REDEBUG("Invalid protocol: %pP", vp);
-					goto error;
-				}
-			}
-		}
+		if (vp && (decode_packet_fields(request, vp) < 0)) goto error;
 
 	next:
 		lineno++;
 		while ((p < end) && (*p)) p++;
 	}
 
+done:
 	/*
 	 *	Let the app_io take care of populating additional fields in the request
 	 */
@@ -38,6 +38,14 @@ typedef struct {
 	fr_dict_attr_t const		*attr_packet_type;
 } proto_detail_process_t;
 
+/*
+ *	What kind of files we're reading.
+ */
+typedef enum {
+	PROTO_DETAIL_FORMAT_TEXT = 0,					//!< text detail files
+	PROTO_DETAIL_FORMAT_SPOOL					//!< binary spool files
+} proto_detail_format_t;
+
 typedef struct {
 	CONF_SECTION			*server_cs;			//!< server CS for this listener
 	CONF_SECTION			*cs;				//!< my configuration
@@ -64,6 +72,7 @@ typedef struct {
 	dl_module_inst_t			*type_submodule;		//!< Instance of the type
 
 	uint32_t			code;				//!< packet code to use for incoming packets
+	uint32_t			format;				//!< proto_detail_format_t of the files
 	uint32_t			max_packet_size;		//!< for message ring buffer
 	uint32_t			num_messages;			//!< for message ring buffer
 	uint32_t			priority;			//!< for packet processing, larger == higher
@@ -88,6 +97,7 @@ struct proto_detail_work_s {
 	char const			*filename_work;		//!< work file name
 
 	uint32_t			poll_interval;		//!< interval between polling
+	bool				inotify;		//!< use inotify to discover new files
 
 	fr_retry_config_t		retry_config;		//!< retry config with irt, mrt, etc.
 	uint32_t			max_outstanding;	//!< number of packets to run in parallel
@@ -95,12 +105,22 @@ struct proto_detail_work_s {
 	bool				track_progress;		//!< do we track progress by writing?
 	bool				retransmit;		//!< are we retransmitting on error?
 	bool				immediate;		//!< start reading the detail files immediately
+	bool				mmap;			//!< read the work file through a memory mapping
 
 	int				mode;			//!< O_RDWR or O_RDONLY
 
 	RADCLIENT			*client;		//!< so the rest of the server doesn't complain
 };
 
+/*
+ *	Location of one entry in a memory mapped detail file.
+ */
+typedef struct {
+	off_t				offset;			//!< start of the entry
+	size_t				len;			//!< length of the entry, including the trailing blank line
+	off_t				done_offset;		//!< where to write "Done", or 0
+} proto_detail_index_t;
+
 typedef struct proto_detail_work_thread_s proto_detail_work_thread_t;
 
 struct proto_detail_work_thread_s {
@@ -139,6 +159,19 @@ struct proto_detail_work_thread_s {
 
 	fr_event_timer_t const		*ev;			//!< for detail file timers.
 
+	uint8_t				*map;			//!< memory mapped work file
+	size_t				map_size;		//!< size of the mapping
+	proto_detail_index_t		*index;			//!< entries found ahead of the reader
+	uint32_t			index_head;		//!< next entry to read
+	uint32_t			index_tail;		//!< one past the last indexed entry
+	off_t				index_offset;		//!< where the next indexing pass starts
+	fr_dlist_head_t			inflight;		//!< outstanding entries, in file order
+	off_t				released;		//!< mapping before this offset has been released
+
+	int				inotify_fd;		//!< for discovering new files
+	uint32_t			poll_interval;		//!< interval between polling, which may be
+								///< set if inotify couldn't be used.
+
 	pthread_mutex_t			worker_mutex;		//!< for the workers
 	int				num_workers;		//!< number of workers
 };
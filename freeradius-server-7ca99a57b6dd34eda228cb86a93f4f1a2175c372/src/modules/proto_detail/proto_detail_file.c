@@ -49,6 +49,17 @@
 #error proto_detail_file requires <glob.h>
 #endif
 
+#ifdef __linux__
+#include <fnmatch.h>
+#include <sys/inotify.h>
+
+/*
+ *	How often we look for new files when inotify was wanted
+ *	instead of polling, but couldn't be set up.
+ */
+#define DETAIL_FILE_POLL_INTERVAL	(5)
+#endif
+
 DIAG_OFF(unused-macros)
 #if 0
 /*
@@ -81,6 +92,8 @@ static const CONF_PARSER file_listen_config[] = {
 
 	{ FR_CONF_OFFSET("poll_interval", FR_TYPE_UINT32, proto_detail_file_t, poll_interval), .dflt = "5" },
 
+	{ FR_CONF_OFFSET("inotify", FR_TYPE_BOOL, proto_detail_file_t, inotify), .dflt = "no" },
+
 	{ FR_CONF_OFFSET("immediate", FR_TYPE_BOOL, proto_detail_file_t, immediate) },
 
 	CONF_PARSER_TERMINATOR
@@ -130,7 +143,7 @@ static int mod_open(fr_listen_t *li)
 	proto_detail_file_t const  *inst = talloc_get_type_abort_const(li->app_io_instance, proto_detail_file_t);
 	proto_detail_file_thread_t *thread = talloc_get_type_abort(li->thread_instance, proto_detail_file_thread_t);
 
-	if (inst->poll_interval == 0) {
+	if ((inst->poll_interval == 0) && !inst->inotify) {
 		int oflag;
 
 #ifdef O_EVTONLY
@@ -150,6 +163,8 @@ static int mod_open(fr_listen_t *li)
 	thread->inst = inst;
 	thread->name = talloc_typed_asprintf(thread, "detail_file polling for files matching %s", inst->filename);
 	thread->vnode_fd = -1;
+	thread->inotify_fd = -1;
+	thread->poll_interval = inst->poll_interval;
 	pthread_mutex_init(&thread->worker_mutex, NULL);
 
 	return 0;
@@ -340,12 +355,15 @@ static int work_exists(proto_detail_file_thread_t *thread, int fd)
 
 	/*
 	 *	Don't do anything until the file has been deleted.
+	 *	With inotify, the directory watch tells us about
+	 *	that.
 	 *
 	 *	@todo - ensure that proto_detail_work is done the file...
 	 *	maybe by creating a new instance?
 	 */
-	if (fr_event_filter_insert(thread, NULL, thread->el, fd, FR_EVENT_FILTER_VNODE,
-				   &funcs, NULL, thread) < 0) {
+	if ((thread->inotify_fd < 0) &&
+	    (fr_event_filter_insert(thread, NULL, thread->el, fd, FR_EVENT_FILTER_VNODE,
+				    &funcs, NULL, thread) < 0)) {
 		PERROR("Failed adding work socket to event loop");
 		close(fd);
 		talloc_free(li);
@@ -389,7 +407,8 @@ static int work_exists(proto_detail_file_thread_t *thread, int fd)
 
 	if (!fr_schedule_listen_add(inst->parent->sc, li)) {
 	error:
-		if (fr_event_fd_delete(thread->el, thread->vnode_fd, FR_EVENT_FILTER_VNODE) < 0) {
+		if ((thread->inotify_fd < 0) &&
+		    (fr_event_fd_delete(thread->el, thread->vnode_fd, FR_EVENT_FILTER_VNODE) < 0)) {
 			PERROR("Failed removing DELETE callback when opening work file");
 		}
 		close(thread->vnode_fd);
@@ -506,16 +525,16 @@ retry:
 		 *	Wait for the directory to change before
 		 *	looking for another "detail" file.
 		 */
-		if (!inst->poll_interval) return;
+		if (!thread->poll_interval) return;
 
 delay:
 		/*
 		 *	Check every N seconds.
 		 */
-		DEBUG3("Waiting %d.000000s for new files in %s", inst->poll_interval, thread->name);
+		DEBUG3("Waiting %d.000000s for new files in %s", thread->poll_interval, thread->name);
 
 		if (fr_event_timer_in(thread, thread->el, &thread->ev,
-				      fr_time_delta_from_sec(inst->poll_interval), work_retry_timer, thread) < 0) {
+				      fr_time_delta_from_sec(thread->poll_interval), work_retry_timer, thread) < 0) {
 			ERROR("Failed inserting poll timer for %s", inst->filename_work);
 		}
 		return;
@@ -544,6 +563,131 @@ delay:
 }
 
 
+#ifdef __linux__
+/** Handle inotify events for the detail file directory
+ *
+ * Unlike kqueue VNODE notifications, inotify tells us which file
+ * changed.  So we only look for work when a file matching our
+ * wildcard is created, or the work file is deleted.
+ */
+static void mod_inotify_read(UNUSED fr_event_list_t *el, int fd, UNUSED int flags, void *uctx)
+{
+	proto_detail_file_thread_t	*thread = talloc_get_type_abort(uctx, proto_detail_file_thread_t);
+	proto_detail_file_t const	*inst = thread->inst;
+	char				buffer[4096] CC_HINT(aligned(__alignof__(struct inotify_event)));
+	char const			*pattern, *work;
+	bool				created = false, deleted = false;
+
+	pattern = strrchr(inst->filename, '/') + 1;
+	work = strrchr(inst->filename_work, '/');
+	work = work ? work + 1 : inst->filename_work;
+
+	for (;;) {
+		struct inotify_event const	*ev;
+		char const			*p;
+		ssize_t				len;
+
+		len = read(fd, buffer, sizeof(buffer));
+		if (len < 0) {
+			if (errno == EINTR) continue;
+			if (errno != EAGAIN) ERROR("proto_detail (%s): Failed reading inotify events: %s",
+						   thread->name, fr_syserror(errno));
+			break;
+		}
+		if (len == 0) break;
+
+		for (p = buffer; p < buffer + len; p += sizeof(*ev) + ev->len) {
+			ev = (struct inotify_event const *) p;
+
+			/*
+			 *	We've missed events, so look for work.
+			 */
+			if (ev->mask & IN_Q_OVERFLOW) {
+				created = true;
+				continue;
+			}
+
+			if (!ev->len) continue;
+
+			if (strcmp(ev->name, work) == 0) {
+				if (ev->mask & (IN_DELETE | IN_MOVED_FROM)) deleted = true;
+				continue;
+			}
+
+			if ((ev->mask & (IN_CREATE | IN_MOVED_TO | IN_CLOSE_WRITE)) &&
+			    (fnmatch(pattern, ev->name, 0) == 0)) {
+				MPRINT("proto_detail (%s): Found new file %s", thread->name, ev->name);
+				created = true;
+			}
+		}
+	}
+
+	if (deleted && (thread->vnode_fd >= 0)) {
+		DEBUG("proto_detail (%s): Deleted %s", thread->name, inst->filename_work);
+		close(thread->vnode_fd);
+		thread->vnode_fd = -1;
+		created = true;
+	}
+
+	/*
+	 *	Still processing a file.  We'll look for more when
+	 *	it's deleted.
+	 */
+	if (!created || (thread->vnode_fd >= 0)) return;
+
+	if (thread->ev) fr_event_timer_delete(&thread->ev);
+
+	work_init(thread);
+}
+
+/** Watch the detail file directory with inotify
+ *
+ */
+static int mod_inotify_init(proto_detail_file_thread_t *thread)
+{
+	proto_detail_file_t const	*inst = thread->inst;
+	char				*work_dir, *p;
+
+	thread->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (thread->inotify_fd < 0) {
+		fr_strerror_printf("Failed creating inotify instance: %s", fr_syserror(errno));
+		return -1;
+	}
+
+	if (inotify_add_watch(thread->inotify_fd, inst->directory,
+			      IN_CREATE | IN_MOVED_TO | IN_CLOSE_WRITE | IN_DELETE | IN_MOVED_FROM) < 0) {
+		fr_strerror_printf("Failed watching %s: %s", inst->directory, fr_syserror(errno));
+	error:
+		close(thread->inotify_fd);
+		thread->inotify_fd = -1;
+		return -1;
+	}
+
+	/*
+	 *	The work file may be somewhere else.
+	 */
+	MEM(work_dir = talloc_strdup(NULL, inst->filename_work));
+	p = strrchr(work_dir, '/');
+	if (p) {
+		*p = '\0';
+		if ((strcmp(work_dir, inst->directory) != 0) &&
+		    (inotify_add_watch(thread->inotify_fd, work_dir, IN_DELETE | IN_MOVED_FROM) < 0)) {
+			fr_strerror_printf("Failed watching %s: %s", work_dir, fr_syserror(errno));
+			talloc_free(work_dir);
+			goto error;
+		}
+	}
+	talloc_free(work_dir);
+
+	if (fr_event_fd_insert(thread, thread->el, thread->inotify_fd, mod_inotify_read, NULL, NULL, thread) < 0) {
+		fr_strerror_printf_push("Failed adding inotify instance to event loop");
+		goto error;
+	}
+
+	return 0;
+}
+#endif
+
 /** Set the event list for a new IO instance
  *
  * @param[in] li the listener
@@ -557,6 +701,17 @@ static void mod_event_list_set(fr_listen_t *li, fr_event_list_t *el, UNUSED void
 
 	thread->el = el;
 
+#ifdef __linux__
+	/*
+	 *	Without inotify, nothing tells us about new files
+	 *	when poll_interval is 0, so we have to poll.
+	 */
+	if (inst->inotify && (mod_inotify_init(thread) < 0)) {
+		if (!thread->poll_interval) thread->poll_interval = DETAIL_FILE_POLL_INTERVAL;
+		PERROR("proto_detail (%s): Falling back to polling every %us", thread->name, thread->poll_interval);
+	}
+#endif
+
 	if (inst->immediate) {
 		work_init(thread);
 		return;
@@ -625,6 +780,11 @@ static int mod_bootstrap(void *instance, CONF_SECTION *cs)
 	 *	Linux inotify works.  So we allow poll_interval==0
 	 */
 	FR_INTEGER_BOUND_CHECK("poll_interval", inst->poll_interval, >=, 1);
+
+	if (inst->inotify) {
+		cf_log_err(cs, "'inotify' is only supported on Linux");
+		return -1;
+	}
 #endif
 	FR_INTEGER_BOUND_CHECK("poll_interval", inst->poll_interval, <=, 3600);
 
@@ -670,7 +830,7 @@ static int mod_close(fr_listen_t *li)
 	if (thread->vnode_fd >= 0) {
 		if (thread->nr) {
 			(void) fr_network_socket_delete(thread->nr, inst->parent->listen);
-		} else {
+		} else if (thread->inotify_fd < 0) {
 			if (fr_event_fd_delete(thread->el, thread->vnode_fd, FR_EVENT_FILTER_VNODE) < 0) {
 				PERROR("Failed removing DELETE callback on detach");
 			}
@@ -681,6 +841,12 @@ static int mod_close(fr_listen_t *li)
 		pthread_mutex_destroy(&thread->worker_mutex);
 	}
 
+	if (thread->inotify_fd >= 0) {
+		(void) fr_event_fd_delete(thread->el, thread->inotify_fd, FR_EVENT_FILTER_IO);
+		close(thread->inotify_fd);
+		thread->inotify_fd = -1;
+	}
+
 	return 0;
 }
 
@@ -0,0 +1,153 @@
+#include <freeradius-devel/util/acutest.h>
+#include <freeradius-devel/util/dict_test.h>
+
+#include "proto_detail.c"
+
+static TALLOC_CTX		*autofree;
+static fr_dict_t		*dict_internal;
+static fr_dict_t		*dict_radius;
+static fr_dict_attr_t const	*attr_user_name;
+
+/** Load the dictionaries, and resolve the attributes proto_detail uses
+ *
+ */
+static void test_init(void)
+{
+	if (autofree) return;
+
+	autofree = talloc_autofree_context();
+	fr_dict_test_init(autofree, "proto_detail_tests", &dict_internal, &dict_radius, "radius");
+
+	if ((fr_dict_autoload(proto_detail_dict) < 0) ||
+	    (fr_dict_attr_autoload(proto_detail_dict_attr) < 0)) {
+		fr_perror("proto_detail_tests");
+		exit(EXIT_FAILURE);
+	}
+
+	attr_user_name = fr_dict_attr_by_name(dict_radius, "User-Name");
+	if (!attr_user_name) {
+		fprintf(stderr, "proto_detail_tests: Missing attributes in the dictionaries\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+static void test_pair_add(VALUE_PAIR **head, fr_dict_attr_t const *da, char const *value)
+{
+	VALUE_PAIR *vp;
+
+	vp = fr_pair_afrom_da(autofree, da);
+	TEST_ASSERT(vp != NULL);
+	TEST_CHECK(fr_pair_value_from_str(vp, value, -1, '\0', false) == 0);
+	TEST_MSG("%s = %s: %s", da->name, value, fr_strerror());
+	fr_pair_add(head, vp);
+}
+
+/** Write a spool record for a packet received from 192.0.2.1 by 192.0.2.2
+ *
+ */
+static ssize_t test_spool_record(uint8_t *buffer, size_t buffer_len)
+{
+	fr_spool_record_t	record = {
+					.code = 4,
+					.dict = dict_radius,
+					.timestamp = fr_unix_time_from_sec(1600000000)
+				};
+	VALUE_PAIR		*head = NULL;
+	fr_cursor_t		cursor;
+	ssize_t			slen;
+
+	test_pair_add(&head, attr_user_name, "bob");
+	test_pair_add(&head, attr_packet_src_ip_address, "192.0.2.1");
+	test_pair_add(&head, attr_packet_src_port, "49152");
+	test_pair_add(&head, attr_packet_dst_ip_address, "192.0.2.2");
+	test_pair_add(&head, attr_packet_dst_port, "1813");
+
+	fr_cursor_init(&cursor, &head);
+	slen = fr_spool_record_encode(buffer, buffer_len, &record, &cursor, NULL, NULL);
+	fr_pair_list_free(&head);
+
+	return slen;
+}
+
+static REQUEST *test_request_alloc(void)
+{
+	REQUEST *request;
+
+	request = request_local_alloc(autofree);
+	request->packet = fr_radius_alloc(request, false);
+	request->packet->src_ipaddr.af = AF_INET;
+	request->packet->src_ipaddr.addr.v4.s_addr = htonl(INADDR_NONE);
+	request->packet->dst_ipaddr = request->packet->src_ipaddr;
+
+	return request;
+}
+
+static void proto_detail_test_spool_replay(void)
+{
+	uint8_t		buffer[1024];
+	ssize_t		slen;
+	REQUEST		*request;
+	VALUE_PAIR	*vp;
+
+	test_init();
+
+	slen = test_spool_record(buffer, sizeof(buffer));
+	TEST_ASSERT(slen > 0);
+
+	request = test_request_alloc();
+	TEST_CHECK(decode_spool(request, buffer, slen) == 0);
+	TEST_MSG("%s", fr_strerror());
+	TEST_CHECK(request->dict == dict_radius);
+
+	TEST_CASE("Packet addresses and ports are restored");
+	TEST_CHECK(request->packet->src_ipaddr.af == AF_INET);
+	TEST_CHECK(request->packet->src_ipaddr.addr.v4.s_addr == htonl(0xc0000201));
+	TEST_CHECK(request->packet->src_port == 49152);
+	TEST_CHECK(request->packet->dst_ipaddr.af == AF_INET);
+	TEST_CHECK(request->packet->dst_ipaddr.addr.v4.s_addr == htonl(0xc0000202));
+	TEST_CHECK(request->packet->dst_port == 1813);
+
+	TEST_CASE("Attributes are added to the request");
+	vp = fr_pair_list_find_by_da(&request->packet->vps, attr_user_name, TAG_ANY);
+	TEST_ASSERT(vp != NULL);
+	TEST_CHECK(strcmp(vp->vp_strvalue, "bob") == 0);
+
+	vp = fr_pair_list_find_by_da(&request->packet->vps, attr_packet_original_timestamp, TAG_ANY);
+	TEST_ASSERT(vp != NULL);
+	TEST_CHECK(vp->vp_date == fr_unix_time_from_sec(1600000000));
+
+	talloc_free(request);
+}
+
+static void proto_detail_test_spool_malformed(void)
+{
+	uint8_t		buffer[1024];
+	ssize_t		slen;
+	REQUEST		*request;
+
+	test_init();
+
+	slen = test_spool_record(buffer, sizeof(buffer));
+	TEST_ASSERT(slen > 0);
+
+	/*
+	 *	Flip a bit in the payload, so the checksum fails.
+	 */
+	buffer[FR_SPOOL_HDR_LEN + 3] ^= 0x01;
+
+	request = test_request_alloc();
+	TEST_CHECK(decode_spool(request, buffer, slen) < 0);
+
+	TEST_CASE("Nothing is added to the request");
+	TEST_CHECK(fr_pair_list_head(&request->packet->vps) == NULL);
+	TEST_CHECK(request->packet->src_ipaddr.addr.v4.s_addr == htonl(INADDR_NONE));
+	TEST_CHECK(request->packet->src_port == 0);
+
+	talloc_free(request);
+}
+
+TEST_LIST = {
+	{ "proto_detail_test_spool_replay",	proto_detail_test_spool_replay		},
+	{ "proto_detail_test_spool_malformed",	proto_detail_test_spool_malformed	},
+	{ NULL }
+};
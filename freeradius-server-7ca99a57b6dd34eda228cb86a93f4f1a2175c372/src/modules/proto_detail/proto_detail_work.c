@@ -29,12 +29,14 @@
 #include <freeradius-devel/io/base.h>
 #include <freeradius-devel/io/application.h>
 #include <freeradius-devel/io/listen.h>
+#include <freeradius-devel/internal/spool.h>
 #include <freeradius-devel/util/dlist.h>
 #include <freeradius-devel/util/time.h>
 #include <freeradius-devel/util/debug.h>
 #include "proto_detail.h"
 
 #include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 
 #ifndef NDEBUG
@@ -65,8 +67,14 @@ typedef struct {
 	fr_retry_t			retry;			//!< our retry timers
 	fr_event_timer_t const		*ev;			//!< retransmission timer
 	fr_dlist_t			entry;			//!< for the retransmission list
+
+	off_t				offset;			//!< start of the entry in a mapped file
+	fr_dlist_t			inflight_entry;		//!< for the list of outstanding entries
 } fr_detail_entry_t;
 
+#define DETAIL_INDEX_MIN	(64)			//!< fewest entries we index ahead of the reader
+#define DETAIL_RELEASE_CHUNK	(1 << 20)		//!< release the mapping in chunks of this size
+
 static CONF_PARSER limit_config[] = {
 	{ FR_CONF_OFFSET("initial_rtx_time", FR_TYPE_TIME_DELTA, proto_detail_work_t, retry_config.irt), .dflt = STRINGIFY(2) },
 	{ FR_CONF_OFFSET("max_rtx_time", FR_TYPE_TIME_DELTA, proto_detail_work_t, retry_config.mrt), .dflt = STRINGIFY(16) },
@@ -91,6 +99,8 @@ static const CONF_PARSER file_listen_config[] = {
 
 	{ FR_CONF_OFFSET("retransmit", FR_TYPE_BOOL, proto_detail_work_t, retransmit ), .dflt = "yes" },
 
+	{ FR_CONF_OFFSET("mmap", FR_TYPE_BOOL, proto_detail_work_t, mmap ), .dflt = "no" },
+
 	{ FR_CONF_POINTER("limit", FR_TYPE_SUBSECTION, NULL), .subcs = (void const *) limit_config },
 	CONF_PARSER_TERMINATOR
 };
@@ -145,6 +155,333 @@ static fr_event_update_t resume_read[] = {
 	{ 0 }
 };
 
+/** Find the boundaries of the next batch of entries in a mapped file
+ *
+ * Entries which have already been marked "Done", and entries which
+ * are too large, are skipped here, so the reader never sees them.
+ */
+static int work_index(proto_detail_work_t const *inst, proto_detail_work_thread_t *thread)
+{
+	uint8_t const			*end = thread->map + thread->map_size;
+	uint32_t			max = talloc_array_length(thread->index);
+
+	thread->index_head = thread->index_tail = 0;
+
+	while ((thread->index_tail < max) && ((size_t) thread->index_offset < thread->map_size)) {
+		uint8_t const	*record = thread->map + thread->index_offset;
+		uint8_t const	*p = record;
+		off_t		done_offset = 0;
+		bool		done = false;
+		size_t		len;
+
+		/*
+		 *	Find the end of the entry, which is a blank
+		 *	line, or EOF.  Every line after the header
+		 *	MUST start with a tab, and contain " = ".
+		 */
+		while (p < end) {
+			uint8_t const *q, *line;
+
+			q = memchr(p, '\n', end - p);
+			if (!q || ((q + 1) == end)) {
+				p = end;
+				break;
+			}
+
+			if (q[1] == '\n') {
+				p = q + 2;
+				break;
+			}
+
+			if (q[1] != '\t') {
+				ERROR("proto_detail (%s): Malformed line found at offset %zu in file %s",
+				      thread->name, (size_t) (q - thread->map), thread->filename_work);
+				return -1;
+			}
+
+			line = q + 2;
+			if (((end - (q + 1)) >= 5) && (memcmp(q + 1, "\tDone", 5) == 0)) {
+				done = true;
+
+			} else if (((end - (q + 1)) > 10) && (memcmp(q + 1, "\tTimestamp", 10) == 0)) {
+				done_offset = line - thread->map;
+			}
+
+			p = line;
+			while ((p < end) && !isspace(*p)) p++;
+			if (((end - p) >= 3) && (memcmp(p, " = ", 3) != 0)) {
+				ERROR("proto_detail (%s): Malformed line found at offset %zu in file %s",
+				      thread->name, (size_t) (line - thread->map), thread->filename_work);
+				return -1;
+			}
+		}
+
+		len = p - record;
+
+		if (done) {
+			MPRINT("Skipping done entry at offset %zu", (size_t) thread->index_offset);
+
+		} else if (len > inst->parent->max_packet_size) {
+			DEBUG("Ignoring 'too large' entry at offset %zu of %s",
+			      (size_t) thread->index_offset, thread->filename_work);
+			DEBUG("Entry size %zu is greater than allowed maximum %u",
+			      len, inst->parent->max_packet_size);
+
+		} else {
+			thread->index[thread->index_tail++] = (proto_detail_index_t) {
+				.offset = thread->index_offset,
+				.len = len,
+				.done_offset = done_offset
+			};
+		}
+
+		thread->index_offset += len;
+	}
+
+	MPRINT("Indexed %u entries, up to offset %zu", thread->index_tail, (size_t) thread->index_offset);
+
+	return 0;
+}
+
+/** Release the part of the mapping before the oldest outstanding entry
+ *
+ * Entries are read in file order, but may finish in any order.  The
+ * oldest outstanding entry marks how far we've got through the file.
+ */
+static void work_progress(proto_detail_work_thread_t *thread)
+{
+	fr_detail_entry_t	*oldest;
+	off_t			progress, release;
+
+	oldest = fr_dlist_head(&thread->inflight);
+	progress = oldest ? oldest->offset : thread->header_offset;
+
+	release = progress - (progress % DETAIL_RELEASE_CHUNK);
+	if (release <= thread->released) return;
+
+	MPRINT("Releasing mapping up to offset %zu", (size_t) release);
+
+	(void) madvise(thread->map + thread->released, release - thread->released, MADV_DONTNEED);
+	thread->released = release;
+}
+
+/** Copy the next entry out of a mapped file
+ *
+ */
+static ssize_t work_read_mmap(proto_detail_work_t const *inst, proto_detail_work_thread_t *thread,
+			      void **packet_ctx, fr_time_t *recv_time_p, uint8_t *buffer, uint32_t *priority)
+{
+	proto_detail_index_t const	*idx;
+	fr_detail_entry_t		*track;
+	uint8_t				*p, *end;
+
+	if ((thread->index_head == thread->index_tail) && (work_index(inst, thread) < 0)) return -1;
+
+	/*
+	 *	Nothing left to read.  If nothing is outstanding
+	 *	either, then every entry in the file was already
+	 *	done, and we can close it now.
+	 */
+	if (thread->index_head == thread->index_tail) {
+		thread->closing = true;
+		(void) lseek(thread->fd, 0, SEEK_END);
+
+		if (!thread->outstanding) {
+			DEBUG("%s - No more entries to process", thread->name);
+			return -1;
+		}
+		return 0;
+	}
+
+	idx = &thread->index[thread->index_head++];
+
+	/*
+	 *	The decoder wants each line to be terminated by a
+	 *	zero byte.
+	 */
+	memcpy(buffer, thread->map + idx->offset, idx->len);
+	end = buffer + idx->len;
+	for (p = buffer; (p = memchr(p, '\n', end - p)) != NULL; p++) *p = '\0';
+
+	track = talloc_zero(thread, fr_detail_entry_t);
+	track->parent = thread;
+	track->timestamp = fr_time();
+	track->id = thread->count++;
+	track->offset = idx->offset;
+	track->done_offset = idx->done_offset;
+	if (inst->retransmit) {
+		track->packet = talloc_memdup(track, buffer, idx->len);
+		track->packet_len = idx->len;
+	}
+	fr_dlist_insert_tail(&thread->inflight, track);
+
+	thread->header_offset = idx->offset + idx->len;
+
+	/*
+	 *	That was the last entry.  Close the file once all of
+	 *	the outstanding entries are done.
+	 */
+	if ((thread->index_head == thread->index_tail) && ((size_t) thread->index_offset >= thread->map_size)) {
+		thread->closing = true;
+	}
+
+	thread->outstanding++;
+
+	if (!thread->paused && (thread->outstanding >= inst->max_outstanding)) {
+		(void) fr_event_filter_update(thread->el, thread->fd, FR_EVENT_FILTER_IO, pause_read);
+		thread->paused = true;
+	}
+
+	*packet_ctx = track;
+	*recv_time_p = track->timestamp;
+	*priority = inst->parent->priority;
+
+	MPRINT("Returning NUM %u - offset %zu", thread->outstanding, (size_t) idx->offset);
+	return idx->len;
+}
+
+/** Read from the work file, or from its mapping
+ *
+ */
+static ssize_t work_pread(proto_detail_work_thread_t *thread, uint8_t *buffer, size_t len, off_t offset)
+{
+	if (thread->map) {
+		if ((size_t) offset >= thread->map_size) return 0;
+		if (len > (thread->map_size - offset)) len = thread->map_size - offset;
+
+		memcpy(buffer, thread->map + offset, len);
+		return len;
+	}
+
+	return pread(thread->fd, buffer, len, offset);
+}
+
+/** Read the next record from a binary spool file
+ *
+ * Records are length prefixed, so there's no searching for the end
+ * of the record.  Records which are already done are skipped, and
+ * damaged data is skipped by looking for the next record header.
+ */
+static ssize_t work_read_spool(proto_detail_work_t const *inst, proto_detail_work_thread_t *thread,
+			       void **packet_ctx, fr_time_t *recv_time_p, uint8_t *buffer, size_t buffer_len,
+			       uint32_t *priority)
+{
+	fr_detail_entry_t		*track;
+	ssize_t				data_size, record_len, skip;
+
+redo:
+	data_size = work_pread(thread, buffer, buffer_len, thread->read_offset);
+	if (data_size < 0) {
+		ERROR("proto_detail (%s): Failed reading file %s: %s",
+		      thread->name, thread->filename_work, fr_syserror(errno));
+		return -1;
+	}
+
+	record_len = fr_spool_record_length(buffer, data_size);
+	if (record_len < 0) {
+		skip = fr_spool_record_sync(buffer, data_size);
+		PERROR("proto_detail (%s): Skipping %zd bytes of damaged data at offset %zu of file %s",
+		       thread->name, skip, (size_t) thread->read_offset, thread->filename_work);
+		thread->read_offset += skip;
+		goto redo;
+	}
+
+	if (record_len == 0) {
+		/*
+		 *	The header is fine, but the record doesn't
+		 *	fit into the buffer.
+		 */
+		if ((size_t) data_size == buffer_len) {
+			uint8_t	next[FR_SPOOL_HDR_LEN + 1];
+			ssize_t	next_len;
+
+			record_len = FR_SPOOL_HDR_LEN + fr_net_to_uint32(buffer + 4);
+
+			/*
+			 *	Nothing has checked the length, so
+			 *	only believe it if another record, or
+			 *	the end of the file, is where it says
+			 *	the record ends.  Read from the last
+			 *	byte of the record, so that ending at
+			 *	EOF and ending past EOF look different.
+			 */
+			next_len = work_pread(thread, next, sizeof(next), thread->read_offset + record_len - 1);
+			if ((next_len > 0) && fr_spool_record_boundary(next + 1, next_len - 1)) goto too_large;
+
+			skip = fr_spool_record_sync(buffer, data_size);
+			ERROR("proto_detail (%s): Record at offset %zu of file %s has an invalid length %zd, "
+			      "skipping %zd bytes", thread->name, (size_t) thread->read_offset, thread->filename_work,
+			      record_len, skip);
+			thread->read_offset += skip;
+			goto redo;
+		}
+
+		/*
+		 *	Nothing left, or a partial record from a
+		 *	writer which didn't finish.  Close the file
+		 *	once all of the outstanding entries are done.
+		 */
+		if (data_size > 0) {
+			WARN("proto_detail (%s): Ignoring truncated record at offset %zu of file %s",
+			     thread->name, (size_t) thread->read_offset, thread->filename_work);
+		}
+
+		thread->closing = true;
+		thread->read_offset = lseek(thread->fd, 0, SEEK_END);
+
+		if (!thread->outstanding) {
+			DEBUG("%s - No more entries to process", thread->name);
+			return -1;
+		}
+		return 0;
+	}
+
+	if (buffer[FR_SPOOL_FLAGS_OFFSET] & FR_SPOOL_FLAG_DONE) {
+		MPRINT("Skipping done record at offset %zu", (size_t) thread->read_offset);
+		thread->read_offset += record_len;
+		goto redo;
+	}
+
+	if ((size_t) record_len > inst->parent->max_packet_size) {
+	too_large:
+		DEBUG("Ignoring 'too large' entry at offset %zu of %s",
+		      (size_t) thread->read_offset, thread->filename_work);
+		DEBUG("Entry size %zd is greater than allowed maximum %u",
+		      record_len, inst->parent->max_packet_size);
+		thread->read_offset += record_len;
+		goto redo;
+	}
+
+	track = talloc_zero(thread, fr_detail_entry_t);
+	track->parent = thread;
+	track->timestamp = fr_time();
+	track->id = thread->count++;
+	track->offset = thread->read_offset;
+	track->done_offset = thread->read_offset + FR_SPOOL_FLAGS_OFFSET;
+	if (inst->retransmit) {
+		track->packet = talloc_memdup(track, buffer, record_len);
+		track->packet_len = record_len;
+	}
+	if (thread->map) fr_dlist_insert_tail(&thread->inflight, track);
+
+	thread->read_offset += record_len;
+	thread->header_offset = thread->read_offset;
+
+	thread->outstanding++;
+
+	if (!thread->paused && (thread->outstanding >= inst->max_outstanding)) {
+		(void) fr_event_filter_update(thread->el, thread->fd, FR_EVENT_FILTER_IO, pause_read);
+		thread->paused = true;
+	}
+
+	*packet_ctx = track;
+	*recv_time_p = track->timestamp;
+	*priority = inst->parent->priority;
+
+	MPRINT("Returning NUM %u - offset %zu", thread->outstanding, (size_t) track->offset);
+	return record_len;
+}
+
 static ssize_t mod_read(fr_listen_t *li, void **packet_ctx, fr_time_t *recv_time_p, uint8_t *buffer, size_t buffer_len, size_t *leftover, uint32_t *priority, UNUSED bool *is_dup)
 {
 	proto_detail_work_t const	*inst = talloc_get_type_abort_const(li->app_io_instance, proto_detail_work_t);
@@ -198,7 +535,10 @@ static ssize_t mod_read(fr_listen_t *li, void **packet_ctx, fr_time_t *recv_time
 	 *	without locking it first.  So too bad for them.
 	 */
 	if (thread->closing) {
-		if (inst->track_progress) thread->read_offset = lseek(thread->fd, 0, SEEK_END);
+		if (inst->track_progress || thread->map ||
+		    (inst->parent->format == PROTO_DETAIL_FORMAT_SPOOL)) {
+			thread->read_offset = lseek(thread->fd, 0, SEEK_END);
+		}
 		return 0;
 	}
 
@@ -212,6 +552,12 @@ static ssize_t mod_read(fr_listen_t *li, void **packet_ctx, fr_time_t *recv_time
 		return 0;
 	}
 
+	if (inst->parent->format == PROTO_DETAIL_FORMAT_SPOOL) {
+		return work_read_spool(inst, thread, packet_ctx, recv_time_p, buffer, buffer_len, priority);
+	}
+
+	if (thread->map) return work_read_mmap(inst, thread, packet_ctx, recv_time_p, buffer, priority);
+
 	/*
 	 *	If we've cached leftover data from the ring buffer,
 	 *	copy it back.
@@ -631,16 +977,33 @@ static ssize_t mod_write(fr_listen_t *li, void *packet_ctx, UNUSED fr_time_t req
 		 *	Seek to the entry, mark it as done, and then seek to
 		 *	the point in the file where we were reading from.
 		 */
-		(void) lseek(thread->fd, track->done_offset, SEEK_SET);
-		if (write(thread->fd, "Done", 4) < 0) {
-			ERROR("%s - Failed marking entry as done: %s", thread->name, fr_syserror(errno));
+		if (inst->parent->format == PROTO_DETAIL_FORMAT_SPOOL) {
+			uint8_t flags = FR_SPOOL_FLAG_DONE;
+
+			if (pwrite(thread->fd, &flags, 1, track->done_offset) < 0) {
+				ERROR("%s - Failed marking entry as done: %s", thread->name, fr_syserror(errno));
+			}
+		} else if (thread->map) {
+			if (pwrite(thread->fd, "Done", 4, track->done_offset) < 0) {
+				ERROR("%s - Failed marking entry as done: %s", thread->name, fr_syserror(errno));
+			}
+		} else {
+			(void) lseek(thread->fd, track->done_offset, SEEK_SET);
+			if (write(thread->fd, "Done", 4) < 0) {
+				ERROR("%s - Failed marking entry as done: %s", thread->name, fr_syserror(errno));
+			}
+			(void) lseek(thread->fd, thread->read_offset, SEEK_SET);
 		}
-		(void) lseek(thread->fd, thread->read_offset, SEEK_SET);
 	}
 
 free_track:
 	thread->outstanding--;
 
+	if (thread->map) {
+		fr_dlist_remove(&thread->inflight, track);
+		work_progress(thread);
+	}
+
 	/*
 	 *	If we need to read some more packet, let's do so.
 	 */
@@ -716,6 +1079,37 @@ static int mod_open(fr_listen_t *li)
 		thread->file_size = 1;
 	}
 
+	/*
+	 *	Map the whole file.  Empty files are read the usual
+	 *	way, as there is nothing to map.
+	 */
+	if (inst->mmap) {
+		struct stat buf;
+
+		if (fstat(thread->fd, &buf) < 0) {
+			cf_log_err(inst->cs, "Failed examining %s: %s", thread->filename_work, fr_syserror(errno));
+			return -1;
+		}
+
+		if (buf.st_size > 0) {
+			void *map;
+
+			map = mmap(NULL, buf.st_size, PROT_READ, MAP_SHARED, thread->fd, 0);
+			if (map == MAP_FAILED) {
+				cf_log_err(inst->cs, "Failed mapping %s: %s", thread->filename_work, fr_syserror(errno));
+				return -1;
+			}
+			(void) madvise(map, buf.st_size, MADV_SEQUENTIAL);
+
+			thread->map = map;
+			thread->map_size = thread->file_size = buf.st_size;
+			MEM(thread->index = talloc_array(thread, proto_detail_index_t,
+							 (inst->max_outstanding * 2) > DETAIL_INDEX_MIN ?
+							 (inst->max_outstanding * 2) : DETAIL_INDEX_MIN));
+			fr_dlist_init(&thread->inflight, fr_detail_entry_t, inflight_entry);
+		}
+	}
+
 	fr_assert(thread->name == NULL);
 	fr_assert(thread->filename_work != NULL);
 	thread->name = talloc_typed_asprintf(thread, "detail_work from filename %s", thread->filename_work);
@@ -746,6 +1140,11 @@ static int mod_close_internal(proto_detail_work_thread_t *thread)
 
 	unlink(thread->filename_work);
 
+	if (thread->map) {
+		(void) munmap(thread->map, thread->map_size);
+		thread->map = NULL;
+	}
+
 	close(thread->fd);
 	thread->fd = -1;
 
@@ -877,7 +1276,17 @@ static int mod_bootstrap(void *instance, CONF_SECTION *cs)
 	}
 
 	FR_INTEGER_BOUND_CHECK("limit.maximum_outstanding", inst->max_outstanding, >=, 1);
-	FR_INTEGER_BOUND_CHECK("limit.maximum_outstanding", inst->max_outstanding, <=, 256);
+
+	/*
+	 *	Reading from a mapped file doesn't need to re-read
+	 *	the file for each entry, so we can have many more
+	 *	entries in flight.
+	 */
+	if (inst->mmap) {
+		FR_INTEGER_BOUND_CHECK("limit.maximum_outstanding", inst->max_outstanding, <=, 65536);
+	} else {
+		FR_INTEGER_BOUND_CHECK("limit.maximum_outstanding", inst->max_outstanding, <=, 256);
+	}
 
 	return 0;
 }
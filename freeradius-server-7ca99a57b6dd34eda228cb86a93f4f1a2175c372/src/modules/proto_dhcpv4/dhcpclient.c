@@ -145,7 +145,7 @@ static RADIUS_PACKET *request_init(char const *filename)
 {
 	FILE *fp;
 	fr_cursor_t cursor;
-	VALUE_PAIR *vp;
+	VALUE_PAIR *vp, *vps = NULL;
 	bool filedone = false;
 	RADIUS_PACKET *packet;
 
@@ -167,17 +167,18 @@ static RADIUS_PACKET *request_init(char const *filename)
 	/*
 	 *	Read the VP's.
 	 */
-	if (fr_pair_list_afrom_file(packet, dict_dhcpv4, &packet->vps, fp, &filedone) < 0) {
+	if (fr_pair_list_afrom_file(packet, dict_dhcpv4, &vps, fp, &filedone) < 0) {
 		fr_perror("dhcpclient");
 		fr_radius_packet_free(&packet);
 		if (fp && (fp != stdin)) fclose(fp);
 		return NULL;
 	}
+	fr_pair_list_append(&packet->vps, vps);
 
 	/*
 	 *	Fix / set various options
 	 */
-	for (vp = fr_cursor_init(&cursor, &packet->vps);
+	for (vp = fr_pair_list_cursor_init(&cursor, &packet->vps);
 	     vp;
 	     vp = fr_cursor_next(&cursor)) {
 
@@ -350,24 +351,27 @@ static RADIUS_PACKET *fr_dhcpv4_recv_raw_loop(int lsockfd,
 		}
 
 		if (reply) {
+			VALUE_PAIR *vps = NULL;
+
 			nb_reply ++;
 
 			if (fr_debug_lvl) print_hex(reply);
 
-			if (fr_dhcpv4_decode(reply, reply->data, reply->data_len, &reply->vps, &reply->code) < 0) {
+			if (fr_dhcpv4_decode(reply, reply->data, reply->data_len, &vps, &reply->code) < 0) {
 				ERROR("Failed decoding reply");
 				return NULL;
 			}
+			fr_pair_list_append(&reply->vps, vps);
 
 			if (!found) found = reply;
 
 			if (reply->code == FR_DHCP_OFFER) {
-				VALUE_PAIR *vp1 = fr_pair_find_by_da(reply->vps,
-								     attr_dhcp_dhcp_server_identifier,
-								     TAG_ANY);
-				VALUE_PAIR *vp2 = fr_pair_find_by_da(reply->vps,
-								     attr_dhcp_your_ip_address,
-								     TAG_ANY);
+				VALUE_PAIR *vp1 = fr_pair_list_find_by_da(&reply->vps,
+									  attr_dhcp_dhcp_server_identifier,
+									  TAG_ANY);
+				VALUE_PAIR *vp2 = fr_pair_list_find_by_da(&reply->vps,
+									  attr_dhcp_your_ip_address,
+									  TAG_ANY);
 
 				if (vp1 && vp2) {
 					nb_offer++;
@@ -584,7 +588,7 @@ static void dhcp_packet_debug(RADIUS_PACKET *packet, bool received)
 #endif
 	       packet->data_len);
 
-	for (vp = fr_cursor_init(&cursor, &packet->vps);
+	for (vp = fr_pair_list_cursor_init(&cursor, &packet->vps);
 	     vp;
 	     vp = fr_cursor_next(&cursor)) {
 		VP_VERIFY(vp);
@@ -609,6 +613,7 @@ int main(int argc, char **argv)
 
 	RADIUS_PACKET		*packet = NULL;
 	RADIUS_PACKET		*reply = NULL;
+	VALUE_PAIR		*vps = NULL;
 
 	TALLOC_CTX		*autofree;
 
@@ -743,7 +748,7 @@ int main(int argc, char **argv)
 	}
 
 	packet = request_init(filename);
-	if (!packet || !packet->vps) {
+	if (!packet || !fr_pair_list_head(&packet->vps)) {
 		ERROR("Nothing to send");
 		fr_exit(EXIT_FAILURE);
 	}
@@ -785,7 +790,8 @@ int main(int argc, char **argv)
 	 *	Decode to produce VALUE_PAIRs from the default field
 	 */
 	if (fr_debug_lvl) {
-		fr_dhcpv4_decode(packet, packet->data, packet->data_len, &packet->vps, &packet->code);
+		fr_dhcpv4_decode(packet, packet->data, packet->data_len, &vps, &packet->code);
+		fr_pair_list_append(&packet->vps, vps);
 		dhcp_packet_debug(packet, false);
 	}
 
@@ -799,10 +805,12 @@ int main(int argc, char **argv)
 	}
 
 	if (reply) {
-		if (fr_dhcpv4_decode(reply, reply->data, reply->data_len, &reply->vps, &reply->code) < 0) {
+		vps = NULL;
+		if (fr_dhcpv4_decode(reply, reply->data, reply->data_len, &vps, &reply->code) < 0) {
 			ERROR("Failed decoding packet");
 			ret = -1;
 		}
+		fr_pair_list_append(&reply->vps, vps);
 		dhcp_packet_debug(reply, true);
 	}
 
@@ -249,6 +249,7 @@ static int mod_decode(void const *instance, REQUEST *request, uint8_t *const dat
 	fr_io_address_t const *address = track->address;
 	RADCLIENT const *client;
 	RADIUS_PACKET *packet = request->packet;
+	VALUE_PAIR *vps = NULL;
 
 	/*
 	 *	Set the request dictionary so that we can do
@@ -276,10 +277,12 @@ static int mod_decode(void const *instance, REQUEST *request, uint8_t *const dat
 	 *	That MUST be set and checked in the underlying
 	 *	transport, via a call to fr_dhcpv4_ok().
 	 */
-	if (fr_dhcpv4_decode(packet, packet->data, packet->data_len, &packet->vps, &packet->code) < 0) {
+	if (fr_dhcpv4_decode(packet, packet->data, packet->data_len, &vps, &packet->code) < 0) {
 		RPEDEBUG("Failed decoding packet");
+		fr_pair_list_free(&vps);
 		return -1;
 	}
+	fr_pair_list_append(&packet->vps, vps);
 
 	/*
 	 *	Set the rest of the fields.
@@ -397,7 +400,7 @@ static ssize_t mod_encode(void const *instance, REQUEST *request, uint8_t *buffe
 	}
 
 	data_len = fr_dhcpv4_encode(buffer, buffer_len, original, request->reply->code,
-				    ntohl(original->xid), request->reply->vps);
+				    ntohl(original->xid), fr_pair_list_head(&request->reply->vps));
 	if (data_len < 0) {
 		RPEDEBUG("Failed encoding DHCPV4 reply");
 		return -1;
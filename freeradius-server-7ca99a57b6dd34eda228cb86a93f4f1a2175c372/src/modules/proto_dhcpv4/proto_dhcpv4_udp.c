@@ -45,6 +45,8 @@ typedef struct {
 
 	fr_io_address_t			*connection;		//!< for connected sockets.
 
+	fr_udp_batch_t			*batch;			//!< for reading and writing many packets at once.
+
 	fr_stats_t			stats;			//!< statistics for this socket
 }  proto_dhcpv4_udp_thread_t;
 
@@ -63,6 +65,12 @@ typedef struct {
 	uint32_t			max_packet_size;	//!< for message ring buffer.
 	uint32_t			max_attributes;		//!< Limit maximum decodable attributes.
 
+	uint32_t			batch;			//!< How many packets to read or write per system call.
+
+	uint32_t			num_sockets;		//!< How many sockets to open on this address.
+	uint32_t			steering;		//!< a fr_socket_steer_t, how the kernel
+								//!< spreads packets across the sockets.
+
 	uint16_t			port;			//!< Port to listen on.
 
 	bool				broadcast;		//!< whether we listen for broadcast packets
@@ -108,6 +116,13 @@ static const CONF_PARSER udp_listen_config[] = {
 	{ FR_CONF_OFFSET("max_packet_size", FR_TYPE_UINT32, proto_dhcpv4_udp_t, max_packet_size), .dflt = "4096" } ,
        	{ FR_CONF_OFFSET("max_attributes", FR_TYPE_UINT32, proto_dhcpv4_udp_t, max_attributes), .dflt = STRINGIFY(DHCPV4_MAX_ATTRIBUTES) } ,
 
+	{ FR_CONF_OFFSET("batch", FR_TYPE_UINT32, proto_dhcpv4_udp_t, batch), .dflt = "0" } ,
+
+	{ FR_CONF_OFFSET("num_sockets", FR_TYPE_UINT32, proto_dhcpv4_udp_t, num_sockets), .dflt = "1" } ,
+	{ FR_CONF_OFFSET("steering", FR_TYPE_UINT32, proto_dhcpv4_udp_t, steering), .dflt = "flow",
+	  .func = cf_table_parse_uint32,
+	  .uctx = &(cf_table_parse_ctx_t){ .table = fr_socket_steer_table, .len = &fr_socket_steer_table_len } },
+
 	CONF_PARSER_TERMINATOR
 };
 
@@ -141,8 +156,6 @@ static ssize_t mod_read(fr_listen_t *li, void **packet_ctx, fr_time_t *recv_time
 	uint32_t			xid, ipaddr;
 	dhcp_packet_t			*packet;
 
-	*leftover = 0;		/* always for UDP */
-
 	/*
 	 *	Where the addresses should go.  This is a special case
 	 *	for proto_dhcpv4.
@@ -150,6 +163,22 @@ static ssize_t mod_read(fr_listen_t *li, void **packet_ctx, fr_time_t *recv_time
 	address_p = (fr_io_address_t **) packet_ctx;
 	address = *address_p;
 
+	/*
+	 *	Read many packets at once, and let the network side
+	 *	walk through them.  "leftover" is the rest of the
+	 *	batch.
+	 */
+	if (thread->batch && !thread->connection) {
+		data_size = udp_batch_recv(thread->batch, thread->sockfd,
+					   buffer, buffer_len, li->default_message_size, leftover,
+					   &address->src_ipaddr, &address->src_port,
+					   &address->dst_ipaddr, &address->dst_port,
+					   &address->if_index, recv_time_p);
+		goto check;
+	}
+
+	*leftover = 0;		/* always for UDP */
+
 	/*
 	 *      Tell udp_recv if we're connected or not.
 	 */
@@ -159,6 +188,8 @@ static ssize_t mod_read(fr_listen_t *li, void **packet_ctx, fr_time_t *recv_time
 			     &address->src_ipaddr, &address->src_port,
 			     &address->dst_ipaddr, &address->dst_port,
 			     &address->if_index, recv_time_p);
+
+check:
 	if (data_size < 0) {
 		DEBUG2("proto_dhvpv4_udp got read error %zd: %s", data_size, fr_strerror());
 		return data_size;
@@ -169,6 +200,16 @@ static ssize_t mod_read(fr_listen_t *li, void **packet_ctx, fr_time_t *recv_time
 		return 0;
 	}
 
+	/*
+	 *	Broadcast packets are delivered to every socket on
+	 *	this address.  Only the first socket processes them,
+	 *	so that they are answered once.
+	 */
+	if (li->shard && (address->dst_ipaddr.addr.v4.s_addr == htonl(INADDR_BROADCAST))) {
+		DEBUG3("proto_dhcpv4_udp ignoring broadcast packet on socket %u", li->shard);
+		return 0;
+	}
+
 	/*
 	 *	@todo - make this take "&packet_len", as the DHCPv4
 	 *	packet may be smaller than the parent UDP packet.
@@ -475,6 +516,18 @@ static ssize_t mod_write(fr_listen_t *li, void *packet_ctx, UNUSED fr_time_t req
 	}
 
 send_reply:
+	/*
+	 *	Queue the reply for mod_flush().
+	 */
+	if (thread->batch && !flags) {
+		if (udp_batch_send(thread->batch, thread->sockfd, buffer, buffer_len,
+				   &address.src_ipaddr, address.src_port,
+				   address.if_index,
+				   &address.dst_ipaddr, address.dst_port) < 0) return -1;
+
+		return buffer_len;
+	}
+
 	/*
 	 *	proto_dhcpv4 takes care of suppressing do-not-respond, etc.
 	 */
@@ -492,6 +545,33 @@ send_reply:
 }
 
 
+/** Send all of the replies which mod_write() has queued
+ *
+ * @return
+ *	- 0 on success, or if the replies which failed were discarded.
+ *	- < 0 with errno set to EWOULDBLOCK if replies are still queued.
+ */
+static int mod_flush(fr_listen_t *li)
+{
+	proto_dhcpv4_udp_thread_t	*thread = talloc_get_type_abort(li->thread_instance, proto_dhcpv4_udp_thread_t);
+
+	if (!thread->batch) return 0;
+
+	if (udp_batch_flush(thread->batch, thread->sockfd) < 0) {
+		/*
+		 *	The replies are still queued.  Tell the
+		 *	network side to call us again when the
+		 *	socket is writable.
+		 */
+		if (errno == EWOULDBLOCK) return -1;
+
+		RATE_LIMIT_GLOBAL(PERROR, "proto_dhcpv4_udp failed sending replies");
+	}
+
+	return 0;
+}
+
+
 static int mod_connection_set(fr_listen_t *li, fr_io_address_t *connection)
 {
 	proto_dhcpv4_udp_thread_t	*thread = talloc_get_type_abort(li->thread_instance, proto_dhcpv4_udp_thread_t);
@@ -562,8 +642,37 @@ static int mod_open(fr_listen_t *li)
 		goto error;
 	}
 
+	/*
+	 *	The master opens the other sockets which share this
+	 *	address.  The steering program is for the whole
+	 *	group, so only the first socket sets it.
+	 */
+	if (!li->connected && (li->shard == 0)) {
+		li->num_shards = inst->num_sockets;
+
+		if (fr_socket_server_steer(sockfd, inst->ipaddr.af, inst->steering, inst->num_sockets) < 0) {
+			close(sockfd);
+			PERROR("Failed setting packet steering");
+			goto error;
+		}
+	}
+
 	thread->sockfd = sockfd;
 
+	/*
+	 *	Connected sockets get one packet at a time.
+	 */
+	if ((inst->batch > 1) && !li->connected) {
+		thread->batch = udp_batch_alloc(thread, inst->batch, inst->max_packet_size);
+		if (!thread->batch) {
+			close(sockfd);
+			PERROR("Failed allocating batch");
+			goto error;
+		}
+
+		li->read_batch = inst->batch;
+	}
+
 	fr_assert((cf_parent(inst->cs) != NULL) && (cf_parent(cf_parent(inst->cs)) != NULL));	/* listen { ... } */
 
 	thread->name = fr_app_io_socket_name(thread, &proto_dhcpv4_udp,
@@ -717,6 +826,11 @@ static int mod_bootstrap(void *instance, CONF_SECTION *cs)
 	FR_INTEGER_BOUND_CHECK("max_packet_size", inst->max_packet_size, >=, MIN_PACKET_SIZE);
 	FR_INTEGER_BOUND_CHECK("max_packet_size", inst->max_packet_size, <=, 65536);
 
+	FR_INTEGER_BOUND_CHECK("num_sockets", inst->num_sockets, >=, 1);
+	FR_INTEGER_BOUND_CHECK("num_sockets", inst->num_sockets, <=, 64);
+
+	FR_INTEGER_BOUND_CHECK("batch", inst->batch, <=, 64);
+
 	if (!inst->port) {
 		struct servent *s;
 
@@ -830,6 +944,7 @@ fr_app_io_t proto_dhcpv4_udp = {
 	.open			= mod_open,
 	.read			= mod_read,
 	.write			= mod_write,
+	.flush			= mod_flush,
 	.fd_set			= mod_fd_set,
 	.track			= mod_track_create,
 	.compare		= mod_compare,
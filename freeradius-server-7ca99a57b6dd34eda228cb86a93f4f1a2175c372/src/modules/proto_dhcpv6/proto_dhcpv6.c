@@ -248,6 +248,7 @@ static int mod_decode(void const *instance, REQUEST *request, uint8_t *const dat
 	fr_io_address_t const *address = track->address;
 	RADCLIENT const *client;
 	RADIUS_PACKET *packet = request->packet;
+	VALUE_PAIR *vps = NULL;
 
 	/*
 	 *	Set the request dictionary so that we can do
@@ -275,10 +276,12 @@ static int mod_decode(void const *instance, REQUEST *request, uint8_t *const dat
 	 *	That MUST be set and checked in the underlying
 	 *	transport, via a call to fr_dhcpv6_ok().
 	 */
-	if (fr_dhcpv6_decode(packet, packet->data, packet->data_len, &packet->vps) < 0) {
+	if (fr_dhcpv6_decode(packet, packet->data, packet->data_len, &vps) < 0) {
 		RPEDEBUG("Failed decoding packet");
+		fr_pair_list_free(&vps);
 		return -1;
 	}
+	fr_pair_list_append(&packet->vps, vps);
 
 	/*
 	 *	Set the rest of the fields.
@@ -385,7 +388,7 @@ static ssize_t mod_encode(void const *instance, REQUEST *request, uint8_t *buffe
 	}
 
 	data_len = fr_dhcpv6_encode(buffer, buffer_len, (uint8_t const *) original, request->reply->code,
-				    request->reply->vps);
+				    fr_pair_list_head(&request->reply->vps));
 	if (data_len < 0) {
 		RPEDEBUG("Failed encoding DHCPv6 reply");
 		return -1;
@@ -107,9 +107,9 @@ static void dhcpv6_packet_debug(REQUEST *request, RADIUS_PACKET *packet, bool re
 		       );
 
 	if (received) {
-		log_request_pair_list(L_DBG_LVL_1, request, packet->vps, NULL);
+		log_request_pair_list(L_DBG_LVL_1, request, fr_pair_list_head(&packet->vps), NULL);
 	} else {
-		log_request_proto_pair_list(L_DBG_LVL_1, request, packet->vps, NULL);
+		log_request_proto_pair_list(L_DBG_LVL_1, request, fr_pair_list_head(&packet->vps), NULL);
 	}
 }
 
@@ -156,7 +156,7 @@ static rlm_rcode_t mod_process(UNUSED module_ctx_t const *mctx, REQUEST *request
 		 *	Allow the admin to explicitly set the reply
 		 *	type.
 		 */
-		vp = fr_pair_find_by_da(request->reply->vps, attr_packet_type, TAG_ANY);
+		vp = fr_pair_list_find_by_da(&request->reply->vps, attr_packet_type, TAG_ANY);
 		if (vp) {
 			request->reply->code = vp->vp_uint32;
 		} else switch (rcode) {
@@ -63,6 +63,10 @@ typedef struct {
 	uint32_t			max_packet_size;	//!< for message ring buffer.
 	uint32_t			max_attributes;		//!< Limit maximum decodable attributes.
 
+	uint32_t			num_sockets;		//!< How many sockets to open on this address.
+	uint32_t			steering;		//!< a fr_socket_steer_t, how the kernel
+								//!< spreads packets across the sockets.
+
 	uint16_t			port;			//!< Port to listen on.
 
 	bool				multicast;		//!< whether or not we listen for multicast packets
@@ -108,6 +112,11 @@ static const CONF_PARSER udp_listen_config[] = {
 	{ FR_CONF_OFFSET("max_packet_size", FR_TYPE_UINT32, proto_dhcpv6_udp_t, max_packet_size), .dflt = "8192" } ,
 	{ FR_CONF_OFFSET("max_attributes", FR_TYPE_UINT32, proto_dhcpv6_udp_t, max_attributes), .dflt = STRINGIFY(DHCPV4_MAX_ATTRIBUTES) } ,
 
+	{ FR_CONF_OFFSET("num_sockets", FR_TYPE_UINT32, proto_dhcpv6_udp_t, num_sockets), .dflt = "1" } ,
+	{ FR_CONF_OFFSET("steering", FR_TYPE_UINT32, proto_dhcpv6_udp_t, steering), .dflt = "flow",
+	  .func = cf_table_parse_uint32,
+	  .uctx = &(cf_table_parse_ctx_t){ .table = fr_socket_steer_table, .len = &fr_socket_steer_table_len } },
+
 	CONF_PARSER_TERMINATOR
 };
 
@@ -169,6 +178,16 @@ static ssize_t mod_read(fr_listen_t *li, void **packet_ctx, fr_time_t *recv_time
 		return 0;
 	}
 
+	/*
+	 *	Multicast packets are delivered to every socket on
+	 *	this address.  Only the first socket processes them,
+	 *	so that they are answered once.
+	 */
+	if (li->shard && IN6_IS_ADDR_MULTICAST(&address->dst_ipaddr.addr.v6)) {
+		DEBUG3("proto_dhcpv6_udp ignoring multicast packet on socket %u", li->shard);
+		return 0;
+	}
+
 	packet_len = data_size;
 
 	/*
@@ -357,6 +376,21 @@ static int mod_open(fr_listen_t *li)
 		}
 	}
 
+	/*
+	 *	The master opens the other sockets which share this
+	 *	address.  The steering program is for the whole
+	 *	group, so only the first socket sets it.
+	 */
+	if (!li->connected && (li->shard == 0)) {
+		li->num_shards = inst->num_sockets;
+
+		if (fr_socket_server_steer(sockfd, inst->ipaddr.af, inst->steering, inst->num_sockets) < 0) {
+			close(sockfd);
+			PERROR("Failed setting packet steering");
+			goto error;
+		}
+	}
+
 	thread->sockfd = sockfd;
 
 	fr_assert((cf_parent(inst->cs) != NULL) && (cf_parent(cf_parent(inst->cs)) != NULL));	/* listen { ... } */
@@ -540,6 +574,9 @@ static int mod_bootstrap(void *instance, CONF_SECTION *cs)
 	FR_INTEGER_BOUND_CHECK("max_packet_size", inst->max_packet_size, >=, 4);
 	FR_INTEGER_BOUND_CHECK("max_packet_size", inst->max_packet_size, <=, 65536);
 
+	FR_INTEGER_BOUND_CHECK("num_sockets", inst->num_sockets, >=, 1);
+	FR_INTEGER_BOUND_CHECK("num_sockets", inst->num_sockets, <=, 64);
+
 	if (!inst->port) {
 		struct servent *s;
 
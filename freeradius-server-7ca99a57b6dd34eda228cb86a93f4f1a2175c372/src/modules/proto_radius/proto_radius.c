@@ -83,6 +83,11 @@ static CONF_PARSER const proto_radius_config[] = {
 	 */
 	{ FR_CONF_OFFSET("tunnel_password_zeros", FR_TYPE_BOOL, proto_radius_t, tunnel_password_zeros) } ,
 
+	/*
+	 *	Reference values in the packet instead of copying them.
+	 */
+	{ FR_CONF_OFFSET("zero_copy", FR_TYPE_BOOL, proto_radius_t, zero_copy), .dflt = "no" } ,
+
 	{ FR_CONF_POINTER("limit", FR_TYPE_SUBSECTION, NULL), .subcs = (void const *) limit_config },
 	{ FR_CONF_POINTER("priority", FR_TYPE_SUBSECTION, NULL), .subcs = (void const *) priority_config },
 
@@ -279,6 +284,8 @@ static int mod_decode(void const *instance, REQUEST *request, uint8_t *const dat
 	fr_io_track_t const	*track = talloc_get_type_abort_const(request->async->packet_ctx, fr_io_track_t);
 	fr_io_address_t const  	*address = track->address;
 	RADCLIENT const		*client;
+	ssize_t			slen;
+	VALUE_PAIR		*vps = NULL;
 
 	fr_assert(data[0] < FR_RADIUS_MAX_PACKET_CODE);
 
@@ -307,12 +314,21 @@ static int mod_decode(void const *instance, REQUEST *request, uint8_t *const dat
 	 *	That MUST be set and checked in the underlying
 	 *	transport, via a call to fr_radius_ok().
 	 */
-	if (fr_radius_decode(request->packet, request->packet->data, request->packet->data_len,
-			     NULL, client->secret, talloc_array_length(client->secret) - 1,
-			     &request->packet->vps) < 0) {
+	if (inst->zero_copy) {
+		slen = fr_radius_decode_borrowed(request->packet, request->packet->data, request->packet->data_len,
+						 NULL, client->secret, talloc_array_length(client->secret) - 1,
+						 &client->secret_md5, &vps);
+	} else {
+		slen = fr_radius_decode(request->packet, request->packet->data, request->packet->data_len,
+					NULL, client->secret, talloc_array_length(client->secret) - 1,
+					&client->secret_md5, &vps);
+	}
+	if (slen < 0) {
 		RPEDEBUG("Failed decoding packet");
+		fr_pair_list_free(&vps);
 		return -1;
 	}
+	fr_pair_list_append(&request->packet->vps, vps);
 
 	/*
 	 *	Set the rest of the fields.
@@ -346,7 +362,7 @@ static int mod_decode(void const *instance, REQUEST *request, uint8_t *const dat
 
 		fr_assert(client->dynamic);
 
-		for (vp = fr_cursor_init(&cursor, &request->packet->vps);
+		for (vp = fr_pair_list_cursor_init(&cursor, &request->packet->vps);
 		     vp != NULL;
 		     vp = fr_cursor_next(&cursor)) {
 			if (vp->da->flags.subtype != FLAG_ENCRYPT_NONE) {
@@ -385,7 +401,7 @@ static int mod_decode(void const *instance, REQUEST *request, uint8_t *const dat
 		       request->packet->data_len,
 		       request->async->listen->name);
 
-		log_request_pair_list(L_DBG_LVL_1, request, request->packet->vps, "");
+		log_request_pair_list(L_DBG_LVL_1, request, fr_pair_list_head(&request->packet->vps), "");
 	}
 
 	if (!inst->io.app_io->decode) return 0;
@@ -483,20 +499,14 @@ static ssize_t mod_encode(void const *instance, REQUEST *request, uint8_t *buffe
 	}
 #endif
 
-	data_len = fr_radius_encode(buffer, buffer_len, request->packet->data,
-				    client->secret, talloc_array_length(client->secret) - 1,
-				    request->reply->code, request->reply->id, request->reply->vps);
+	data_len = fr_radius_encode_reply(&FR_DBUFF_TMP(buffer, buffer_len), request->packet->data,
+					  client->secret, talloc_array_length(client->secret) - 1, &client->secret_md5,
+					  request->reply->code, request->reply->id, fr_pair_list_head(&request->reply->vps));
 	if (data_len < 0) {
 		RPEDEBUG("Failed encoding RADIUS reply");
 		return -1;
 	}
 
-	if (fr_radius_sign(buffer, request->packet->data,
-			   (uint8_t const *) client->secret, talloc_array_length(client->secret) - 1) < 0) {
-		RPEDEBUG("Failed signing RADIUS reply");
-		return -1;
-	}
-
 	if (RDEBUG_ENABLED) {
 		RDEBUG("Sending %s ID %i from %pV:%i to %pV:%i length %zu via socket %s",
 		       fr_packet_codes[request->reply->code],
@@ -508,7 +518,7 @@ static ssize_t mod_encode(void const *instance, REQUEST *request, uint8_t *buffe
 		       data_len,
 		       request->async->listen->name);
 
-		log_request_pair_list(L_DBG_LVL_1, request, request->reply->vps, "");
+		log_request_pair_list(L_DBG_LVL_1, request, fr_pair_list_head(&request->reply->vps), "");
 	}
 
 	return data_len;
@@ -40,6 +40,8 @@ typedef struct {
 
 	bool				tunnel_password_zeros;		//!< check for trailing zeroes in Tunnel-Password.
 
+	bool				zero_copy;			//!< decode values as references to the packet.
+
 	bool				code_allowed[FR_CODE_RADIUS_MAX + 1];	//!< Allowed packet codes.
 
 	uint32_t			priorities[FR_RADIUS_MAX_PACKET_CODE];	//!< priorities for individual packets
@@ -161,9 +161,9 @@ static char *auth_name(char *buf, size_t buflen, REQUEST *request)
 	uint32_t	port = 0;	/* RFC 2865 NAS-Port is 4 bytes */
 	char const	*tls = "";
 
-	cli = fr_pair_find_by_da(request->packet->vps, attr_calling_station_id, TAG_ANY);
+	cli = fr_pair_list_find_by_da(&request->packet->vps, attr_calling_station_id, TAG_ANY);
 
-	pair = fr_pair_find_by_da(request->packet->vps, attr_nas_port, TAG_ANY);
+	pair = fr_pair_list_find_by_da(&request->packet->vps, attr_nas_port, TAG_ANY);
 	if (pair != NULL) port = pair->vp_uint32;
 
 	if (request->packet->dst_port == 0) tls = " via proxy to virtual server";
@@ -207,21 +207,21 @@ static void CC_HINT(format (printf, 4, 5)) auth_message(proto_radius_auth_t cons
 	 * Get the correct username based on the configured value
 	 */
 	if (!inst->log_stripped_names) {
-		username = fr_pair_find_by_da(request->packet->vps, attr_user_name, TAG_ANY);
+		username = fr_pair_list_find_by_da(&request->packet->vps, attr_user_name, TAG_ANY);
 	} else {
-		username = fr_pair_find_by_da(request->packet->vps, attr_stripped_user_name, TAG_ANY);
-		if (!username) username = fr_pair_find_by_da(request->packet->vps, attr_user_name, TAG_ANY);
+		username = fr_pair_list_find_by_da(&request->packet->vps, attr_stripped_user_name, TAG_ANY);
+		if (!username) username = fr_pair_list_find_by_da(&request->packet->vps, attr_user_name, TAG_ANY);
 	}
 
 	/*
 	 *	Clean up the password
 	 */
 	if (inst->log_auth_badpass || inst->log_auth_goodpass) {
-		password = fr_pair_find_by_da(request->packet->vps, attr_user_password, TAG_ANY);
+		password = fr_pair_list_find_by_da(&request->packet->vps, attr_user_password, TAG_ANY);
 		if (!password) {
 			VALUE_PAIR *auth_type;
 
-			auth_type = fr_pair_find_by_da(request->control, attr_auth_type, TAG_ANY);
+			auth_type = fr_pair_list_find_by_da(&request->control, attr_auth_type, TAG_ANY);
 			if (auth_type) {
 				snprintf(password_buff, sizeof(password_buff), "<via Auth-Type = %s>",
 					 fr_dict_enum_name_by_value(auth_type->da, &auth_type->data));
@@ -229,7 +229,7 @@ static void CC_HINT(format (printf, 4, 5)) auth_message(proto_radius_auth_t cons
 			} else {
 				password_str = "<no User-Password attribute>";
 			}
-		} else if (fr_pair_find_by_da(request->packet->vps, attr_chap_password, TAG_ANY)) {
+		} else if (fr_pair_list_find_by_da(&request->packet->vps, attr_chap_password, TAG_ANY)) {
 			password_str = "<CHAP-Password>";
 		}
 	}
@@ -284,7 +284,7 @@ static rlm_rcode_t mod_process(module_ctx_t const *mctx, REQUEST *request)
 	case REQUEST_INIT:
 		if (request->parent && RDEBUG_ENABLED) {
 			RDEBUG("Received %s ID %i", fr_packet_codes[request->packet->code], request->packet->id);
-			log_request_pair_list(L_DBG_LVL_1, request, request->packet->vps, "");
+			log_request_pair_list(L_DBG_LVL_1, request, fr_pair_list_head(&request->packet->vps), "");
 		}
 
 		request->component = "radius";
@@ -333,8 +333,8 @@ static rlm_rcode_t mod_process(module_ctx_t const *mctx, REQUEST *request)
 		case RLM_MODULE_REJECT:
 		case RLM_MODULE_DISALLOW:
 		default:
-			if ((vp = fr_pair_find_by_da(request->packet->vps,
-						     attr_module_failure_message, TAG_ANY)) != NULL) {
+			if ((vp = fr_pair_list_find_by_da(&request->packet->vps,
+							  attr_module_failure_message, TAG_ANY)) != NULL) {
 				auth_message(inst, request, false, "Invalid user (%pV)", &vp->data);
 			} else {
 				auth_message(inst, request, false, "Invalid user");
@@ -348,7 +348,7 @@ static rlm_rcode_t mod_process(module_ctx_t const *mctx, REQUEST *request)
 		 *	Find Auth-Type, and complain if they have too many.
 		 */
 		auth_type = NULL;
-		for (vp = fr_cursor_iter_by_da_init(&cursor, &request->control, attr_auth_type);
+		for (vp = fr_pair_list_cursor_by_da_init(&cursor, &request->control, attr_auth_type);
 		     vp;
 		     vp = fr_cursor_next(&cursor)) {
 			if (!auth_type) {
@@ -370,7 +370,7 @@ static rlm_rcode_t mod_process(module_ctx_t const *mctx, REQUEST *request)
 			 *	the "recv Access-Request" section
 			 *	should have returned reject.
 			 */
-			vp = fr_pair_find_by_da(request->packet->vps, attr_service_type, TAG_ANY);
+			vp = fr_pair_list_find_by_da(&request->packet->vps, attr_service_type, TAG_ANY);
 			if (vp && (vp->vp_uint32 == FR_SERVICE_TYPE_VALUE_AUTHORIZE_ONLY)) {
 				RDEBUG("Skipping authenticate as we have found %pP", vp);
 				request->reply->code = FR_CODE_ACCESS_ACCEPT;
@@ -380,7 +380,7 @@ static rlm_rcode_t mod_process(module_ctx_t const *mctx, REQUEST *request)
 			/*
 			 *	Allow for over-ride of reply code.
 			 */
-			vp = fr_pair_find_by_da(request->reply->vps, attr_packet_type, TAG_ANY);
+			vp = fr_pair_list_find_by_da(&request->reply->vps, attr_packet_type, TAG_ANY);
 			if (vp) {
 				request->reply->code = vp->vp_uint32;
 				goto setup_send;
@@ -460,7 +460,7 @@ static rlm_rcode_t mod_process(module_ctx_t const *mctx, REQUEST *request)
 			/*
 			 *	Maybe the shared secret is wrong?
 			 */
-			vp = fr_pair_find_by_da(request->packet->vps, attr_user_password, TAG_ANY);
+			vp = fr_pair_list_find_by_da(&request->packet->vps, attr_user_password, TAG_ANY);
 			if (vp) {
 				if (RDEBUG_ENABLED2) {
 					uint8_t const *p;
@@ -493,12 +493,12 @@ static rlm_rcode_t mod_process(module_ctx_t const *mctx, REQUEST *request)
 		/*
 		 *	Allow for over-ride of reply code.
 		 */
-		vp = fr_pair_find_by_da(request->reply->vps, attr_packet_type, TAG_ANY);
+		vp = fr_pair_list_find_by_da(&request->reply->vps, attr_packet_type, TAG_ANY);
 		if (vp) request->reply->code = vp->vp_uint32;
 
 	setup_send:
 		if (!request->reply->code) {
-			vp = fr_pair_find_by_da(request->reply->vps, attr_packet_type, TAG_ANY);
+			vp = fr_pair_list_find_by_da(&request->reply->vps, attr_packet_type, TAG_ANY);
 			if (vp) {
 				request->reply->code = vp->vp_uint32;
 			} else {
@@ -515,7 +515,7 @@ static rlm_rcode_t mod_process(module_ctx_t const *mctx, REQUEST *request)
 		 *	"send Access-Challenge" section.
 		 */
 		if ((request->reply->code == FR_CODE_ACCESS_CHALLENGE) &&
-		    !(vp = fr_pair_find_by_da(request->reply->vps, attr_state, TAG_ANY))) {
+		    !(vp = fr_pair_list_find_by_da(&request->reply->vps, attr_state, TAG_ANY))) {
 			uint8_t buffer[16];
 
 			fr_rand_buffer(buffer, sizeof(buffer));
@@ -648,14 +648,14 @@ static rlm_rcode_t mod_process(module_ctx_t const *mctx, REQUEST *request)
 		 *	we're sending an accept.
 		 */
 		if (request->reply->code == FR_CODE_ACCESS_ACCEPT) {
-			vp = fr_pair_find_by_da(request->packet->vps, attr_module_success_message, TAG_ANY);
+			vp = fr_pair_list_find_by_da(&request->packet->vps, attr_module_success_message, TAG_ANY);
 			if (vp){
 				auth_message(inst, request, true, "Login OK (%pV)", &vp->data);
 			} else {
 				auth_message(inst, request, true, "Login OK");
 			}
 		} else if (request->reply->code == FR_CODE_ACCESS_REJECT) {
-			vp = fr_pair_find_by_da(request->packet->vps, attr_module_failure_message, TAG_ANY);
+			vp = fr_pair_list_find_by_da(&request->packet->vps, attr_module_failure_message, TAG_ANY);
 			if (vp) {
 				auth_message(inst, request, false, "Login incorrect (%pV)", &vp->data);
 			} else {
@@ -664,7 +664,7 @@ static rlm_rcode_t mod_process(module_ctx_t const *mctx, REQUEST *request)
 		}
 		if (request->parent && RDEBUG_ENABLED) {
 			RDEBUG("Sending %s ID %i", fr_packet_codes[request->reply->code], request->reply->id);
-			log_request_pair_list(L_DBG_LVL_1, request, request->reply->vps, "");
+			log_request_pair_list(L_DBG_LVL_1, request, fr_pair_list_head(&request->reply->vps), "");
 		}
 		break;
 
@@ -727,12 +727,25 @@ static const virtual_server_compile_t compile_list[] = {
 	COMPILE_TERMINATOR
 };
 
-static int mod_instantiate(void *instance, UNUSED CONF_SECTION *process_app_cs)
+static int mod_instantiate(void *instance, CONF_SECTION *process_app_cs)
 {
 	proto_radius_auth_t	*inst = instance;
+	CONF_SECTION		*server_cs;
 
 	inst->state_tree = fr_state_tree_init(inst, attr_state, main_config->spawn_workers, inst->max_session,
 					      inst->session_timeout, inst->state_server_id);
+	if (!inst->state_tree) {
+		cf_log_err(process_app_cs, "Failed creating state tree");
+		return -1;
+	}
+
+	/*
+	 *	radmin shows the state shards as "stats state <server> self".
+	 */
+	server_cs = cf_item_to_section(cf_parent(cf_item_to_section(cf_parent(process_app_cs))));
+	if (fr_command_register_hook(NULL, cf_section_name2(server_cs), inst->state_tree, cmd_state_table) < 0) {
+		PWARN("Failed registering state statistics for server %s", cf_section_name2(server_cs));
+	}
 
 	return 0;
 }
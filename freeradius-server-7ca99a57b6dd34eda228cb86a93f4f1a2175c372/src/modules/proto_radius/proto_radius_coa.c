@@ -63,7 +63,7 @@ static rlm_rcode_t mod_process(UNUSED module_ctx_t const *mctx, REQUEST *request
 	case REQUEST_INIT:
 		if (request->parent && RDEBUG_ENABLED) {
 			RDEBUG("Received %s ID %i", fr_packet_codes[request->packet->code], request->packet->id);
-			log_request_pair_list(L_DBG_LVL_1, request, request->packet->vps, "");
+			log_request_pair_list(L_DBG_LVL_1, request, fr_pair_list_head(&request->packet->vps), "");
 		}
 
 		request->component = "radius";
@@ -82,8 +82,8 @@ static rlm_rcode_t mod_process(UNUSED module_ctx_t const *mctx, REQUEST *request
 		 *	re-authorization requests.
 		 */
 		if (request->packet->code == FR_CODE_COA_REQUEST) {
-			vp = fr_pair_find_by_da(request->reply->vps, attr_service_type, TAG_ANY);
-			if (vp && !fr_pair_find_by_da(request->reply->vps, attr_state, TAG_ANY)) {
+			vp = fr_pair_list_find_by_da(&request->reply->vps, attr_service_type, TAG_ANY);
+			if (vp && !fr_pair_list_find_by_da(&request->reply->vps, attr_state, TAG_ANY)) {
 				REDEBUG("CoA-Request with Service-Type = Authorize-Only MUST contain a State attribute");
 				request->reply->code = FR_CODE_COA_NAK;
 				goto nak;
@@ -135,7 +135,7 @@ static rlm_rcode_t mod_process(UNUSED module_ctx_t const *mctx, REQUEST *request
 		/*
 		 *	Allow for over-ride of reply code.
 		 */
-		vp = fr_pair_find_by_da(request->reply->vps, attr_packet_type, TAG_ANY);
+		vp = fr_pair_list_find_by_da(&request->reply->vps, attr_packet_type, TAG_ANY);
 		if (vp) request->reply->code = vp->vp_uint32;
 
 	nak:
@@ -226,7 +226,7 @@ static rlm_rcode_t mod_process(UNUSED module_ctx_t const *mctx, REQUEST *request
 
 		if (request->parent && RDEBUG_ENABLED) {
 			RDEBUG("Sending %s ID %i", fr_packet_codes[request->reply->code], request->reply->id);
-			log_request_pair_list(L_DBG_LVL_1, request, request->reply->vps, "");
+			log_request_pair_list(L_DBG_LVL_1, request, fr_pair_list_head(&request->reply->vps), "");
 		}
 		break;
 
@@ -157,16 +157,16 @@ static rlm_rcode_t mod_process(UNUSED module_ctx_t const *mctx, REQUEST *request
 		if (request->reply->code == FR_CODE_ACCESS_ACCEPT) {
 			VALUE_PAIR *vp;
 
-			vp = fr_pair_find_by_da(request->control, attr_freeradius_client_ip_address, TAG_ANY);
-			if (!vp) fr_pair_find_by_da(request->control, attr_freeradius_client_ipv6_address, TAG_ANY);
-			if (!vp) fr_pair_find_by_da(request->control, attr_freeradius_client_ip_prefix, TAG_ANY);
-			if (!vp) fr_pair_find_by_da(request->control, attr_freeradius_client_ipv6_prefix, TAG_ANY);
+			vp = fr_pair_list_find_by_da(&request->control, attr_freeradius_client_ip_address, TAG_ANY);
+			if (!vp) fr_pair_list_find_by_da(&request->control, attr_freeradius_client_ipv6_address, TAG_ANY);
+			if (!vp) fr_pair_list_find_by_da(&request->control, attr_freeradius_client_ip_prefix, TAG_ANY);
+			if (!vp) fr_pair_list_find_by_da(&request->control, attr_freeradius_client_ipv6_prefix, TAG_ANY);
 			if (!vp) {
 				ERROR("The 'control' list MUST contain a FreeRADIUS-Client.. IP address attribute");
 				goto deny;
 			}
 
-			vp = fr_pair_find_by_da(request->control, attr_freeradius_client_secret, TAG_ANY);
+			vp = fr_pair_list_find_by_da(&request->control, attr_freeradius_client_secret, TAG_ANY);
 			if (!vp) {
 				ERROR("The 'control' list MUST contain a FreeRADIUS-Client-Secret attribute");
 				goto deny;
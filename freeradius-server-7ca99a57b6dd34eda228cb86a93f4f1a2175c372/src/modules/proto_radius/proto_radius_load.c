@@ -33,6 +33,9 @@
 #include <freeradius-devel/io/schedule.h>
 #include <freeradius-devel/io/load.h>
 #include <freeradius-devel/util/debug.h>
+#ifdef HAVE_LIBPCAP
+#  include <freeradius-devel/util/pcap.h>
+#endif
 
 #include "proto_radius.h"
 
@@ -56,6 +59,42 @@ extern fr_app_io_t proto_radius_load;
 
 typedef struct proto_radius_load_s proto_radius_load_t;
 
+/** Where the request templates are read from
+ *
+ */
+typedef enum {
+	LOAD_FORMAT_PAIRS = 0,					//!< Blank line separated attribute lists.
+	LOAD_FORMAT_DETAIL,					//!< Detail file entries.
+	LOAD_FORMAT_PCAP					//!< RADIUS requests in a packet capture.
+} proto_radius_load_format_t;
+
+static fr_table_num_sorted_t const load_format_table[] = {
+	{ L("detail"),	LOAD_FORMAT_DETAIL	},
+	{ L("pairs"),	LOAD_FORMAT_PAIRS	},
+	{ L("pcap"),	LOAD_FORMAT_PCAP	}
+};
+static size_t load_format_table_len = NUM_ELEMENTS(load_format_table);
+
+static fr_table_num_sorted_t const load_mode_table[] = {
+	{ L("search"),	FR_LOAD_MODE_SEARCH	},
+	{ L("step"),	FR_LOAD_MODE_STEP	}
+};
+static size_t load_mode_table_len = NUM_ELEMENTS(load_mode_table);
+
+static fr_table_num_sorted_t const load_report_table[] = {
+	{ L("csv"),	FR_LOAD_REPORT_CSV	},
+	{ L("json"),	FR_LOAD_REPORT_JSON	}
+};
+static size_t load_report_table_len = NUM_ELEMENTS(load_report_table);
+
+/** An encoded request, ready to be replayed
+ *
+ */
+typedef struct {
+	uint8_t				*packet;		//!< encoded packet
+	size_t				packet_len;		//!< length of packet
+} proto_radius_load_packet_t;
+
 typedef struct {
 	fr_event_list_t			*el;			//!< event list
 	fr_network_t			*nr;			//!< network handler
@@ -71,8 +110,12 @@ typedef struct {
 	fr_stats_t			stats;			//!< statistics for this socket
 
 	int				fd;			//!< for CSV files
+	int				report_fd;		//!< for per-step reports
+	size_t				reported;		//!< number of steps written to the report
 	fr_event_timer_t const		*ev;			//!< for writing statistics
 
+	size_t				next;			//!< next request template to send
+
 	int				sockets[2];
 	fr_listen_t			*parent;		//!< master IO handler
 } proto_radius_load_thread_t;
@@ -81,8 +124,9 @@ struct proto_radius_load_s {
 	CONF_SECTION			*cs;			//!< our configuration
 
 	char const     			*filename;		//!< where to read input packets from
-	uint8_t				*packet;		//!< encoded packet read from the file
-	size_t				packet_len;		//!< length of packet
+	uint32_t			format;			//!< format of the input file
+	char const			*secret;		//!< shared secret for packets read from a pcap file
+	proto_radius_load_packet_t	*packets;		//!< encoded packets read from the file
 
 	uint32_t			max_packet_size;	//!< for message ring buffer.
 	uint32_t			max_attributes;		//!< Limit maximum decodable attributes
@@ -92,12 +136,24 @@ struct proto_radius_load_s {
 	fr_load_config_t		load;			//!< load configuration
 	bool				repeat;			//!, do we repeat the load generation
 	char const     			*csv;			//!< where to write CSV stats
+	char const			*report;		//!< where to write per-step results
+	uint32_t			report_format;		//!< CSV or JSON
 };
 
 
 static const CONF_PARSER load_listen_config[] = {
 	{ FR_CONF_OFFSET("filename", FR_TYPE_FILE_INPUT, proto_radius_load_t, filename) },
+	{ FR_CONF_OFFSET("format", FR_TYPE_UINT32, proto_radius_load_t, format),
+	  .func = cf_table_parse_uint32,
+	  .uctx = &(cf_table_parse_ctx_t){ .table = load_format_table, .len = &load_format_table_len },
+	  .dflt = "pairs" },
+	{ FR_CONF_OFFSET("secret", FR_TYPE_STRING | FR_TYPE_SECRET, proto_radius_load_t, secret), .dflt = "testing123" },
 	{ FR_CONF_OFFSET("csv", FR_TYPE_STRING, proto_radius_load_t, csv) },
+	{ FR_CONF_OFFSET("report", FR_TYPE_STRING, proto_radius_load_t, report) },
+	{ FR_CONF_OFFSET("report_format", FR_TYPE_UINT32, proto_radius_load_t, report_format),
+	  .func = cf_table_parse_uint32,
+	  .uctx = &(cf_table_parse_ctx_t){ .table = load_report_table, .len = &load_report_table_len },
+	  .dflt = "csv" },
 
 	{ FR_CONF_OFFSET("max_packet_size", FR_TYPE_UINT32, proto_radius_load_t, max_packet_size), .dflt = "4096" } ,
 	{ FR_CONF_OFFSET("max_attributes", FR_TYPE_UINT32, proto_radius_load_t, max_attributes), .dflt = STRINGIFY(RADIUS_MAX_ATTRIBUTES) } ,
@@ -109,6 +165,11 @@ static const CONF_PARSER load_listen_config[] = {
 	{ FR_CONF_OFFSET("max_backlog", FR_TYPE_UINT32, proto_radius_load_t, load.milliseconds) },
 	{ FR_CONF_OFFSET("parallel", FR_TYPE_UINT32, proto_radius_load_t, load.parallel) },
 	{ FR_CONF_OFFSET("repeat", FR_TYPE_BOOL, proto_radius_load_t, repeat) },
+	{ FR_CONF_OFFSET("mode", FR_TYPE_UINT32, proto_radius_load_t, load.mode),
+	  .func = cf_table_parse_uint32,
+	  .uctx = &(cf_table_parse_ctx_t){ .table = load_mode_table, .len = &load_mode_table_len },
+	  .dflt = "step" },
+	{ FR_CONF_OFFSET("latency_target", FR_TYPE_UINT32, proto_radius_load_t, load.latency_target) },
 
 	CONF_PARSER_TERMINATOR
 };
@@ -119,6 +180,7 @@ static ssize_t mod_read(fr_listen_t *li, void **packet_ctx, fr_time_t *recv_time
 	proto_radius_load_t const       *inst = talloc_get_type_abort_const(li->app_io_instance, proto_radius_load_t);
 	proto_radius_load_thread_t	*thread = talloc_get_type_abort(li->thread_instance, proto_radius_load_thread_t);
 	fr_io_address_t			*address, **address_p;
+	proto_radius_load_packet_t const *template;
 
 	size_t				packet_len;
 
@@ -140,15 +202,19 @@ static ssize_t mod_read(fr_listen_t *li, void **packet_ctx, fr_time_t *recv_time
 
 	*recv_time_p = thread->recv_time;
 
-	if (buffer_len < inst->packet_len) {
+	/*
+	 *	Cycle through the request templates.
+	 */
+	template = &inst->packets[thread->next++];
+	if (thread->next >= talloc_array_length(inst->packets)) thread->next = 0;
+
+	if (buffer_len < template->packet_len) {
 		DEBUG2("proto_radius_load read buffer is too small for input packet");
 		return 0;
 	}
 
-	memcpy(buffer, inst->packet, inst->packet_len);
-	packet_len = inst->packet_len;
-
-	// @todo - try for some variation in the packet
+	memcpy(buffer, template->packet, template->packet_len);
+	packet_len = template->packet_len;
 
 	/*
 	 *	The packet is always OK for RADIUS.
@@ -169,6 +235,30 @@ static ssize_t mod_read(fr_listen_t *li, void **packet_ctx, fr_time_t *recv_time
 }
 
 
+/** Write out the results of any steps which have finished since the last call
+ *
+ */
+static void write_report(proto_radius_load_thread_t *thread)
+{
+	fr_load_phase_t const	*phases;
+	size_t			num, len;
+	char			buffer[512];
+
+	if (!thread->inst->report || (thread->report_fd < 0)) return;
+
+	phases = fr_load_generator_phases(thread->l, &num);
+
+	while (thread->reported < num) {
+		len = fr_load_generator_phase_sprint(&phases[thread->reported], thread->inst->report_format,
+						     (thread->reported == 0), buffer, sizeof(buffer));
+		if (write(thread->report_fd, buffer, len) < 0) {
+			DEBUG("Failed writing to %s - %s", thread->inst->report, fr_syserror(errno));
+			return;
+		}
+		thread->reported++;
+	}
+}
+
 static ssize_t mod_write(fr_listen_t *li, UNUSED void *packet_ctx, fr_time_t request_time,
 			 UNUSED uint8_t *buffer, size_t buffer_len, UNUSED size_t written)
 {
@@ -189,6 +279,13 @@ static ssize_t mod_write(fr_listen_t *li, UNUSED void *packet_ctx, fr_time_t req
 	 */
 	state = fr_load_generator_have_reply(thread->l, request_time);
 	if (state == FR_LOAD_DONE) {
+		write_report(thread);
+
+		if (thread->load.mode == FR_LOAD_MODE_SEARCH) {
+			INFO("proto_radius_load - Highest rate meeting the p99 target of %u usec is %u packets/s",
+			     thread->load.latency_target, fr_load_generator_stats(thread->l)->max_pps);
+		}
+
 		if (!thread->inst->repeat) {
 			thread->done = true;
 		} else {
@@ -273,6 +370,10 @@ static void write_stats(fr_event_list_t *el, fr_time_t now, void *uctx)
 
 	(void) fr_event_timer_in(thread, el, &thread->ev, NSEC, write_stats, thread);
 
+	write_report(thread);
+
+	if (!thread->inst->csv || (thread->fd < 0)) return;
+
 	len = fr_load_generator_stats_sprint(thread->l, now, buffer, sizeof(buffer));
 	if (write(thread->fd, buffer, len) < 0) {
 		DEBUG("Failed writing to %s - %s", thread->inst->csv, fr_syserror(errno));
@@ -303,6 +404,17 @@ static void mod_event_list_set(fr_listen_t *li, fr_event_list_t *el, void *nr)
 
 	(void) fr_load_generator_start(thread->l);
 
+	thread->fd = thread->report_fd = -1;
+
+	if (!inst->csv && !inst->report) return;
+
+	if (inst->report) {
+		thread->report_fd = open(inst->report, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+		if (thread->report_fd < 0) ERROR("Failed opening %s - %s", inst->report, fr_syserror(errno));
+	}
+
+	(void) fr_event_timer_in(thread, thread->el, &thread->ev, NSEC, write_stats, thread);
+
 	if (!inst->csv) return;
 
 	thread->fd = open(inst->csv, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
@@ -311,8 +423,6 @@ static void mod_event_list_set(fr_listen_t *li, fr_event_list_t *el, void *nr)
 		return;
 	}
 
-	(void) fr_event_timer_in(thread, thread->el, &thread->ev, NSEC, write_stats, thread);
-
 	len = fr_load_generator_stats_sprint(thread->l, fr_time(), buffer, sizeof(buffer));
 	if (write(thread->fd, buffer, len) < 0) {
 		DEBUG("Failed writing to %s - %s", thread->inst->csv, fr_syserror(errno));
@@ -343,7 +453,7 @@ static int mod_bootstrap(void *instance, CONF_SECTION *cs)
 	FR_INTEGER_BOUND_CHECK("step", inst->load.step, <, 100000);
 
 	if (inst->load.max_pps > 0) FR_INTEGER_BOUND_CHECK("max_pps", inst->load.max_pps, >, inst->load.start_pps);
-	FR_INTEGER_BOUND_CHECK("max_pps", inst->load.max_pps, <, 100000);
+	FR_INTEGER_BOUND_CHECK("max_pps", inst->load.max_pps, <, 10000000);
 
 	FR_INTEGER_BOUND_CHECK("duration", inst->load.duration, >=, 1);
 	FR_INTEGER_BOUND_CHECK("duration", inst->load.duration, <, 10000);
@@ -355,6 +465,15 @@ static int mod_bootstrap(void *instance, CONF_SECTION *cs)
 	FR_INTEGER_BOUND_CHECK("max_backlog", inst->load.milliseconds, >=, 1);
 	FR_INTEGER_BOUND_CHECK("max_backlog", inst->load.milliseconds, <, 100000);
 
+	FR_INTEGER_BOUND_CHECK("latency_target", inst->load.latency_target, <, 60000000);
+
+#ifndef HAVE_LIBPCAP
+	if (inst->format == LOAD_FORMAT_PCAP) {
+		cf_log_err(cs, "Reading packets from pcap files requires libpcap");
+		return -1;
+	}
+#endif
+
 	return 0;
 }
 
@@ -366,16 +485,205 @@ static RADCLIENT *mod_client_find(fr_listen_t *li, UNUSED fr_ipaddr_t const *ipa
 }
 
 
+/** Encode a request template, and add it to the list of packets to send
+ *
+ */
+static int load_packet_add(proto_radius_load_t *inst, CONF_SECTION *cs, VALUE_PAIR *vps, int code)
+{
+	VALUE_PAIR			*vp;
+	proto_radius_load_packet_t	*packet;
+	size_t				num = talloc_array_length(inst->packets);
+	ssize_t				packet_len;
+
+	vp = fr_pair_find_by_da(vps, attr_packet_type, TAG_ANY);
+	if (vp) code = vp->vp_uint32;
+
+	MEM(inst->packets = talloc_realloc(inst, inst->packets, proto_radius_load_packet_t, num + 1));
+	packet = &inst->packets[num];
+	memset(packet, 0, sizeof(*packet));
+
+	MEM(packet->packet = talloc_zero_array(inst->packets, uint8_t, inst->max_packet_size));
+
+	/*
+	 *	Encode the packet.
+	 */
+	packet_len = fr_radius_encode(packet->packet, inst->max_packet_size, NULL,
+				      inst->client->secret, talloc_array_length(inst->client->secret),
+				      code, 0, vps);
+	if (packet_len <= 0) {
+		cf_log_perr(cs, "Failed encoding packet %zu from %s",
+			    num + 1, inst->filename ? inst->filename : "none");
+		return -1;
+	}
+
+	packet->packet_len = packet_len;
+
+	return 0;
+}
+
+/** Read blank line separated attribute lists, as used by radclient
+ *
+ */
+static int load_pairs_read(proto_radius_load_t *inst, CONF_SECTION *cs, FILE *fp)
+{
+	bool		done;
+	VALUE_PAIR	*vps;
+	int		ret;
+
+	do {
+		vps = NULL;
+
+		if (fr_pair_list_afrom_file(inst, dict_radius, &vps, fp, &done) < 0) {
+			cf_log_perr(cs, "Failed reading %s", inst->filename);
+			return -1;
+		}
+
+		if (!vps) continue;
+
+		ret = load_packet_add(inst, cs, vps, FR_CODE_ACCESS_REQUEST);
+		fr_pair_list_free(&vps);
+		if (ret < 0) return -1;
+	} while (!done);
+
+	return 0;
+}
+
+/** Read detail file entries
+ *
+ *  Each entry starts with a timestamp line, and is followed by
+ *  indented attributes.  Attributes which aren't in the RADIUS
+ *  dictionary, such as those added by the server when writing the
+ *  entry, are ignored.
+ */
+static int load_detail_read(proto_radius_load_t *inst, CONF_SECTION *cs, FILE *fp)
+{
+	char		buf[8192];
+	VALUE_PAIR	*vp, *vps = NULL;
+
+	while (fgets(buf, sizeof(buf), fp) != NULL) {
+		if (buf[0] == '#') continue;
+
+		/*
+		 *	A blank line or a timestamp ends the entry.
+		 */
+		if ((buf[0] == '\n') || !isspace((uint8_t) buf[0])) {
+			if (vps) {
+				int ret;
+
+				ret = load_packet_add(inst, cs, vps, FR_CODE_ACCOUNTING_REQUEST);
+				fr_pair_list_free(&vps);
+				if (ret < 0) return -1;
+			}
+			continue;
+		}
+
+		vp = NULL;
+		(void) fr_pair_list_afrom_str(inst, dict_radius, buf, &vp);
+		if (!vp) {
+			DEBUG3("proto_radius_load - Ignoring \"%pV\" in %s",
+			       fr_box_strvalue_len(buf, strlen(buf) - 1), inst->filename);
+			continue;
+		}
+
+		fr_pair_add(&vps, vp);
+	}
+
+	if (vps) {
+		int ret;
+
+		ret = load_packet_add(inst, cs, vps, FR_CODE_ACCOUNTING_REQUEST);
+		fr_pair_list_free(&vps);
+		if (ret < 0) return -1;
+	}
+
+	return 0;
+}
+
+#ifdef HAVE_LIBPCAP
+/** Read RADIUS requests from a packet capture
+ *
+ *  The requests are decoded with the configured secret, and then
+ *  encoded again as if they came from the load generator's client.
+ */
+static int load_pcap_read(proto_radius_load_t *inst, CONF_SECTION *cs)
+{
+	fr_pcap_t		*pcap;
+	struct pcap_pkthdr	*header;
+	uint8_t const		*data;
+
+	pcap = fr_pcap_init(inst, inst->filename, PCAP_FILE_IN);
+	if (!pcap || (fr_pcap_open(pcap) < 0)) {
+		cf_log_perr(cs, "Failed opening %s", inst->filename);
+		talloc_free(pcap);
+		return -1;
+	}
+
+	while (pcap_next_ex(pcap->handle, &header, &data) == 1) {
+		uint8_t const	*p = data, *end = data + header->caplen;
+		ssize_t		offset;
+		size_t		len;
+		uint8_t		proto;
+		VALUE_PAIR	*vps = NULL;
+		int		ret;
+
+		offset = fr_pcap_link_layer_offset(data, header->caplen, pcap->link_layer);
+		if ((offset < 0) || (offset >= (end - p))) continue;
+		p += offset;
+
+		switch (p[0] >> 4) {
+		case 4:
+			if ((size_t) (end - p) < sizeof(ip_header_t)) continue;
+			proto = ((ip_header_t const *) p)->ip_p;
+			p += (p[0] & 0x0f) * 4;	/* header length is in 32bit words */
+			break;
+
+		case 6:
+			if ((size_t) (end - p) < sizeof(ip_header6_t)) continue;
+			proto = ((ip_header6_t const *) p)->ip_next;
+			p += sizeof(ip_header6_t);
+			break;
+
+		default:
+			continue;
+		}
+
+		if (proto != IPPROTO_UDP) continue;
+
+		p += sizeof(udp_header_t);
+		if ((p + RADIUS_HEADER_LENGTH) > end) continue;
+
+		/*
+		 *	Only replay requests.
+		 */
+		if (!is_radius_code(p[0]) || !fr_request_packets[p[0]]) continue;
+
+		len = end - p;
+		if (!fr_radius_ok(p, &len, inst->max_attributes, false, NULL)) continue;
+
+		if (fr_radius_decode(inst, p, len, NULL, inst->secret, talloc_array_length(inst->secret) - 1, NULL, &vps) < 0) {
+			cf_log_warn(cs, "Ignoring %s in %s - %s", fr_packet_codes[p[0]], inst->filename, fr_strerror());
+			continue;
+		}
+
+		ret = load_packet_add(inst, cs, vps, p[0]);
+		fr_pair_list_free(&vps);
+		if (ret < 0) {
+			talloc_free(pcap);
+			return -1;
+		}
+	}
+
+	talloc_free(pcap);
+
+	return 0;
+}
+#endif
+
 static int mod_instantiate(void *instance, CONF_SECTION *cs)
 {
 	proto_radius_load_t	*inst = talloc_get_type_abort(instance, proto_radius_load_t);
 	RADCLIENT		*client;
 
-	bool			done;
-	VALUE_PAIR		*vp, *vps = NULL;
-	ssize_t			packet_len;
-	int			code = FR_CODE_ACCESS_REQUEST;
-
 	inst->client = client = talloc_zero(inst, RADCLIENT);
 	if (!inst->client) return 0;
 
@@ -383,49 +691,55 @@ static int mod_instantiate(void *instance, CONF_SECTION *cs)
 	client->src_ipaddr = client->ipaddr;
 
 	client->longname = client->shortname = inst->filename;
-	client->secret = talloc_strdup(client, "testing123");
+	client->secret = talloc_strdup(client, inst->secret);
+	client_secret_md5_init(client);
 	client->nas_type = talloc_strdup(client, "load");
 	client->use_connected = false;
 
 	if (inst->filename) {
-		FILE *fp;
+		FILE	*fp;
+		int	ret;
+
+		switch (inst->format) {
+#ifdef HAVE_LIBPCAP
+		case LOAD_FORMAT_PCAP:
+			if (load_pcap_read(inst, cs) < 0) return -1;
+			break;
+#endif
+
+		default:
+			fp = fopen(inst->filename, "r");
+			if (!fp) {
+				cf_log_err(cs, "Failed reading %s - %s",
+					   inst->filename, fr_syserror(errno));
+				return -1;
+			}
+
+			if (inst->format == LOAD_FORMAT_DETAIL) {
+				ret = load_detail_read(inst, cs, fp);
+			} else {
+				ret = load_pairs_read(inst, cs, fp);
+			}
+			fclose(fp);
 
-		fp = fopen(inst->filename, "r");
-		if (!fp) {
-			cf_log_err(cs, "Failed reading %s - %s",
-				   inst->filename, fr_syserror(errno));
-			return -1;
+			if (ret < 0) return -1;
+			break;
 		}
 
-		if (fr_pair_list_afrom_file(inst, dict_radius, &vps, fp, &done) < 0) {
-			cf_log_perr(cs, "Failed reading %s", inst->filename);
-			fclose(fp);
+		if (!inst->packets) {
+			cf_log_err(cs, "No packets found in %s", inst->filename);
 			return -1;
 		}
 
-		fclose(fp);
-	}
-
-	MEM(inst->packet = talloc_zero_array(inst, uint8_t, inst->max_packet_size));
+		cf_log_debug(cs, "Read %zu packets from %s", talloc_array_length(inst->packets), inst->filename);
 
-	vp = fr_pair_find_by_da(vps, attr_packet_type, TAG_ANY);
-	if (vp) code = vp->vp_uint32;
+		return 0;
+	}
 
 	/*
-	 *	Encode the packet.
+	 *	No input file, send empty Access-Requests.
 	 */
-	packet_len = fr_radius_encode(inst->packet, inst->max_packet_size, NULL,
-				      client->secret, talloc_array_length(client->secret),
-				      code, 0, vps);
-	if (packet_len <= 0) {
-		cf_log_perr(cs, "Failed encoding packet from %s",
-			    inst->filename);
-		return -1;
-	}
-
-	inst->packet_len = packet_len;
-
-	return 0;
+	return load_packet_add(inst, cs, NULL, FR_CODE_ACCESS_REQUEST);
 }
 
 fr_app_io_t proto_radius_load = {
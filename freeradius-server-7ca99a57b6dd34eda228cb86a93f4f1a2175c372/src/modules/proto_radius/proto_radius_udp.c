@@ -44,6 +44,8 @@ typedef struct {
 
 	fr_io_address_t			*connection;		//!< for connected sockets.
 
+	fr_udp_batch_t			*batch;			//!< for reading and writing many packets at once.
+
 	fr_stats_t			stats;			//!< statistics for this socket
 } proto_radius_udp_thread_t;
 
@@ -61,6 +63,12 @@ typedef struct {
 	uint32_t			max_packet_size;	//!< for message ring buffer.
 	uint32_t			max_attributes;		//!< Limit maximum decodable attributes.
 
+	uint32_t			batch;			//!< How many packets to read or write per system call.
+
+	uint32_t			num_sockets;		//!< How many sockets to open on this address.
+	uint32_t			steering;		//!< a fr_socket_steer_t, how the kernel
+								//!< spreads packets across the sockets.
+
 	uint16_t			port;			//!< Port to listen on.
 
 	bool				recv_buff_is_set;	//!< Whether we were provided with a recv_buff
@@ -104,6 +112,13 @@ static const CONF_PARSER udp_listen_config[] = {
 	{ FR_CONF_OFFSET("max_packet_size", FR_TYPE_UINT32, proto_radius_udp_t, max_packet_size), .dflt = "4096" } ,
        	{ FR_CONF_OFFSET("max_attributes", FR_TYPE_UINT32, proto_radius_udp_t, max_attributes), .dflt = STRINGIFY(RADIUS_MAX_ATTRIBUTES) } ,
 
+	{ FR_CONF_OFFSET("batch", FR_TYPE_UINT32, proto_radius_udp_t, batch), .dflt = "0" } ,
+
+	{ FR_CONF_OFFSET("num_sockets", FR_TYPE_UINT32, proto_radius_udp_t, num_sockets), .dflt = "1" } ,
+	{ FR_CONF_OFFSET("steering", FR_TYPE_UINT32, proto_radius_udp_t, steering), .dflt = "flow",
+	  .func = cf_table_parse_uint32,
+	  .uctx = &(cf_table_parse_ctx_t){ .table = fr_socket_steer_table, .len = &fr_socket_steer_table_len } },
+
 	CONF_PARSER_TERMINATOR
 };
 
@@ -119,8 +134,6 @@ static ssize_t mod_read(fr_listen_t *li, void **packet_ctx, fr_time_t *recv_time
 	size_t				packet_len;
 	decode_fail_t			reason;
 
-	*leftover = 0;		/* always for UDP */
-
 	/*
 	 *	Where the addresses should go.  This is a special case
 	 *	for proto_radius.
@@ -128,6 +141,22 @@ static ssize_t mod_read(fr_listen_t *li, void **packet_ctx, fr_time_t *recv_time
 	address_p = (fr_io_address_t **) packet_ctx;
 	address = *address_p;
 
+	/*
+	 *	Read many packets at once, and let the network side
+	 *	walk through them.  "leftover" is the rest of the
+	 *	batch.
+	 */
+	if (thread->batch && !thread->connection) {
+		data_size = udp_batch_recv(thread->batch, thread->sockfd,
+					   buffer, buffer_len, li->default_message_size, leftover,
+					   &address->src_ipaddr, &address->src_port,
+					   &address->dst_ipaddr, &address->dst_port,
+					   &address->if_index, recv_time_p);
+		goto check;
+	}
+
+	*leftover = 0;		/* always for UDP */
+
 	/*
 	 *      Tell udp_recv if we're connected or not.
 	 */
@@ -137,6 +166,8 @@ static ssize_t mod_read(fr_listen_t *li, void **packet_ctx, fr_time_t *recv_time
 			     &address->src_ipaddr, &address->src_port,
 			     &address->dst_ipaddr, &address->dst_port,
 			     &address->if_index, recv_time_p);
+
+check:
 	if (data_size < 0) {
 		PDEBUG2("proto_radius_udp got read error");
 		return data_size;
@@ -194,6 +225,27 @@ static ssize_t mod_read(fr_listen_t *li, void **packet_ctx, fr_time_t *recv_time
 }
 
 
+/** Send a reply, or queue it for mod_flush() if we're batching writes
+ *
+ */
+static ssize_t mod_send(proto_radius_udp_thread_t *thread, int flags, uint8_t *buffer, size_t buffer_len,
+			fr_io_address_t const *address)
+{
+	if (thread->batch && !flags) {
+		if (udp_batch_send(thread->batch, thread->sockfd, buffer, buffer_len,
+				   &address->dst_ipaddr, address->dst_port,
+				   address->if_index,
+				   &address->src_ipaddr, address->src_port) < 0) return -1;
+
+		return buffer_len;
+	}
+
+	return udp_send(thread->sockfd, buffer, buffer_len, flags,
+			&address->dst_ipaddr, address->dst_port,
+			address->if_index,
+			&address->src_ipaddr, address->src_port);
+}
+
 static ssize_t mod_write(fr_listen_t *li, void *packet_ctx, UNUSED fr_time_t request_time,
 			 uint8_t *buffer, size_t buffer_len, UNUSED size_t written)
 {
@@ -230,10 +282,7 @@ static ssize_t mod_write(fr_listen_t *li, void *packet_ctx, UNUSED fr_time_t req
 
 			memcpy(&packet, &track->reply, sizeof(packet)); /* const issues */
 
-			(void) udp_send(thread->sockfd, packet, track->reply_len, flags,
-					&address->dst_ipaddr, address->dst_port,
-					address->if_index,
-					&address->src_ipaddr, address->src_port);
+			(void) mod_send(thread, flags, (uint8_t *) packet, track->reply_len, address);
 		}
 
 		return buffer_len;
@@ -248,10 +297,7 @@ static ssize_t mod_write(fr_listen_t *li, void *packet_ctx, UNUSED fr_time_t req
 	 *	Only write replies if they're RADIUS packets.
 	 *	sometimes we want to NOT send a reply...
 	 */
-	data_size = udp_send(thread->sockfd, buffer, buffer_len, flags,
-			     &address->dst_ipaddr, address->dst_port,
-			     address->if_index,
-			     &address->src_ipaddr, address->src_port);
+	data_size = mod_send(thread, flags, buffer, buffer_len, address);
 
 	/*
 	 *	This socket is dead.  That's an error...
@@ -270,6 +316,33 @@ static ssize_t mod_write(fr_listen_t *li, void *packet_ctx, UNUSED fr_time_t req
 }
 
 
+/** Send all of the replies which mod_write() has queued
+ *
+ * @return
+ *	- 0 on success, or if the replies which failed were discarded.
+ *	- < 0 with errno set to EWOULDBLOCK if replies are still queued.
+ */
+static int mod_flush(fr_listen_t *li)
+{
+	proto_radius_udp_thread_t	*thread = talloc_get_type_abort(li->thread_instance, proto_radius_udp_thread_t);
+
+	if (!thread->batch) return 0;
+
+	if (udp_batch_flush(thread->batch, thread->sockfd) < 0) {
+		/*
+		 *	The replies are still queued.  Tell the
+		 *	network side to call us again when the
+		 *	socket is writable.
+		 */
+		if (errno == EWOULDBLOCK) return -1;
+
+		RATE_LIMIT_GLOBAL(PERROR, "proto_radius_udp failed sending replies");
+	}
+
+	return 0;
+}
+
+
 static int mod_connection_set(fr_listen_t *li, fr_io_address_t *connection)
 {
 	proto_radius_udp_thread_t	*thread = talloc_get_type_abort(li->thread_instance, proto_radius_udp_thread_t);
@@ -350,8 +423,37 @@ static int mod_open(fr_listen_t *li)
 		goto error;
 	}
 
+	/*
+	 *	The master opens the other sockets which share this
+	 *	address.  The steering program is for the whole
+	 *	group, so only the first socket sets it.
+	 */
+	if (!li->connected && (li->shard == 0)) {
+		li->num_shards = inst->num_sockets;
+
+		if (fr_socket_server_steer(sockfd, inst->ipaddr.af, inst->steering, inst->num_sockets) < 0) {
+			close(sockfd);
+			PERROR("Failed setting packet steering");
+			goto error;
+		}
+	}
+
 	thread->sockfd = sockfd;
 
+	/*
+	 *	Connected sockets get one packet at a time.
+	 */
+	if ((inst->batch > 1) && !li->connected) {
+		thread->batch = udp_batch_alloc(thread, inst->batch, inst->max_packet_size);
+		if (!thread->batch) {
+			close(sockfd);
+			PERROR("Failed allocating batch");
+			goto error;
+		}
+
+		li->read_batch = inst->batch;
+	}
+
 	fr_assert((cf_parent(inst->cs) != NULL) && (cf_parent(cf_parent(inst->cs)) != NULL));	/* listen { ... } */
 
 	thread->name = fr_app_io_socket_name(thread, &proto_radius_udp,
@@ -454,6 +556,11 @@ static int mod_bootstrap(void *instance, CONF_SECTION *cs)
 	FR_INTEGER_BOUND_CHECK("max_packet_size", inst->max_packet_size, >=, 20);
 	FR_INTEGER_BOUND_CHECK("max_packet_size", inst->max_packet_size, <=, 65536);
 
+	FR_INTEGER_BOUND_CHECK("num_sockets", inst->num_sockets, >=, 1);
+	FR_INTEGER_BOUND_CHECK("num_sockets", inst->num_sockets, <=, 64);
+
+	FR_INTEGER_BOUND_CHECK("batch", inst->batch, <=, 64);
+
 	if (!inst->port) {
 		struct servent *s;
 
@@ -543,6 +650,7 @@ fr_app_io_t proto_radius_udp = {
 	.open			= mod_open,
 	.read			= mod_read,
 	.write			= mod_write,
+	.flush			= mod_flush,
 	.fd_set			= mod_fd_set,
 	.track			= mod_track_create,
 	.compare		= mod_compare,
@@ -241,6 +241,7 @@ static int mod_decode(void const *instance, REQUEST *request, uint8_t *const dat
 	fr_io_address_t const  	*address = track->address;
 	RADCLIENT const		*client;
 	fr_tacacs_packet_t const *pkt = (fr_tacacs_packet_t const *)data;
+	VALUE_PAIR		*vps = NULL;
 
 	RHEXDUMP3(data, data_len, "proto_tacacs decode packet");
 
@@ -295,10 +296,12 @@ static int mod_decode(void const *instance, REQUEST *request, uint8_t *const dat
 	 */
 	if (fr_tacacs_decode(request->packet, request->packet->data, request->packet->data_len,
 			     NULL, client->secret, talloc_array_length(client->secret) - 1,
-			     &request->packet->vps) < 0) {
+			     &vps) < 0) {
 		RPEDEBUG("Failed decoding packet");
+		fr_pair_list_free(&vps);
 		return -1;
 	}
+	fr_pair_list_append(&request->packet->vps, vps);
 
 	/*
 	 *	Set the rest of the fields.
@@ -332,7 +335,7 @@ static int mod_decode(void const *instance, REQUEST *request, uint8_t *const dat
 
 		fr_assert(client->dynamic);
 
-		for (vp = fr_cursor_init(&cursor, &request->packet->vps);
+		for (vp = fr_pair_list_cursor_init(&cursor, &request->packet->vps);
 		     vp != NULL;
 		     vp = fr_cursor_next(&cursor)) {
 			if (vp->da->flags.subtype != FLAG_ENCRYPT_NONE) {
@@ -371,7 +374,7 @@ static int mod_decode(void const *instance, REQUEST *request, uint8_t *const dat
 		       request->packet->data_len,
 		       request->async->listen->name);
 
-		log_request_pair_list(L_DBG_LVL_1, request, request->packet->vps, "");
+		log_request_pair_list(L_DBG_LVL_1, request, fr_pair_list_head(&request->packet->vps), "");
 	}
 
 	if (!inst->io.app_io->decode) return 0;
@@ -451,7 +454,7 @@ static ssize_t mod_encode(void const *instance, REQUEST *request, uint8_t *buffe
 
 	data_len = fr_tacacs_encode(buffer, buffer_len, request->packet->data,
 				    client->secret, talloc_array_length(client->secret) - 1,
-				    request->reply->vps);
+				    fr_pair_list_head(&request->reply->vps));
 	if (data_len < 0) {
 		RPEDEBUG("Failed encoding TACACS+ reply");
 		return -1;
@@ -468,7 +471,7 @@ static ssize_t mod_encode(void const *instance, REQUEST *request, uint8_t *buffe
 		       data_len,
 		       request->async->listen->name);
 
-		log_request_pair_list(L_DBG_LVL_1, request, request->reply->vps, "");
+		log_request_pair_list(L_DBG_LVL_1, request, fr_pair_list_head(&request->reply->vps), "");
 	}
 
 	RHEXDUMP3(buffer, data_len, "proto_tacacs encode packet");
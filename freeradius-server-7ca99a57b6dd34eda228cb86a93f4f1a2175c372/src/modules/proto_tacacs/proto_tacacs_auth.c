@@ -131,7 +131,7 @@ static void authentication_failed(REQUEST *request, char const *msg)
 	/*
 	 *	Set the server reply message.  Note that we do not tell the user *why* they failed authentication.
 	 */
-	if (!fr_pair_find_by_da(request->reply->vps, attr_tacacs_server_message, TAG_ANY)) {
+	if (!fr_pair_list_find_by_da(&request->reply->vps, attr_tacacs_server_message, TAG_ANY)) {
 		MEM(pair_update_reply(&vp, attr_tacacs_server_message) >= 0);
 		fr_pair_value_strdup(vp, "Authentication failed");
 	}
@@ -219,7 +219,7 @@ static rlm_rcode_t mod_process(module_ctx_t const *mctx, REQUEST *request)
 		 *	Find TACACS-Authentication-Type, and complain if they have too many.
 		 */
 		auth_type = NULL;
-		for (vp = fr_cursor_iter_by_da_init(&cursor, &request->control, attr_auth_type);
+		for (vp = fr_pair_list_cursor_by_da_init(&cursor, &request->control, attr_auth_type);
 		     vp;
 		     vp = fr_cursor_next(&cursor)) {
 			if (!auth_type) {
@@ -234,7 +234,7 @@ static rlm_rcode_t mod_process(module_ctx_t const *mctx, REQUEST *request)
 		 *	No Auth-Type, force it to reject.
 		 */
 		if (!auth_type) {
-			vp = fr_pair_find_by_da(request->packet->vps, attr_tacacs_authentication_type, TAG_ANY);
+			vp = fr_pair_list_find_by_da(&request->packet->vps, attr_tacacs_authentication_type, TAG_ANY);
 			if (!vp) {
 				authentication_failed(request, "No Auth-Type or TACACS-Authentication-Type configured: rejecting authentication.");
 				goto setup_send;
@@ -308,7 +308,7 @@ static rlm_rcode_t mod_process(module_ctx_t const *mctx, REQUEST *request)
 			/*
 			 *	Maybe the shared secret is wrong?
 			 */
-			vp = fr_pair_find_by_da(request->packet->vps, attr_tacacs_user_name, TAG_ANY);
+			vp = fr_pair_list_find_by_da(&request->packet->vps, attr_tacacs_user_name, TAG_ANY);
 			if (vp) {
 				if (RDEBUG_ENABLED2) {
 					uint8_t const *p;
@@ -455,9 +455,10 @@ static virtual_server_compile_t compile_list[] = {
 	COMPILE_TERMINATOR
 };
 
-static int mod_instantiate(void *instance, UNUSED CONF_SECTION *process_app_cs)
+static int mod_instantiate(void *instance, CONF_SECTION *process_app_cs)
 {
 	proto_tacacs_auth_t	*inst = instance;
+	CONF_SECTION		*server_cs;
 
 	/*
 	 *	Usually we use the 'State' attribute. But, in this
@@ -475,6 +476,18 @@ static int mod_instantiate(void *instance, UNUSED CONF_SECTION *process_app_cs)
 	 */
 	inst->state_tree = fr_state_tree_init(inst, attr_tacacs_session_id, main_config->spawn_workers, inst->max_session,
 					      inst->session_timeout, inst->state_server_id);
+	if (!inst->state_tree) {
+		cf_log_err(process_app_cs, "Failed creating state tree");
+		return -1;
+	}
+
+	/*
+	 *	radmin shows the state shards as "stats state <server> self".
+	 */
+	server_cs = cf_item_to_section(cf_parent(cf_item_to_section(cf_parent(process_app_cs))));
+	if (fr_command_register_hook(NULL, cf_section_name2(server_cs), inst->state_tree, cmd_state_table) < 0) {
+		PWARN("Failed registering state statistics for server %s", cf_section_name2(server_cs));
+	}
 
 	return 0;
 }
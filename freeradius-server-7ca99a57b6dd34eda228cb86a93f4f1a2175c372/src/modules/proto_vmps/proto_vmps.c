@@ -230,6 +230,7 @@ static int mod_decode(void const *instance, REQUEST *request, uint8_t *const dat
 	fr_io_address_t const *address = track->address;
 	RADCLIENT const *client;
 	RADIUS_PACKET *packet = request->packet;
+	VALUE_PAIR *vps = NULL;
 
 	fr_assert(data[0] < FR_RADIUS_MAX_PACKET_CODE);
 
@@ -260,10 +261,12 @@ static int mod_decode(void const *instance, REQUEST *request, uint8_t *const dat
 	 *	That MUST be set and checked in the underlying
 	 *	transport, via a call to fr_vqp_ok().
 	 */
-	if (fr_vqp_decode(packet, packet->data, packet->data_len, &packet->vps, &packet->code) < 0) {
+	if (fr_vqp_decode(packet, packet->data, packet->data_len, &vps, &packet->code) < 0) {
 		RPEDEBUG("Failed decoding packet");
+		fr_pair_list_free(&vps);
 		return -1;
 	}
+	fr_pair_list_append(&packet->vps, vps);
 
 	/*
 	 *	Set the rest of the fields.
@@ -372,7 +375,7 @@ static ssize_t mod_encode(void const *instance, REQUEST *request, uint8_t *buffe
 #endif
 
 	data_len = fr_vqp_encode(buffer, buffer_len, request->packet->data,
-				  request->reply->code, request->reply->id, request->reply->vps);
+				  request->reply->code, request->reply->id, fr_pair_list_head(&request->reply->vps));
 	if (data_len < 0) {
 		RPEDEBUG("Failed encoding VMPS reply");
 		return -1;
@@ -62,6 +62,10 @@ typedef struct {
 
 	uint32_t			max_packet_size;	//!< for message ring buffer.
 
+	uint32_t			num_sockets;		//!< How many sockets to open on this address.
+	uint32_t			steering;		//!< a fr_socket_steer_t, how the kernel
+								//!< spreads packets across the sockets.
+
 	uint16_t			port;			//!< Port to listen on.
 
 	bool				recv_buff_is_set;	//!< Whether we were provided with a receive
@@ -100,6 +104,11 @@ static const CONF_PARSER udp_listen_config[] = {
 
 	{ FR_CONF_OFFSET("max_packet_size", FR_TYPE_UINT32, proto_vmps_udp_t, max_packet_size), .dflt = "1024" } ,
 
+	{ FR_CONF_OFFSET("num_sockets", FR_TYPE_UINT32, proto_vmps_udp_t, num_sockets), .dflt = "1" } ,
+	{ FR_CONF_OFFSET("steering", FR_TYPE_UINT32, proto_vmps_udp_t, steering), .dflt = "flow",
+	  .func = cf_table_parse_uint32,
+	  .uctx = &(cf_table_parse_ctx_t){ .table = fr_socket_steer_table, .len = &fr_socket_steer_table_len } },
+
 	CONF_PARSER_TERMINATOR
 };
 
@@ -334,6 +343,21 @@ static int mod_open(fr_listen_t *li)
 		goto error;
 	}
 
+	/*
+	 *	The master opens the other sockets which share this
+	 *	address.  The steering program is for the whole
+	 *	group, so only the first socket sets it.
+	 */
+	if (!li->connected && (li->shard == 0)) {
+		li->num_shards = inst->num_sockets;
+
+		if (fr_socket_server_steer(sockfd, inst->ipaddr.af, inst->steering, inst->num_sockets) < 0) {
+			close(sockfd);
+			PERROR("Failed setting packet steering");
+			goto error;
+		}
+	}
+
 	thread->sockfd = sockfd;
 
 	fr_assert((cf_parent(inst->cs) != NULL) && (cf_parent(cf_parent(inst->cs)) != NULL));	/* listen { ... } */
@@ -408,6 +432,9 @@ static int mod_bootstrap(void *instance, CONF_SECTION *cs)
 	FR_INTEGER_BOUND_CHECK("max_packet_size", inst->max_packet_size, >=, 32);
 	FR_INTEGER_BOUND_CHECK("max_packet_size", inst->max_packet_size, <=, 65536);
 
+	FR_INTEGER_BOUND_CHECK("num_sockets", inst->num_sockets, >=, 1);
+	FR_INTEGER_BOUND_CHECK("num_sockets", inst->num_sockets, <=, 64);
+
 	if (!inst->port) {
 		struct servent *s;
 
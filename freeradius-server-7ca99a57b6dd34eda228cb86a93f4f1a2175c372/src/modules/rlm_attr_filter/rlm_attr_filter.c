@@ -250,7 +250,7 @@ static rlm_rcode_t CC_HINT(nonnull(1,2)) attr_filter_common(void const *instance
 		 *	only if it matches all rules that describe an
 		 *	Idle-Timeout.
 		 */
-		for (input_item = fr_cursor_init(&input, &packet->vps);
+		for (input_item = fr_pair_list_cursor_init(&input, &packet->vps);
 		     input_item;
 		     input_item = fr_cursor_next(&input)) {
 			pass = fail = 0; /* reset the pass,fail vars for each reply item */
@@ -312,8 +312,8 @@ static rlm_rcode_t CC_HINT(nonnull(1,2)) attr_filter_common(void const *instance
 	/*
 	 *	Replace the existing request list with our filtered one
 	 */
-	fr_pair_list_free(&packet->vps);
-	packet->vps = output;
+	fr_pair_list_clear(&packet->vps);
+	fr_pair_list_append(&packet->vps, output);
 
 	return RLM_MODULE_UPDATED;
 
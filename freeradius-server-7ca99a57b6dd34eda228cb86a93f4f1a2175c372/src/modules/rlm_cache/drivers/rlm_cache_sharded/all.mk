@@ -0,0 +1,3 @@
+TARGETNAME	:= rlm_cache_sharded
+TARGET		:= $(TARGETNAME).a
+SOURCES		:= $(TARGETNAME).c
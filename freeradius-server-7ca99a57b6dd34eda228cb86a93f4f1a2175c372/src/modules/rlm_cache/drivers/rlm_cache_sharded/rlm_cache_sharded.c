@@ -0,0 +1,621 @@
+/*
+ *   This program is is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or (at
+ *   your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/**
+ * $Id$
+ * @file rlm_cache_sharded.c
+ * @brief In memory cache, split into independently locked shards.
+ *
+ * Keys are hashed to one of a power of two number of shards.  Each shard
+ * has its own mutex, hash table, expiry heap and eviction list, so
+ * requests for different keys rarely contend.
+ *
+ * Every worker runs a timer which removes expired entries from the
+ * shards, so memory is reclaimed even when no requests arrive.  If
+ * max_entries is set, it is split evenly between the shards, and
+ * inserting into a full shard evicts an entry using the CLOCK (second
+ * chance) algorithm.
+ *
+ * @copyright 2020 The FreeRADIUS server project
+ */
+#define LOG_PREFIX "rlm_cache_sharded - "
+
+#include <freeradius-devel/server/base.h>
+#include <freeradius-devel/util/debug.h>
+#include <freeradius-devel/util/dlist.h>
+#include <freeradius-devel/util/heap.h>
+#include <freeradius-devel/util/swiss.h>
+#include "../../rlm_cache.h"
+
+#ifdef HAVE_STDATOMIC_H
+#  include <stdatomic.h>
+#else
+#  include <freeradius-devel/util/stdatomic.h>
+#endif
+
+typedef struct {
+	pthread_mutex_t		mutex;		//!< Protects everything in the shard except the counters.
+
+	fr_swiss_table_t	*cache;		//!< Entries, keyed on the cache key.
+	fr_heap_t		*heap;		//!< Entries, ordered by expiry time.
+	fr_dlist_head_t		clock;		//!< Entries in eviction order.
+
+	uint32_t		max_entries;	//!< Maximum entries in this shard, 0 means no limit.
+
+	/*
+	 *	Written with the mutex held, but read without it,
+	 *	so stats don't contend with lookups.
+	 */
+	atomic_uint_fast64_t	hits;		//!< Lookups which found a valid entry.
+	atomic_uint_fast64_t	misses;		//!< Lookups which didn't.
+	atomic_uint_fast64_t	evictions;	//!< Entries removed to make space for new ones.
+	atomic_uint_fast64_t	expired;	//!< Entries removed because their TTL passed.
+	atomic_uint_fast64_t	entries;	//!< Entries currently in the shard.
+} rlm_cache_sharded_shard_t;
+
+typedef struct {
+	uint32_t		num_shards;	//!< How many shards to split the cache into.
+	fr_time_delta_t		expire_interval;	//!< How often each worker removes expired entries.
+	uint32_t		expire_max;	//!< Maximum number of entries to expire per shard, per run.
+
+	rlm_cache_sharded_shard_t	*shards;	//!< Array of num_shards shards.
+} rlm_cache_sharded_t;
+
+typedef struct {
+	rlm_cache_sharded_t	*driver;	//!< Instance data.
+	fr_event_list_t		*el;		//!< Worker's event list.
+	fr_event_timer_t const	*ev;		//!< Expiry timer.
+
+	rlm_cache_sharded_shard_t	*locked;	//!< Shard locked by the current request.
+} rlm_cache_sharded_thread_t;
+
+typedef struct {
+	rlm_cache_entry_t	fields;		//!< Entry data.
+	uint32_t		hash;		//!< Hash of the key.
+	int32_t			heap_id;	//!< Offset used for heap.
+	fr_dlist_t		entry;		//!< Entry in the shard's eviction list.
+	bool			referenced;	//!< Entry has been retrieved since the clock last passed it.
+} rlm_cache_sharded_entry_t;
+
+static const CONF_PARSER driver_config[] = {
+	{ FR_CONF_OFFSET("shards", FR_TYPE_UINT32, rlm_cache_sharded_t, num_shards), .dflt = "16" },
+	{ FR_CONF_OFFSET("expire_interval", FR_TYPE_TIME_DELTA, rlm_cache_sharded_t, expire_interval), .dflt = "1.0" },
+	{ FR_CONF_OFFSET("expire_max", FR_TYPE_UINT32, rlm_cache_sharded_t, expire_max), .dflt = "1024" },
+	CONF_PARSER_TERMINATOR
+};
+
+static uint32_t cache_entry_hash(void const *data)
+{
+	rlm_cache_sharded_entry_t const *c = data;
+
+	return c->hash;
+}
+
+/** Compare two entries by key
+ *
+ * There may only be one entry with the same key.
+ */
+static int cache_entry_cmp(void const *one, void const *two)
+{
+	rlm_cache_entry_t const *a = one, *b = two;
+	int ret;
+
+	ret = (a->key_len > b->key_len) - (a->key_len < b->key_len);
+	if (ret != 0) return ret;
+
+	return memcmp(a->key, b->key, a->key_len);
+}
+
+/** Compare two entries by expiry time
+ *
+ * There may be multiple entries with the same expiry time.
+ */
+static int8_t cache_heap_cmp(void const *one, void const *two)
+{
+	rlm_cache_entry_t const *a = one, *b = two;
+
+	return (a->expires > b->expires) - (a->expires < b->expires);
+}
+
+/** Return the shard a key lives in
+ *
+ */
+static inline rlm_cache_sharded_shard_t *cache_shard(rlm_cache_sharded_t const *driver, uint32_t hash)
+{
+	return &driver->shards[hash & (driver->num_shards - 1)];
+}
+
+/** Lock the shard for a key, releasing any other shard the request holds
+ *
+ * The lock is held until the rlm_cache calls #cache_release, as rlm_cache
+ * continues using the entries we return after the find callback returns.
+ */
+static rlm_cache_sharded_shard_t *cache_shard_lock(rlm_cache_sharded_thread_t *thread, uint32_t hash)
+{
+	rlm_cache_sharded_shard_t *shard = cache_shard(thread->driver, hash);
+
+	if (thread->locked == shard) return shard;
+
+	if (thread->locked) pthread_mutex_unlock(&thread->locked->mutex);
+	pthread_mutex_lock(&shard->mutex);
+	thread->locked = shard;
+
+	return shard;
+}
+
+/** Remove an entry from all of the shard's indexes and free it
+ *
+ */
+static void cache_shard_entry_free(rlm_cache_sharded_shard_t *shard, rlm_cache_sharded_entry_t *c)
+{
+	fr_swiss_table_delete(shard->cache, c);
+	fr_heap_extract(shard->heap, c);
+	fr_dlist_remove(&shard->clock, c);
+	talloc_free(c);
+	atomic_fetch_sub_explicit(&shard->entries, 1, memory_order_relaxed);
+}
+
+/** Remove up to max expired entries from a shard
+ *
+ * @return the number of entries removed.
+ */
+static uint32_t cache_shard_expire(rlm_cache_sharded_shard_t *shard, fr_unix_time_t now, uint32_t max)
+{
+	rlm_cache_sharded_entry_t	*c;
+	uint32_t			i;
+
+	for (i = 0; i < max; i++) {
+		c = fr_heap_peek(shard->heap);
+		if (!c || (c->fields.expires >= now)) break;
+
+		cache_shard_entry_free(shard, c);
+	}
+	if (i) atomic_fetch_add_explicit(&shard->expired, i, memory_order_relaxed);
+
+	return i;
+}
+
+/** Evict an entry from a full shard
+ *
+ * Entries which have been retrieved since the clock last passed
+ * them get a second chance, and go to the back of the list.
+ */
+static void cache_shard_evict(rlm_cache_sharded_shard_t *shard)
+{
+	rlm_cache_sharded_entry_t *c;
+
+	while ((c = fr_dlist_head(&shard->clock))) {
+		if (!c->referenced) {
+			cache_shard_entry_free(shard, c);
+			atomic_fetch_add_explicit(&shard->evictions, 1, memory_order_relaxed);
+			return;
+		}
+
+		c->referenced = false;
+		fr_dlist_remove(&shard->clock, c);
+		fr_dlist_insert_tail(&shard->clock, c);
+	}
+}
+
+/** Remove expired entries from every shard
+ *
+ * Shards which are busy are skipped, they'll be checked again the
+ * next time the timer fires.
+ */
+static void _cache_expire_timer(fr_event_list_t *el, fr_time_t now, void *uctx)
+{
+	rlm_cache_sharded_thread_t	*thread = talloc_get_type_abort(uctx, rlm_cache_sharded_thread_t);
+	rlm_cache_sharded_t		*driver = thread->driver;
+	uint32_t			i, expired = 0;
+
+	for (i = 0; i < driver->num_shards; i++) {
+		rlm_cache_sharded_shard_t *shard = &driver->shards[i];
+
+		if (pthread_mutex_trylock(&shard->mutex) != 0) continue;
+		expired += cache_shard_expire(shard, fr_time_to_unix_time(now), driver->expire_max);
+		pthread_mutex_unlock(&shard->mutex);
+	}
+
+	if (expired) DEBUG3("Expired %u entries", expired);
+
+	if (fr_event_timer_in(thread, el, &thread->ev, driver->expire_interval, _cache_expire_timer, thread) < 0) {
+		ERROR("Failed inserting expiry timer");
+	}
+}
+
+/** Walk over a shard's entries
+ *
+ * Used to free any entries left in the shard on detach.
+ */
+static int _cache_entry_free(UNUSED void *ctx, void *data)
+{
+	talloc_free(data);
+
+	return 0;
+}
+
+/** Cleanup a cache_sharded instance
+ *
+ */
+static int mod_detach(void *instance)
+{
+	rlm_cache_sharded_t	*driver = talloc_get_type_abort(instance, rlm_cache_sharded_t);
+	uint32_t		i;
+
+	if (!driver->shards) return 0;
+
+	for (i = 0; i < driver->num_shards; i++) {
+		rlm_cache_sharded_shard_t *shard = &driver->shards[i];
+
+		if (!shard->cache) continue;
+
+		fr_swiss_table_walk(shard->cache, _cache_entry_free, NULL);
+		pthread_mutex_destroy(&shard->mutex);
+	}
+	TALLOC_FREE(driver->shards);
+
+	return 0;
+}
+
+/** Create a new cache_sharded instance
+ *
+ * @param instance	A uint8_t array of inst_size if inst_size > 0, else NULL,
+ *			this should contain the result of parsing the driver's
+ *			CONF_PARSER array that it specified in the interface struct.
+ * @param conf		section holding driver specific #CONF_PAIR (s).
+ * @return
+ *	- 0 on success.
+ *	- -1 on failure.
+ */
+static int mod_instantiate(void *instance, CONF_SECTION *conf)
+{
+	rlm_cache_sharded_t		*driver = talloc_get_type_abort(instance, rlm_cache_sharded_t);
+	rlm_cache_config_t const	*config = dl_module_parent_data_by_child_data(instance);
+	uint32_t			i;
+
+	FR_INTEGER_BOUND_CHECK("shards", driver->num_shards, >=, 1);
+	FR_INTEGER_BOUND_CHECK("shards", driver->num_shards, <=, 1024);
+	FR_INTEGER_BOUND_CHECK("expire_max", driver->expire_max, >=, 1);
+	FR_TIME_DELTA_BOUND_CHECK("expire_interval", driver->expire_interval, >=, fr_time_delta_from_msec(10));
+
+	/*
+	 *	We pick shards by masking the hash.
+	 */
+	if ((driver->num_shards & (driver->num_shards - 1)) != 0) {
+		cf_log_err(conf, "'shards' must be a power of 2");
+		return -1;
+	}
+
+	/*
+	 *	Don't create shards which can never hold anything.
+	 */
+	if (config->max_entries && (config->max_entries < driver->num_shards)) {
+		driver->num_shards = 1;
+		while ((driver->num_shards << 1) <= config->max_entries) driver->num_shards <<= 1;
+		cf_log_warn(conf, "Reducing 'shards' to %u, to match max_entries", driver->num_shards);
+	}
+
+	MEM(driver->shards = talloc_zero_array(driver, rlm_cache_sharded_shard_t, driver->num_shards));
+
+	for (i = 0; i < driver->num_shards; i++) {
+		rlm_cache_sharded_shard_t *shard = &driver->shards[i];
+
+		shard->max_entries = (config->max_entries + driver->num_shards - 1) / driver->num_shards;
+
+		shard->cache = fr_swiss_table_create(driver->shards, cache_entry_hash, cache_entry_cmp, NULL);
+		if (!shard->cache) {
+			ERROR("Failed to create cache");
+			return -1;
+		}
+
+		shard->heap = fr_heap_talloc_alloc(driver->shards, cache_heap_cmp, rlm_cache_sharded_entry_t, heap_id);
+		if (!shard->heap) {
+			ERROR("Failed to create heap for the cache");
+			return -1;
+		}
+
+		fr_dlist_talloc_init(&shard->clock, rlm_cache_sharded_entry_t, entry);
+
+		if (pthread_mutex_init(&shard->mutex, NULL) < 0) {
+			ERROR("Failed initializing mutex: %s", fr_syserror(errno));
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/** Start the expiry timer for this worker
+ *
+ */
+static int mod_thread_instantiate(UNUSED CONF_SECTION const *conf, void *instance,
+				  fr_event_list_t *el, void *thread)
+{
+	rlm_cache_sharded_thread_t *t = talloc_get_type_abort(thread, rlm_cache_sharded_thread_t);
+
+	t->driver = talloc_get_type_abort(instance, rlm_cache_sharded_t);
+	t->el = el;
+
+	if (fr_event_timer_in(t, el, &t->ev, t->driver->expire_interval, _cache_expire_timer, t) < 0) {
+		ERROR("Failed inserting expiry timer");
+		return -1;
+	}
+
+	return 0;
+}
+
+/** Stop the expiry timer for this worker
+ *
+ */
+static int mod_thread_detach(UNUSED fr_event_list_t *el, void *thread)
+{
+	rlm_cache_sharded_thread_t *t = talloc_get_type_abort(thread, rlm_cache_sharded_thread_t);
+
+	fr_event_timer_delete(&t->ev);
+
+	return 0;
+}
+
+/** Custom allocation function for the driver
+ *
+ * Allows allocation of cache entry structures with additional fields.
+ *
+ * @copydetails cache_entry_alloc_t
+ */
+static rlm_cache_entry_t *cache_entry_alloc(UNUSED rlm_cache_config_t const *config, UNUSED void *instance,
+					    REQUEST *request)
+{
+	rlm_cache_sharded_entry_t *c;
+
+	c = talloc_zero(NULL, rlm_cache_sharded_entry_t);
+	if (!c) {
+		RERROR("Failed allocating cache entry");
+		return NULL;
+	}
+	c->heap_id = -1;
+
+	return (rlm_cache_entry_t *)c;
+}
+
+/** Locate a cache entry
+ *
+ * Expired entries are removed and reported as a miss.
+ *
+ * @copydetails cache_entry_find_t
+ */
+static cache_status_t cache_entry_find(rlm_cache_entry_t **out,
+				       UNUSED rlm_cache_config_t const *config, UNUSED void *instance,
+				       REQUEST *request, void *handle, uint8_t const *key, size_t key_len)
+{
+	rlm_cache_sharded_thread_t	*thread = talloc_get_type_abort(handle, rlm_cache_sharded_thread_t);
+	rlm_cache_sharded_shard_t	*shard;
+	rlm_cache_sharded_entry_t	*c, find = { .fields = { .key = key, .key_len = key_len } };
+
+	find.hash = fr_hash(key, key_len);
+	shard = cache_shard_lock(thread, find.hash);
+
+	c = fr_swiss_table_finddata(shard->cache, &find);
+	if (c && (c->fields.expires < fr_time_to_unix_time(request->packet->timestamp))) {
+		cache_shard_entry_free(shard, c);
+		atomic_fetch_add_explicit(&shard->expired, 1, memory_order_relaxed);
+		c = NULL;
+	}
+
+	if (!c) {
+		atomic_fetch_add_explicit(&shard->misses, 1, memory_order_relaxed);
+		*out = NULL;
+		return CACHE_MISS;
+	}
+
+	atomic_fetch_add_explicit(&shard->hits, 1, memory_order_relaxed);
+	c->referenced = true;
+	*out = &c->fields;
+
+	return CACHE_OK;
+}
+
+/** Free an entry and remove it from the data store
+ *
+ * @copydetails cache_entry_expire_t
+ */
+static cache_status_t cache_entry_expire(UNUSED rlm_cache_config_t const *config, UNUSED void *instance,
+					 REQUEST *request, void *handle,
+					 uint8_t const *key, size_t key_len)
+{
+	rlm_cache_sharded_thread_t	*thread = talloc_get_type_abort(handle, rlm_cache_sharded_thread_t);
+	rlm_cache_sharded_shard_t	*shard;
+	rlm_cache_sharded_entry_t	*c, find = { .fields = { .key = key, .key_len = key_len } };
+
+	if (!request) return CACHE_ERROR;
+
+	find.hash = fr_hash(key, key_len);
+	shard = cache_shard_lock(thread, find.hash);
+
+	c = fr_swiss_table_finddata(shard->cache, &find);
+	if (!c) return CACHE_MISS;
+
+	cache_shard_entry_free(shard, c);
+
+	return CACHE_OK;
+}
+
+/** Insert a new entry into the data store
+ *
+ * Existing entries with the same key are replaced.  If the shard is
+ * full, another entry is evicted to make space.
+ *
+ * @copydetails cache_entry_insert_t
+ */
+static cache_status_t cache_entry_insert(UNUSED rlm_cache_config_t const *config, UNUSED void *instance,
+					 REQUEST *request, void *handle,
+					 rlm_cache_entry_t const *c)
+{
+	rlm_cache_sharded_thread_t	*thread = talloc_get_type_abort(handle, rlm_cache_sharded_thread_t);
+	rlm_cache_sharded_shard_t	*shard;
+	rlm_cache_sharded_entry_t	*my_c, *old;
+
+	if (!request) return CACHE_ERROR;
+
+	memcpy(&my_c, &c, sizeof(my_c));
+
+	my_c->hash = fr_hash(c->key, c->key_len);
+	shard = cache_shard_lock(thread, my_c->hash);
+
+	/*
+	 *	Allow overwriting
+	 */
+	old = fr_swiss_table_finddata(shard->cache, my_c);
+	if (old) cache_shard_entry_free(shard, old);
+
+	if (shard->max_entries && ((uint32_t)fr_swiss_table_num_elements(shard->cache) >= shard->max_entries)) {
+		if (cache_shard_expire(shard, fr_time_to_unix_time(request->packet->timestamp), 1) == 0) {
+			cache_shard_evict(shard);
+		}
+	}
+
+	if (fr_swiss_table_insert(shard->cache, my_c) != 1) {
+		RERROR("Failed adding entry");
+		return CACHE_ERROR;
+	}
+
+	if (fr_heap_insert(shard->heap, my_c) < 0) {
+		fr_swiss_table_delete(shard->cache, my_c);
+		RERROR("Failed adding entry to expiry heap");
+		return CACHE_ERROR;
+	}
+
+	my_c->referenced = false;
+	fr_dlist_insert_tail(&shard->clock, my_c);
+	atomic_fetch_add_explicit(&shard->entries, 1, memory_order_relaxed);
+
+	return CACHE_OK;
+}
+
+/** Update the TTL of an entry
+ *
+ * @copydetails cache_entry_set_ttl_t
+ */
+static cache_status_t cache_entry_set_ttl(UNUSED rlm_cache_config_t const *config, UNUSED void *instance,
+					  REQUEST *request, void *handle,
+					  rlm_cache_entry_t *c)
+{
+	rlm_cache_sharded_thread_t	*thread = talloc_get_type_abort(handle, rlm_cache_sharded_thread_t);
+	rlm_cache_sharded_entry_t	*my_c = (rlm_cache_sharded_entry_t *)c;
+	rlm_cache_sharded_shard_t	*shard;
+
+#ifdef NDEBUG
+	if (!request) return CACHE_ERROR;
+#endif
+
+	shard = cache_shard_lock(thread, my_c->hash);
+
+	if (!fr_cond_assert(fr_heap_extract(shard->heap, my_c) == 0)) {
+		RERROR("Entry not in heap");
+		return CACHE_ERROR;
+	}
+
+	if (fr_heap_insert(shard->heap, my_c) < 0) {
+		cache_shard_entry_free(shard, my_c);	/* make sure we don't leak entries... */
+		RERROR("Failed updating entry TTL.  Entry was forcefully expired");
+		return CACHE_ERROR;
+	}
+	return CACHE_OK;
+}
+
+/** Sum the counters of all shards
+ *
+ * No locks are taken, so the totals may be slightly out of date if
+ * other workers are using the cache, but reading them never blocks.
+ *
+ * @copydetails cache_stats_t
+ */
+static void cache_stats(rlm_cache_stats_t *out, UNUSED rlm_cache_config_t const *config, void *instance)
+{
+	rlm_cache_sharded_t	*driver = talloc_get_type_abort(instance, rlm_cache_sharded_t);
+	uint32_t		i;
+
+	memset(out, 0, sizeof(*out));
+
+	for (i = 0; i < driver->num_shards; i++) {
+		rlm_cache_sharded_shard_t *shard = &driver->shards[i];
+
+		out->hits += atomic_load_explicit(&shard->hits, memory_order_relaxed);
+		out->misses += atomic_load_explicit(&shard->misses, memory_order_relaxed);
+		out->evictions += atomic_load_explicit(&shard->evictions, memory_order_relaxed);
+		out->expired += atomic_load_explicit(&shard->expired, memory_order_relaxed);
+		out->entries += atomic_load_explicit(&shard->entries, memory_order_relaxed);
+	}
+}
+
+/** Get the per-worker handle
+ *
+ * No locks are taken here, the shard is only known once we see the key.
+ *
+ * @copydetails cache_acquire_t
+ */
+static int cache_acquire(void **handle, UNUSED rlm_cache_config_t const *config, void *instance,
+			 UNUSED REQUEST *request)
+{
+	module_thread_instance_t	*ti = module_thread_by_data(instance);
+	rlm_cache_sharded_thread_t	*thread = talloc_get_type_abort(ti->data, rlm_cache_sharded_thread_t);
+
+	fr_assert(!thread->locked);
+
+	*handle = thread;
+
+	return 0;
+}
+
+/** Unlock the shard the request used
+ *
+ * @copydetails cache_release_t
+ */
+static void cache_release(UNUSED rlm_cache_config_t const *config, UNUSED void *instance, REQUEST *request,
+			  rlm_cache_handle_t *handle)
+{
+	rlm_cache_sharded_thread_t *thread = talloc_get_type_abort(handle, rlm_cache_sharded_thread_t);
+
+	if (!thread->locked) return;
+
+	pthread_mutex_unlock(&thread->locked->mutex);
+	thread->locked = NULL;
+
+	RDEBUG3("Mutex released");
+}
+
+extern rlm_cache_driver_t rlm_cache_sharded;
+rlm_cache_driver_t rlm_cache_sharded = {
+	.name			= "rlm_cache_sharded",
+	.magic			= RLM_MODULE_INIT,
+	.config			= driver_config,
+	.instantiate		= mod_instantiate,
+	.detach			= mod_detach,
+	.inst_size		= sizeof(rlm_cache_sharded_t),
+	.thread_instantiate	= mod_thread_instantiate,
+	.thread_detach		= mod_thread_detach,
+	.thread_inst_size	= sizeof(rlm_cache_sharded_thread_t),
+	.thread_inst_type	= "rlm_cache_sharded_thread_t",
+	.alloc			= cache_entry_alloc,
+
+	.find			= cache_entry_find,
+	.insert			= cache_entry_insert,
+	.expire			= cache_entry_expire,
+	.set_ttl		= cache_entry_set_ttl,
+	.stats			= cache_stats,
+
+	.acquire		= cache_acquire,
+	.release		= cache_release,
+};
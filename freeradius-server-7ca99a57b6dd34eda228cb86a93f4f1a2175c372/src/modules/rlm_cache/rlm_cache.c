@@ -62,6 +62,11 @@ static fr_dict_attr_t const *attr_cache_allow_merge;
 static fr_dict_attr_t const *attr_cache_allow_insert;
 static fr_dict_attr_t const *attr_cache_ttl;
 static fr_dict_attr_t const *attr_cache_entry_hits;
+static fr_dict_attr_t const *attr_cache_hits;
+static fr_dict_attr_t const *attr_cache_misses;
+static fr_dict_attr_t const *attr_cache_evictions;
+static fr_dict_attr_t const *attr_cache_entries;
+static fr_dict_attr_t const *attr_cache_expired;
 
 extern fr_dict_attr_autoload_t rlm_cache_dict_attr[];
 fr_dict_attr_autoload_t rlm_cache_dict_attr[] = {
@@ -71,6 +76,11 @@ fr_dict_attr_autoload_t rlm_cache_dict_attr[] = {
 	{ .out = &attr_cache_allow_insert, .name = "Cache-Allow-Insert", .type = FR_TYPE_BOOL, .dict = &dict_freeradius },
 	{ .out = &attr_cache_ttl, .name = "Cache-TTL", .type = FR_TYPE_INT32, .dict = &dict_freeradius },
 	{ .out = &attr_cache_entry_hits, .name = "Cache-Entry-Hits", .type = FR_TYPE_UINT32, .dict = &dict_freeradius },
+	{ .out = &attr_cache_hits, .name = "Cache-Hits", .type = FR_TYPE_UINT64, .dict = &dict_freeradius },
+	{ .out = &attr_cache_misses, .name = "Cache-Misses", .type = FR_TYPE_UINT64, .dict = &dict_freeradius },
+	{ .out = &attr_cache_evictions, .name = "Cache-Evictions", .type = FR_TYPE_UINT64, .dict = &dict_freeradius },
+	{ .out = &attr_cache_entries, .name = "Cache-Entries", .type = FR_TYPE_UINT64, .dict = &dict_freeradius },
+	{ .out = &attr_cache_expired, .name = "Cache-Expired", .type = FR_TYPE_UINT64, .dict = &dict_freeradius },
 	{ NULL }
 };
 
@@ -427,7 +437,7 @@ static rlm_rcode_t cache_insert(rlm_cache_t const *inst, REQUEST *request, rlm_c
 	/*
 	 *	Check to see if we need to merge the entry into the request
 	 */
-	vp = fr_pair_find_by_da(request->control, attr_cache_merge_new, TAG_ANY);
+	vp = fr_pair_list_find_by_da(&request->control, attr_cache_merge_new, TAG_ANY);
 	if (vp && vp->vp_bool) merge = true;
 
 	if (merge) cache_merge(inst, request, c);
@@ -507,6 +517,34 @@ static rlm_rcode_t cache_set_ttl(rlm_cache_t const *inst, REQUEST *request,
 	}
 }
 
+/** Add the driver's counters to the request
+ *
+ * Called after the handle has been released, so drivers are free
+ * to lock their datastore to read the counters.
+ */
+static void cache_stats_add(rlm_cache_t const *inst, REQUEST *request)
+{
+	rlm_cache_stats_t	stats;
+	VALUE_PAIR		*vp;
+
+	inst->driver->stats(&stats, &inst->config, inst->driver_inst->dl_inst->data);
+
+	MEM(pair_update_request(&vp, attr_cache_hits) >= 0);
+	vp->vp_uint64 = stats.hits;
+
+	MEM(pair_update_request(&vp, attr_cache_misses) >= 0);
+	vp->vp_uint64 = stats.misses;
+
+	MEM(pair_update_request(&vp, attr_cache_evictions) >= 0);
+	vp->vp_uint64 = stats.evictions;
+
+	MEM(pair_update_request(&vp, attr_cache_entries) >= 0);
+	vp->vp_uint64 = stats.entries;
+
+	MEM(pair_update_request(&vp, attr_cache_expired) >= 0);
+	vp->vp_uint64 = stats.expired;
+}
+
 /** Verify that a map in the cache section makes sense
  *
  */
@@ -564,7 +602,7 @@ static rlm_rcode_t CC_HINT(nonnull) mod_cache_it(module_ctx_t const *mctx, REQUE
 	 *	If Cache-Status-Only == yes, only return whether we found a
 	 *	valid cache entry
 	 */
-	vp = fr_pair_find_by_da(request->control, attr_cache_status_only, TAG_ANY);
+	vp = fr_pair_list_find_by_da(&request->control, attr_cache_status_only, TAG_ANY);
 	if (vp && vp->vp_bool) {
 		RINDENT();
 		RDEBUG3("status-only: yes");
@@ -584,13 +622,13 @@ static rlm_rcode_t CC_HINT(nonnull) mod_cache_it(module_ctx_t const *mctx, REQUE
 	/*
 	 *	Figure out what operation we're doing
 	 */
-	vp = fr_pair_find_by_da(request->control, attr_cache_allow_merge, TAG_ANY);
+	vp = fr_pair_list_find_by_da(&request->control, attr_cache_allow_merge, TAG_ANY);
 	if (vp) merge = vp->vp_bool;
 
-	vp = fr_pair_find_by_da(request->control, attr_cache_allow_insert, TAG_ANY);
+	vp = fr_pair_list_find_by_da(&request->control, attr_cache_allow_insert, TAG_ANY);
 	if (vp) insert = vp->vp_bool;
 
-	vp = fr_pair_find_by_da(request->control, attr_cache_ttl, TAG_ANY);
+	vp = fr_pair_list_find_by_da(&request->control, attr_cache_ttl, TAG_ANY);
 	if (vp) {
 		if (vp->vp_int32 == 0) {
 			expire = true;
@@ -752,10 +790,12 @@ finish:
 	cache_free(inst, &c);
 	cache_release(inst, request, &handle);
 
+	if (inst->config.stats && inst->driver->stats) cache_stats_add(inst, request);
+
 	/*
 	 *	Clear control attributes
 	 */
-	for (vp = fr_cursor_init(&cursor, &request->control);
+	for (vp = fr_pair_list_cursor_init(&cursor, &request->control);
 	     vp;
 	     vp = fr_cursor_next(&cursor)) {
 	     again:
@@ -85,6 +85,17 @@ typedef struct {
 	vp_map_t		*maps;			//!< Head of the maps list.
 } rlm_cache_entry_t;
 
+/** Counters reported by drivers which keep them
+ *
+ */
+typedef struct {
+	uint64_t		hits;			//!< Lookups which found a valid entry.
+	uint64_t		misses;			//!< Lookups which didn't.
+	uint64_t		evictions;		//!< Entries removed to make space for new entries.
+	uint64_t		expired;		//!< Entries removed because their TTL passed.
+	uint64_t		entries;		//!< Entries currently in the cache.
+} rlm_cache_stats_t;
+
 /** Allocate a new cache entry
  *
  */
@@ -219,6 +230,16 @@ typedef cache_status_t	(*cache_entry_set_ttl_t)(rlm_cache_config_t const *config
 typedef uint32_t	(*cache_entry_count_t)(rlm_cache_config_t const *config, void *instance,
 					       REQUEST *request, void *handle);
 
+/** Get the driver's counters
+ *
+ * @note This callback is optional.  It's called after the handle has been released.
+ *
+ * @param[out] out Where to write the counters.
+ * @param[in] config for this instance of the rlm_cache module.
+ * @param[in] instance Driver specific instance data.
+ */
+typedef void		(*cache_stats_t)(rlm_cache_stats_t *out, rlm_cache_config_t const *config, void *instance);
+
 /** Acquire a handle to access the cache
  *
  * @note This callback is optional. If it's not provided the handle argument to other callbacks
@@ -277,6 +298,7 @@ struct rlm_cache_driver_s {
 	cache_entry_set_ttl_t		set_ttl;		//!< (Optional) Update the TTL of an entry.
 	cache_entry_count_t		count;			//!< (Optional) Number of entries currently in
 								//!< the cache.
+	cache_stats_t			stats;			//!< (Optional) Hit, miss and eviction counters.
 
 	cache_acquire_t			acquire;		//!< (optional) Acquire exclusive access to a resource
 								//!< used to retrieve the cache entry.
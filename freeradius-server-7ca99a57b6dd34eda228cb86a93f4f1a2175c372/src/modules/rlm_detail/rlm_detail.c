@@ -30,6 +30,8 @@ RCSID("$Id$")
 #include <freeradius-devel/server/module.h>
 #include <freeradius-devel/util/debug.h>
 #include <freeradius-devel/server/exfile.h>
+#include <freeradius-devel/internal/spool.h>
+#include <freeradius-devel/io/pair.h>
 
 #include <ctype.h>
 #include <fcntl.h>
@@ -45,6 +47,20 @@ RCSID("$Id$")
 
 #define DIRLEN	8192		//!< Maximum path length.
 
+/** What we write to the files
+ *
+ */
+typedef enum {
+	DETAIL_FORMAT_TEXT = 0,		//!< Text detail entries.
+	DETAIL_FORMAT_SPOOL		//!< Binary spool records.
+} detail_format_t;
+
+static fr_table_num_sorted_t const detail_format_table[] = {
+	{ L("detail"),	DETAIL_FORMAT_TEXT	},
+	{ L("spool"),	DETAIL_FORMAT_SPOOL	}
+};
+static size_t detail_format_table_len = NUM_ELEMENTS(detail_format_table);
+
 /** Instance configuration for rlm_detail
  *
  * Holds the configuration and preparsed data for a instance of rlm_detail.
@@ -56,6 +72,7 @@ typedef struct {
 	char const	*group;		//!< Group to use for new files.
 
 	char const	*header;	//!< Header format.
+	uint32_t	format;		//!< detail_format_t to write.
 	bool		locking;	//!< Whether the file should be locked.
 
 	bool		log_srcdst;	//!< Add IP src/dst attributes to entries.
@@ -65,6 +82,8 @@ typedef struct {
 	xlat_escape_legacy_t	escape_func; //!< escape function
 
 	exfile_t    	*ef;		//!< Log file handler
+	exfile_async_conf_t async;	//!< Writer thread configuration.
+	bool		stats;		//!< Add writer thread statistics to the request.
 
 	fr_hash_table_t *ht;		//!< Holds suppressed attributes.
 } rlm_detail_t;
@@ -72,11 +91,17 @@ typedef struct {
 static const CONF_PARSER module_config[] = {
 	{ FR_CONF_OFFSET("filename", FR_TYPE_FILE_OUTPUT | FR_TYPE_REQUIRED | FR_TYPE_XLAT, rlm_detail_t, filename), .dflt = "%A/%{Packet-Src-IP-Address}/detail" },
 	{ FR_CONF_OFFSET("header", FR_TYPE_STRING | FR_TYPE_XLAT, rlm_detail_t, header), .dflt = "%t" },
+	{ FR_CONF_OFFSET("format", FR_TYPE_UINT32, rlm_detail_t, format),
+	  .func = cf_table_parse_uint32,
+	  .uctx = &(cf_table_parse_ctx_t){ .table = detail_format_table, .len = &detail_format_table_len },
+	  .dflt = "detail" },
 	{ FR_CONF_OFFSET("permissions", FR_TYPE_UINT32, rlm_detail_t, perm), .dflt = "0600" },
 	{ FR_CONF_OFFSET("group", FR_TYPE_STRING, rlm_detail_t, group) },
 	{ FR_CONF_OFFSET("locking", FR_TYPE_BOOL, rlm_detail_t, locking), .dflt = "no" },
 	{ FR_CONF_OFFSET("escape_filenames", FR_TYPE_BOOL, rlm_detail_t, escape), .dflt = "no" },
 	{ FR_CONF_OFFSET("log_packet_header", FR_TYPE_BOOL, rlm_detail_t, log_srcdst), .dflt = "no" },
+	{ FR_CONF_OFFSET("async", FR_TYPE_SUBSECTION, rlm_detail_t, async), .subcs = (void const *) exfile_async_config },
+	{ FR_CONF_OFFSET("add_stats", FR_TYPE_BOOL, rlm_detail_t, stats), .dflt = "no" },
 	CONF_PARSER_TERMINATOR
 };
 
@@ -166,6 +191,11 @@ static int mod_instantiate(void *instance, CONF_SECTION *conf)
 		return -1;
 	}
 
+	if (inst->async.enabled && (exfile_async_start(inst->ef, &inst->async) < 0)) {
+		cf_log_perr(conf, "Failed starting writer thread");
+		return -1;
+	}
+
 	/*
 	 *	Suppress certain attributes.
 	 */
@@ -254,7 +284,7 @@ static int detail_write(FILE *out, rlm_detail_t const *inst, REQUEST *request, R
 		return -1;
 	}
 
-	if (!packet->vps) {
+	if (!fr_pair_list_head(&packet->vps)) {
 		RWDEBUG("Skipping empty packet");
 		return 0;
 	}
@@ -327,7 +357,7 @@ static int detail_write(FILE *out, rlm_detail_t const *inst, REQUEST *request, R
 	{
 		fr_cursor_t cursor;
 		/* Write each attribute/value to the log file */
-		for (vp = fr_cursor_init(&cursor, &packet->vps);
+		for (vp = fr_pair_list_cursor_init(&cursor, &packet->vps);
 		     vp;
 		     vp = fr_cursor_next(&cursor)) {
 			fr_token_t op;
@@ -362,6 +392,270 @@ static int detail_write(FILE *out, rlm_detail_t const *inst, REQUEST *request, R
 	return 0;
 }
 
+/** Resolve the group to set on detail files
+ *
+ */
+static int detail_group(gid_t *out, rlm_detail_t const *inst, REQUEST *request)
+{
+	char *endptr;
+
+	*out = strtol(inst->group, &endptr, 10);
+	if (*endptr == '\0') return 0;
+
+	if (rad_getgid(request, out, inst->group) < 0) {
+		RDEBUG2("Unable to find system group '%s'", inst->group);
+		return -1;
+	}
+
+	return 0;
+}
+
+/** Accumulates a formatted detail entry in memory
+ *
+ */
+typedef struct {
+	TALLOC_CTX	*ctx;		//!< To allocate the buffer in.
+	uint8_t		*data;		//!< Formatted entry.
+	size_t		len;		//!< Length of the formatted entry.
+} detail_buffer_t;
+
+static ssize_t _detail_buffer_write(void *cookie, char const *in, size_t len)
+{
+	detail_buffer_t	*db = cookie;
+	uint8_t		*data;
+
+	data = talloc_realloc(db->ctx, db->data, uint8_t, db->len + len);
+	if (!data) {
+		errno = ENOMEM;
+		return -1;
+	}
+
+	memcpy(data + db->len, in, len);
+	db->data = data;
+	db->len += len;
+
+	return len;
+}
+
+/** Format a detail entry in memory, and queue it for the writer thread
+ *
+ */
+static rlm_rcode_t detail_do_async(rlm_detail_t const *inst, REQUEST *request,
+				   RADIUS_PACKET *packet, bool compat, char const *filename)
+{
+	detail_buffer_t	db = { .ctx = request };
+	FILE		*outfp;
+	gid_t		gid = -1;
+	struct iovec	vector;
+	int		ret;
+
+	if (inst->group && (detail_group(&gid, inst, request) < 0)) gid = -1;
+
+	outfp = fopencookie(&db, "w", (cookie_io_functions_t){ .write = _detail_buffer_write });
+	if (!outfp) {
+		RERROR("Failed creating buffer for detail entry: %s", fr_syserror(errno));
+		return RLM_MODULE_FAIL;
+	}
+
+	ret = detail_write(outfp, inst, request, packet, compat);
+	if (fclose(outfp) != 0) ret = -1;
+	if (ret < 0) {
+		talloc_free(db.data);
+		return RLM_MODULE_FAIL;
+	}
+
+	if (db.len == 0) return RLM_MODULE_OK;
+
+	vector.iov_base = db.data;
+	vector.iov_len = db.len;
+
+	ret = exfile_write(inst->ef, request, filename, inst->perm, gid, &vector, 1);
+	talloc_free(db.data);
+	if (ret < 0) {
+		RPERROR("Failed writing detail entry to %s", filename);
+		return RLM_MODULE_FAIL;
+	}
+
+	if (inst->stats) exfile_stats_to_pairs(request, inst->ef);
+
+	return RLM_MODULE_OK;
+}
+
+/** Which attributes to write to a spool record
+ *
+ */
+typedef struct {
+	rlm_detail_t const	*inst;
+	bool			compat;
+} detail_spool_filter_t;
+
+static bool detail_spool_filter(VALUE_PAIR const *vp, void *uctx)
+{
+	detail_spool_filter_t const *filter = uctx;
+
+	if (filter->inst->ht && fr_hash_table_finddata(filter->inst->ht, vp->da)) return false;
+
+	/*
+	 *	Don't write passwords in old format...
+	 */
+	if (filter->compat && (vp->da == attr_user_password)) return false;
+
+	return true;
+}
+
+/** Build the src/dst attributes for a spool record
+ *
+ */
+static void detail_spool_srcdst(VALUE_PAIR **out, REQUEST *request, RADIUS_PACKET *packet)
+{
+	fr_cursor_t	cursor;
+	VALUE_PAIR	*vp;
+
+	fr_cursor_init(&cursor, out);
+
+	switch (packet->src_ipaddr.af) {
+	case AF_INET:
+		MEM(vp = fr_pair_afrom_da(request, attr_packet_src_ipv4_address));
+		fr_value_box_shallow(&vp->data, &packet->src_ipaddr, true);
+		fr_cursor_append(&cursor, vp);
+
+		MEM(vp = fr_pair_afrom_da(request, attr_packet_dst_ipv4_address));
+		fr_value_box_shallow(&vp->data, &packet->dst_ipaddr, true);
+		fr_cursor_append(&cursor, vp);
+		break;
+
+	case AF_INET6:
+		MEM(vp = fr_pair_afrom_da(request, attr_packet_src_ipv6_address));
+		fr_value_box_shallow(&vp->data, &packet->src_ipaddr, true);
+		fr_cursor_append(&cursor, vp);
+
+		MEM(vp = fr_pair_afrom_da(request, attr_packet_dst_ipv6_address));
+		fr_value_box_shallow(&vp->data, &packet->dst_ipaddr, true);
+		fr_cursor_append(&cursor, vp);
+		break;
+
+	default:
+		break;
+	}
+
+	MEM(vp = fr_pair_afrom_da(request, attr_packet_src_port));
+	fr_value_box_shallow(&vp->data, packet->src_port, true);
+	fr_cursor_append(&cursor, vp);
+
+	MEM(vp = fr_pair_afrom_da(request, attr_packet_dst_port));
+	fr_value_box_shallow(&vp->data, packet->dst_port, true);
+	fr_cursor_append(&cursor, vp);
+}
+
+/** Encode a packet as a binary spool record
+ *
+ * @param[out] out	The encoded record, allocated in the request.
+ * @param[in] inst	Instance of rlm_detail.
+ * @param[in] request	The current request.
+ * @param[in] packet	associated with the request (request, reply...).
+ * @param[in] compat	Write out entry in compatibility mode.
+ * @return
+ *	- >0 the length of the record.
+ *	- 0 if there's nothing to write.
+ *	- -1 on failure.
+ */
+static ssize_t detail_spool_encode(uint8_t **out, rlm_detail_t const *inst, REQUEST *request,
+				   RADIUS_PACKET *packet, bool compat)
+{
+	fr_spool_record_t	record = {
+					.code = packet->code,
+					.dict = request->dict,
+					.timestamp = fr_time_to_unix_time(request->packet->timestamp)
+				};
+	detail_spool_filter_t	filter = { .inst = inst, .compat = compat };
+	VALUE_PAIR		*srcdst = NULL;
+	uint8_t			*buffer;
+	size_t			buffer_len = 1024;
+	ssize_t			slen, len;
+
+	if (!fr_pair_list_head(&packet->vps)) {
+		RWDEBUG("Skipping empty packet");
+		return 0;
+	}
+
+	if (inst->log_srcdst) detail_spool_srcdst(&srcdst, request, packet);
+
+	/*
+	 *	Most records fit the first time around.  If not,
+	 *	try again with a larger buffer.
+	 */
+	for (;;) {
+		fr_cursor_t cursor;
+
+		MEM(buffer = talloc_array(request, uint8_t, buffer_len));
+
+		fr_cursor_init(&cursor, &srcdst);
+		slen = fr_spool_pairs_encode(buffer + FR_SPOOL_HDR_LEN, buffer_len - FR_SPOOL_HDR_LEN,
+					     &cursor, NULL, NULL);
+		if (slen >= 0) {
+			len = FR_SPOOL_HDR_LEN + slen;
+
+			fr_pair_list_cursor_init(&cursor, &packet->vps);
+			slen = fr_spool_pairs_encode(buffer + len, buffer_len - len,
+						     &cursor, detail_spool_filter, &filter);
+		}
+		if (slen >= 0) break;
+
+		talloc_free(buffer);
+
+		if ((slen == PAIR_ENCODE_FATAL_ERROR) || (buffer_len > FR_SPOOL_MAX_LEN)) {
+			RPERROR("Failed encoding spool record");
+			fr_pair_list_free(&srcdst);
+			return -1;
+		}
+		buffer_len *= 2;
+	}
+	fr_pair_list_free(&srcdst);
+
+	len += slen;
+	if (fr_spool_record_header(buffer, len, &record) < 0) {
+		RPERROR("Failed encoding spool record");
+		talloc_free(buffer);
+		return -1;
+	}
+
+	*out = buffer;
+	return len;
+}
+
+/** Append a binary spool record to the file
+ *
+ */
+static rlm_rcode_t detail_do_spool(rlm_detail_t const *inst, REQUEST *request,
+				   RADIUS_PACKET *packet, bool compat, char const *filename)
+{
+	uint8_t		*record;
+	ssize_t		len;
+	gid_t		gid = -1;
+	struct iovec	vector;
+	int		ret;
+
+	len = detail_spool_encode(&record, inst, request, packet, compat);
+	if (len < 0) return RLM_MODULE_FAIL;
+	if (len == 0) return RLM_MODULE_OK;
+
+	if (inst->group && (detail_group(&gid, inst, request) < 0)) gid = -1;
+
+	vector.iov_base = record;
+	vector.iov_len = len;
+
+	ret = exfile_write(inst->ef, request, filename, inst->perm, gid, &vector, 1);
+	talloc_free(record);
+	if (ret < 0) {
+		RPERROR("Failed writing spool record to %s", filename);
+		return RLM_MODULE_FAIL;
+	}
+
+	if (inst->stats) exfile_stats_to_pairs(request, inst->ef);
+
+	return RLM_MODULE_OK;
+}
+
 /*
  *	Do detail, compatible with old accounting
  */
@@ -373,10 +667,7 @@ static rlm_rcode_t CC_HINT(nonnull) detail_do(void const *instance, REQUEST *req
 
 	FILE		*outfp;
 
-#ifdef HAVE_GRP_H
 	gid_t		gid;
-	char		*endptr;
-#endif
 
 	rlm_detail_t const *inst = talloc_get_type_abort_const(instance, rlm_detail_t);
 
@@ -391,6 +682,10 @@ static rlm_rcode_t CC_HINT(nonnull) detail_do(void const *instance, REQUEST *req
 
 	RDEBUG2("%s expands to %s", inst->filename, buffer);
 
+	if (inst->format == DETAIL_FORMAT_SPOOL) return detail_do_spool(inst, request, packet, compat, buffer);
+
+	if (inst->async.enabled) return detail_do_async(inst, request, packet, compat, buffer);
+
 	outfd = exfile_open(inst->ef, request, buffer, inst->perm);
 	if (outfd < 0) {
 		RPERROR("Couldn't open file %s", buffer);
@@ -399,13 +694,7 @@ static rlm_rcode_t CC_HINT(nonnull) detail_do(void const *instance, REQUEST *req
 	}
 
 	if (inst->group != NULL) {
-		gid = strtol(inst->group, &endptr, 10);
-		if (*endptr != '\0') {
-			if (rad_getgid(request, &gid, inst->group) < 0) {
-				RDEBUG2("Unable to find system group '%s'", inst->group);
-				goto skip_group;
-			}
-		}
+		if (detail_group(&gid, inst, request) < 0) goto skip_group;
 
 		if (chown(buffer, -1, gid) == -1) {
 			RDEBUG2("Unable to change system group of '%s'", buffer);
@@ -93,7 +93,7 @@ static rlm_rcode_t CC_HINT(nonnull) mod_authorize(module_ctx_t const *mctx, REQU
 	/*
 	 *	Find the first attribute which is parented by Digest-Attributes.
 	 */
-	for (vp = fr_cursor_init(&cursor, &request->packet->vps);
+	for (vp = fr_pair_list_cursor_init(&cursor, &request->packet->vps);
 	     vp;
 	     vp = fr_cursor_next(&cursor)) {
 		if (vp->da->parent == attr_digest_attributes) break;
@@ -135,14 +135,14 @@ static rlm_rcode_t CC_HINT(nonnull) mod_authenticate(UNUSED module_ctx_t const *
 	 *	We require access to the plain-text password, or to the
 	 *	Digest-HA1 parameter.
 	 */
-	passwd = fr_pair_find_by_da(request->control, attr_digest_ha1, TAG_ANY);
+	passwd = fr_pair_list_find_by_da(&request->control, attr_digest_ha1, TAG_ANY);
 	if (passwd) {
 		if (passwd->vp_length != 32) {
 			REDEBUG("Digest-HA1 has invalid length, authentication failed");
 			return RLM_MODULE_INVALID;
 		}
 	} else {
-		passwd = fr_pair_find_by_da(request->control, attr_cleartext_password, TAG_ANY);
+		passwd = fr_pair_list_find_by_da(&request->control, attr_cleartext_password, TAG_ANY);
 	}
 	if (!passwd) {
 		REDEBUG("Cleartext-Password or Digest-HA1 is required for authentication");
@@ -152,7 +152,7 @@ static rlm_rcode_t CC_HINT(nonnull) mod_authenticate(UNUSED module_ctx_t const *
 	/*
 	 *	We require access to the Digest-Nonce-Value
 	 */
-	nonce = fr_pair_find_by_da(request->packet->vps, attr_digest_nonce, TAG_ANY);
+	nonce = fr_pair_list_find_by_da(&request->packet->vps, attr_digest_nonce, TAG_ANY);
 	if (!nonce) {
 		REDEBUG("No Digest-Nonce: Cannot perform Digest authentication");
 		return RLM_MODULE_INVALID;
@@ -161,7 +161,7 @@ static rlm_rcode_t CC_HINT(nonnull) mod_authenticate(UNUSED module_ctx_t const *
 	/*
 	 *	A1 = Digest-User-Name ":" Realm ":" Password
 	 */
-	vp = fr_pair_find_by_da(request->packet->vps, attr_digest_user_name, TAG_ANY);
+	vp = fr_pair_list_find_by_da(&request->packet->vps, attr_digest_user_name, TAG_ANY);
 	if (!vp) {
 		REDEBUG("No Digest-User-Name: Cannot perform Digest authentication");
 		return RLM_MODULE_INVALID;
@@ -172,7 +172,7 @@ static rlm_rcode_t CC_HINT(nonnull) mod_authenticate(UNUSED module_ctx_t const *
 	a1[a1_len] = ':';
 	a1_len++;
 
-	vp = fr_pair_find_by_da(request->packet->vps, attr_digest_realm, TAG_ANY);
+	vp = fr_pair_list_find_by_da(&request->packet->vps, attr_digest_realm, TAG_ANY);
 	if (!vp) {
 		REDEBUG("No Digest-Realm: Cannot perform Digest authentication");
 		return RLM_MODULE_INVALID;
@@ -198,7 +198,7 @@ static rlm_rcode_t CC_HINT(nonnull) mod_authenticate(UNUSED module_ctx_t const *
 	 *	See which variant we calculate.
 	 *	Assume MD5 if no Digest-Algorithm attribute received
 	 */
-	algo = fr_pair_find_by_da(request->packet->vps, attr_digest_algorithm, TAG_ANY);
+	algo = fr_pair_list_find_by_da(&request->packet->vps, attr_digest_algorithm, TAG_ANY);
 	if ((!algo) ||
 	    (strcasecmp(algo->vp_strvalue, "MD5") == 0)) {
 		/*
@@ -243,7 +243,7 @@ static rlm_rcode_t CC_HINT(nonnull) mod_authenticate(UNUSED module_ctx_t const *
 		a1[a1_len] = ':';
 		a1_len++;
 
-		vp = fr_pair_find_by_da(request->packet->vps, attr_digest_cnonce, TAG_ANY);
+		vp = fr_pair_list_find_by_da(&request->packet->vps, attr_digest_cnonce, TAG_ANY);
 		if (!vp) {
 			REDEBUG("No Digest-CNonce: Cannot perform Digest authentication");
 			return RLM_MODULE_INVALID;
@@ -271,7 +271,7 @@ static rlm_rcode_t CC_HINT(nonnull) mod_authenticate(UNUSED module_ctx_t const *
 	/*
 	 *	A2 = Digest-Method ":" Digest-URI
 	 */
-	vp = fr_pair_find_by_da(request->packet->vps, attr_digest_method, TAG_ANY);
+	vp = fr_pair_list_find_by_da(&request->packet->vps, attr_digest_method, TAG_ANY);
 	if (!vp) {
 		REDEBUG("No Digest-Method: Cannot perform Digest authentication");
 		return RLM_MODULE_INVALID;
@@ -282,7 +282,7 @@ static rlm_rcode_t CC_HINT(nonnull) mod_authenticate(UNUSED module_ctx_t const *
 	a2[a2_len] = ':';
 	a2_len++;
 
-	vp = fr_pair_find_by_da(request->packet->vps, attr_digest_uri, TAG_ANY);
+	vp = fr_pair_list_find_by_da(&request->packet->vps, attr_digest_uri, TAG_ANY);
 	if (!vp) {
 		REDEBUG("No Digest-URI: Cannot perform Digest authentication");
 		return RLM_MODULE_INVALID;
@@ -293,7 +293,7 @@ static rlm_rcode_t CC_HINT(nonnull) mod_authenticate(UNUSED module_ctx_t const *
 	/*
 	 *  QOP is "auth-int", tack on ": Digest-Body-Digest"
 	 */
-	qop = fr_pair_find_by_da(request->packet->vps, attr_digest_qop, TAG_ANY);
+	qop = fr_pair_list_find_by_da(&request->packet->vps, attr_digest_qop, TAG_ANY);
 	if (qop) {
 		if (strcasecmp(qop->vp_strvalue, "auth-int") == 0) {
 			VALUE_PAIR *body;
@@ -307,7 +307,7 @@ static rlm_rcode_t CC_HINT(nonnull) mod_authenticate(UNUSED module_ctx_t const *
 			/*
 			 *  Must be a hex representation of an MD5 digest.
 			 */
-			body = fr_pair_find_by_da(request->packet->vps, attr_digest_body_digest, TAG_ANY);
+			body = fr_pair_list_find_by_da(&request->packet->vps, attr_digest_body_digest, TAG_ANY);
 			if (!body) {
 				REDEBUG("No Digest-Body-Digest: Cannot perform Digest authentication");
 				return RLM_MODULE_INVALID;
@@ -370,7 +370,7 @@ static rlm_rcode_t CC_HINT(nonnull) mod_authenticate(UNUSED module_ctx_t const *
 		kd[kd_len] = ':';
 		kd_len++;
 
-		vp = fr_pair_find_by_da(request->packet->vps, attr_digest_nonce_count, TAG_ANY);
+		vp = fr_pair_list_find_by_da(&request->packet->vps, attr_digest_nonce_count, TAG_ANY);
 		if (!vp) {
 			REDEBUG("No Digest-Nonce-Count: Cannot perform Digest authentication");
 			return RLM_MODULE_INVALID;
@@ -381,7 +381,7 @@ static rlm_rcode_t CC_HINT(nonnull) mod_authenticate(UNUSED module_ctx_t const *
 		kd[kd_len] = ':';
 		kd_len++;
 
-		vp = fr_pair_find_by_da(request->packet->vps, attr_digest_cnonce, TAG_ANY);
+		vp = fr_pair_list_find_by_da(&request->packet->vps, attr_digest_cnonce, TAG_ANY);
 		if (!vp) {
 			REDEBUG("No Digest-CNonce: Cannot perform Digest authentication");
 			return RLM_MODULE_INVALID;
@@ -423,7 +423,7 @@ static rlm_rcode_t CC_HINT(nonnull) mod_authenticate(UNUSED module_ctx_t const *
 	/*
 	 *	Get the binary value of Digest-Response
 	 */
-	vp = fr_pair_find_by_da(request->packet->vps, attr_digest_response, TAG_ANY);
+	vp = fr_pair_list_find_by_da(&request->packet->vps, attr_digest_response, TAG_ANY);
 	if (!vp) {
 		REDEBUG("No Digest-Response attribute in the request.  Cannot perform digest authentication");
 		return RLM_MODULE_INVALID;
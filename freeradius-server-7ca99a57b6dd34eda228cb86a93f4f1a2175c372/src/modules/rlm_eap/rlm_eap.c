@@ -259,7 +259,7 @@ static eap_type_t eap_process_nak(module_ctx_t const *mctx, REQUEST *request,
 	 *	Pick one type out of the one they asked for,
 	 *	as they may have asked for many.
 	 */
-	vp = fr_pair_find_by_da(request->control, attr_eap_type, TAG_ANY);
+	vp = fr_pair_list_find_by_da(&request->control, attr_eap_type, TAG_ANY);
 	for (i = 0; i < nak->length; i++) {
 		/*
 		 *	Type 0 is valid, and means there are no
@@ -540,7 +540,7 @@ static rlm_rcode_t eap_method_select(module_ctx_t const *mctx, eap_session_t *ea
 		/*
 		 *	Allow per-user configuration of EAP types.
 		 */
-		vp = fr_pair_find_by_da(eap_session->request->control, attr_eap_type, TAG_ANY);
+		vp = fr_pair_list_find_by_da(&eap_session->request->control, attr_eap_type, TAG_ANY);
 		if (vp) {
 			RDEBUG2("Using method from &control:EAP-Type");
 			next = vp->vp_uint32;
@@ -614,17 +614,17 @@ static rlm_rcode_t eap_method_select(module_ctx_t const *mctx, eap_session_t *ea
 								     request->dict));
 
 	if (method->submodule->clone_parent_lists) {
-		if (fr_pair_list_copy(eap_session->subrequest,
-				      &eap_session->subrequest->control, request->control) < 0) {
+		if (fr_pair_list_append_copy(eap_session->subrequest,
+					     &eap_session->subrequest->control, fr_pair_list_head(&request->control)) < 0) {
 		list_copy_fail:
 			RERROR("Failed copying parent's attribute list");
 			TALLOC_FREE(eap_session->subrequest);
 			return RLM_MODULE_FAIL;
 		}
 
-		if (fr_pair_list_copy(eap_session->subrequest->packet,
-				      &eap_session->subrequest->packet->vps,
-				      request->packet->vps) < 0) goto list_copy_fail;
+		if (fr_pair_list_append_copy(eap_session->subrequest->packet,
+					     &eap_session->subrequest->packet->vps,
+					     fr_pair_list_head(&request->packet->vps)) < 0) goto list_copy_fail;
 	}
 
 	/*
@@ -670,7 +670,7 @@ static rlm_rcode_t mod_authenticate(module_ctx_t const *mctx, REQUEST *request)
 	eap_packet_raw_t	*eap_packet;
 	rlm_rcode_t		rcode;
 
-	if (!fr_pair_find_by_da(request->packet->vps, attr_eap_message, TAG_ANY)) {
+	if (!fr_pair_list_find_by_da(&request->packet->vps, attr_eap_message, TAG_ANY)) {
 		REDEBUG("You set 'Auth-Type = EAP' for a request that does not contain an EAP-Message attribute!");
 		return RLM_MODULE_INVALID;
 	}
@@ -680,7 +680,7 @@ static rlm_rcode_t mod_authenticate(module_ctx_t const *mctx, REQUEST *request)
 	 *	attribute.  The relevant decoder should have already
 	 *	concatenated the fragments into a single buffer.
 	 */
-	eap_packet = eap_packet_from_vp(request, request->packet->vps);
+	eap_packet = eap_packet_from_vp(request, fr_pair_list_head(&request->packet->vps));
 	if (!eap_packet) {
 		RPERROR("Malformed EAP Message");
 		return RLM_MODULE_FAIL;
@@ -863,7 +863,7 @@ static rlm_rcode_t mod_post_proxy(module_ctx_t const *mctx, REQUEST *request)
 			eap_session_destroy(&eap_session);
 		}
 
-		username = fr_pair_find_by_da(request->packet->vps, attr_user_name, TAG_ANY);
+		username = fr_pair_list_find_by_da(&request->packet->vps, attr_user_name, TAG_ANY);
 
 		/*
 		 *	If it's an Access-Accept, RFC 2869, Section 2.3.1
@@ -901,15 +901,15 @@ static rlm_rcode_t mod_post_auth(module_ctx_t const *mctx, REQUEST *request)
 	 *	says that we MUST include a User-Name attribute in the
 	 *	Access-Accept.
 	 */
-	username = fr_pair_find_by_da(request->packet->vps, attr_user_name, TAG_ANY);
+	username = fr_pair_list_find_by_da(&request->packet->vps, attr_user_name, TAG_ANY);
 	if ((request->reply->code == FR_CODE_ACCESS_ACCEPT) && username) {
 		/*
 		 *	Doesn't exist, add it in.
 		 */
-		vp = fr_pair_find_by_da(request->reply->vps, attr_user_name, TAG_ANY);
+		vp = fr_pair_list_find_by_da(&request->reply->vps, attr_user_name, TAG_ANY);
 		if (!vp) {
 			vp = fr_pair_copy(request->reply, username);
-			fr_pair_add(&request->reply->vps, vp);
+			fr_pair_list_append(&request->reply->vps, vp);
 		}
 
 		/*
@@ -931,12 +931,12 @@ static rlm_rcode_t mod_post_auth(module_ctx_t const *mctx, REQUEST *request)
 	 */
 	if (request->reply->code != FR_CODE_ACCESS_REJECT) return RLM_MODULE_NOOP;
 
-	if (!fr_pair_find_by_da(request->packet->vps, attr_eap_message, TAG_ANY)) {
+	if (!fr_pair_list_find_by_da(&request->packet->vps, attr_eap_message, TAG_ANY)) {
 		RDEBUG3("Request didn't contain an EAP-Message, not inserting EAP-Failure");
 		return RLM_MODULE_NOOP;
 	}
 
-	if (fr_pair_find_by_da(request->reply->vps, attr_eap_message, TAG_ANY)) {
+	if (fr_pair_list_find_by_da(&request->reply->vps, attr_eap_message, TAG_ANY)) {
 		RDEBUG3("Reply already contained an EAP-Message, not inserting EAP-Failure");
 		return RLM_MODULE_NOOP;
 	}
@@ -499,7 +499,7 @@ static rlm_rcode_t CC_HINT(nonnull) process_reply(UNUSED eap_session_t *eap_sess
 		 * Copy what we need into the TTLS tunnel and leave
 		 * the rest to be cleaned up.
 		 */
-		for (vp = fr_cursor_init(&cursor, &reply->vps); vp; vp = fr_cursor_next(&cursor)) {
+		for (vp = fr_pair_list_cursor_init(&cursor, &reply->vps); vp; vp = fr_cursor_next(&cursor)) {
 			if (fr_dict_vendor_num_by_da(vp->da) != VENDORPEC_MICROSOFT) continue;
 
 			/* FIXME must be a better way to capture/re-derive this later for ISK */
@@ -545,9 +545,9 @@ static rlm_rcode_t CC_HINT(nonnull) process_reply(UNUSED eap_session_t *eap_sess
 		/*
 		 *	Copy the EAP-Message back to the tunnel.
 		 */
-		(void) fr_cursor_init(&cursor, &reply->vps);
+		(void) fr_pair_list_cursor_init(&cursor, &reply->vps);
 
-		for (vp = fr_cursor_iter_by_da_init(&cursor, &reply->vps, attr_eap_message);
+		for (vp = fr_pair_list_cursor_by_da_init(&cursor, &reply->vps, attr_eap_message);
 		     vp;
 		     vp = fr_cursor_next(&cursor)) {
 			eap_fast_tlv_append(tls_session, attr_eap_fast_eap_payload, true, vp->vp_length, vp->vp_octets);
@@ -580,7 +580,7 @@ static FR_CODE eap_fast_eap_payload(REQUEST *request, eap_session_t *eap_session
 	 *	Allocate a fake REQUEST structure.
 	 */
 	fake = request_alloc_fake(request, NULL);
-	fr_assert(!fake->packet->vps);
+	fr_assert(!fr_pair_list_head(&fake->packet->vps));
 
 	t = talloc_get_type_abort(tls_session->opaque, eap_fast_tunnel_t);
 
@@ -588,16 +588,17 @@ static FR_CODE eap_fast_eap_payload(REQUEST *request, eap_session_t *eap_session
 	 *	Add the tunneled attributes to the fake request.
 	 */
 
-	MEM(fake->packet->vps = vp = fr_pair_afrom_da(fake->packet, attr_eap_message));
-	fr_pair_value_memdup(fake->packet->vps, tlv_eap_payload->vp_octets, tlv_eap_payload->vp_length, false);
+	MEM(vp = fr_pair_afrom_da(fake->packet, attr_eap_message));
+	fr_pair_list_append(&fake->packet->vps, vp);
+	fr_pair_value_memdup(vp, tlv_eap_payload->vp_octets, tlv_eap_payload->vp_length, false);
 
 	RDEBUG2("Got tunneled request");
-	log_request_pair_list(L_DBG_LVL_1, fake, fake->packet->vps, NULL);
+	log_request_pair_list(L_DBG_LVL_1, fake, fr_pair_list_head(&fake->packet->vps), NULL);
 
 	/*
 	 *	Tell the request that it's a fake one.
 	 */
-	MEM(fr_pair_add_by_da(fake->packet, &vp, &fake->packet->vps, attr_freeradius_proxied_to) >= 0);
+	MEM(fr_pair_list_add_by_da(fake->packet, &vp, &fake->packet->vps, attr_freeradius_proxied_to) >= 0);
 	fr_pair_value_from_str(vp, "127.0.0.1", sizeof("127.0.0.1"), '\0', false);
 
 	/*
@@ -631,7 +632,7 @@ static FR_CODE eap_fast_eap_payload(REQUEST *request, eap_session_t *eap_session
 
 	if (t->username) {
 		vp = fr_pair_copy(fake->packet, t->username);
-		fr_pair_add(&fake->packet->vps, vp);
+		fr_pair_list_append(&fake->packet->vps, vp);
 	}
 
 	if (t->stage == EAP_FAST_AUTHENTICATION) {	/* FIXME do this only for MSCHAPv2 */
@@ -639,7 +640,7 @@ static FR_CODE eap_fast_eap_payload(REQUEST *request, eap_session_t *eap_session
 
 		MEM(tvp = fr_pair_afrom_da(fake, attr_eap_type));
 		tvp->vp_uint32 = t->default_provisioning_method;
-		fr_pair_add(&fake->control, tvp);
+		fr_pair_list_append(&fake->control, tvp);
 
 		/*
 		 * RFC 5422 section 3.2.3 - Authenticating Using EAP-FAST-MSCHAPv2
@@ -647,12 +648,12 @@ static FR_CODE eap_fast_eap_payload(REQUEST *request, eap_session_t *eap_session
 		if (t->mode == EAP_FAST_PROVISIONING_ANON) {
 			MEM(tvp = fr_pair_afrom_da(fake, attr_ms_chap_challenge));
 			fr_pair_value_memdup(tvp, t->keyblock->server_challenge, RADIUS_CHAP_CHALLENGE_LENGTH, false);
-			fr_pair_add(&fake->control, tvp);
+			fr_pair_list_append(&fake->control, tvp);
 			RHEXDUMP3(t->keyblock->server_challenge, RADIUS_CHAP_CHALLENGE_LENGTH, "MSCHAPv2 auth_challenge");
 
 			MEM(tvp = fr_pair_afrom_da(fake, attr_ms_chap_peer_challenge));
 			fr_pair_value_memdup(tvp, t->keyblock->client_challenge, RADIUS_CHAP_CHALLENGE_LENGTH, false);
-			fr_pair_add(&fake->control, tvp);
+			fr_pair_list_append(&fake->control, tvp);
 			RHEXDUMP3(t->keyblock->client_challenge, RADIUS_CHAP_CHALLENGE_LENGTH, "MSCHAPv2 peer_challenge");
 		}
 	}
@@ -669,17 +670,19 @@ static FR_CODE eap_fast_eap_payload(REQUEST *request, eap_session_t *eap_session
 	switch (fake->reply->code) {
 	case 0:			/* No reply code, must be proxied... */
 #ifdef WITH_PROXY
-		vp = fr_pair_find_by_da(fake->control, attr_proxy_to_realm, TAG_ANY);
+		vp = fr_pair_list_find_by_da(&fake->control, attr_proxy_to_realm, TAG_ANY);
 		if (vp) {
 			int			ret;
 			eap_tunnel_data_t	*tunnel;
+			VALUE_PAIR		*proxy_to = NULL;
 
 			RDEBUG2("Tunneled authentication will be proxied to %pV", &vp->data);
 
 			/*
 			 *	Tell the original request that it's going to be proxied.
 			 */
-			fr_pair_list_copy_by_da(request, &request->control, fake->control, attr_proxy_to_realm);
+			fr_pair_list_copy_by_da(request, &proxy_to, fr_pair_list_head(&fake->control), attr_proxy_to_realm);
+			fr_pair_list_append(&request->control, proxy_to);
 
 			/*
 			 *	Seed the proxy packet with the tunneled request.
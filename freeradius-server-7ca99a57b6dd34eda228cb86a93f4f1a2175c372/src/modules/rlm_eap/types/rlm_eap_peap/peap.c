@@ -164,7 +164,7 @@ static void eap_peap_soh_verify(REQUEST *request, RADIUS_PACKET *packet,
 
 	MEM(vp = fr_pair_afrom_da(packet, attr_soh_supported));
 	vp->vp_bool = false;
-	fr_pair_add(&packet->vps, vp);
+	fr_pair_list_append(&packet->vps, vp);
 
 	if (data && data[0] == FR_EAP_METHOD_NAK) {
 		REDEBUG("SoH - client NAKed");
@@ -384,7 +384,7 @@ static rlm_rcode_t CC_HINT(nonnull) process_reply(eap_session_t *eap_session, fr
 		} else {
 			RDEBUG2("Got tunneled reply code %i", reply->code);
 		}
-		log_request_pair_list(L_DBG_LVL_2, request, reply->vps, NULL);
+		log_request_pair_list(L_DBG_LVL_2, request, fr_pair_list_head(&reply->vps), NULL);
 	}
 
 	switch (reply->code) {
@@ -411,7 +411,7 @@ static rlm_rcode_t CC_HINT(nonnull) process_reply(eap_session_t *eap_session, fr
 		 *	Access-Challenge is ignored.
 		 */
 		vp = NULL;
-		fr_pair_list_copy_by_da(t, &vp, reply->vps, attr_eap_message);
+		fr_pair_list_copy_by_da(t, &vp, fr_pair_list_head(&reply->vps), attr_eap_message);
 
 		/*
 		 *	Handle the ACK, by tunneling any necessary reply
@@ -551,7 +551,7 @@ rlm_rcode_t eap_peap_process(REQUEST *request, eap_session_t *eap_session, fr_tl
 
 	case PEAP_STATUS_WAIT_FOR_SOH_RESPONSE:
 		fake = request_alloc_fake(request, NULL);
-		fr_assert(!fake->packet->vps);
+		fr_assert(!fr_pair_list_head(&fake->packet->vps));
 		eap_peap_soh_verify(fake, fake->packet, data, data_len);
 		setup_fake_request(request, fake, t);
 
@@ -572,8 +572,8 @@ rlm_rcode_t eap_peap_process(REQUEST *request, eap_session_t *eap_session, fr_tl
 
 		/* save the SoH VPs */
 		fr_assert(!t->soh_reply_vps);
-		MEM(fr_pair_list_copy(t, &t->soh_reply_vps, fake->reply->vps) >= 0);
-		fr_assert(!fake->reply->vps);
+		MEM(fr_pair_list_copy(t, &t->soh_reply_vps, fr_pair_list_head(&fake->reply->vps)) >= 0);
+		fr_assert(!fr_pair_list_head(&fake->reply->vps));
 		TALLOC_FREE(fake);
 
 		if (t->session_resumption_state == PEAP_RESUMPTION_YES) {
@@ -652,7 +652,7 @@ rlm_rcode_t eap_peap_process(REQUEST *request, eap_session_t *eap_session, fr_tl
 	}
 
 	fake = request_alloc_fake(request, NULL);
-	fr_assert(!fake->packet->vps);
+	fr_assert(!fr_pair_list_head(&fake->packet->vps));
 
 	switch (t->status) {
 	/*
@@ -679,14 +679,14 @@ rlm_rcode_t eap_peap_process(REQUEST *request, eap_session_t *eap_session, fr_tl
 		q[4] = FR_EAP_METHOD_IDENTITY;
 		memcpy(q + EAP_HEADER_LEN + 1,
 		       t->username->vp_strvalue, t->username->vp_length);
-		fr_pair_add(&fake->packet->vps, vp);
+		fr_pair_list_append(&fake->packet->vps, vp);
 	}
 		break;
 
 	case PEAP_STATUS_PHASE2:
-		fake->packet->vps = eap_peap_inner_to_pairs(request, fake->packet,
-							    eap_round, data, data_len);
-		if (!fake->packet->vps) {
+		fr_pair_list_append(&fake->packet->vps, eap_peap_inner_to_pairs(request, fake->packet,
+										eap_round, data, data_len));
+		if (!fr_pair_list_head(&fake->packet->vps)) {
 			talloc_free(fake);
 			RDEBUG2("Unable to convert tunneled EAP packet to internal server data structures");
 			rcode = RLM_MODULE_REJECT;
@@ -701,7 +701,7 @@ rlm_rcode_t eap_peap_process(REQUEST *request, eap_session_t *eap_session, fr_tl
 	}
 
 	RDEBUG2("Got tunneled request");
-	log_request_pair_list(L_DBG_LVL_2, request, fake->packet->vps, NULL);
+	log_request_pair_list(L_DBG_LVL_2, request, fr_pair_list_head(&fake->packet->vps), NULL);
 
 	/*
 	 *	Update other items in the REQUEST data structure.
@@ -754,12 +754,12 @@ static int CC_HINT(nonnull) setup_fake_request(REQUEST *request, REQUEST *fake,
 	/*
 	 *	Tell the request that it's a fake one.
 	 */
-	MEM(fr_pair_add_by_da(fake->packet, &vp, &fake->packet->vps, attr_freeradius_proxied_to) >= 0);
+	MEM(fr_pair_list_add_by_da(fake->packet, &vp, &fake->packet->vps, attr_freeradius_proxied_to) >= 0);
 	fr_pair_value_from_str(vp, "127.0.0.1", sizeof("127.0.0.1"), '\0', false);
 
 	if (t->username) {
 		vp = fr_pair_copy(fake->packet, t->username);
-		fr_pair_add(&fake->packet->vps, vp);
+		fr_pair_list_append(&fake->packet->vps, vp);
 		RDEBUG2("Setting &request:User-Name from tunneled (inner) identity \"%s\"",
 			vp->vp_strvalue);
 	} else {
@@ -147,7 +147,7 @@ static rlm_rcode_t eap_tls_virtual_server(rlm_eap_tls_t *inst, REQUEST *request,
 	VALUE_PAIR	*vp;
 
 	/* set the virtual server to use */
-	vp = fr_pair_find_by_da(request->control, attr_virtual_server, TAG_ANY);
+	vp = fr_pair_list_find_by_da(&request->control, attr_virtual_server, TAG_ANY);
 	if (vp) {
 		server_cs = virtual_server_find(vp->vp_strvalue);
 		if (!server_cs) {
@@ -267,7 +267,7 @@ static rlm_rcode_t mod_session_init(module_ctx_t const *mctx, REQUEST *request)
 	 *	EAP-TLS-Require-Client-Cert attribute will override
 	 *	the require_client_cert configuration option.
 	 */
-	vp = fr_pair_find_by_da(request->control, attr_eap_tls_require_client_cert, TAG_ANY);
+	vp = fr_pair_list_find_by_da(&request->control, attr_eap_tls_require_client_cert, TAG_ANY);
 	if (vp) {
 		client_cert = vp->vp_uint32 ? true : false;
 	} else {
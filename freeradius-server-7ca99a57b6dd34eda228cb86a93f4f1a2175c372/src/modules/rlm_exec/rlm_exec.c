@@ -104,7 +104,7 @@ static ssize_t exec_xlat(UNUSED TALLOC_CTX *ctx, char **out, size_t outlen,
 {
 	int			result;
 	rlm_exec_t const	*inst = mod_inst;
-	VALUE_PAIR		**input_pairs = NULL;
+	fr_pair_list_t		*input_pairs = NULL;
 	char *p;
 
 	if (!inst->wait) {
@@ -124,7 +124,7 @@ static ssize_t exec_xlat(UNUSED TALLOC_CTX *ctx, char **out, size_t outlen,
 	 *	This function does it's own xlat of the input program
 	 *	to execute.
 	 */
-	result = radius_exec_program(request, *out, outlen, NULL, request, fmt, input_pairs ? *input_pairs : NULL,
+	result = radius_exec_program(request, *out, outlen, NULL, request, fmt, input_pairs ? fr_pair_list_head(input_pairs) : NULL,
 				     inst->wait, inst->shell_escape, inst->timeout);
 	if (result != 0) return -1;
 
@@ -265,14 +265,14 @@ static rlm_rcode_t mod_exec_nowait_resume(module_ctx_t const *mctx, REQUEST *req
 	 *	Decide what input/output the program takes.
 	 */
 	if (inst->input) {
-		VALUE_PAIR **input_pairs;
+		fr_pair_list_t *input_pairs;
 
 		input_pairs = radius_list(request, inst->input_list);
 		if (!input_pairs) {
 			return RLM_MODULE_INVALID;
 		}
 
-		env_pairs = *input_pairs;
+		env_pairs = fr_pair_list_head(input_pairs);
 	}
 
 	if (fr_exec_nowait(request, box, env_pairs) < 0) {
@@ -356,7 +356,8 @@ static rlm_rcode_t mod_exec_wait_resume(module_ctx_t const *mctx, REQUEST *reque
 
 	if (inst->output && m->box) {
 		TALLOC_CTX *ctx;
-		VALUE_PAIR *vps, **output_pairs;
+		VALUE_PAIR *vps;
+		fr_pair_list_t *output_pairs;
 
 		RDEBUG("EXEC GOT -- %pV", m->box);
 
@@ -420,12 +421,12 @@ static rlm_rcode_t CC_HINT(nonnull) mod_exec_dispatch(module_ctx_t const *mctx,
 	 *	Decide what input/output the program takes.
 	 */
 	if (inst->input) {
-		VALUE_PAIR **input_pairs;
+		fr_pair_list_t *input_pairs;
 
 		input_pairs = radius_list(request, inst->input_list);
 		if (!input_pairs) return RLM_MODULE_INVALID;
 
-		env_pairs = *input_pairs;
+		env_pairs = fr_pair_list_head(input_pairs);
 	}
 
 	if (inst->output) {
@@ -32,28 +32,75 @@ RCSID("$Id$")
 #include <ctype.h>
 #include <fcntl.h>
 
+/*
+ *	DEFAULT entries are indexed on up to this many check
+ *	attributes.  Entries which can't be indexed are evaluated
+ *	for every request, as before.
+ */
+#define FILES_INDEX_MAX		(4)
+
+/*
+ *	An attribute must be compared with '==' in at least this
+ *	many DEFAULT entries before it's worth indexing.
+ */
+#define FILES_INDEX_MIN		(2)
+
+/*
+ *	Maximum number of candidate lists merged for a single
+ *	request.  If the request has more instances of the indexed
+ *	attributes than this, we fall back to a linear scan.
+ */
+#define FILES_MERGE_MAX		(16)
+
+/** DEFAULT entries which compare an indexed attribute against the same value
+ *
+ */
+typedef struct {
+	fr_value_box_t const	*key;		//!< Value the request attribute must be equal to.
+	PAIR_LIST const		**entries;	//!< Entries with this value, in file order.
+} files_bucket_t;
+
+/** Index of DEFAULT entries on a single check attribute
+ *
+ */
+typedef struct {
+	fr_dict_attr_t const	*da;		//!< Check attribute the entries are indexed on.
+	rbtree_t		*buckets;	//!< #files_bucket_t keyed on value.
+} files_index_t;
+
+/** A compiled "users" file
+ *
+ */
+typedef struct {
+	rbtree_t		*names;		//!< Named entries, keyed on name.
+	PAIR_LIST const		**defaults;	//!< All DEFAULT entries, in file order.
+	PAIR_LIST const		**unindexed;	//!< DEFAULT entries which must always be evaluated.
+	files_index_t		index[FILES_INDEX_MAX];
+	int			num_index;	//!< Number of attributes DEFAULT entries are indexed on.
+} files_list_t;
+
 typedef struct {
 	tmpl_t *key;
 
 	char const *filename;
-	rbtree_t *common;
+	files_list_t *common;
 
 	/* autz */
 	char const *usersfile;
-	rbtree_t *users;
+	files_list_t *users;
 
 
 	/* authenticate */
 	char const *auth_usersfile;
-	rbtree_t *auth_users;
+	files_list_t *auth_users;
 
 	/* preacct */
 	char const *acct_usersfile;
-	rbtree_t *acct_users;
+	files_list_t *acct_users;
 
 	/* post-authenticate */
 	char const *postauth_usersfile;
-	rbtree_t *postauth_users;
+	files_list_t *postauth_users;
 } rlm_files_t;
 
 static fr_dict_t const *dict_freeradius;
@@ -67,10 +114,12 @@ fr_dict_autoload_t rlm_files_dict[] = {
 };
 
 static fr_dict_attr_t const *attr_fall_through;
+static fr_dict_attr_t const *attr_user_password;
 
 extern fr_dict_attr_autoload_t rlm_files_dict_attr[];
 fr_dict_attr_autoload_t rlm_files_dict_attr[] = {
 	{ .out = &attr_fall_through, .name = "Fall-Through", .type = FR_TYPE_BOOL, .dict = &dict_freeradius },
+	{ .out = &attr_user_password, .name = "User-Password", .type = FR_TYPE_STRING, .dict = &dict_radius },
 
 	{ NULL }
 };
@@ -102,17 +151,198 @@ static int pairlist_cmp(void const *a, void const *b)
 	return strcmp(((PAIR_LIST const *)a)->name, ((PAIR_LIST const *)b)->name);
 }
 
-static int getusersfile(TALLOC_CTX *ctx, char const *filename, rbtree_t **ptree)
+static int bucket_cmp(void const *a, void const *b)
+{
+	return fr_value_box_cmp(((files_bucket_t const *)a)->key, ((files_bucket_t const *)b)->key);
+}
+
+/** Whether a check item can be used to select DEFAULT entries by value
+ *
+ * Only '==' comparisons of protocol attributes against literal values
+ * qualify.  Anything paircmp() treats specially has to be evaluated
+ * for every request.
+ */
+static bool files_indexable(VALUE_PAIR const *vp)
+{
+	if (vp->op != T_OP_CMP_EQ) return false;
+	if (vp->type != VT_DATA) return false;
+	if (vp->da->flags.has_tag) return false;
+	if (vp->da == attr_user_password) return false;
+	if (fr_dict_by_da(vp->da) != dict_radius) return false;
+	if (paircmp_find(vp->da)) return false;
+
+	switch (vp->vp_type) {
+	case FR_TYPE_STRING:
+	case FR_TYPE_OCTETS:
+	case FR_TYPE_UINT8:
+	case FR_TYPE_UINT16:
+	case FR_TYPE_UINT32:
+	case FR_TYPE_UINT64:
+	case FR_TYPE_INT32:
+	case FR_TYPE_DATE:
+	case FR_TYPE_IPV4_ADDR:
+	case FR_TYPE_IPV6_ADDR:
+	case FR_TYPE_IFID:
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+/** Return the first check item of an entry which can be indexed on da
+ *
+ */
+static VALUE_PAIR *files_index_key(PAIR_LIST const *entry, fr_dict_attr_t const *da)
+{
+	VALUE_PAIR *vp;
+
+	for (vp = entry->check; vp; vp = vp->next) {
+		if ((vp->da == da) && files_indexable(vp)) return vp;
+	}
+
+	return NULL;
+}
+
+/** Pick the attribute which selects the largest number of unindexed DEFAULT entries
+ *
+ */
+static fr_dict_attr_t const *files_index_pick(TALLOC_CTX *ctx, PAIR_LIST const **defaults, bool const *indexed)
+{
+	typedef struct {
+		fr_dict_attr_t const	*da;
+		size_t			count;
+	} files_tally_t;
+
+	files_tally_t		*tally;
+	fr_dict_attr_t const	*best = NULL;
+	size_t			best_count = FILES_INDEX_MIN - 1;
+	size_t			i, j, num_tally = 0;
+
+	MEM(tally = talloc_array(ctx, files_tally_t, 0));
+
+	for (i = 0; i < talloc_array_length(defaults); i++) {
+		VALUE_PAIR *vp;
+
+		if (indexed[i]) continue;
+
+		for (vp = defaults[i]->check; vp; vp = vp->next) {
+			if (!files_indexable(vp)) continue;
+
+			/*
+			 *	Count each attribute once per entry.
+			 */
+			if (files_index_key(defaults[i], vp->da) != vp) continue;
+
+			for (j = 0; j < num_tally; j++) if (tally[j].da == vp->da) break;
+
+			if (j == num_tally) {
+				MEM(tally = talloc_realloc(ctx, tally, files_tally_t, num_tally + 1));
+
+				tally[num_tally++] = (files_tally_t) { .da = vp->da };
+			}
+
+			if (++tally[j].count > best_count) {
+				best = tally[j].da;
+				best_count = tally[j].count;
+			}
+		}
+	}
+
+	talloc_free(tally);
+
+	return best;
+}
+
+/** Compile the DEFAULT entries of a users file into value indexes
+ *
+ * Entries are assigned to the index of the first attribute picked
+ * which they compare with '=='.  Each entry lives in exactly one
+ * bucket, or in the unindexed list, so merging the candidate lists
+ * by entry order reproduces the order of the file.
+ */
+static int files_index_build(files_list_t *list, PAIR_LIST *default_list)
+{
+	PAIR_LIST	*entry;
+	bool		*indexed;
+	size_t		i, num = 0, num_unindexed = 0;
+	int		ret = -1;
+
+	for (entry = default_list; entry; entry = entry->next) num++;
+
+	MEM(list->defaults = talloc_array(list, PAIR_LIST const *, num));
+	for (entry = default_list, i = 0; entry; entry = entry->next) list->defaults[i++] = entry;
+
+	MEM(indexed = talloc_zero_array(list, bool, num));
+
+	while (list->num_index < FILES_INDEX_MAX) {
+		files_index_t		*index = &list->index[list->num_index];
+		fr_dict_attr_t const	*da;
+
+		da = files_index_pick(list, list->defaults, indexed);
+		if (!da) break;
+
+		index->da = da;
+		index->buckets = rbtree_alloc(list, bucket_cmp, NULL, RBTREE_FLAG_NONE);
+		if (!index->buckets) goto finish;
+		list->num_index++;
+
+		for (i = 0; i < num; i++) {
+			VALUE_PAIR	*vp;
+			files_bucket_t	*bucket, find;
+			size_t		len;
+
+			if (indexed[i]) continue;
+
+			vp = files_index_key(list->defaults[i], da);
+			if (!vp) continue;
+
+			find.key = &vp->data;
+			bucket = rbtree_finddata(index->buckets, &find);
+			if (!bucket) {
+				MEM(bucket = talloc_zero(index->buckets, files_bucket_t));
+				bucket->key = &vp->data;
+				MEM(bucket->entries = talloc_array(bucket, PAIR_LIST const *, 0));
+				if (!rbtree_insert(index->buckets, bucket)) {
+					talloc_free(bucket);
+					goto finish;
+				}
+			}
+
+			len = talloc_array_length(bucket->entries);
+			MEM(bucket->entries = talloc_realloc(bucket, bucket->entries, PAIR_LIST const *, len + 1));
+			bucket->entries[len] = list->defaults[i];
+			indexed[i] = true;
+		}
+	}
+
+	for (i = 0; i < num; i++) if (!indexed[i]) num_unindexed++;
+
+	MEM(list->unindexed = talloc_array(list, PAIR_LIST const *, num_unindexed));
+	for (i = 0, num_unindexed = 0; i < num; i++) {
+		if (!indexed[i]) list->unindexed[num_unindexed++] = list->defaults[i];
+	}
+	ret = 0;
+
+finish:
+	talloc_free(indexed);
+
+	return ret;
+}
+
+static int getusersfile(TALLOC_CTX *ctx, char const *filename, files_list_t **plist)
 {
 	int rcode;
 	VALUE_PAIR *vp;
 	PAIR_LIST *users = NULL;
 	PAIR_LIST *entry, *next;
 	PAIR_LIST *user_list, *default_list, **default_tail;
-	rbtree_t *tree;
+	files_list_t *list;
+	fr_time_t start = fr_time();
+	size_t num_unindexed;
 
 	if (!filename) {
-		*ptree = NULL;
+		*plist = NULL;
 		return 0;
 	}
 
@@ -191,9 +421,11 @@ static int getusersfile(TALLOC_CTX *ctx, char const *filename, rbtree_t **ptree)
 		entry = entry->next;
 	}
 
-	tree = rbtree_alloc(ctx, pairlist_cmp, NULL, RBTREE_FLAG_NONE);
-	if (!tree) {
+	MEM(list = talloc_zero(ctx, files_list_t));
+	list->names = rbtree_alloc(list, pairlist_cmp, NULL, RBTREE_FLAG_NONE);
+	if (!list->names) {
 		pairlist_free(&users);
+		talloc_free(list);
 		return -1;
 	}
 
@@ -213,31 +445,11 @@ static int getusersfile(TALLOC_CTX *ctx, char const *filename, rbtree_t **ptree)
 		entry->next = NULL;
 
 		/*
-		 *	DEFAULT entries get their own list.
+		 *	DEFAULT entries get their own list, which
+		 *	is indexed below.
 		 */
 		if (strcmp(entry->name, "DEFAULT") == 0) {
-			if (!default_list) {
-				default_list = entry;
-
-				/*
-				 *	Insert the first DEFAULT into the tree.
-				 */
-				if (!rbtree_insert(tree, entry)) {
-				error:
-					pairlist_free(&entry);
-					pairlist_free(&next);
-					talloc_free(tree);
-					return -1;
-				}
-
-			} else {
-				/*
-				 *	Tack this entry onto the tail
-				 *	of the DEFAULT list.
-				 */
-				*default_tail = entry;
-			}
-
+			*default_tail = entry;
 			default_tail = &entry->next;
 			continue;
 		}
@@ -245,12 +457,19 @@ static int getusersfile(TALLOC_CTX *ctx, char const *filename, rbtree_t **ptree)
 		/*
 		 *	Not DEFAULT, must be a normal user.
 		 */
-		user_list = rbtree_finddata(tree, entry);
+		user_list = rbtree_finddata(list->names, entry);
 		if (!user_list) {
 			/*
 			 *	Insert the first one.
 			 */
-			if (!rbtree_insert(tree, entry)) goto error;
+			if (!rbtree_insert(list->names, entry)) {
+			error:
+				pairlist_free(&entry);
+				pairlist_free(&next);
+				pairlist_free(&default_list);
+				talloc_free(list);
+				return -1;
+			}
 		} else {
 			/*
 			 *	Find the tail of this list, and add it
@@ -262,7 +481,23 @@ static int getusersfile(TALLOC_CTX *ctx, char const *filename, rbtree_t **ptree)
 		}
 	}
 
-	*ptree = tree;
+	/*
+	 *	Most DEFAULT entries only match requests with a
+	 *	particular NAS, Called-Station-Id, etc.  Index them
+	 *	on those attributes, so that we only evaluate the
+	 *	entries which could possibly match.
+	 */
+	if (files_index_build(list, default_list) < 0) {
+		entry = next = NULL;
+		goto error;
+	}
+
+	num_unindexed = talloc_array_length(list->unindexed);
+	DEBUG("%s: Indexed %zu of %zu DEFAULT entries on %i attribute(s) in %.3f ms", filename,
+	      talloc_array_length(list->defaults) - num_unindexed, talloc_array_length(list->defaults),
+	      list->num_index, (double)(fr_time() - start) * 1000 / NSEC);
+
+	*plist = list;
 
 	return 0;
 }
@@ -288,10 +523,96 @@ static int mod_instantiate(void *instance, UNUSED CONF_SECTION *conf)
 	return 0;
 }
 
+/** A list of candidate DEFAULT entries, in file order
+ *
+ */
+typedef struct {
+	PAIR_LIST const		**entries;	//!< Candidate entries.
+	size_t			num;		//!< Number of entries.
+	size_t			next;		//!< Next entry to return.
+} files_merge_t;
+
+/** Find the lists of DEFAULT entries which could match the request
+ *
+ * @return the number of lists to merge.
+ */
+static int files_merge_init(files_merge_t *merge, files_list_t const *list,
+			    RADIUS_PACKET *packet)
+{
+	int	i, j, num = 0;
+
+#define MERGE_ADD(_entries) do { \
+	if (talloc_array_length(_entries) > 0) { \
+		if (num == FILES_MERGE_MAX) goto linear; \
+		merge[num++] = (files_merge_t) { .entries = (_entries), .num = talloc_array_length(_entries) }; \
+	} \
+} while (0)
+
+	MERGE_ADD(list->unindexed);
+
+	for (i = 0; i < list->num_index; i++) {
+		files_index_t const	*index = &list->index[i];
+		fr_cursor_t		cursor;
+		VALUE_PAIR		*vp;
+
+		for (vp = fr_pair_list_cursor_by_da_init(&cursor, &packet->vps, index->da);
+		     vp;
+		     vp = fr_cursor_next(&cursor)) {
+			files_bucket_t	*bucket, find = { .key = &vp->data };
+
+			bucket = rbtree_finddata(index->buckets, &find);
+			if (!bucket) continue;
+
+			/*
+			 *	The request may contain the same value
+			 *	more than once.
+			 */
+			for (j = 0; j < num; j++) if (merge[j].entries == bucket->entries) break;
+			if (j < num) continue;
+
+			MERGE_ADD(bucket->entries);
+		}
+	}
+
+#undef MERGE_ADD
+
+	return num;
+
+	/*
+	 *	Too many candidate lists, just walk all
+	 *	of the DEFAULT entries.
+	 */
+linear:
+	merge[0] = (files_merge_t) { .entries = list->defaults, .num = talloc_array_length(list->defaults) };
+
+	return 1;
+}
+
+/** Return the next candidate DEFAULT entry, in file order
+ *
+ */
+static PAIR_LIST const *files_merge_next(files_merge_t *merge, int num)
+{
+	files_merge_t	*best = NULL;
+	int		i;
+
+	for (i = 0; i < num; i++) {
+		if (merge[i].next == merge[i].num) continue;
+
+		if (!best || (merge[i].entries[merge[i].next]->order < best->entries[best->next]->order)) {
+			best = &merge[i];
+		}
+	}
+
+	if (!best) return NULL;
+
+	return best->entries[best->next++];
+}
+
 /*
  *	Common code called by everything below.
  */
-static rlm_rcode_t file_common(rlm_files_t const *inst, REQUEST *request, char const *filename, rbtree_t *tree,
+static rlm_rcode_t file_common(rlm_files_t const *inst, REQUEST *request, char const *filename, files_list_t const *list,
 			       RADIUS_PACKET *packet, RADIUS_PACKET *reply)
 {
 	char const	*name;
@@ -301,18 +622,21 @@ static rlm_rcode_t file_common(rlm_files_t const *inst, REQUEST *request, char c
 	bool		found = false;
 	PAIR_LIST	my_pl;
 	char		buffer[256];
+	files_merge_t	merge[FILES_MERGE_MAX];
+	int		num_merge;
 
 	if (tmpl_expand(&name, buffer, sizeof(buffer), request, inst->key, NULL, NULL) < 0) {
 		REDEBUG("Failed expanding key %s", inst->key->name);
 		return RLM_MODULE_FAIL;
 	}
 
-	if (!tree) return RLM_MODULE_NOOP;
+	if (!list) return RLM_MODULE_NOOP;
 
 	my_pl.name = name;
-	user_pl = rbtree_finddata(tree, &my_pl);
-	my_pl.name = "DEFAULT";
-	default_pl = rbtree_finddata(tree, &my_pl);
+	user_pl = rbtree_finddata(list->names, &my_pl);
+
+	num_merge = files_merge_init(merge, list, packet);
+	default_pl = files_merge_next(merge, num_merge);
 
 	/*
 	 *	Find the entry for the user.
@@ -332,7 +656,7 @@ static rlm_rcode_t file_common(rlm_files_t const *inst, REQUEST *request, char c
 
 		} else if (!user_pl && default_pl) {
 			pl = default_pl;
-			default_pl = default_pl->next;
+			default_pl = files_merge_next(merge, num_merge);
 
 		} else if (user_pl->order < default_pl->order) {
 			pl = user_pl;
@@ -340,7 +664,7 @@ static rlm_rcode_t file_common(rlm_files_t const *inst, REQUEST *request, char c
 
 		} else {
 			pl = default_pl;
-			default_pl = default_pl->next;
+			default_pl = files_merge_next(merge, num_merge);
 		}
 
 		MEM(fr_pair_list_copy(request, &check_tmp, pl->check) >= 0);
@@ -354,7 +678,7 @@ static rlm_rcode_t file_common(rlm_files_t const *inst, REQUEST *request, char c
 			}
 		}
 
-		if (paircmp(request, packet->vps, check_tmp, &reply->vps) == 0) {
+		if (paircmp(request, fr_pair_list_head(&packet->vps), check_tmp, &reply->vps) == 0) {
 			RDEBUG2("Found match \"%s\" one line %d of %s", pl->name, pl->lineno, filename);
 			found = true;
 
@@ -378,7 +702,7 @@ static rlm_rcode_t file_common(rlm_files_t const *inst, REQUEST *request, char c
 	/*
 	 *	Remove server internal parameters.
 	 */
-	fr_pair_delete_by_da(&reply->vps, attr_fall_through);
+	fr_pair_list_delete_by_da(&reply->vps, attr_fall_through);
 
 	/*
 	 *	See if we succeeded.
@@ -36,43 +36,31 @@ USES_APPLE_DEPRECATED_API
 
 #include "rlm_ldap.h"
 
-/** Convert multiple group names into a DNs
+/** Build a filter matching multiple group names
  *
- * Given an array of group names, builds a filter matching all names, then retrieves all group objects
- * and stores the DN associated with each group object.
+ * It'll probably only save a few ms in network latency, but it means we can send a query
+ * for the entire group list at once.
  *
  * @param[in] inst rlm_ldap configuration.
  * @param[in] request Current request.
- * @param[in,out] pconn to use. May change as this function calls functions which auto re-connect.
  * @param[in] names to convert to DNs (NULL terminated).
- * @param[out] out Where to write the DNs. DNs must be freed with ldap_memfree(). Will be NULL terminated.
- * @param[in] outlen Size of out.
- * @return One of the RLM_MODULE_* values.
+ * @param[out] base_dn Where to write a pointer to the expanded base DN.
+ * @param[in] base_dn_buff Buffer to expand the base DN into.  Must be at least #LDAP_MAX_DN_STR_LEN bytes.
+ * @param[out] filter Where to write the filter.  Must be freed with talloc_free.
+ * @return
+ *	- #RLM_MODULE_OK if the search should be performed.
+ *	- #RLM_MODULE_NOOP if there are no names to convert.
+ *	- #RLM_MODULE_INVALID on error.
  */
-static rlm_rcode_t rlm_ldap_group_name2dn(rlm_ldap_t const *inst, REQUEST *request, fr_ldap_connection_t **pconn,
-					  char **names, char **out, size_t outlen)
+static rlm_rcode_t rlm_ldap_group_name2dn_expand(rlm_ldap_t const *inst, REQUEST *request, char * const *names,
+						 char const **base_dn, char base_dn_buff[], char **filter)
 {
-	rlm_rcode_t rcode = RLM_MODULE_OK;
-	fr_ldap_rcode_t status;
-	int ldap_errno;
-
-	unsigned int name_cnt = 0;
-	unsigned int entry_cnt;
-	char const *attrs[] = { NULL };
-
-	LDAPMessage *result = NULL, *entry;
+	char * const	*name = names;
+	char		buffer[LDAP_MAX_GROUP_NAME_LEN + 1];
 
-	char **name = names;
-	char **dn = out;
-	char const *base_dn = NULL;
-	char base_dn_buff[LDAP_MAX_DN_STR_LEN];
-	char buffer[LDAP_MAX_GROUP_NAME_LEN + 1];
+	*filter = NULL;
 
-	char *filter;
-
-	*dn = NULL;
-
-	if (!*names) return RLM_MODULE_OK;
+	if (!*names) return RLM_MODULE_NOOP;
 
 	if (!inst->groupobj_name_attr) {
 		REDEBUG("Told to convert group names to DNs but missing 'group.name_attribute' directive");
@@ -82,142 +70,52 @@ static rlm_rcode_t rlm_ldap_group_name2dn(rlm_ldap_t const *inst, REQUEST *reque
 
 	RDEBUG2("Converting group name(s) to group DN(s)");
 
-	/*
-	 *	It'll probably only save a few ms in network latency, but it means we can send a query
-	 *	for the entire group list at once.
-	 */
-	filter = talloc_typed_asprintf(request, "%s%s%s",
-				 inst->groupobj_filter ? "(&" : "",
-				 inst->groupobj_filter ? inst->groupobj_filter : "",
-				 names[0] && names[1] ? "(|" : "");
-	while (*name) {
-		fr_ldap_escape_func(request, buffer, sizeof(buffer), *name++, NULL);
-		filter = talloc_asprintf_append_buffer(filter, "(%s=%s)", inst->groupobj_name_attr, buffer);
-
-		name_cnt++;
-	}
-	filter = talloc_asprintf_append_buffer(filter, "%s%s",
-					       inst->groupobj_filter ? ")" : "",
-					       names[0] && names[1] ? ")" : "");
-
-	if (tmpl_expand(&base_dn, base_dn_buff, sizeof(base_dn_buff), request,
+	if (tmpl_expand(base_dn, base_dn_buff, LDAP_MAX_DN_STR_LEN, request,
 			inst->groupobj_base_dn, fr_ldap_escape_func, NULL) < 0) {
 		REDEBUG("Failed creating base_dn");
 
 		return RLM_MODULE_INVALID;
 	}
 
-	status = fr_ldap_search(&result, request, pconn, base_dn, inst->groupobj_scope,
-				filter, attrs, NULL, NULL);
-	switch (status) {
-	case LDAP_PROC_SUCCESS:
-		break;
-
-	case LDAP_PROC_NO_RESULT:
-		RDEBUG2("Tried to resolve group name(s) to DNs but got no results");
-		goto finish;
-
-	default:
-		rcode = RLM_MODULE_FAIL;
-		goto finish;
-	}
-
-	entry_cnt = ldap_count_entries((*pconn)->handle, result);
-	if (entry_cnt > name_cnt) {
-		REDEBUG("Number of DNs exceeds number of names, group and/or dn should be more restrictive");
-		rcode = RLM_MODULE_INVALID;
-
-		goto finish;
-	}
-
-	if (entry_cnt > (outlen - 1)) {
-		REDEBUG("Number of DNs exceeds limit (%zu)", outlen - 1);
-		rcode = RLM_MODULE_INVALID;
-
-		goto finish;
-	}
-
-	if (entry_cnt < name_cnt) {
-		RWDEBUG("Got partial mapping of group names (%i) to DNs (%i), membership information may be incomplete",
-			name_cnt, entry_cnt);
-	}
-
-	entry = ldap_first_entry((*pconn)->handle, result);
-	if (!entry) {
-		ldap_get_option((*pconn)->handle, LDAP_OPT_RESULT_CODE, &ldap_errno);
-		REDEBUG("Failed retrieving entry: %s", ldap_err2string(ldap_errno));
-
-		rcode = RLM_MODULE_FAIL;
-		goto finish;
-	}
-
-	do {
-		*dn = ldap_get_dn((*pconn)->handle, entry);
-		if (!*dn) {
-			ldap_get_option((*pconn)->handle, LDAP_OPT_RESULT_CODE, &ldap_errno);
-			REDEBUG("Retrieving object DN from entry failed: %s", ldap_err2string(ldap_errno));
-
-			rcode = RLM_MODULE_FAIL;
-			goto finish;
-		}
-		fr_ldap_util_normalise_dn(*dn, *dn);
-
-		RDEBUG2("Got group DN \"%s\"", *dn);
-		dn++;
-	} while((entry = ldap_next_entry((*pconn)->handle, entry)));
-
-	*dn = NULL;
-
-finish:
-	talloc_free(filter);
-	if (result) ldap_msgfree(result);
-
-	/*
-	 *	Be nice and cleanup the output array if we error out.
-	 */
-	if (rcode != RLM_MODULE_OK) {
-		dn = out;
-		while(*dn) ldap_memfree(*dn++);
-		*dn = NULL;
+	*filter = talloc_typed_asprintf(request, "%s%s%s",
+					inst->groupobj_filter ? "(&" : "",
+					inst->groupobj_filter ? inst->groupobj_filter : "",
+					names[0] && names[1] ? "(|" : "");
+	while (*name) {
+		fr_ldap_escape_func(request, buffer, sizeof(buffer), *name++, NULL);
+		*filter = talloc_asprintf_append_buffer(*filter, "(%s=%s)", inst->groupobj_name_attr, buffer);
 	}
+	*filter = talloc_asprintf_append_buffer(*filter, "%s%s",
+						inst->groupobj_filter ? ")" : "",
+						names[0] && names[1] ? ")" : "");
 
-	return rcode;
+	return RLM_MODULE_OK;
 }
 
-/** Convert a single group name into a DN
+/** Convert the result of a search for a single group object to the group's name
  *
  * Unlike the inverse conversion of a name to a DN, most LDAP directories don't allow filtering by DN,
  * so we need to search for each DN individually.
  *
  * @param[in] inst rlm_ldap configuration.
  * @param[in] request Current request.
- * @param[in,out] pconn to use. May change as this function calls functions which auto re-connect.
- * @param[in] dn to resolve.
+ * @param[in] conn used to parse the result.
+ * @param[in] dn the search was performed for.
+ * @param[in] status of the search.
+ * @param[in] result of the search.  Not freed.
  * @param[out] out Where to write group name (must be freed with talloc_free).
  * @return One of the RLM_MODULE_* values.
  */
-static rlm_rcode_t rlm_ldap_group_dn2name(rlm_ldap_t const *inst, REQUEST *request,
-					  fr_ldap_connection_t **pconn, char const *dn, char **out)
+static rlm_rcode_t rlm_ldap_group_dn2name_result(rlm_ldap_t const *inst, REQUEST *request,
+						 fr_ldap_connection_t const *conn, char const *dn,
+						 fr_ldap_rcode_t status, LDAPMessage *result, char **out)
 {
-	rlm_rcode_t rcode = RLM_MODULE_OK;
-	fr_ldap_rcode_t status;
-	int ldap_errno;
-
-	struct berval **values = NULL;
-	char const *attrs[] = { inst->groupobj_name_attr, NULL };
-	LDAPMessage *result = NULL, *entry;
+	int		ldap_errno;
+	struct berval	**values;
+	LDAPMessage	*entry;
 
 	*out = NULL;
 
-	if (!inst->groupobj_name_attr) {
-		REDEBUG("Told to resolve group DN to name but missing 'group.name_attribute' directive");
-
-		return RLM_MODULE_INVALID;
-	}
-
-	RDEBUG2("Resolving group DN \"%s\" to group name", dn);
-
-	status = fr_ldap_search(&result, request, pconn, dn, LDAP_SCOPE_BASE, NULL, attrs, NULL, NULL);
 	switch (status) {
 	case LDAP_PROC_SUCCESS:
 		break;
@@ -230,71 +128,76 @@ static rlm_rcode_t rlm_ldap_group_dn2name(rlm_ldap_t const *inst, REQUEST *reque
 		return RLM_MODULE_FAIL;
 	}
 
-	entry = ldap_first_entry((*pconn)->handle, result);
+	entry = ldap_first_entry(conn->handle, result);
 	if (!entry) {
-		ldap_get_option((*pconn)->handle, LDAP_OPT_RESULT_CODE, &ldap_errno);
+		ldap_get_option(conn->handle, LDAP_OPT_RESULT_CODE, &ldap_errno);
 		REDEBUG("Failed retrieving entry: %s", ldap_err2string(ldap_errno));
 
-		rcode = RLM_MODULE_INVALID;
-		goto finish;
+		return RLM_MODULE_INVALID;
 	}
 
-	values = ldap_get_values_len((*pconn)->handle, entry, inst->groupobj_name_attr);
+	values = ldap_get_values_len(conn->handle, entry, inst->groupobj_name_attr);
 	if (!values) {
 		REDEBUG("No %s attributes found in object", inst->groupobj_name_attr);
 
-		rcode = RLM_MODULE_INVALID;
-
-		goto finish;
+		return RLM_MODULE_INVALID;
 	}
 
 	*out = fr_ldap_berval_to_string(request, values[0]);
 	RDEBUG2("Group DN \"%s\" resolves to name \"%s\"", dn, *out);
 
-finish:
-	if (result) ldap_msgfree(result);
-	if (values) ldap_value_free_len(values);
+	ldap_value_free_len(values);
 
-	return rcode;
+	return RLM_MODULE_OK;
 }
 
-/** Convert group membership information into attributes
+/** Free any memberships which weren't added to the control list
+ *
+ */
+static int _userobj_groups_free(rlm_ldap_userobj_groups_t *groups)
+{
+	fr_pair_list_free(&groups->groups);
+
+	return 0;
+}
+
+/** Parse group membership information from a user object
+ *
+ * Memberships which are already in the form we're caching are converted to attributes
+ * straight away.  Group names which need converting to DNs, and group DNs which need
+ * converting to names, are recorded so they can be resolved with
+ * #rlm_ldap_cacheable_userobj_dn2name and #rlm_ldap_cacheable_userobj_name2dn.
  *
+ * @param[out] out Where to write the parsed memberships.  NULL if the user object has none.
+ * @param[in] ctx to allocate the parsed memberships in.
  * @param[in] inst rlm_ldap configuration.
  * @param[in] request Current request.
- * @param[in,out] pconn to use. May change as this function calls functions which auto re-connect.
+ * @param[in] conn used to parse the entry.
  * @param[in] entry retrieved by rlm_ldap_find_user or fr_ldap_search.
  * @param[in] attr membership attribute to look for in the entry.
  * @return One of the RLM_MODULE_* values.
  */
-rlm_rcode_t rlm_ldap_cacheable_userobj(rlm_ldap_t const *inst, REQUEST *request, fr_ldap_connection_t **pconn,
-				       LDAPMessage *entry, char const *attr)
+rlm_rcode_t rlm_ldap_cacheable_userobj_parse(rlm_ldap_userobj_groups_t **out, TALLOC_CTX *ctx,
+					     rlm_ldap_t const *inst, REQUEST *request,
+					     fr_ldap_connection_t const *conn, LDAPMessage *entry, char const *attr)
 {
-	rlm_rcode_t rcode = RLM_MODULE_OK;
-
-	struct berval **values;
-
-	char *group_name[LDAP_MAX_CACHEABLE + 1];
-	char **name_p = group_name;
-
-	char *group_dn[LDAP_MAX_CACHEABLE + 1];
-	char **dn_p;
-
-	char *name;
-
-	VALUE_PAIR *vp, **list, *groups = NULL;
-	TALLOC_CTX *list_ctx, *value_ctx;
-	fr_cursor_t list_cursor, groups_cursor;
-
-	int is_dn, i, count;
+	rlm_ldap_userobj_groups_t	*groups;
+	struct berval			**values;
+	char				**name_p, **dn_p;
+	VALUE_PAIR			*vp;
+	TALLOC_CTX			*list_ctx;
+	fr_cursor_t			groups_cursor;
+	int				is_dn, i, count;
 
 	fr_assert(entry);
 	fr_assert(attr);
 
+	*out = NULL;
+
 	/*
 	 *	Parse the membership information we got in the initial user query.
 	 */
-	values = ldap_get_values_len((*pconn)->handle, entry, attr);
+	values = ldap_get_values_len(conn->handle, entry, attr);
 	if (!values) {
 		RDEBUG2("No cacheable group memberships found in user object");
 
@@ -302,22 +205,20 @@ rlm_rcode_t rlm_ldap_cacheable_userobj(rlm_ldap_t const *inst, REQUEST *request,
 	}
 	count = ldap_count_values_len(values);
 
-	list = radius_list(request, PAIR_LIST_CONTROL);
 	list_ctx = radius_list_ctx(request, PAIR_LIST_CONTROL);
-	fr_assert(list != NULL);
 	fr_assert(list_ctx != NULL);
 
-	/*
-	 *	Simplifies freeing temporary values
-	 */
-	value_ctx = talloc_new(request);
+	MEM(groups = talloc_zero(ctx, rlm_ldap_userobj_groups_t));
+	talloc_set_destructor(groups, _userobj_groups_free);
+	name_p = groups->names;
+	dn_p = groups->dns;
 
 	/*
 	 *	Temporary list to hold new group VPs, will be merged
 	 *	once all group info has been gathered/resolved
 	 *	successfully.
 	 */
-	fr_cursor_init(&groups_cursor, &groups);
+	fr_cursor_init(&groups_cursor, &groups->groups);
 
 	for (i = 0; (i < LDAP_MAX_CACHEABLE) && (i < count); i++) {
 		is_dn = fr_ldap_util_is_dn(values[i]->bv_val, values[i]->bv_len);
@@ -335,7 +236,7 @@ rlm_rcode_t rlm_ldap_cacheable_userobj(rlm_ldap_t const *inst, REQUEST *request,
 			 *	this to a DN. Store all the group names in an array so we can do one query.
 			 */
 			} else {
-				*name_p++ = fr_ldap_berval_to_string(value_ctx, values[i]);
+				*name_p++ = fr_ldap_berval_to_string(groups, values[i]);
 			}
 		}
 
@@ -354,64 +255,200 @@ rlm_rcode_t rlm_ldap_cacheable_userobj(rlm_ldap_t const *inst, REQUEST *request,
 			 *	for each individual group.
 			 */
 			} else {
-				char *dn;
+				*dn_p++ = fr_ldap_berval_to_string(groups, values[i]);
+			}
+		}
+	}
+	*name_p = NULL;
+	*dn_p = NULL;
 
-				dn = fr_ldap_berval_to_string(value_ctx, values[i]);
-				rcode = rlm_ldap_group_dn2name(inst, request, pconn, dn, &name);
-				talloc_free(dn);
+	ldap_value_free_len(values);
 
-				if (rcode == RLM_MODULE_NOOP) continue;
+	if (groups->dns[0] && !inst->groupobj_name_attr) {
+		REDEBUG("Told to resolve group DN to name but missing 'group.name_attribute' directive");
+		talloc_free(groups);
 
-				if (rcode != RLM_MODULE_OK) {
-					ldap_value_free_len(values);
-					talloc_free(value_ctx);
-					fr_pair_list_free(&groups);
+		return RLM_MODULE_INVALID;
+	}
 
-					return rcode;
-				}
+	*out = groups;
 
-				MEM(vp = fr_pair_afrom_da(list_ctx, inst->cache_da));
-				fr_pair_value_bstrdup_buffer(vp, name, true);
-				fr_cursor_append(&groups_cursor, vp);
-				talloc_free(name);
-			}
-		}
-	}
-	*name_p = NULL;
+	return RLM_MODULE_OK;
+}
 
-	rcode = rlm_ldap_group_name2dn(inst, request, pconn, group_name, group_dn, sizeof(group_dn));
+/** Convert the name of the next group DN from a user object to an attribute
+ *
+ * The search should have been for groups->dns[groups->dn_idx], with scope base, retrieving
+ * the group name attribute.
+ *
+ * @param[in] inst rlm_ldap configuration.
+ * @param[in] request Current request.
+ * @param[in] groups being resolved.
+ * @param[in] conn used to parse the result.
+ * @param[in] status of the search.
+ * @param[in] result of the search.  Not freed.
+ * @return One of the RLM_MODULE_* values.
+ */
+rlm_rcode_t rlm_ldap_cacheable_userobj_dn2name(rlm_ldap_t const *inst, REQUEST *request,
+					       rlm_ldap_userobj_groups_t *groups, fr_ldap_connection_t const *conn,
+					       fr_ldap_rcode_t status, LDAPMessage *result)
+{
+	rlm_rcode_t	rcode;
+	VALUE_PAIR	*vp;
+	fr_cursor_t	groups_cursor;
+	char		*name;
 
-	ldap_value_free_len(values);
-	talloc_free(value_ctx);
+	fr_assert(groups->dns[groups->dn_idx]);
 
+	rcode = rlm_ldap_group_dn2name_result(inst, request, conn, groups->dns[groups->dn_idx++],
+					      status, result, &name);
+	if (rcode == RLM_MODULE_NOOP) return RLM_MODULE_OK;	/* Dangling reference */
 	if (rcode != RLM_MODULE_OK) return rcode;
 
-	fr_cursor_init(&list_cursor, list);
+	MEM(vp = fr_pair_afrom_da(radius_list_ctx(request, PAIR_LIST_CONTROL), inst->cache_da));
+	fr_pair_value_bstrdup_buffer(vp, name, true);
+	fr_cursor_init(&groups_cursor, &groups->groups);
+	fr_cursor_append(&groups_cursor, vp);
+	talloc_free(name);
+
+	return RLM_MODULE_OK;
+}
+
+/** Expand the base DN and filter used to convert the group names from a user object to DNs
+ *
+ * @param[in] inst rlm_ldap configuration.
+ * @param[in] request Current request.
+ * @param[in] groups being resolved.
+ * @param[out] base_dn Where to write a pointer to the expanded base DN.
+ * @param[in] base_dn_buff Buffer to expand the base DN into.  Must be at least #LDAP_MAX_DN_STR_LEN bytes.
+ * @param[out] filter Where to write the filter.  Must be freed with talloc_free.
+ * @return
+ *	- #RLM_MODULE_OK if the search should be performed.
+ *	- #RLM_MODULE_NOOP if there are no names to convert.
+ *	- #RLM_MODULE_INVALID on error.
+ */
+rlm_rcode_t rlm_ldap_cacheable_userobj_name2dn_expand(rlm_ldap_t const *inst, REQUEST *request,
+						      rlm_ldap_userobj_groups_t const *groups,
+						      char const **base_dn, char base_dn_buff[], char **filter)
+{
+	return rlm_ldap_group_name2dn_expand(inst, request, groups->names, base_dn, base_dn_buff, filter);
+}
+
+/** Convert the DNs of the groups named in a user object to attributes
+ *
+ * @param[in] inst rlm_ldap configuration.
+ * @param[in] request Current request.
+ * @param[in] groups being resolved.
+ * @param[in] conn used to parse the result.
+ * @param[in] status of the search.
+ * @param[in] result of the search.  Not freed.
+ * @return One of the RLM_MODULE_* values.
+ */
+rlm_rcode_t rlm_ldap_cacheable_userobj_name2dn(rlm_ldap_t const *inst, REQUEST *request,
+					       rlm_ldap_userobj_groups_t *groups, fr_ldap_connection_t const *conn,
+					       fr_ldap_rcode_t status, LDAPMessage *result)
+{
+	int		ldap_errno;
+	unsigned int	name_cnt = 0;
+	unsigned int	entry_cnt;
+	LDAPMessage	*entry;
+	VALUE_PAIR	*vp;
+	fr_cursor_t	groups_cursor;
+	char		*dn;
+
+	while (groups->names[name_cnt]) name_cnt++;
+
+	switch (status) {
+	case LDAP_PROC_SUCCESS:
+		break;
+
+	case LDAP_PROC_NO_RESULT:
+		RDEBUG2("Tried to resolve group name(s) to DNs but got no results");
+		return RLM_MODULE_OK;
+
+	default:
+		return RLM_MODULE_FAIL;
+	}
+
+	entry_cnt = ldap_count_entries(conn->handle, result);
+	if (entry_cnt > name_cnt) {
+		REDEBUG("Number of DNs exceeds number of names, group and/or dn should be more restrictive");
+
+		return RLM_MODULE_INVALID;
+	}
+
+	if (entry_cnt > LDAP_MAX_CACHEABLE) {
+		REDEBUG("Number of DNs exceeds limit (%i)", LDAP_MAX_CACHEABLE);
+
+		return RLM_MODULE_INVALID;
+	}
+
+	if (entry_cnt < name_cnt) {
+		RWDEBUG("Got partial mapping of group names (%i) to DNs (%i), membership information may be incomplete",
+			name_cnt, entry_cnt);
+	}
+
+	entry = ldap_first_entry(conn->handle, result);
+	if (!entry) {
+		ldap_get_option(conn->handle, LDAP_OPT_RESULT_CODE, &ldap_errno);
+		REDEBUG("Failed retrieving entry: %s", ldap_err2string(ldap_errno));
+
+		return RLM_MODULE_FAIL;
+	}
+
+	fr_cursor_init(&groups_cursor, &groups->groups);
+	do {
+		dn = ldap_get_dn(conn->handle, entry);
+		if (!dn) {
+			ldap_get_option(conn->handle, LDAP_OPT_RESULT_CODE, &ldap_errno);
+			REDEBUG("Retrieving object DN from entry failed: %s", ldap_err2string(ldap_errno));
+
+			return RLM_MODULE_FAIL;
+		}
+		fr_ldap_util_normalise_dn(dn, dn);
+
+		RDEBUG2("Got group DN \"%s\"", dn);
+
+		MEM(vp = fr_pair_afrom_da(radius_list_ctx(request, PAIR_LIST_CONTROL), inst->cache_da));
+		fr_pair_value_strdup(vp, dn);
+		fr_cursor_append(&groups_cursor, vp);
+		ldap_memfree(dn);
+	} while((entry = ldap_next_entry(conn->handle, entry)));
+
+	return RLM_MODULE_OK;
+}
+
+/** Add the memberships from a user object to the control list
+ *
+ * @param[in] inst rlm_ldap configuration.
+ * @param[in] request Current request.
+ * @param[in] groups which have been resolved.
+ */
+void rlm_ldap_cacheable_userobj_merge(rlm_ldap_t const *inst, REQUEST *request, rlm_ldap_userobj_groups_t *groups)
+{
+	VALUE_PAIR	*vp;
+	fr_pair_list_t	*list;
+	fr_cursor_t	list_cursor, groups_cursor;
+
+	list = radius_list(request, PAIR_LIST_CONTROL);
+	fr_assert(list != NULL);
+
+	fr_pair_list_cursor_init(&list_cursor, list);
 
 	RDEBUG2("Adding cacheable user object memberships");
-	RINDENT();
+	fr_cursor_init(&groups_cursor, &groups->groups);
 	if (RDEBUG_ENABLED) {
+		RINDENT();
 		for (vp = fr_cursor_head(&groups_cursor);
 		     vp;
 		     vp = fr_cursor_next(&groups_cursor)) {
 			RDEBUG2("&control:%s += \"%pV\"", inst->cache_da->name, &vp->data);
 		}
+		REXDENT();
 	}
 
 	fr_cursor_head(&groups_cursor);
 	fr_cursor_merge(&list_cursor, &groups_cursor);
-
-	for (dn_p = group_dn; *dn_p; dn_p++) {
-		MEM(vp = fr_pair_afrom_da(list_ctx, inst->cache_da));
-		fr_pair_value_strdup(vp, *dn_p);
-		fr_cursor_append(&list_cursor, vp);
-
-		RDEBUG2("&control:%s += \"%pV\"", inst->cache_da->name, &vp->data);
-		ldap_memfree(*dn_p);
-	}
-	REXDENT();
-
-	return rcode;
 }
 
 /** Convert group membership information into attributes
@@ -419,81 +456,158 @@ rlm_rcode_t rlm_ldap_cacheable_userobj(rlm_ldap_t const *inst, REQUEST *request,
  * @param[in] inst rlm_ldap configuration.
  * @param[in] request Current request.
  * @param[in,out] pconn to use. May change as this function calls functions which auto re-connect.
+ * @param[in] entry retrieved by rlm_ldap_find_user or fr_ldap_search.
+ * @param[in] attr membership attribute to look for in the entry.
  * @return One of the RLM_MODULE_* values.
  */
-rlm_rcode_t rlm_ldap_cacheable_groupobj(rlm_ldap_t const *inst, REQUEST *request, fr_ldap_connection_t **pconn)
+rlm_rcode_t rlm_ldap_cacheable_userobj(rlm_ldap_t const *inst, REQUEST *request, fr_ldap_connection_t **pconn,
+				       LDAPMessage *entry, char const *attr)
 {
-	rlm_rcode_t rcode = RLM_MODULE_OK;
-	fr_ldap_rcode_t status;
-	int ldap_errno;
+	rlm_ldap_userobj_groups_t	*groups;
+	rlm_rcode_t			rcode;
+	fr_ldap_rcode_t			status;
+	LDAPMessage			*result;
+	char const			*base_dn;
+	char				base_dn_buff[LDAP_MAX_DN_STR_LEN];
+	char				*filter;
+
+	rcode = rlm_ldap_cacheable_userobj_parse(&groups, request, inst, request, *pconn, entry, attr);
+	if (!groups) return rcode;
+
+	while (groups->dns[groups->dn_idx]) {
+		char const *attrs[] = { inst->groupobj_name_attr, NULL };
+
+		RDEBUG2("Resolving group DN \"%s\" to group name", groups->dns[groups->dn_idx]);
+
+		result = NULL;
+		status = fr_ldap_search(&result, request, pconn, groups->dns[groups->dn_idx], LDAP_SCOPE_BASE,
+					NULL, attrs, NULL, NULL);
+		rcode = rlm_ldap_cacheable_userobj_dn2name(inst, request, groups, *pconn, status, result);
+		if (result) ldap_msgfree(result);
+		if (rcode != RLM_MODULE_OK) goto finish;
+	}
 
-	LDAPMessage *result = NULL;
-	LDAPMessage *entry;
+	rcode = rlm_ldap_cacheable_userobj_name2dn_expand(inst, request, groups, &base_dn, base_dn_buff, &filter);
+	switch (rcode) {
+	case RLM_MODULE_OK:
+	{
+		char const *attrs[] = { NULL };
 
-	char const *base_dn;
-	char base_dn_buff[LDAP_MAX_DN_STR_LEN];
+		result = NULL;
+		status = fr_ldap_search(&result, request, pconn, base_dn, inst->groupobj_scope,
+					filter, attrs, NULL, NULL);
+		talloc_free(filter);
 
-	char const *filters[] = { inst->groupobj_filter, inst->groupobj_membership_filter };
-	char filter[LDAP_MAX_FILTER_STR_LEN + 1];
+		rcode = rlm_ldap_cacheable_userobj_name2dn(inst, request, groups, *pconn, status, result);
+		if (result) ldap_msgfree(result);
+		if (rcode != RLM_MODULE_OK) goto finish;
+	}
+		break;
 
-	char const *attrs[] = { inst->groupobj_name_attr, NULL };
+	case RLM_MODULE_NOOP:
+		rcode = RLM_MODULE_OK;
+		break;
 
-	VALUE_PAIR *vp;
-	char *dn;
+	default:
+		goto finish;
+	}
+
+	rlm_ldap_cacheable_userobj_merge(inst, request, groups);
+
+finish:
+	talloc_free(groups);
+
+	return rcode;
+}
+
+/** Expand the base DN and filter used to find the group objects the user is a member of
+ *
+ * @param[in] inst rlm_ldap configuration.
+ * @param[in] request Current request.
+ * @param[out] base_dn Where to write a pointer to the expanded base DN.
+ * @param[in] base_dn_buff Buffer to expand the base DN into.  Must be at least #LDAP_MAX_DN_STR_LEN bytes.
+ * @param[in] filter Buffer to write the filter to.  Must be at least #LDAP_MAX_FILTER_STR_LEN + 1 bytes.
+ * @return
+ *	- #RLM_MODULE_OK if the search should be performed.
+ *	- #RLM_MODULE_NOOP if no membership filter is configured.
+ *	- #RLM_MODULE_INVALID on error.
+ */
+rlm_rcode_t rlm_ldap_cacheable_groupobj_expand(rlm_ldap_t const *inst, REQUEST *request,
+					       char const **base_dn, char base_dn_buff[], char filter[])
+{
+	char const *filters[] = { inst->groupobj_filter, inst->groupobj_membership_filter };
 
 	fr_assert(inst->groupobj_base_dn);
 
 	if (!inst->groupobj_membership_filter) {
 		RDEBUG2("Skipping caching group objects as directive 'group.membership_filter' is not set");
 
-		return RLM_MODULE_OK;
+		return RLM_MODULE_NOOP;
 	}
 
 	if (fr_ldap_xlat_filter(request,
 				 filters, NUM_ELEMENTS(filters),
-				 filter, sizeof(filter)) < 0) {
+				 filter, LDAP_MAX_FILTER_STR_LEN + 1) < 0) {
 		return RLM_MODULE_INVALID;
 	}
 
-	if (tmpl_expand(&base_dn, base_dn_buff, sizeof(base_dn_buff), request,
+	if (tmpl_expand(base_dn, base_dn_buff, LDAP_MAX_DN_STR_LEN, request,
 			inst->groupobj_base_dn, fr_ldap_escape_func, NULL) < 0) {
 		REDEBUG("Failed creating base_dn");
 
 		return RLM_MODULE_INVALID;
 	}
 
-	status = fr_ldap_search(&result, request, pconn, base_dn,
-				inst->groupobj_scope, filter, attrs, NULL, NULL);
+	return RLM_MODULE_OK;
+}
+
+/** Convert the group objects the user is a member of into attributes
+ *
+ * @param[in] inst rlm_ldap configuration.
+ * @param[in] request Current request.
+ * @param[in] conn used to parse the result.
+ * @param[in] status of the search.
+ * @param[in] result of the search.  Not freed.
+ * @return One of the RLM_MODULE_* values.
+ */
+rlm_rcode_t rlm_ldap_cacheable_groupobj_result(rlm_ldap_t const *inst, REQUEST *request,
+					       fr_ldap_connection_t const *conn,
+					       fr_ldap_rcode_t status, LDAPMessage *result)
+{
+	int		ldap_errno;
+	LDAPMessage	*entry;
+	VALUE_PAIR	*vp;
+	char		*dn;
+
 	switch (status) {
 	case LDAP_PROC_SUCCESS:
 		break;
 
 	case LDAP_PROC_NO_RESULT:
 		RDEBUG2("No cacheable group memberships found in group objects");
-		goto finish;
+		return RLM_MODULE_OK;
 
 	default:
-		rcode = RLM_MODULE_FAIL;
-		goto finish;
+		return RLM_MODULE_FAIL;
 	}
 
-	entry = ldap_first_entry((*pconn)->handle, result);
+	entry = ldap_first_entry(conn->handle, result);
 	if (!entry) {
-		ldap_get_option((*pconn)->handle, LDAP_OPT_RESULT_CODE, &ldap_errno);
+		ldap_get_option(conn->handle, LDAP_OPT_RESULT_CODE, &ldap_errno);
 		REDEBUG("Failed retrieving entry: %s", ldap_err2string(ldap_errno));
 
-		goto finish;
+		return RLM_MODULE_OK;
 	}
 
 	RDEBUG2("Adding cacheable group object memberships");
 	do {
 		if (inst->cacheable_group_dn) {
-			dn = ldap_get_dn((*pconn)->handle, entry);
+			dn = ldap_get_dn(conn->handle, entry);
 			if (!dn) {
-				ldap_get_option((*pconn)->handle, LDAP_OPT_RESULT_CODE, &ldap_errno);
+				ldap_get_option(conn->handle, LDAP_OPT_RESULT_CODE, &ldap_errno);
 				REDEBUG("Retrieving object DN from entry failed: %s", ldap_err2string(ldap_errno));
 
-				goto finish;
+				return RLM_MODULE_OK;
 			}
 			fr_ldap_util_normalise_dn(dn, dn);
 
@@ -509,7 +623,7 @@ rlm_rcode_t rlm_ldap_cacheable_groupobj(rlm_ldap_t const *inst, REQUEST *request
 		if (inst->cacheable_group_name) {
 			struct berval **values;
 
-			values = ldap_get_values_len((*pconn)->handle, entry, inst->groupobj_name_attr);
+			values = ldap_get_values_len(conn->handle, entry, inst->groupobj_name_attr);
 			if (!values) continue;
 
 			MEM(pair_add_control(&vp, inst->cache_da) == 0);
@@ -521,32 +635,56 @@ rlm_rcode_t rlm_ldap_cacheable_groupobj(rlm_ldap_t const *inst, REQUEST *request
 
 			ldap_value_free_len(values);
 		}
-	} while ((entry = ldap_next_entry((*pconn)->handle, entry)));
+	} while ((entry = ldap_next_entry(conn->handle, entry)));
 
-finish:
-	if (result) ldap_msgfree(result);
-
-	return rcode;
+	return RLM_MODULE_OK;
 }
 
-/** Query the LDAP directory to check if a group object includes a user object as a member
+/** Convert group membership information into attributes
  *
  * @param[in] inst rlm_ldap configuration.
  * @param[in] request Current request.
  * @param[in,out] pconn to use. May change as this function calls functions which auto re-connect.
- * @param[in] check vp containing the group value (name or dn).
  * @return One of the RLM_MODULE_* values.
  */
-rlm_rcode_t rlm_ldap_check_groupobj_dynamic(rlm_ldap_t const *inst, REQUEST *request, fr_ldap_connection_t **pconn,
-					    VALUE_PAIR *check)
-
+rlm_rcode_t rlm_ldap_cacheable_groupobj(rlm_ldap_t const *inst, REQUEST *request, fr_ldap_connection_t **pconn)
 {
+	rlm_rcode_t	rcode;
 	fr_ldap_rcode_t	status;
-
+	LDAPMessage	*result = NULL;
 	char const	*base_dn;
-	char		base_dn_buff[LDAP_MAX_DN_STR_LEN + 1];
-	char 		filter[LDAP_MAX_FILTER_STR_LEN + 1];
-	int		ret;
+	char		base_dn_buff[LDAP_MAX_DN_STR_LEN];
+	char		filter[LDAP_MAX_FILTER_STR_LEN + 1];
+	char const	*attrs[] = { inst->groupobj_name_attr, NULL };
+
+	rcode = rlm_ldap_cacheable_groupobj_expand(inst, request, &base_dn, base_dn_buff, filter);
+	if (rcode == RLM_MODULE_NOOP) return RLM_MODULE_OK;
+	if (rcode != RLM_MODULE_OK) return rcode;
+
+	status = fr_ldap_search(&result, request, pconn, base_dn,
+				inst->groupobj_scope, filter, attrs, NULL, NULL);
+	rcode = rlm_ldap_cacheable_groupobj_result(inst, request, *pconn, status, result);
+	if (result) ldap_msgfree(result);
+
+	return rcode;
+}
+
+/** Expand the base DN and filter used to check if a group object includes the user as a member
+ *
+ * @param[in] inst rlm_ldap configuration.
+ * @param[in] request Current request.
+ * @param[in] check vp containing the group value (name or dn).
+ * @param[out] base_dn Where to write a pointer to the base DN.
+ * @param[in] base_dn_buff Buffer to expand the base DN into.  Must be at least #LDAP_MAX_DN_STR_LEN + 1 bytes.
+ * @param[in] filter Buffer to write the filter to.  Must be at least #LDAP_MAX_FILTER_STR_LEN + 1 bytes.
+ * @return
+ *	- #RLM_MODULE_OK if the search should be performed.
+ *	- #RLM_MODULE_INVALID on error.
+ */
+rlm_rcode_t rlm_ldap_check_groupobj_dynamic_expand(rlm_ldap_t const *inst, REQUEST *request, VALUE_PAIR const *check,
+						   char const **base_dn, char base_dn_buff[], char filter[])
+{
+	int ret;
 
 	fr_assert(inst->groupobj_base_dn);
 
@@ -561,7 +699,7 @@ rlm_rcode_t rlm_ldap_check_groupobj_dynamic(rlm_ldap_t const *inst, REQUEST *req
 	default:
 		REDEBUG("Operator \"%s\" not allowed for LDAP group comparisons",
 			fr_table_str_by_value(fr_tokens_table, check->op, "<INVALID>"));
-		return 1;
+		return RLM_MODULE_FAIL;
 	}
 
 	RDEBUG2("Checking for user in group objects");
@@ -572,12 +710,12 @@ rlm_rcode_t rlm_ldap_check_groupobj_dynamic(rlm_ldap_t const *inst, REQUEST *req
 		RINDENT();
 		ret = fr_ldap_xlat_filter(request,
 					   filters, NUM_ELEMENTS(filters),
-					   filter, sizeof(filter));
+					   filter, LDAP_MAX_FILTER_STR_LEN + 1);
 		REXDENT();
 
 		if (ret < 0) return RLM_MODULE_INVALID;
 
-		base_dn = check->vp_strvalue;
+		*base_dn = check->vp_strvalue;
 	} else {
 		char name_filter[LDAP_MAX_FILTER_STR_LEN];
 		char const *filters[] = { name_filter, inst->groupobj_filter, inst->groupobj_membership_filter };
@@ -593,7 +731,7 @@ rlm_rcode_t rlm_ldap_check_groupobj_dynamic(rlm_ldap_t const *inst, REQUEST *req
 		RINDENT();
 		ret = fr_ldap_xlat_filter(request,
 					   filters, NUM_ELEMENTS(filters),
-					   filter, sizeof(filter));
+					   filter, LDAP_MAX_FILTER_STR_LEN + 1);
 		REXDENT();
 		if (ret < 0) return RLM_MODULE_INVALID;
 
@@ -602,7 +740,7 @@ rlm_rcode_t rlm_ldap_check_groupobj_dynamic(rlm_ldap_t const *inst, REQUEST *req
 		 *	rlm_ldap_find_user does this, too.  Oh well.
 		 */
 		RINDENT();
-		ret = tmpl_expand(&base_dn, base_dn_buff, sizeof(base_dn_buff), request, inst->groupobj_base_dn,
+		ret = tmpl_expand(base_dn, base_dn_buff, LDAP_MAX_DN_STR_LEN + 1, request, inst->groupobj_base_dn,
 				  fr_ldap_escape_func, NULL);
 		REXDENT();
 		if (ret < 0) {
@@ -612,13 +750,25 @@ rlm_rcode_t rlm_ldap_check_groupobj_dynamic(rlm_ldap_t const *inst, REQUEST *req
 		}
 	}
 
-	RINDENT();
-	status = fr_ldap_search(NULL, request, pconn, base_dn, inst->groupobj_scope, filter, NULL, NULL, NULL);
-	REXDENT();
+	return RLM_MODULE_OK;
+}
+
+/** Convert the result of a search for group objects including the user to a module rcode
+ *
+ * @param[in] request Current request.
+ * @param[in] base_dn the search was performed in.
+ * @param[in] status of the search.
+ * @return
+ *	- #RLM_MODULE_OK if the user is a member.
+ *	- #RLM_MODULE_NOTFOUND if the user isn't.
+ *	- #RLM_MODULE_FAIL on error.
+ */
+rlm_rcode_t rlm_ldap_check_groupobj_dynamic_result(REQUEST *request, char const *base_dn, fr_ldap_rcode_t status)
+{
 	switch (status) {
 	case LDAP_PROC_SUCCESS:
 		RDEBUG2("User found in group object \"%s\"", base_dn);
-		break;
+		return RLM_MODULE_OK;
 
 	case LDAP_PROC_NO_RESULT:
 		return RLM_MODULE_NOTFOUND;
@@ -626,37 +776,75 @@ rlm_rcode_t rlm_ldap_check_groupobj_dynamic(rlm_ldap_t const *inst, REQUEST *req
 	default:
 		return RLM_MODULE_FAIL;
 	}
-
-	return RLM_MODULE_OK;
 }
 
-/** Query the LDAP directory to check if a user object is a member of a group
+/** Query the LDAP directory to check if a group object includes a user object as a member
  *
  * @param[in] inst rlm_ldap configuration.
  * @param[in] request Current request.
  * @param[in,out] pconn to use. May change as this function calls functions which auto re-connect.
- * @param[in] dn of user object.
  * @param[in] check vp containing the group value (name or dn).
  * @return One of the RLM_MODULE_* values.
  */
-rlm_rcode_t rlm_ldap_check_userobj_dynamic(rlm_ldap_t const *inst, REQUEST *request, fr_ldap_connection_t **pconn,
-					   char const *dn, VALUE_PAIR *check)
+rlm_rcode_t rlm_ldap_check_groupobj_dynamic(rlm_ldap_t const *inst, REQUEST *request, fr_ldap_connection_t **pconn,
+					    VALUE_PAIR *check)
+
 {
-	rlm_rcode_t	rcode = RLM_MODULE_NOTFOUND, ret;
 	fr_ldap_rcode_t	status;
-	bool		name_is_dn = false, value_is_dn = false;
+	rlm_rcode_t	rcode;
 
-	LDAPMessage     *result = NULL;
-	LDAPMessage     *entry = NULL;
-	struct berval	**values = NULL;
+	char const	*base_dn;
+	char		base_dn_buff[LDAP_MAX_DN_STR_LEN + 1];
+	char 		filter[LDAP_MAX_FILTER_STR_LEN + 1];
 
-	char const	*attrs[] = { inst->userobj_membership_attr, NULL };
-	int		i, count, ldap_errno;
+	rcode = rlm_ldap_check_groupobj_dynamic_expand(inst, request, check, &base_dn, base_dn_buff, filter);
+	if (rcode != RLM_MODULE_OK) return rcode;
 
-	RDEBUG2("Checking user object's %s attributes", inst->userobj_membership_attr);
 	RINDENT();
-	status = fr_ldap_search(&result, request, pconn, dn, LDAP_SCOPE_BASE, NULL, attrs, NULL, NULL);
+	status = fr_ldap_search(NULL, request, pconn, base_dn, inst->groupobj_scope, filter, NULL, NULL, NULL);
 	REXDENT();
+
+	return rlm_ldap_check_groupobj_dynamic_result(request, base_dn, status);
+}
+
+static int _userobj_check_free(rlm_ldap_userobj_check_t *uc)
+{
+	if (uc->values) ldap_value_free_len(uc->values);
+
+	return 0;
+}
+
+/** Retrieve the membership values from the result of a search for the user object
+ *
+ * The search should have been for the user's DN, with scope base, retrieving the user
+ * object membership attribute.
+ *
+ * @param[out] out Where to write the state of the comparison.  Pass to
+ *	#rlm_ldap_check_userobj_next to find out if the user is a member of the group.
+ * @param[in] ctx to allocate the state in.
+ * @param[in] inst rlm_ldap configuration.
+ * @param[in] request Current request.
+ * @param[in] conn used to parse the result.
+ * @param[in] status of the search.
+ * @param[in] result of the search.  Not freed.
+ * @param[in] check vp containing the group value (name or dn).
+ * @return
+ *	- #RLM_MODULE_OK if the user object has membership values to check.
+ *	- #RLM_MODULE_NOTFOUND if it doesn't.
+ *	- #RLM_MODULE_FAIL on error.
+ */
+rlm_rcode_t rlm_ldap_check_userobj_dynamic_result(rlm_ldap_userobj_check_t **out, TALLOC_CTX *ctx,
+						  rlm_ldap_t const *inst, REQUEST *request,
+						  fr_ldap_connection_t const *conn,
+						  fr_ldap_rcode_t status, LDAPMessage *result, VALUE_PAIR const *check)
+{
+	rlm_ldap_userobj_check_t	*uc;
+	LDAPMessage			*entry;
+	struct berval			**values;
+	int				ldap_errno;
+
+	*out = NULL;
+
 	switch (status) {
 	case LDAP_PROC_SUCCESS:
 		break;
@@ -664,54 +852,91 @@ rlm_rcode_t rlm_ldap_check_userobj_dynamic(rlm_ldap_t const *inst, REQUEST *requ
 	case LDAP_PROC_NO_RESULT:
 		RDEBUG2("Can't check membership attributes, user object not found");
 
-		rcode = RLM_MODULE_NOTFOUND;
+		return RLM_MODULE_NOTFOUND;
 
-		FALL_THROUGH;
 	default:
-		goto finish;
+		return RLM_MODULE_FAIL;
 	}
 
-	entry = ldap_first_entry((*pconn)->handle, result);
+	entry = ldap_first_entry(conn->handle, result);
 	if (!entry) {
-		ldap_get_option((*pconn)->handle, LDAP_OPT_RESULT_CODE, &ldap_errno);
+		ldap_get_option(conn->handle, LDAP_OPT_RESULT_CODE, &ldap_errno);
 		REDEBUG("Failed retrieving entry: %s", ldap_err2string(ldap_errno));
 
-		rcode = RLM_MODULE_FAIL;
-
-		goto finish;
+		return RLM_MODULE_FAIL;
 	}
 
-	values = ldap_get_values_len((*pconn)->handle, entry, inst->userobj_membership_attr);
+	values = ldap_get_values_len(conn->handle, entry, inst->userobj_membership_attr);
 	if (!values) {
 		RDEBUG2("No group membership attribute(s) found in user object");
 
-		goto finish;
+		return RLM_MODULE_NOTFOUND;
 	}
 
+	MEM(uc = talloc_zero(ctx, rlm_ldap_userobj_check_t));
+	talloc_set_destructor(uc, _userobj_check_free);
+	uc->values = values;
+	uc->check_is_dn = fr_ldap_util_is_dn(check->vp_strvalue, check->vp_length);
+
+	*out = uc;
+
+	return RLM_MODULE_OK;
+}
+
+/** Compare a group name against a membership value, or the group being checked
+ *
+ */
+static bool rlm_ldap_check_userobj_name_eq(char const *name, char const *value, size_t value_len)
+{
+	return ((talloc_array_length(name) - 1) == value_len) && (memcmp(value, name, value_len) == 0);
+}
+
+/** Compare the user's remaining membership values against the group
+ *
+ * Group names are compared case sensitively, and DNs case insensitively.  If a value
+ * and the group aren't of the same type, the DN must be resolved to a group name
+ * before they can be compared.  In that case #RLM_MODULE_YIELD is returned, the caller
+ * should search for uc->resolve (with scope base, retrieving the group name attribute),
+ * and pass the result to #rlm_ldap_check_userobj_resolved.
+ *
+ * @param[in] inst rlm_ldap configuration.
+ * @param[in] request Current request.
+ * @param[in] uc state of the comparison.
+ * @param[in] check vp containing the group value (name or dn).
+ * @return
+ *	- #RLM_MODULE_OK if the user is a member of the group.
+ *	- #RLM_MODULE_NOTFOUND if the user isn't.
+ *	- #RLM_MODULE_YIELD if uc->resolve must be resolved to a name.
+ *	- #RLM_MODULE_INVALID if a DN must be resolved, but no group name attribute is configured.
+ */
+rlm_rcode_t rlm_ldap_check_userobj_next(rlm_ldap_t const *inst, REQUEST *request,
+					rlm_ldap_userobj_check_t *uc, VALUE_PAIR const *check)
+{
+	struct berval	*value;
+	bool		value_is_dn;
+
 	/*
 	 *	Loop over the list of groups the user is a member of,
 	 *	looking for a match.
 	 */
-	name_is_dn = fr_ldap_util_is_dn(check->vp_strvalue, check->vp_length);
-	count = ldap_count_values_len(values);
-	for (i = 0; i < count; i++) {
-		value_is_dn = fr_ldap_util_is_dn(values[i]->bv_val, values[i]->bv_len);
+	while ((value = uc->values[uc->idx])) {
+		value_is_dn = fr_ldap_util_is_dn(value->bv_val, value->bv_len);
 
 		RDEBUG2("Processing %s value \"%pV\" as a %s", inst->userobj_membership_attr,
-			fr_box_strvalue_len(values[i]->bv_val, values[i]->bv_len),
+			fr_box_strvalue_len(value->bv_val, value->bv_len),
 			value_is_dn ? "DN" : "group name");
 
 		/*
 		 *	Both literal group names, do case sensitive comparison
 		 */
-		if (!name_is_dn && !value_is_dn) {
-			if ((check->vp_length == values[i]->bv_len) &&
-			    (memcmp(values[i]->bv_val, check->vp_strvalue, values[i]->bv_len) == 0)) {
+		if (!uc->check_is_dn && !value_is_dn) {
+			uc->idx++;
+
+			if ((check->vp_length == value->bv_len) &&
+			    (memcmp(value->bv_val, check->vp_strvalue, value->bv_len) == 0)) {
 				RDEBUG2("User found in group \"%s\". Comparison between membership: name, check: name",
 				       check->vp_strvalue);
-				rcode = RLM_MODULE_OK;
-
-				goto finish;
+				return RLM_MODULE_OK;
 			}
 
 			continue;
@@ -720,19 +945,19 @@ rlm_rcode_t rlm_ldap_check_userobj_dynamic(rlm_ldap_t const *inst, REQUEST *requ
 		/*
 		 *	Both DNs, do case insensitive, binary safe comparison
 		 */
-		if (name_is_dn && value_is_dn) {
-			if (check->vp_length == values[i]->bv_len) {
-				int j;
+		if (uc->check_is_dn && value_is_dn) {
+			uc->idx++;
+
+			if (check->vp_length == value->bv_len) {
+				size_t i;
 
-				for (j = 0; j < (int)values[i]->bv_len; j++) {
-					if (tolower(values[i]->bv_val[j]) != tolower(check->vp_strvalue[j])) break;
+				for (i = 0; i < value->bv_len; i++) {
+					if (tolower(value->bv_val[i]) != tolower(check->vp_strvalue[i])) break;
 				}
-				if (j == (int)values[i]->bv_len) {
+				if (i == value->bv_len) {
 					RDEBUG2("User found in group DN \"%s\". "
 					       "Comparison between membership: dn, check: dn", check->vp_strvalue);
-					rcode = RLM_MODULE_OK;
-
-					goto finish;
+					return RLM_MODULE_OK;
 				}
 			}
 
@@ -741,33 +966,21 @@ rlm_rcode_t rlm_ldap_check_userobj_dynamic(rlm_ldap_t const *inst, REQUEST *requ
 
 		/*
 		 *	If the value is not a DN, and the name we were given is a dn
-		 *	convert the value to a DN and do a comparison.
+		 *	convert the check DN to a name (once) and do a comparison.
 		 */
-		if (!value_is_dn && name_is_dn) {
-			char *resolved;
-			bool eq = false;
-
-			RINDENT();
-			ret = rlm_ldap_group_dn2name(inst, request, pconn, check->vp_strvalue, &resolved);
-			REXDENT();
-
-			if (ret == RLM_MODULE_NOOP) continue;
-
-			if (ret != RLM_MODULE_OK) {
-				rcode = ret;
-				goto finish;
+		if (!value_is_dn && uc->check_is_dn) {
+			if (!uc->check_name) {
+				if (!inst->groupobj_name_attr) goto missing_name_attr;
+				uc->resolve = talloc_strdup(uc, check->vp_strvalue);
+				return RLM_MODULE_YIELD;
 			}
+			uc->idx++;
 
-			if (((talloc_array_length(resolved) - 1) == values[i]->bv_len) &&
-			    (memcmp(values[i]->bv_val, resolved, values[i]->bv_len) == 0)) eq = true;
-			talloc_free(resolved);
-			if (eq) {
+			if (rlm_ldap_check_userobj_name_eq(uc->check_name, value->bv_val, value->bv_len)) {
 				RDEBUG2("User found in group \"%pV\". Comparison between membership: name, check: name "
 				       "(resolved from DN \"%s\")",
-				       fr_box_strvalue_len(values[i]->bv_val, values[i]->bv_len), check->vp_strvalue);
-				rcode = RLM_MODULE_OK;
-
-				goto finish;
+				       fr_box_strvalue_len(value->bv_val, value->bv_len), check->vp_strvalue);
+				return RLM_MODULE_OK;
 			}
 
 			continue;
@@ -777,43 +990,122 @@ rlm_rcode_t rlm_ldap_check_userobj_dynamic(rlm_ldap_t const *inst, REQUEST *requ
 		 *	We have a value which is a DN, and a check item which specifies the name of a group,
 		 *	convert the value to a name so we can do a comparison.
 		 */
-		if (value_is_dn && !name_is_dn) {
-			char *resolved;
-			char *value;
-			bool eq = false;
+		if (!inst->groupobj_name_attr) goto missing_name_attr;
+		uc->resolve = fr_ldap_berval_to_string(uc, value);
+		return RLM_MODULE_YIELD;
+	}
 
-			value = fr_ldap_berval_to_string(request, values[i]);
-			RINDENT();
-			ret = rlm_ldap_group_dn2name(inst, request, pconn, value, &resolved);
-			REXDENT();
-			talloc_free(value);
+	return RLM_MODULE_NOTFOUND;
 
-			if (ret == RLM_MODULE_NOOP) continue;
+missing_name_attr:
+	REDEBUG("Told to resolve group DN to name but missing 'group.name_attribute' directive");
 
-			if (ret != RLM_MODULE_OK) {
-				rcode = ret;
-				goto finish;
-			}
+	return RLM_MODULE_INVALID;
+}
 
-			if (((talloc_array_length(resolved) - 1) == check->vp_length) &&
-			    (memcmp(check->vp_strvalue, resolved, check->vp_length) == 0)) eq = true;
-			talloc_free(resolved);
-			if (eq) {
-				RDEBUG2("User found in group \"%pV\". Comparison between membership: name "
-				       "(resolved from DN \"%s\"), check: name", &check->data, value);
-				rcode = RLM_MODULE_OK;
+/** Compare the DN which was resolved to a name against the group
+ *
+ * @param[in] inst rlm_ldap configuration.
+ * @param[in] request Current request.
+ * @param[in] uc state of the comparison.
+ * @param[in] check vp containing the group value (name or dn).
+ * @param[in] conn used to parse the result.
+ * @param[in] status of the search for uc->resolve.
+ * @param[in] result of the search for uc->resolve.  Not freed.
+ * @return
+ *	- #RLM_MODULE_OK if the user is a member of the group.
+ *	- #RLM_MODULE_NOTFOUND if the comparison should continue with #rlm_ldap_check_userobj_next.
+ *	- Another RLM_MODULE_* value on error.
+ */
+rlm_rcode_t rlm_ldap_check_userobj_resolved(rlm_ldap_t const *inst, REQUEST *request,
+					    rlm_ldap_userobj_check_t *uc, VALUE_PAIR const *check,
+					    fr_ldap_connection_t const *conn, fr_ldap_rcode_t status, LDAPMessage *result)
+{
+	struct berval	*value = uc->values[uc->idx++];
+	rlm_rcode_t	rcode;
+	char		*resolved;
+	bool		eq;
 
-				goto finish;
-			}
+	fr_assert(uc->resolve);
 
-			continue;
+	RINDENT();
+	rcode = rlm_ldap_group_dn2name_result(inst, request, conn, uc->resolve, status, result, &resolved);
+	REXDENT();
+	TALLOC_FREE(uc->resolve);
+
+	if (rcode == RLM_MODULE_NOOP) return RLM_MODULE_NOTFOUND;	/* Dangling reference, skip the value */
+	if (rcode != RLM_MODULE_OK) return rcode;
+
+	/*
+	 *	The group we're looking for was a DN, we'll
+	 *	compare its name against the remaining values.
+	 */
+	if (uc->check_is_dn) {
+		uc->check_name = talloc_steal(uc, resolved);
+
+		if (rlm_ldap_check_userobj_name_eq(uc->check_name, value->bv_val, value->bv_len)) {
+			RDEBUG2("User found in group \"%pV\". Comparison between membership: name, check: name "
+			       "(resolved from DN \"%s\")",
+			       fr_box_strvalue_len(value->bv_val, value->bv_len), check->vp_strvalue);
+			return RLM_MODULE_OK;
 		}
-		fr_assert(0);
+
+		return RLM_MODULE_NOTFOUND;
 	}
 
-finish:
-	if (values) ldap_value_free_len(values);
+	eq = rlm_ldap_check_userobj_name_eq(resolved, check->vp_strvalue, check->vp_length);
+	talloc_free(resolved);
+	if (eq) {
+		RDEBUG2("User found in group \"%pV\". Comparison between membership: name "
+		       "(resolved from DN \"%pV\"), check: name", &check->data,
+		       fr_box_strvalue_len(value->bv_val, value->bv_len));
+		return RLM_MODULE_OK;
+	}
+
+	return RLM_MODULE_NOTFOUND;
+}
+
+/** Query the LDAP directory to check if a user object is a member of a group
+ *
+ * @param[in] inst rlm_ldap configuration.
+ * @param[in] request Current request.
+ * @param[in,out] pconn to use. May change as this function calls functions which auto re-connect.
+ * @param[in] dn of user object.
+ * @param[in] check vp containing the group value (name or dn).
+ * @return One of the RLM_MODULE_* values.
+ */
+rlm_rcode_t rlm_ldap_check_userobj_dynamic(rlm_ldap_t const *inst, REQUEST *request, fr_ldap_connection_t **pconn,
+					   char const *dn, VALUE_PAIR *check)
+{
+	rlm_ldap_userobj_check_t	*uc;
+	rlm_rcode_t			rcode;
+	fr_ldap_rcode_t			status;
+	LDAPMessage			*result = NULL;
+	char const			*attrs[] = { inst->userobj_membership_attr, NULL };
+
+	RDEBUG2("Checking user object's %s attributes", inst->userobj_membership_attr);
+	RINDENT();
+	status = fr_ldap_search(&result, request, pconn, dn, LDAP_SCOPE_BASE, NULL, attrs, NULL, NULL);
+	REXDENT();
+	rcode = rlm_ldap_check_userobj_dynamic_result(&uc, request, inst, request, *pconn, status, result, check);
 	if (result) ldap_msgfree(result);
+	if (!uc) return rcode;
+
+	while ((rcode = rlm_ldap_check_userobj_next(inst, request, uc, check)) == RLM_MODULE_YIELD) {
+		char const *name_attrs[] = { inst->groupobj_name_attr, NULL };
+
+		RDEBUG2("Resolving group DN \"%s\" to group name", uc->resolve);
+
+		result = NULL;
+		RINDENT();
+		status = fr_ldap_search(&result, request, pconn, uc->resolve, LDAP_SCOPE_BASE,
+					NULL, name_attrs, NULL, NULL);
+		REXDENT();
+		rcode = rlm_ldap_check_userobj_resolved(inst, request, uc, check, *pconn, status, result);
+		if (result) ldap_msgfree(result);
+		if (rcode != RLM_MODULE_NOTFOUND) break;
+	}
+	talloc_free(uc);
 
 	return rcode;
 }
@@ -836,7 +1128,7 @@ rlm_rcode_t rlm_ldap_check_cached(rlm_ldap_t const *inst, REQUEST *request, VALU
 	 *	We return RLM_MODULE_INVALID here as an indication
 	 *	the caller should try a dynamic group lookup instead.
 	 */
-	vp =  fr_cursor_iter_by_da_init(&cursor, &request->control, inst->cache_da);
+	vp =  fr_pair_list_cursor_by_da_init(&cursor, &request->control, inst->cache_da);
 	if (!vp) return RLM_MODULE_INVALID;
 
 	for (vp = fr_cursor_current(&cursor);
@@ -36,6 +36,7 @@ USES_APPLE_DEPRECATED_API
 #include "rlm_ldap.h"
 
 #include <freeradius-devel/server/map_proc.h>
+#include <freeradius-devel/unlang/base.h>
 
 static CONF_PARSER sasl_mech_dynamic[] = {
 	{ FR_CONF_OFFSET("mech", FR_TYPE_TMPL | FR_TYPE_NOT_EMPTY, fr_ldap_sasl_t_dynamic_t, mech) },
@@ -223,6 +224,10 @@ static const CONF_PARSER module_config[] = {
 	{ FR_CONF_POINTER("global", FR_TYPE_SUBSECTION, NULL), .subcs = (void const *) global_config },
 
 	{ FR_CONF_OFFSET("tls", FR_TYPE_SUBSECTION, rlm_ldap_t, handle_config), .subcs = (void const *) tls_config },
+
+	{ FR_CONF_OFFSET("trunk", FR_TYPE_SUBSECTION, rlm_ldap_t, trunk_conf), .subcs = (void const *) fr_trunk_config },
+
+	{ FR_CONF_OFFSET("bind_trunk", FR_TYPE_SUBSECTION, rlm_ldap_t, bind_trunk_conf), .subcs = (void const *) fr_trunk_config },
 	CONF_PARSER_TERMINATOR
 };
 
@@ -576,40 +581,21 @@ free_urldesc:
 	return rcode;
 }
 
-/** Perform LDAP-Group comparison checking
- *
- * Attempts to match users to groups using a variety of methods.
+/** Normalise the group DN, and check the user's cached group memberships
  *
- * @param instance of the rlm_ldap module.
- * @param request Current request.
- * @param thing Unknown.
- * @param check Which group to check for user membership.
- * @param check_pairs Unknown.
- * @param reply_pairs Unknown.
+ * @param[in] inst rlm_ldap configuration.
+ * @param[in] request Current request.
+ * @param[in] check Which group to check for user membership.  If the value is a DN
+ *	it's normalised in place.
  * @return
- *	- 1 on failure (or if the user is not a member).
- *	- 0 on success.
+ *	- #RLM_MODULE_OK if the user is a member of the group.
+ *	- #RLM_MODULE_NOTFOUND if the user isn't.
+ *	- #RLM_MODULE_INVALID if membership couldn't be determined from the cached
+ *	  memberships, and a dynamic search should be performed instead.
  */
-static int rlm_ldap_groupcmp(void *instance, REQUEST *request, UNUSED VALUE_PAIR *thing, VALUE_PAIR *check,
-			     UNUSED VALUE_PAIR *check_pairs, UNUSED VALUE_PAIR **reply_pairs)
+static rlm_rcode_t rlm_ldap_groupcmp_cached(rlm_ldap_t const *inst, REQUEST *request, VALUE_PAIR *check)
 {
-	rlm_ldap_t const	*inst = talloc_get_type_abort_const(instance, rlm_ldap_t);
-	rlm_rcode_t		rcode;
-
-	bool			found = false;
-	bool			check_is_dn;
-
-	fr_ldap_connection_t		*conn = NULL;
-	char const		*user_dn;
-
-	fr_assert(inst->groupobj_base_dn);
-
-	RDEBUG2("Searching for user in group \"%pV\"", &check->data);
-
-	if (check->vp_length == 0) {
-		REDEBUG("Cannot do comparison (group name is empty)");
-		return 1;
-	}
+	bool check_is_dn;
 
 	/*
 	 *	Check if we can do cached membership verification
@@ -635,12 +621,10 @@ static int rlm_ldap_groupcmp(void *instance, REQUEST *request, UNUSED VALUE_PAIR
 	if ((check_is_dn && inst->cacheable_group_dn) || (!check_is_dn && inst->cacheable_group_name)) {
 		switch (rlm_ldap_check_cached(inst, request, check)) {
 		case RLM_MODULE_NOTFOUND:
-			found = false;
-			goto finish;
+			return RLM_MODULE_NOTFOUND;
 
 		case RLM_MODULE_OK:
-			found = true;
-			goto finish;
+			return RLM_MODULE_OK;
 		/*
 		 *	Fallback to dynamic search on failure
 		 */
@@ -651,17 +635,35 @@ static int rlm_ldap_groupcmp(void *instance, REQUEST *request, UNUSED VALUE_PAIR
 		}
 	}
 
+	return RLM_MODULE_INVALID;
+}
+
+/** Check group membership using a connection from the pool
+ *
+ * Only used if the module doesn't have a trunk, i.e. when session tracking is enabled.
+ *
+ * @param[in] inst rlm_ldap configuration.
+ * @param[in] request Current request.
+ * @param[in] check Which group to check for user membership.
+ * @return
+ *	- #RLM_MODULE_OK if the user is a member of the group.
+ *	- #RLM_MODULE_NOTFOUND if the user isn't.
+ *	- Another RLM_MODULE_* value on error.
+ */
+static rlm_rcode_t rlm_ldap_groupcmp_dynamic(rlm_ldap_t const *inst, REQUEST *request, VALUE_PAIR *check)
+{
+	rlm_rcode_t		rcode;
+	fr_ldap_connection_t	*conn;
+	char const		*user_dn;
+
 	conn = mod_conn_get(inst, request);
-	if (!conn) return 1;
+	if (!conn) return RLM_MODULE_FAIL;
 
 	/*
 	 *	This is used in the default membership filter.
 	 */
 	user_dn = rlm_ldap_find_user(inst, request, &conn, NULL, false, NULL, &rcode);
-	if (!user_dn) {
-		ldap_mod_conn_release(inst, request, conn);
-		return 1;
-	}
+	if (!user_dn) goto finish;
 
 	fr_assert(conn);
 
@@ -669,17 +671,8 @@ static int rlm_ldap_groupcmp(void *instance, REQUEST *request, UNUSED VALUE_PAIR
 	 *	Check groupobj user membership
 	 */
 	if (inst->groupobj_membership_filter) {
-		switch (rlm_ldap_check_groupobj_dynamic(inst, request, &conn, check)) {
-		case RLM_MODULE_NOTFOUND:
-			break;
-
-		case RLM_MODULE_OK:
-			found = true;
-			FALL_THROUGH;
-
-		default:
-			goto finish;
-		}
+		rcode = rlm_ldap_check_groupobj_dynamic(inst, request, &conn, check);
+		if (rcode != RLM_MODULE_NOTFOUND) goto finish;
 	}
 
 	fr_assert(conn);
@@ -688,25 +681,57 @@ static int rlm_ldap_groupcmp(void *instance, REQUEST *request, UNUSED VALUE_PAIR
 	 *	Check userobj group membership
 	 */
 	if (inst->userobj_membership_attr) {
-		switch (rlm_ldap_check_userobj_dynamic(inst, request, &conn, user_dn, check)) {
-		case RLM_MODULE_NOTFOUND:
-			break;
-
-		case RLM_MODULE_OK:
-			found = true;
-			FALL_THROUGH;
-
-		default:
-			goto finish;
-		}
+		rcode = rlm_ldap_check_userobj_dynamic(inst, request, &conn, user_dn, check);
+		if (rcode != RLM_MODULE_NOTFOUND) goto finish;
 	}
 
 	fr_assert(conn);
 
+	rcode = RLM_MODULE_NOTFOUND;
+
 finish:
 	if (conn) ldap_mod_conn_release(inst, request, conn);
 
-	if (!found) {
+	return rcode;
+}
+
+/** Perform LDAP-Group comparison checking
+ *
+ * Attempts to match users to groups using a variety of methods.
+ *
+ * Comparisons can't yield, so memberships which aren't cached are always checked
+ * with a connection from the pool, even if the module has a trunk.  The
+ * %{<inst>_group:} xlat checks them via the trunk without blocking.
+ *
+ * @param instance of the rlm_ldap module.
+ * @param request Current request.
+ * @param thing Unknown.
+ * @param check Which group to check for user membership.
+ * @param check_pairs Unknown.
+ * @param reply_pairs Unknown.
+ * @return
+ *	- 1 on failure (or if the user is not a member).
+ *	- 0 on success.
+ */
+static int rlm_ldap_groupcmp(void *instance, REQUEST *request, UNUSED VALUE_PAIR *thing, VALUE_PAIR *check,
+			     UNUSED VALUE_PAIR *check_pairs, UNUSED fr_pair_list_t *reply_pairs)
+{
+	rlm_ldap_t const	*inst = talloc_get_type_abort_const(instance, rlm_ldap_t);
+	rlm_rcode_t		rcode;
+
+	fr_assert(inst->groupobj_base_dn);
+
+	RDEBUG2("Searching for user in group \"%pV\"", &check->data);
+
+	if (check->vp_length == 0) {
+		REDEBUG("Cannot do comparison (group name is empty)");
+		return 1;
+	}
+
+	rcode = rlm_ldap_groupcmp_cached(inst, request, check);
+	if (rcode == RLM_MODULE_INVALID) rcode = rlm_ldap_groupcmp_dynamic(inst, request, check);
+
+	if (rcode != RLM_MODULE_OK) {
 		RDEBUG2("User is not a member of \"%pV\"", &check->data);
 
 		return 1;
@@ -715,217 +740,1512 @@ finish:
 	return 0;
 }
 
-static rlm_rcode_t CC_HINT(nonnull) mod_authenticate(module_ctx_t const *mctx, REQUEST *request)
+/** Convert the result of a bind operation to a module rcode
+ *
+ */
+static rlm_rcode_t rlm_ldap_bind_rcode(fr_ldap_rcode_t status)
 {
-	rlm_ldap_t const 	*inst = talloc_get_type_abort_const(mctx->instance, rlm_ldap_t);
-	rlm_rcode_t		rcode;
-	fr_ldap_rcode_t		status;
-	char const		*dn;
-	fr_ldap_connection_t	*conn;
+	switch (status) {
+	case LDAP_PROC_SUCCESS:
+		return RLM_MODULE_OK;
 
-	char			sasl_mech_buff[LDAP_MAX_DN_STR_LEN];
-	char			sasl_proxy_buff[LDAP_MAX_DN_STR_LEN];
-	char			sasl_realm_buff[LDAP_MAX_DN_STR_LEN];
-	fr_ldap_sasl_t		sasl;
-	VALUE_PAIR *username, *password;
+	case LDAP_PROC_NOT_PERMITTED:
+		return RLM_MODULE_DISALLOW;
 
-	username = fr_pair_find_by_da(request->packet->vps, attr_user_name, TAG_ANY);
-	password = fr_pair_find_by_da(request->packet->vps, attr_user_password, TAG_ANY);
+	case LDAP_PROC_REJECT:
+		return RLM_MODULE_REJECT;
 
-	/*
-	 *	We can only authenticate user requests which HAVE
-	 *	a User-Name attribute.
-	 */
-	if (!username) {
-		REDEBUG("Attribute \"User-Name\" is required for authentication");
+	case LDAP_PROC_BAD_DN:
 		return RLM_MODULE_INVALID;
-	}
 
-	if (!password) {
-		RWDEBUG("You have set \"Auth-Type := LDAP\" somewhere");
-		RWDEBUG("without checking if User-Password is present");
-		RWDEBUG("*********************************************");
-		RWDEBUG("* THAT CONFIGURATION IS WRONG.  DELETE IT.   ");
-		RWDEBUG("* YOU ARE PREVENTING THE SERVER FROM WORKING");
-		RWDEBUG("*********************************************");
+	case LDAP_PROC_NO_RESULT:
+		return RLM_MODULE_NOTFOUND;
 
-		REDEBUG("Attribute \"User-Password\" is required for authentication");
-		return RLM_MODULE_INVALID;
+	default:
+		return RLM_MODULE_FAIL;
 	}
+}
+
+/** Where the result of a query sent via one of the trunks is written
+ *
+ * Embedded in the resume ctx of the module method which sent the query.
+ */
+typedef struct {
+	fr_ldap_query_t		*query;			//!< Query in flight.  NULL once the query has
+							///< completed, failed, or been cancelled.
+	fr_ldap_rcode_t		ret;			//!< Result of the query.
+	fr_ldap_result_t	*result;		//!< Entries returned by a search, or the response
+							///< to an extended operation.  Parented by the request.
+} ldap_query_ctx_t;
+
+/** Copy the result of a query out of the trunk request, and mark the request as runnable
+ *
+ */
+static void ldap_trunk_request_complete(REQUEST *request, void *preq, void *rctx, UNUSED void *uctx)
+{
+	fr_ldap_query_t		*query = talloc_get_type_abort(preq, fr_ldap_query_t);
+	ldap_query_ctx_t	*q = rctx;
+
+	talloc_free(q->result);			/* Result of the previous query, if there was one */
+
+	q->ret = query->ret;
+	q->result = talloc_steal(request, query->result);	/* Take ownership, the query is freed after we return */
+	query->result = NULL;
+	q->query = NULL;
+
+	unlang_interpret_resumable(request);
+}
+
+/** Record that a query could not be sent, and mark the request as runnable
+ *
+ */
+static void ldap_trunk_request_fail(REQUEST *request, UNUSED void *preq, void *rctx,
+				    UNUSED fr_trunk_request_state_t state, UNUSED void *uctx)
+{
+	ldap_query_ctx_t	*q = rctx;
+
+	TALLOC_FREE(q->result);
+
+	q->ret = LDAP_PROC_ERROR;
+	q->query = NULL;
+
+	unlang_interpret_resumable(request);
+}
+
+/** Give up waiting for the result of a query
+ *
+ */
+static void ldap_query_timeout(UNUSED module_ctx_t const *mctx, REQUEST *request, void *rctx,
+			       UNUSED fr_time_t fired)
+{
+	ldap_query_ctx_t	*q = rctx;
+
+	REDEBUG("Timeout waiting for LDAP result");
 
 	/*
-	 *	Make sure the supplied password isn't empty
+	 *	Abandons the operation if it's already been sent.
 	 */
-	if (password->vp_length == 0) {
-		REDEBUG("User-Password must not be empty");
-		return RLM_MODULE_INVALID;
+	if (q->query) fr_trunk_request_signal_cancel(q->query->treq);
+	q->query = NULL;
+	q->ret = LDAP_PROC_TIMEOUT;
+
+	unlang_interpret_resumable(request);
+}
+
+/** Stop waiting for a query, because the request is being cancelled
+ *
+ */
+static void ldap_query_cancel(REQUEST *request, ldap_query_ctx_t *q)
+{
+	(void) unlang_module_timeout_delete(request, q);
+
+	if (q->query) fr_trunk_request_signal_cancel(q->query->treq);
+	q->query = NULL;
+}
+
+/** Yield until the query completes, fails, or times out
+ *
+ * If yielding fails the query is cancelled, and the caller must free rctx.
+ */
+static rlm_rcode_t ldap_query_yield(rlm_ldap_t const *inst, REQUEST *request, ldap_query_ctx_t *q,
+				    fr_unlang_module_resume_t resume, fr_unlang_module_signal_t signal, void *rctx)
+{
+	if (inst->handle_config.res_timeout &&
+	    (unlang_module_timeout_add(request, ldap_query_timeout, q,
+				       fr_time() + inst->handle_config.res_timeout) < 0)) {
+		RPEDEBUG("Failed adding query timeout");
+		ldap_query_cancel(request, q);
+		return RLM_MODULE_FAIL;
+	}
+
+	return unlang_module_yield(request, resume, signal, rctx);
+}
+
+/** Return the connection the result of the last query was received on
+ *
+ * The connection may have been closed between the result being received and
+ * the request being resumed.  The result can't be parsed without the connection's
+ * handle, so in that case the query is treated as having failed.
+ *
+ * @return
+ *	- The connection which received the result.
+ *	- NULL if the query didn't succeed, or the connection has been closed.
+ */
+static fr_ldap_connection_t *ldap_query_result_conn(REQUEST *request, ldap_query_ctx_t *q)
+{
+	if ((q->ret != LDAP_PROC_SUCCESS) || !q->result) return NULL;
+
+	if (!q->result->c) {
+		REDEBUG("Connection closed before the result could be processed");
+		q->ret = LDAP_PROC_ERROR;
+		return NULL;
+	}
+
+	return q->result->c;
+}
+
+/** Wrapper around the module thread struct for the group xlat
+ *
+ */
+typedef struct {
+	rlm_ldap_t const	*inst;			//!< Instance of ldap module.
+	rlm_ldap_thread_t	*t;			//!< ldap module thread instance.
+} ldap_group_xlat_thread_inst_t;
+
+typedef enum {
+	LDAP_GROUP_FIND = 0,				//!< Searching for the user object.
+	LDAP_GROUP_GROUPOBJ,				//!< Searching for group objects including the user.
+	LDAP_GROUP_USEROBJ,				//!< Retrieving the user object's memberships.
+	LDAP_GROUP_RESOLVE				//!< Resolving a group DN to a name.
+} ldap_group_state_t;
+
+/** State of an asynchronous group membership check
+ *
+ */
+typedef struct {
+	ldap_query_ctx_t	q;			//!< Query currently in flight.
+	ldap_group_state_t	state;			//!< What we're waiting for.
+	VALUE_PAIR		*check;			//!< Group to check for user membership.
+	char const		*user_dn;		//!< DN of the user object.
+	char const		*base_dn;		//!< Of the group object search.
+	char const		*attrs[2];		//!< Attributes to retrieve.
+	rlm_ldap_userobj_check_t *uc;			//!< State of the user object membership comparison.
+} ldap_group_xlat_rctx_t;
+
+static int _ldap_group_xlat_rctx_free(ldap_group_xlat_rctx_t *rctx)
+{
+	talloc_free(rctx->q.result);
+
+	return 0;
+}
+
+static xlat_action_t ldap_group_xlat_resume(TALLOC_CTX *ctx, fr_cursor_t *out,
+					    REQUEST *request, void const *xlat_inst, void *xlat_thread_inst,
+					    fr_value_box_t **in, void *rctx);
+
+/** Give up waiting for the result of a query made by the group xlat
+ *
+ */
+static void ldap_group_xlat_timeout(REQUEST *request, UNUSED void *xlat_inst, UNUSED void *xlat_thread_inst,
+				    void *rctx, UNUSED fr_time_t fired)
+{
+	ldap_group_xlat_rctx_t	*our_rctx = talloc_get_type_abort(rctx, ldap_group_xlat_rctx_t);
+
+	REDEBUG("Timeout waiting for LDAP result");
+
+	if (our_rctx->q.query) fr_trunk_request_signal_cancel(our_rctx->q.query->treq);
+	our_rctx->q.query = NULL;
+	our_rctx->q.ret = LDAP_PROC_TIMEOUT;
+
+	unlang_interpret_resumable(request);
+}
+
+static void ldap_group_xlat_signal(UNUSED REQUEST *request, UNUSED void *xlat_inst, UNUSED void *xlat_thread_inst,
+				   void *rctx, fr_state_signal_t action)
+{
+	ldap_group_xlat_rctx_t	*our_rctx = talloc_get_type_abort(rctx, ldap_group_xlat_rctx_t);
+
+	if (action != FR_SIGNAL_CANCEL) return;
+
+	if (our_rctx->q.query) fr_trunk_request_signal_cancel(our_rctx->q.query->treq);
+	talloc_free(our_rctx);
+}
+
+/** Enqueue a search for the group xlat
+ *
+ */
+static xlat_action_t ldap_group_xlat_search(rlm_ldap_t const *inst, rlm_ldap_thread_t *t, REQUEST *request,
+					    ldap_group_xlat_rctx_t *our_rctx, char const *dn, int scope,
+					    char const *filter, char const * const *attrs)
+{
+	TALLOC_FREE(our_rctx->q.result);
+
+	if (fr_ldap_trunk_search(&our_rctx->q.query, t->trunk, request, &our_rctx->q, dn, scope,
+				 filter, attrs, NULL, NULL) < 0) return XLAT_ACTION_FAIL;
+
+	if (inst->handle_config.res_timeout &&
+	    (unlang_xlat_event_timeout_add(request, ldap_group_xlat_timeout, our_rctx,
+					   fr_time() + inst->handle_config.res_timeout) < 0)) {
+		RPEDEBUG("Failed adding query timeout");
+		fr_trunk_request_signal_cancel(our_rctx->q.query->treq);
+		our_rctx->q.query = NULL;
+		return XLAT_ACTION_FAIL;
 	}
 
-	/*
-	 *	Log the password
-	 */
-	if (RDEBUG_ENABLED3) {
-		RDEBUG("Login attempt with password \"%pV\"", &password->data);
-	} else {
-		RDEBUG2("Login attempt with password");
-	}
+	return unlang_xlat_yield(request, ldap_group_xlat_resume, ldap_group_xlat_signal, our_rctx);
+}
+
+/** Write the result of the group membership check
+ *
+ */
+static xlat_action_t ldap_group_xlat_done(TALLOC_CTX *ctx, fr_cursor_t *out, bool member)
+{
+	fr_value_box_t	*vb;
+
+	MEM(vb = fr_value_box_alloc(ctx, FR_TYPE_BOOL, NULL, false));
+	vb->vb_bool = member;
+	fr_cursor_insert(out, vb);
+
+	return XLAT_ACTION_DONE;
+}
+
+/** Enqueue the next search needed to determine group membership
+ *
+ * Follows the same logic as #rlm_ldap_groupcmp_dynamic.
+ */
+static xlat_action_t ldap_group_xlat_next(TALLOC_CTX *ctx, fr_cursor_t *out,
+					  rlm_ldap_t const *inst, rlm_ldap_thread_t *t, REQUEST *request,
+					  ldap_group_xlat_rctx_t *our_rctx)
+{
+	rlm_rcode_t	rcode;
+
+	switch (our_rctx->state) {
+	case LDAP_GROUP_FIND:
+		/*
+		 *	Check groupobj user membership
+		 */
+		if (inst->groupobj_membership_filter) {
+			char	base_dn_buff[LDAP_MAX_DN_STR_LEN + 1];
+			char	filter[LDAP_MAX_FILTER_STR_LEN + 1];
+
+			rcode = rlm_ldap_check_groupobj_dynamic_expand(inst, request, our_rctx->check,
+								       &our_rctx->base_dn, base_dn_buff, filter);
+			if (rcode != RLM_MODULE_OK) return XLAT_ACTION_FAIL;
+			MEM(our_rctx->base_dn = talloc_strdup(our_rctx, our_rctx->base_dn));
+
+			our_rctx->state = LDAP_GROUP_GROUPOBJ;
+			return ldap_group_xlat_search(inst, t, request, our_rctx, our_rctx->base_dn,
+						      inst->groupobj_scope, filter, NULL);
+		}
+		FALL_THROUGH;
+
+	case LDAP_GROUP_GROUPOBJ:
+		/*
+		 *	Check userobj group membership
+		 */
+		if (inst->userobj_membership_attr) {
+			RDEBUG2("Checking user object's %s attributes", inst->userobj_membership_attr);
+
+			our_rctx->state = LDAP_GROUP_USEROBJ;
+			our_rctx->attrs[0] = inst->userobj_membership_attr;
+			return ldap_group_xlat_search(inst, t, request, our_rctx, our_rctx->user_dn,
+						      LDAP_SCOPE_BASE, NULL, our_rctx->attrs);
+		}
+		break;
+
+	case LDAP_GROUP_USEROBJ:
+	case LDAP_GROUP_RESOLVE:
+		switch (rlm_ldap_check_userobj_next(inst, request, our_rctx->uc, our_rctx->check)) {
+		case RLM_MODULE_OK:
+			return ldap_group_xlat_done(ctx, out, true);
+
+		case RLM_MODULE_NOTFOUND:
+			break;
+
+		case RLM_MODULE_YIELD:
+			RDEBUG2("Resolving group DN \"%s\" to group name", our_rctx->uc->resolve);
+
+			our_rctx->state = LDAP_GROUP_RESOLVE;
+			our_rctx->attrs[0] = inst->groupobj_name_attr;
+			return ldap_group_xlat_search(inst, t, request, our_rctx, our_rctx->uc->resolve,
+						      LDAP_SCOPE_BASE, NULL, our_rctx->attrs);
+
+		default:
+			return XLAT_ACTION_FAIL;
+		}
+		break;
+	}
+
+	RDEBUG2("User is not a member of \"%pV\"", &our_rctx->check->data);
+
+	return ldap_group_xlat_done(ctx, out, false);
+}
+
+/** Process the result of the last search, and enqueue the next one
+ *
+ */
+static xlat_action_t ldap_group_xlat_resume(TALLOC_CTX *ctx, fr_cursor_t *out,
+					    REQUEST *request, UNUSED void const *xlat_inst, void *xlat_thread_inst,
+					    UNUSED fr_value_box_t **in, void *rctx)
+{
+	ldap_group_xlat_thread_inst_t	*xt = talloc_get_type_abort(xlat_thread_inst, ldap_group_xlat_thread_inst_t);
+	rlm_ldap_t const		*inst = xt->inst;
+	ldap_group_xlat_rctx_t		*our_rctx = talloc_get_type_abort(rctx, ldap_group_xlat_rctx_t);
+	fr_ldap_connection_t		*conn;
+	LDAPMessage			*result;
+	rlm_rcode_t			rcode;
+	xlat_action_t			xa;
+
+	conn = ldap_query_result_conn(request, &our_rctx->q);
+	result = our_rctx->q.result ? our_rctx->q.result->msg : NULL;
+
+	switch (our_rctx->state) {
+	case LDAP_GROUP_FIND:
+		switch (our_rctx->q.ret) {
+		case LDAP_PROC_SUCCESS:
+			break;
+
+		case LDAP_PROC_BAD_DN:
+		case LDAP_PROC_NO_RESULT:
+			RDEBUG2("User object not found");
+			xa = ldap_group_xlat_done(ctx, out, false);
+			goto finish;
+
+		default:
+			xa = XLAT_ACTION_FAIL;
+			goto finish;
+		}
+
+		our_rctx->user_dn = rlm_ldap_find_user_result(inst, request, conn, result, &rcode);
+		if (!our_rctx->user_dn) {
+			xa = XLAT_ACTION_FAIL;
+			goto finish;
+		}
+		MEM(our_rctx->user_dn = talloc_strdup(our_rctx, our_rctx->user_dn));
+		break;
+
+	case LDAP_GROUP_GROUPOBJ:
+		switch (rlm_ldap_check_groupobj_dynamic_result(request, our_rctx->base_dn, our_rctx->q.ret)) {
+		case RLM_MODULE_OK:
+			xa = ldap_group_xlat_done(ctx, out, true);
+			goto finish;
+
+		case RLM_MODULE_NOTFOUND:
+			break;
+
+		default:
+			xa = XLAT_ACTION_FAIL;
+			goto finish;
+		}
+		break;
+
+	case LDAP_GROUP_USEROBJ:
+		rcode = rlm_ldap_check_userobj_dynamic_result(&our_rctx->uc, our_rctx, inst, request, conn,
+							      our_rctx->q.ret, result, our_rctx->check);
+		if (!our_rctx->uc) {
+			if (rcode != RLM_MODULE_NOTFOUND) {
+				xa = XLAT_ACTION_FAIL;
+				goto finish;
+			}
+
+			RDEBUG2("User is not a member of \"%pV\"", &our_rctx->check->data);
+			xa = ldap_group_xlat_done(ctx, out, false);
+			goto finish;
+		}
+		break;
+
+	case LDAP_GROUP_RESOLVE:
+		switch (rlm_ldap_check_userobj_resolved(inst, request, our_rctx->uc, our_rctx->check,
+							conn, our_rctx->q.ret, result)) {
+		case RLM_MODULE_OK:
+			xa = ldap_group_xlat_done(ctx, out, true);
+			goto finish;
+
+		case RLM_MODULE_NOTFOUND:
+			break;
+
+		default:
+			xa = XLAT_ACTION_FAIL;
+			goto finish;
+		}
+		break;
+	}
+
+	xa = ldap_group_xlat_next(ctx, out, inst, xt->t, request, our_rctx);
+	if (xa == XLAT_ACTION_YIELD) return xa;
+
+finish:
+	talloc_free(our_rctx);
+
+	return xa;
+}
+
+/** Check if the user is a member of a group
+ *
+ * Cached group memberships are checked first, then the directory is searched
+ * via the module's trunk.
+ *
+ * Example:
+@verbatim
+%{ldap_group:<group name or DN>}
+@endverbatim
+ *
+ * @ingroup xlat_functions
+ */
+static xlat_action_t ldap_group_xlat(TALLOC_CTX *ctx, fr_cursor_t *out,
+				     REQUEST *request, UNUSED void const *xlat_inst, void *xlat_thread_inst,
+				     fr_value_box_t **in)
+{
+	ldap_group_xlat_thread_inst_t	*xt = talloc_get_type_abort(xlat_thread_inst, ldap_group_xlat_thread_inst_t);
+	rlm_ldap_t const		*inst = xt->inst;
+	rlm_ldap_thread_t		*t = xt->t;
+	ldap_group_xlat_rctx_t		*our_rctx;
+	VALUE_PAIR			*vp;
+	rlm_rcode_t			rcode;
+	xlat_action_t			xa;
+
+	fr_assert(inst->groupobj_base_dn);
+
+	if (!*in) {
+		REDEBUG("Cannot do comparison (group name is empty)");
+		return XLAT_ACTION_FAIL;
+	}
+
+	if (fr_value_box_list_concat(ctx, *in, in, FR_TYPE_STRING, true) < 0) {
+		REDEBUG("Failed concatenating arguments into group name");
+		return XLAT_ACTION_FAIL;
+	}
+
+	if ((*in)->vb_length == 0) {
+		REDEBUG("Cannot do comparison (group name is empty)");
+		return XLAT_ACTION_FAIL;
+	}
+
+	MEM(our_rctx = talloc_zero(request, ldap_group_xlat_rctx_t));
+	talloc_set_destructor(our_rctx, _ldap_group_xlat_rctx_free);
+
+	MEM(our_rctx->check = fr_pair_afrom_da(our_rctx, inst->group_da));
+	our_rctx->check->op = T_OP_CMP_EQ;
+	fr_pair_value_bstrndup(our_rctx->check, (*in)->vb_strvalue, (*in)->vb_length, (*in)->tainted);
+
+	RDEBUG2("Searching for user in group \"%pV\"", &our_rctx->check->data);
+
+	rcode = rlm_ldap_groupcmp_cached(inst, request, our_rctx->check);
+	if (rcode == RLM_MODULE_INVALID) {
+		/*
+		 *	No trunk, so we have to block.
+		 */
+		if (!t->trunk) {
+			rcode = rlm_ldap_groupcmp_dynamic(inst, request, our_rctx->check);
+			if (rcode == RLM_MODULE_NOTFOUND) RDEBUG2("User is not a member of \"%pV\"",
+								  &our_rctx->check->data);
+
+		} else {
+			/*
+			 *	We may already have the DN from a previous call to authorize
+			 */
+			vp = fr_pair_list_find_by_da(&request->control, attr_ldap_userdn, TAG_ANY);
+			if (vp) {
+				MEM(our_rctx->user_dn = talloc_strdup(our_rctx, vp->vp_strvalue));
+
+				xa = ldap_group_xlat_next(ctx, out, inst, t, request, our_rctx);
+			} else {
+				static char const	*attrs[] = { LDAP_NO_ATTRS, NULL };
+				char const		*base_dn, *filter;
+				char			base_dn_buff[LDAP_MAX_DN_STR_LEN];
+				char			filter_buff[LDAP_MAX_FILTER_STR_LEN];
+
+				if (rlm_ldap_find_user_expand(inst, request, &base_dn, base_dn_buff,
+							      &filter, filter_buff) != RLM_MODULE_OK) {
+					xa = XLAT_ACTION_FAIL;
+					goto finish;
+				}
+
+				our_rctx->state = LDAP_GROUP_FIND;
+				xa = ldap_group_xlat_search(inst, t, request, our_rctx, base_dn,
+							    inst->userobj_scope, filter, attrs);
+			}
+			if (xa == XLAT_ACTION_YIELD) return xa;
+			goto finish;
+		}
+	}
+
+	switch (rcode) {
+	case RLM_MODULE_OK:
+		xa = ldap_group_xlat_done(ctx, out, true);
+		break;
+
+	case RLM_MODULE_NOTFOUND:
+		xa = ldap_group_xlat_done(ctx, out, false);
+		break;
+
+	default:
+		xa = XLAT_ACTION_FAIL;
+		break;
+	}
+
+finish:
+	talloc_free(our_rctx);
+
+	return xa;
+}
+
+typedef enum {
+	LDAP_AUTH_FIND = 0,				//!< Searching for the user object.
+	LDAP_AUTH_BIND					//!< Binding as the user.
+} ldap_auth_state_t;
+
+/** State of an asynchronous authentication
+ *
+ */
+typedef struct {
+	ldap_query_ctx_t	q;			//!< Query currently in flight.
+	ldap_auth_state_t	state;			//!< What we're waiting for.
+	char const		*dn;			//!< Of the user object.
+	char const		*password;		//!< User supplied password.
+} ldap_auth_ctx_t;
+
+static int _ldap_auth_ctx_free(ldap_auth_ctx_t *auth)
+{
+	talloc_free(auth->q.result);
+
+	return 0;
+}
+
+/** Enqueue a bind as the user on the bind trunk
+ *
+ */
+static rlm_rcode_t ldap_auth_bind(rlm_ldap_thread_t *t, REQUEST *request, ldap_auth_ctx_t *auth)
+{
+	auth->state = LDAP_AUTH_BIND;
+
+	if (fr_ldap_trunk_bind(&auth->q.query, t->bind_trunk, request, &auth->q,
+			       auth->dn, auth->password, NULL, NULL) < 0) return RLM_MODULE_FAIL;
+
+	return RLM_MODULE_YIELD;
+}
+
+static void mod_authenticate_signal(UNUSED module_ctx_t const *mctx, REQUEST *request,
+				    void *rctx, fr_state_signal_t action)
+{
+	ldap_auth_ctx_t		*auth = talloc_get_type_abort(rctx, ldap_auth_ctx_t);
+
+	if (action != FR_SIGNAL_CANCEL) return;
+
+	ldap_query_cancel(request, &auth->q);
+	talloc_free(auth);
+}
+
+static rlm_rcode_t mod_authenticate_resume(module_ctx_t const *mctx, REQUEST *request, void *rctx)
+{
+	rlm_ldap_t const	*inst = talloc_get_type_abort_const(mctx->instance, rlm_ldap_t);
+	rlm_ldap_thread_t	*t = talloc_get_type_abort(mctx->thread, rlm_ldap_thread_t);
+	ldap_auth_ctx_t		*auth = talloc_get_type_abort(rctx, ldap_auth_ctx_t);
+	fr_ldap_connection_t	*conn;
+	rlm_rcode_t		rcode;
+
+	(void) unlang_module_timeout_delete(request, &auth->q);
+
+	conn = ldap_query_result_conn(request, &auth->q);
+
+	switch (auth->state) {
+	case LDAP_AUTH_FIND:
+		switch (auth->q.ret) {
+		case LDAP_PROC_SUCCESS:
+			break;
+
+		case LDAP_PROC_BAD_DN:
+		case LDAP_PROC_NO_RESULT:
+			RDEBUG2("User object not found");
+			rcode = RLM_MODULE_NOTFOUND;
+			goto finish;
+
+		default:
+			rcode = RLM_MODULE_FAIL;
+			goto finish;
+		}
+
+		auth->dn = rlm_ldap_find_user_result(inst, request, conn, auth->q.result->msg, &rcode);
+		if (!auth->dn) goto finish;
+
+		rcode = ldap_auth_bind(t, request, auth);
+		if (rcode != RLM_MODULE_YIELD) goto finish;
+
+		rcode = ldap_query_yield(inst, request, &auth->q, mod_authenticate_resume, mod_authenticate_signal, auth);
+		if (rcode != RLM_MODULE_YIELD) goto finish;
+
+		return rcode;
+
+	case LDAP_AUTH_BIND:
+		rcode = rlm_ldap_bind_rcode(auth->q.ret);
+		if (rcode == RLM_MODULE_OK) RDEBUG2("Bind as user \"%s\" was successful", auth->dn);
+		break;
+	}
+
+finish:
+	talloc_free(auth);
+
+	return rcode;
+}
+
+/** Authenticate the user by binding as them on the bind trunk
+ *
+ * The request yields while the user object is located, and again while
+ * the bind is in progress.
+ */
+static rlm_rcode_t mod_authenticate_async(rlm_ldap_t const *inst, rlm_ldap_thread_t *t, REQUEST *request,
+					  VALUE_PAIR *username, VALUE_PAIR *password)
+{
+	static char const	*attrs[] = { LDAP_NO_ATTRS, NULL };
+	ldap_auth_ctx_t		*auth;
+	VALUE_PAIR		*vp;
+	rlm_rcode_t		rcode;
+
+	MEM(auth = talloc_zero(request, ldap_auth_ctx_t));
+	talloc_set_destructor(auth, _ldap_auth_ctx_free);
+	auth->password = password->vp_strvalue;
+
+	RDEBUG2("Login attempt by \"%pV\"", &username->data);
+
+	/*
+	 *	We may already have the DN from a previous call to authorize
+	 */
+	vp = fr_pair_list_find_by_da(&request->control, attr_ldap_userdn, TAG_ANY);
+	if (vp) {
+		RDEBUG2("Using user DN from request \"%pV\"", &vp->data);
+		auth->dn = vp->vp_strvalue;
+
+		rcode = ldap_auth_bind(t, request, auth);
+	} else {
+		char const	*base_dn, *filter;
+		char		base_dn_buff[LDAP_MAX_DN_STR_LEN];
+		char		filter_buff[LDAP_MAX_FILTER_STR_LEN];
+		LDAPControl	*serverctrls[] = { inst->userobj_sort_ctrl, NULL };
+
+		rcode = rlm_ldap_find_user_expand(inst, request, &base_dn, base_dn_buff, &filter, filter_buff);
+		if (rcode != RLM_MODULE_OK) goto finish;
+
+		auth->state = LDAP_AUTH_FIND;
+		if (fr_ldap_trunk_search(&auth->q.query, t->trunk, request, &auth->q, base_dn, inst->userobj_scope,
+					 filter, attrs, serverctrls, NULL) < 0) {
+			rcode = RLM_MODULE_FAIL;
+			goto finish;
+		}
+		rcode = RLM_MODULE_YIELD;
+	}
+	if (rcode != RLM_MODULE_YIELD) goto finish;
+
+	rcode = ldap_query_yield(inst, request, &auth->q, mod_authenticate_resume, mod_authenticate_signal, auth);
+	if (rcode == RLM_MODULE_YIELD) return rcode;
+
+finish:
+	talloc_free(auth);
+
+	return rcode;
+}
+
+static rlm_rcode_t CC_HINT(nonnull) mod_authenticate(module_ctx_t const *mctx, REQUEST *request)
+{
+	rlm_ldap_t const 	*inst = talloc_get_type_abort_const(mctx->instance, rlm_ldap_t);
+	rlm_ldap_thread_t	*t = talloc_get_type_abort(mctx->thread, rlm_ldap_thread_t);
+	rlm_rcode_t		rcode;
+	fr_ldap_rcode_t		status;
+	char const		*dn;
+	fr_ldap_connection_t	*conn;
+
+	char			sasl_mech_buff[LDAP_MAX_DN_STR_LEN];
+	char			sasl_proxy_buff[LDAP_MAX_DN_STR_LEN];
+	char			sasl_realm_buff[LDAP_MAX_DN_STR_LEN];
+	fr_ldap_sasl_t		sasl;
+	VALUE_PAIR *username, *password;
+
+	username = fr_pair_list_find_by_da(&request->packet->vps, attr_user_name, TAG_ANY);
+	password = fr_pair_list_find_by_da(&request->packet->vps, attr_user_password, TAG_ANY);
+
+	/*
+	 *	We can only authenticate user requests which HAVE
+	 *	a User-Name attribute.
+	 */
+	if (!username) {
+		REDEBUG("Attribute \"User-Name\" is required for authentication");
+		return RLM_MODULE_INVALID;
+	}
+
+	if (!password) {
+		RWDEBUG("You have set \"Auth-Type := LDAP\" somewhere");
+		RWDEBUG("without checking if User-Password is present");
+		RWDEBUG("*********************************************");
+		RWDEBUG("* THAT CONFIGURATION IS WRONG.  DELETE IT.   ");
+		RWDEBUG("* YOU ARE PREVENTING THE SERVER FROM WORKING");
+		RWDEBUG("*********************************************");
+
+		REDEBUG("Attribute \"User-Password\" is required for authentication");
+		return RLM_MODULE_INVALID;
+	}
+
+	/*
+	 *	Make sure the supplied password isn't empty
+	 */
+	if (password->vp_length == 0) {
+		REDEBUG("User-Password must not be empty");
+		return RLM_MODULE_INVALID;
+	}
+
+	/*
+	 *	Log the password
+	 */
+	if (RDEBUG_ENABLED3) {
+		RDEBUG("Login attempt with password \"%pV\"", &password->data);
+	} else {
+		RDEBUG2("Login attempt with password");
+	}
+
+	/*
+	 *	SASL binds may need multiple round trips,
+	 *	so continue to use the pool for them.
+	 */
+	if (t->bind_trunk && !inst->user_sasl.mech) return mod_authenticate_async(inst, t, request, username, password);
+
+	conn = mod_conn_get(inst, request);
+	if (!conn) return RLM_MODULE_FAIL;
+
+	/*
+	 *	Expand dynamic SASL fields
+	 */
+	if (inst->user_sasl.mech) {
+		memset(&sasl, 0, sizeof(sasl));
+
+		if (tmpl_expand(&sasl.mech, sasl_mech_buff, sizeof(sasl_mech_buff), request,
+				inst->user_sasl.mech, fr_ldap_escape_func, inst) < 0) {
+			RPEDEBUG("Failed expanding user.sasl.mech");
+			rcode = RLM_MODULE_FAIL;
+			goto finish;
+		}
+
+		if (inst->user_sasl.proxy) {
+			if (tmpl_expand(&sasl.proxy, sasl_proxy_buff, sizeof(sasl_proxy_buff), request,
+					inst->user_sasl.proxy, fr_ldap_escape_func, inst) < 0) {
+				RPEDEBUG("Failed expanding user.sasl.proxy");
+				rcode = RLM_MODULE_FAIL;
+				goto finish;
+			}
+		}
+
+		if (inst->user_sasl.realm) {
+			if (tmpl_expand(&sasl.realm, sasl_realm_buff, sizeof(sasl_realm_buff), request,
+					inst->user_sasl.realm, fr_ldap_escape_func, inst) < 0) {
+				RPEDEBUG("Failed expanding user.sasl.realm");
+				rcode = RLM_MODULE_FAIL;
+				goto finish;
+			}
+		}
+	}
+
+	RDEBUG2("Login attempt by \"%pV\"", &username->data);
+
+	/*
+	 *	Get the DN by doing a search.
+	 */
+	dn = rlm_ldap_find_user(inst, request, &conn, NULL, false, NULL, &rcode);
+	if (!dn) {
+		ldap_mod_conn_release(inst, request, conn);
+
+		return rcode;
+	}
+	conn->rebound = true;
+	status = fr_ldap_bind(request,
+			      &conn,
+			      dn, password->vp_strvalue,
+			      inst->user_sasl.mech ? &sasl : NULL,
+			      0,
+			      NULL, NULL);
+	rcode = rlm_ldap_bind_rcode(status);
+	if (rcode == RLM_MODULE_OK) RDEBUG2("Bind as user \"%s\" was successful", dn);
+
+finish:
+	ldap_mod_conn_release(inst, request, conn);
+
+	return rcode;
+}
+
+/** Expand the profile filter
+ *
+ */
+static int rlm_ldap_profile_filter(rlm_ldap_t const *inst, REQUEST *request,
+				   char const **filter, char filter_buff[])
+{
+	fr_assert(inst->profile_filter); 	/* We always have a default filter set */
+
+	if (tmpl_expand(filter, filter_buff, LDAP_MAX_FILTER_STR_LEN, request,
+			inst->profile_filter, fr_ldap_escape_func, NULL) < 0) {
+		REDEBUG("Failed creating profile filter");
+
+		return -1;
+	}
+
+	return 0;
+}
+
+/** Apply the result of a profile search
+ *
+ * @param[in] inst rlm_ldap configuration.
+ * @param[in] request Current request.
+ * @param[in] conn used to parse the result.
+ * @param[in] dn of the profile object.
+ * @param[in] status of the search.
+ * @param[in] result of the search.  Not freed.
+ * @param[in] expanded Structure containing a list of xlat expanded attribute names and mapping
+information.
+ * @return One of the RLM_MODULE_* values.
+ */
+static rlm_rcode_t rlm_ldap_map_profile_result(rlm_ldap_t const *inst, REQUEST *request,
+					       fr_ldap_connection_t *conn, char const *dn,
+					       fr_ldap_rcode_t status, LDAPMessage *result,
+					       fr_ldap_map_exp_t const *expanded)
+{
+	rlm_rcode_t	rcode = RLM_MODULE_OK;
+	LDAPMessage	*entry;
+	int		ldap_errno;
+
+	switch (status) {
+	case LDAP_PROC_SUCCESS:
+		break;
+
+	case LDAP_PROC_BAD_DN:
+	case LDAP_PROC_NO_RESULT:
+		RDEBUG2("Profile object \"%s\" not found", dn);
+		return RLM_MODULE_NOTFOUND;
+
+	default:
+		return RLM_MODULE_FAIL;
+	}
+
+	fr_assert(result);
+
+	entry = ldap_first_entry(conn->handle, result);
+	if (!entry) {
+		ldap_get_option(conn->handle, LDAP_OPT_RESULT_CODE, &ldap_errno);
+		REDEBUG("Failed retrieving entry: %s", ldap_err2string(ldap_errno));
+
+		return RLM_MODULE_NOTFOUND;
+	}
+
+	RDEBUG2("Processing profile attributes");
+	RINDENT();
+	if (fr_ldap_map_do(request, conn, inst->valuepair_attr, expanded, entry) > 0) rcode = RLM_MODULE_UPDATED;
+	REXDENT();
+
+	return rcode;
+}
+
+/** Search for and apply an LDAP profile
+ *
+ * LDAP profiles are mapped using the same attribute map as user objects, they're used to add common
+ * sets of attributes to the request.
+ *
+ * @param[in] inst rlm_ldap configuration.
+ * @param[in] request Current request.
+ * @param[in,out] pconn to use. May change as this function calls functions which auto re-connect.
+ * @param[in] dn of profile object to apply.
+ * @param[in] expanded Structure containing a list of xlat expanded attribute names and mapping
+information.
+ * @return One of the RLM_MODULE_* values.
+ */
+static rlm_rcode_t rlm_ldap_map_profile(rlm_ldap_t const *inst, REQUEST *request, fr_ldap_connection_t **pconn,
+					char const *dn, fr_ldap_map_exp_t const *expanded)
+{
+	rlm_rcode_t	rcode;
+	fr_ldap_rcode_t	status;
+	LDAPMessage	*result = NULL;
+	char const	*filter;
+	char		filter_buff[LDAP_MAX_FILTER_STR_LEN];
+
+	if (!dn || !*dn) return RLM_MODULE_OK;
+
+	if (rlm_ldap_profile_filter(inst, request, &filter, filter_buff) < 0) return RLM_MODULE_INVALID;
+
+	status = fr_ldap_search(&result, request, pconn, dn,
+				LDAP_SCOPE_BASE, filter, expanded->attrs, NULL, NULL);
+
+	fr_assert(*pconn);
+
+	rcode = rlm_ldap_map_profile_result(inst, request, *pconn, dn, status, result, expanded);
+	if (result) ldap_msgfree(result);
+
+	return rcode;
+}
+
+/** Add any additional attributes we need for checking access, memberships, and profiles
+ *
+ */
+static void rlm_ldap_autz_attrs(rlm_ldap_t const *inst, fr_ldap_map_exp_t *expanded)
+{
+	if (inst->userobj_access_attr) {
+		expanded->attrs[expanded->count++] = inst->userobj_access_attr;
+	}
+
+	if (inst->userobj_membership_attr && (inst->cacheable_group_dn || inst->cacheable_group_name)) {
+		expanded->attrs[expanded->count++] = inst->userobj_membership_attr;
+	}
+
+	if (inst->profile_attr) {
+		expanded->attrs[expanded->count++] = inst->profile_attr;
+	}
+
+	if (inst->valuepair_attr) {
+		expanded->attrs[expanded->count++] = inst->valuepair_attr;
+	}
+
+	expanded->attrs[expanded->count] = NULL;
+}
+
+/** Cache the user's group memberships, if configured to
+ *
+ */
+static rlm_rcode_t rlm_ldap_autz_groups(rlm_ldap_t const *inst, REQUEST *request, fr_ldap_connection_t **pconn,
+					LDAPMessage *entry)
+{
+	rlm_rcode_t rcode;
+
+	if (!inst->cacheable_group_dn && !inst->cacheable_group_name) return RLM_MODULE_OK;
+
+	if (inst->userobj_membership_attr) {
+		rcode = rlm_ldap_cacheable_userobj(inst, request, pconn, entry, inst->userobj_membership_attr);
+		if (rcode != RLM_MODULE_OK) return rcode;
+	}
+
+	return rlm_ldap_cacheable_groupobj(inst, request, pconn);
+}
+
+#ifdef WITH_EDIR
+/** Add the universal password retrieved from eDirectory to the control list
+ *
+ */
+static VALUE_PAIR *rlm_ldap_edir_password_add(REQUEST *request, char const *password, size_t pass_size)
+{
+	VALUE_PAIR	*vp;
+
+	/*
+	 *	Add Cleartext-Password attribute to the request
+	 */
+	MEM(pair_update_control(&vp, attr_cleartext_password) >= 0);
+	fr_pair_value_bstrndup(vp, password, pass_size, true);
+
+	if (RDEBUG_ENABLED3) {
+		RDEBUG3("Added eDirectory password.  control:%pP", vp);
+	} else {
+		RDEBUG2("Added eDirectory password");
+	}
+
+	return vp;
+}
+
+/** Retrieve the user's universal password, and optionally bind as them
+ *
+ */
+static rlm_rcode_t rlm_ldap_autz_edir(rlm_ldap_t const *inst, REQUEST *request, fr_ldap_connection_t **pconn,
+				      char const *dn)
+{
+	VALUE_PAIR	*vp;
+	int		res = 0;
+	char		password[256];
+	size_t		pass_size = sizeof(password);
+	rlm_rcode_t	rcode;
+
+	if (!inst->edir) return RLM_MODULE_OK;
+
+	/*
+	 *	We already have a Cleartext-Password.  Skip edir.
+	 */
+	if (fr_pair_list_find_by_da(&request->control, attr_cleartext_password, TAG_ANY)) return RLM_MODULE_OK;
+
+	/*
+	 *	Retrive universal password
+	 */
+	res = fr_ldap_edir_get_password((*pconn)->handle, dn, password, &pass_size);
+	if (res != 0) {
+		REDEBUG("Failed to retrieve eDirectory password: (%i) %s", res, fr_ldap_edir_errstr(res));
+
+		return RLM_MODULE_FAIL;
+	}
+
+	vp = rlm_ldap_edir_password_add(request, password, pass_size);
+
+	if (!inst->edir_autz) return RLM_MODULE_OK;
+
+	RDEBUG2("Binding as user for eDirectory authorization checks");
+	/*
+	 *	Bind as the user
+	 */
+	(*pconn)->rebound = true;
+	rcode = rlm_ldap_bind_rcode(fr_ldap_bind(request, pconn, dn, vp->vp_strvalue, NULL, 0, NULL, NULL));
+	if (rcode == RLM_MODULE_OK) RDEBUG2("Bind as user '%s' was successful", dn);
+
+	return rcode;
+}
+#endif
+
+typedef enum {
+	LDAP_AUTZ_FIND = 0,				//!< Searching for the user object.
+	LDAP_AUTZ_GROUP_DN2NAME,			//!< Resolving a group DN from the user object to a name.
+	LDAP_AUTZ_GROUP_NAME2DN,			//!< Resolving group names from the user object to DNs.
+	LDAP_AUTZ_GROUPOBJ,				//!< Searching for group objects including the user.
+#ifdef WITH_EDIR
+	LDAP_AUTZ_EDIR_PASSWORD,			//!< Retrieving the user's universal password.
+	LDAP_AUTZ_EDIR_BIND,				//!< Binding as the user.
+#endif
+	LDAP_AUTZ_DEFAULT_PROFILE,			//!< Searching for the default profile.
+	LDAP_AUTZ_USER_PROFILE				//!< Searching for one of the user's profiles.
+} ldap_autz_state_t;
+
+/** State of an asynchronous authorization
+ *
+ */
+typedef struct {
+	ldap_query_ctx_t	q;			//!< Query currently in flight.
+	ldap_autz_state_t	state;			//!< What we're waiting for.
+	fr_ldap_map_exp_t	expanded;		//!< Attributes to retrieve, and how to map them.
+	fr_ldap_result_t	*result;		//!< Containing the user object.
+	LDAPMessage		*entry;			//!< The user object.
+	char const		*dn;			//!< Of the user object.
+	rlm_ldap_userobj_groups_t *groups;		//!< Group memberships from the user object
+							///< which are being resolved.
+	char const		*attrs[2];		//!< Attributes to retrieve when resolving groups.
+	char			*profile_dn;		//!< Profile currently being retrieved.
+	struct berval		**profile_values;	//!< DNs of the user's profiles.
+	int			profile_idx;		//!< Next user profile to retrieve.
+	rlm_rcode_t		rcode;			//!< To return once all the profiles have been applied.
+} ldap_autz_ctx_t;
+
+static int _ldap_autz_ctx_free(ldap_autz_ctx_t *autz)
+{
+	talloc_free(autz->q.result);
+	talloc_free(autz->result);
+	if (autz->profile_values) ldap_value_free_len(autz->profile_values);
+	talloc_free(autz->expanded.ctx);
+
+	return 0;
+}
+
+/** Enqueue a search on behalf of an asynchronous authorization
+ *
+ * @return
+ *	- RLM_MODULE_YIELD if the search was enqueued.
+ *	- RLM_MODULE_FAIL on error.
+ */
+static rlm_rcode_t ldap_autz_search(rlm_ldap_thread_t *t, REQUEST *request, ldap_autz_ctx_t *autz,
+				    char const *dn, int scope, char const *filter, char const * const *attrs)
+{
+	/*
+	 *	Free the result of any previous search
+	 */
+	TALLOC_FREE(autz->q.result);
+
+	if (fr_ldap_trunk_search(&autz->q.query, t->trunk, request, &autz->q, dn, scope,
+				 filter, attrs, NULL, NULL) < 0) return RLM_MODULE_FAIL;
+
+	return RLM_MODULE_YIELD;
+}
+
+/** Enqueue a search for a profile object
+ *
+ * @return
+ *	- RLM_MODULE_YIELD if the search was enqueued.
+ *	- RLM_MODULE_NOOP if there's no profile to retrieve.
+ *	- RLM_MODULE_INVALID or RLM_MODULE_FAIL on error.
+ */
+static rlm_rcode_t ldap_autz_profile_search(rlm_ldap_t const *inst, rlm_ldap_thread_t *t, REQUEST *request,
+					    ldap_autz_ctx_t *autz, char const *dn)
+{
+	char const	*filter;
+	char		filter_buff[LDAP_MAX_FILTER_STR_LEN];
+
+	if (!dn || !*dn) return RLM_MODULE_NOOP;
+
+	if (rlm_ldap_profile_filter(inst, request, &filter, filter_buff) < 0) return RLM_MODULE_INVALID;
+
+	talloc_free(autz->profile_dn);
+	MEM(autz->profile_dn = talloc_strdup(autz, dn));
+
+	return ldap_autz_search(t, request, autz, dn, LDAP_SCOPE_BASE, filter, autz->expanded.attrs);
+}
+
+/** Process the user object, and perform access checks
+ *
+ * Memberships in the user object are parsed here, and resolved by the
+ * searches enqueued by #ldap_autz_next.
+ */
+static rlm_rcode_t ldap_autz_user(rlm_ldap_t const *inst, REQUEST *request, fr_ldap_connection_t *conn,
+				  ldap_autz_ctx_t *autz)
+{
+	char const		*dn;
+	rlm_rcode_t		rcode;
+
+	switch (autz->q.ret) {
+	case LDAP_PROC_SUCCESS:
+		break;
+
+	case LDAP_PROC_BAD_DN:
+	case LDAP_PROC_NO_RESULT:
+		RDEBUG2("User object not found");
+		return RLM_MODULE_NOTFOUND;
+
+	default:
+		return RLM_MODULE_FAIL;
+	}
+
+	autz->result = autz->q.result;
+	autz->q.result = NULL;
+
+	dn = rlm_ldap_find_user_result(inst, request, conn, autz->result->msg, &rcode);
+	if (!dn) return rcode;
+	MEM(autz->dn = talloc_strdup(autz, dn));
+
+	autz->entry = ldap_first_entry(conn->handle, autz->result->msg);	/* Checked by rlm_ldap_find_user_result */
+
+	/*
+	 *	Check for access.
+	 */
+	if (inst->userobj_access_attr) {
+		rcode = rlm_ldap_check_access(inst, request, conn, autz->entry);
+		if (rcode != RLM_MODULE_OK) return rcode;
+	}
+
+	/*
+	 *	Check if we need to cache group memberships
+	 */
+	if ((inst->cacheable_group_dn || inst->cacheable_group_name) && inst->userobj_membership_attr) {
+		return rlm_ldap_cacheable_userobj_parse(&autz->groups, autz, inst, request, conn, autz->entry,
+							inst->userobj_membership_attr);
+	}
+
+	return RLM_MODULE_OK;
+}
+
+/** Enqueue the next query needed to authorize the user
+ *
+ * Follows the same logic as the synchronous path in #mod_authorize.  Each state
+ * falls through to the next if there's nothing to do for it.
+ *
+ * @return
+ *	- RLM_MODULE_YIELD if a query was enqueued.
+ *	- Another RLM_MODULE_* value once authorization is complete, or on error.
+ */
+static rlm_rcode_t ldap_autz_next(rlm_ldap_t const *inst, rlm_ldap_thread_t *t, REQUEST *request,
+				  ldap_autz_ctx_t *autz)
+{
+	rlm_ldap_userobj_groups_t	*groups = autz->groups;
+	fr_ldap_connection_t		*conn;
+	rlm_rcode_t			rcode;
+
+	switch (autz->state) {
+	case LDAP_AUTZ_FIND:
+	case LDAP_AUTZ_GROUP_DN2NAME:
+		/*
+		 *	Resolve the memberships from the user object
+		 */
+		if (groups) {
+			char const	*base_dn;
+			char		base_dn_buff[LDAP_MAX_DN_STR_LEN];
+			char		*filter;
+
+			if (groups->dns[groups->dn_idx]) {
+				RDEBUG2("Resolving group DN \"%s\" to group name", groups->dns[groups->dn_idx]);
+
+				autz->state = LDAP_AUTZ_GROUP_DN2NAME;
+				autz->attrs[0] = inst->groupobj_name_attr;
+				return ldap_autz_search(t, request, autz, groups->dns[groups->dn_idx],
+							LDAP_SCOPE_BASE, NULL, autz->attrs);
+			}
+
+			rcode = rlm_ldap_cacheable_userobj_name2dn_expand(inst, request, groups,
+									  &base_dn, base_dn_buff, &filter);
+			if (rcode == RLM_MODULE_OK) {
+				autz->state = LDAP_AUTZ_GROUP_NAME2DN;
+				autz->attrs[0] = NULL;
+				rcode = ldap_autz_search(t, request, autz, base_dn, inst->groupobj_scope,
+							 filter, autz->attrs);
+				talloc_free(filter);
+
+				return rcode;
+			}
+			if (rcode != RLM_MODULE_NOOP) return rcode;
+
+			rlm_ldap_cacheable_userobj_merge(inst, request, groups);
+			TALLOC_FREE(autz->groups);
+		}
+		FALL_THROUGH;
+
+	case LDAP_AUTZ_GROUP_NAME2DN:
+		/*
+		 *	Cache the group objects the user is a member of
+		 */
+		if (inst->cacheable_group_dn || inst->cacheable_group_name) {
+			char const	*base_dn;
+			char		base_dn_buff[LDAP_MAX_DN_STR_LEN];
+			char		filter[LDAP_MAX_FILTER_STR_LEN + 1];
+
+			rcode = rlm_ldap_cacheable_groupobj_expand(inst, request, &base_dn, base_dn_buff, filter);
+			if (rcode == RLM_MODULE_OK) {
+				autz->state = LDAP_AUTZ_GROUPOBJ;
+				autz->attrs[0] = inst->groupobj_name_attr;
+				return ldap_autz_search(t, request, autz, base_dn, inst->groupobj_scope,
+							filter, autz->attrs);
+			}
+			if (rcode != RLM_MODULE_NOOP) return rcode;
+		}
+		FALL_THROUGH;
+
+	case LDAP_AUTZ_GROUPOBJ:
+#ifdef WITH_EDIR
+		/*
+		 *	Retrieve Universal Password if we use eDirectory,
+		 *	and don't already have a Cleartext-Password.
+		 */
+		if (inst->edir && !fr_pair_list_find_by_da(&request->control, attr_cleartext_password, TAG_ANY)) {
+			TALLOC_FREE(autz->q.result);
+
+			autz->state = LDAP_AUTZ_EDIR_PASSWORD;
+			if (fr_ldap_edir_get_password_async(&autz->q.query, t->trunk, request,
+							    &autz->q, autz->dn) < 0) return RLM_MODULE_FAIL;
+
+			return RLM_MODULE_YIELD;
+		}
+		FALL_THROUGH;
+
+	case LDAP_AUTZ_EDIR_PASSWORD:
+		/*
+		 *	Only bind as the user if we retrieved their password
+		 */
+		if (inst->edir_autz && (autz->state == LDAP_AUTZ_EDIR_PASSWORD)) {
+			VALUE_PAIR *vp;
+
+			vp = fr_pair_list_find_by_da(&request->control, attr_cleartext_password, TAG_ANY);
+			fr_assert(vp);
+
+			RDEBUG2("Binding as user for eDirectory authorization checks");
+
+			autz->state = LDAP_AUTZ_EDIR_BIND;
+			if (fr_ldap_trunk_bind(&autz->q.query, t->bind_trunk, request, &autz->q,
+					       autz->dn, vp->vp_strvalue, NULL, NULL) < 0) return RLM_MODULE_FAIL;
+
+			return RLM_MODULE_YIELD;
+		}
+		FALL_THROUGH;
+
+	case LDAP_AUTZ_EDIR_BIND:
+#endif
+		/*
+		 *	Apply ONE user profile, or a default user profile.
+		 */
+		autz->state = LDAP_AUTZ_DEFAULT_PROFILE;
+		if (inst->default_profile) {
+			char const *profile;
+			char profile_buff[1024];
+
+			if (tmpl_expand(&profile, profile_buff, sizeof(profile_buff),
+					request, inst->default_profile, NULL, NULL) < 0) {
+				REDEBUG("Failed creating default profile string");
+
+				return RLM_MODULE_INVALID;
+			}
+
+			rcode = ldap_autz_profile_search(inst, t, request, autz, profile);
+			if (rcode != RLM_MODULE_NOOP) return rcode;
+		}
+		FALL_THROUGH;
+
+	case LDAP_AUTZ_DEFAULT_PROFILE:
+		/*
+		 *	The user object must be parsed with the handle
+		 *	of the connection which received it.
+		 */
+		conn = autz->result->c;
+		if (!conn) {
+			REDEBUG("Connection closed before the user object could be processed");
+
+			return RLM_MODULE_FAIL;
+		}
+
+		/*
+		 *	Apply a SET of user profiles.
+		 */
+		autz->state = LDAP_AUTZ_USER_PROFILE;
+		if (inst->profile_attr) autz->profile_values = ldap_get_values_len(conn->handle, autz->entry,
+										   inst->profile_attr);
+		FALL_THROUGH;
+
+	case LDAP_AUTZ_USER_PROFILE:
+		while (autz->profile_values && autz->profile_values[autz->profile_idx]) {
+			char *value;
+
+			value = fr_ldap_berval_to_string(request, autz->profile_values[autz->profile_idx++]);
+			rcode = ldap_autz_profile_search(inst, t, request, autz, value);
+			talloc_free(value);
+			if (rcode == RLM_MODULE_YIELD) return rcode;
+			if (rcode == RLM_MODULE_FAIL) return rcode;
+		}
+		break;
+	}
+
+	if (inst->user_map || inst->valuepair_attr) {
+		conn = autz->result->c;
+		if (!conn) {
+			REDEBUG("Connection closed before the user object could be processed");
+
+			return RLM_MODULE_FAIL;
+		}
+
+		RDEBUG2("Processing user attributes");
+		RINDENT();
+		if (fr_ldap_map_do(request, conn, inst->valuepair_attr,
+				   &autz->expanded, autz->entry) > 0) autz->rcode = RLM_MODULE_UPDATED;
+		REXDENT();
+		rlm_ldap_check_reply(inst, request, conn);
+	}
+
+	return autz->rcode;
+}
+
+static void mod_authorize_signal(UNUSED module_ctx_t const *mctx, REQUEST *request,
+				 void *rctx, fr_state_signal_t action)
+{
+	ldap_autz_ctx_t		*autz = talloc_get_type_abort(rctx, ldap_autz_ctx_t);
+
+	if (action != FR_SIGNAL_CANCEL) return;
+
+	ldap_query_cancel(request, &autz->q);
+	talloc_free(autz);
+}
+
+/** Process the result of the last query, and enqueue the next one
+ *
+ */
+static rlm_rcode_t mod_authorize_resume(module_ctx_t const *mctx, REQUEST *request, void *rctx)
+{
+	rlm_ldap_t const	*inst = talloc_get_type_abort_const(mctx->instance, rlm_ldap_t);
+	rlm_ldap_thread_t	*t = talloc_get_type_abort(mctx->thread, rlm_ldap_thread_t);
+	ldap_autz_ctx_t		*autz = talloc_get_type_abort(rctx, ldap_autz_ctx_t);
+	fr_ldap_connection_t	*conn;
+	LDAPMessage		*result;
+	rlm_rcode_t		rcode;
+
+	(void) unlang_module_timeout_delete(request, &autz->q);
+
+	conn = ldap_query_result_conn(request, &autz->q);
+	result = autz->q.result ? autz->q.result->msg : NULL;
+
+	switch (autz->state) {
+	case LDAP_AUTZ_FIND:
+		rcode = ldap_autz_user(inst, request, conn, autz);
+		if (rcode != RLM_MODULE_OK) goto finish;
+		break;
+
+	case LDAP_AUTZ_GROUP_DN2NAME:
+		rcode = rlm_ldap_cacheable_userobj_dn2name(inst, request, autz->groups, conn, autz->q.ret, result);
+		if (rcode != RLM_MODULE_OK) goto finish;
+		break;
+
+	case LDAP_AUTZ_GROUP_NAME2DN:
+		rcode = rlm_ldap_cacheable_userobj_name2dn(inst, request, autz->groups, conn, autz->q.ret, result);
+		if (rcode != RLM_MODULE_OK) goto finish;
 
-	conn = mod_conn_get(inst, request);
-	if (!conn) return RLM_MODULE_FAIL;
+		rlm_ldap_cacheable_userobj_merge(inst, request, autz->groups);
+		TALLOC_FREE(autz->groups);
+		break;
 
-	/*
-	 *	Expand dynamic SASL fields
-	 */
-	if (inst->user_sasl.mech) {
-		memset(&sasl, 0, sizeof(sasl));
+	case LDAP_AUTZ_GROUPOBJ:
+		rcode = rlm_ldap_cacheable_groupobj_result(inst, request, conn, autz->q.ret, result);
+		if (rcode != RLM_MODULE_OK) goto finish;
+		break;
+
+#ifdef WITH_EDIR
+	case LDAP_AUTZ_EDIR_PASSWORD:
+	{
+		int	res;
+		char	password[256];
+		size_t	pass_size = sizeof(password);
+
+		if (autz->q.ret != LDAP_PROC_SUCCESS) {
+			REDEBUG("Failed to retrieve eDirectory password");
 
-		if (tmpl_expand(&sasl.mech, sasl_mech_buff, sizeof(sasl_mech_buff), request,
-				inst->user_sasl.mech, fr_ldap_escape_func, inst) < 0) {
-			RPEDEBUG("Failed expanding user.sasl.mech");
 			rcode = RLM_MODULE_FAIL;
 			goto finish;
 		}
 
-		if (inst->user_sasl.proxy) {
-			if (tmpl_expand(&sasl.proxy, sasl_proxy_buff, sizeof(sasl_proxy_buff), request,
-					inst->user_sasl.proxy, fr_ldap_escape_func, inst) < 0) {
-				RPEDEBUG("Failed expanding user.sasl.proxy");
-				rcode = RLM_MODULE_FAIL;
-				goto finish;
-			}
-		}
+		res = fr_ldap_edir_get_password_result(autz->q.result, password, &pass_size);
+		if (res != 0) {
+			REDEBUG("Failed to retrieve eDirectory password: (%i) %s", res, fr_ldap_edir_errstr(res));
 
-		if (inst->user_sasl.realm) {
-			if (tmpl_expand(&sasl.realm, sasl_realm_buff, sizeof(sasl_realm_buff), request,
-					inst->user_sasl.realm, fr_ldap_escape_func, inst) < 0) {
-				RPEDEBUG("Failed expanding user.sasl.realm");
-				rcode = RLM_MODULE_FAIL;
-				goto finish;
-			}
+			rcode = RLM_MODULE_FAIL;
+			goto finish;
 		}
-	}
-
-	RDEBUG2("Login attempt by \"%pV\"", &username->data);
-
-	/*
-	 *	Get the DN by doing a search.
-	 */
-	dn = rlm_ldap_find_user(inst, request, &conn, NULL, false, NULL, &rcode);
-	if (!dn) {
-		ldap_mod_conn_release(inst, request, conn);
 
-		return rcode;
+		(void) rlm_ldap_edir_password_add(request, password, pass_size);
 	}
-	conn->rebound = true;
-	status = fr_ldap_bind(request,
-			      &conn,
-			      dn, password->vp_strvalue,
-			      inst->user_sasl.mech ? &sasl : NULL,
-			      0,
-			      NULL, NULL);
-	switch (status) {
-	case LDAP_PROC_SUCCESS:
-		rcode = RLM_MODULE_OK;
-		RDEBUG2("Bind as user \"%s\" was successful", dn);
 		break;
 
-	case LDAP_PROC_NOT_PERMITTED:
-		rcode = RLM_MODULE_DISALLOW;
-		break;
+	case LDAP_AUTZ_EDIR_BIND:
+		rcode = rlm_ldap_bind_rcode(autz->q.ret);
+		if (rcode != RLM_MODULE_OK) goto finish;
 
-	case LDAP_PROC_REJECT:
-		rcode = RLM_MODULE_REJECT;
+		RDEBUG2("Bind as user '%s' was successful", autz->dn);
 		break;
+#endif
 
-	case LDAP_PROC_BAD_DN:
-		rcode = RLM_MODULE_INVALID;
-		break;
+	case LDAP_AUTZ_DEFAULT_PROFILE:
+		switch (rlm_ldap_map_profile_result(inst, request, conn, autz->profile_dn,
+						    autz->q.ret, result, &autz->expanded)) {
+		case RLM_MODULE_FAIL:
+			rcode = RLM_MODULE_FAIL;
+			goto finish;
 
-	case LDAP_PROC_NO_RESULT:
-		rcode = RLM_MODULE_NOTFOUND;
+		case RLM_MODULE_UPDATED:
+			autz->rcode = RLM_MODULE_UPDATED;
+			break;
+
+		default:
+			break;
+		}
 		break;
 
-	default:
-		rcode = RLM_MODULE_FAIL;
+	case LDAP_AUTZ_USER_PROFILE:
+		rcode = rlm_ldap_map_profile_result(inst, request, conn, autz->profile_dn,
+						    autz->q.ret, result, &autz->expanded);
+		if (rcode == RLM_MODULE_FAIL) goto finish;
 		break;
-	};
+	}
+
+	rcode = ldap_autz_next(inst, t, request, autz);
+	if (rcode == RLM_MODULE_YIELD) {
+		rcode = ldap_query_yield(inst, request, &autz->q, mod_authorize_resume, mod_authorize_signal, autz);
+		if (rcode == RLM_MODULE_YIELD) return rcode;
+	}
 
 finish:
-	ldap_mod_conn_release(inst, request, conn);
+	talloc_free(autz);
 
 	return rcode;
 }
 
-/** Search for and apply an LDAP profile
+/** Retrieve the user object, resolve group memberships, and retrieve profiles via the trunk
  *
- * LDAP profiles are mapped using the same attribute map as user objects, they're used to add common
- * sets of attributes to the request.
- *
- * @param[in] inst rlm_ldap configuration.
- * @param[in] request Current request.
- * @param[in,out] pconn to use. May change as this function calls functions which auto re-connect.
- * @param[in] dn of profile object to apply.
- * @param[in] expanded Structure containing a list of xlat expanded attribute names and mapping
-information.
- * @return One of the RLM_MODULE_* values.
+ * The request yields while each query is in flight, so the worker can
+ * continue processing other requests.
  */
-static rlm_rcode_t rlm_ldap_map_profile(rlm_ldap_t const *inst, REQUEST *request, fr_ldap_connection_t **pconn,
-					char const *dn, fr_ldap_map_exp_t const *expanded)
+static rlm_rcode_t mod_authorize_async(rlm_ldap_t const *inst, rlm_ldap_thread_t *t, REQUEST *request)
 {
-	rlm_rcode_t	rcode = RLM_MODULE_OK;
-	fr_ldap_rcode_t	status;
-	LDAPMessage	*result = NULL, *entry = NULL;
-	int		ldap_errno;
-	LDAP		*handle = (*pconn)->handle;
-	char const	*filter;
-	char		filter_buff[LDAP_MAX_FILTER_STR_LEN];
-
-	fr_assert(inst->profile_filter); 	/* We always have a default filter set */
-
-	if (!dn || !*dn) return RLM_MODULE_OK;
-
-	if (tmpl_expand(&filter, filter_buff, sizeof(filter_buff), request,
-			inst->profile_filter, fr_ldap_escape_func, NULL) < 0) {
-		REDEBUG("Failed creating profile filter");
-
-		return RLM_MODULE_INVALID;
-	}
-
-	status = fr_ldap_search(&result, request, pconn, dn,
-				LDAP_SCOPE_BASE, filter, expanded->attrs, NULL, NULL);
-	switch (status) {
-	case LDAP_PROC_SUCCESS:
-		break;
+	ldap_autz_ctx_t		*autz;
+	char const		*base_dn, *filter;
+	char			base_dn_buff[LDAP_MAX_DN_STR_LEN];
+	char			filter_buff[LDAP_MAX_FILTER_STR_LEN];
+	LDAPControl		*serverctrls[] = { inst->userobj_sort_ctrl, NULL };
+	rlm_rcode_t		rcode;
 
-	case LDAP_PROC_BAD_DN:
-	case LDAP_PROC_NO_RESULT:
-		RDEBUG2("Profile object \"%s\" not found", dn);
-		return RLM_MODULE_NOTFOUND;
+	MEM(autz = talloc_zero(request, ldap_autz_ctx_t));
+	talloc_set_destructor(autz, _ldap_autz_ctx_free);
+	autz->rcode = RLM_MODULE_OK;
 
-	default:
-		return RLM_MODULE_FAIL;
+	if (fr_ldap_map_expand(&autz->expanded, request, inst->user_map) < 0) {
+		rcode = RLM_MODULE_FAIL;
+		goto finish;
 	}
+	rlm_ldap_autz_attrs(inst, &autz->expanded);
 
-	fr_assert(*pconn);
-	fr_assert(result);
-
-	entry = ldap_first_entry(handle, result);
-	if (!entry) {
-		ldap_get_option(handle, LDAP_OPT_RESULT_CODE, &ldap_errno);
-		REDEBUG("Failed retrieving entry: %s", ldap_err2string(ldap_errno));
-
-		rcode = RLM_MODULE_NOTFOUND;
+	rcode = rlm_ldap_find_user_expand(inst, request, &base_dn, base_dn_buff, &filter, filter_buff);
+	if (rcode != RLM_MODULE_OK) goto finish;
 
-		goto free_result;
+	if (fr_ldap_trunk_search(&autz->q.query, t->trunk, request, &autz->q, base_dn, inst->userobj_scope,
+				 filter, autz->expanded.attrs, serverctrls, NULL) < 0) {
+		rcode = RLM_MODULE_FAIL;
+		goto finish;
 	}
 
-	RDEBUG2("Processing profile attributes");
-	RINDENT();
-	if (fr_ldap_map_do(request, *pconn, inst->valuepair_attr, expanded, entry) > 0) rcode = RLM_MODULE_UPDATED;
-	REXDENT();
+	rcode = ldap_query_yield(inst, request, &autz->q, mod_authorize_resume, mod_authorize_signal, autz);
+	if (rcode == RLM_MODULE_YIELD) return rcode;
 
-free_result:
-	ldap_msgfree(result);
+finish:
+	talloc_free(autz);
 
 	return rcode;
 }
@@ -933,6 +2253,7 @@ free_result:
 static rlm_rcode_t CC_HINT(nonnull) mod_authorize(module_ctx_t const *mctx, REQUEST *request)
 {
 	rlm_ldap_t const 	*inst = talloc_get_type_abort_const(mctx->instance, rlm_ldap_t);
+	rlm_ldap_thread_t	*t = talloc_get_type_abort(mctx->thread, rlm_ldap_thread_t);
 	rlm_rcode_t		rcode = RLM_MODULE_OK;
 	int			ldap_errno;
 	int			i;
@@ -941,9 +2262,6 @@ static rlm_rcode_t CC_HINT(nonnull) mod_authorize(module_ctx_t const *mctx, REQU
 	LDAPMessage		*result, *entry;
 	char const 		*dn = NULL;
 	fr_ldap_map_exp_t	expanded; /* faster than allocing every time */
-#ifdef WITH_EDIR
-	fr_ldap_rcode_t		status;
-#endif
 
 	/*
 	 *	Don't be tempted to add a check for User-Name or
@@ -951,31 +2269,14 @@ static rlm_rcode_t CC_HINT(nonnull) mod_authorize(module_ctx_t const *mctx, REQU
 	 *	for many things besides searching for users.
 	 */
 
+	if (t->trunk) return mod_authorize_async(inst, t, request);
+
 	if (fr_ldap_map_expand(&expanded, request, inst->user_map) < 0) return RLM_MODULE_FAIL;
 
 	conn = mod_conn_get(inst, request);
 	if (!conn) return RLM_MODULE_FAIL;
 
-	/*
-	 *	Add any additional attributes we need for checking access, memberships, and profiles
-	 */
-	if (inst->userobj_access_attr) {
-		expanded.attrs[expanded.count++] = inst->userobj_access_attr;
-	}
-
-	if (inst->userobj_membership_attr && (inst->cacheable_group_dn || inst->cacheable_group_name)) {
-		expanded.attrs[expanded.count++] = inst->userobj_membership_attr;
-	}
-
-	if (inst->profile_attr) {
-		expanded.attrs[expanded.count++] = inst->profile_attr;
-	}
-
-	if (inst->valuepair_attr) {
-		expanded.attrs[expanded.count++] = inst->valuepair_attr;
-	}
-
-	expanded.attrs[expanded.count] = NULL;
+	rlm_ldap_autz_attrs(inst, &expanded);
 
 	dn = rlm_ldap_find_user(inst, request, &conn, expanded.attrs, true, &result, &rcode);
 	if (!dn) {
@@ -1003,95 +2304,15 @@ static rlm_rcode_t CC_HINT(nonnull) mod_authorize(module_ctx_t const *mctx, REQU
 	/*
 	 *	Check if we need to cache group memberships
 	 */
-	if (inst->cacheable_group_dn || inst->cacheable_group_name) {
-		if (inst->userobj_membership_attr) {
-			rcode = rlm_ldap_cacheable_userobj(inst, request, &conn, entry, inst->userobj_membership_attr);
-			if (rcode != RLM_MODULE_OK) {
-				goto finish;
-			}
-		}
-
-		rcode = rlm_ldap_cacheable_groupobj(inst, request, &conn);
-		if (rcode != RLM_MODULE_OK) {
-			goto finish;
-		}
-	}
+	rcode = rlm_ldap_autz_groups(inst, request, &conn, entry);
+	if (rcode != RLM_MODULE_OK) goto finish;
 
 #ifdef WITH_EDIR
-	/*
-	 *	We already have a Cleartext-Password.  Skip edir.
-	 */
-	if (fr_pair_find_by_da(request->control, attr_cleartext_password, TAG_ANY)) goto skip_edir;
-
 	/*
 	 *      Retrieve Universal Password if we use eDirectory
 	 */
-	if (inst->edir) {
-		VALUE_PAIR	*vp;
-		int		res = 0;
-		char		password[256];
-		size_t		pass_size = sizeof(password);
-
-		/*
-		 *	Retrive universal password
-		 */
-		res = fr_ldap_edir_get_password(conn->handle, dn, password, &pass_size);
-		if (res != 0) {
-			REDEBUG("Failed to retrieve eDirectory password: (%i) %s", res, fr_ldap_edir_errstr(res));
-			rcode = RLM_MODULE_FAIL;
-
-			goto finish;
-		}
-
-		/*
-		 *	Add Cleartext-Password attribute to the request
-		 */
-		MEM(pair_update_control(&vp, attr_cleartext_password) >= 0);
-		fr_pair_value_bstrndup(vp, password, pass_size, true);
-
-		if (RDEBUG_ENABLED3) {
-			RDEBUG3("Added eDirectory password.  control:%pP", vp);
-		} else {
-			RDEBUG2("Added eDirectory password");
-		}
-
-		if (inst->edir_autz) {
-			RDEBUG2("Binding as user for eDirectory authorization checks");
-			/*
-			 *	Bind as the user
-			 */
-			conn->rebound = true;
-			status = fr_ldap_bind(request, &conn, dn, vp->vp_strvalue, NULL, 0, NULL, NULL);
-			switch (status) {
-			case LDAP_PROC_SUCCESS:
-				rcode = RLM_MODULE_OK;
-				RDEBUG2("Bind as user '%s' was successful", dn);
-				break;
-
-			case LDAP_PROC_NOT_PERMITTED:
-				rcode = RLM_MODULE_DISALLOW;
-				goto finish;
-
-			case LDAP_PROC_REJECT:
-				rcode = RLM_MODULE_REJECT;
-				goto finish;
-
-			case LDAP_PROC_BAD_DN:
-				rcode = RLM_MODULE_INVALID;
-				goto finish;
-
-			case LDAP_PROC_NO_RESULT:
-				rcode = RLM_MODULE_NOTFOUND;
-				goto finish;
-
-			default:
-				rcode = RLM_MODULE_FAIL;
-				goto finish;
-			};
-		}
-	}
-
-skip_edir:
+	rcode = rlm_ldap_autz_edir(inst, request, &conn, dn);
+	if (rcode != RLM_MODULE_OK) goto finish;
 #endif
 
 	/*
@@ -1473,6 +2694,21 @@ static int parse_sub_section(rlm_ldap_t *inst, CONF_SECTION *parent, ldap_acct_s
 	return 0;
 }
 
+/** Find the module thread instance for the group xlat
+ *
+ */
+static int ldap_group_xlat_thread_instantiate(UNUSED void *xlat_inst, void *xlat_thread_inst,
+					      UNUSED xlat_exp_t const *exp, void *uctx)
+{
+	rlm_ldap_t			*inst = talloc_get_type_abort(uctx, rlm_ldap_t);
+	ldap_group_xlat_thread_inst_t	*xt = xlat_thread_inst;
+
+	xt->inst = inst;
+	xt->t = talloc_get_type_abort(module_thread_by_data(inst)->data, rlm_ldap_thread_t);
+
+	return 0;
+}
+
 /** Bootstrap the module
  *
  * Define attributes.
@@ -1488,6 +2724,7 @@ static int mod_bootstrap(void *instance, CONF_SECTION *conf)
 	rlm_ldap_t	*inst = instance;
 	char		buffer[256];
 	char const	*group_attribute;
+	xlat_t const	*xlat;
 
 	inst->name = cf_section_name2(conf);
 	if (!inst->name) inst->name = cf_section_name1(conf);
@@ -1532,6 +2769,11 @@ static int mod_bootstrap(void *instance, CONF_SECTION *conf)
 	xlat_register_legacy(inst, inst->name, ldap_xlat, fr_ldap_escape_func, NULL, 0, XLAT_DEFAULT_BUF_LEN);
 	xlat_register_legacy(inst, "ldap_escape", ldap_escape_xlat, NULL, NULL, 0, XLAT_DEFAULT_BUF_LEN);
 	xlat_register_legacy(inst, "ldap_unescape", ldap_unescape_xlat, NULL, NULL, 0, XLAT_DEFAULT_BUF_LEN);
+
+	snprintf(buffer, sizeof(buffer), "%s_group", inst->name);
+	xlat = xlat_register(inst, buffer, ldap_group_xlat, true);
+	xlat_async_thread_instantiate_set(xlat, ldap_group_xlat_thread_instantiate,
+					  ldap_group_xlat_thread_inst_t, NULL, inst);
 	map_proc_register(inst, inst->name, mod_map_proc, ldap_map_verify, 0);
 
 	return 0;
@@ -1995,6 +3237,22 @@ static int mod_instantiate(void *instance, CONF_SECTION *conf)
 						 ldap_mod_conn_create, NULL, NULL, NULL, NULL);
 	if (!inst->pool) goto error;
 
+	/*
+	 *	Trunk requests carry the query, and copies of
+	 *	its DN, and filter or password.
+	 */
+	inst->trunk_conf.req_pool_headers = 3;
+	inst->trunk_conf.req_pool_size = sizeof(fr_ldap_query_t) + 256;
+	inst->bind_trunk_conf.req_pool_headers = 3;
+	inst->bind_trunk_conf.req_pool_size = sizeof(fr_ldap_query_t) + 256;
+
+	/*
+	 *	A bind changes the identity of the connection, so
+	 *	nothing else can be in progress on it at the same time.
+	 */
+	inst->bind_trunk_conf.max_req_per_conn = 1;
+	inst->bind_trunk_conf.target_req_per_conn = 1;
+
 	fr_ldap_global_config(inst->ldap_debug, inst->tls_random_file);
 
 	return 0;
@@ -2003,6 +3261,66 @@ error:
 	return -1;
 }
 
+/** Allocate the trunks used for searches and binds
+ *
+ */
+static int mod_thread_instantiate(UNUSED CONF_SECTION const *cs, void *instance, fr_event_list_t *el, void *thread)
+{
+	rlm_ldap_t		*inst = talloc_get_type_abort(instance, rlm_ldap_t);
+	rlm_ldap_thread_t	*t = talloc_get_type_abort(thread, rlm_ldap_thread_t);
+
+	t->inst = inst;
+	t->el = el;
+
+#ifdef LDAP_CONTROL_X_SESSION_TRACKING
+	/*
+	 *	Session tracking controls are added to the
+	 *	connections in the pool, so all operations
+	 *	must use the pool.
+	 */
+	if (inst->session_tracking) return 0;
+#endif
+
+	t->trunk = fr_ldap_trunk_alloc(t, el, &inst->handle_config, &inst->trunk_conf,
+				       ldap_trunk_request_complete, ldap_trunk_request_fail, inst->name, false);
+	if (!t->trunk) return -1;
+
+	/*
+	 *	SASL binds may need multiple round trips, so
+	 *	continue to use the pool for them.  eDirectory
+	 *	authorization checks always use simple binds.
+	 */
+#ifdef WITH_EDIR
+	if (inst->user_sasl.mech && !inst->edir_autz) return 0;
+#else
+	if (inst->user_sasl.mech) return 0;
+#endif
+
+	/*
+	 *	Only start connections when the first bind
+	 *	is enqueued, as many instances only authorize.
+	 */
+	t->bind_trunk = fr_ldap_trunk_alloc(t, el, &inst->handle_config, &inst->bind_trunk_conf,
+					    ldap_trunk_request_complete, ldap_trunk_request_fail, inst->name, true);
+	if (!t->bind_trunk) return -1;
+
+	return 0;
+}
+
+static int mod_thread_detach(UNUSED fr_event_list_t *el, void *thread)
+{
+	rlm_ldap_thread_t	*t = talloc_get_type_abort(thread, rlm_ldap_thread_t);
+
+	/*
+	 *	Close the trunk's connections before
+	 *	the event list goes away.
+	 */
+	TALLOC_FREE(t->bind_trunk);
+	TALLOC_FREE(t->trunk);
+
+	return 0;
+}
+
 static int mod_load(void)
 {
 	fr_ldap_init();
@@ -2028,6 +3346,11 @@ module_t rlm_ldap = {
 	.bootstrap	= mod_bootstrap,
 	.instantiate	= mod_instantiate,
 	.detach		= mod_detach,
+
+	.thread_inst_size = sizeof(rlm_ldap_thread_t),
+	.thread_inst_type = "rlm_ldap_thread_t",
+	.thread_instantiate = mod_thread_instantiate,
+	.thread_detach	= mod_thread_detach,
 	.methods = {
 		[MOD_AUTHENTICATE]	= mod_authenticate,
 		[MOD_AUTHORIZE]		= mod_authorize,
@@ -142,6 +142,11 @@ struct ldap_inst_s {
 	fr_pool_t	*pool;				//!< Connection pool instance.
 	fr_ldap_config_t handle_config;			//!< Connection configuration instance.
 
+	fr_trunk_conf_t	trunk_conf;			//!< Configuration of the per-thread trunk used
+							///< for searches.
+	fr_trunk_conf_t	bind_trunk_conf;		//!< Configuration of the per-thread trunk used
+							///< for user binds.
+
 	/*
 	 *	Global config
 	 */
@@ -151,6 +156,41 @@ struct ldap_inst_s {
 	uint32_t	ldap_debug;			//!< Debug flag for the SDK.
 };
 
+/** Thread specific structure to hold the trunks
+ *
+ */
+typedef struct {
+	rlm_ldap_t const	*inst;			//!< Instance of ldap module.
+	fr_event_list_t		*el;			//!< Thread event list for callbacks / timeouts.
+
+	fr_trunk_t		*trunk;			//!< Connections bound as the admin user, used
+							///< for searches.
+	fr_trunk_t		*bind_trunk;		//!< Connections used to check user credentials.
+} rlm_ldap_thread_t;
+
+/** Group memberships from a user object which are being resolved
+ *
+ */
+typedef struct {
+	VALUE_PAIR		*groups;		//!< Memberships to add to the control list.
+	char			*names[LDAP_MAX_CACHEABLE + 1];	//!< Group names to convert to DNs.
+	char			*dns[LDAP_MAX_CACHEABLE + 1];	//!< Group DNs to convert to names.
+	int			dn_idx;			//!< Next DN to convert.
+} rlm_ldap_userobj_groups_t;
+
+/** State of a comparison between the user object's memberships and a group
+ *
+ */
+typedef struct {
+	struct berval		**values;		//!< Membership values from the user object.
+	int			idx;			//!< Next value to compare.
+	bool			check_is_dn;		//!< Whether the group being checked is a DN.
+	char			*check_name;		//!< The name of the group being checked, if it
+							///< was a DN which had to be resolved.
+	char			*resolve;		//!< DN which must be resolved to a name before
+							///< the comparison can continue.
+} rlm_ldap_userobj_check_t;
+
 extern fr_dict_attr_t const *attr_cleartext_password;
 extern fr_dict_attr_t const *attr_crypt_password;
 extern fr_dict_attr_t const *attr_ldap_userdn;
@@ -163,6 +203,13 @@ extern fr_dict_attr_t const *attr_user_name;
 /*
  *	user.c - User lookup functions
  */
+rlm_rcode_t rlm_ldap_find_user_expand(rlm_ldap_t const *inst, REQUEST *request,
+				      char const **base_dn, char base_dn_buff[],
+				      char const **filter, char filter_buff[]);
+
+char const *rlm_ldap_find_user_result(rlm_ldap_t const *inst, REQUEST *request, fr_ldap_connection_t const *conn,
+				      LDAPMessage *result, rlm_rcode_t *rcode);
+
 char const *rlm_ldap_find_user(rlm_ldap_t const *inst, REQUEST *request, fr_ldap_connection_t **pconn,
 			       char const *attrs[], bool force, LDAPMessage **result, rlm_rcode_t *rcode);
 
@@ -174,14 +221,56 @@ void rlm_ldap_check_reply(rlm_ldap_t const *inst, REQUEST *request, fr_ldap_conn
 /*
  *	groups.c - Group membership functions.
  */
+rlm_rcode_t rlm_ldap_cacheable_userobj_parse(rlm_ldap_userobj_groups_t **out, TALLOC_CTX *ctx,
+					     rlm_ldap_t const *inst, REQUEST *request,
+					     fr_ldap_connection_t const *conn, LDAPMessage *entry, char const *attr);
+
+rlm_rcode_t rlm_ldap_cacheable_userobj_dn2name(rlm_ldap_t const *inst, REQUEST *request,
+					       rlm_ldap_userobj_groups_t *groups, fr_ldap_connection_t const *conn,
+					       fr_ldap_rcode_t status, LDAPMessage *result);
+
+rlm_rcode_t rlm_ldap_cacheable_userobj_name2dn_expand(rlm_ldap_t const *inst, REQUEST *request,
+						      rlm_ldap_userobj_groups_t const *groups,
+						      char const **base_dn, char base_dn_buff[], char **filter);
+
+rlm_rcode_t rlm_ldap_cacheable_userobj_name2dn(rlm_ldap_t const *inst, REQUEST *request,
+					       rlm_ldap_userobj_groups_t *groups, fr_ldap_connection_t const *conn,
+					       fr_ldap_rcode_t status, LDAPMessage *result);
+
+void rlm_ldap_cacheable_userobj_merge(rlm_ldap_t const *inst, REQUEST *request, rlm_ldap_userobj_groups_t *groups);
+
 rlm_rcode_t rlm_ldap_cacheable_userobj(rlm_ldap_t const *inst, REQUEST *request, fr_ldap_connection_t **pconn,
 				       LDAPMessage *entry, char const *attr);
 
+rlm_rcode_t rlm_ldap_cacheable_groupobj_expand(rlm_ldap_t const *inst, REQUEST *request,
+					       char const **base_dn, char base_dn_buff[], char filter[]);
+
+rlm_rcode_t rlm_ldap_cacheable_groupobj_result(rlm_ldap_t const *inst, REQUEST *request,
+					       fr_ldap_connection_t const *conn,
+					       fr_ldap_rcode_t status, LDAPMessage *result);
+
 rlm_rcode_t rlm_ldap_cacheable_groupobj(rlm_ldap_t const *inst, REQUEST *request, fr_ldap_connection_t **pconn);
 
+rlm_rcode_t rlm_ldap_check_groupobj_dynamic_expand(rlm_ldap_t const *inst, REQUEST *request, VALUE_PAIR const *check,
+						   char const **base_dn, char base_dn_buff[], char filter[]);
+
+rlm_rcode_t rlm_ldap_check_groupobj_dynamic_result(REQUEST *request, char const *base_dn, fr_ldap_rcode_t status);
+
 rlm_rcode_t rlm_ldap_check_groupobj_dynamic(rlm_ldap_t const *inst, REQUEST *request, fr_ldap_connection_t **pconn,
 					    VALUE_PAIR *check);
 
+rlm_rcode_t rlm_ldap_check_userobj_dynamic_result(rlm_ldap_userobj_check_t **out, TALLOC_CTX *ctx,
+						  rlm_ldap_t const *inst, REQUEST *request,
+						  fr_ldap_connection_t const *conn,
+						  fr_ldap_rcode_t status, LDAPMessage *result, VALUE_PAIR const *check);
+
+rlm_rcode_t rlm_ldap_check_userobj_next(rlm_ldap_t const *inst, REQUEST *request,
+					rlm_ldap_userobj_check_t *uc, VALUE_PAIR const *check);
+
+rlm_rcode_t rlm_ldap_check_userobj_resolved(rlm_ldap_t const *inst, REQUEST *request,
+					    rlm_ldap_userobj_check_t *uc, VALUE_PAIR const *check,
+					    fr_ldap_connection_t const *conn, fr_ldap_rcode_t status, LDAPMessage *result);
+
 rlm_rcode_t rlm_ldap_check_userobj_dynamic(rlm_ldap_t const *inst, REQUEST *request, fr_ldap_connection_t **pconn,
 					   char const *dn, VALUE_PAIR *check);
 
@@ -36,6 +36,120 @@ USES_APPLE_DEPRECATED_API
 
 #include "rlm_ldap.h"
 
+/** Expand the base DN and filter used to search for user objects
+ *
+ * @param[in] inst		rlm_ldap configuration.
+ * @param[in] request		Current request.
+ * @param[out] base_dn		Where to write a pointer to the expanded base DN.
+ * @param[in] base_dn_buff	Buffer to expand the base DN into.  Must be at least
+ *				#LDAP_MAX_DN_STR_LEN bytes.
+ * @param[out] filter		Where to write a pointer to the expanded filter.
+ *				Will be NULL if no user filter is configured.
+ * @param[in] filter_buff	Buffer to expand the filter into.  Must be at least
+ *				#LDAP_MAX_FILTER_STR_LEN bytes.
+ * @return
+ *	- #RLM_MODULE_OK on success.
+ *	- #RLM_MODULE_INVALID if expansion failed.
+ */
+rlm_rcode_t rlm_ldap_find_user_expand(rlm_ldap_t const *inst, REQUEST *request,
+				      char const **base_dn, char base_dn_buff[],
+				      char const **filter, char filter_buff[])
+{
+	*filter = NULL;
+
+	if (inst->userobj_filter) {
+		if (tmpl_expand(filter, filter_buff, LDAP_MAX_FILTER_STR_LEN, request, inst->userobj_filter,
+				fr_ldap_escape_func, NULL) < 0) {
+			REDEBUG("Unable to create filter");
+			return RLM_MODULE_INVALID;
+		}
+	}
+
+	if (tmpl_expand(base_dn, base_dn_buff, LDAP_MAX_DN_STR_LEN, request,
+			inst->userobj_base_dn, fr_ldap_escape_func, NULL) < 0) {
+		REDEBUG("Unable to create base_dn");
+		return RLM_MODULE_INVALID;
+	}
+
+	return RLM_MODULE_OK;
+}
+
+/** Extract the DN of the user object from the results of a user search
+ *
+ * Adds the DN to the control list as LDAP-UserDN.
+ *
+ * @param[in] inst	rlm_ldap configuration.
+ * @param[in] request	Current request.
+ * @param[in] conn	Used to parse the result.
+ * @param[in] result	of the user search, not freed.
+ * @param[out] rcode	The status of the operation, one of the RLM_MODULE_* codes.
+ * @return The user's DN or NULL on error.
+ */
+char const *rlm_ldap_find_user_result(rlm_ldap_t const *inst, REQUEST *request, fr_ldap_connection_t const *conn,
+				      LDAPMessage *result, rlm_rcode_t *rcode)
+{
+	VALUE_PAIR	*vp;
+	LDAPMessage	*entry;
+	int		ldap_errno;
+	int		cnt;
+	char		*dn;
+
+	*rcode = RLM_MODULE_FAIL;
+
+	/*
+	 *	Forbid the use of unsorted search results that
+	 *	contain multiple entries, as it's a potential
+	 *	security issue, and likely non deterministic.
+	 */
+	if (!inst->userobj_sort_ctrl) {
+		cnt = ldap_count_entries(conn->handle, result);
+		if (cnt > 1) {
+			REDEBUG("Ambiguous search result, returned %i unsorted entries (should return 1 or 0).  "
+				"Enable sorting, or specify a more restrictive base_dn, filter or scope", cnt);
+			REDEBUG("The following entries were returned:");
+			RINDENT();
+			for (entry = ldap_first_entry(conn->handle, result);
+			     entry;
+			     entry = ldap_next_entry(conn->handle, entry)) {
+				dn = ldap_get_dn(conn->handle, entry);
+				REDEBUG("%s", dn);
+				ldap_memfree(dn);
+			}
+			REXDENT();
+			*rcode = RLM_MODULE_INVALID;
+			return NULL;
+		}
+	}
+
+	entry = ldap_first_entry(conn->handle, result);
+	if (!entry) {
+		ldap_get_option(conn->handle, LDAP_OPT_RESULT_CODE, &ldap_errno);
+		REDEBUG("Failed retrieving entry: %s",
+			ldap_err2string(ldap_errno));
+
+		return NULL;
+	}
+
+	dn = ldap_get_dn(conn->handle, entry);
+	if (!dn) {
+		ldap_get_option(conn->handle, LDAP_OPT_RESULT_CODE, &ldap_errno);
+		REDEBUG("Retrieving object DN from entry failed: %s", ldap_err2string(ldap_errno));
+
+		return NULL;
+	}
+	fr_ldap_util_normalise_dn(dn, dn);
+
+	RDEBUG2("User object found at DN \"%s\"", dn);
+
+	MEM(pair_update_control(&vp, attr_ldap_userdn) >= 0);
+	fr_pair_value_strdup(vp, dn);
+	*rcode = RLM_MODULE_OK;
+
+	ldap_memfree(dn);
+
+	return vp->vp_strvalue;
+}
+
 /** Retrieve the DN of a user object
  *
  * Retrieves the DN of a user and adds it to the control list as LDAP-UserDN. Will also retrieve any
@@ -61,10 +175,8 @@ char const *rlm_ldap_find_user(rlm_ldap_t const *inst, REQUEST *request, fr_ldap
 
 	fr_ldap_rcode_t	status;
 	VALUE_PAIR	*vp = NULL;
-	LDAPMessage	*tmp_msg = NULL, *entry = NULL;
-	int		ldap_errno;
-	int		cnt;
-	char		*dn = NULL;
+	LDAPMessage	*tmp_msg = NULL;
+	char const	*dn = NULL;
 	char const	*filter = NULL;
 	char	    	filter_buff[LDAP_MAX_FILTER_STR_LEN];
 	char const	*base_dn;
@@ -90,7 +202,7 @@ char const *rlm_ldap_find_user(rlm_ldap_t const *inst, REQUEST *request, fr_ldap
 	 *	If the caller isn't looking for the result we can just return the current userdn value.
 	 */
 	if (!force) {
-		vp = fr_pair_find_by_da(request->control, attr_ldap_userdn, TAG_ANY);
+		vp = fr_pair_list_find_by_da(&request->control, attr_ldap_userdn, TAG_ANY);
 		if (vp) {
 			RDEBUG2("Using user DN from request \"%pV\"", &vp->data);
 			*rcode = RLM_MODULE_OK;
@@ -115,23 +227,8 @@ char const *rlm_ldap_find_user(rlm_ldap_t const *inst, REQUEST *request, fr_ldap
 		(*pconn)->rebound = false;
 	}
 
-	if (inst->userobj_filter) {
-		if (tmpl_expand(&filter, filter_buff, sizeof(filter_buff), request, inst->userobj_filter,
-				fr_ldap_escape_func, NULL) < 0) {
-			REDEBUG("Unable to create filter");
-			*rcode = RLM_MODULE_INVALID;
-
-			return NULL;
-		}
-	}
-
-	if (tmpl_expand(&base_dn, base_dn_buff, sizeof(base_dn_buff), request,
-			inst->userobj_base_dn, fr_ldap_escape_func, NULL) < 0) {
-		REDEBUG("Unable to create base_dn");
-		*rcode = RLM_MODULE_INVALID;
-
-		return NULL;
-	}
+	*rcode = rlm_ldap_find_user_expand(inst, request, &base_dn, base_dn_buff, &filter, filter_buff);
+	if (*rcode != RLM_MODULE_OK) return NULL;
 
 	status = fr_ldap_search(result, request, pconn, base_dn,
 				inst->userobj_scope, filter, attrs, serverctrls, NULL);
@@ -151,64 +248,14 @@ char const *rlm_ldap_find_user(rlm_ldap_t const *inst, REQUEST *request, fr_ldap
 
 	fr_assert(*pconn);
 
-	/*
-	 *	Forbid the use of unsorted search results that
-	 *	contain multiple entries, as it's a potential
-	 *	security issue, and likely non deterministic.
-	 */
-	if (!inst->userobj_sort_ctrl) {
-		cnt = ldap_count_entries((*pconn)->handle, *result);
-		if (cnt > 1) {
-			REDEBUG("Ambiguous search result, returned %i unsorted entries (should return 1 or 0).  "
-				"Enable sorting, or specify a more restrictive base_dn, filter or scope", cnt);
-			REDEBUG("The following entries were returned:");
-			RINDENT();
-			for (entry = ldap_first_entry((*pconn)->handle, *result);
-			     entry;
-			     entry = ldap_next_entry((*pconn)->handle, entry)) {
-				dn = ldap_get_dn((*pconn)->handle, entry);
-				REDEBUG("%s", dn);
-				ldap_memfree(dn);
-			}
-			REXDENT();
-			*rcode = RLM_MODULE_INVALID;
-			goto finish;
-		}
-	}
-
-	entry = ldap_first_entry((*pconn)->handle, *result);
-	if (!entry) {
-		ldap_get_option((*pconn)->handle, LDAP_OPT_RESULT_CODE, &ldap_errno);
-		REDEBUG("Failed retrieving entry: %s",
-			ldap_err2string(ldap_errno));
-
-		goto finish;
-	}
-
-	dn = ldap_get_dn((*pconn)->handle, entry);
-	if (!dn) {
-		ldap_get_option((*pconn)->handle, LDAP_OPT_RESULT_CODE, &ldap_errno);
-		REDEBUG("Retrieving object DN from entry failed: %s", ldap_err2string(ldap_errno));
-
-		goto finish;
-	}
-	fr_ldap_util_normalise_dn(dn, dn);
-
-	RDEBUG2("User object found at DN \"%s\"", dn);
-
-	MEM(pair_update_control(&vp, attr_ldap_userdn) >= 0);
-	fr_pair_value_strdup(vp, dn);
-	*rcode = RLM_MODULE_OK;
-
-	ldap_memfree(dn);
+	dn = rlm_ldap_find_user_result(inst, request, *pconn, *result, rcode);
 
-finish:
 	if ((freeit || (*rcode != RLM_MODULE_OK)) && *result) {
 		ldap_msgfree(*result);
 		*result = NULL;
 	}
 
-	return vp ? vp->vp_strvalue : NULL;
+	return dn;
 }
 
 /** Check for presence of access attribute in result
@@ -267,12 +314,12 @@ void rlm_ldap_check_reply(rlm_ldap_t const *inst, REQUEST *request, fr_ldap_conn
 	*/
 	if (!inst->expect_password || !RDEBUG_ENABLED2) return;
 
-	if (!fr_pair_find_by_da(request->control, attr_cleartext_password, TAG_ANY) &&
-	    !fr_pair_find_by_da(request->control, attr_nt_password, TAG_ANY) &&
-	    !fr_pair_find_by_da(request->control, attr_user_password, TAG_ANY) &&
-	    !fr_pair_find_by_da(request->control, attr_password_with_header, TAG_ANY) &&
-	    !fr_pair_find_by_da(request->control, attr_crypt_password, TAG_ANY)) {
-		switch (conn->directory->type) {
+	if (!fr_pair_list_find_by_da(&request->control, attr_cleartext_password, TAG_ANY) &&
+	    !fr_pair_list_find_by_da(&request->control, attr_nt_password, TAG_ANY) &&
+	    !fr_pair_list_find_by_da(&request->control, attr_user_password, TAG_ANY) &&
+	    !fr_pair_list_find_by_da(&request->control, attr_password_with_header, TAG_ANY) &&
+	    !fr_pair_list_find_by_da(&request->control, attr_crypt_password, TAG_ANY)) {
+		switch (conn->directory ? conn->directory->type : FR_LDAP_DIRECTORY_UNKNOWN) {
 		case FR_LDAP_DIRECTORY_ACTIVE_DIRECTORY:
 			RWDEBUG2("!!! Found map between LDAP attribute and a FreeRADIUS password attribute");
 			RWDEBUG2("!!! Active Directory does not allow passwords to be read via LDAP");
@@ -103,6 +103,8 @@ typedef struct {
 		char const		*group_str;		//!< Group to set on new files.
 		gid_t			group;			//!< Resolved gid.
 		exfile_t		*ef;			//!< Exclusive file access handle.
+		exfile_async_conf_t	async;			//!< Writer thread configuration.
+		bool			stats;			//!< Add writer thread statistics to the request.
 		bool			escape;			//!< Do filename escaping, yes / no.
 		xlat_escape_legacy_t		escape_func;		//!< Escape function.
 	} file;
@@ -128,6 +130,8 @@ static const CONF_PARSER file_config[] = {
 	{ FR_CONF_OFFSET("permissions", FR_TYPE_UINT32, rlm_linelog_t, file.permissions), .dflt = "0600" },
 	{ FR_CONF_OFFSET("group", FR_TYPE_STRING, rlm_linelog_t, file.group_str) },
 	{ FR_CONF_OFFSET("escape_filenames", FR_TYPE_BOOL, rlm_linelog_t, file.escape), .dflt = "no" },
+	{ FR_CONF_OFFSET("async", FR_TYPE_SUBSECTION, rlm_linelog_t, file.async), .subcs = (void const *) exfile_async_config },
+	{ FR_CONF_OFFSET("add_stats", FR_TYPE_BOOL, rlm_linelog_t, file.stats), .dflt = "no" },
 	CONF_PARSER_TERMINATOR
 };
 
@@ -329,6 +333,11 @@ static int mod_instantiate(void *instance, CONF_SECTION *conf)
 			return -1;
 		}
 
+		if (inst->file.async.enabled && (exfile_async_start(inst->file.ef, &inst->file.async) < 0)) {
+			cf_log_perr(conf, "Failed starting writer thread");
+			return -1;
+		}
+
 		if (inst->file.group_str) {
 			char *endptr;
 
@@ -652,6 +661,23 @@ build_vector:
 			*p = '/';
 		}
 
+		/*
+		 *	Copy the data into the writer thread's queue
+		 *	and carry on.
+		 */
+		if (inst->file.async.enabled) {
+			if (exfile_write(inst->file.ef, request, path, inst->file.permissions,
+					 inst->file.group_str ? inst->file.group : (gid_t)-1,
+					 vector_p, vector_len) < 0) {
+				RPERROR("Failed writing to \"%s\"", path);
+				rcode = RLM_MODULE_FAIL;
+				goto finish;
+			}
+
+			if (inst->file.stats) exfile_stats_to_pairs(request, inst->file.ef);
+			break;
+		}
+
 		fd = exfile_open(inst->file.ef, request, path, inst->file.permissions);
 		if (fd < 0) {
 			RERROR("Failed to open %s: %s", path, fr_syserror(errno));
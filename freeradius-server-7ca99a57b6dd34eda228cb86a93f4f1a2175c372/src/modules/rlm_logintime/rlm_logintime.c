@@ -79,7 +79,7 @@ fr_dict_attr_autoload_t rlm_logintime_dict_attr[] = {
  *      Compare the current time to a range.
  */
 static int timecmp(UNUSED void *instance, REQUEST *req, UNUSED VALUE_PAIR *request, VALUE_PAIR *check,
-		   UNUSED VALUE_PAIR *check_pairs, UNUSED VALUE_PAIR **reply_pairs)
+		   UNUSED VALUE_PAIR *check_pairs, UNUSED fr_pair_list_t *reply_pairs)
 {
 	/*
 	 *      If there's a request, use that timestamp.
@@ -95,7 +95,7 @@ static int timecmp(UNUSED void *instance, REQUEST *req, UNUSED VALUE_PAIR *reque
  */
 static int time_of_day(UNUSED void *instance, REQUEST *request,
 		       UNUSED VALUE_PAIR *request_pairs, VALUE_PAIR *check,
-		       UNUSED VALUE_PAIR *check_pairs, UNUSED VALUE_PAIR **reply_pairs)
+		       UNUSED VALUE_PAIR *check_pairs, UNUSED fr_pair_list_t *reply_pairs)
 {
 	int		scan;
 	int		hhmmss, when;
@@ -157,7 +157,7 @@ static rlm_rcode_t CC_HINT(nonnull) mod_authorize(module_ctx_t const *mctx, REQU
 	VALUE_PAIR		*ends, *vp;
 	int32_t			left;
 
-	ends = fr_pair_find_by_da(request->control, attr_login_time, TAG_ANY);
+	ends = fr_pair_list_find_by_da(&request->control, attr_login_time, TAG_ANY);
 	if (!ends) return RLM_MODULE_NOOP;
 
 	/*
@@ -210,14 +210,14 @@ static int mod_instantiate(void *instance, CONF_SECTION *conf)
 	return 0;
 }
 
-static int mruby_vps_to_array(REQUEST *request, mrb_value *out, mrb_state *mrb, VALUE_PAIR **vps)
+static int mruby_vps_to_array(REQUEST *request, mrb_value *out, mrb_state *mrb, fr_pair_list_t *vps)
 {
 	mrb_value	res;
 	VALUE_PAIR	*vp;
 	fr_cursor_t	cursor;
 
 	res = mrb_ary_new(mrb);
-	for (vp = fr_cursor_init(&cursor, vps); vp; vp = fr_cursor_next(&cursor)) {
+	for (vp = fr_pair_list_cursor_init(&cursor, vps); vp; vp = fr_cursor_next(&cursor)) {
 		mrb_value	tmp, key, val, to_cast;
 		char		*str;
 
@@ -309,7 +309,7 @@ static int mruby_vps_to_array(REQUEST *request, mrb_value *out, mrb_state *mrb,
 	return 0;
 }
 
-static void add_vp_tuple(TALLOC_CTX *ctx, REQUEST *request, VALUE_PAIR **vps, mrb_state *mrb, mrb_value value, char const *function_name)
+static void add_vp_tuple(TALLOC_CTX *ctx, REQUEST *request, fr_pair_list_t *vps, mrb_state *mrb, mrb_value value, char const *function_name)
 {
 	int i;
 
@@ -391,7 +391,7 @@ static void add_vp_tuple(TALLOC_CTX *ctx, REQUEST *request, VALUE_PAIR **vps, mr
 }
 
 static inline int mruby_set_vps(REQUEST *request, mrb_state *mrb, mrb_value mruby_request,
-				char const *list_name, VALUE_PAIR **vps)
+				char const *list_name, fr_pair_list_t *vps)
 {
 	mrb_value res;
 
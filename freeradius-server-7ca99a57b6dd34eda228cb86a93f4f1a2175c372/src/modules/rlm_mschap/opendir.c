@@ -239,7 +239,7 @@ rlm_rcode_t od_mschap_auth(REQUEST *request, VALUE_PAIR *challenge, VALUE_PAIR *
 	unsigned int t;
 #endif
 
-	response = fr_pair_find_by_da(request->packet->vps, attr_ms_chap2_response, TAG_ANY);
+	response = fr_pair_list_find_by_da(&request->packet->vps, attr_ms_chap2_response, TAG_ANY);
 
 	username_string = talloc_array(request, char, usernamepair->vp_length + 1);
 	if (!username_string) return RLM_MODULE_FAIL;
@@ -512,7 +512,7 @@ static int mod_detach (void *instance) {
 }
 
 static void result_add(TALLOC_CTX *ctx, rlm_passwd_t const *inst, REQUEST *request,
-		       VALUE_PAIR **vps, struct mypasswd * pw, char when, char const *listname)
+		       fr_pair_list_t *vps, struct mypasswd * pw, char when, char const *listname)
 {
 	uint32_t i;
 	VALUE_PAIR *vp;
@@ -522,8 +522,9 @@ static void result_add(TALLOC_CTX *ctx, rlm_passwd_t const *inst, REQUEST *reque
 		    (i != inst->key_field) && inst->pwd_fmt->listflag[i] == when) {
 			if (!inst->ignore_empty || pw->field[i][0] != 0 ) { /* if value in key/value pair is not empty */
 				vp = fr_pair_make(ctx, request->dict,
-						  vps, inst->pwd_fmt->field[i], pw->field[i], T_OP_EQ);
+						  NULL, inst->pwd_fmt->field[i], pw->field[i], T_OP_EQ);
 				if (vp) {
+					fr_pair_list_append(vps, vp);
 					RDEBUG2("Added %s: '%s' to %s ", inst->pwd_fmt->field[i], pw->field[i], listname);
 				}
 			} else
@@ -542,7 +543,7 @@ static rlm_rcode_t CC_HINT(nonnull) mod_passwd_map(module_ctx_t const *mctx, REQ
 	fr_cursor_t		cursor;
 	int			found = 0;
 
-	key = fr_pair_find_by_da(request->packet->vps, inst->keyattr, TAG_ANY);
+	key = fr_pair_list_find_by_da(&request->packet->vps, inst->keyattr, TAG_ANY);
 	if (!key) return RLM_MODULE_NOTFOUND;
 
 	for (i = fr_cursor_iter_by_da_init(&cursor, &key, inst->keyattr);
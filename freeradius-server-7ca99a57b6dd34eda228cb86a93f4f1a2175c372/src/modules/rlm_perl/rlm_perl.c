@@ -669,18 +669,20 @@ static void perl_vp_to_svpvn_element(REQUEST *request, AV *av, VALUE_PAIR const
  *  	Example for this is Cisco-AVPair that holds multiple values.
  *  	Which will be available as array_ref in $RAD_REQUEST{'Cisco-AVPair'}
  */
-static void perl_store_vps(UNUSED TALLOC_CTX *ctx, REQUEST *request, VALUE_PAIR **vps, HV *rad_hv,
+static void perl_store_vps(UNUSED TALLOC_CTX *ctx, REQUEST *request, fr_pair_list_t *vps, HV *rad_hv,
 			   const char *hash_name, const char *list_name)
 {
-	VALUE_PAIR *vp;
+	VALUE_PAIR *vp, *sorted;
 
 	hv_undef(rad_hv);
 
 	fr_cursor_t cursor;
 
 	RINDENT();
-	fr_pair_list_sort(vps, fr_pair_cmp_by_da_tag);
-	for (vp = fr_cursor_init(&cursor, vps);
+	sorted = fr_pair_list_detach(vps);
+	fr_pair_list_sort(&sorted, fr_pair_cmp_by_da_tag);
+	fr_pair_list_append(vps, sorted);
+	for (vp = fr_pair_list_cursor_init(&cursor, vps);
 	     vp;
 	     vp = fr_cursor_next(&cursor)) {
 		VALUE_PAIR *next;
@@ -922,26 +924,26 @@ static int do_perl(void *instance, REQUEST *request, char const *function_name)
 
 		vp = NULL;
 		if ((get_hv_content(request->packet, request, rad_request_hv, &vp, "RAD_REQUEST", "request")) == 0) {
-			fr_pair_list_free(&request->packet->vps);
-			request->packet->vps = vp;
+			fr_pair_list_clear(&request->packet->vps);
+			fr_pair_list_append(&request->packet->vps, vp);
 			vp = NULL;
 		}
 
 		if ((get_hv_content(request->reply, request, rad_reply_hv, &vp, "RAD_REPLY", "reply")) == 0) {
-			fr_pair_list_free(&request->reply->vps);
-			request->reply->vps = vp;
+			fr_pair_list_clear(&request->reply->vps);
+			fr_pair_list_append(&request->reply->vps, vp);
 			vp = NULL;
 		}
 
 		if ((get_hv_content(request, request, rad_config_hv, &vp, "RAD_CONFIG", "control")) == 0) {
-			fr_pair_list_free(&request->control);
-			request->control = vp;
+			fr_pair_list_clear(&request->control);
+			fr_pair_list_append(&request->control, vp);
 			vp = NULL;
 		}
 
 		if ((get_hv_content(request->state_ctx, request, rad_state_hv, &vp, "RAD_STATE", "session-state")) == 0) {
-			fr_pair_list_free(&request->state);
-			request->state = vp;
+			fr_pair_list_clear(&request->state);
+			fr_pair_list_append(&request->state, vp);
 			vp = NULL;
 		}
 	}
@@ -969,7 +971,7 @@ static rlm_rcode_t CC_HINT(nonnull) mod_accounting(module_ctx_t const *mctx, REQ
 	VALUE_PAIR		*pair;
 	int 			acct_status_type = 0;
 
-	pair = fr_pair_find_by_da(request->packet->vps, attr_acct_status_type, TAG_ANY);
+	pair = fr_pair_list_find_by_da(&request->packet->vps, attr_acct_status_type, TAG_ANY);
 	if (pair != NULL) {
 		acct_status_type = pair->vp_uint32;
 	} else {
@@ -35,6 +35,7 @@ RCSID("$Id$")
 #include <freeradius-devel/server/pairmove.h>
 #include <freeradius-devel/util/debug.h>
 #include <freeradius-devel/util/lsan.h>
+#include <freeradius-devel/util/swiss.h>
 
 #include <Python.h>
 #include <frameobject.h> /* Python header not pulled in by default. */
@@ -68,7 +69,13 @@ typedef struct {
 #if PY_MAJOR_VERSION == 2
 	bool		single_interpreter_mode;//!< Whether or not to create interpreters per module
 						//!< instance.
+#else
+	bool		per_thread_interpreter;	//!< Create an interpreter with its own GIL for each
+						//!< worker thread, instead of one for the instance.
+	char		*path;			//!< Python path for per-thread interpreters.
 #endif
+	bool		pass_dict;		//!< Pass the request to functions as a dict of
+						//!< attribute names to values.
 
 	python_func_def_t
 	instantiate,
@@ -83,13 +90,41 @@ typedef struct {
 						//!< made available to the python script.
 } rlm_python_t;
 
+/** A cached Python string for an attribute name
+ *
+ */
+typedef struct {
+	fr_dict_attr_t const	*da;		//!< Attribute the name is for.
+	PyObject		*name;		//!< Python string holding the attribute name.
+} python_attr_name_t;
+
 /** Tracks a python module inst/thread state pair
  *
  * Multiple instances of python create multiple interpreters and each
  * thread must have a PyThreadState per interpreter, to track execution.
+ *
+ * With per_thread_interpreter, the thread state is instead the main
+ * thread state of an interpreter which only this thread uses, and the
+ * functions are loaded into that interpreter.
  */
 typedef struct {
-	PyThreadState	*state;			//!< Module instance/thread specific state.
+	rlm_python_t const	*inst;		//!< Instance this thread state belongs to.
+	PyThreadState		*state;		//!< Module instance/thread specific state.
+	bool			own_interpreter; //!< Whether state is for an interpreter created
+						//!< for this thread.
+	PyObject		*module;	//!< radiusd module in this thread's own interpreter.
+
+	python_func_def_t
+	instantiate,
+	authorize,
+	authenticate,
+	preacct,
+	accounting,
+	post_auth,
+	detach;					//!< Functions called by this thread.
+
+	fr_swiss_table_t	*attr_names;	//!< Attribute names as Python strings, used when
+						//!< building dicts for pass_dict.
 } rlm_python_thread_t;
 
 static void		*python_dlhandle;
@@ -161,7 +196,10 @@ static CONF_PARSER module_config[] = {
 
 #if PY_MAJOR_VERSION == 2
 	{ FR_CONF_OFFSET("cext_compat", FR_TYPE_BOOL, rlm_python_t, single_interpreter_mode), .dflt = "no" },
+#else
+	{ FR_CONF_OFFSET("per_thread_interpreter", FR_TYPE_BOOL, rlm_python_t, per_thread_interpreter), .dflt = "no" },
 #endif
+	{ FR_CONF_OFFSET("pass_dict", FR_TYPE_BOOL, rlm_python_t, pass_dict), .dflt = "no" },
 
 	CONF_PARSER_TERMINATOR
 };
@@ -250,13 +288,24 @@ static void python_error_log(const rlm_python_t *inst, REQUEST *request)
 
 		for(; ptb != NULL; ptb = ptb->tb_next, fnum++) {
 			PyFrameObject *cur_frame = ptb->tb_frame;
+			PyCodeObject *code;
 
+			/*
+			 *	Frames are opaque as of Python 3.11
+			 */
+#if PY_VERSION_HEX >= 0x03090000
+			code = PyFrame_GetCode(cur_frame);
+#else
+			code = cur_frame->f_code;
+			Py_INCREF(code);
+#endif
 			ROPTIONAL(RERROR, ERROR, "[%ld] %s:%d at %s()",
 				fnum,
-				PyUnicode_AsUTF8(cur_frame->f_code->co_filename),
+				PyUnicode_AsUTF8(code->co_filename),
 				PyFrame_GetLineNumber(cur_frame),
-				PyUnicode_AsUTF8(cur_frame->f_code->co_name)
+				PyUnicode_AsUTF8(code->co_name)
 			);
+			Py_DECREF(code);
 		}
 	}
 
@@ -268,14 +317,97 @@ failed:
 	Py_XDECREF(p_traceback);
 }
 
+/** Create a pair from strings returned by a Python function, and move it into a list
+ *
+ */
+static void mod_vp_add(TALLOC_CTX *ctx, rlm_python_t const *inst, REQUEST *request, fr_pair_list_t *vps,
+		       char const *s1, fr_token_t op, char const *s2, char const *funcname, char const *list_name)
+{
+	tmpl_t		*dst;
+	VALUE_PAIR	*vp;
+	REQUEST		*current = request;
+
+	if (tmpl_afrom_attr_str(ctx, NULL, &dst, s1,
+				&(tmpl_rules_t){
+					.dict_def = request->dict,
+					.list_def = PAIR_LIST_REPLY
+				}) <= 0) {
+		ERROR("%s - Failed to find attribute %s:%s", funcname, list_name, s1);
+		return;
+	}
+
+	if (radius_request(&current, tmpl_request(dst)) < 0) {
+		ERROR("%s - Attribute name %s:%s refers to outer request but not in a tunnel, skipping...",
+		      funcname, list_name, s1);
+		talloc_free(dst);
+		return;
+	}
+
+	MEM(vp = fr_pair_afrom_da(ctx, tmpl_da(dst)));
+	talloc_free(dst);
+
+	vp->op = op;
+	if (fr_pair_value_from_str(vp, s2, -1, '\0', false) < 0) {
+		DEBUG("%s - Failed: '%s:%s' %s '%s'", funcname, list_name, s1,
+		      fr_table_str_by_value(fr_tokens_table, op, "="), s2);
+	} else {
+		DEBUG("%s - '%s:%s' %s '%s'", funcname, list_name, s1,
+		      fr_table_str_by_value(fr_tokens_table, op, "="), s2);
+	}
+
+	radius_pairmove(current, vps, vp, false);
+}
+
+/** Add pairs from a dict of attribute names to values
+ *
+ * A str value is added with '=', as with the tuple form.  A list or
+ * tuple of str values adds every one of them with '+='.
+ */
+static void mod_vpdict(TALLOC_CTX *ctx, rlm_python_t const *inst, REQUEST *request,
+		       fr_pair_list_t *vps, PyObject *p_value, char const *funcname, char const *list_name)
+{
+	PyObject	*p_key, *p_item;
+	Py_ssize_t	pos = 0;
+
+	while (PyDict_Next(p_value, &pos, &p_key, &p_item)) {
+		Py_ssize_t	i, len;
+		char const	*s1;
+
+		if (!PyUnicode_CheckExact(p_key)) {
+			ERROR("%s - Key of %s is not a str", funcname, list_name);
+			continue;
+		}
+		s1 = PyUnicode_AsUTF8(p_key);
+
+		if (PyUnicode_CheckExact(p_item)) {
+			mod_vp_add(ctx, inst, request, vps, s1, T_OP_EQ, PyUnicode_AsUTF8(p_item), funcname, list_name);
+			continue;
+		}
+
+		if (!PyList_CheckExact(p_item) && !PyTuple_CheckExact(p_item)) {
+			ERROR("%s - Value of %s:%s must be a str, or a list of str", funcname, list_name, s1);
+			continue;
+		}
+
+		len = PySequence_Fast_GET_SIZE(p_item);
+		for (i = 0; i < len; i++) {
+			PyObject *p_str = PySequence_Fast_GET_ITEM(p_item, i);
+
+			if (!PyUnicode_CheckExact(p_str)) {
+				ERROR("%s - Value %zd of %s:%s is not a str", funcname, i, list_name, s1);
+				continue;
+			}
+
+			mod_vp_add(ctx, inst, request, vps, s1, T_OP_ADD, PyUnicode_AsUTF8(p_str), funcname, list_name);
+		}
+	}
+}
+
 static void mod_vptuple(TALLOC_CTX *ctx, rlm_python_t const *inst, REQUEST *request,
-			VALUE_PAIR **vps, PyObject *p_value, char const *funcname, char const *list_name)
+			fr_pair_list_t *vps, PyObject *p_value, char const *funcname, char const *list_name)
 {
 	int		i;
 	Py_ssize_t	tuple_len;
-	tmpl_t	*dst;
-	VALUE_PAIR	*vp;
-	REQUEST		*current = request;
 
 	/*
 	 *	If the Python function gave us None for the tuple,
@@ -283,6 +415,11 @@ static void mod_vptuple(TALLOC_CTX *ctx, rlm_python_t const *inst, REQUEST *requ
 	 */
 	if (p_value == Py_None) return;
 
+	if (PyDict_CheckExact(p_value)) {
+		mod_vpdict(ctx, inst, request, vps, p_value, funcname, list_name);
+		return;
+	}
+
 	if (!PyTuple_CheckExact(p_value)) {
 		ERROR("%s - non-tuple passed to %s", funcname, list_name);
 		return;
@@ -348,57 +485,19 @@ static void mod_vptuple(TALLOC_CTX *ctx, rlm_python_t const *inst, REQUEST *requ
 			}
 		}
 
-		if (tmpl_afrom_attr_str(ctx, NULL, &dst, s1,
-					&(tmpl_rules_t){
-						.dict_def = request->dict,
-						.list_def = PAIR_LIST_REPLY
-					}) <= 0) {
-			ERROR("%s - Failed to find attribute %s:%s", funcname, list_name, s1);
-			continue;
-		}
-
-		if (radius_request(&current, tmpl_request(dst)) < 0) {
-			ERROR("%s - Attribute name %s:%s refers to outer request but not in a tunnel, skipping...",
-			      funcname, list_name, s1);
-			talloc_free(dst);
-			continue;
-		}
-
-		MEM(vp = fr_pair_afrom_da(ctx, tmpl_da(dst)));
-		talloc_free(dst);
-
-		vp->op = op;
-		if (fr_pair_value_from_str(vp, s2, -1, '\0', false) < 0) {
-			DEBUG("%s - Failed: '%s:%s' %s '%s'", funcname, list_name, s1,
-			      fr_table_str_by_value(fr_tokens_table, op, "="), s2);
-		} else {
-			DEBUG("%s - '%s:%s' %s '%s'", funcname, list_name, s1,
-			      fr_table_str_by_value(fr_tokens_table, op, "="), s2);
-		}
-
-		radius_pairmove(current, vps, vp, false);
+		mod_vp_add(ctx, inst, request, vps, s1, op, s2, funcname, list_name);
 	}
 }
 
 
-/*
- *	This is the core Python function that the others wrap around.
- *	Pass the value-pair print strings in a tuple.
+/** Convert the value of a pair to a Python object
+ *
+ * @return a new reference, or NULL on error.
  */
-static int mod_populate_vptuple(rlm_python_t const *inst, REQUEST *request, PyObject *pp, VALUE_PAIR *vp)
+static PyObject *python_value_from_vp(rlm_python_t const *inst, REQUEST *request, VALUE_PAIR *vp)
 {
-	PyObject *attribute = NULL;
 	PyObject *value = NULL;
 
-	/* Look at the fr_pair_fprint_name? */
-	if (vp->da->flags.has_tag) {
-		attribute = PyUnicode_FromFormat("%s:%d", vp->da->name, vp->tag);
-	} else {
-		attribute = PyUnicode_FromString(vp->da->name);
-	}
-
-	if (!attribute) return -1;
-
 	switch (vp->vp_type) {
 	case FR_TYPE_STRING:
 		value = PyUnicode_FromStringAndSize(vp->vp_strvalue, vp->vp_length);
@@ -476,13 +575,38 @@ static int mod_populate_vptuple(rlm_python_t const *inst, REQUEST *request, PyOb
 
 	case FR_TYPE_NON_VALUES:
 		fr_assert(0);
-		return -1;
+		return NULL;
 	}
 
 	if (value == NULL) {
 		ROPTIONAL(REDEBUG, ERROR, "Failed marshalling %pP to Python value", vp);
 		python_error_log(inst, request);
-		Py_XDECREF(attribute);
+	}
+
+	return value;
+}
+
+/*
+ *	This is the core Python function that the others wrap around.
+ *	Pass the value-pair print strings in a tuple.
+ */
+static int mod_populate_vptuple(rlm_python_t const *inst, REQUEST *request, PyObject *pp, VALUE_PAIR *vp)
+{
+	PyObject *attribute = NULL;
+	PyObject *value = NULL;
+
+	/* Look at the fr_pair_fprint_name? */
+	if (vp->da->flags.has_tag) {
+		attribute = PyUnicode_FromFormat("%s:%d", vp->da->name, vp->tag);
+	} else {
+		attribute = PyUnicode_FromString(vp->da->name);
+	}
+
+	if (!attribute) return -1;
+
+	value = python_value_from_vp(inst, request, vp);
+	if (!value) {
+		Py_DECREF(attribute);
 		return -1;
 	}
 
@@ -492,7 +616,146 @@ static int mod_populate_vptuple(rlm_python_t const *inst, REQUEST *request, PyOb
 	return 0;
 }
 
-static rlm_rcode_t do_python_single(rlm_python_t const *inst, REQUEST *request, PyObject *p_func, char const *funcname)
+static uint32_t python_attr_name_hash(void const *data)
+{
+	python_attr_name_t const *entry = data;
+
+	return fr_hash(&entry->da, sizeof(entry->da));
+}
+
+static int python_attr_name_cmp(void const *one, void const *two)
+{
+	python_attr_name_t const *a = one, *b = two;
+
+	return (a->da > b->da) - (a->da < b->da);
+}
+
+/** Release a cached name
+ *
+ * Called when the cache is freed, which must be done with the GIL held.
+ */
+static void python_attr_name_free(void *data)
+{
+	python_attr_name_t *entry = data;
+
+	Py_DECREF(entry->name);
+}
+
+/** Get the name of an attribute as a Python string
+ *
+ * Names are created once per thread, and reused for every request.
+ *
+ * @return a new reference, or NULL on error.
+ */
+static PyObject *python_attr_name(rlm_python_thread_t *this_thread, VALUE_PAIR const *vp)
+{
+	python_attr_name_t	*entry;
+	PyObject		*name;
+
+	if (vp->da->flags.has_tag) return PyUnicode_FromFormat("%s:%d", vp->da->name, vp->tag);
+
+	entry = fr_swiss_table_finddata(this_thread->attr_names, &(python_attr_name_t){ .da = vp->da });
+	if (entry) {
+		Py_INCREF(entry->name);
+		return entry->name;
+	}
+
+	name = PyUnicode_FromString(vp->da->name);
+	if (!name) return NULL;
+
+	/*
+	 *	Unknown attributes are freed with the request,
+	 *	so there's no point remembering their names.
+	 */
+	if (vp->da->flags.is_unknown) return name;
+
+	MEM(entry = talloc(this_thread->attr_names, python_attr_name_t));
+	entry->da = vp->da;
+	entry->name = name;
+	Py_INCREF(name);
+
+	if (fr_swiss_table_insert(this_thread->attr_names, entry) != 1) {
+		Py_DECREF(name);
+		talloc_free(entry);
+	}
+
+	return name;
+}
+
+/** Build a dict of attribute names to values from a list of pairs
+ *
+ * Attributes which appear once map to their value, attributes which
+ * appear more than once map to a list of values, in packet order.
+ *
+ * @return a new reference, or NULL on error.
+ */
+static PyObject *python_dict_from_vps(rlm_python_t const *inst, rlm_python_thread_t *this_thread,
+				      REQUEST *request, VALUE_PAIR *vps)
+{
+	fr_cursor_t	cursor;
+	VALUE_PAIR	*vp;
+	PyObject	*p_dict;
+
+	p_dict = PyDict_New();
+	if (!p_dict) return NULL;
+
+	for (vp = fr_cursor_init(&cursor, &vps);
+	     vp;
+	     vp = fr_cursor_next(&cursor)) {
+		PyObject	*p_key, *p_value, *p_current;
+		int		ret;
+
+		p_key = python_attr_name(this_thread, vp);
+		if (!p_key) goto error;
+
+		/*
+		 *	Values which can't be converted are left
+		 *	out, as the tuple form passes None for them.
+		 */
+		p_value = python_value_from_vp(inst, request, vp);
+		if (!p_value) {
+			Py_DECREF(p_key);
+			continue;
+		}
+
+		p_current = PyDict_GetItem(p_dict, p_key);	/* Borrowed */
+		if (!p_current) {
+			ret = PyDict_SetItem(p_dict, p_key, p_value);
+
+		} else if (PyList_CheckExact(p_current)) {
+			ret = PyList_Append(p_current, p_value);
+
+		} else {
+			PyObject *p_list;
+
+			p_list = PyList_New(2);
+			if (!p_list) {
+				ret = -1;
+			} else {
+				Py_INCREF(p_current);
+				PyList_SET_ITEM(p_list, 0, p_current);
+				Py_INCREF(p_value);
+				PyList_SET_ITEM(p_list, 1, p_value);
+
+				ret = PyDict_SetItem(p_dict, p_key, p_list);
+				Py_DECREF(p_list);
+			}
+		}
+
+		Py_DECREF(p_key);
+		Py_DECREF(p_value);
+		if (ret < 0) {
+		error:
+			Py_DECREF(p_dict);
+			return NULL;
+		}
+	}
+
+	return p_dict;
+}
+
+static rlm_rcode_t do_python_single(rlm_python_t const *inst, rlm_python_thread_t *this_thread,
+				    REQUEST *request, PyObject *p_func, char const *funcname)
 {
 	fr_cursor_t	cursor;
 	VALUE_PAIR	*vp;
@@ -501,6 +764,19 @@ static rlm_rcode_t do_python_single(rlm_python_t const *inst, REQUEST *request,
 	int		tuple_len;
 	rlm_rcode_t	rcode = RLM_MODULE_OK;
 
+	/*
+	 *	With pass_dict the request is passed as a single dict,
+	 *	which avoids building a tuple for every attribute.
+	 */
+	if (request && inst->pass_dict) {
+		p_arg = python_dict_from_vps(inst, this_thread, request, fr_pair_list_head(&request->packet->vps));
+		if (!p_arg) {
+			rcode = RLM_MODULE_FAIL;
+			goto finish;
+		}
+		goto call;
+	}
+
 	/*
 	 *	We will pass a tuple containing (name, value) tuples
 	 *	We can safely use the Python function to build up a
@@ -511,7 +787,7 @@ static rlm_rcode_t do_python_single(rlm_python_t const *inst, REQUEST *request,
 	 */
 	tuple_len = 0;
 	if (request != NULL) {
-		for (vp = fr_cursor_init(&cursor, &request->packet->vps);
+		for (vp = fr_pair_list_cursor_init(&cursor, &request->packet->vps);
 		     vp;
 		     vp = fr_cursor_next(&cursor)) tuple_len++;
 	}
@@ -526,7 +802,7 @@ static rlm_rcode_t do_python_single(rlm_python_t const *inst, REQUEST *request,
 			goto finish;
 		}
 
-		for (vp = fr_cursor_init(&cursor, &request->packet->vps);
+		for (vp = fr_pair_list_cursor_init(&cursor, &request->packet->vps);
 		     vp;
 		     vp = fr_cursor_next(&cursor), i++) {
 			PyObject *pp;
@@ -548,6 +824,7 @@ static rlm_rcode_t do_python_single(rlm_python_t const *inst, REQUEST *request,
 		}
 	}
 
+call:
 	/* Call Python function. */
 	p_ret = PyObject_CallFunctionObjArgs(p_func, p_arg, NULL);
 	if (!p_ret) {
@@ -567,7 +844,7 @@ static rlm_rcode_t do_python_single(rlm_python_t const *inst, REQUEST *request,
 	 *  1. (returnvalue, replyTuple, configTuple), where
 	 *   - returnvalue is one of the constants RLM_*
 	 *   - replyTuple and configTuple are tuples of string
-	 *      tuples of size 2
+	 *      tuples of size 2, or dicts of names to values
 	 *
 	 *  2. the function return value alone
 	 *
@@ -638,7 +915,7 @@ static rlm_rcode_t do_python(rlm_python_t const *inst, rlm_python_thread_t *this
 	RDEBUG3("Using thread state %p/%p", inst, this_thread->state);
 
 	PyEval_RestoreThread(this_thread->state);	/* Swap in our local thread state */
-	rcode = do_python_single(inst, request, p_func, funcname);
+	rcode = do_python_single(inst, this_thread, request, p_func, funcname);
 	(void)fr_cond_assert(PyEval_SaveThread() == this_thread->state);
 
 	return rcode;
@@ -649,7 +926,7 @@ static rlm_rcode_t CC_HINT(nonnull) mod_##x(module_ctx_t const *mctx, REQUEST *r
 { \
 	rlm_python_t const *inst = talloc_get_type_abort_const(mctx->instance, rlm_python_t); \
 	rlm_python_thread_t *thread = talloc_get_type_abort(mctx->thread, rlm_python_thread_t); \
-	return do_python(inst, thread, request, inst->x.function, #x);\
+	return do_python(inst, thread, request, thread->x.function, #x);\
 }
 
 MOD_FUNC(authenticate)
@@ -795,7 +1072,8 @@ static int python_parse_config(rlm_python_t *inst, CONF_SECTION *cs, int lvl, Py
 /** Make the current instance's config available within the module we're initialising
  *
  */
-static int python_module_import_config(rlm_python_t *inst, CONF_SECTION *conf, PyObject *module)
+static int python_module_import_config(rlm_python_t *inst, CONF_SECTION const *conf, PyObject *module,
+				       PyObject **pythonconf_dict)
 {
 	CONF_SECTION *cs;
 
@@ -803,12 +1081,12 @@ static int python_module_import_config(rlm_python_t *inst, CONF_SECTION *conf, P
 	 *	Convert a FreeRADIUS config structure into a python
 	 *	dictionary.
 	 */
-	inst->pythonconf_dict = PyDict_New();
-	if (!inst->pythonconf_dict) {
+	*pythonconf_dict = PyDict_New();
+	if (!*pythonconf_dict) {
 		ERROR("Unable to create python dict for config");
 	error:
-		Py_XDECREF(inst->pythonconf_dict);
-		inst->pythonconf_dict = NULL;
+		Py_XDECREF(*pythonconf_dict);
+		*pythonconf_dict = NULL;
 		python_error_log(inst, NULL);
 		return -1;
 	}
@@ -816,13 +1094,13 @@ static int python_module_import_config(rlm_python_t *inst, CONF_SECTION *conf, P
 	cs = cf_section_find(conf, "config", NULL);
 	if (cs) {
 		DEBUG("Inserting \"config\" section into python environment as radiusd.config");
-		if (python_parse_config(inst, cs, 0, inst->pythonconf_dict) < 0) goto error;
+		if (python_parse_config(inst, cs, 0, *pythonconf_dict) < 0) goto error;
 	}
 
 	/*
 	 *	Add module configuration as a dict
 	 */
-	if (PyModule_AddObject(module, "config", inst->pythonconf_dict) < 0) goto error;
+	if (PyModule_AddObject(module, "config", *pythonconf_dict) < 0) goto error;
 
 	return 0;
 }
@@ -876,6 +1154,32 @@ static char *python_path_build(TALLOC_CTX *ctx, rlm_python_t *inst, CONF_SECTION
  *	Python 3 interpreter initialisation and destruction
  */
 #if PY_MAJOR_VERSION == 3
+#  if PY_VERSION_HEX >= 0x030C0000
+/** Define the radiusd module
+ *
+ * Uses multi-phase initialisation, so the module can be imported into
+ * interpreters with their own GIL.  Interpreters for per_thread_interpreter
+ * are created concurrently by the workers, so this can't use current_inst.
+ */
+static PyObject *python_module_init(void)
+{
+	static PyModuleDef_Slot py_module_slots[] = {
+		{ Py_mod_multiple_interpreters, Py_MOD_PER_INTERPRETER_GIL_SUPPORTED },
+		{ 0, NULL }
+	};
+
+	static struct PyModuleDef py_module_def = {
+		PyModuleDef_HEAD_INIT,
+		.m_name = "radiusd",
+		.m_doc = "FreeRADIUS python module",
+		.m_size = 0,
+		.m_methods = module_methods,
+		.m_slots = py_module_slots
+	};
+
+	return PyModuleDef_Init(&py_module_def);
+}
+#  else
 static PyObject *python_module_init(void)
 {
 	rlm_python_t	*inst = current_inst;
@@ -904,12 +1208,41 @@ static PyObject *python_module_init(void)
 
 	return module;
 }
+#  endif
+
+/** Set sys.path for the current interpreter
+ *
+ * PySys_SetPath was removed in Python 3.13, so split the path ourselves.
+ *
+ * Must be called with the interpreter's thread state.
+ */
+static int python_path_set(rlm_python_t const *inst, char const *path)
+{
+	PyObject	*p_path, *p_sep, *p_list;
+
+	DEBUG3("Setting python path to \"%s\"", path);
+
+	p_path = PyUnicode_DecodeFSDefault(path);
+	p_sep = PyUnicode_FromString(":");
+	p_list = (p_path && p_sep) ? PyUnicode_Split(p_path, p_sep, -1) : NULL;
+	Py_XDECREF(p_path);
+	Py_XDECREF(p_sep);
+	if (!p_list || (PySys_SetObject("path", p_list) < 0)) {
+		ERROR("Failed setting python path to \"%s\"", path);
+		Py_XDECREF(p_list);
+		python_error_log(inst, NULL);
+		return -1;
+	}
+	Py_DECREF(p_list);
+
+	return 0;
+}
 
 static int python_interpreter_init(rlm_python_t *inst, CONF_SECTION *conf)
 {
 	char		*path;
 	PyObject	*module;
-	wchar_t	        *wide_path;
+	int		ret;
 
 	/*
 	 *	python_module_init takes no args, so we need
@@ -932,11 +1265,9 @@ static int python_interpreter_init(rlm_python_t *inst, CONF_SECTION *conf)
 	PyEval_RestoreThread(inst->interpreter);
 
 	path = python_path_build(inst, inst, conf);
-	DEBUG3("Setting python path to \"%s\"", path);
-	wide_path = Py_DecodeLocale(path, NULL);
+	ret = python_path_set(inst, path);
 	talloc_free(path);
-	PySys_SetPath(wide_path);
-	PyMem_RawFree(wide_path);
+	if (ret < 0) return -1;
 
 	/*
 	 *	Import the radiusd module into this python
@@ -949,7 +1280,7 @@ static int python_interpreter_init(rlm_python_t *inst, CONF_SECTION *conf)
  		ERROR("Failed importing \"radiusd\" module into interpreter %p", inst->interpreter);
  		return -1;
  	}
-	if ((python_module_import_config(inst, conf, module) < 0) ||
+	if ((python_module_import_config(inst, conf, module, &inst->pythonconf_dict) < 0) ||
 	    (python_module_import_constants(inst, module) < 0)) {
 		Py_DECREF(module);
 		return -1;
@@ -973,6 +1304,132 @@ static void python_interpreter_free(UNUSED rlm_python_t *inst, PyThreadState *in
 	PyThreadState_Swap(global_interpreter);	/* Get a none-null thread state */
 	PyEval_SaveThread();		/* Unlock GIL */
 }
+
+#  if PY_VERSION_HEX >= 0x030C0000
+/** Free a worker's own interpreter
+ *
+ * Must be called with the interpreter's thread state current.
+ * Returns with no thread state.
+ */
+static void python_thread_interpreter_free(rlm_python_thread_t *this_thread)
+{
+	python_function_destroy(&this_thread->instantiate);
+	python_function_destroy(&this_thread->authorize);
+	python_function_destroy(&this_thread->authenticate);
+	python_function_destroy(&this_thread->preacct);
+	python_function_destroy(&this_thread->accounting);
+	python_function_destroy(&this_thread->post_auth);
+	python_function_destroy(&this_thread->detach);
+	python_obj_destroy(&this_thread->module);
+
+	Py_EndInterpreter(this_thread->state);	/* Destroys interpreter and its GIL - sets thread state to NULL */
+	this_thread->state = NULL;
+	this_thread->own_interpreter = false;
+}
+
+/** Create an interpreter with its own GIL for a worker
+ *
+ * The interpreter gets its own radiusd module, and its own copies of
+ * the user's modules and functions.  As only this worker uses it, the
+ * GIL is never contended, and workers run Python code in parallel.
+ *
+ * Must be called with no thread state.  Returns with no thread state.
+ */
+static int python_thread_interpreter_init(rlm_python_t *inst, CONF_SECTION const *conf,
+					  rlm_python_thread_t *this_thread)
+{
+	PyThreadState		*main_state;
+	PyObject		*module, *pythonconf_dict;
+	PyStatus		status;
+	int			ret = -1;
+	PyInterpreterConfig	config = {
+		.use_main_obmalloc = 0,
+		.allow_fork = 0,
+		.allow_exec = 0,
+		.allow_threads = 1,
+		.allow_daemon_threads = 0,
+		.check_multi_interp_extensions = 1,
+		.gil = PyInterpreterConfig_OWN_GIL,
+	};
+
+	/*
+	 *	Interpreters are created from an existing one, and
+	 *	this thread doesn't have a state in any of them yet.
+	 */
+	main_state = PyThreadState_New(global_interpreter->interp);
+	if (!main_state) {
+		ERROR("Failed initialising local PyThreadState");
+		return -1;
+	}
+	PyEval_RestoreThread(main_state);
+
+	LSAN_DISABLE(status = Py_NewInterpreterFromConfig(&this_thread->state, &config));
+	if (PyStatus_Exception(status)) {
+		ERROR("Failed creating new interpreter: %s", status.err_msg ? status.err_msg : "unknown error");
+		this_thread->state = NULL;
+		goto discard;
+	}
+	DEBUG3("Created new interpreter %p", this_thread->state);
+	this_thread->own_interpreter = true;
+
+	if (python_path_set(inst, inst->path) < 0) goto error;
+
+	module = PyImport_ImportModule("radiusd");
+	if (!module) {
+		ERROR("Failed importing \"radiusd\" module into interpreter %p", this_thread->state);
+		python_error_log(inst, NULL);
+		goto error;
+	}
+	this_thread->module = module;
+
+	if ((python_module_import_config(inst, conf, module, &pythonconf_dict) < 0) ||
+	    (python_module_import_constants(inst, module) < 0)) goto error;
+
+#define PYTHON_THREAD_FUNC_LOAD(_x) \
+	this_thread->_x.module_name = inst->_x.module_name; \
+	this_thread->_x.function_name = inst->_x.function_name; \
+	if (python_function_load(inst, &this_thread->_x) < 0) goto error
+	PYTHON_THREAD_FUNC_LOAD(instantiate);
+	PYTHON_THREAD_FUNC_LOAD(authenticate);
+	PYTHON_THREAD_FUNC_LOAD(authorize);
+	PYTHON_THREAD_FUNC_LOAD(preacct);
+	PYTHON_THREAD_FUNC_LOAD(accounting);
+	PYTHON_THREAD_FUNC_LOAD(post_auth);
+	PYTHON_THREAD_FUNC_LOAD(detach);
+#undef PYTHON_THREAD_FUNC_LOAD
+
+	/*
+	 *	Module level state in Python isn't shared between
+	 *	workers, so instantiate is called for each of them.
+	 */
+	if (this_thread->instantiate.function) {
+		switch (do_python_single(inst, this_thread, NULL, this_thread->instantiate.function, "instantiate")) {
+		case RLM_MODULE_FAIL:
+		case RLM_MODULE_REJECT:
+		case RLM_MODULE_YIELD:	/* Yield not valid in instantiate */
+			goto error;
+
+		default:
+			break;
+		}
+	}
+
+	PyEval_SaveThread();		/* Unlock our GIL */
+	ret = 0;
+
+finish:
+	PyEval_RestoreThread(main_state);
+discard:
+	PyThreadState_Clear(main_state);
+	PyThreadState_DeleteCurrent();	/* Unlocks the main GIL */
+
+	return ret;
+
+error:
+	python_thread_interpreter_free(this_thread);
+	goto finish;
+}
+#  endif
 /*
  *	Python 2 interpreter initialisation and destruction
  */
@@ -1028,7 +1485,7 @@ static int python_interpreter_init(rlm_python_t *inst, CONF_SECTION *conf)
 		 */
 		Py_INCREF(module);
 
-		if ((python_module_import_config(inst, conf, module) < 0) ||
+		if ((python_module_import_config(inst, conf, module, &inst->pythonconf_dict) < 0) ||
 		    (python_module_import_constants(inst, module) < 0)) goto error;
 
 		if (inst->single_interpreter_mode) global_module = module;
@@ -1089,6 +1546,23 @@ static int mod_instantiate(void *instance, CONF_SECTION *conf)
 	inst->name = cf_section_name2(conf);
 	if (!inst->name) inst->name = cf_section_name1(conf);
 
+#if PY_MAJOR_VERSION == 3
+	/*
+	 *	Each worker creates its own interpreter, and loads
+	 *	the functions into it, in mod_thread_instantiate.
+	 */
+	if (inst->per_thread_interpreter) {
+#  if PY_VERSION_HEX < 0x030C0000
+		cf_log_err(conf, "per_thread_interpreter requires Python 3.12 or later, "
+			   "rlm_python was built against %s", PY_VERSION);
+		return -1;
+#  else
+		inst->path = python_path_build(inst, inst, conf);
+		return 0;
+#  endif
+	}
+#endif
+
 	if (python_interpreter_init(inst, conf) < 0) return -1;
 
 	/*
@@ -1114,7 +1588,7 @@ static int mod_instantiate(void *instance, CONF_SECTION *conf)
 	if (inst->instantiate.function) {
 		rlm_rcode_t rcode;
 
-		rcode = do_python_single(inst, NULL, inst->instantiate.function, "instantiate");
+		rcode = do_python_single(inst, NULL, NULL, inst->instantiate.function, "instantiate");
 		switch (rcode) {
 		case RLM_MODULE_FAIL:
 		case RLM_MODULE_REJECT:
@@ -1156,7 +1630,7 @@ static int mod_detach(void *instance)
 	/*
 	 *	We don't care if this fails.
 	 */
-	if (inst->detach.function) (void)do_python_single(inst, NULL, inst->detach.function, "detach");
+	if (inst->detach.function) (void)do_python_single(inst, NULL, NULL, inst->detach.function, "detach");
 
 #define PYTHON_FUNC_DESTROY(_x) python_function_destroy(&inst->_x)
 	PYTHON_FUNC_DESTROY(instantiate);
@@ -1178,22 +1652,43 @@ static int mod_detach(void *instance)
 	return 0;
 }
 
-static int mod_thread_instantiate(UNUSED CONF_SECTION const *conf, void *instance,
+static int mod_thread_instantiate(CONF_SECTION const *conf, void *instance,
 				  UNUSED fr_event_list_t *el, void *thread)
 {
 	PyThreadState		*state;
 	rlm_python_t		*inst = instance;
 	rlm_python_thread_t	*this_thread = thread;
 
+	this_thread->inst = inst;
+
+	if (inst->pass_dict) {
+		MEM(this_thread->attr_names = fr_swiss_table_create(this_thread, python_attr_name_hash,
+								    python_attr_name_cmp, python_attr_name_free));
+	}
+
+#if PY_VERSION_HEX >= 0x030C0000
+	if (inst->per_thread_interpreter) return python_thread_interpreter_init(inst, conf, this_thread);
+#endif
+
 	state = PyThreadState_New(inst->interpreter->interp);
 	if (!state) {
-		ERROR("Failed initialising local PyThreadState");
+		cf_log_err(conf, "Failed initialising local PyThreadState");
 		return -1;
 	}
 
 	DEBUG3("Initialised new thread state %p", state);
 	this_thread->state = state;
 
+	/*
+	 *	All workers share the instance's interpreter, and the
+	 *	functions loaded into it.
+	 */
+	this_thread->authorize = inst->authorize;
+	this_thread->authenticate = inst->authenticate;
+	this_thread->preacct = inst->preacct;
+	this_thread->accounting = inst->accounting;
+	this_thread->post_auth = inst->post_auth;
+
 	return 0;
 }
 
@@ -1201,7 +1696,35 @@ static int mod_thread_detach(UNUSED fr_event_list_t *el, void *thread)
 {
 	rlm_python_thread_t	*this_thread = thread;
 
+	if (!this_thread->state) return 0;
+
 	PyEval_RestoreThread(this_thread->state);	/* Swap in our local thread state */
+
+	/*
+	 *	The cached names belong to the interpreter this
+	 *	thread state is for, and must be released with
+	 *	its GIL held.
+	 */
+	if (this_thread->attr_names) {
+		fr_swiss_table_free(this_thread->attr_names);
+		this_thread->attr_names = NULL;
+	}
+
+#if PY_VERSION_HEX >= 0x030C0000
+	if (this_thread->own_interpreter) {
+		/*
+		 *	We don't care if this fails.
+		 */
+		if (this_thread->detach.function) {
+			(void)do_python_single(this_thread->inst, this_thread, NULL,
+					       this_thread->detach.function, "detach");
+		}
+		python_thread_interpreter_free(this_thread);
+
+		return 0;
+	}
+#endif
+
 	PyThreadState_Clear(this_thread->state);
 	PyEval_SaveThread();
 
@@ -1250,12 +1773,13 @@ static int mod_load(void)
 #endif
 
 	/*
-	 *	As of 3.7 this is called by Py_Initialize
+	 *	As of 3.7 this is called by Py_Initialize, and
+	 *	PyEval_ThreadsInitialized was removed in 3.13.
 	 */
 #if PY_VERSION_HEX < 0x03070000
 	PyEval_InitThreads(); 			/* This also grabs a lock (which we then need to release) */
-#endif
 	fr_assert(PyEval_ThreadsInitialized());
+#endif
 
 	/*
 	 *	Set program name (i.e. the software calling the interpreter)
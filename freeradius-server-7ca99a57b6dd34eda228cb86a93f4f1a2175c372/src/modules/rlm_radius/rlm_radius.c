@@ -405,7 +405,7 @@ static void radius_fixups(rlm_radius_t const *inst, REQUEST *request)
 	if (RDEBUG_ENABLED) {
 		fr_cursor_t cursor;
 
-		for (vp = fr_cursor_iter_by_da_init(&cursor, &request->packet->vps, attr_proxy_state);
+		for (vp = fr_pair_list_cursor_by_da_init(&cursor, &request->packet->vps, attr_proxy_state);
 		     vp;
 		     vp = fr_cursor_next(&cursor)) {
 			if (vp->vp_length != 4) continue;
@@ -419,8 +419,8 @@ static void radius_fixups(rlm_radius_t const *inst, REQUEST *request)
 
 	if (request->packet->code != FR_CODE_ACCESS_REQUEST) return;
 
-	if (fr_pair_find_by_da(request->packet->vps, attr_chap_password, TAG_ANY) &&
-	    !fr_pair_find_by_da(request->packet->vps, attr_chap_challenge, TAG_ANY)) {
+	if (fr_pair_list_find_by_da(&request->packet->vps, attr_chap_password, TAG_ANY) &&
+	    !fr_pair_list_find_by_da(&request->packet->vps, attr_chap_challenge, TAG_ANY)) {
 	    	MEM(pair_add_request(&vp, attr_chap_challenge) >= 0);
 		fr_pair_value_memdup(vp, request->packet->vector, sizeof(request->packet->vector), true);
 	}
@@ -50,6 +50,8 @@ RCSID("$Id$")
 
 #include <freeradius-devel/redis/base.h>
 #include <freeradius-devel/redis/cluster.h>
+#include <freeradius-devel/redis/pipeline.h>
+#include <freeradius-devel/unlang/base.h>
 #include "redis_ippool.h"
 
 #include <freeradius-devel/dhcpv4/dhcpv4.h>
@@ -98,10 +100,50 @@ typedef struct {
 						//!< allocated_address_attr if updates are successful.
 
 	fr_redis_cluster_t	*cluster;	//!< Redis cluster.
+
+	fr_trunk_conf_t		trunk_conf;	//!< Configuration for the per-worker trunks
+						//!< to each cluster node.
 } rlm_redis_ippool_t;
 
+/** rlm_redis_ippool thread instance
+ *
+ */
+typedef struct {
+	fr_redis_cluster_thread_t *cluster;	//!< Thread local cluster state, with trunks
+						//!< to each cluster node.
+} rlm_redis_ippool_thread_t;
+
+/** Resume context for a pool action
+ *
+ * Holds copies of the expanded arguments, as they're needed again if
+ * the script has to be loaded, and when processing the result.
+ */
+typedef struct {
+	ippool_action_t		action;		//!< What we're doing to the pool.
+
+	fr_redis_command_set_t	*cmds;		//!< Commands currently in flight.
+	bool			failed;		//!< Commands couldn't be sent, or didn't complete.
+	bool			script_sent;	//!< Commands were sent with EVAL as the node
+						//!< didn't have the script cached.
+	redisReply		*reply;		//!< Result of the Lua script.
+	redisReply		*wait_reply;	//!< Result of the WAIT command (if any).
+
+	uint8_t			*key_prefix;	//!< Pool name.
+	size_t			key_prefix_len;
+	uint8_t			*device_id;	//!< Device identifier.
+	size_t			device_id_len;
+	uint8_t			*gateway_id;	//!< Gateway identifier.
+	size_t			gateway_id_len;
+
+	char			*ip_str;	//!< Requested address, as a string.
+	fr_ipaddr_t		ip;		//!< Requested address.
+	uint32_t		expires;	//!< Lease time.
+	uint32_t		now;		//!< Wall time the action was started.
+} ippool_rctx_t;
+
 static CONF_PARSER redis_config[] = {
 	REDIS_COMMON_CONFIG,
+	{ FR_CONF_OFFSET("trunk", FR_TYPE_SUBSECTION, rlm_redis_ippool_t, trunk_conf), .subcs = (void const *) fr_trunk_config },
 	CONF_PARSER_TERMINATOR
 };
 
@@ -437,200 +479,13 @@ static void ippool_action_print(REQUEST *request, ippool_action_t action,
 	talloc_free(gateway_str);
 }
 
-/** Execute a script against Redis cluster
+/** Process the result of allocating a new IP address from a pool
  *
- * Handles uploading the script to the server if required.
- *
- * @note All replies will be freed on error.
- *
- * @param[out] out		Where to write Redis reply object resulting from the command.
- * @param[in] request		The current request.
- * @param[in] cluster		configuration.
- * @param[in] key		to use to determine the cluster node.
- * @param[in] key_len		length of the key.
- * @param[in] wait_num		If > 0 wait until this many slaves have replicated the data
- *				from the last command.
- * @param[in] wait_timeout	How long to wait for slaves.
- * @param[in] digest		of script.
- * @param[in] script		to upload.
- * @param[in] cmd		EVALSHA command to execute.
- * @param[in] ...		Arguments for the eval command.
- * @return status of the command.
  */
-static fr_redis_rcode_t ippool_script(redisReply **out, REQUEST *request, fr_redis_cluster_t *cluster,
-				      uint8_t const *key, size_t key_len,
-				      uint32_t wait_num, fr_time_delta_t wait_timeout,
-				      char const digest[], char const *script,
-				      char const *cmd, ...)
+static ippool_rcode_t redis_ippool_allocate(rlm_redis_ippool_t const *inst, REQUEST *request, redisReply *reply)
 {
-	fr_redis_conn_t			*conn;
-	redisReply			*replies[5];	/* Must be equal to the maximum number of pipelined commands */
-	size_t				reply_cnt = 0, i;
-
-	fr_redis_cluster_state_t	state;
-	fr_redis_rcode_t		s_ret, status;
-	unsigned int			pipelined = 0;
-
-	va_list				ap;
-
-	*out = NULL;
-
-#ifndef NDEBUG
-	memset(replies, 0, sizeof(replies));
-#endif
-
-	va_start(ap, cmd);
-
-	for (s_ret = fr_redis_cluster_state_init(&state, &conn, cluster, request, key, key_len, false);
-	     s_ret == REDIS_RCODE_TRY_AGAIN;	/* Continue */
-	     s_ret = fr_redis_cluster_state_next(&state, &conn, cluster, request, status, &replies[0])) {
-	     	va_list	copy;
-
-	     	RDEBUG3("Calling script 0x%s", digest);
-	     	va_copy(copy, ap);	/* copy or segv */
-		redisvAppendCommand(conn->handle, cmd, copy);
-		va_end(copy);
-		pipelined = 1;
-		if (wait_num) {
-			redisAppendCommand(conn->handle, "WAIT %i %i", wait_num, fr_time_delta_to_msec(wait_timeout));
-			pipelined++;
-		}
-		reply_cnt = fr_redis_pipeline_result(&pipelined, &status,
-						     replies, NUM_ELEMENTS(replies),
-						     conn);
-		if (status != REDIS_RCODE_NO_SCRIPT) continue;
-
-		/*
-		 *	Clear out the existing reply
-		 */
-		fr_redis_pipeline_free(replies, reply_cnt);
-
-		/*
-		 *	Last command failed with NOSCRIPT, this means
-		 *	we have to send the Lua script up to the node
-		 *	so it can be cached.
-		 */
-	     	RDEBUG3("Loading script 0x%s", digest);
-		redisAppendCommand(conn->handle, "MULTI");
-		redisAppendCommand(conn->handle, "SCRIPT LOAD %s", script);
-	     	va_copy(copy, ap);	/* copy or segv */
-		redisvAppendCommand(conn->handle, cmd, copy);
-		va_end(copy);
-		redisAppendCommand(conn->handle, "EXEC");
-		pipelined = 4;
-		if (wait_num) {
-			redisAppendCommand(conn->handle, "WAIT %i %i", wait_num, wait_timeout);
-			pipelined++;
-		}
-
-		reply_cnt = fr_redis_pipeline_result(&pipelined, &status,
-						     replies, NUM_ELEMENTS(replies),
-						     conn);
-		if (status == REDIS_RCODE_SUCCESS) {
-			if (RDEBUG_ENABLED3) for (i = 0; i < reply_cnt; i++) {
-				fr_redis_reply_print(L_DBG_LVL_3, replies[i], request, i);
-			}
-
-			if (replies[3]->type != REDIS_REPLY_ARRAY) {
-				REDEBUG("Bad response to EXEC, expected array got %s",
-					fr_table_str_by_value(redis_reply_types, replies[3]->type, "<UNKNOWN>"));
-			error:
-				fr_redis_pipeline_free(replies, reply_cnt);
-				status = REDIS_RCODE_ERROR;
-				goto finish;
-			}
-			if (replies[3]->elements != 2) {
-				REDEBUG("Bad response to EXEC, expected 2 result elements, got %zu",
-					replies[3]->elements);
-				goto error;
-			}
-			if (replies[3]->element[0]->type != REDIS_REPLY_STRING) {
-				REDEBUG("Bad response to SCRIPT LOAD, expected string got %s",
-					fr_table_str_by_value(redis_reply_types, replies[3]->element[0]->type, "<UNKNOWN>"));
-				goto error;
-			}
-			if (strcmp(replies[3]->element[0]->str, digest) != 0) {
-				RWDEBUG("Incorrect SHA1 from SCRIPT LOAD, expected %s, got %s",
-					digest, replies[3]->element[0]->str);
-				goto error;
-			}
-		}
-	}
-	if (s_ret != REDIS_RCODE_SUCCESS) goto error;
-
-	switch (reply_cnt) {
-	case 2:	/* EVALSHA with wait */
-		if (ippool_wait_check(request, wait_num, replies[1]) < 0) goto error;
-		fr_redis_reply_free(&replies[1]);	/* Free the wait response */
-		break;
-
-	case 1:	/* EVALSHA */
-		*out = replies[0];
-		break;
-
-	case 5: /* LOADSCRIPT + EVALSHA + WAIT */
-		if (ippool_wait_check(request, wait_num, replies[4]) < 0) goto error;
-		fr_redis_reply_free(&replies[4]);	/* Free the wait response */
-		FALL_THROUGH;
-
-	case 4: /* LOADSCRIPT + EVALSHA */
-		fr_redis_reply_free(&replies[2]);	/* Free the queued cmd response*/
-		fr_redis_reply_free(&replies[1]);	/* Free the queued script load response */
-		fr_redis_reply_free(&replies[0]);	/* Free the queued multi response */
-		*out = replies[3]->element[1];
-		replies[3]->element[1] = NULL;		/* Prevent double free */
-		fr_redis_reply_free(&replies[3]);	/* This works because hiredis checks for NULL elements */
-		break;
-
-	case 0:
-		break;
-	}
-
-finish:
-	va_end(ap);
-	return s_ret;
-}
-
-/** Allocate a new IP address from a pool
- *
- */
-static ippool_rcode_t redis_ippool_allocate(rlm_redis_ippool_t const *inst, REQUEST *request,
-					    uint8_t const *key_prefix, size_t key_prefix_len,
-					    uint8_t const *device_id, size_t device_id_len,
-					    uint8_t const *gateway_id, size_t gateway_id_len,
-					    uint32_t expires)
-{
-	struct			timeval now;
-	redisReply		*reply = NULL;
-
-	fr_redis_rcode_t	status;
 	ippool_rcode_t		ret = IPPOOL_RCODE_SUCCESS;
 
-	fr_assert(key_prefix);
-	fr_assert(device_id);
-
-	now = fr_time_to_timeval(fr_time());
-
-	/*
-	 *	hiredis doesn't deal well with NULL string pointers
-	 */
-	if (!gateway_id) gateway_id = (uint8_t const *)"";
-
-	status = ippool_script(&reply, request, inst->cluster,
-			       key_prefix, key_prefix_len,
-			       inst->wait_num, inst->wait_timeout,
-			       lua_alloc_digest, lua_alloc_cmd,
-	 		       "EVALSHA %s 1 %b %u %u %b %b",
-	 		       lua_alloc_digest,
-			       key_prefix, key_prefix_len,
-			       (unsigned int)now.tv_sec, expires,
-			       device_id, device_id_len,
-			       gateway_id, gateway_id_len);
-	if (status != REDIS_RCODE_SUCCESS) {
-		ret = IPPOOL_RCODE_FAIL;
-		goto finish;
-	}
-
 	fr_assert(reply);
 	if (reply->type != REDIS_REPLY_ARRAY) {
 		REDEBUG("Expected result to be array got \"%s\"",
@@ -778,24 +633,15 @@ static ippool_rcode_t redis_ippool_allocate(rlm_redis_ippool_t const *inst, REQU
 		}
 	}
 finish:
-	fr_redis_reply_free(&reply);
 	return ret;
 }
 
-/** Update an existing IP address in a pool
+/** Process the result of updating an existing IP address in a pool
  *
  */
-static ippool_rcode_t redis_ippool_update(rlm_redis_ippool_t const *inst, REQUEST *request,
-					  uint8_t const *key_prefix, size_t key_prefix_len,
-					  fr_ipaddr_t *ip,
-					  uint8_t const *device_id, size_t device_id_len,
-					  uint8_t const *gateway_id, size_t gateway_id_len,
+static ippool_rcode_t redis_ippool_update(rlm_redis_ippool_t const *inst, REQUEST *request, redisReply *reply,
 					  uint32_t expires)
 {
-	struct			timeval now;
-	redisReply		*reply = NULL;
-
-	fr_redis_rcode_t	status;
 	ippool_rcode_t		ret = IPPOOL_RCODE_SUCCESS;
 
 	tmpl_t		range_rhs;
@@ -803,47 +649,6 @@ static ippool_rcode_t redis_ippool_update(rlm_redis_ippool_t const *inst, REQUES
 
 	tmpl_init(&range_rhs, TMPL_TYPE_DATA, "", 0, T_DOUBLE_QUOTED_STRING);
 
-	now = fr_time_to_timeval(fr_time());
-
-	/*
-	 *	hiredis doesn't deal well with NULL string pointers
-	 */
-	if (!device_id) device_id = (uint8_t const *)"";
-	if (!gateway_id) gateway_id = (uint8_t const *)"";
-
-	if ((ip->af == AF_INET) && inst->ipv4_integer) {
-		status = ippool_script(&reply, request, inst->cluster,
-				       key_prefix, key_prefix_len,
-				       inst->wait_num, inst->wait_timeout,
-				       lua_update_digest, lua_update_cmd,
-				       "EVALSHA %s 1 %b %u %u %u %b %b",
-				       lua_update_digest,
-				       key_prefix, key_prefix_len,
-				       (unsigned int)now.tv_sec, expires,
-				       htonl(ip->addr.v4.s_addr),
-				       device_id, device_id_len,
-				       gateway_id, gateway_id_len);
-	} else {
-		char ip_buff[FR_IPADDR_PREFIX_STRLEN];
-
-		IPPOOL_SPRINT_IP(ip_buff, ip, ip->prefix);
-		status = ippool_script(&reply, request, inst->cluster,
-				       key_prefix, key_prefix_len,
-				       inst->wait_num, inst->wait_timeout,
-				       lua_update_digest, lua_update_cmd,
-				       "EVALSHA %s 1 %b %u %u %s %b %b",
-				       lua_update_digest,
-				       key_prefix, key_prefix_len,
-				       (unsigned int)now.tv_sec, expires,
-				       ip_buff,
-				       device_id, device_id_len,
-				       gateway_id, gateway_id_len);
-	}
-	if (status != REDIS_RCODE_SUCCESS) {
-		ret = IPPOOL_RCODE_FAIL;
-		goto finish;
-	}
-
 	if (reply->type != REDIS_REPLY_ARRAY) {
 		REDEBUG("Expected result to be array got \"%s\"",
 			fr_table_str_by_value(redis_reply_types, reply->type, "<UNKNOWN>"));
@@ -919,63 +724,16 @@ static ippool_rcode_t redis_ippool_update(rlm_redis_ippool_t const *inst, REQUES
 	}
 
 finish:
-	fr_redis_reply_free(&reply);
-
 	return ret;
 }
 
-/** Release an existing IP address in a pool
+/** Process the result of releasing an existing IP address in a pool
  *
  */
-static ippool_rcode_t redis_ippool_release(rlm_redis_ippool_t const *inst, REQUEST *request,
-					   uint8_t const *key_prefix, size_t key_prefix_len,
-					   fr_ipaddr_t *ip,
-					   uint8_t const *device_id, size_t device_id_len)
+static ippool_rcode_t redis_ippool_release(REQUEST *request, redisReply *reply)
 {
-	struct			timeval now;
-	redisReply		*reply = NULL;
-
-	fr_redis_rcode_t	status;
 	ippool_rcode_t		ret = IPPOOL_RCODE_SUCCESS;
 
-	now = fr_time_to_timeval(fr_time());
-
-	/*
-	 *	hiredis doesn't deal well with NULL string pointers
-	 */
-	if (!device_id) device_id = (uint8_t const *)"";
-
-	if ((ip->af == AF_INET) && inst->ipv4_integer) {
-		status = ippool_script(&reply, request, inst->cluster,
-				       key_prefix, key_prefix_len,
-				       inst->wait_num, inst->wait_timeout,
-				       lua_release_digest, lua_release_cmd,
-				       "EVALSHA %s 1 %b %u %u %b",
-				       lua_release_digest,
-				       key_prefix, key_prefix_len,
-				       (unsigned int)now.tv_sec,
-				       htonl(ip->addr.v4.s_addr),
-				       device_id, device_id_len);
-	} else {
-		char ip_buff[FR_IPADDR_PREFIX_STRLEN];
-
-		IPPOOL_SPRINT_IP(ip_buff, ip, ip->prefix);
-		status = ippool_script(&reply, request, inst->cluster,
-				       key_prefix, key_prefix_len,
-				       inst->wait_num, inst->wait_timeout,
-				       lua_release_digest, lua_release_cmd,
-				       "EVALSHA %s 1 %b %u %s %b",
-				       lua_release_digest,
-				       key_prefix, key_prefix_len,
-				       (unsigned int)now.tv_sec,
-				       ip_buff,
-				       device_id, device_id_len);
-	}
-	if (status != REDIS_RCODE_SUCCESS) {
-		ret = IPPOOL_RCODE_FAIL;
-		goto finish;
-	}
-
 	if (reply->type != REDIS_REPLY_ARRAY) {
 		REDEBUG("Expected result to be array got \"%s\"",
 			fr_table_str_by_value(redis_reply_types, reply->type, "<UNKNOWN>"));
@@ -1002,8 +760,6 @@ static ippool_rcode_t redis_ippool_release(rlm_redis_ippool_t const *inst, REQUE
 	if (ret < 0) goto finish;
 
 finish:
-	fr_redis_reply_free(&reply);
-
 	return ret;
 }
 
@@ -1046,65 +802,167 @@ static inline ssize_t ippool_pool_name(uint8_t const **out, uint8_t buff[], size
 	return slen;
 }
 
-static rlm_rcode_t mod_action(rlm_redis_ippool_t const *inst, REQUEST *request, ippool_action_t action)
+/** Free any replies we still own
+ *
+ */
+static int _ippool_rctx_free(ippool_rctx_t *r)
 {
-	uint8_t		key_prefix_buff[IPPOOL_MAX_KEY_PREFIX_SIZE], device_id_buff[256], gateway_id_buff[256];
-	uint8_t const	*key_prefix, *device_id = NULL, *gateway_id = NULL;
-	size_t		key_prefix_len, device_id_len = 0, gateway_id_len = 0;
-	ssize_t		slen;
-	fr_ipaddr_t	ip;
-	char		expires_buff[20];
-	char const	*expires_str;
-	unsigned long	expires = 0;
-	char		*q;
-
-	slen = ippool_pool_name(&key_prefix, (uint8_t *)&key_prefix_buff, sizeof(key_prefix_len), inst, request);
-	if (slen < 0) return RLM_MODULE_FAIL;
-	if (slen == 0) return RLM_MODULE_NOOP;
+	if (r->reply) fr_redis_reply_free(&r->reply);
+	if (r->wait_reply) fr_redis_reply_free(&r->wait_reply);
 
-	key_prefix_len = (size_t)slen;
+	return 0;
+}
 
-	if (inst->device_id) {
-		slen = tmpl_expand((char const **)&device_id,
-				   (char *)&device_id_buff, sizeof(device_id_buff),
-				   request, inst->device_id, NULL, NULL);
-		if (slen < 0) {
-			REDEBUG("Failed expanding device (%s)", inst->device_id->name);
-			return RLM_MODULE_FAIL;
-		}
-		device_id_len = (size_t)slen;
+/** Record the replies to the script and WAIT commands, and mark the request as runnable
+ *
+ */
+static void ippool_command_set_complete(REQUEST *request, fr_dlist_head_t *completed, void *rctx)
+{
+	ippool_rctx_t		*r = talloc_get_type_abort(rctx, ippool_rctx_t);
+	fr_redis_command_t	*cmd;
+
+	cmd = fr_dlist_head(completed);
+	if (cmd) {
+		r->reply = fr_redis_command_steal_result(cmd);
+		cmd = fr_dlist_next(completed, cmd);
+		if (cmd) r->wait_reply = fr_redis_command_steal_result(cmd);
 	}
+	r->cmds = NULL;
 
-	if (inst->gateway_id) {
-		slen = tmpl_expand((char const **)&gateway_id,
-				   (char *)&gateway_id_buff, sizeof(gateway_id_buff),
-				   request, inst->gateway_id, NULL, NULL);
-		if (slen < 0) {
-			REDEBUG("Failed expanding gateway (%s)", inst->gateway_id->name);
-			return RLM_MODULE_FAIL;
-		}
-		gateway_id_len = (size_t)slen;
-	}
+	unlang_interpret_resumable(request);
+}
 
-	switch (action) {
+/** The commands couldn't be sent, or the connection failed before we got a response
+ *
+ */
+static void ippool_command_set_fail(REQUEST *request, UNUSED fr_dlist_head_t *completed, void *rctx)
+{
+	ippool_rctx_t		*r = talloc_get_type_abort(rctx, ippool_rctx_t);
+
+	r->failed = true;
+	r->cmds = NULL;
+
+	unlang_interpret_resumable(request);
+}
+
+/** Build the commands for a pool action, and enqueue them on the node responsible for the pool
+ *
+ * The first time around the script is called with EVALSHA.  If the node
+ * doesn't have the script cached, we're called again with script_sent
+ * set, and the script body is sent with EVAL, which also caches it.
+ *
+ * @param[in] inst	This instance of the rlm_redis_ippool module.
+ * @param[in] t		Thread specific data.
+ * @param[in] request	The current request.
+ * @param[in] r		Resume context holding the expanded arguments.
+ * @return
+ *	- RLM_MODULE_YIELD if the commands were enqueued.
+ *	- RLM_MODULE_FAIL on error.
+ */
+static rlm_rcode_t ippool_enqueue(rlm_redis_ippool_t const *inst, rlm_redis_ippool_thread_t *t,
+				  REQUEST *request, ippool_rctx_t *r)
+{
+	fr_redis_command_set_t		*cmds;
+	fr_redis_pipeline_status_t	ret;
+	char const			*eval = r->script_sent ? "EVAL" : "EVALSHA";
+	char				ip_buff[FR_IPADDR_PREFIX_STRLEN];
+	bool				ip_integer = (r->ip.af == AF_INET) && inst->ipv4_integer;
+
+	/*
+	 *	hiredis doesn't deal well with NULL string pointers
+	 */
+	uint8_t const			*device_id = r->device_id ? r->device_id : (uint8_t const *)"";
+	uint8_t const			*gateway_id = r->gateway_id ? r->gateway_id : (uint8_t const *)"";
+
+	if ((r->action != POOL_ACTION_ALLOCATE) && !ip_integer) IPPOOL_SPRINT_IP(ip_buff, &r->ip, r->ip.prefix);
+
+	MEM(cmds = fr_redis_command_set_alloc(NULL, request, ippool_command_set_complete, ippool_command_set_fail, r));
+
+	switch (r->action) {
 	case POOL_ACTION_ALLOCATE:
-		if (tmpl_expand(&expires_str, expires_buff, sizeof(expires_buff),
-				request, inst->offer_time, NULL, NULL) < 0) {
-			REDEBUG("Failed expanding offer_time (%s)", inst->offer_time->name);
-			return RLM_MODULE_FAIL;
+		ret = fr_redis_command_add(cmds, "%s %s 1 %b %u %u %b %b",
+					   eval, r->script_sent ? lua_alloc_cmd : lua_alloc_digest,
+					   r->key_prefix, r->key_prefix_len,
+					   r->now, r->expires,
+					   device_id, r->device_id_len,
+					   gateway_id, r->gateway_id_len);
+		break;
+
+	case POOL_ACTION_UPDATE:
+		if (ip_integer) {
+			ret = fr_redis_command_add(cmds, "%s %s 1 %b %u %u %u %b %b",
+						   eval, r->script_sent ? lua_update_cmd : lua_update_digest,
+						   r->key_prefix, r->key_prefix_len,
+						   r->now, r->expires,
+						   htonl(r->ip.addr.v4.s_addr),
+						   device_id, r->device_id_len,
+						   gateway_id, r->gateway_id_len);
+		} else {
+			ret = fr_redis_command_add(cmds, "%s %s 1 %b %u %u %s %b %b",
+						   eval, r->script_sent ? lua_update_cmd : lua_update_digest,
+						   r->key_prefix, r->key_prefix_len,
+						   r->now, r->expires,
+						   ip_buff,
+						   device_id, r->device_id_len,
+						   gateway_id, r->gateway_id_len);
 		}
+		break;
 
-		expires = strtoul(expires_str, &q, 10);
-		if (q != (expires_str + strlen(expires_str))) {
-			REDEBUG("Invalid offer_time.  Must be an integer value");
-			return RLM_MODULE_FAIL;
+	case POOL_ACTION_RELEASE:
+		if (ip_integer) {
+			ret = fr_redis_command_add(cmds, "%s %s 1 %b %u %u %b",
+						   eval, r->script_sent ? lua_release_cmd : lua_release_digest,
+						   r->key_prefix, r->key_prefix_len,
+						   r->now,
+						   htonl(r->ip.addr.v4.s_addr),
+						   device_id, r->device_id_len);
+		} else {
+			ret = fr_redis_command_add(cmds, "%s %s 1 %b %u %s %b",
+						   eval, r->script_sent ? lua_release_cmd : lua_release_digest,
+						   r->key_prefix, r->key_prefix_len,
+						   r->now,
+						   ip_buff,
+						   device_id, r->device_id_len);
 		}
+		break;
 
-		ippool_action_print(request, action, L_DBG_LVL_2, key_prefix, key_prefix_len, NULL,
-				    device_id, device_id_len, gateway_id, gateway_id_len, expires);
-		switch (redis_ippool_allocate(inst, request, key_prefix, key_prefix_len,
-					      device_id, device_id_len,
-					      gateway_id, gateway_id_len, (uint32_t)expires)) {
+	default:
+		fr_assert(0);
+		ret = FR_REDIS_PIPELINE_FAIL;
+		break;
+	}
+	if (ret != FR_REDIS_PIPELINE_OK) {
+	error:
+		talloc_free(cmds);
+		return RLM_MODULE_FAIL;
+	}
+
+	if (inst->wait_num) {
+		ret = fr_redis_command_add(cmds, "WAIT %u %u",
+					   inst->wait_num, (unsigned int)fr_time_delta_to_msec(inst->wait_timeout));
+		if (ret != FR_REDIS_PIPELINE_OK) goto error;
+	}
+
+	RDEBUG3("Calling script 0x%s", r->action == POOL_ACTION_ALLOCATE ? lua_alloc_digest :
+		r->action == POOL_ACTION_UPDATE ? lua_update_digest : lua_release_digest);
+
+	if (fr_redis_command_set_enqueue(t->cluster, cmds, r->key_prefix, r->key_prefix_len) != FR_REDIS_PIPELINE_OK) {
+		REDEBUG("Failed enqueueing commands");
+		goto error;
+	}
+	r->cmds = cmds;
+
+	return RLM_MODULE_YIELD;
+}
+
+/** Convert the result of a pool action into a module rcode
+ *
+ */
+static rlm_rcode_t ippool_action_result(rlm_redis_ippool_t const *inst, REQUEST *request, ippool_rctx_t *r)
+{
+	switch (r->action) {
+	case POOL_ACTION_ALLOCATE:
+		switch (redis_ippool_allocate(inst, request, r->reply)) {
 		case IPPOOL_RCODE_SUCCESS:
 			RDEBUG2("IP address lease allocated");
 			return RLM_MODULE_UPDATED;
@@ -1118,39 +976,9 @@ static rlm_rcode_t mod_action(rlm_redis_ippool_t const *inst, REQUEST *request,
 		}
 
 	case POOL_ACTION_UPDATE:
-	{
-		char		ip_buff[INET6_ADDRSTRLEN + 4];
-		char const	*ip_str;
-
-		if (tmpl_expand(&expires_str, expires_buff, sizeof(expires_buff),
-				request, inst->lease_time, NULL, NULL) < 0) {
-			REDEBUG("Failed expanding lease_time (%s)", inst->lease_time->name);
-			return RLM_MODULE_FAIL;
-		}
-
-		expires = strtoul(expires_str, &q, 10);
-		if (q != (expires_str + strlen(expires_str))) {
-			REDEBUG("Invalid expires.  Must be an integer value");
-			return RLM_MODULE_FAIL;
-		}
-
-		if (tmpl_expand(&ip_str, ip_buff, sizeof(ip_buff), request, inst->requested_address, NULL, NULL) < 0) {
-			REDEBUG("Failed expanding requested_address (%s)", inst->requested_address->name);
-			return RLM_MODULE_FAIL;
-		}
-
-		if (fr_inet_pton(&ip, ip_str, -1, AF_UNSPEC, false, true) < 0) {
-			RPEDEBUG("Failed parsing address");
-			return RLM_MODULE_FAIL;
-		}
-
-		ippool_action_print(request, action, L_DBG_LVL_2, key_prefix, key_prefix_len,
-				    ip_str, device_id, device_id_len, gateway_id, gateway_id_len, expires);
-		switch (redis_ippool_update(inst, request, key_prefix, key_prefix_len,
-					    &ip, device_id, device_id_len,
-					    gateway_id, gateway_id_len, (uint32_t)expires)) {
+		switch (redis_ippool_update(inst, request, r->reply, r->expires)) {
 		case IPPOOL_RCODE_SUCCESS:
-			RDEBUG2("Requested IP address' \"%s\" lease updated", ip_str);
+			RDEBUG2("Requested IP address' \"%s\" lease updated", r->ip_str);
 
 			/*
 			 *	Copy over the input IP address to the reply attribute
@@ -1167,7 +995,7 @@ static rlm_rcode_t mod_action(rlm_redis_ippool_t const *inst, REQUEST *request,
 					.rhs = &ip_rhs
 				};
 
-				fr_value_box_strdup_shallow(&ip_rhs.data.literal, NULL, ip_str, false);
+				fr_value_box_strdup_shallow(&ip_rhs.data.literal, NULL, r->ip_str, false);
 
 				if (map_to_request(request, &ip_map, map_to_vp, NULL) < 0) return RLM_MODULE_FAIL;
 			}
@@ -1179,43 +1007,25 @@ static rlm_rcode_t mod_action(rlm_redis_ippool_t const *inst, REQUEST *request,
 		 *	be found.  This extremely useful for migrations.
 		 */
 		case IPPOOL_RCODE_NOT_FOUND:
-			REDEBUG("Requested IP address \"%s\" is not a member of the specified pool", ip_str);
+			REDEBUG("Requested IP address \"%s\" is not a member of the specified pool", r->ip_str);
 			return RLM_MODULE_NOTFOUND;
 
 		case IPPOOL_RCODE_EXPIRED:
-			REDEBUG("Requested IP address' \"%s\" lease already expired at time of renewal", ip_str);
+			REDEBUG("Requested IP address' \"%s\" lease already expired at time of renewal", r->ip_str);
 			return RLM_MODULE_INVALID;
 
 		case IPPOOL_RCODE_DEVICE_MISMATCH:
-			REDEBUG("Requested IP address' \"%s\" lease allocated to another device", ip_str);
+			REDEBUG("Requested IP address' \"%s\" lease allocated to another device", r->ip_str);
 			return RLM_MODULE_INVALID;
 
 		default:
 			return RLM_MODULE_FAIL;
 		}
-	}
 
 	case POOL_ACTION_RELEASE:
-	{
-		char		ip_buff[INET6_ADDRSTRLEN + 4];
-		char const	*ip_str;
-
-		if (tmpl_expand(&ip_str, ip_buff, sizeof(ip_buff), request, inst->requested_address, NULL, NULL) < 0) {
-			REDEBUG("Failed expanding requested_address (%s)", inst->requested_address->name);
-			return RLM_MODULE_FAIL;
-		}
-
-		if (fr_inet_pton(&ip, ip_str, -1, AF_UNSPEC, false, true) < 0) {
-			RPEDEBUG("Failed parsing address");
-			return RLM_MODULE_FAIL;
-		}
-
-		ippool_action_print(request, action, L_DBG_LVL_2, key_prefix, key_prefix_len,
-				    ip_str, device_id, device_id_len, gateway_id, gateway_id_len, 0);
-		switch (redis_ippool_release(inst, request, key_prefix, key_prefix_len,
-					     &ip, device_id, device_id_len)) {
+		switch (redis_ippool_release(request, r->reply)) {
 		case IPPOOL_RCODE_SUCCESS:
-			RDEBUG2("IP address \"%s\" released", ip_str);
+			RDEBUG2("IP address \"%s\" released", r->ip_str);
 			return RLM_MODULE_UPDATED;
 
 		/*
@@ -1224,43 +1034,252 @@ static rlm_rcode_t mod_action(rlm_redis_ippool_t const *inst, REQUEST *request,
 		 *	be found.  This extremely useful for migrations.
 		 */
 		case IPPOOL_RCODE_NOT_FOUND:
-			REDEBUG("Requested IP address \"%s\" is not a member of the specified pool", ip_str);
+			REDEBUG("Requested IP address \"%s\" is not a member of the specified pool", r->ip_str);
 			return RLM_MODULE_NOTFOUND;
 
 		case IPPOOL_RCODE_DEVICE_MISMATCH:
-			REDEBUG("Requested IP address' \"%s\" lease allocated to another device", ip_str);
+			REDEBUG("Requested IP address' \"%s\" lease allocated to another device", r->ip_str);
 			return RLM_MODULE_INVALID;
 
 		default:
 			return RLM_MODULE_FAIL;
 		}
+
+	default:
+		fr_assert(0);
+		return RLM_MODULE_FAIL;
 	}
+}
+
+static void mod_action_signal(UNUSED module_ctx_t const *mctx, UNUSED REQUEST *request,
+			      void *rctx, fr_state_signal_t action)
+{
+	ippool_rctx_t		*r = talloc_get_type_abort(rctx, ippool_rctx_t);
+
+	if (action != FR_SIGNAL_CANCEL) return;
+
+	/*
+	 *	Responses to any commands already
+	 *	sent will be discarded.
+	 */
+	if (r->cmds) fr_redis_command_set_signal_cancel(r->cmds);
+	talloc_free(r);
+}
+
+/** Process the replies to a pool action
+ *
+ */
+static rlm_rcode_t mod_action_resume(module_ctx_t const *mctx, REQUEST *request, void *rctx)
+{
+	rlm_redis_ippool_t const	*inst = talloc_get_type_abort_const(mctx->instance, rlm_redis_ippool_t);
+	rlm_redis_ippool_thread_t	*t = talloc_get_type_abort(mctx->thread, rlm_redis_ippool_thread_t);
+	ippool_rctx_t			*r = talloc_get_type_abort(rctx, ippool_rctx_t);
+	fr_redis_rcode_t		status;
+	rlm_rcode_t			rcode;
+
+	if (r->failed || !r->reply) {
+		REDEBUG("Failed executing script, no response from Redis");
+		rcode = RLM_MODULE_FAIL;
+		goto finish;
+	}
+
+	if (RDEBUG_ENABLED3) {
+		fr_redis_reply_print(L_DBG_LVL_3, r->reply, request, 0);
+		if (r->wait_reply) fr_redis_reply_print(L_DBG_LVL_3, r->wait_reply, request, 1);
+	}
+
+	status = fr_redis_command_status(NULL, r->reply);
+
+	/*
+	 *	The node doesn't have the script cached,
+	 *	send it the script body.
+	 */
+	if ((status == REDIS_RCODE_NO_SCRIPT) && !r->script_sent) {
+		RDEBUG3("Loading script");
+
+		fr_redis_reply_free(&r->reply);
+		if (r->wait_reply) fr_redis_reply_free(&r->wait_reply);
+		r->script_sent = true;
+
+		rcode = ippool_enqueue(inst, t, request, r);
+		if (rcode == RLM_MODULE_YIELD) return unlang_module_yield(request, mod_action_resume, mod_action_signal, r);
+		goto finish;
+	}
+
+	if (status != REDIS_RCODE_SUCCESS) {
+		RPEDEBUG("Failed executing script");
+		rcode = RLM_MODULE_FAIL;
+		goto finish;
+	}
+
+	if (r->wait_reply && (ippool_wait_check(request, inst->wait_num, r->wait_reply) < 0)) {
+		rcode = RLM_MODULE_FAIL;
+		goto finish;
+	}
+
+	rcode = ippool_action_result(inst, request, r);
+
+finish:
+	talloc_free(r);
+
+	return rcode;
+}
+
+/** Expand the arguments for a pool action, and send the commands to the cluster
+ *
+ * The request yields until the cluster node responds, so the worker can
+ * continue processing other requests.  Commands from concurrent requests
+ * for pools on the same node are pipelined on the same connection.
+ */
+static rlm_rcode_t mod_action(rlm_redis_ippool_t const *inst, rlm_redis_ippool_thread_t *t,
+			      REQUEST *request, ippool_action_t action)
+{
+	uint8_t		key_prefix_buff[IPPOOL_MAX_KEY_PREFIX_SIZE], device_id_buff[256], gateway_id_buff[256];
+	uint8_t const	*key_prefix, *device_id = NULL, *gateway_id = NULL;
+	size_t		key_prefix_len, device_id_len = 0, gateway_id_len = 0;
+	ssize_t		slen;
+	char		expires_buff[20];
+	char const	*expires_str;
+	unsigned long	expires = 0;
+	char		*q;
+	ippool_rctx_t	*r;
+	rlm_rcode_t	rcode;
+
+	slen = ippool_pool_name(&key_prefix, (uint8_t *)&key_prefix_buff, sizeof(key_prefix_buff), inst, request);
+	if (slen < 0) return RLM_MODULE_FAIL;
+	if (slen == 0) return RLM_MODULE_NOOP;
+
+	key_prefix_len = (size_t)slen;
+
+	if (inst->device_id) {
+		slen = tmpl_expand((char const **)&device_id,
+				   (char *)&device_id_buff, sizeof(device_id_buff),
+				   request, inst->device_id, NULL, NULL);
+		if (slen < 0) {
+			REDEBUG("Failed expanding device (%s)", inst->device_id->name);
+			return RLM_MODULE_FAIL;
+		}
+		device_id_len = (size_t)slen;
+	}
+
+	if (inst->gateway_id) {
+		slen = tmpl_expand((char const **)&gateway_id,
+				   (char *)&gateway_id_buff, sizeof(gateway_id_buff),
+				   request, inst->gateway_id, NULL, NULL);
+		if (slen < 0) {
+			REDEBUG("Failed expanding gateway (%s)", inst->gateway_id->name);
+			return RLM_MODULE_FAIL;
+		}
+		gateway_id_len = (size_t)slen;
+	}
+
+	MEM(r = talloc_zero(request, ippool_rctx_t));
+	talloc_set_destructor(r, _ippool_rctx_free);
+	r->action = action;
+	r->now = (uint32_t)fr_time_to_sec(fr_time());
+
+	switch (action) {
+	case POOL_ACTION_ALLOCATE:
+		if (tmpl_expand(&expires_str, expires_buff, sizeof(expires_buff),
+				request, inst->offer_time, NULL, NULL) < 0) {
+			REDEBUG("Failed expanding offer_time (%s)", inst->offer_time->name);
+		error:
+			talloc_free(r);
+			return RLM_MODULE_FAIL;
+		}
+
+		expires = strtoul(expires_str, &q, 10);
+		if (q != (expires_str + strlen(expires_str))) {
+			REDEBUG("Invalid offer_time.  Must be an integer value");
+			goto error;
+		}
+
+		ippool_action_print(request, action, L_DBG_LVL_2, key_prefix, key_prefix_len, NULL,
+				    device_id, device_id_len, gateway_id, gateway_id_len, expires);
+		break;
+
+	case POOL_ACTION_UPDATE:
+	case POOL_ACTION_RELEASE:
+	{
+		char		ip_buff[INET6_ADDRSTRLEN + 4];
+		char const	*ip_str;
+
+		if (action == POOL_ACTION_UPDATE) {
+			if (tmpl_expand(&expires_str, expires_buff, sizeof(expires_buff),
+					request, inst->lease_time, NULL, NULL) < 0) {
+				REDEBUG("Failed expanding lease_time (%s)", inst->lease_time->name);
+				goto error;
+			}
+
+			expires = strtoul(expires_str, &q, 10);
+			if (q != (expires_str + strlen(expires_str))) {
+				REDEBUG("Invalid expires.  Must be an integer value");
+				goto error;
+			}
+		}
+
+		if (tmpl_expand(&ip_str, ip_buff, sizeof(ip_buff), request, inst->requested_address, NULL, NULL) < 0) {
+			REDEBUG("Failed expanding requested_address (%s)", inst->requested_address->name);
+			goto error;
+		}
+
+		if (fr_inet_pton(&r->ip, ip_str, -1, AF_UNSPEC, false, true) < 0) {
+			RPEDEBUG("Failed parsing address");
+			goto error;
+		}
+		MEM(r->ip_str = talloc_typed_strdup(r, ip_str));
+
+		ippool_action_print(request, action, L_DBG_LVL_2, key_prefix, key_prefix_len,
+				    ip_str, device_id, device_id_len, gateway_id, gateway_id_len, expires);
+	}
+		break;
 
 	case POOL_ACTION_BULK_RELEASE:
 		RDEBUG2("Bulk release not yet implemented");
+		talloc_free(r);
 		return RLM_MODULE_NOOP;
 
 	default:
 		fr_assert(0);
-		return RLM_MODULE_FAIL;
+		goto error;
+	}
+
+	r->expires = (uint32_t)expires;
+	MEM(r->key_prefix = talloc_memdup(r, key_prefix, key_prefix_len));
+	r->key_prefix_len = key_prefix_len;
+	if (device_id) {
+		MEM(r->device_id = talloc_memdup(r, device_id, device_id_len ? device_id_len : 1));
+		r->device_id_len = device_id_len;
+	}
+	if (gateway_id) {
+		MEM(r->gateway_id = talloc_memdup(r, gateway_id, gateway_id_len ? gateway_id_len : 1));
+		r->gateway_id_len = gateway_id_len;
 	}
+
+	rcode = ippool_enqueue(inst, t, request, r);
+	if (rcode == RLM_MODULE_YIELD) return unlang_module_yield(request, mod_action_resume, mod_action_signal, r);
+
+	talloc_free(r);
+
+	return rcode;
 }
 
 static rlm_rcode_t CC_HINT(nonnull) mod_accounting(module_ctx_t const *mctx, REQUEST *request)
 {
 	rlm_redis_ippool_t const	*inst = talloc_get_type_abort_const(mctx->instance, rlm_redis_ippool_t);
+	rlm_redis_ippool_thread_t	*t = talloc_get_type_abort(mctx->thread, rlm_redis_ippool_thread_t);
 	VALUE_PAIR			*vp;
 
 	/*
 	 *	Pool-Action override
 	 */
-	vp = fr_pair_find_by_da(request->control, attr_pool_action, TAG_ANY);
-	if (vp) return mod_action(inst, request, vp->vp_uint32);
+	vp = fr_pair_list_find_by_da(&request->control, attr_pool_action, TAG_ANY);
+	if (vp) return mod_action(inst, t, request, vp->vp_uint32);
 
 	/*
 	 *	Otherwise, guess the action by Acct-Status-Type
 	 */
-	vp = fr_pair_find_by_da(request->packet->vps, attr_acct_status_type, TAG_ANY);
+	vp = fr_pair_list_find_by_da(&request->packet->vps, attr_acct_status_type, TAG_ANY);
 	if (!vp) {
 		RDEBUG2("Couldn't find &request:Acct-Status-Type or &control:Pool-Action, doing nothing...");
 		return RLM_MODULE_NOOP;
@@ -1269,14 +1288,14 @@ static rlm_rcode_t CC_HINT(nonnull) mod_accounting(module_ctx_t const *mctx, REQ
 	switch (vp->vp_uint32) {
 	case FR_STATUS_START:
 	case FR_STATUS_ALIVE:
-		return mod_action(inst, request, POOL_ACTION_UPDATE);
+		return mod_action(inst, t, request, POOL_ACTION_UPDATE);
 
 	case FR_STATUS_STOP:
-		return mod_action(inst, request, POOL_ACTION_RELEASE);
+		return mod_action(inst, t, request, POOL_ACTION_RELEASE);
 
 	case FR_STATUS_ACCOUNTING_OFF:
 	case FR_STATUS_ACCOUNTING_ON:
-		return mod_action(inst, request, POOL_ACTION_BULK_RELEASE);
+		return mod_action(inst, t, request, POOL_ACTION_BULK_RELEASE);
 
 	default:
 		return RLM_MODULE_NOOP;
@@ -1286,19 +1305,21 @@ static rlm_rcode_t CC_HINT(nonnull) mod_accounting(module_ctx_t const *mctx, REQ
 static rlm_rcode_t CC_HINT(nonnull) mod_authorize(module_ctx_t const *mctx, REQUEST *request)
 {
 	rlm_redis_ippool_t const	*inst = talloc_get_type_abort_const(mctx->instance, rlm_redis_ippool_t);
+	rlm_redis_ippool_thread_t	*t = talloc_get_type_abort(mctx->thread, rlm_redis_ippool_thread_t);
 	VALUE_PAIR			*vp;
 
 	/*
 	 *	Unless it's overridden the default action is to allocate
 	 *	when called in Post-Auth.
 	 */
-	vp = fr_pair_find_by_da(request->control, attr_pool_action, TAG_ANY);
-	return mod_action(inst, request, vp ? vp->vp_uint32 : POOL_ACTION_ALLOCATE);
+	vp = fr_pair_list_find_by_da(&request->control, attr_pool_action, TAG_ANY);
+	return mod_action(inst, t, request, vp ? vp->vp_uint32 : POOL_ACTION_ALLOCATE);
 }
 
 static rlm_rcode_t CC_HINT(nonnull) mod_post_auth(module_ctx_t const *mctx, REQUEST *request)
 {
 	rlm_redis_ippool_t const	*inst = talloc_get_type_abort_const(mctx->instance, rlm_redis_ippool_t);
+	rlm_redis_ippool_thread_t	*t = talloc_get_type_abort(mctx->thread, rlm_redis_ippool_thread_t);
 	VALUE_PAIR			*vp;
 	ippool_action_t			action = POOL_ACTION_ALLOCATE;
 
@@ -1306,7 +1327,7 @@ static rlm_rcode_t CC_HINT(nonnull) mod_post_auth(module_ctx_t const *mctx, REQU
 	 *	Unless it's overridden the default action is to allocate
 	 *	when called in Post-Auth.
 	 */
-	vp = fr_pair_find_by_da(request->control, attr_pool_action, TAG_ANY);
+	vp = fr_pair_list_find_by_da(&request->control, attr_pool_action, TAG_ANY);
 	if (vp) {
 		if ((vp->vp_uint32 > 0) && (vp->vp_uint32 <= POOL_ACTION_BULK_RELEASE)) {
 			action = vp->vp_uint32;
@@ -1317,19 +1338,20 @@ static rlm_rcode_t CC_HINT(nonnull) mod_post_auth(module_ctx_t const *mctx, REQU
 		}
 
 	} else if (request->dict == dict_dhcpv4) {
-		vp = fr_pair_find_by_da(request->control, attr_message_type, TAG_ANY);
+		vp = fr_pair_list_find_by_da(&request->control, attr_message_type, TAG_ANY);
 		if (!vp) goto run;
 
 		if (vp->vp_uint8 == FR_DHCP_REQUEST) action = POOL_ACTION_UPDATE;
 	}
 
 run:
-	return mod_action(inst, request, action);
+	return mod_action(inst, t, request, action);
 }
 
 static rlm_rcode_t CC_HINT(nonnull) mod_request(module_ctx_t const *mctx, REQUEST *request)
 {
 	rlm_redis_ippool_t const	*inst = talloc_get_type_abort_const(mctx->instance, rlm_redis_ippool_t);
+	rlm_redis_ippool_thread_t	*t = talloc_get_type_abort(mctx->thread, rlm_redis_ippool_thread_t);
 	VALUE_PAIR			*vp;
 
 	/*
@@ -1337,8 +1359,8 @@ static rlm_rcode_t CC_HINT(nonnull) mod_request(module_ctx_t const *mctx, REQUES
 	 *	when called by DHCP request
 	 */
 
-	vp = fr_pair_find_by_da(request->control, attr_pool_action, TAG_ANY);
-	return mod_action(inst, request, vp ? vp->vp_uint32 : POOL_ACTION_UPDATE);
+	vp = fr_pair_list_find_by_da(&request->control, attr_pool_action, TAG_ANY);
+	return mod_action(inst, t, request, vp ? vp->vp_uint32 : POOL_ACTION_UPDATE);
 }
 
 static int mod_instantiate(void *instance, CONF_SECTION *conf)
@@ -1391,6 +1413,30 @@ static int mod_instantiate(void *instance, CONF_SECTION *conf)
 	return 0;
 }
 
+static int mod_thread_instantiate(UNUSED CONF_SECTION const *cs, void *instance, fr_event_list_t *el, void *thread)
+{
+	rlm_redis_ippool_t		*inst = talloc_get_type_abort(instance, rlm_redis_ippool_t);
+	rlm_redis_ippool_thread_t	*t = talloc_get_type_abort(thread, rlm_redis_ippool_thread_t);
+
+	t->cluster = fr_redis_cluster_thread_alloc(t, el, inst->cluster, &inst->trunk_conf);
+	if (!t->cluster) return -1;
+
+	return 0;
+}
+
+static int mod_thread_detach(UNUSED fr_event_list_t *el, void *thread)
+{
+	rlm_redis_ippool_thread_t	*t = talloc_get_type_abort(thread, rlm_redis_ippool_thread_t);
+
+	/*
+	 *	Close the trunk connections before
+	 *	the event list goes away.
+	 */
+	TALLOC_FREE(t->cluster);
+
+	return 0;
+}
+
 static int mod_load(void)
 {
 	fr_redis_version_print();
@@ -1407,6 +1453,11 @@ module_t rlm_redis_ippool = {
 	.config		= module_config,
 	.onload		= mod_load,
 	.instantiate	= mod_instantiate,
+
+	.thread_inst_size = sizeof(rlm_redis_ippool_thread_t),
+	.thread_inst_type = "rlm_redis_ippool_thread_t",
+	.thread_instantiate = mod_thread_instantiate,
+	.thread_detach	= mod_thread_detach,
 	.methods = {
 		[MOD_ACCOUNTING]	= mod_accounting,
 		[MOD_AUTHORIZE]		= mod_authorize,
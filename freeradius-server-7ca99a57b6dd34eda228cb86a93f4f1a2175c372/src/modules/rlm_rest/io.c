@@ -26,10 +26,65 @@
 #include <freeradius-devel/server/module.h>
 #include <freeradius-devel/unlang/base.h>
 
+/** Get an idle easy handle, allocating a new one if there are none
+ *
+ * @param[in] t		Thread instance the handle will be used with.
+ * @param[in] request	The current request.
+ * @return
+ *	- A handle ready to be configured.
+ *	- NULL if max_requests would be exceeded, or allocation failed.
+ */
+fr_curl_io_request_t *rest_io_handle_get(rlm_rest_thread_t *t, REQUEST *request)
+{
+	rlm_rest_t const	*inst = t->inst;
+	rlm_rest_curl_context_t	*curl_ctx;
+	fr_curl_io_request_t	*randle;
+
+	if (inst->max_requests && (t->active >= inst->max_requests)) {
+		REDEBUG("Too many requests in flight (%u), increase connection.max_requests", t->active);
+		return NULL;
+	}
+
+	curl_ctx = fr_dlist_pop_head(&t->idle);
+	if (curl_ctx) {
+		randle = curl_ctx->randle;
+	} else {
+		randle = rest_handle_alloc(t, inst);
+		if (!randle) {
+			REDEBUG("Failed allocating curl handle");
+			return NULL;
+		}
+	}
+	t->active++;
+
+	return randle;
+}
+
+/** Reset a handle, and return it to the thread's idle list
+ *
+ * Handles are pushed onto the head of the list, so the most recently
+ * used handle is reused first.
+ *
+ * @param[in] t		Thread instance the handle belongs to.
+ * @param[in] randle	to release.
+ */
+void rest_io_handle_release(rlm_rest_thread_t *t, fr_curl_io_request_t *randle)
+{
+	rlm_rest_curl_context_t	*curl_ctx = talloc_get_type_abort(randle->uctx, rlm_rest_curl_context_t);
+
+	rest_request_cleanup(t->inst, randle);
+	randle->request = NULL;
+
+	fr_assert(t->active > 0);
+	t->active--;
+
+	fr_dlist_insert_head(&t->idle, curl_ctx);
+}
+
 /** Handle asynchronous cancellation of a request
  *
  * If we're signalled that the request has been cancelled (FR_SIGNAL_CANCEL).
- * Cleanup any pending state and release the connection handle back into the pool.
+ * Cleanup any pending state and return the handle to the idle list.
  */
 void rest_io_module_action(module_ctx_t const *mctx, REQUEST *request, void *rctx, fr_state_signal_t action)
 {
@@ -48,14 +103,13 @@ void rest_io_module_action(module_ctx_t const *mctx, REQUEST *request, void *rct
 	}
 	t->mhandle->transfers--;
 
-	rest_request_cleanup(mctx->instance, randle);
-	fr_pool_connection_release(t->pool, request, randle);
+	rest_io_handle_release(t, randle);
 }
 
 /** Handle asynchronous cancellation of a request
  *
  * If we're signalled that the request has been cancelled (FR_SIGNAL_CANCEL).
- * Cleanup any pending state and release the connection handle back into the pool.
+ * Cleanup any pending state and return the handle to the idle list.
  */
 void rest_io_xlat_signal(REQUEST *request, UNUSED void *instance, void *thread, void *rctx, fr_state_signal_t action)
 {
@@ -35,7 +35,6 @@ RCSID("$Id$")
 #include <freeradius-devel/util/debug.h>
 #include <freeradius-devel/server/base.h>
 #include <freeradius-devel/util/base.h>
-#include <freeradius-devel/server/pool.h>
 
 #include "rest.h"
 
@@ -232,41 +231,25 @@ typedef struct {
 } json_flags_t;
 #endif
 
-/** Frees a libcurl handle, and any additional memory used by context data.
- *
- * @param[in] randle fr_curl_io_request_t to close and free.
- * @return returns true.
- */
-static int _mod_conn_free(fr_curl_io_request_t *randle)
-{
-	curl_easy_cleanup(randle->candle);
-
-	return 0;
-}
-
-/** Creates a new connection handle for use by the FR connection API.
- *
- * Matches the fr_pool_connection_create_t function prototype, is passed to
- * fr_pool_init, and called when a new connection is required by the
- * connection pool API.
+/** Creates a new curl easy handle, and the context data rlm_rest needs to use it
  *
  * Creates an instances of fr_curl_io_request_t, and rlm_rest_curl_context_t
  * which hold the context data required for generating requests and parsing
  * responses.
  *
- * If instance->connect_uri is not NULL libcurl will attempt to open a
- * TCP socket to the server specified in the URI. This is done so that when the
- * socket is first used, there will already be a cached TCP connection to the
- * REST server associated with the curl handle.
+ * Handles are owned by a thread, and are returned to its idle list once
+ * a request completes.  Connections belong to the thread's multi handle,
+ * not to the easy handle, so they're reused regardless of which handle
+ * services the next request.
  *
- * @see fr_pool_init
- * @see fr_pool_connection_create_t
- * @see connection.c
+ * @param[in] ctx	to allocate the handle in.
+ * @param[in] inst	of rlm_rest.
+ * @return
+ *	- A new handle.
+ *	- NULL on error.
  */
-void *rest_mod_conn_create(TALLOC_CTX *ctx, void *instance, UNUSED fr_time_delta_t timeout)
+fr_curl_io_request_t *rest_handle_alloc(TALLOC_CTX *ctx, rlm_rest_t const *inst)
 {
-	rlm_rest_t const	*inst = talloc_get_type_abort_const(instance, rlm_rest_t);
-
 	fr_curl_io_request_t	*randle = NULL;
 	rlm_rest_curl_context_t	*curl_ctx = NULL;
 
@@ -276,14 +259,14 @@ void *rest_mod_conn_create(TALLOC_CTX *ctx, void *instance, UNUSED fr_time_delta
 	randle = fr_curl_io_request_alloc(ctx);
 	if (!randle) return NULL;
 
-	curl_ctx = talloc_zero(randle, rlm_rest_curl_context_t);
+	MEM(curl_ctx = talloc_zero(randle, rlm_rest_curl_context_t));
 
+	curl_ctx->randle = randle;
 	curl_ctx->headers = NULL; /* CURL needs this to be NULL */
 	curl_ctx->request.instance = inst;
 	curl_ctx->response.instance = inst;
 
 	randle->uctx = curl_ctx;
-	talloc_set_destructor(randle, _mod_conn_free);
 
 	return randle;
 }
@@ -547,7 +530,7 @@ static size_t rest_encode_json(void *out, size_t size, size_t nmemb, void *userd
 	fr_assert(freespace > 0);
 
 	if (ctx->state == READ_STATE_INIT) {
-		encoded = fr_json_afrom_pair_list(data, request->packet->vps, NULL);
+		encoded = fr_json_afrom_pair_list(data, fr_pair_list_head(&request->packet->vps), NULL);
 		if (!encoded) return -1;
 
 		data->start = data->p = encoded;
@@ -718,7 +701,7 @@ static int rest_decode_post(UNUSED rlm_rest_t const *instance, UNUSED rlm_rest_s
 	while (((q = strchr(p, '=')) != NULL) && (count < REST_BODY_MAX_ATTRS)) {
 		tmpl_t		*dst;
 		REQUEST			*current;
-		VALUE_PAIR		**vps;
+		fr_pair_list_t		*vps;
 		TALLOC_CTX		*ctx;
 		fr_dict_attr_t const	*da;
 		VALUE_PAIR		*vp;
@@ -815,7 +798,7 @@ static int rest_decode_post(UNUSED rlm_rest_t const *instance, UNUSED rlm_rest_s
 			goto skip;
 		}
 
-		fr_pair_add(vps, vp);
+		fr_pair_list_append(vps, vp);
 
 		count++;
 
@@ -1020,7 +1003,8 @@ static int json_pair_alloc(rlm_rest_t const *instance, rlm_rest_section_t const
 		};
 
 		REQUEST		*current = request;
-		VALUE_PAIR	**vps, *vp = NULL;
+		fr_pair_list_t	*vps;
+		VALUE_PAIR	*vp = NULL;
 
 		TALLOC_FREE(dst);
 
@@ -1716,7 +1700,7 @@ error:
  *	- 0 on success (all opts configured).
  *	- -1 on failure.
  */
-int rest_request_config(rlm_rest_t const *inst, rlm_rest_thread_t *t, rlm_rest_section_t const *section,
+int rest_request_config(rlm_rest_t const *inst, UNUSED rlm_rest_thread_t *t, rlm_rest_section_t const *section,
 			REQUEST *request, fr_curl_io_request_t *randle, http_method_t method,
 			http_body_type_t type,
 			char const *uri, char const *username, char const *password)
@@ -1769,7 +1753,7 @@ int rest_request_config(rlm_rest_t const *inst, rlm_rest_thread_t *t, rlm_rest_s
 		}
 	}
 
-	timeout = fr_pool_timeout(t->pool);
+	timeout = inst->connect_timeout;
 	RDEBUG3("Connect timeout is %pVs, request timeout is %pVs",
 	        fr_box_time_delta(timeout), fr_box_time_delta(section->timeout));
 	FR_CURL_SET_OPTION(CURLOPT_CONNECTTIMEOUT_MS, fr_time_delta_to_msec(timeout));
@@ -1795,7 +1779,7 @@ int rest_request_config(rlm_rest_t const *inst, rlm_rest_thread_t *t, rlm_rest_s
 	ctx->headers = curl_slist_append(ctx->headers, buffer);
 	if (!ctx->headers) goto error_header;
 
-	for (header =  fr_cursor_iter_by_da_init(&headers, &request->control, attr_rest_http_header);
+	for (header =  fr_pair_list_cursor_by_da_init(&headers, &request->control, attr_rest_http_header);
 	     header;
 	     header = fr_cursor_next(&headers)) {
 		header = fr_cursor_remove(&headers);
@@ -2024,7 +2008,7 @@ do {\
 
 	case REST_HTTP_BODY_POST:
 		rest_request_init(section, request, &ctx->request);
-		fr_cursor_init(&(ctx->request.cursor), &request->packet->vps);
+		fr_pair_list_cursor_init(&(ctx->request.cursor), &request->packet->vps);
 
 		if (rest_request_config_body(inst, section, request, randle, rest_encode_post) < 0) return -1;
 
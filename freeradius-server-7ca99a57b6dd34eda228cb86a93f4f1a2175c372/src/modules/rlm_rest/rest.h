@@ -28,7 +28,6 @@ RCSIDH(rest_h, "$Id$")
 #include <freeradius-devel/curl/base.h>
 #include <freeradius-devel/curl/config.h>
 #include <freeradius-devel/server/pairmove.h>
-#include <freeradius-devel/server/pool.h>
 
 #define CURL_NO_OLDIES 1
 
@@ -156,7 +155,9 @@ typedef struct {
 	bool			multiplex;	//!< Whether to perform multiple requests using a single
 						///< connection.
 
-	fr_pool_t		*pool;		//!< Pointer to the connection pool.
+	fr_time_delta_t		connect_timeout;	//!< How long to wait for a connection to open.
+	uint32_t		max_requests;	//!< Maximum number of requests each thread may have
+						///< in flight.  0 means unlimited.
 
 	rlm_rest_section_t	xlat;		//!< Configuration specific to xlat.
 	rlm_rest_section_t	authorize;	//!< Configuration specific to authorisation.
@@ -175,9 +176,10 @@ typedef struct {
  */
 typedef struct {
 	rlm_rest_t const	*inst;		//!< Instance of rlm_rest.
-	fr_pool_t		*pool;		//!< Thread specific connection pool.
 	fr_curl_handle_t	*mhandle;	//!< Thread specific multi handle.  Serves as the dispatch
 						//!< and coralling structure for REST requests.
+	fr_dlist_head_t		idle;		//!< Easy handles not currently servicing a request.
+	uint32_t		active;		//!< Easy handles currently servicing a request.
 } rlm_rest_thread_t;
 
 /** Wrapper around the module thread stuct for individual xlats
@@ -251,6 +253,9 @@ typedef struct {
  *	Curl context data
  */
 typedef struct {
+	fr_dlist_t		entry;		//!< Entry in the thread's list of idle handles.
+	fr_curl_io_request_t	*randle;	//!< The easy handle this context belongs to.
+
 	struct curl_slist	*headers;	//!< Any HTTP headers which will be sent with the
 						//!< request.
 
@@ -283,7 +288,7 @@ typedef size_t (*rest_read_t)(void *ptr, size_t size, size_t nmemb,
 			      void *userdata);
 
 
-void *rest_mod_conn_create(TALLOC_CTX *ctx, void *instance, fr_time_delta_t timeout);
+fr_curl_io_request_t *rest_handle_alloc(TALLOC_CTX *ctx, rlm_rest_t const *inst);
 
 /*
  *	Request processing API
@@ -320,5 +325,7 @@ ssize_t rest_uri_host_unescape(char **out, UNUSED rlm_rest_t const *mod_inst, RE
 /*
  *	Async IO helpers
  */
+fr_curl_io_request_t *rest_io_handle_get(rlm_rest_thread_t *t, REQUEST *request);
+void rest_io_handle_release(rlm_rest_thread_t *t, fr_curl_io_request_t *randle);
 void rest_io_module_action(module_ctx_t const *mctx, REQUEST *request, void *rctx, fr_state_signal_t action);
 void rest_io_xlat_signal(REQUEST *request, void *xlat_inst, void *xlat_thread_inst, void *rctx, fr_state_signal_t action);
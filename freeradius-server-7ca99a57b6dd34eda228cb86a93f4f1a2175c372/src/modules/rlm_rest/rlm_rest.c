@@ -103,8 +103,15 @@ static const CONF_PARSER xlat_config[] = {
 	CONF_PARSER_TERMINATOR
 };
 
+static const CONF_PARSER connection_config[] = {
+	{ FR_CONF_OFFSET("connect_timeout", FR_TYPE_TIME_DELTA, rlm_rest_t, connect_timeout), .dflt = "3.0" },
+	{ FR_CONF_OFFSET("max_requests", FR_TYPE_UINT32, rlm_rest_t, max_requests), .dflt = "0" },
+	CONF_PARSER_TERMINATOR
+};
+
 static const CONF_PARSER module_config[] = {
 	{ FR_CONF_DEPRECATED("connect_timeout", FR_TYPE_TIME_DELTA, rlm_rest_t, connect_timeout) },
+	{ FR_CONF_POINTER("connection", FR_TYPE_SUBSECTION, NULL), .subcs = (void const *) connection_config },
 	{ FR_CONF_OFFSET("connect_proxy", FR_TYPE_STRING, rlm_rest_t, connect_proxy) },
 	{ FR_CONF_OFFSET("http_negotiation", FR_TYPE_VOID, rlm_rest_t, http_negotiation),
 	  .func = cf_table_parse_int, .uctx = &(cf_table_parse_ctx_t){ .table = http_negotiation_table, .len = &http_negotiation_table_len }, .dflt = "default" },
@@ -222,7 +229,6 @@ static xlat_action_t rest_xlat_resume(TALLOC_CTX *ctx, fr_cursor_t *out,
 				      UNUSED fr_value_box_t **in, void *rctx)
 {
 	rest_xlat_thread_inst_t		*xti = talloc_get_type_abort(xlat_thread_inst, rest_xlat_thread_inst_t);
-	rlm_rest_t const		*mod_inst = xti->inst;
 	rlm_rest_thread_t		*t = xti->t;
 
 	rlm_rest_xlat_rctx_t		*our_rctx = talloc_get_type_abort(rctx, rlm_rest_xlat_rctx_t);
@@ -281,9 +287,7 @@ error:
 	}
 
 finish:
-	rest_request_cleanup(mod_inst, handle);
-
-	fr_pool_connection_release(t->pool, request, handle);
+	rest_io_handle_release(t, handle);
 
 	talloc_free(our_rctx);
 
@@ -370,7 +374,7 @@ static xlat_action_t rest_xlat(TALLOC_CTX *ctx, UNUSED fr_cursor_t *out,
 	 */
 	fr_skip_whitespace(p);
 
-	randle = rctx->handle = fr_pool_connection_get(t->pool, request);
+	randle = rctx->handle = rest_io_handle_get(t, request);
 	if (!randle) return XLAT_ACTION_FAIL;
 
 	/*
@@ -380,8 +384,7 @@ static xlat_action_t rest_xlat(TALLOC_CTX *ctx, UNUSED fr_cursor_t *out,
 	len = rest_uri_host_unescape(&uri, mod_inst, request, randle, p);
 	if (len <= 0) {
 	error:
-		rest_request_cleanup(mod_inst, randle);
-		fr_pool_connection_release(t->pool, request, randle);
+		rest_io_handle_release(t, randle);
 		talloc_free(section);
 
 		return XLAT_ACTION_FAIL;
@@ -500,9 +503,7 @@ static rlm_rcode_t mod_authorize_result(module_ctx_t const *mctx, REQUEST *reque
 	}
 
 finish:
-	rest_request_cleanup(inst, handle);
-
-	fr_pool_connection_release(t->pool, request, handle);
+	rest_io_handle_release(t, handle);
 
 	return rcode;
 }
@@ -524,13 +525,12 @@ static rlm_rcode_t CC_HINT(nonnull) mod_authorize(module_ctx_t const *mctx, REQU
 
 	if (!section->name) return RLM_MODULE_NOOP;
 
-	handle = fr_pool_connection_get(t->pool, request);
+	handle = rest_io_handle_get(t, request);
 	if (!handle) return RLM_MODULE_FAIL;
 
 	ret = rlm_rest_perform(inst, t, section, handle, request, NULL, NULL);
 	if (ret < 0) {
-		rest_request_cleanup(inst, handle);
-		fr_pool_connection_release(t->pool, request, handle);
+		rest_io_handle_release(t, handle);
 
 		return RLM_MODULE_FAIL;
 	}
@@ -614,9 +614,7 @@ static rlm_rcode_t mod_authenticate_result(module_ctx_t const *mctx, REQUEST *re
 	}
 
 finish:
-	rest_request_cleanup(inst, handle);
-
-	fr_pool_connection_release(t->pool, request, handle);
+	rest_io_handle_release(t, handle);
 
 	return rcode;
 }
@@ -638,8 +636,8 @@ static rlm_rcode_t CC_HINT(nonnull) mod_authenticate(module_ctx_t const *mctx, R
 
 	if (!section->name) return RLM_MODULE_NOOP;
 
-	username = fr_pair_find_by_da(request->packet->vps, attr_user_name, TAG_ANY);
-	password = fr_pair_find_by_da(request->packet->vps, attr_user_password, TAG_ANY);
+	username = fr_pair_list_find_by_da(&request->packet->vps, attr_user_name, TAG_ANY);
+	password = fr_pair_list_find_by_da(&request->packet->vps, attr_user_password, TAG_ANY);
 
 	/*
 	 *	We can only authenticate user requests which HAVE
@@ -672,19 +670,18 @@ static rlm_rcode_t CC_HINT(nonnull) mod_authenticate(module_ctx_t const *mctx, R
 		RDEBUG2("Login attempt with password");
 	}
 
-	handle = fr_pool_connection_get(t->pool, request);
+	handle = rest_io_handle_get(t, request);
 	if (!handle) return RLM_MODULE_FAIL;
 
 	ret = rlm_rest_perform(inst, t, section,
 			       handle, request, username->vp_strvalue, password->vp_strvalue);
 	if (ret < 0) {
-		rest_request_cleanup(inst, handle);
-		fr_pool_connection_release(t->pool, request, handle);
+		rest_io_handle_release(t, handle);
 
 		return RLM_MODULE_FAIL;
 	}
 
-	return unlang_module_yield(request, mod_authenticate_result, NULL, handle);
+	return unlang_module_yield(request, mod_authenticate_result, rest_io_module_action, handle);
 }
 
 static rlm_rcode_t mod_accounting_result(module_ctx_t const *mctx, REQUEST *request, void *rctx)
@@ -731,9 +728,7 @@ static rlm_rcode_t mod_accounting_result(module_ctx_t const *mctx, REQUEST *requ
 	}
 
 finish:
-	rest_request_cleanup(inst, handle);
-
-	fr_pool_connection_release(t->pool, request, handle);
+	rest_io_handle_release(t, handle);
 
 	return rcode;
 }
@@ -752,18 +747,17 @@ static rlm_rcode_t CC_HINT(nonnull) mod_accounting(module_ctx_t const *mctx, REQ
 
 	if (!section->name) return RLM_MODULE_NOOP;
 
-	handle = fr_pool_connection_get(t->pool, request);
+	handle = rest_io_handle_get(t, request);
 	if (!handle) return RLM_MODULE_FAIL;
 
 	ret = rlm_rest_perform(inst, t, section, handle, request, NULL, NULL);
 	if (ret < 0) {
-		rest_request_cleanup(inst, handle);
-		fr_pool_connection_release(t->pool, request, handle);
+		rest_io_handle_release(t, handle);
 
 		return RLM_MODULE_FAIL;
 	}
 
-	return unlang_module_yield(request, mod_accounting_result, NULL, handle);
+	return unlang_module_yield(request, mod_accounting_result, rest_io_module_action, handle);
 }
 
 static rlm_rcode_t mod_post_auth_result(module_ctx_t const *mctx, REQUEST *request, void *rctx)
@@ -810,9 +804,7 @@ static rlm_rcode_t mod_post_auth_result(module_ctx_t const *mctx, REQUEST *reque
 	}
 
 finish:
-	rest_request_cleanup(inst, handle);
-
-	fr_pool_connection_release(t->pool, request, handle);
+	rest_io_handle_release(t, handle);
 
 	return rcode;
 }
@@ -831,19 +823,17 @@ static rlm_rcode_t CC_HINT(nonnull) mod_post_auth(module_ctx_t const *mctx, REQU
 
 	if (!section->name) return RLM_MODULE_NOOP;
 
-	handle = fr_pool_connection_get(t->pool, request);
+	handle = rest_io_handle_get(t, request);
 	if (!handle) return RLM_MODULE_FAIL;
 
 	ret = rlm_rest_perform(inst, t, section, handle, request, NULL, NULL);
 	if (ret < 0) {
-		rest_request_cleanup(inst, handle);
-
-		fr_pool_connection_release(t->pool, request, handle);
+		rest_io_handle_release(t, handle);
 
 		return RLM_MODULE_FAIL;
 	}
 
-	return unlang_module_yield(request, mod_post_auth_result, NULL, handle);
+	return unlang_module_yield(request, mod_post_auth_result, rest_io_module_action, handle);
 }
 
 static int parse_sub_section(rlm_rest_t *inst, CONF_SECTION *parent, CONF_PARSER const *config_items,
@@ -1005,7 +995,8 @@ static int mod_xlat_thread_instantiate(UNUSED void *xlat_inst, void *xlat_thread
 /** Create a thread specific multihandle
  *
  * Easy handles representing requests are added to the curl multihandle
- * with the multihandle used for mux/demux.
+ * with the multihandle used for mux/demux.  Easy handles are allocated
+ * on demand, and kept on the thread's idle list between requests.
  *
  * @param[in] conf	section containing the configuration of this module instance.
  * @param[in] instance	of rlm_rest_t.
@@ -1015,32 +1006,14 @@ static int mod_xlat_thread_instantiate(UNUSED void *xlat_inst, void *xlat_thread
  *	- 0 on success.
  *	- -1 on failure.
  */
-static int mod_thread_instantiate(CONF_SECTION const *conf, void *instance, fr_event_list_t *el, void *thread)
+static int mod_thread_instantiate(UNUSED CONF_SECTION const *conf, void *instance, fr_event_list_t *el, void *thread)
 {
 	rlm_rest_t		*inst = instance;
 	rlm_rest_thread_t	*t = thread;
 	fr_curl_handle_t	*mhandle;
-	CONF_SECTION		*my_conf;
 
 	t->inst = instance;
-
-	/*
-	 *	Temporary hack to make config parsing
-	 *	thread safe.
-	 */
-	my_conf = cf_section_dup(NULL, NULL, conf, cf_section_name1(conf), cf_section_name2(conf), true);
-	t->pool = fr_pool_init(NULL, my_conf, instance, rest_mod_conn_create, NULL, inst->xlat_name);
-	talloc_free(my_conf);
-
-	if (!t->pool) {
-		ERROR("Pool instantiation failed");
-		return -1;
-	}
-
-	if (fr_pool_start(t->pool) < 0) {
-		ERROR("Starting initial connections failed");
-		return -1;
-	}
+	fr_dlist_talloc_init(&t->idle, rlm_rest_curl_context_t, entry);
 
 	mhandle = fr_curl_io_init(t, el, inst->multiplex);
 	if (!mhandle) return -1;
@@ -1062,9 +1035,11 @@ static int mod_thread_instantiate(CONF_SECTION const *conf, void *instance, fr_e
 static int mod_thread_detach(UNUSED fr_event_list_t *el, void *thread)
 {
 	rlm_rest_thread_t	*t = thread;
+	rlm_rest_curl_context_t	*curl_ctx;
+
+	talloc_free(t->mhandle);	/* Ensure this is shutdown before the handles */
 
-	talloc_free(t->mhandle);	/* Ensure this is shutdown before the pool */
-	fr_pool_free(t->pool);
+	while ((curl_ctx = fr_dlist_pop_head(&t->idle))) talloc_free(curl_ctx->randle);
 
 	return 0;
 }
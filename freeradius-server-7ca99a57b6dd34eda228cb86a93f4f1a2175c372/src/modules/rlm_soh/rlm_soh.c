@@ -85,19 +85,19 @@ static ssize_t soh_xlat(UNUSED TALLOC_CTX *ctx, char **out, size_t outlen,
 	/*
 	 * There will be no point unless SoH-Supported = yes
 	 */
-	vp[0] = fr_pair_find_by_da(request->packet->vps, attr_soh_supported, TAG_ANY);
+	vp[0] = fr_pair_list_find_by_da(&request->packet->vps, attr_soh_supported, TAG_ANY);
 	if (!vp[0])
 		return 0;
 
 
 	if (strncasecmp(fmt, "OS", 2) == 0) {
 		/* OS vendor */
-		vp[0] = fr_pair_find_by_da(request->packet->vps, attr_soh_ms_machine_os_vendor, TAG_ANY);
-		vp[1] = fr_pair_find_by_da(request->packet->vps, attr_soh_ms_machine_os_version, TAG_ANY);
-		vp[2] = fr_pair_find_by_da(request->packet->vps, attr_soh_ms_machine_os_release, TAG_ANY);
-		vp[3] = fr_pair_find_by_da(request->packet->vps, attr_soh_ms_machine_os_build, TAG_ANY);
-		vp[4] = fr_pair_find_by_da(request->packet->vps, attr_soh_ms_machine_sp_version, TAG_ANY);
-		vp[5] = fr_pair_find_by_da(request->packet->vps, attr_soh_ms_machine_sp_release, TAG_ANY);
+		vp[0] = fr_pair_list_find_by_da(&request->packet->vps, attr_soh_ms_machine_os_vendor, TAG_ANY);
+		vp[1] = fr_pair_list_find_by_da(&request->packet->vps, attr_soh_ms_machine_os_version, TAG_ANY);
+		vp[2] = fr_pair_list_find_by_da(&request->packet->vps, attr_soh_ms_machine_os_release, TAG_ANY);
+		vp[3] = fr_pair_list_find_by_da(&request->packet->vps, attr_soh_ms_machine_os_build, TAG_ANY);
+		vp[4] = fr_pair_list_find_by_da(&request->packet->vps, attr_soh_ms_machine_sp_version, TAG_ANY);
+		vp[5] = fr_pair_list_find_by_da(&request->packet->vps, attr_soh_ms_machine_sp_release, TAG_ANY);
 
 		if (vp[0] && vp[0]->vp_uint32 == VENDORPEC_MICROSOFT) {
 			if (!vp[1]) {
@@ -150,7 +150,7 @@ static rlm_rcode_t CC_HINT(nonnull) mod_post_auth(module_ctx_t const *mctx, REQU
 
 	if (!inst->dhcp) return RLM_MODULE_NOOP;
 
-	vp = fr_pair_find_by_da(request->packet->vps, attr_dhcp_vendor, TAG_ANY);
+	vp = fr_pair_list_find_by_da(&request->packet->vps, attr_dhcp_vendor, TAG_ANY);
 	if (vp) {
 		/*
 		 * vendor-specific options contain
@@ -181,7 +181,7 @@ static rlm_rcode_t CC_HINT(nonnull) mod_post_auth(module_ctx_t const *mctx, REQU
 					p[4] = 'N';
 					p[3] = 'A';
 					p[2] = 'P';
-					fr_pair_add(&request->reply->vps, vp);
+					fr_pair_list_append(&request->reply->vps, vp);
 
 				} else {
 					RDEBUG2("SoH decoding NAP from DHCP request");
@@ -211,7 +211,7 @@ static rlm_rcode_t CC_HINT(nonnull) mod_authorize(UNUSED module_ctx_t const *mct
 	int rv;
 
 	/* try to find the MS-SoH payload */
-	vp = fr_pair_find_by_da(request->packet->vps, attr_ms_quarantine_soh, TAG_ANY);
+	vp = fr_pair_list_find_by_da(&request->packet->vps, attr_ms_quarantine_soh, TAG_ANY);
 	if (!vp) {
 		RDEBUG2("SoH radius VP not found");
 		return RLM_MODULE_NOOP;
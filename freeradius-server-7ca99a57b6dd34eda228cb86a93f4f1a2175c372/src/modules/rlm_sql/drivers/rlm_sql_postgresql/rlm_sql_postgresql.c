@@ -42,6 +42,7 @@ RCSID("$Id$")
 #define LOG_PREFIX "rlm_sql_postgresql - "
 
 #include <freeradius-devel/server/base.h>
+#include <freeradius-devel/server/connection.h>
 #include <freeradius-devel/util/debug.h>
 
 #include <sys/stat.h>
@@ -178,6 +179,19 @@ static sql_rcode_t sql_classify_error(rlm_sql_postgres_t *inst, ExecStatusType s
 			error_code = "42000";
 			break;
 
+	#ifdef HAVE_PQENTERPIPELINEMODE
+		case PGRES_PIPELINE_SYNC:
+			error_code = "00000";
+			break;
+
+		/*
+		 *  An earlier query in the same pipeline failed.
+		 */
+		case PGRES_PIPELINE_ABORTED:
+			ERROR("Query not run as pipeline was aborted");
+			return RLM_SQL_ERROR;
+	#endif
+
 		case PGRES_BAD_RESPONSE:
 		case PGRES_NONFATAL_ERROR:
 		case PGRES_FATAL_ERROR:
@@ -382,6 +396,10 @@ static CC_HINT(nonnull) sql_rcode_t sql_query(rlm_sql_handle_t *handle, rlm_sql_
 	case PGRES_BAD_RESPONSE:	/* The server's response was not understood */
 	case PGRES_NONFATAL_ERROR:
 	case PGRES_FATAL_ERROR:
+#ifdef HAVE_PQENTERPIPELINEMODE
+	case PGRES_PIPELINE_SYNC:	/* Only seen in pipeline mode */
+	case PGRES_PIPELINE_ABORTED:
+#endif
 		break;
 	}
 
@@ -532,6 +550,633 @@ static size_t sql_escape_func(REQUEST *request, char *out, size_t outlen, char c
 	return ret;
 }
 
+/*
+ *	Asynchronous queries
+ *
+ *	Connections are opened with PQconnectStart and polled from the
+ *	event loop, and queries are sent with the connection in
+ *	non-blocking mode.
+ *
+ *	If libpq supports pipeline mode, any number of queries may be
+ *	in flight on a connection at once, each followed by its own sync
+ *	point, so that a failure of one query doesn't abort the others.
+ *	Results arrive in the order queries were sent, so we only need
+ *	a FIFO to match them back up.
+ *
+ *	Without pipeline mode there's at most one query in flight per
+ *	connection, and the trunk opens more connections as required.
+ */
+
+/** A query waiting for its result
+ *
+ */
+typedef struct {
+	rlm_sql_query_t			*query;		//!< Query the result is for.  NULL if the query
+							///< was cancelled, or was sent by us when the
+							///< connection was opened.
+	PGresult			*result;	//!< First result received for the query.
+	fr_dlist_t			entry;		//!< Entry in the connection's list of sent queries.
+} rlm_sql_postgres_sent_t;
+
+/** Asynchronous connection
+ *
+ */
+typedef struct {
+	PGconn				*db;		//!< libpq connection handle.
+	int				fd;		//!< Socket libpq is currently using.
+	fr_event_list_t			*el;		//!< Event list the socket is registered with.
+	fr_connection_t			*conn;		//!< Connection this handle belongs to.
+	fr_trunk_connection_t		*tconn;		//!< Trunk connection, set when the trunk first
+							///< asks to be notified of I/O events.
+	rlm_sql_postgres_t		*driver;	//!< Driver instance.
+	rlm_sql_config_t const		*config;	//!< rlm_sql instance config.
+	rlm_sql_thread_t		*thread;	//!< Worker the connection belongs to.
+
+	fr_dlist_head_t			sent;		//!< Queries waiting for results, in the order sent.
+
+	bool				pipeline;	//!< Whether libpq's pipeline mode is in use.
+	bool				want_write;	//!< Trunk has requests waiting to be sent.
+	bool				flush_pending;	//!< libpq has data it couldn't write yet.
+} rlm_sql_postgres_aconn_t;
+
+static void _sql_aconn_readable(fr_event_list_t *el, int fd, int flags, void *uctx);
+static void _sql_aconn_writable(fr_event_list_t *el, int fd, int flags, void *uctx);
+
+static int _sql_sent_free(rlm_sql_postgres_sent_t *sent)
+{
+	if (sent->query) sent->query->uctx = NULL;
+	if (sent->result) PQclear(sent->result);
+
+	return 0;
+}
+
+static int _sql_aconn_free(rlm_sql_postgres_aconn_t *c)
+{
+	rlm_sql_postgres_sent_t *sent;
+
+	if (c->thread->escape_conn == c) c->thread->escape_conn = NULL;
+
+	while ((sent = fr_dlist_head(&c->sent))) {
+		fr_dlist_remove(&c->sent, sent);
+		talloc_free(sent);
+	}
+
+	if (c->fd >= 0) fr_event_fd_delete(c->el, c->fd, FR_EVENT_FILTER_IO);
+
+	if (c->db) PQfinish(c->db);
+
+	return 0;
+}
+
+static void _sql_aconn_error(UNUSED fr_event_list_t *el, UNUSED int fd, UNUSED int flags, int fd_errno, void *uctx)
+{
+	rlm_sql_postgres_aconn_t	*c = talloc_get_type_abort(uctx, rlm_sql_postgres_aconn_t);
+
+	ERROR("Connection failed: %s", fr_syserror(fd_errno));
+
+	fr_connection_signal_reconnect(c->conn, FR_CONNECTION_FAILED);
+}
+
+/** Update the I/O events we're interested in
+ *
+ * We always want read events, so we notice the server closing the
+ * connection, and so results for cancelled queries are drained.
+ *
+ * We want write events if libpq has buffered data, or if the trunk has
+ * requests for us and we're able to send them.
+ */
+static int sql_aconn_events_update(rlm_sql_postgres_aconn_t *c)
+{
+	fr_event_fd_cb_t	write_fn = NULL;
+
+	if (c->flush_pending ||
+	    (c->want_write && (c->pipeline || (fr_dlist_num_elements(&c->sent) == 0)))) write_fn = _sql_aconn_writable;
+
+	if (fr_event_fd_insert(c, c->el, c->fd, _sql_aconn_readable, write_fn, _sql_aconn_error, c) < 0) {
+		PERROR("Failed inserting FD event");
+		return -1;
+	}
+
+	return 0;
+}
+
+/** Write as much of libpq's output buffer as the socket will accept
+ *
+ */
+static int sql_aconn_flush(rlm_sql_postgres_aconn_t *c)
+{
+	switch (PQflush(c->db)) {
+	case 0:
+		c->flush_pending = false;
+		break;
+
+	case 1:
+		c->flush_pending = true;
+		break;
+
+	default:
+		ERROR("Failed sending queries: %s", PQerrorMessage(c->db));
+		return -1;
+	}
+
+	return sql_aconn_events_update(c);
+}
+
+/** Add a query to libpq's output buffer
+ *
+ * @param[in] c		to send the query on.
+ * @param[in] query	to record the result in.  NULL if the result should be discarded.
+ * @param[in] query_str	to send.
+ * @return
+ *	- 0 on success.
+ *	- -1 if the connection is no longer usable.
+ */
+static int sql_aconn_send(rlm_sql_postgres_aconn_t *c, rlm_sql_query_t *query, char const *query_str)
+{
+	rlm_sql_postgres_sent_t	*sent;
+	int			ret;
+
+#ifdef HAVE_PQENTERPIPELINEMODE
+	if (c->pipeline) {
+		/*
+		 *	PQsendQuery isn't allowed in pipeline mode, the
+		 *	extended query protocol must be used instead.
+		 */
+		ret = PQsendQueryParams(c->db, query_str, 0, NULL, NULL, NULL, NULL, 0) && PQpipelineSync(c->db);
+	} else
+#endif
+	{
+		ret = PQsendQuery(c->db, query_str);
+	}
+	if (!ret) {
+		ERROR("Failed to send query: %s", PQerrorMessage(c->db));
+		return -1;
+	}
+
+	MEM(sent = talloc_zero(c, rlm_sql_postgres_sent_t));
+	talloc_set_destructor(sent, _sql_sent_free);
+	sent->query = query;
+	if (query) query->uctx = sent;
+
+	fr_dlist_insert_tail(&c->sent, sent);
+
+	return 0;
+}
+
+/** Translate a PGresult into an rlm_sql result
+ *
+ */
+static void sql_aconn_query_result(rlm_sql_postgres_aconn_t *c, rlm_sql_query_t *query, PGresult *result)
+{
+	ExecStatusType	status;
+	char const	*msg;
+
+	if (!result) {
+		query->rcode = RLM_SQL_RECONNECT;
+		query->error = talloc_typed_strdup(query, PQerrorMessage(c->db));
+		return;
+	}
+
+	status = PQresultStatus(result);
+	switch (status) {
+	case PGRES_COMMAND_OK:
+		query->affected_rows = affected_rows(result);
+		break;
+
+#ifdef HAVE_PGRES_SINGLE_TUPLE
+	case PGRES_SINGLE_TUPLE:
+#endif
+	case PGRES_TUPLES_OK:
+		query->affected_rows = PQntuples(result);
+		break;
+
+	default:
+		break;
+	}
+
+	query->rcode = sql_classify_error(c->driver, status, result);
+	if (query->rcode == RLM_SQL_OK) return;
+
+	msg = PQresultErrorMessage(result);
+	if (msg && *msg) query->error = talloc_bstrndup(query, msg, strcspn(msg, "\n"));
+}
+
+/** All results for the query at the head of the sent list have been received
+ *
+ */
+static void sql_aconn_sent_complete(rlm_sql_postgres_aconn_t *c, rlm_sql_postgres_sent_t *sent)
+{
+	rlm_sql_query_t	*query = sent->query;
+
+	fr_dlist_remove(&c->sent, sent);
+
+	if (!query) {
+		if (sent->result && (sql_classify_error(c->driver, PQresultStatus(sent->result),
+							sent->result) != RLM_SQL_OK)) {
+			WARN("Discarded query failed: %s", PQresultErrorMessage(sent->result));
+		}
+		talloc_free(sent);
+		return;
+	}
+
+	sql_aconn_query_result(c, query, sent->result);
+	talloc_free(sent);
+
+	fr_trunk_request_signal_complete(query->treq);
+}
+
+/** Read any results libpq has available, and match them with the queries we sent
+ *
+ * @return
+ *	- 0 on success.
+ *	- -1 if the connection is no longer usable.
+ */
+static int sql_aconn_read(rlm_sql_postgres_aconn_t *c)
+{
+	rlm_sql_postgres_sent_t	*sent;
+	PGresult		*result;
+
+	if (!PQconsumeInput(c->db)) {
+		ERROR("Failed reading input: %s", PQerrorMessage(c->db));
+		return -1;
+	}
+
+	while ((sent = fr_dlist_head(&c->sent)) && !PQisBusy(c->db)) {
+		result = PQgetResult(c->db);
+
+#ifdef HAVE_PQENTERPIPELINEMODE
+		/*
+		 *	In pipeline mode the end of each query's
+		 *	results is marked with NULL, followed by the
+		 *	result for the sync point we sent after it.
+		 */
+		if (c->pipeline) {
+			if (!result) continue;
+
+			if (PQresultStatus(result) == PGRES_PIPELINE_SYNC) {
+				PQclear(result);
+				sql_aconn_sent_complete(c, sent);
+				continue;
+			}
+		} else
+#endif
+		if (!result) {
+			sql_aconn_sent_complete(c, sent);
+			continue;
+		}
+
+		/*
+		 *	Discard results for appended queries
+		 */
+		if (sent->result) {
+			PQclear(result);
+			continue;
+		}
+		sent->result = result;
+	}
+
+	/*
+	 *	Without pipelining, we may now be able
+	 *	to send the next query.
+	 */
+	if (!c->pipeline && c->want_write) return sql_aconn_events_update(c);
+
+	return 0;
+}
+
+static void _sql_aconn_readable(UNUSED fr_event_list_t *el, UNUSED int fd, UNUSED int flags, void *uctx)
+{
+	rlm_sql_postgres_aconn_t	*c = talloc_get_type_abort(uctx, rlm_sql_postgres_aconn_t);
+
+	/*
+	 *	Only the results of queries we sent
+	 *	ourselves can be outstanding.
+	 */
+	if (!c->tconn) {
+		if (sql_aconn_read(c) < 0) fr_connection_signal_reconnect(c->conn, FR_CONNECTION_FAILED);
+		return;
+	}
+
+	fr_trunk_connection_signal_readable(c->tconn);
+}
+
+static void _sql_aconn_writable(UNUSED fr_event_list_t *el, UNUSED int fd, UNUSED int flags, void *uctx)
+{
+	rlm_sql_postgres_aconn_t	*c = talloc_get_type_abort(uctx, rlm_sql_postgres_aconn_t);
+
+	if (c->flush_pending) {
+		if (sql_aconn_flush(c) < 0) {
+			fr_connection_signal_reconnect(c->conn, FR_CONNECTION_FAILED);
+			return;
+		}
+		if (c->flush_pending) return;
+	}
+
+	if (c->want_write && c->tconn) fr_trunk_connection_signal_writable(c->tconn);
+}
+
+/** Continue opening the connection
+ *
+ */
+static void _sql_aconn_poll(fr_event_list_t *el, UNUSED int fd, UNUSED int flags, void *uctx)
+{
+	rlm_sql_postgres_aconn_t	*c = talloc_get_type_abort(uctx, rlm_sql_postgres_aconn_t);
+	fr_event_fd_cb_t		read_fn = NULL, write_fn = NULL;
+	int				sockfd;
+
+	switch (PQconnectPoll(c->db)) {
+	case PGRES_POLLING_OK:
+		fr_connection_signal_connected(c->conn);
+		return;
+
+	case PGRES_POLLING_FAILED:
+		ERROR("Connection failed: %s", PQerrorMessage(c->db));
+		fr_connection_signal_reconnect(c->conn, FR_CONNECTION_FAILED);
+		return;
+
+	case PGRES_POLLING_READING:
+		read_fn = _sql_aconn_poll;
+		break;
+
+	default:
+		write_fn = _sql_aconn_poll;
+		break;
+	}
+
+	/*
+	 *	libpq may open a new socket if it moves
+	 *	onto the next host in the connection string.
+	 */
+	sockfd = PQsocket(c->db);
+	if (sockfd != c->fd) {
+		fr_event_fd_delete(el, c->fd, FR_EVENT_FILTER_IO);
+		c->fd = sockfd;
+	}
+
+	if (fr_event_fd_insert(c, el, c->fd, read_fn, write_fn, _sql_aconn_error, c) < 0) {
+		PERROR("Failed inserting FD event");
+		fr_connection_signal_reconnect(c->conn, FR_CONNECTION_FAILED);
+	}
+}
+
+/** Start opening a new connection
+ *
+ */
+static fr_connection_state_t _sql_aconn_init(void **h_out, fr_connection_t *conn, void *uctx)
+{
+	rlm_sql_thread_t		*t = talloc_get_type_abort(uctx, rlm_sql_thread_t);
+	rlm_sql_postgres_aconn_t	*c;
+
+	MEM(c = talloc_zero(conn, rlm_sql_postgres_aconn_t));
+	c->fd = -1;
+	c->el = conn->el;
+	c->conn = conn;
+	c->config = t->inst->config;
+	c->driver = t->inst->config->driver;
+	c->thread = t;
+	fr_dlist_talloc_init(&c->sent, rlm_sql_postgres_sent_t, entry);
+
+	DEBUG2("Connecting using parameters: %s", c->driver->db_string);
+	c->db = PQconnectStart(c->driver->db_string);
+	if (!c->db) {
+		ERROR("Connection failed: Out of memory");
+	error:
+		talloc_free(c);
+		return FR_CONNECTION_STATE_FAILED;
+	}
+	talloc_set_destructor(c, _sql_aconn_free);
+
+	if (PQstatus(c->db) == CONNECTION_BAD) {
+		ERROR("Connection failed: %s", PQerrorMessage(c->db));
+		goto error;
+	}
+
+	if (PQsetnonblocking(c->db, 1) < 0) {
+		ERROR("Failed setting connection to non-blocking: %s", PQerrorMessage(c->db));
+		goto error;
+	}
+
+	/*
+	 *	The first step of PQconnectPoll is always
+	 *	waiting for the socket to become writable.
+	 */
+	c->fd = PQsocket(c->db);
+	if (fr_event_fd_insert(c, c->el, c->fd, NULL, _sql_aconn_poll, _sql_aconn_error, c) < 0) {
+		PERROR("Failed inserting FD event");
+		goto error;
+	}
+
+	*h_out = c;
+
+	return FR_CONNECTION_STATE_CONNECTING;
+}
+
+/** Enter pipeline mode, and send any queries required to setup the session
+ *
+ */
+static fr_connection_state_t _sql_aconn_open(UNUSED fr_event_list_t *el, void *h, UNUSED void *uctx)
+{
+	rlm_sql_postgres_aconn_t	*c = talloc_get_type_abort(h, rlm_sql_postgres_aconn_t);
+	char const			*setup[2];
+	char				*timeout = NULL, *joined = NULL;
+	size_t				i, num = 0;
+
+	DEBUG2("Connected to database '%s' on '%s' server version %i, protocol version %i, backend PID %i ",
+	       PQdb(c->db), PQhost(c->db), PQserverVersion(c->db), PQprotocolVersion(c->db),
+	       PQbackendPID(c->db));
+
+#ifdef HAVE_PQENTERPIPELINEMODE
+	c->pipeline = (PQenterPipelineMode(c->db) == 1);
+	if (!c->pipeline) WARN("Failed entering pipeline mode, queries will be sent one at a time");
+#endif
+
+	/*
+	 *	The blocking path enforces query_timeout itself, here
+	 *	we ask the server to do it.
+	 */
+	if (c->config->query_timeout) {
+		setup[num++] = timeout = talloc_typed_asprintf(c, "SET statement_timeout = %u",
+							       c->config->query_timeout * 1000);
+	}
+	if (c->config->connect_query) setup[num++] = c->config->connect_query;
+
+	/*
+	 *	Only one query can be in flight without
+	 *	pipelining, so send them as one.
+	 */
+	if ((num > 1) && !c->pipeline) {
+		setup[0] = joined = talloc_typed_asprintf(c, "%s; %s", setup[0], setup[1]);
+		num = 1;
+	}
+
+	for (i = 0; i < num; i++) {
+		if (sql_aconn_send(c, NULL, setup[i]) < 0) {
+			talloc_free(timeout);
+			talloc_free(joined);
+			return FR_CONNECTION_STATE_FAILED;
+		}
+	}
+	talloc_free(timeout);
+	talloc_free(joined);
+
+	if (sql_aconn_flush(c) < 0) return FR_CONNECTION_STATE_FAILED;
+
+	/*
+	 *	Escaping only looks at the connection's settings,
+	 *	so any connected connection will do.
+	 */
+	if (!c->thread->escape_conn) c->thread->escape_conn = c;
+
+	return FR_CONNECTION_STATE_CONNECTED;
+}
+
+/** Escape values for asynchronous queries
+ *
+ * PQescapeStringConn doesn't do any I/O, so we can use one of the trunk's
+ * connections while it has queries in flight.
+ *
+ * The escaping rules depend on the connection's encoding and
+ * standard_conforming_strings, so if none are connected, the value
+ * isn't escaped, and the query fails.
+ */
+static size_t sql_escape_async_func(REQUEST *request, char *out, size_t outlen, char const *in, void *arg)
+{
+	rlm_sql_thread_t		*t = talloc_get_type_abort(arg, rlm_sql_thread_t);
+	rlm_sql_postgres_aconn_t	*c = t->escape_conn;
+	size_t				inlen, ret;
+	int				err;
+
+	out[0] = '\0';
+
+	/* Check for potential buffer overflow */
+	inlen = strlen(in);
+	if ((inlen * 2 + 1) > outlen) {
+	error:
+		t->escape_failed = true;
+		return 0;
+	}
+	/* Prevent integer overflow */
+	if ((inlen * 2 + 1) <= inlen) goto error;
+
+	if (!c) {
+		REDEBUG("Can't escape string \"%s\": No connections available", in);
+		goto error;
+	}
+
+	ret = PQescapeStringConn(c->db, out, in, inlen, &err);
+	if (err) {
+		REDEBUG("Error escaping string \"%s\": %s", in, PQerrorMessage(c->db));
+		goto error;
+	}
+
+	return ret;
+}
+
+static void _sql_aconn_close(UNUSED fr_event_list_t *el, void *h, UNUSED void *uctx)
+{
+	talloc_free(h);
+}
+
+static fr_connection_t *sql_trunk_connection_alloc(fr_trunk_connection_t *tconn, fr_event_list_t *el,
+						   fr_connection_conf_t const *conf,
+						   char const *log_prefix, void *uctx)
+{
+	fr_connection_t		*conn;
+
+	conn = fr_connection_alloc(tconn, el,
+				   &(fr_connection_funcs_t){
+					.init = _sql_aconn_init,
+					.open = _sql_aconn_open,
+					.close = _sql_aconn_close
+				   },
+				   conf,
+				   log_prefix,
+				   uctx);
+	if (!conn) {
+		PERROR("Failed allocating state handler for new connection");
+		return NULL;
+	}
+
+	return conn;
+}
+
+static void sql_trunk_connection_notify(fr_trunk_connection_t *tconn, fr_connection_t *conn,
+					UNUSED fr_event_list_t *el,
+					fr_trunk_connection_event_t notify_on, UNUSED void *uctx)
+{
+	rlm_sql_postgres_aconn_t	*c = talloc_get_type_abort(conn->h, rlm_sql_postgres_aconn_t);
+
+	c->tconn = tconn;
+	c->want_write = (notify_on & FR_TRUNK_CONN_EVENT_WRITE);
+
+	/*
+	 *	May free the connection!
+	 */
+	if (sql_aconn_events_update(c) < 0) fr_trunk_connection_signal_reconnect(tconn, FR_CONNECTION_FAILED);
+}
+
+static void sql_trunk_request_mux(UNUSED fr_event_list_t *el,
+				  fr_trunk_connection_t *tconn, fr_connection_t *conn, UNUSED void *uctx)
+{
+	rlm_sql_postgres_aconn_t	*c = talloc_get_type_abort(conn->h, rlm_sql_postgres_aconn_t);
+	fr_trunk_request_t		*treq;
+	rlm_sql_query_t			*query;
+
+	/*
+	 *	Without pipelining libpq only allows
+	 *	one query in flight at a time.
+	 */
+	while (c->pipeline || (fr_dlist_num_elements(&c->sent) == 0)) {
+		if (fr_trunk_connection_pop_request(&treq, tconn) != 0) break;
+
+		query = talloc_get_type_abort(treq->preq, rlm_sql_query_t);
+
+		DEBUG3("Sending query: %s", query->query_str);
+
+		if (sql_aconn_send(c, query, query->query_str) < 0) {
+			fr_connection_signal_reconnect(conn, FR_CONNECTION_FAILED);
+			return;
+		}
+
+		fr_trunk_request_signal_sent(treq);
+	}
+
+	if (sql_aconn_flush(c) < 0) fr_connection_signal_reconnect(conn, FR_CONNECTION_FAILED);
+}
+
+static void sql_trunk_request_demux(UNUSED fr_trunk_connection_t *tconn, fr_connection_t *conn, UNUSED void *uctx)
+{
+	rlm_sql_postgres_aconn_t	*c = talloc_get_type_abort(conn->h, rlm_sql_postgres_aconn_t);
+
+	if (sql_aconn_read(c) < 0) fr_connection_signal_reconnect(conn, FR_CONNECTION_FAILED);
+}
+
+/** Stop tracking a query
+ *
+ * Once sent, there's no way to remove a query from the pipeline, so
+ * its result will be discarded when it arrives.
+ */
+static void sql_trunk_request_cancel(UNUSED fr_connection_t *conn, void *preq_to_reset,
+				     UNUSED fr_trunk_cancel_reason_t reason, UNUSED void *uctx)
+{
+	rlm_sql_query_t			*query = talloc_get_type_abort(preq_to_reset, rlm_sql_query_t);
+	rlm_sql_postgres_sent_t		*sent;
+
+	if (!query->uctx) return;
+
+	sent = talloc_get_type_abort(query->uctx, rlm_sql_postgres_sent_t);
+	sent->query = NULL;
+	query->uctx = NULL;
+}
+
+static fr_trunk_io_funcs_t const trunk_io_funcs = {
+	.connection_alloc = sql_trunk_connection_alloc,
+	.connection_notify = sql_trunk_connection_notify,
+	.request_mux = sql_trunk_request_mux,
+	.request_demux = sql_trunk_request_demux,
+	.request_cancel = sql_trunk_request_cancel
+};
+
 static int mod_instantiate(rlm_sql_config_t const *config, void *instance, CONF_SECTION *conf)
 {
 	rlm_sql_postgres_t	*inst = instance;
@@ -672,5 +1317,7 @@ rlm_sql_driver_t rlm_sql_postgresql = {
 	.sql_finish_query		= sql_free_result,
 	.sql_finish_select_query	= sql_free_result,
 	.sql_affected_rows		= sql_affected_rows,
-	.sql_escape_func		= sql_escape_func
+	.sql_escape_func		= sql_escape_func,
+	.trunk_io_funcs			= &trunk_io_funcs,
+	.sql_escape_async_func		= sql_escape_async_func
 };
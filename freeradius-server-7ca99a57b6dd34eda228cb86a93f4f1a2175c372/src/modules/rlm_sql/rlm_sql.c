@@ -36,6 +36,7 @@ RCSID("$Id$")
 #include <freeradius-devel/server/map_proc.h>
 #include <freeradius-devel/server/module.h>
 #include <freeradius-devel/server/pairmove.h>
+#include <freeradius-devel/unlang/base.h>
 #include <freeradius-devel/util/debug.h>
 #include <freeradius-devel/util/table.h>
 
@@ -113,6 +114,11 @@ static const CONF_PARSER module_config[] = {
 	{ FR_CONF_POINTER("accounting", FR_TYPE_SUBSECTION, NULL), .subcs = (void const *) acct_config },
 
 	{ FR_CONF_POINTER("post-auth", FR_TYPE_SUBSECTION, NULL), .subcs = (void const *) postauth_config },
+
+	/*
+	 *	Only used by drivers which support asynchronous queries.
+	 */
+	{ FR_CONF_OFFSET("trunk", FR_TYPE_SUBSECTION, rlm_sql_config_t, trunk_conf), .subcs = (void const *) fr_trunk_config },
 	CONF_PARSER_TERMINATOR
 };
 
@@ -672,7 +678,7 @@ int sql_set_user(rlm_sql_t const *inst, REQUEST *request, char const *username)
 /*
  *	Do a set/unset user, so it's a bit clearer what's going on.
  */
-#define sql_unset_user(_i, _r) fr_pair_delete_by_da(&_r->packet->vps, _i->sql_user)
+#define sql_unset_user(_i, _r) fr_pair_list_delete_by_da(&_r->packet->vps, _i->sql_user)
 
 static int sql_get_grouplist(rlm_sql_t const *inst, rlm_sql_handle_t **handle, REQUEST *request,
 			     rlm_sql_grouplist_t **phead)
@@ -730,11 +736,11 @@ static int sql_get_grouplist(rlm_sql_t const *inst, rlm_sql_handle_t **handle, R
  */
 static int sql_groupcmp(void *instance, REQUEST *request, UNUSED VALUE_PAIR *request_vp,
 			VALUE_PAIR *check, UNUSED VALUE_PAIR *check_pairs,
-			UNUSED VALUE_PAIR **reply_pairs) CC_HINT(nonnull (1, 2, 4));
+			UNUSED fr_pair_list_t *reply_pairs) CC_HINT(nonnull (1, 2, 4));
 
 static int sql_groupcmp(void *instance, REQUEST *request, UNUSED VALUE_PAIR *request_vp,
 			VALUE_PAIR *check, UNUSED VALUE_PAIR *check_pairs,
-			UNUSED VALUE_PAIR **reply_pairs)
+			UNUSED fr_pair_list_t *reply_pairs)
 {
 	rlm_sql_handle_t	*handle;
 	rlm_sql_t const		*inst = talloc_get_type_abort_const(instance, rlm_sql_t);
@@ -878,7 +884,7 @@ static rlm_rcode_t rlm_sql_process_groups(rlm_sql_t const *inst, REQUEST *reques
 			 *	process the reply rows
 			 */
 			if ((rows > 0) &&
-			    (paircmp(request, request->packet->vps, check_tmp, &request->reply->vps) != 0)) {
+			    (paircmp(request, fr_pair_list_head(&request->packet->vps), check_tmp, &request->reply->vps) != 0)) {
 				fr_pair_list_free(&check_tmp);
 				entry = entry->next;
 
@@ -1173,6 +1179,18 @@ static int mod_instantiate(void *instance, CONF_SECTION *conf)
 	inst->pool = module_connection_pool_init(inst->cs, inst, sql_mod_conn_create, NULL, NULL, NULL, NULL);
 	if (!inst->pool) return -1;
 
+	/*
+	 *	Accounting and post-auth queries are sent via
+	 *	per-worker trunks if the driver supports it.
+	 *	Everything else still uses the pool.
+	 */
+	if (inst->driver->trunk_io_funcs) {
+		inst->config->trunk_conf.req_pool_headers = 1;	/* One for the query */
+		inst->config->trunk_conf.req_pool_size = sizeof(rlm_sql_query_t);
+
+		INFO("Driver supports asynchronous queries, accounting and post-auth queries will not block");
+	}
+
 	return RLM_MODULE_OK;
 }
 
@@ -1259,7 +1277,7 @@ static rlm_rcode_t CC_HINT(nonnull) mod_authorize(module_ctx_t const *mctx, REQU
 		 */
 		RDEBUG2("User found in radcheck table");
 		user_found = true;
-		if (paircmp(request, request->packet->vps, check_tmp, &request->reply->vps) != 0) {
+		if (paircmp(request, fr_pair_list_head(&request->packet->vps), check_tmp, &request->reply->vps) != 0) {
 			fr_pair_list_free(&check_tmp);
 			check_tmp = NULL;
 			goto skip_reply;
@@ -1365,7 +1383,7 @@ skip_reply:
 		 *  Check for a default_profile or for a User-Profile.
 		 */
 		RDEBUG3("... falling-through to profile processing");
-		user_profile = fr_pair_find_by_da(request->control, attr_user_profile, TAG_ANY);
+		user_profile = fr_pair_list_find_by_da(&request->control, attr_user_profile, TAG_ANY);
 
 		profile = user_profile ?
 				      user_profile->vp_strvalue :
@@ -1420,41 +1438,28 @@ release:
 	return rcode;
 }
 
-/*
- *	Generic function for failing between a bunch of queries.
- *
- *	Uses the same principle as rlm_linelog, expanding the 'reference' config
- *	item using xlat to figure out what query it should execute.
- *
- *	If the reference matches multiple config items, and a query fails or
- *	doesn't update any rows, the next matching config item is used.
+/** Expand the 'reference' of an accounting or post-auth section, and find the first query it points to
  *
+ * @param[out] pair_out	The first matching query.
+ * @param[in] request	The current request.
+ * @param[in] section	to resolve the reference in.
+ * @return
+ *	- RLM_MODULE_OK if a query was found.
+ *	- RLM_MODULE_NOOP if the reference didn't match a query.
+ *	- RLM_MODULE_FAIL if the reference couldn't be expanded.
  */
-static int acct_redundant(rlm_sql_t const *inst, REQUEST *request, sql_acct_section_t *section)
+static rlm_rcode_t acct_reference_pair(CONF_PAIR **pair_out, REQUEST *request, sql_acct_section_t *section)
 {
-	rlm_rcode_t		rcode = RLM_MODULE_OK;
-
-	rlm_sql_handle_t	*handle = NULL;
-	int			sql_ret;
-	int			numaffected = 0;
-
 	CONF_ITEM		*item;
-	CONF_PAIR 		*pair;
-	char const		*attr = NULL;
-	char const		*value;
-
 	char			path[FR_MAX_STRING_LEN];
 	char			*p = path;
-	char			*expanded = NULL;
 
 	fr_assert(section);
 
 	if (section->reference[0] != '.') *p++ = '.';
 
 	if (xlat_eval(p, sizeof(path) - (p - path), request, section->reference, NULL, NULL) < 0) {
-		rcode = RLM_MODULE_FAIL;
-
-		goto finish;
+		return RLM_MODULE_FAIL;
 	}
 
 	/*
@@ -1464,21 +1469,48 @@ static int acct_redundant(rlm_sql_t const *inst, REQUEST *request, sql_acct_sect
 	item = cf_reference_item(NULL, section->cs, path);
 	if (!item) {
 		RWDEBUG("No such configuration item %s", path);
-		rcode = RLM_MODULE_NOOP;
-
-		goto finish;
+		return RLM_MODULE_NOOP;
 	}
 	if (cf_item_is_section(item)){
 		RWDEBUG("Sections are not supported as references");
-		rcode = RLM_MODULE_NOOP;
-
-		goto finish;
+		return RLM_MODULE_NOOP;
 	}
 
-	pair = cf_item_to_pair(item);
-	attr = cf_pair_attr(pair);
+	*pair_out = cf_item_to_pair(item);
+
+	RDEBUG2("Using query template '%s'", cf_pair_attr(*pair_out));
+
+	return RLM_MODULE_OK;
+}
+
+/*
+ *	Generic function for failing between a bunch of queries.
+ *
+ *	Uses the same principle as rlm_linelog, expanding the 'reference' config
+ *	item using xlat to figure out what query it should execute.
+ *
+ *	If the reference matches multiple config items, and a query fails or
+ *	doesn't update any rows, the next matching config item is used.
+ *
+ */
+static int acct_redundant(rlm_sql_t const *inst, REQUEST *request, sql_acct_section_t *section)
+{
+	rlm_rcode_t		rcode = RLM_MODULE_OK;
+
+	rlm_sql_handle_t	*handle = NULL;
+	int			sql_ret;
+	int			numaffected = 0;
+
+	CONF_PAIR 		*pair;
+	char const		*attr = NULL;
+	char const		*value;
 
-	RDEBUG2("Using query template '%s'", attr);
+	char			*expanded = NULL;
+
+	rcode = acct_reference_pair(&pair, request, section);
+	if (rcode != RLM_MODULE_OK) goto finish;
+
+	attr = cf_pair_attr(pair);
 
 	handle = fr_pool_connection_get(inst->pool, request);
 	if (!handle) {
@@ -1588,14 +1620,246 @@ finish:
 	return rcode;
 }
 
+/** State for an accounting or post-auth query run via the trunk
+ *
+ */
+typedef struct {
+	sql_acct_section_t	*section;		//!< Section the queries came from.
+	CONF_PAIR		*pair;			//!< Query currently being run.
+	fr_trunk_request_t	*treq;			//!< Trunk request for the in-flight query.
+	sql_rcode_t		sql_rcode;		//!< Result of the last query.
+	int			affected_rows;		//!< Number of rows the last query affected.
+} sql_acct_rctx_t;
+
+/** Write the result of the query to the rctx, and mark the request as runnable
+ *
+ */
+static void sql_trunk_request_complete(REQUEST *request, void *preq, void *rctx, UNUSED void *uctx)
+{
+	rlm_sql_query_t		*query = talloc_get_type_abort(preq, rlm_sql_query_t);
+	sql_acct_rctx_t		*r = talloc_get_type_abort(rctx, sql_acct_rctx_t);
+
+	if (query->error) {
+		if (query->rcode == RLM_SQL_ALT_QUERY) {
+			RDEBUG2("%s", query->error);
+		} else {
+			RERROR("%s", query->error);
+		}
+	}
+
+	r->sql_rcode = query->rcode;
+	r->affected_rows = query->affected_rows;
+	r->treq = NULL;
+
+	unlang_interpret_resumable(request);
+}
+
+/** The query couldn't be sent, treat this the same as a connection failure
+ *
+ */
+static void sql_trunk_request_fail(REQUEST *request, UNUSED void *preq, void *rctx,
+				   UNUSED fr_trunk_request_state_t state, UNUSED void *uctx)
+{
+	sql_acct_rctx_t		*r = talloc_get_type_abort(rctx, sql_acct_rctx_t);
+
+	r->sql_rcode = RLM_SQL_RECONNECT;
+	r->treq = NULL;
+
+	unlang_interpret_resumable(request);
+}
+
+/** Explicitly free the query
+ *
+ */
+static void sql_trunk_request_free(UNUSED REQUEST *request, void *preq_to_free, UNUSED void *uctx)
+{
+	talloc_free(talloc_get_type_abort(preq_to_free, rlm_sql_query_t));
+}
+
+/** Expand the current query and enqueue it on the trunk
+ *
+ */
+static rlm_rcode_t acct_async_enqueue(rlm_sql_t const *inst, rlm_sql_thread_t *t, REQUEST *request,
+				      sql_acct_rctx_t *r)
+{
+	rlm_sql_query_t		*query;
+	fr_trunk_request_t	*treq;
+	char const		*value;
+	char			*expanded = NULL;
+
+	value = cf_pair_value(r->pair);
+	if (!value) {
+		RDEBUG2("Ignoring null query");
+		return RLM_MODULE_NOOP;
+	}
+
+	/*
+	 *	Escaping mustn't block the worker, so drivers
+	 *	don't get a connection of their own to do it.
+	 */
+	if (inst->driver->sql_escape_async_func) {
+		t->escape_failed = false;
+		if (xlat_aeval(request, &expanded, request, value,
+			       inst->driver->sql_escape_async_func, t) < 0) return RLM_MODULE_FAIL;
+
+		if (t->escape_failed) {
+			REDEBUG("Failed escaping values for query");
+			talloc_free(expanded);
+			return RLM_MODULE_FAIL;
+		}
+	} else {
+		rlm_sql_handle_t escape = { .inst = inst };
+
+		if (xlat_aeval(request, &expanded, request, value, sql_escape_func, &escape) < 0) return RLM_MODULE_FAIL;
+	}
+
+	if (!*expanded) {
+		RDEBUG2("Ignoring null query");
+		talloc_free(expanded);
+		return RLM_MODULE_NOOP;
+	}
+
+	rlm_sql_query_log(inst, request, r->section, expanded);
+
+	treq = fr_trunk_request_alloc(t->trunk, request);
+	if (!treq) {
+		talloc_free(expanded);
+		return RLM_MODULE_FAIL;
+	}
+
+	MEM(query = talloc(treq, rlm_sql_query_t));
+	*query = (rlm_sql_query_t){
+		.inst = inst,
+		.request = request,
+		.query_str = talloc_steal(query, expanded),
+		.treq = treq,
+		.rcode = RLM_SQL_ERROR
+	};
+
+	if (fr_trunk_request_enqueue(&treq, t->trunk, request, query, r) < 0) {
+		fr_trunk_request_free(&treq);		/* Return to the free list */
+		return RLM_MODULE_FAIL;
+	}
+
+	r->treq = treq;	/* Remember for signalling purposes */
+
+	return RLM_MODULE_YIELD;
+}
+
+static void acct_async_signal(module_ctx_t const *mctx, REQUEST *request,
+			      void *rctx, fr_state_signal_t action)
+{
+	rlm_sql_t const		*inst = talloc_get_type_abort_const(mctx->instance, rlm_sql_t);
+	sql_acct_rctx_t		*r = talloc_get_type_abort(rctx, sql_acct_rctx_t);
+
+	if (action != FR_SIGNAL_CANCEL) return;
+
+	/*
+	 *	The trunk will discard the result if the
+	 *	query has already been sent.
+	 */
+	if (r->treq) fr_trunk_request_signal_cancel(r->treq);
+	sql_unset_user(inst, request);
+	talloc_free(r);
+}
+
+/** Process the result of an asynchronous query, moving onto the next query in the set if required
+ *
+ * Follows the same logic as #acct_redundant.
+ */
+static rlm_rcode_t acct_async_resume(module_ctx_t const *mctx, REQUEST *request, void *rctx)
+{
+	rlm_sql_t const		*inst = talloc_get_type_abort_const(mctx->instance, rlm_sql_t);
+	rlm_sql_thread_t	*t = talloc_get_type_abort(mctx->thread, rlm_sql_thread_t);
+	sql_acct_rctx_t		*r = talloc_get_type_abort(rctx, sql_acct_rctx_t);
+	rlm_rcode_t		rcode;
+
+	RDEBUG2("SQL query returned: %s", fr_table_str_by_value(sql_rcode_description_table, r->sql_rcode, "<INVALID>"));
+
+	switch (r->sql_rcode) {
+	case RLM_SQL_OK:
+	case RLM_SQL_NO_MORE_ROWS:
+		RDEBUG2("%i record(s) updated", r->affected_rows);
+
+		if (r->affected_rows > 0) {
+			rcode = RLM_MODULE_OK;
+			goto finish;
+		}
+		break;
+
+	case RLM_SQL_ALT_QUERY:
+		break;
+
+	case RLM_SQL_QUERY_INVALID:
+		rcode = RLM_MODULE_INVALID;
+		goto finish;
+
+	case RLM_SQL_ERROR:
+	case RLM_SQL_RECONNECT:
+		rcode = RLM_MODULE_FAIL;
+		goto finish;
+	}
+
+	r->pair = cf_pair_find_next(r->section->cs, r->pair, cf_pair_attr(r->pair));
+	if (!r->pair) {
+		RDEBUG2("No additional queries configured");
+		rcode = RLM_MODULE_NOOP;
+		goto finish;
+	}
+
+	RDEBUG2("Trying next query...");
+
+	rcode = acct_async_enqueue(inst, t, request, r);
+	if (rcode == RLM_MODULE_YIELD) return unlang_module_yield(request, acct_async_resume, acct_async_signal, r);
+
+finish:
+	sql_unset_user(inst, request);
+	talloc_free(r);
+
+	return rcode;
+}
+
+/** Run an accounting or post-auth query set via the trunk
+ *
+ * The request yields while each query is in flight, so the worker can
+ * continue processing other requests.
+ */
+static rlm_rcode_t acct_redundant_async(rlm_sql_t const *inst, rlm_sql_thread_t *t, REQUEST *request,
+					sql_acct_section_t *section)
+{
+	sql_acct_rctx_t		*r;
+	CONF_PAIR		*pair;
+	rlm_rcode_t		rcode;
+
+	rcode = acct_reference_pair(&pair, request, section);
+	if (rcode != RLM_MODULE_OK) return rcode;
+
+	MEM(r = talloc_zero(request, sql_acct_rctx_t));
+	r->section = section;
+	r->pair = pair;
+
+	sql_set_user(inst, request, NULL);
+
+	rcode = acct_async_enqueue(inst, t, request, r);
+	if (rcode == RLM_MODULE_YIELD) return unlang_module_yield(request, acct_async_resume, acct_async_signal, r);
+
+	sql_unset_user(inst, request);
+	talloc_free(r);
+
+	return rcode;
+}
+
 /*
  *	Accounting: Insert or update session data in our sql table
  */
 static rlm_rcode_t CC_HINT(nonnull) mod_accounting(module_ctx_t const *mctx, REQUEST *request)
 {
-	rlm_sql_t const *inst = talloc_get_type_abort_const(mctx->instance, rlm_sql_t);
+	rlm_sql_t const		*inst = talloc_get_type_abort_const(mctx->instance, rlm_sql_t);
+	rlm_sql_thread_t	*t = talloc_get_type_abort(mctx->thread, rlm_sql_thread_t);
 
 	if (inst->config->accounting.reference_cp) {
+		if (t->trunk) return acct_redundant_async(inst, t, request, &inst->config->accounting);
+
 		return acct_redundant(inst, request, &inst->config->accounting);
 	}
 
@@ -1607,15 +1871,62 @@ static rlm_rcode_t CC_HINT(nonnull) mod_accounting(module_ctx_t const *mctx, REQ
  */
 static rlm_rcode_t CC_HINT(nonnull) mod_post_auth(module_ctx_t const *mctx, REQUEST *request)
 {
-	rlm_sql_t const *inst = talloc_get_type_abort_const(mctx->instance, rlm_sql_t);
+	rlm_sql_t const		*inst = talloc_get_type_abort_const(mctx->instance, rlm_sql_t);
+	rlm_sql_thread_t	*t = talloc_get_type_abort(mctx->thread, rlm_sql_thread_t);
 
 	if (inst->config->postauth.reference_cp) {
+		if (t->trunk) return acct_redundant_async(inst, t, request, &inst->config->postauth);
+
 		return acct_redundant(inst, request, &inst->config->postauth);
 	}
 
 	return RLM_MODULE_NOOP;
 }
 
+/** Allocate a trunk for drivers which support asynchronous queries
+ *
+ */
+static int mod_thread_instantiate(UNUSED CONF_SECTION const *cs, void *instance, fr_event_list_t *el, void *thread)
+{
+	rlm_sql_t		*inst = talloc_get_type_abort(instance, rlm_sql_t);
+	rlm_sql_thread_t	*t = talloc_get_type_abort(thread, rlm_sql_thread_t);
+	fr_trunk_io_funcs_t	io_funcs;
+
+	t->inst = inst;
+	t->el = el;
+
+	if (!inst->driver->trunk_io_funcs) return 0;
+
+	io_funcs = *inst->driver->trunk_io_funcs;
+	io_funcs.request_complete = sql_trunk_request_complete;
+	io_funcs.request_fail = sql_trunk_request_fail;
+	io_funcs.request_free = sql_trunk_request_free;
+
+	/*
+	 *	Our escape function would be wrong for
+	 *	drivers which escape values themselves.
+	 */
+	fr_assert(!inst->driver->sql_escape_func || inst->driver->sql_escape_async_func);
+
+	t->trunk = fr_trunk_alloc(t, el, &io_funcs, &inst->config->trunk_conf, inst->name, t, false);
+	if (!t->trunk) return -1;
+
+	return 0;
+}
+
+static int mod_thread_detach(UNUSED fr_event_list_t *el, void *thread)
+{
+	rlm_sql_thread_t	*t = talloc_get_type_abort(thread, rlm_sql_thread_t);
+
+	/*
+	 *	Close the trunk's connections before
+	 *	the event list goes away.
+	 */
+	TALLOC_FREE(t->trunk);
+
+	return 0;
+}
+
 /*
  *	Execute postauth_query after authentication
  */
@@ -1631,6 +1942,11 @@ module_t rlm_sql = {
 	.bootstrap	= mod_bootstrap,
 	.instantiate	= mod_instantiate,
 	.detach		= mod_detach,
+
+	.thread_inst_size = sizeof(rlm_sql_thread_t),
+	.thread_inst_type = "rlm_sql_thread_t",
+	.thread_instantiate = mod_thread_instantiate,
+	.thread_detach	= mod_thread_detach,
 	.methods = {
 		[MOD_AUTHORIZE]		= mod_authorize,
 		[MOD_ACCOUNTING]	= mod_accounting,
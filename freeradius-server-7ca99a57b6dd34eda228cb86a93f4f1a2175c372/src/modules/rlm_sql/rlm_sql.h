@@ -29,6 +29,7 @@ RCSIDH(rlm_sql_h, "$Id$")
 
 #include <freeradius-devel/server/base.h>
 #include <freeradius-devel/server/pool.h>
+#include <freeradius-devel/server/trunk.h>
 #include <freeradius-devel/server/modpriv.h>
 #include <freeradius-devel/server/exfile.h>
 
@@ -128,6 +129,10 @@ typedef struct {
 	void			*driver;			//!< Where drivers should write a
 								//!< pointer to their configurations.
 
+	fr_trunk_conf_t		trunk_conf;			//!< Configuration for the per-worker trunks
+								///< used by drivers which support asynchronous
+								///< queries.
+
 	/*
 	 *	@todo The rest of the queries should also be moved into
 	 *	their own sections.
@@ -150,6 +155,38 @@ typedef struct {
 								//!< when log strings need to be copied.
 } rlm_sql_handle_t;
 
+/** Per-worker state
+ *
+ */
+typedef struct {
+	rlm_sql_t const		*inst;				//!< Instance of rlm_sql.
+	fr_event_list_t		*el;				//!< This thread's event list.
+	fr_trunk_t		*trunk;				//!< Trunk for asynchronous queries.  NULL
+								///< if the driver doesn't support them.
+	void			*escape_conn;			//!< Driver handle of a connected trunk connection,
+								///< used to escape the values of asynchronous
+								///< queries.  Set and cleared by the driver.
+	bool			escape_failed;			//!< Set by the driver's sql_escape_async_func
+								///< if a value couldn't be escaped.
+} rlm_sql_thread_t;
+
+/** A query sent via a trunk
+ *
+ * Allocated by rlm_sql, filled in by the driver's demux callback.
+ */
+typedef struct {
+	rlm_sql_t const		*inst;				//!< Instance of rlm_sql.
+	REQUEST			*request;			//!< Request the query is being run for.
+	char const		*query_str;			//!< Query to send.
+	fr_trunk_request_t	*treq;				//!< Trunk request for this query.
+
+	sql_rcode_t		rcode;				//!< Result of the query.
+	int			affected_rows;			//!< Number of rows affected or returned.
+	char const		*error;				//!< Error message from the server, allocated
+								///< in the context of the query.
+	void			*uctx;				//!< Driver specific tracking data.
+} rlm_sql_query_t;
+
 extern fr_table_num_sorted_t const sql_rcode_description_table[];
 extern size_t sql_rcode_description_table_len;
 extern fr_table_num_sorted_t const sql_rcode_table[];
@@ -211,6 +248,32 @@ typedef struct {
 	sql_rcode_t (*sql_finish_select_query)(rlm_sql_handle_t *handle, rlm_sql_config_t *config);
 
 	xlat_escape_legacy_t	sql_escape_func;
+
+	/** I/O functions for asynchronous queries
+	 *
+	 * If set, rlm_sql allocates a trunk per worker, and queries which can be
+	 * run asynchronously are enqueued as #rlm_sql_query_t, with the request
+	 * yielding until the driver signals the result.
+	 *
+	 * The driver provides the connection and mux/demux callbacks. The
+	 * request_complete, request_fail and request_free callbacks are provided
+	 * by rlm_sql, and must be left NULL.
+	 *
+	 * The uctx passed to all callbacks is the #rlm_sql_thread_t.
+	 */
+	fr_trunk_io_funcs_t const	*trunk_io_funcs;
+
+	/** Escape values for asynchronous queries
+	 *
+	 * Called with the #rlm_sql_thread_t as the arg.  This runs on the worker,
+	 * so it must not block.  Drivers which need a connection to escape values
+	 * should use #rlm_sql_thread_t.escape_conn.  If a value can't be escaped,
+	 * the driver must set #rlm_sql_thread_t.escape_failed, and the query is
+	 * not sent.
+	 *
+	 * If NULL, the values of asynchronous queries are escaped by rlm_sql.
+	 */
+	xlat_escape_legacy_t		sql_escape_async_func;
 } rlm_sql_driver_t;
 
 struct sql_inst {
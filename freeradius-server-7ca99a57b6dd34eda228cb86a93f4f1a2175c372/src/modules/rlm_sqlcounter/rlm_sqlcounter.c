@@ -341,7 +341,7 @@ static ssize_t sqlcounter_expand(char *out, int outlen, rlm_sqlcounter_t const *
  *	See if the counter matches.
  */
 static int counter_cmp(void *instance, REQUEST *request, UNUSED VALUE_PAIR *req , VALUE_PAIR *check,
-		       UNUSED VALUE_PAIR *check_pairs, UNUSED VALUE_PAIR **reply_pairs)
+		       UNUSED VALUE_PAIR *check_pairs, UNUSED fr_pair_list_t *reply_pairs)
 {
 	rlm_sqlcounter_t const *inst = talloc_get_type_abort_const(instance, rlm_sqlcounter_t);
 	uint64_t counter;
@@ -491,13 +491,13 @@ static rlm_rcode_t CC_HINT(nonnull) mod_post_auth(module_ctx_t const *mctx, REQU
 	/*
 	 *	If there is a Framed-IP-Address attribute in the reply do nothing
 	 */
-	if (fr_pair_find_by_da(request->reply->vps, inst->framed_ip_address, TAG_ANY) != NULL) {
+	if (fr_pair_list_find_by_da(&request->reply->vps, inst->framed_ip_address, TAG_ANY) != NULL) {
 		RDEBUG2("%s already exists", inst->framed_ip_address->name);
 
 		return do_logging(inst, request, inst->log_exists, RLM_MODULE_NOOP);
 	}
 
-	if (fr_pair_find_by_da(request->control, attr_pool_name, TAG_ANY) == NULL) {
+	if (fr_pair_list_find_by_da(&request->control, attr_pool_name, TAG_ANY) == NULL) {
 		RDEBUG2("No %s defined", attr_pool_name->name);
 
 		return do_logging(inst, request, inst->log_nopool, RLM_MODULE_NOOP);
@@ -607,7 +607,7 @@ static rlm_rcode_t CC_HINT(nonnull) mod_post_auth(module_ctx_t const *mctx, REQU
 	}
 
 	RDEBUG2("Allocated IP %s", allocation);
-	fr_pair_add(&request->reply->vps, vp);
+	fr_pair_list_append(&request->reply->vps, vp);
 
 	/*
 	 *	UPDATE
@@ -685,7 +685,7 @@ static rlm_rcode_t CC_HINT(nonnull) mod_accounting(module_ctx_t const *mctx, REQ
 	int			acct_status_type;
 	rlm_sql_handle_t	*handle;
 
-	vp = fr_pair_find_by_da(request->packet->vps, attr_acct_status_type, TAG_ANY);
+	vp = fr_pair_list_find_by_da(&request->packet->vps, attr_acct_status_type, TAG_ANY);
 	if (!vp) {
 		RDEBUG2("Could not find account status type in packet");
 		return RLM_MODULE_NOOP;
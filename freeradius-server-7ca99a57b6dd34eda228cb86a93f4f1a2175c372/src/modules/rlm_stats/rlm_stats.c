@@ -239,7 +239,7 @@ static rlm_rcode_t CC_HINT(nonnull) mod_stats(module_ctx_t const *mctx, REQUEST
 		return RLM_MODULE_NOOP;
 	}
 
-	vp = fr_pair_find_by_da(request->packet->vps, attr_freeradius_stats4_type, TAG_ANY);
+	vp = fr_pair_list_find_by_da(&request->packet->vps, attr_freeradius_stats4_type, TAG_ANY);
 	if (!vp) {
 		stats_type = FR_FREERADIUS_STATS4_TYPE_VALUE_GLOBAL;
 	} else {
@@ -249,7 +249,7 @@ static rlm_rcode_t CC_HINT(nonnull) mod_stats(module_ctx_t const *mctx, REQUEST
 	/*
 	 *	Create attributes based on the statistics.
 	 */
-	fr_cursor_init(&cursor, &request->reply->vps);
+	fr_pair_list_cursor_init(&cursor, &request->reply->vps);
 
 	MEM(pair_update_reply(&vp, attr_freeradius_stats4_type) >= 0);
 	vp->vp_uint32 = stats_type;
@@ -273,8 +273,8 @@ static rlm_rcode_t CC_HINT(nonnull) mod_stats(module_ctx_t const *mctx, REQUEST
 		break;
 
 	case FR_FREERADIUS_STATS4_TYPE_VALUE_CLIENT:			/* src */
-		vp = fr_pair_find_by_da(request->packet->vps, attr_freeradius_stats4_ipv4_address, TAG_ANY);
-		if (!vp) vp = fr_pair_find_by_da(request->packet->vps, attr_freeradius_stats4_ipv6_address, TAG_ANY);
+		vp = fr_pair_list_find_by_da(&request->packet->vps, attr_freeradius_stats4_ipv4_address, TAG_ANY);
+		if (!vp) vp = fr_pair_list_find_by_da(&request->packet->vps, attr_freeradius_stats4_ipv6_address, TAG_ANY);
 		if (!vp) return RLM_MODULE_NOOP;
 
 		mydata.ipaddr = vp->vp_ip;
@@ -282,8 +282,8 @@ static rlm_rcode_t CC_HINT(nonnull) mod_stats(module_ctx_t const *mctx, REQUEST
 		break;
 
 	case FR_FREERADIUS_STATS4_TYPE_VALUE_LISTENER:			/* dst */
-		vp = fr_pair_find_by_da(request->packet->vps, attr_freeradius_stats4_ipv4_address, TAG_ANY);
-		if (!vp) vp = fr_pair_find_by_da(request->packet->vps, attr_freeradius_stats4_ipv6_address, TAG_ANY);
+		vp = fr_pair_list_find_by_da(&request->packet->vps, attr_freeradius_stats4_ipv4_address, TAG_ANY);
+		if (!vp) vp = fr_pair_list_find_by_da(&request->packet->vps, attr_freeradius_stats4_ipv6_address, TAG_ANY);
 		if (!vp) return RLM_MODULE_NOOP;
 
 		mydata.ipaddr = vp->vp_ip;
@@ -189,7 +189,7 @@ fr_dict_attr_autoload_t rlm_test_dict_attr[] = {
 };
 
 static int rlm_test_cmp(UNUSED void *instance, REQUEST *request, UNUSED VALUE_PAIR *thing, VALUE_PAIR *check,
-			UNUSED VALUE_PAIR *check_pairs, UNUSED VALUE_PAIR **reply_pairs)
+			UNUSED VALUE_PAIR *check_pairs, UNUSED fr_pair_list_t *reply_pairs)
 {
 	fr_assert(check->vp_type == FR_TYPE_STRING);
 
@@ -221,6 +221,30 @@ static int mod_thread_detach(UNUSED fr_event_list_t *el, void *thread)
 	return 0;
 }
 
+/** Count how many times this function has been called
+ *
+ * Registered as a pure function, so that tests can check whether
+ * calls were answered from the memoization table instead of being
+ * evaluated again.  A memoized call returns the previous count.
+ *
+@verbatim
+%{test_call_count:<any>}
+@endverbatim
+ */
+static xlat_action_t test_call_count_xlat(TALLOC_CTX *ctx, fr_cursor_t *out,
+					  UNUSED REQUEST *request, UNUSED void const *xlat_inst,
+					  UNUSED void *xlat_thread_inst, UNUSED fr_value_box_t **in)
+{
+	static _Thread_local uint64_t	calls;
+	fr_value_box_t			*vb;
+
+	MEM(vb = fr_value_box_alloc(ctx, FR_TYPE_UINT64, NULL, false));
+	vb->vb_uint64 = ++calls;
+	fr_cursor_append(out, vb);
+
+	return XLAT_ACTION_DONE;
+}
+
 /*
  *	Do any per-module bootstrapping that is separate to each
  *	configured instance of the module.  e.g. set up connections
@@ -233,7 +257,8 @@ static int mod_thread_detach(UNUSED fr_event_list_t *el, void *thread)
  */
 static int mod_bootstrap(void *instance, UNUSED CONF_SECTION *conf)
 {
-	rlm_test_t *inst = instance;
+	rlm_test_t	*inst = instance;
+	xlat_t const	*xlat;
 
 	if (paircmp_register_by_name("Test-Paircmp", attr_user_name, false,
 					rlm_test_cmp, inst) < 0) {
@@ -241,6 +266,9 @@ static int mod_bootstrap(void *instance, UNUSED CONF_SECTION *conf)
 		return -1;
 	}
 
+	xlat = xlat_register(inst, "test_call_count", test_call_count_xlat, false);
+	if (xlat) xlat_pure_set(xlat);
+
 	/*
 	 *	Log some messages
 	 */
@@ -123,7 +123,7 @@ static rlm_rcode_t CC_HINT(nonnull) mod_authorize(UNUSED module_ctx_t const *mct
 	/*
 	 *	Fix Calling-Station-Id.  Damn you, WiMAX!
 	 */
-	vp = fr_pair_find_by_da(request->packet->vps, attr_calling_station_id, TAG_ANY);
+	vp = fr_pair_list_find_by_da(&request->packet->vps, attr_calling_station_id, TAG_ANY);
 	if (vp && (vp->vp_length == 6)) {
 		int	i;
 		char	*p;
@@ -173,8 +173,8 @@ static rlm_rcode_t CC_HINT(nonnull) mod_post_auth(module_ctx_t const *mctx, REQU
 	uint8_t			mip_rk_1[EVP_MAX_MD_SIZE], mip_rk_2[EVP_MAX_MD_SIZE];
 	uint8_t			mip_rk[2 * EVP_MAX_MD_SIZE];
 
-	msk = fr_pair_find_by_da(request->reply->vps, attr_eap_msk, TAG_ANY);
-	emsk = fr_pair_find_by_da(request->reply->vps, attr_eap_emsk, TAG_ANY);
+	msk = fr_pair_list_find_by_da(&request->reply->vps, attr_eap_msk, TAG_ANY);
+	emsk = fr_pair_list_find_by_da(&request->reply->vps, attr_eap_emsk, TAG_ANY);
 	if (!msk || !emsk) {
 		REDEBUG2("No EAP-MSK or EAP-EMSK.  Cannot create WiMAX keys");
 		return RLM_MODULE_NOOP;
@@ -248,8 +248,8 @@ static rlm_rcode_t CC_HINT(nonnull) mod_post_auth(module_ctx_t const *mctx, REQU
 	/*
 	 *	Calculate mobility keys
 	 */
-	mn_nai = fr_pair_find_by_da(request->packet->vps, attr_wimax_mn_nai, TAG_ANY);
-	if (!mn_nai) mn_nai = fr_pair_find_by_da(request->reply->vps, attr_wimax_mn_nai, TAG_ANY);
+	mn_nai = fr_pair_list_find_by_da(&request->packet->vps, attr_wimax_mn_nai, TAG_ANY);
+	if (!mn_nai) mn_nai = fr_pair_list_find_by_da(&request->reply->vps, attr_wimax_mn_nai, TAG_ANY);
 	if (!mn_nai) {
 		RWDEBUG("%s was not found in the request or in the reply", attr_wimax_mn_nai->name);
 		RWDEBUG("We cannot calculate MN-HA keys");
@@ -259,7 +259,7 @@ static rlm_rcode_t CC_HINT(nonnull) mod_post_auth(module_ctx_t const *mctx, REQU
 	 *	WiMAX-IP-Technology
 	 */
 	vp = NULL;
-	if (mn_nai) vp = fr_pair_find_by_da(request->reply->vps, attr_wimax_ip_technology, TAG_ANY);
+	if (mn_nai) vp = fr_pair_list_find_by_da(&request->reply->vps, attr_wimax_ip_technology, TAG_ANY);
 	if (!vp) {
 		RWDEBUG("%s not found in reply", attr_wimax_ip_technology->name);
 		RWDEBUG("Not calculating MN-HA keys");
@@ -270,7 +270,7 @@ static rlm_rcode_t CC_HINT(nonnull) mod_post_auth(module_ctx_t const *mctx, REQU
 		/*
 		 *	Look for WiMAX-hHA-IP-MIP4
 		 */
-		ip = fr_pair_find_by_da(request->reply->vps, attr_wimax_hha_ip_mip4, TAG_ANY);
+		ip = fr_pair_list_find_by_da(&request->reply->vps, attr_wimax_hha_ip_mip4, TAG_ANY);
 		if (!ip) {
 			RWDEBUG("%s not found.  Cannot calculate MN-HA-PMIP4 key", attr_wimax_hha_ip_mip4->name);
 			break;
@@ -304,7 +304,7 @@ static rlm_rcode_t CC_HINT(nonnull) mod_post_auth(module_ctx_t const *mctx, REQU
 		/*
 		 *	Look for WiMAX-hHA-IP-MIP4
 		 */
-		ip = fr_pair_find_by_da(request->reply->vps, attr_wimax_hha_ip_mip4, TAG_ANY);
+		ip = fr_pair_list_find_by_da(&request->reply->vps, attr_wimax_hha_ip_mip4, TAG_ANY);
 		if (!ip) {
 			RWDEBUG("%s not found.  Cannot calculate MN-HA-CMIP4 key", attr_wimax_hha_ip_mip4->name);
 			break;
@@ -338,7 +338,7 @@ static rlm_rcode_t CC_HINT(nonnull) mod_post_auth(module_ctx_t const *mctx, REQU
 		/*
 		 *	Look for WiMAX-hHA-IP-MIP6
 		 */
-		ip = fr_pair_find_by_da(request->reply->vps, attr_wimax_hha_ip_mip6, TAG_ANY);
+		ip = fr_pair_list_find_by_da(&request->reply->vps, attr_wimax_hha_ip_mip6, TAG_ANY);
 		if (!ip) {
 			RWDEBUG("%s not found.  Cannot calculate MN-HA-CMIP6 key", attr_wimax_hha_ip_mip6->name);
 			break;
@@ -377,7 +377,7 @@ static rlm_rcode_t CC_HINT(nonnull) mod_post_auth(module_ctx_t const *mctx, REQU
 	 *
 	 *	FA-RK= H(MIP-RK, "FA-RK")
 	 */
-	fa_rk = fr_pair_find_by_da(request->reply->vps, attr_wimax_fa_rk_key, TAG_ANY);
+	fa_rk = fr_pair_list_find_by_da(&request->reply->vps, attr_wimax_fa_rk_key, TAG_ANY);
 	if (fa_rk && (fa_rk->vp_length <= 1)) {
 		HMAC_Init_ex(hmac, mip_rk, rk_len, EVP_sha1(), NULL);
 
@@ -402,7 +402,7 @@ static rlm_rcode_t CC_HINT(nonnull) mod_post_auth(module_ctx_t const *mctx, REQU
 	 *
 	 *	WiMAX-RRQ-MN-HA-SPI
 	 */
-	vp = fr_pair_find_by_da(request->packet->vps, attr_wimax_rrq_mn_ha_spi, TAG_ANY);
+	vp = fr_pair_list_find_by_da(&request->packet->vps, attr_wimax_rrq_mn_ha_spi, TAG_ANY);
 	if (vp) {
 		REDEBUG2("Client requested MN-HA key: Should use SPI to look up key from storage");
 		if (!mn_nai) {
@@ -412,14 +412,14 @@ static rlm_rcode_t CC_HINT(nonnull) mod_post_auth(module_ctx_t const *mctx, REQU
 		/*
 		 *	WiMAX-RRQ-HA-IP
 		 */
-		if (!fr_pair_find_by_da(request->packet->vps, attr_wimax_rrq_ha_ip, TAG_ANY)) {
+		if (!fr_pair_list_find_by_da(&request->packet->vps, attr_wimax_rrq_ha_ip, TAG_ANY)) {
 			RWDEBUG("HA-IP was not found!");
 		}
 
 		/*
 		 *	WiMAX-HA-RK-Key-Requested
 		 */
-		vp = fr_pair_find_by_da(request->packet->vps, attr_wimax_ha_rk_key_requested, TAG_ANY);
+		vp = fr_pair_list_find_by_da(&request->packet->vps, attr_wimax_ha_rk_key_requested, TAG_ANY);
 		if (vp && (vp->vp_uint32 == 1)) {
 			REDEBUG2("Client requested HA-RK: Should use IP to look it up from storage");
 		}
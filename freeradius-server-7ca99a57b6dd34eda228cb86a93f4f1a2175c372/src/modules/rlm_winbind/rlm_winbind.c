@@ -86,7 +86,7 @@ fr_dict_attr_autoload_t rlm_winbind_dict_attr[] = {
  *	- 1 failure or user is not in group
  */
 static int winbind_group_cmp(void *instance, REQUEST *request, UNUSED VALUE_PAIR *req, VALUE_PAIR *check,
-			     UNUSED VALUE_PAIR *check_pairs, UNUSED VALUE_PAIR **reply_pairs)
+			     UNUSED VALUE_PAIR *check_pairs, UNUSED fr_pair_list_t *reply_pairs)
 {
 	rlm_winbind_t		*inst = instance;
 	rlm_rcode_t		rcode = 1;
@@ -106,7 +106,7 @@ static int winbind_group_cmp(void *instance, REQUEST *request, UNUSED VALUE_PAIR
 	ssize_t			slen;
 	size_t			backslash = 0;
 
-	vp_username = fr_pair_find_by_da(request->packet->vps, attr_user_name, TAG_ANY);
+	vp_username = fr_pair_list_find_by_da(&request->packet->vps, attr_user_name, TAG_ANY);
 	if (!vp_username) return -1;
 
 	RINDENT();
@@ -465,7 +465,7 @@ static rlm_rcode_t CC_HINT(nonnull) mod_authorize(module_ctx_t const *mctx, REQU
 	rlm_winbind_t const	*inst = talloc_get_type_abort_const(mctx->instance, rlm_winbind_t);
 	VALUE_PAIR		*vp;
 
-	vp = fr_pair_find_by_da(request->packet->vps, attr_user_password, TAG_ANY);
+	vp = fr_pair_list_find_by_da(&request->packet->vps, attr_user_password, TAG_ANY);
 	if (!vp) {
 		REDEBUG2("No User-Password found in the request; not doing winbind authentication.");
 		return RLM_MODULE_NOOP;
@@ -495,8 +495,8 @@ static rlm_rcode_t CC_HINT(nonnull) mod_authenticate(module_ctx_t const *mctx, R
 	rlm_winbind_t const	*inst = talloc_get_type_abort_const(mctx->instance, rlm_winbind_t);
 	VALUE_PAIR		*username, *password;
 
-	username = fr_pair_find_by_da(request->packet->vps, attr_user_name, TAG_ANY);
-	password = fr_pair_find_by_da(request->packet->vps, attr_user_password, TAG_ANY);
+	username = fr_pair_list_find_by_da(&request->packet->vps, attr_user_name, TAG_ANY);
+	password = fr_pair_list_find_by_da(&request->packet->vps, attr_user_password, TAG_ANY);
 
 	/*
 	 *	We can only authenticate user requests which HAVE
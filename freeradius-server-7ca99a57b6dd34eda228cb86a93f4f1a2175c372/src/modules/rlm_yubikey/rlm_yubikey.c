@@ -257,7 +257,7 @@ static rlm_rcode_t CC_HINT(nonnull) mod_authorize(module_ctx_t const *mctx, REQU
 	/*
 	 *	Can't do yubikey auth if there's no password.
 	 */
-	password = fr_pair_find_by_da(request->packet->vps, attr_user_password, TAG_ANY);
+	password = fr_pair_list_find_by_da(&request->packet->vps, attr_user_password, TAG_ANY);
 	if (!password) {
 		/*
 		 *	Don't print out debugging messages if we know
@@ -364,13 +364,13 @@ static rlm_rcode_t CC_HINT(nonnull) mod_authenticate(module_ctx_t const *mctx, R
 	size_t			len;
 	int			ret;
 
-	vp = fr_pair_find_by_da(request->packet->vps, attr_yubikey_otp, TAG_ANY);
+	vp = fr_pair_list_find_by_da(&request->packet->vps, attr_yubikey_otp, TAG_ANY);
 	if (!vp) {
 		RDEBUG2("No Yubikey-OTP attribute found, falling back to User-Password");
 		/*
 		 *	Can't do yubikey auth if there's no password.
 		 */
-		vp = fr_pair_find_by_da(request->packet->vps, attr_user_password, TAG_ANY);
+		vp = fr_pair_list_find_by_da(&request->packet->vps, attr_user_password, TAG_ANY);
 		if (!vp) {
 			REDEBUG("No User-Password in the request. Can't do Yubikey authentication");
 			return RLM_MODULE_INVALID;
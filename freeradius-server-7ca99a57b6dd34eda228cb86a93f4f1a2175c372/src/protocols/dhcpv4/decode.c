@@ -459,6 +459,7 @@ static ssize_t fr_dhcpv4_decode_proto(TALLOC_CTX *ctx, VALUE_PAIR **vps, uint8_t
 	ssize_t rcode;
 //	fr_dhcpv4_ctx_t	*test_ctx = talloc_get_type_abort(proto_ctx, fr_dhcpv4_ctx_t);
 	RADIUS_PACKET *packet;
+	VALUE_PAIR *head = NULL;
 
 	if (!fr_dhcpv4_ok(data, data_len, NULL, NULL)) return -1;
 
@@ -467,9 +468,9 @@ static ssize_t fr_dhcpv4_decode_proto(TALLOC_CTX *ctx, VALUE_PAIR **vps, uint8_t
 
 	memcpy(&packet->data, &data, sizeof(packet->data)); /* const issues */
 	packet->data_len = data_len;
-	rcode = fr_dhcpv4_decode(packet, packet->data, packet->data_len, &packet->vps, &packet->code);
+	rcode = fr_dhcpv4_decode(packet, packet->data, packet->data_len, &head, &packet->code);
 
-	(void) fr_pair_list_copy(ctx, vps, packet->vps);
+	(void) fr_pair_list_copy(ctx, vps, head);
 	talloc_free(packet);
 
 	return rcode;
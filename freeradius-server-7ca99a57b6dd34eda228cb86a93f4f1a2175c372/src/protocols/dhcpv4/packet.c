@@ -344,13 +344,13 @@ int fr_dhcpv4_packet_encode(RADIUS_PACKET *packet)
 	if (packet->code == 0) packet->code = FR_DHCP_NAK;
 
 	/* store xid */
-	if ((vp = fr_pair_find_by_da(packet->vps, attr_dhcp_transaction_id, TAG_ANY))) {
+	if ((vp = fr_pair_list_find_by_da(&packet->vps, attr_dhcp_transaction_id, TAG_ANY))) {
 		packet->id = vp->vp_uint32;
 	} else {
 		packet->id = fr_rand();
 	}
 
-	len = fr_dhcpv4_encode(packet->data, packet->data_len, NULL, packet->code, packet->id, packet->vps);
+	len = fr_dhcpv4_encode(packet->data, packet->data_len, NULL, packet->code, packet->id, fr_pair_list_head(&packet->vps));
 	if (len < 0) return -1;
 
 	packet->data_len = len;
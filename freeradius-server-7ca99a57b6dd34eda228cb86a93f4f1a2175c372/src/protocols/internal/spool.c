@@ -0,0 +1,303 @@
+/*
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Lesser General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2.1 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *   Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/**
+ * $Id$
+ *
+ * @file protocols/internal/spool.c
+ * @brief Functions to encode and decode binary spool records.
+ *
+ * @copyright 2020 The FreeRADIUS server project
+ */
+#include <freeradius-devel/internal/internal.h>
+#include <freeradius-devel/internal/spool.h>
+#include <freeradius-devel/io/pair.h>
+#include <freeradius-devel/util/crc32.h>
+#include <freeradius-devel/util/net.h>
+#include <freeradius-devel/util/proto.h>
+
+/** Encode attributes for the payload of a spool record
+ *
+ * @param[out] out		Where to write the attributes.
+ * @param[in] outlen		Length of the out buffer.
+ * @param[in] cursor		Attributes to encode.  All attributes from the
+ *				current position of the cursor are encoded.
+ * @param[in] filter		Optional callback.  Attributes for which it returns
+ *				false are not encoded.
+ * @param[in] uctx		to pass to the filter.
+ * @return
+ *	- >=0 the number of bytes written.
+ *	- <0 on error.  If the error is PAIR_ENCODE_FATAL_ERROR, the
+ *	  attributes can't be encoded, otherwise the buffer is too small.
+ */
+ssize_t fr_spool_pairs_encode(uint8_t *out, size_t outlen, fr_cursor_t *cursor,
+			      bool (*filter)(VALUE_PAIR const *vp, void *uctx), void *uctx)
+{
+	fr_dict_t const		*internal = fr_dict_internal();
+	uint8_t			*p = out, *end = out + outlen;
+	VALUE_PAIR		*vp;
+
+	while ((vp = fr_cursor_current(cursor))) {
+		ssize_t slen;
+
+		if (filter && !filter(vp, uctx)) {
+			fr_cursor_next(cursor);
+			continue;
+		}
+
+		if ((end - p) < 2) return -1;
+
+		*p = (fr_dict_by_da(vp->da) == internal) ? FR_SPOOL_DICT_INTERNAL : FR_SPOOL_DICT_PROTOCOL;
+
+		/*
+		 *	This advances the cursor.
+		 */
+		slen = fr_internal_encode_pair(p + 1, end - (p + 1), cursor, NULL);
+		if (slen == PAIR_ENCODE_FATAL_ERROR) return slen;
+		if (slen < 0) return -1;
+
+		p += 1 + slen;
+	}
+
+	return p - out;
+}
+
+/** Write the header of a spool record, once the payload has been encoded
+ *
+ * @param[in,out] out		Start of the record.  The payload starts
+ *				#FR_SPOOL_HDR_LEN bytes later.
+ * @param[in] len		Length of the record, including the header.
+ * @param[in] record		Fixed fields of the record.
+ * @return
+ *	- 0 on success.
+ *	- -1 if the record is too large.
+ */
+int fr_spool_record_header(uint8_t *out, size_t len, fr_spool_record_t const *record)
+{
+	if ((len < FR_SPOOL_HDR_LEN) || (len > (FR_SPOOL_HDR_LEN + FR_SPOOL_MAX_LEN))) {
+		fr_strerror_printf("Invalid record length %zu", len);
+		return -1;
+	}
+
+	out[0] = FR_SPOOL_MAGIC;
+	out[1] = 'S';
+	out[2] = 'P';
+	out[3] = FR_SPOOL_VERSION;
+	fr_net_from_uint32(out + 4, len - FR_SPOOL_HDR_LEN);
+	out[FR_SPOOL_FLAGS_OFFSET] = record->flags;
+	memset(out + FR_SPOOL_FLAGS_OFFSET + 1, 0, 3);
+	fr_net_from_uint32(out + 16, record->code);
+	fr_net_from_uint32(out + 20, fr_dict_root(record->dict)->attr);
+	fr_net_from_uint64(out + 24, fr_unix_time_to_nsec(record->timestamp));
+	fr_net_from_uint32(out + 12, fr_crc32c(0, out + 16, len - 16));
+
+	return 0;
+}
+
+/** Encode a packet as a spool record
+ *
+ * @param[out] out		Where to write the record.
+ * @param[in] outlen		Length of the out buffer.
+ * @param[in] record		Fixed fields of the record.
+ * @param[in] cursor		Attributes to encode.
+ * @param[in] filter		Optional callback, as with #fr_spool_pairs_encode.
+ * @param[in] uctx		to pass to the filter.
+ * @return
+ *	- >0 the length of the record.
+ *	- 0 the out buffer is too small.
+ *	- <0 on error.
+ */
+ssize_t fr_spool_record_encode(uint8_t *out, size_t outlen, fr_spool_record_t const *record,
+			       fr_cursor_t *cursor, bool (*filter)(VALUE_PAIR const *vp, void *uctx), void *uctx)
+{
+	ssize_t slen;
+
+	if (outlen < FR_SPOOL_HDR_LEN) return 0;
+
+	slen = fr_spool_pairs_encode(out + FR_SPOOL_HDR_LEN, outlen - FR_SPOOL_HDR_LEN, cursor, filter, uctx);
+	if (slen == PAIR_ENCODE_FATAL_ERROR) return -1;
+	if (slen < 0) return 0;
+
+	if (fr_spool_record_header(out, FR_SPOOL_HDR_LEN + slen, record) < 0) return -1;
+
+	return FR_SPOOL_HDR_LEN + slen;
+}
+
+/** Check the header and checksum of a spool record
+ *
+ * @param[in] data		Start of the record.
+ * @param[in] data_len		Length of the data available.
+ * @return
+ *	- >0 the length of the record, including the header.
+ *	- 0 more data is needed.
+ *	- <0 the record is invalid.  Use #fr_spool_record_sync
+ *	  to find the next record.
+ */
+ssize_t fr_spool_record_length(uint8_t const *data, size_t data_len)
+{
+	size_t	len;
+
+	if (data_len < FR_SPOOL_HDR_LEN) return 0;
+
+	if ((data[0] != FR_SPOOL_MAGIC) || (data[1] != 'S') || (data[2] != 'P')) {
+		fr_strerror_printf("Invalid record header");
+		return -1;
+	}
+
+	if (data[3] != FR_SPOOL_VERSION) {
+		fr_strerror_printf("Unsupported record version %u", data[3]);
+		return -1;
+	}
+
+	len = fr_net_to_uint32(data + 4);
+	if (len > FR_SPOOL_MAX_LEN) {
+		fr_strerror_printf("Invalid record length %zu", len);
+		return -1;
+	}
+
+	len += FR_SPOOL_HDR_LEN;
+	if (data_len < len) return 0;
+
+	if (fr_crc32c(0, data + 16, len - 16) != fr_net_to_uint32(data + 12)) {
+		fr_strerror_printf("Record checksum mismatch");
+		return -1;
+	}
+
+	return len;
+}
+
+/** Check whether a record may start at a given position
+ *
+ * The length of a record which is too large to read in full can't
+ * be verified with the checksum.  Readers should only believe it if
+ * the record ends where another record starts, or at the end of the
+ * file.
+ *
+ * Only the fields of the header which are available are checked, so
+ * a header which is still being written by another process is
+ * accepted.
+ *
+ * @param[in] data		Where the record may start.
+ * @param[in] data_len		Length of the data available.  0 means
+ *				data is at the end of the file.
+ * @return
+ *	- true if data is the start of a record, or the end of the file.
+ *	- false if data can't be the start of a record.
+ */
+bool fr_spool_record_boundary(uint8_t const *data, size_t data_len)
+{
+	if ((data_len > 0) && (data[0] != FR_SPOOL_MAGIC)) return false;
+	if ((data_len > 1) && (data[1] != 'S')) return false;
+	if ((data_len > 2) && (data[2] != 'P')) return false;
+	if ((data_len > 3) && (data[3] != FR_SPOOL_VERSION)) return false;
+	if ((data_len >= 8) && (fr_net_to_uint32(data + 4) > FR_SPOOL_MAX_LEN)) return false;
+
+	return true;
+}
+
+/** Find where the next record may start, after an invalid one
+ *
+ * @param[in] data		Start of the invalid record.
+ * @param[in] data_len		Length of the data available.
+ * @return the number of bytes to skip.
+ */
+ssize_t fr_spool_record_sync(uint8_t const *data, size_t data_len)
+{
+	uint8_t const	*p = data + 1, *end = data + data_len;
+
+	while ((p = memchr(p, FR_SPOOL_MAGIC, end - p)) != NULL) {
+		if ((end - p) < 4) return p - data;
+
+		if ((p[1] == 'S') && (p[2] == 'P') && (p[3] == FR_SPOOL_VERSION)) return p - data;
+		p++;
+	}
+
+	return data_len;
+}
+
+/** Decode a spool record
+ *
+ * @param[in] ctx		to allocate attributes in.
+ * @param[in] cursor		to add the decoded attributes to.
+ * @param[out] record		Fixed fields of the record.
+ * @param[in] data		Start of the record.
+ * @param[in] data_len		Length of the record.
+ * @return
+ *	- >0 the length of the record.
+ *	- <0 on error.
+ */
+ssize_t fr_spool_record_decode(TALLOC_CTX *ctx, fr_cursor_t *cursor, fr_spool_record_t *record,
+			       uint8_t const *data, size_t data_len)
+{
+	fr_dict_t const		*internal = fr_dict_internal();
+	uint8_t const		*p, *end;
+	VALUE_PAIR		*head = NULL;
+	fr_cursor_t		tmp;
+	ssize_t			len;
+
+	len = fr_spool_record_length(data, data_len);
+	if (len <= 0) {
+		if (len == 0) fr_strerror_printf("Truncated record");
+		return -1;
+	}
+
+	record->flags = data[FR_SPOOL_FLAGS_OFFSET];
+	record->code = fr_net_to_uint32(data + 16);
+	record->timestamp = fr_unix_time_from_nsec(fr_net_to_uint64(data + 24));
+	record->dict = fr_dict_by_protocol_num(fr_net_to_uint32(data + 20));
+	if (!record->dict) {
+		fr_strerror_printf("Unknown protocol %u", fr_net_to_uint32(data + 20));
+		return -1;
+	}
+
+	fr_cursor_init(&tmp, &head);
+
+	p = data + FR_SPOOL_HDR_LEN;
+	end = data + len;
+	while (p < end) {
+		fr_dict_t const	*dict;
+		ssize_t		slen;
+
+		switch (*p) {
+		case FR_SPOOL_DICT_PROTOCOL:
+			dict = record->dict;
+			break;
+
+		case FR_SPOOL_DICT_INTERNAL:
+			dict = internal;
+			break;
+
+		default:
+			fr_strerror_printf("Invalid dictionary %u at offset %zu", *p, (size_t) (p - data));
+		error:
+			fr_pair_list_free(&head);
+			return -1;
+		}
+		p++;
+
+		slen = fr_internal_decode_pair(ctx, &tmp, dict, p, end - p, NULL);
+		if (slen <= 0) {
+			fr_strerror_printf_push("Failed decoding attribute at offset %zu", (size_t) (p - data));
+			goto error;
+		}
+		p += slen;
+	}
+
+	fr_cursor_head(&tmp);
+	fr_cursor_merge(cursor, &tmp);
+
+	return len;
+}
@@ -0,0 +1,103 @@
+#pragma once
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/*
+ * $Id$
+ *
+ * @file protocols/internal/spool.h
+ * @brief Binary spool records, for store and forward.
+ *
+ * @copyright 2020 The FreeRADIUS server project
+ */
+#include <freeradius-devel/util/cursor.h>
+#include <freeradius-devel/util/dict.h>
+#include <freeradius-devel/util/pair.h>
+#include <freeradius-devel/util/time.h>
+
+#include <talloc.h>
+
+/*
+ *	Every record starts with a fixed size header, all fields in
+ *	network byte order.  The records are self-describing, so a
+ *	spool file is simply records appended one after the other,
+ *	and a reader can resynchronise on the magic after damage.
+ *
+ *	 0                   1                   2                   3
+ *	 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+ *	+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ *	|     Magic     |      'S'      |      'P'      |    Version    |
+ *	+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ *	|                        Payload length                         |
+ *	+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ *	|     Flags     |                   Reserved                    |
+ *	+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ *	|                       CRC32C (16..end)                        |
+ *	+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ *	|                          Packet code                          |
+ *	+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ *	|                        Protocol number                        |
+ *	+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ *	|                  Timestamp (unix nanoseconds)                 |
+ *	|                                                               |
+ *	+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ *	|  Payload...
+ *	+-+-+-+-+-+-+-+-+-
+ *
+ *	The flags are not covered by the checksum, so that a reader
+ *	can mark the record as done in place.
+ *
+ *	The payload is a sequence of attributes, each one prefixed
+ *	by a byte saying which dictionary it belongs to, and then
+ *	encoded with the internal encoder.
+ */
+#define FR_SPOOL_MAGIC			0xfe
+#define FR_SPOOL_VERSION		1
+#define FR_SPOOL_HDR_LEN		32
+#define FR_SPOOL_FLAGS_OFFSET		8
+#define FR_SPOOL_MAX_LEN		(1 << 24)	//!< Largest payload we'll believe.
+
+#define FR_SPOOL_FLAG_DONE		0x01		//!< Record has been processed.
+
+#define FR_SPOOL_DICT_PROTOCOL		0		//!< Attribute is from the protocol dictionary.
+#define FR_SPOOL_DICT_INTERNAL		1		//!< Attribute is from the internal dictionary.
+
+/** Fixed fields of a spool record
+ *
+ */
+typedef struct {
+	uint32_t		code;		//!< Packet code.
+	fr_dict_t const		*dict;		//!< Protocol dictionary.
+	fr_unix_time_t		timestamp;	//!< When the packet was originally received.
+	uint8_t			flags;		//!< FR_SPOOL_FLAG_* values.
+} fr_spool_record_t;
+
+ssize_t	fr_spool_pairs_encode(uint8_t *out, size_t outlen, fr_cursor_t *cursor,
+			      bool (*filter)(VALUE_PAIR const *vp, void *uctx), void *uctx);
+
+int	fr_spool_record_header(uint8_t *out, size_t len, fr_spool_record_t const *record);
+
+ssize_t	fr_spool_record_encode(uint8_t *out, size_t outlen, fr_spool_record_t const *record,
+			       fr_cursor_t *cursor, bool (*filter)(VALUE_PAIR const *vp, void *uctx), void *uctx);
+
+ssize_t	fr_spool_record_length(uint8_t const *data, size_t data_len);
+
+bool	fr_spool_record_boundary(uint8_t const *data, size_t data_len);
+
+ssize_t	fr_spool_record_sync(uint8_t const *data, size_t data_len);
+
+ssize_t	fr_spool_record_decode(TALLOC_CTX *ctx, fr_cursor_t *cursor, fr_spool_record_t *record,
+			       uint8_t const *data, size_t data_len);
@@ -0,0 +1,298 @@
+#include <freeradius-devel/util/acutest.h>
+#include <freeradius-devel/util/conf.h>
+#include <freeradius-devel/util/dict_test.h>
+#include <freeradius-devel/util/net.h>
+#include <freeradius-devel/util/pair.h>
+#include <freeradius-devel/internal/spool.h>
+
+#define SPOOL_TEST_RECORDS	(3)
+#define SPOOL_TEST_LARGE	(200)		//!< Length of the User-Name in a large record.
+#define SPOOL_TEST_WINDOW	(128)		//!< Smaller than a large record.
+
+static TALLOC_CTX		*autofree;
+static fr_dict_t		*dict_internal;
+static fr_dict_t		*dict_radius;
+static fr_dict_attr_t const	*attr_tmp_string_0;
+static fr_dict_attr_t const	*attr_user_name;
+static fr_dict_attr_t const	*attr_acct_session_time;
+
+/** Load the internal and RADIUS dictionaries
+ *
+ */
+static void test_init(void)
+{
+	if (autofree) return;
+
+	autofree = talloc_autofree_context();
+	fr_dict_test_init(autofree, "spool_tests", &dict_internal, &dict_radius, "radius");
+
+	attr_tmp_string_0 = fr_dict_attr_by_name(dict_internal, "Tmp-String-0");
+	attr_user_name = fr_dict_attr_by_name(dict_radius, "User-Name");
+	attr_acct_session_time = fr_dict_attr_by_name(dict_radius, "Acct-Session-Time");
+	if (!attr_tmp_string_0 || !attr_user_name || !attr_acct_session_time) {
+		fprintf(stderr, "spool_tests: Missing attributes in the dictionaries\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+/** Build the attributes for record number i
+ *
+ * @param[in] i		Record number.
+ * @param[in] large	Pad the User-Name, so the record is larger
+ *			than the reader's buffer.
+ */
+static VALUE_PAIR *spool_test_pairs(int i, bool large)
+{
+	VALUE_PAIR	*head = NULL, *vp;
+	char		buffer[SPOOL_TEST_LARGE + 1];
+
+	if (large) {
+		memset(buffer, 'a', SPOOL_TEST_LARGE);
+		buffer[SPOOL_TEST_LARGE] = '\0';
+	} else {
+		snprintf(buffer, sizeof(buffer), "user%i", i);
+	}
+	vp = fr_pair_afrom_da(autofree, attr_user_name);
+	fr_pair_value_strdup(vp, buffer);
+	fr_pair_add(&head, vp);
+
+	vp = fr_pair_afrom_da(autofree, attr_acct_session_time);
+	vp->vp_uint32 = i * 60;
+	fr_pair_add(&head, vp);
+
+	vp = fr_pair_afrom_da(autofree, attr_tmp_string_0);
+	fr_pair_value_strdup(vp, "internal");
+	fr_pair_add(&head, vp);
+
+	return head;
+}
+
+/** Write records to a file, and read the file back into a buffer
+ *
+ * @param[out] buffer	Where to read the file to.
+ * @param[in] buffer_len	Length of the buffer.
+ * @param[out] offsets	Where each record starts.
+ * @param[in] large	Record which should be larger than the reader's buffer, or -1.
+ * @return the length of the file.
+ */
+static size_t spool_test_write(uint8_t *buffer, size_t buffer_len, size_t offsets[SPOOL_TEST_RECORDS], int large)
+{
+	FILE		*fp;
+	size_t		len = 0;
+	int		i;
+
+	fp = tmpfile();
+	TEST_ASSERT(fp != NULL);
+
+	for (i = 0; i < SPOOL_TEST_RECORDS; i++) {
+		fr_spool_record_t	record = {
+						.code = 4,
+						.dict = dict_radius,
+						.timestamp = fr_unix_time_from_sec(1600000000 + i)
+					};
+		VALUE_PAIR		*head = spool_test_pairs(i, (i == large));
+		fr_cursor_t		cursor;
+		ssize_t			slen;
+
+		fr_cursor_init(&cursor, &head);
+		slen = fr_spool_record_encode(buffer, buffer_len, &record, &cursor, NULL, NULL);
+		TEST_ASSERT(slen > 0);
+		TEST_CHECK(fwrite(buffer, slen, 1, fp) == 1);
+
+		offsets[i] = len;
+		len += slen;
+		fr_pair_list_free(&head);
+	}
+
+	TEST_ASSERT(len <= buffer_len);
+	rewind(fp);
+	TEST_CHECK(fread(buffer, len, 1, fp) == 1);
+	fclose(fp);
+
+	return len;
+}
+
+/** Read records back, the way the detail reader does
+ *
+ * Only window bytes are looked at for each record.  Records which
+ * are larger than that are skipped, using their length if another
+ * record starts where the record says it ends.
+ *
+ * @param[in] buffer	Records to read.
+ * @param[in] len	Length of the records.
+ * @param[in] window	How much the reader reads at a time.
+ * @param[out] found	Which records were decoded successfully.
+ * @return the number of times the reader had to resynchronise.
+ */
+static int spool_test_read(uint8_t const *buffer, size_t len, size_t window, bool found[SPOOL_TEST_RECORDS])
+{
+	uint8_t const	*p, *end;
+	int		i, skipped = 0;
+
+	memset(found, 0, sizeof(bool) * SPOOL_TEST_RECORDS);
+
+	p = buffer;
+	end = buffer + len;
+	while (p < end) {
+		fr_spool_record_t	record;
+		VALUE_PAIR		*head = NULL, *vp;
+		fr_cursor_t		cursor;
+		ssize_t			slen;
+		size_t			avail = end - p;
+
+		if (avail > window) avail = window;
+
+		slen = fr_spool_record_length(p, avail);
+		if (slen == 0) {
+			size_t claimed;
+
+			TEST_ASSERT(avail == window);
+
+			claimed = FR_SPOOL_HDR_LEN + fr_net_to_uint32(p + 4);
+			if ((claimed <= (size_t) (end - p)) &&
+			    fr_spool_record_boundary(p + claimed, (end - p) - claimed)) {
+				p += claimed;
+				continue;
+			}
+			slen = -1;
+		}
+
+		if (slen < 0) {
+			p += fr_spool_record_sync(p, avail);
+			skipped++;
+			continue;
+		}
+
+		fr_cursor_init(&cursor, &head);
+		TEST_CHECK(fr_spool_record_decode(autofree, &cursor, &record, p, slen) == slen);
+		TEST_MSG("%s", fr_strerror());
+		TEST_CHECK(record.dict == dict_radius);
+		TEST_CHECK(record.code == 4);
+
+		vp = fr_pair_find_by_da(head, attr_acct_session_time, TAG_ANY);
+		TEST_ASSERT(vp != NULL);
+		i = vp->vp_uint32 / 60;
+		TEST_ASSERT((i >= 0) && (i < SPOOL_TEST_RECORDS));
+		TEST_CHECK(!found[i]);
+		found[i] = true;
+
+		TEST_CHECK(record.timestamp == fr_unix_time_from_sec(1600000000 + i));
+
+		{
+			VALUE_PAIR *expected = spool_test_pairs(i, false);
+
+			TEST_CHECK(fr_pair_list_cmp(expected, head) == 0);
+			TEST_MSG("record %i attributes differ", i);
+			fr_pair_list_free(&expected);
+		}
+
+		fr_pair_list_free(&head);
+		p += slen;
+	}
+
+	return skipped;
+}
+
+/** Write records to a file, and read them back the way radspool does
+ *
+ * @param[in] corrupt	Record to damage after writing, or -1.
+ * @param[out] found	Which records were decoded successfully.
+ * @return the number of times the reader had to resynchronise.
+ */
+static int spool_test_roundtrip(int corrupt, bool found[SPOOL_TEST_RECORDS])
+{
+	uint8_t		buffer[4096];
+	size_t		offsets[SPOOL_TEST_RECORDS], len;
+
+	len = spool_test_write(buffer, sizeof(buffer), offsets, -1);
+
+	/*
+	 *	Flip a bit in the payload, so the checksum fails
+	 *	but the header still looks valid.
+	 */
+	if (corrupt >= 0) buffer[offsets[corrupt] + FR_SPOOL_HDR_LEN + 3] ^= 0x01;
+
+	return spool_test_read(buffer, len, sizeof(buffer), found);
+}
+
+static void spool_test_clean(void)
+{
+	bool	found[SPOOL_TEST_RECORDS];
+	int	i;
+
+	test_init();
+
+	TEST_CHECK(spool_test_roundtrip(-1, found) == 0);
+	for (i = 0; i < SPOOL_TEST_RECORDS; i++) {
+		TEST_CHECK(found[i]);
+		TEST_MSG("record %i missing", i);
+	}
+}
+
+static void spool_test_resync(void)
+{
+	bool	found[SPOOL_TEST_RECORDS];
+	int	i, corrupt;
+
+	test_init();
+
+	for (corrupt = 0; corrupt < SPOOL_TEST_RECORDS; corrupt++) {
+		TEST_CASE("Damaged record is skipped");
+		TEST_CHECK(spool_test_roundtrip(corrupt, found) == 1);
+		TEST_MSG("corrupted record %i", corrupt);
+
+		for (i = 0; i < SPOOL_TEST_RECORDS; i++) {
+			TEST_CHECK(found[i] == (i != corrupt));
+			TEST_MSG("corrupted record %i, record %i %s", corrupt, i, found[i] ? "decoded" : "missing");
+		}
+	}
+}
+
+static void spool_test_large(void)
+{
+	uint8_t		buffer[4096];
+	size_t		offsets[SPOOL_TEST_RECORDS], len;
+	bool		found[SPOOL_TEST_RECORDS];
+	uint32_t	lengths[] = { 5, (SPOOL_TEST_WINDOW * 2) + 1, FR_SPOOL_MAX_LEN }, payload;
+	size_t		i;
+	int		j;
+
+	test_init();
+
+	TEST_CASE("Large record is skipped using its length");
+	len = spool_test_write(buffer, sizeof(buffer), offsets, 0);
+	TEST_ASSERT((offsets[1] - offsets[0]) > SPOOL_TEST_WINDOW);
+	TEST_CHECK(spool_test_read(buffer, len, SPOOL_TEST_WINDOW, found) == 0);
+	TEST_CHECK(!found[0]);
+	for (j = 1; j < SPOOL_TEST_RECORDS; j++) {
+		TEST_CHECK(found[j]);
+		TEST_MSG("record %i missing", j);
+	}
+
+	/*
+	 *	The length can't be checked against the checksum,
+	 *	as the reader never has the whole record.  A bad
+	 *	length mustn't take the following records with it.
+	 */
+	for (i = 0; i < NUM_ELEMENTS(lengths); i++) {
+		TEST_CASE("Large record with a damaged length is skipped by resynchronising");
+		len = spool_test_write(buffer, sizeof(buffer), offsets, 0);
+		payload = offsets[1] - offsets[0] - FR_SPOOL_HDR_LEN;
+		fr_net_from_uint32(buffer + offsets[0] + 4,
+				   (lengths[i] > (FR_SPOOL_MAX_LEN - payload)) ? FR_SPOOL_MAX_LEN : payload + lengths[i]);
+
+		TEST_CHECK(spool_test_read(buffer, len, SPOOL_TEST_WINDOW, found) > 0);
+		TEST_CHECK(!found[0]);
+		for (j = 1; j < SPOOL_TEST_RECORDS; j++) {
+			TEST_CHECK(found[j]);
+			TEST_MSG("length increased by %u, record %i missing", lengths[i], j);
+		}
+	}
+}
+
+TEST_LIST = {
+	{ "spool_test_clean",		spool_test_clean	},
+	{ "spool_test_resync",		spool_test_resync	},
+	{ "spool_test_large",		spool_test_large	},
+	{ NULL }
+};
@@ -243,7 +243,7 @@ size_t fr_radius_attr_len(VALUE_PAIR const *vp)
 ssize_t fr_radius_ascend_secret(uint8_t *out, size_t outlen, uint8_t const *in, size_t inlen,
 				char const *secret, uint8_t const *vector)
 {
-	fr_md5_ctx_t	*md5_ctx;
+	fr_md5_state_t	md5_ctx;
 	int		i;
 	uint8_t		buff[RADIUS_AUTH_VECTOR_LENGTH];
 
@@ -258,11 +258,10 @@ ssize_t fr_radius_ascend_secret(uint8_t *out, size_t outlen, uint8_t const *in,
 		in = buff;
 	}
 
-	md5_ctx = fr_md5_ctx_alloc(true);
-	fr_md5_update(md5_ctx, vector, RADIUS_AUTH_VECTOR_LENGTH);
-	fr_md5_update(md5_ctx, (uint8_t const *) secret, talloc_array_length(secret) - 1);
-	fr_md5_final(out, md5_ctx);
-	fr_md5_ctx_free(&md5_ctx);
+	fr_md5_state_init(&md5_ctx);
+	fr_md5_state_update(&md5_ctx, vector, RADIUS_AUTH_VECTOR_LENGTH);
+	fr_md5_state_update(&md5_ctx, (uint8_t const *) secret, talloc_array_length(secret) - 1);
+	fr_md5_state_final(out, &md5_ctx);
 
 	for (i = 0; i < RADIUS_AUTH_VECTOR_LENGTH; i++ ) out[i] ^= in[i];
 
@@ -359,6 +358,7 @@ invalid:
 int fr_radius_sign(uint8_t *packet, uint8_t const *original,
 		   uint8_t const *secret, size_t secret_len)
 {
+	fr_md5_state_t	md5_ctx;
 	uint8_t		*msg, *end;
 	size_t		packet_len = (packet[2] << 8) | packet[3];
 
@@ -492,15 +492,10 @@ int fr_radius_sign(uint8_t *packet, uint8_t const *original,
 	/*
 	 *	Request / Response Authenticator = MD5(packet + secret)
 	 */
-	{
-		fr_md5_ctx_t	*md5_ctx;
-
-		md5_ctx = fr_md5_ctx_alloc(true);
-		fr_md5_update(md5_ctx, packet, packet_len);
-		fr_md5_update(md5_ctx, secret, secret_len);
-		fr_md5_final(packet + 4, md5_ctx);
-		fr_md5_ctx_free(&md5_ctx);
-	}
+	fr_md5_state_init(&md5_ctx);
+	fr_md5_state_update(&md5_ctx, packet, packet_len);
+	fr_md5_state_update(&md5_ctx, secret, secret_len);
+	fr_md5_state_final(packet + 4, &md5_ctx);
 
 	return 0;
 }
@@ -901,6 +896,7 @@ ssize_t fr_radius_encode(uint8_t *packet, size_t packet_len, uint8_t const *orig
 	uint8_t			*out_p, *out_end;
 
 	packet_ctx.secret = secret;
+	packet_ctx.secret_md5 = NULL;
 	packet_ctx.vector = packet + 4;
 	packet_ctx.rand_ctx.a = fr_rand();
 	packet_ctx.rand_ctx.b = fr_rand();
@@ -1047,20 +1043,20 @@ ssize_t fr_radius_encode(uint8_t *packet, size_t packet_len, uint8_t const *orig
 	return out_p - packet;
 }
 
-/** Decode a raw RADIUS packet into VPs.
- *
- */
-ssize_t	fr_radius_decode(TALLOC_CTX *ctx, uint8_t const *packet, size_t packet_len, uint8_t const *original,
-			 char const *secret, UNUSED size_t secret_len, VALUE_PAIR **vps)
+static ssize_t radius_decode(TALLOC_CTX *ctx, uint8_t const *packet, size_t packet_len, uint8_t const *original,
+			     char const *secret, fr_md5_state_t const *secret_md5, VALUE_PAIR **vps, bool borrow)
 {
 	ssize_t			slen;
 	fr_cursor_t		cursor;
 	uint8_t const		*attr, *end;
-	fr_radius_ctx_t		packet_ctx;
+	fr_radius_ctx_t		packet_ctx = {
+					.secret = secret,
+					.secret_md5 = secret_md5,
+					.vector = original ? original + 4 : packet + 4,
+					.borrow = borrow ? packet : NULL
+				};
 
 	packet_ctx.tmp_ctx = talloc_init_const("tmp");
-	packet_ctx.secret = secret;
-	packet_ctx.vector = original ? original + 4 : packet + 4;
 
 	fr_cursor_init(&cursor, vps);
 
@@ -1098,6 +1094,41 @@ ssize_t	fr_radius_decode(TALLOC_CTX *ctx, uint8_t const *packet, size_t packet_l
 	return packet_len;
 }
 
+/** Decode a raw RADIUS packet into VPs.
+ *
+ */
+ssize_t	fr_radius_decode(TALLOC_CTX *ctx, uint8_t const *packet, size_t packet_len, uint8_t const *original,
+			 char const *secret, UNUSED size_t secret_len, fr_md5_state_t const *secret_md5,
+			 VALUE_PAIR **vps)
+{
+	return radius_decode(ctx, packet, packet_len, original, secret, secret_md5, vps, false);
+}
+
+/** Decode a raw RADIUS packet into VPs, referencing values in the packet instead of copying them
+ *
+ * Longer octets values point into the packet, and are only copied if
+ * they're modified.  Each such VP holds a talloc reference to the
+ * packet, so it remains valid for as long as the VPs do.
+ *
+ * @param[in] ctx		to allocate VPs in.
+ * @param[in] packet		to decode.  Must be the start of a talloced buffer.
+ * @param[in] packet_len	length of the packet.
+ * @param[in] original		request, if packet is a reply.
+ * @param[in] secret		shared secret.
+ * @param[in] secret_len	length of the secret.
+ * @param[in] secret_md5	MD5 state with the secret already hashed in, or NULL.
+ * @param[out] vps		where to write the decoded VPs.
+ * @return
+ *	- The length of the packet on success.
+ *	- < 0 on error.
+ */
+ssize_t	fr_radius_decode_borrowed(TALLOC_CTX *ctx, uint8_t const *packet, size_t packet_len, uint8_t const *original,
+				  char const *secret, UNUSED size_t secret_len, fr_md5_state_t const *secret_md5,
+				  VALUE_PAIR **vps)
+{
+	return radius_decode(ctx, packet, packet_len, original, secret, secret_md5, vps, true);
+}
+
 int fr_radius_init(void)
 {
 	if (instance_count > 0) {
@@ -1107,10 +1138,13 @@ int fr_radius_init(void)
 
 	if (fr_dict_autoload(libfreeradius_radius_dict) < 0) return -1;
 	if (fr_dict_attr_autoload(libfreeradius_radius_dict_attr) < 0) {
+	fail:
 		fr_dict_autofree(libfreeradius_radius_dict);
 		return -1;
 	}
 
+	if (fr_radius_encode_hdr_init() < 0) goto fail;
+
 	instance_count++;
 
 	return 0;
@@ -1120,6 +1154,7 @@ void fr_radius_free(void)
 {
 	if (--instance_count > 0) return;
 
+	fr_radius_encode_hdr_free();
 	fr_dict_autofree(libfreeradius_radius_dict);
 }
 
@@ -30,6 +30,13 @@ RCSID("$Id$")
 #include <freeradius-devel/io/test_point.h>
 #include "attrs.h"
 
+/*
+ *	Octets values shorter than this are copied even when values
+ *	are being borrowed, as the reference which keeps the packet
+ *	alive costs as much as the copy.
+ */
+#define RADIUS_BORROW_MIN	(32)
+
 static void memcpy_bounded(void * restrict dst, const void * restrict src, size_t n, const void * restrict end)
 {
 	size_t len = n;
@@ -59,11 +66,11 @@ static void memcpy_bounded(void * restrict dst, const void * restrict src, size_
  * above.
  */
 ssize_t fr_radius_decode_tunnel_password(uint8_t *passwd, size_t *pwlen,
-					 char const *secret, uint8_t const *vector, bool tunnel_password_zeros)
+					 char const *secret, fr_md5_state_t const *secret_md5,
+					 uint8_t const *vector, bool tunnel_password_zeros)
 {
-	fr_md5_ctx_t	*md5_ctx, *md5_ctx_old;
+	fr_md5_state_t	md5_ctx, md5_ctx_old;
 	uint8_t		digest[RADIUS_AUTH_VECTOR_LENGTH];
-	int		secretlen;
 	size_t		i, n, encrypted_len, embedded_len;
 
 	encrypted_len = *pwlen;
@@ -97,21 +104,16 @@ ssize_t fr_radius_decode_tunnel_password(uint8_t *passwd, size_t *pwlen,
 	/*
 	 *	Use the secret to setup the decryption digest
 	 */
-	secretlen = talloc_array_length(secret) - 1;
-
-	md5_ctx = fr_md5_ctx_alloc(false);
-	md5_ctx_old = fr_md5_ctx_alloc(true);
-
-	fr_md5_update(md5_ctx, (uint8_t const *) secret, secretlen);
-	fr_md5_ctx_copy(md5_ctx_old, md5_ctx); /* save intermediate work */
+	fr_radius_secret_md5_init(&md5_ctx_old, secret_md5, secret);
+	md5_ctx = md5_ctx_old; /* save intermediate work */
 
 	/*
 	 *	Set up the initial key:
 	 *
 	 *	 b(1) = MD5(secret + vector + salt)
 	 */
-	fr_md5_update(md5_ctx, vector, RADIUS_AUTH_VECTOR_LENGTH);
-	fr_md5_update(md5_ctx, passwd, 2);
+	fr_md5_state_update(&md5_ctx, vector, RADIUS_AUTH_VECTOR_LENGTH);
+	fr_md5_state_update(&md5_ctx, passwd, 2);
 
 	embedded_len = 0;
 	for (n = 0; n < encrypted_len; n += AUTH_PASS_LEN) {
@@ -128,8 +130,8 @@ ssize_t fr_radius_decode_tunnel_password(uint8_t *passwd, size_t *pwlen,
 		if (n == 0) {
 			base = 1;
 
-			fr_md5_final(digest, md5_ctx);
-			fr_md5_ctx_copy(md5_ctx, md5_ctx_old);
+			fr_md5_state_final(digest, &md5_ctx);
+			md5_ctx = md5_ctx_old;
 
 			/*
 			 *	A quick check: decrypt the first octet
@@ -140,20 +142,18 @@ ssize_t fr_radius_decode_tunnel_password(uint8_t *passwd, size_t *pwlen,
 			if (embedded_len > encrypted_len) {
 				fr_strerror_printf("Tunnel Password is too long for the attribute "
 						   "(shared secret is probably incorrect!)");
-				fr_md5_ctx_free(&md5_ctx);
-				fr_md5_ctx_free(&md5_ctx_old);
 				return -1;
 			}
 
-			fr_md5_update(md5_ctx, passwd + 2, block_len);
+			fr_md5_state_update(&md5_ctx, passwd + 2, block_len);
 
 		} else {
 			base = 0;
 
-			fr_md5_final(digest, md5_ctx);
+			fr_md5_state_final(digest, &md5_ctx);
 
-			fr_md5_ctx_copy(md5_ctx, md5_ctx_old);
-			fr_md5_update(md5_ctx, passwd + n + 2, block_len);
+			md5_ctx = md5_ctx_old;
+			fr_md5_state_update(&md5_ctx, passwd + n + 2, block_len);
 		}
 
 		for (i = base; i < block_len; i++) {
@@ -161,9 +161,6 @@ ssize_t fr_radius_decode_tunnel_password(uint8_t *passwd, size_t *pwlen,
 		}
 	}
 
-	fr_md5_ctx_free(&md5_ctx);
-	fr_md5_ctx_free(&md5_ctx_old);
-
 	/*
 	 *	Check trailing bytes
 	 */
@@ -186,12 +183,13 @@ ssize_t fr_radius_decode_tunnel_password(uint8_t *passwd, size_t *pwlen,
 /** Decode password
  *
  */
-ssize_t fr_radius_decode_password(char *passwd, size_t pwlen, char const *secret, uint8_t const *vector)
+ssize_t fr_radius_decode_password(char *passwd, size_t pwlen, char const *secret,
+				  fr_md5_state_t const *secret_md5, uint8_t const *vector)
 {
-	fr_md5_ctx_t	*md5_ctx, *md5_ctx_old;
+	fr_md5_state_t	md5_ctx, md5_ctx_old;
 	uint8_t		digest[RADIUS_AUTH_VECTOR_LENGTH];
 	int		i;
-	size_t		n, secretlen;
+	size_t		n;
 
 	/*
 	 *	The RFC's say that the maximum is 128.
@@ -208,41 +206,33 @@ ssize_t fr_radius_decode_password(char *passwd, size_t pwlen, char const *secret
 	/*
 	 *	Use the secret to setup the decryption digest
 	 */
-	secretlen = talloc_array_length(secret) - 1;
-
-	md5_ctx = fr_md5_ctx_alloc(false);
-	md5_ctx_old = fr_md5_ctx_alloc(true);
-
-	fr_md5_update(md5_ctx, (uint8_t const *) secret, secretlen);
-	fr_md5_ctx_copy(md5_ctx_old, md5_ctx);	/* save intermediate work */
+	fr_radius_secret_md5_init(&md5_ctx_old, secret_md5, secret);
+	md5_ctx = md5_ctx_old;	/* save intermediate work */
 
 	/*
 	 *	The inverse of the code above.
 	 */
 	for (n = 0; n < pwlen; n += AUTH_PASS_LEN) {
 		if (n == 0) {
-			fr_md5_update(md5_ctx, vector, RADIUS_AUTH_VECTOR_LENGTH);
-			fr_md5_final(digest, md5_ctx);
+			fr_md5_state_update(&md5_ctx, vector, RADIUS_AUTH_VECTOR_LENGTH);
+			fr_md5_state_final(digest, &md5_ctx);
 
-			fr_md5_ctx_copy(md5_ctx, md5_ctx_old);
+			md5_ctx = md5_ctx_old;
 			if (pwlen > AUTH_PASS_LEN) {
-				fr_md5_update(md5_ctx, (uint8_t *) passwd, AUTH_PASS_LEN);
+				fr_md5_state_update(&md5_ctx, (uint8_t *) passwd, AUTH_PASS_LEN);
 			}
 		} else {
-			fr_md5_final(digest, md5_ctx);
+			fr_md5_state_final(digest, &md5_ctx);
 
-			fr_md5_ctx_copy(md5_ctx, md5_ctx_old);
+			md5_ctx = md5_ctx_old;
 			if (pwlen > (n + AUTH_PASS_LEN)) {
-				fr_md5_update(md5_ctx, (uint8_t *) passwd + n, AUTH_PASS_LEN);
+				fr_md5_state_update(&md5_ctx, (uint8_t *) passwd + n, AUTH_PASS_LEN);
 			}
 		}
 
 		for (i = 0; i < AUTH_PASS_LEN; i++) passwd[i + n] ^= digest[i];
 	}
 
-	fr_md5_ctx_free(&md5_ctx);
-	fr_md5_ctx_free(&md5_ctx_old);
-
  done:
 	passwd[pwlen] = '\0';
 	return strlen(passwd);
@@ -560,6 +550,35 @@ static ssize_t decode_vsa_internal(TALLOC_CTX *ctx, fr_cursor_t *cursor, fr_dict
 }
 
 
+/** Decode a value which was reassembled from fragments, and free the buffer
+ *
+ * If values are being borrowed from the packet, they're borrowed from
+ * the reassembled buffer instead, which then lives as long as they do.
+ */
+static ssize_t decode_reassembled(TALLOC_CTX *ctx, fr_cursor_t *cursor, fr_dict_t const *dict,
+				  fr_dict_attr_t const *parent, uint8_t *head, size_t len, void *decoder_ctx)
+{
+	fr_radius_ctx_t		*packet_ctx = decoder_ctx;
+	uint8_t const		*borrow = NULL;
+	ssize_t			rcode;
+
+	if (packet_ctx && packet_ctx->borrow) {
+		borrow = packet_ctx->borrow;
+		packet_ctx->borrow = head;
+	}
+
+	rcode = fr_radius_decode_pair_value(ctx, cursor, dict, parent, head, len, len, decoder_ctx);
+
+	if (borrow) {
+		packet_ctx->borrow = borrow;
+		talloc_unlink(ctx, head);	/* Frees it unless values reference it */
+	} else {
+		talloc_free(head);
+	}
+
+	return rcode;
+}
+
 /** Convert a fragmented extended attr to a VP
  *
  * Format is:
@@ -652,9 +671,7 @@ static ssize_t decode_extended(TALLOC_CTX *ctx, fr_cursor_t *cursor, fr_dict_t c
 
 	FR_PROTO_HEX_DUMP(head, fraglen, "long-extended fragments");
 
-	rcode = fr_radius_decode_pair_value(ctx, cursor, dict,
-					    parent, head, fraglen, fraglen, decoder_ctx);
-	talloc_free(head);
+	rcode = decode_reassembled(ctx, cursor, dict, parent, head, fraglen, decoder_ctx);
 	if (rcode < 0) return rcode;
 
 	return end - data;
@@ -822,9 +839,7 @@ static ssize_t decode_wimax(TALLOC_CTX *ctx, fr_cursor_t *cursor, fr_dict_t cons
 
 	FR_PROTO_HEX_DUMP(head, wimax_len, "Wimax fragments");
 
-	rcode = fr_radius_decode_pair_value(ctx, cursor, dict,
-					    da, head, wimax_len, wimax_len, decoder_ctx);
-	talloc_free(head);
+	rcode = decode_reassembled(ctx, cursor, dict, da, head, wimax_len, decoder_ctx);
 	if (rcode < 0) return rcode;
 
 	return end - data;
@@ -1101,7 +1116,7 @@ ssize_t fr_radius_decode_pair_value(TALLOC_CTX *ctx, fr_cursor_t *cursor, fr_dic
 		 */
 		case FLAG_ENCRYPT_USER_PASSWORD:
 			fr_radius_decode_password((char *)buffer, attr_len,
-						  packet_ctx->secret, packet_ctx->vector);
+						  packet_ctx->secret, packet_ctx->secret_md5, packet_ctx->vector);
 			buffer[253] = '\0';
 
 			/*
@@ -1135,7 +1150,8 @@ ssize_t fr_radius_decode_pair_value(TALLOC_CTX *ctx, fr_cursor_t *cursor, fr_dic
 		 */
 		case FLAG_ENCRYPT_TUNNEL_PASSWORD:
 			if (fr_radius_decode_tunnel_password(buffer, &data_len,
-							     packet_ctx->secret, packet_ctx->vector,
+							     packet_ctx->secret, packet_ctx->secret_md5,
+							     packet_ctx->vector,
 							     packet_ctx->tunnel_password_zeros) < 0) {
 				goto raw;
 			}
@@ -1449,6 +1465,20 @@ ssize_t fr_radius_decode_pair_value(TALLOC_CTX *ctx, fr_cursor_t *cursor, fr_dic
 		 *	doesn't.  Therefor it's malformed.
 		 */
 		if (parent->flags.length && (data_len != parent->flags.length)) goto raw;
+
+		/*
+		 *	Reference the value in the packet instead of
+		 *	copying it.
+		 */
+		if (packet_ctx && packet_ctx->borrow && (data_len >= RADIUS_BORROW_MIN) &&
+		    (p >= packet_ctx->borrow) &&
+		    ((p + data_len) <= (packet_ctx->borrow + talloc_array_length(packet_ctx->borrow)))) {
+			if (fr_pair_value_memdup_borrowed(vp, packet_ctx->borrow, p, data_len, true) < 0) {
+				fr_pair_list_free(&vp);
+				return -1;
+			}
+			break;
+		}
 		FALL_THROUGH;
 
 	case FR_TYPE_STRING:
@@ -1674,13 +1704,19 @@ static int decode_test_ctx(void **out, TALLOC_CTX *ctx)
 	return 0;
 }
 
-static ssize_t fr_radius_decode_proto(TALLOC_CTX *ctx, VALUE_PAIR **vps, uint8_t const *data, size_t data_len, void *proto_ctx)
+/** Decode a packet for the test points
+ *
+ * The packet is first copied into a talloced buffer, as proto_radius does.
+ */
+static ssize_t decode_proto(TALLOC_CTX *ctx, VALUE_PAIR **vps, uint8_t const *data, size_t data_len,
+			    fr_radius_ctx_t *test_ctx, bool borrow)
 {
-	size_t packet_len = data_len;
-	fr_radius_ctx_t	*test_ctx = talloc_get_type_abort(proto_ctx, fr_radius_ctx_t);
-	decode_fail_t reason;
-	fr_cursor_t cursor;
-	VALUE_PAIR *vp;
+	size_t		packet_len = data_len;
+	decode_fail_t	reason;
+	fr_cursor_t	cursor;
+	VALUE_PAIR	*vp;
+	uint8_t		*packet;
+	ssize_t		slen;
 
 	if (!fr_radius_ok(data, &packet_len, 200, false, &reason)) {
 		return -1;
@@ -1709,8 +1745,38 @@ static ssize_t fr_radius_decode_proto(TALLOC_CTX *ctx, VALUE_PAIR **vps, uint8_t
 	fr_cursor_append(&cursor, vp);
 	vp = fr_cursor_tail(&cursor);
 
-	return fr_radius_decode(ctx, data, packet_len, test_ctx->vector - 4, /* decode adds 4 to this */
-				test_ctx->secret, talloc_array_length(test_ctx->secret) - 1, &vp->next);
+	packet = talloc_memdup(ctx, data, packet_len);
+	if (!packet) {
+		fr_strerror_printf("Out of memory");
+		return -1;
+	}
+	talloc_set_type(packet, uint8_t);
+
+	if (borrow) {
+		slen = fr_radius_decode_borrowed(ctx, packet, packet_len, test_ctx->vector - 4, /* decode adds 4 to this */
+						 test_ctx->secret, talloc_array_length(test_ctx->secret) - 1, NULL,
+						 &vp->next);
+	} else {
+		slen = fr_radius_decode(ctx, packet, packet_len, test_ctx->vector - 4, /* decode adds 4 to this */
+					test_ctx->secret, talloc_array_length(test_ctx->secret) - 1, NULL, &vp->next);
+	}
+	talloc_unlink(ctx, packet);	/* Frees it unless values reference it */
+
+	return slen;
+}
+
+static ssize_t fr_radius_decode_proto(TALLOC_CTX *ctx, VALUE_PAIR **vps, uint8_t const *data, size_t data_len, void *proto_ctx)
+{
+	fr_radius_ctx_t	*test_ctx = talloc_get_type_abort(proto_ctx, fr_radius_ctx_t);
+
+	return decode_proto(ctx, vps, data, data_len, test_ctx, false);
+}
+
+static ssize_t fr_radius_decode_proto_borrowed(TALLOC_CTX *ctx, VALUE_PAIR **vps, uint8_t const *data, size_t data_len, void *proto_ctx)
+{
+	fr_radius_ctx_t	*test_ctx = talloc_get_type_abort(proto_ctx, fr_radius_ctx_t);
+
+	return decode_proto(ctx, vps, data, data_len, test_ctx, true);
 }
 
 /*
@@ -1727,3 +1793,9 @@ fr_test_point_proto_decode_t radius_tp_decode_proto = {
 	.test_ctx	= decode_test_ctx,
 	.func		= fr_radius_decode_proto
 };
+
+extern fr_test_point_proto_decode_t radius_tp_decode_proto_borrowed;
+fr_test_point_proto_decode_t radius_tp_decode_proto_borrowed = {
+	.test_ctx	= decode_test_ctx,
+	.func		= fr_radius_decode_proto_borrowed
+};
@@ -29,6 +29,7 @@ RCSID("$Id$")
 #include <freeradius-devel/util/md5.h>
 #include <freeradius-devel/util/struct.h>
 #include <freeradius-devel/util/net.h>
+#include <freeradius-devel/util/swiss.h>
 #include <freeradius-devel/io/test_point.h>
 #include "attrs.h"
 
@@ -46,6 +47,26 @@ static ssize_t encode_tlv_hdr(fr_dbuff_t *dbuff,
 
 static ssize_t encode_pair_dbuff(fr_dbuff_t *dbuff, fr_cursor_t *cursor, void *encoder_ctx);
 
+#define RADIUS_ENCODE_HDR_MAX	(12)	//!< Vendor-Specific, vendor, 4 byte type, 2 byte length.
+
+/** A precomputed wire header for an attribute
+ *
+ * Only attributes which can be encoded without looking at their
+ * parents have one.  i.e. RFC attributes and VSAs with simple values,
+ * which aren't tagged, encrypted, or split across multiple attributes.
+ */
+typedef struct {
+	fr_dict_attr_t const	*da;				//!< Attribute the header is for.
+	uint8_t			hdr[RADIUS_ENCODE_HDR_MAX];	//!< Header, with lengths set for an empty value.
+	uint8_t			hdr_len;			//!< Length of the header.
+	uint8_t			vsa_len_offset;			//!< Offset of the vendor length field.
+	uint8_t			vsa_len_size;			//!< Size of the vendor length field, or 0.
+} radius_encode_hdr_t;
+
+static TALLOC_CTX		*encode_hdr_ctx;
+static radius_encode_hdr_t	*encode_hdr_rfc;		//!< Indexed by attribute number.
+static fr_swiss_table_t		*encode_hdr_vsa;		//!< VSA headers, keyed by da.
+
 /** Encode a CHAP password
  *
  * @param[out] out		An output buffer of 17 bytes (id + digest).
@@ -58,30 +79,29 @@ void fr_radius_encode_chap_password(uint8_t out[static 1 + RADIUS_CHAP_CHALLENGE
 				    RADIUS_PACKET *packet, uint8_t id, char const *password, size_t password_len)
 {
 	VALUE_PAIR	*challenge;
-	fr_md5_ctx_t	*md5_ctx;
+	fr_md5_state_t	md5_ctx;
 
-	md5_ctx = fr_md5_ctx_alloc(true);
+	fr_md5_state_init(&md5_ctx);
 
 	/*
 	 *	First ingest the ID and the password.
 	 */
-	fr_md5_update(md5_ctx, (uint8_t const *)&id, 1);
-	fr_md5_update(md5_ctx, (uint8_t const *)password, password_len);
+	fr_md5_state_update(&md5_ctx, (uint8_t const *)&id, 1);
+	fr_md5_state_update(&md5_ctx, (uint8_t const *)password, password_len);
 
 	/*
 	 *	Use Chap-Challenge pair if present,
 	 *	Request Authenticator otherwise.
 	 */
-	challenge = fr_pair_find_by_da(packet->vps, attr_chap_challenge, TAG_ANY);
+	challenge = fr_pair_list_find_by_da(&packet->vps, attr_chap_challenge, TAG_ANY);
 	if (challenge) {
-		fr_md5_update(md5_ctx, challenge->vp_octets, challenge->vp_length);
+		fr_md5_state_update(&md5_ctx, challenge->vp_octets, challenge->vp_length);
 	} else {
-		fr_md5_update(md5_ctx, packet->vector, RADIUS_AUTH_VECTOR_LENGTH);
+		fr_md5_state_update(&md5_ctx, packet->vector, RADIUS_AUTH_VECTOR_LENGTH);
 	}
 
 	out[0] = id;
-	fr_md5_final(out + 1, md5_ctx);
-	fr_md5_ctx_free(&md5_ctx);
+	fr_md5_state_final(out + 1, &md5_ctx);
 }
 
 /** "encrypt" a password RADIUS style
@@ -89,9 +109,9 @@ void fr_radius_encode_chap_password(uint8_t out[static 1 + RADIUS_CHAP_CHALLENGE
  * Input and output buffers can be identical if in-place encryption is needed.
  */
 static ssize_t encode_password(uint8_t *out, ssize_t outlen, uint8_t const *input, size_t inlen,
-			       char const *secret, uint8_t const *vector)
+			       fr_radius_ctx_t const *packet_ctx)
 {
-	fr_md5_ctx_t	*md5_ctx, *md5_ctx_old;
+	fr_md5_state_t	md5_ctx, md5_ctx_old;
 	uint8_t		digest[RADIUS_AUTH_VECTOR_LENGTH];
 	uint8_t		passwd[RADIUS_MAX_PASS_LENGTH];
 	size_t		i, n;
@@ -113,30 +133,28 @@ static ssize_t encode_password(uint8_t *out, ssize_t outlen, uint8_t const *inpu
 		len &= ~0x0f;
 	}
 
-	md5_ctx = fr_md5_ctx_alloc(false);
-	md5_ctx_old = fr_md5_ctx_alloc(true);
-
-	fr_md5_update(md5_ctx, (uint8_t const *) secret, talloc_array_length(secret) - 1);
-	fr_md5_ctx_copy(md5_ctx_old, md5_ctx);
+	/*
+	 *	Start from the pre-hashed secret, and clone
+	 *	that state for each block.
+	 */
+	fr_radius_secret_md5_init(&md5_ctx_old, packet_ctx->secret_md5, packet_ctx->secret);
+	md5_ctx = md5_ctx_old;
 
 	/*
 	 *	Do first pass.
 	 */
-	fr_md5_update(md5_ctx, vector, AUTH_PASS_LEN);
+	fr_md5_state_update(&md5_ctx, packet_ctx->vector, AUTH_PASS_LEN);
 
 	for (n = 0; n < len; n += AUTH_PASS_LEN) {
 		if (n > 0) {
-			fr_md5_ctx_copy(md5_ctx, md5_ctx_old);
-			fr_md5_update(md5_ctx, passwd + n - AUTH_PASS_LEN, AUTH_PASS_LEN);
+			md5_ctx = md5_ctx_old;
+			fr_md5_state_update(&md5_ctx, passwd + n - AUTH_PASS_LEN, AUTH_PASS_LEN);
 		}
 
-		fr_md5_final(digest, md5_ctx);
+		fr_md5_state_final(digest, &md5_ctx);
 		for (i = 0; i < AUTH_PASS_LEN; i++) passwd[i + n] ^= digest[i];
 	}
 
-	fr_md5_ctx_free(&md5_ctx);
-	fr_md5_ctx_free(&md5_ctx_old);
-
 	/*
 	 *	Return how many bytes we would have needed
 	 */
@@ -151,7 +169,7 @@ static ssize_t encode_password(uint8_t *out, ssize_t outlen, uint8_t const *inpu
 static ssize_t encode_tunnel_password(uint8_t *out, size_t outlen,
 				      uint8_t const *in, size_t inlen, void *encoder_ctx)
 {
-	fr_md5_ctx_t	*md5_ctx, *md5_ctx_old;
+	fr_md5_state_t	md5_ctx, md5_ctx_old;
 	uint8_t		digest[RADIUS_AUTH_VECTOR_LENGTH];
 	uint8_t		tpasswd[RADIUS_MAX_STRING_LENGTH];
 	size_t		i, n;
@@ -224,23 +242,20 @@ static ssize_t encode_tunnel_password(uint8_t *out, size_t outlen,
 	tpasswd[1] = r & 0xff;
 	tpasswd[2] = inlen;	/* length of the password string */
 
-	md5_ctx = fr_md5_ctx_alloc(false);
-	md5_ctx_old = fr_md5_ctx_alloc(true);
+	fr_radius_secret_md5_init(&md5_ctx_old, packet_ctx->secret_md5, packet_ctx->secret);
+	md5_ctx = md5_ctx_old;
 
-	fr_md5_update(md5_ctx, (uint8_t const *) packet_ctx->secret, talloc_array_length(packet_ctx->secret) - 1);
-	fr_md5_ctx_copy(md5_ctx_old, md5_ctx);
-
-	fr_md5_update(md5_ctx, packet_ctx->vector, RADIUS_AUTH_VECTOR_LENGTH);
-	fr_md5_update(md5_ctx, &tpasswd[0], 2);
+	fr_md5_state_update(&md5_ctx, packet_ctx->vector, RADIUS_AUTH_VECTOR_LENGTH);
+	fr_md5_state_update(&md5_ctx, &tpasswd[0], 2);
 
 	for (n = 0; n < encrypted_len; n += AUTH_PASS_LEN) {
 		size_t block_len;
 
 		if (n > 0) {
-			fr_md5_ctx_copy(md5_ctx, md5_ctx_old);
-			fr_md5_update(md5_ctx, tpasswd + 2 + n - AUTH_PASS_LEN, AUTH_PASS_LEN);
+			md5_ctx = md5_ctx_old;
+			fr_md5_state_update(&md5_ctx, tpasswd + 2 + n - AUTH_PASS_LEN, AUTH_PASS_LEN);
 		}
-		fr_md5_final(digest, md5_ctx);
+		fr_md5_state_final(digest, &md5_ctx);
 
 		if ((2 + n + AUTH_PASS_LEN) < outlen) {
 			block_len = AUTH_PASS_LEN;
@@ -251,9 +266,6 @@ static ssize_t encode_tunnel_password(uint8_t *out, size_t outlen,
 		for (i = 0; i < block_len; i++) tpasswd[i + 2 + n] ^= digest[i];
 	}
 
-	fr_md5_ctx_free(&md5_ctx);
-	fr_md5_ctx_free(&md5_ctx_old);
-
 	memcpy(out, tpasswd, len);
 
 	return len;
@@ -609,8 +621,7 @@ static ssize_t encode_value(uint8_t *out, size_t outlen,
 		 *	Encode the password in place
 		 */
 		slen = encode_password(out_p, out_end - out_p,
-				       value_start, value_end - value_start,
-				       packet_ctx->secret, packet_ctx->vector);
+				       value_start, value_end - value_start, packet_ctx);
 		if (slen < 0) return slen;
 
 		out_p += slen;
@@ -1462,6 +1473,405 @@ static ssize_t encode_pair_dbuff(fr_dbuff_t *dbuff, fr_cursor_t *cursor, void *e
 	return fr_dbuff_set(dbuff, &work_dbuff);
 }
 
+static uint32_t encode_hdr_hash(void const *data)
+{
+	radius_encode_hdr_t const *hdr = data;
+
+	return fr_hash(&hdr->da, sizeof(hdr->da));
+}
+
+static int encode_hdr_cmp(void const *one, void const *two)
+{
+	radius_encode_hdr_t const *a = one, *b = two;
+
+	return (a->da > b->da) - (a->da < b->da);
+}
+
+/** Whether an attribute's value can be written directly after a precomputed header
+ *
+ */
+static bool encode_hdr_leaf_ok(fr_dict_attr_t const *da)
+{
+	if (da->flags.internal || da->flags.has_tag || da->flags.concat || da->flags.array ||
+	    da->flags.extra || da->flags.is_unknown || da->flags.is_raw ||
+	    (da->flags.subtype != FLAG_ENCRYPT_NONE)) return false;
+
+	switch (da->type) {
+	case FR_TYPE_OCTETS:
+	case FR_TYPE_STRING:
+	case FR_TYPE_IPV4_ADDR:
+	case FR_TYPE_IFID:
+	case FR_TYPE_ETHERNET:
+	case FR_TYPE_BOOL:
+	case FR_TYPE_UINT8:
+	case FR_TYPE_UINT16:
+	case FR_TYPE_UINT32:
+	case FR_TYPE_UINT64:
+	case FR_TYPE_INT8:
+	case FR_TYPE_INT16:
+	case FR_TYPE_INT32:
+	case FR_TYPE_INT64:
+	case FR_TYPE_FLOAT32:
+	case FR_TYPE_FLOAT64:
+	case FR_TYPE_DATE:
+	case FR_TYPE_TIME_DELTA:
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+/** Precompute the headers for the VSAs of one vendor
+ *
+ */
+static int encode_hdr_vendor(fr_dict_attr_t const *dv)
+{
+	fr_dict_attr_t const	*da;
+	radius_encode_hdr_t	*hdr;
+	uint8_t			*p;
+
+	/*
+	 *	WiMAX has a continuation byte, and can fragment
+	 *	its attributes.
+	 */
+	if (dv->attr == VENDORPEC_WIMAX) return 0;
+
+	switch (dv->flags.type_size) {
+	case 1:
+	case 2:
+	case 4:
+		break;
+
+	default:
+		return 0;
+	}
+
+	if (dv->flags.length > 2) return 0;
+
+	for (da = NULL; (da = fr_dict_attr_iterate_children(dv, &da)); ) {
+		if (!encode_hdr_leaf_ok(da)) continue;
+		if ((dv->flags.type_size < 4) && (da->attr >= (1U << (8 * dv->flags.type_size)))) continue;
+
+		MEM(hdr = talloc_zero(encode_hdr_ctx, radius_encode_hdr_t));
+		hdr->da = da;
+		hdr->hdr_len = 6 + dv->flags.type_size + dv->flags.length;
+
+		p = hdr->hdr;
+		*p++ = FR_VENDOR_SPECIFIC;
+		*p++ = hdr->hdr_len;
+		fr_net_from_uint32(p, dv->attr);
+		p += 4;
+
+		switch (dv->flags.type_size) {
+		case 4:
+			fr_net_from_uint32(p, da->attr);
+			break;
+
+		case 2:
+			fr_net_from_uint16(p, da->attr);
+			break;
+
+		default:
+			*p = da->attr;
+			break;
+		}
+		p += dv->flags.type_size;
+
+		if (dv->flags.length) {
+			hdr->vsa_len_offset = p - hdr->hdr;
+			hdr->vsa_len_size = dv->flags.length;
+			p[dv->flags.length - 1] = dv->flags.type_size + dv->flags.length;
+		}
+
+		if (fr_swiss_table_insert(encode_hdr_vsa, hdr) != 1) {
+			fr_strerror_printf("Failed inserting header for %s", da->name);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/** Precompute the wire headers for attributes in the RADIUS dictionary
+ *
+ * Called once the dictionary has been loaded.  Attributes which don't
+ * get a header here are encoded by walking the dictionary as before.
+ *
+ * @return
+ *	- 0 on success.
+ *	- -1 on failure.
+ */
+int fr_radius_encode_hdr_init(void)
+{
+	fr_dict_attr_t const	*da;
+
+	fr_radius_encode_hdr_free();
+
+	encode_hdr_ctx = talloc_init_const("radius_encode_hdr");
+	if (!encode_hdr_ctx) return -1;
+
+	MEM(encode_hdr_rfc = talloc_zero_array(encode_hdr_ctx, radius_encode_hdr_t, UINT8_MAX + 1));
+	MEM(encode_hdr_vsa = fr_swiss_table_create(encode_hdr_ctx, encode_hdr_hash, encode_hdr_cmp, NULL));
+
+	for (da = NULL; (da = fr_dict_attr_iterate_children(fr_dict_root(dict_radius), &da)); ) {
+		radius_encode_hdr_t *hdr;
+
+		/*
+		 *	Message-Authenticator is filled in when the
+		 *	packet is signed.
+		 */
+		if ((da->attr == 0) || (da->attr > UINT8_MAX) || (da == attr_message_authenticator)) continue;
+		if (!encode_hdr_leaf_ok(da)) continue;
+
+		hdr = &encode_hdr_rfc[da->attr];
+		hdr->da = da;
+		hdr->hdr[0] = da->attr;
+		hdr->hdr[1] = 2;
+		hdr->hdr_len = 2;
+	}
+
+	for (da = NULL; (da = fr_dict_attr_iterate_children(attr_vendor_specific, &da)); ) {
+		if (da->type != FR_TYPE_VENDOR) continue;
+
+		if (encode_hdr_vendor(da) < 0) {
+			fr_radius_encode_hdr_free();
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/** Free the precomputed wire headers
+ *
+ */
+void fr_radius_encode_hdr_free(void)
+{
+	TALLOC_FREE(encode_hdr_ctx);
+	encode_hdr_rfc = NULL;
+	encode_hdr_vsa = NULL;
+}
+
+static inline CC_HINT(always_inline) radius_encode_hdr_t const *encode_hdr_find(fr_dict_attr_t const *da)
+{
+	radius_encode_hdr_t const *hdr;
+
+	if (!encode_hdr_rfc) return NULL;
+
+	if (da->parent->flags.is_root) {
+		if (da->attr > UINT8_MAX) return NULL;
+
+		hdr = &encode_hdr_rfc[da->attr];
+		return (hdr->da == da) ? hdr : NULL;
+	}
+
+	if (da->parent->type != FR_TYPE_VENDOR) return NULL;
+
+	return fr_swiss_table_finddata(encode_hdr_vsa, &(radius_encode_hdr_t){ .da = da });
+}
+
+/** Encode an attribute using its precomputed header
+ *
+ * @return
+ *	- >0 the number of bytes written.
+ *	- 0 the attribute has to be encoded by encode_pair_dbuff() instead.
+ */
+static ssize_t encode_pair_hdr(fr_dbuff_t *dbuff, radius_encode_hdr_t const *hdr, VALUE_PAIR const *vp)
+{
+	uint8_t		*p = fr_dbuff_current(dbuff);
+	uint8_t		*value = p + hdr->hdr_len;
+	size_t		max = fr_dbuff_remaining(dbuff);
+	ssize_t		slen;
+
+	if (max > UINT8_MAX) max = UINT8_MAX;
+	if (max <= hdr->hdr_len) return 0;
+	max -= hdr->hdr_len;
+
+	switch (vp->vp_type) {
+	case FR_TYPE_OCTETS:
+	case FR_TYPE_STRING:
+		if ((vp->vp_length == 0) || (vp->vp_length > max)) return 0;
+
+		memcpy(value, vp->vp_ptr, vp->vp_length);
+		slen = vp->vp_length;
+		break;
+
+	default:
+	{
+		size_t need = 0;
+
+		slen = fr_value_box_to_network(&need, value, max, &vp->data);
+		if ((slen <= 0) || (need > 0)) return 0;
+	}
+		break;
+	}
+
+	memcpy(p, hdr->hdr, hdr->hdr_len);
+	p[1] += slen;
+	if (hdr->vsa_len_size) p[hdr->vsa_len_offset + hdr->vsa_len_size - 1] += slen;
+
+	FR_PROTO_HEX_DUMP(p, hdr->hdr_len + slen, "precomputed %s", vp->da->name);
+
+	return fr_dbuff_advance(dbuff, hdr->hdr_len + slen);
+}
+
+/** Encode and sign a reply in one pass
+ *
+ * Attributes with precomputed headers are written directly to the
+ * buffer.  Everything else goes through the normal encoder.  The
+ * location of Message-Authenticator is remembered as it's written, so
+ * its HMAC and the Response Authenticator are calculated straight
+ * after encoding, without looking through the packet again.
+ *
+ * The output is the same as #fr_radius_encode followed by #fr_radius_sign.
+ *
+ * @param[out] dbuff		to write the reply to.
+ * @param[in] original		request the reply is for.
+ * @param[in] secret		to sign the reply with.
+ * @param[in] secret_len	Length of the secret.
+ * @param[in] secret_md5	MD5 state with the secret already hashed in, or NULL.
+ *				Used for User-Password and Tunnel-Password encryption.
+ * @param[in] code		of the reply.
+ * @param[in] id		of the reply.
+ * @param[in] vps		to encode.
+ * @return
+ *	- >0 the length of the reply.
+ *	- <0 on error.
+ */
+ssize_t fr_radius_encode_reply(fr_dbuff_t *dbuff, uint8_t const *original,
+			       char const *secret, size_t secret_len, fr_md5_state_t const *secret_md5,
+			       int code, int id, VALUE_PAIR *vps)
+{
+	fr_dbuff_t			work_dbuff = FR_DBUFF_MAX_NO_ADVANCE(dbuff, UINT16_MAX);
+	uint8_t				*packet = fr_dbuff_current(&work_dbuff);
+	uint8_t				*msg = NULL;
+	bool				rescan = false;
+	size_t				packet_len;
+	ssize_t				slen;
+	fr_radius_ctx_t			packet_ctx;
+	fr_cursor_t			cursor;
+	fr_md5_state_t			md5_ctx;
+	VALUE_PAIR const		*vp;
+	radius_encode_hdr_t const	*hdr;
+
+	switch (code) {
+	case FR_CODE_ACCESS_ACCEPT:
+	case FR_CODE_ACCESS_REJECT:
+	case FR_CODE_ACCESS_CHALLENGE:
+	case FR_CODE_ACCOUNTING_RESPONSE:
+	case FR_CODE_COA_ACK:
+	case FR_CODE_COA_NAK:
+	case FR_CODE_DISCONNECT_ACK:
+	case FR_CODE_DISCONNECT_NAK:
+		break;
+
+	/*
+	 *	Leave any checks on Protocol-Error to fr_radius_sign().
+	 */
+	case FR_CODE_PROTOCOL_ERROR:
+		rescan = true;
+		break;
+
+	default:
+		fr_strerror_printf("Cannot encode %s as a reply",
+				   is_radius_code(code) ? fr_packet_codes[code] : "unknown packet code");
+		return -1;
+	}
+
+	packet_ctx.secret = secret;
+	packet_ctx.secret_md5 = secret_md5;
+	packet_ctx.vector = original + 4;
+	packet_ctx.rand_ctx.a = fr_rand();
+	packet_ctx.rand_ctx.b = fr_rand();
+
+	FR_DBUFF_BYTES_IN_RETURN(&work_dbuff, (uint8_t)code, (uint8_t)id, 0, RADIUS_HEADER_LENGTH);
+	FR_DBUFF_MEMCPY_IN_RETURN(&work_dbuff, original + 4, RADIUS_AUTH_VECTOR_LENGTH);
+
+	/*
+	 *	Original-Packet-Code, as with fr_radius_encode().
+	 */
+	if (code == FR_CODE_PROTOCOL_ERROR) FR_DBUFF_BYTES_IN_RETURN(&work_dbuff, 241, 7, 4, 0, 0, 0, original[0]);
+
+	fr_cursor_talloc_iter_init(&cursor, &vps, fr_proto_next_encodable, dict_radius, VALUE_PAIR);
+	while ((vp = fr_cursor_current(&cursor))) {
+		VP_VERIFY(vp);
+
+		if (vp->da->flags.internal) {
+#ifndef NDEBUG
+			/*
+			 *	Badly formatted attributes may hide a
+			 *	Message-Authenticator, so the packet
+			 *	has to be signed the slow way.
+			 */
+			if ((vp->da == attr_raw_attribute) && (vp->vp_length <= (RADIUS_MAX_STRING_LENGTH + 2))) {
+				FR_DBUFF_MEMCPY_IN_RETURN(&work_dbuff, vp->vp_octets, vp->vp_length);
+				rescan = true;
+			}
+#endif
+			fr_cursor_next(&cursor);
+			continue;
+		}
+
+		hdr = encode_hdr_find(vp->da);
+		if (hdr && (encode_pair_hdr(&work_dbuff, hdr, vp) > 0)) {
+			fr_cursor_next(&cursor);
+			continue;
+		}
+
+		if (!msg && (vp->da == attr_message_authenticator)) msg = fr_dbuff_current(&work_dbuff);
+
+		slen = encode_pair_dbuff(&work_dbuff, &cursor, &packet_ctx);
+		if (slen < 0) {
+			if (slen == PAIR_ENCODE_SKIPPED) continue;
+			return slen;
+		}
+	}
+
+	packet_len = fr_dbuff_used(&work_dbuff);
+	fr_net_from_uint16(packet + 2, packet_len);
+
+	FR_PROTO_HEX_DUMP(packet, packet_len, "%s encoded packet", __FUNCTION__);
+
+	if (rescan) {
+		if (fr_radius_sign(packet, original, (uint8_t const *)secret, secret_len) < 0) return -1;
+		return fr_dbuff_set(dbuff, &work_dbuff);
+	}
+
+	/*
+	 *	Message-Authenticator is calculated over the packet
+	 *	with the Request Authenticator, except for responses
+	 *	to accounting and CoA requests, which use zeros.
+	 */
+	if (msg) {
+		switch (code) {
+		case FR_CODE_ACCOUNTING_RESPONSE:
+		case FR_CODE_COA_ACK:
+		case FR_CODE_COA_NAK:
+		case FR_CODE_DISCONNECT_ACK:
+		case FR_CODE_DISCONNECT_NAK:
+			if (original[0] != FR_CODE_STATUS_SERVER) memset(packet + 4, 0, RADIUS_AUTH_VECTOR_LENGTH);
+			break;
+
+		default:
+			break;
+		}
+
+		fr_hmac_md5(msg + 2, packet, packet_len, (uint8_t const *)secret, secret_len);
+		memcpy(packet + 4, original + 4, RADIUS_AUTH_VECTOR_LENGTH);
+	}
+
+	/*
+	 *	Response Authenticator = MD5(packet + secret)
+	 */
+	fr_md5_state_init(&md5_ctx);
+	fr_md5_state_update(&md5_ctx, packet, packet_len);
+	fr_md5_state_update(&md5_ctx, (uint8_t const *)secret, secret_len);
+	fr_md5_state_final(packet + 4, &md5_ctx);
+
+	return fr_dbuff_set(dbuff, &work_dbuff);
+}
+
 static int _test_ctx_free(UNUSED fr_radius_ctx_t *ctx)
 {
 	fr_radius_free();
@@ -1492,10 +1902,54 @@ static int encode_test_ctx(void **out, TALLOC_CTX *ctx)
 	return 0;
 }
 
+/** Make up the request which a reply is for
+ *
+ * @return
+ *	- The request.
+ *	- NULL if the packet type isn't a reply.
+ */
+static uint8_t const *encode_test_original(uint8_t original[static RADIUS_HEADER_LENGTH],
+					   fr_radius_ctx_t const *test_ctx, int packet_type)
+{
+	switch (packet_type) {
+	case FR_CODE_ACCESS_ACCEPT:
+	case FR_CODE_ACCESS_REJECT:
+	case FR_CODE_ACCESS_CHALLENGE:
+	case FR_CODE_PROTOCOL_ERROR:
+		original[0] = FR_CODE_ACCESS_REQUEST;
+		break;
+
+	case FR_CODE_ACCOUNTING_RESPONSE:
+		original[0] = FR_CODE_ACCOUNTING_REQUEST;
+		break;
+
+	case FR_CODE_COA_ACK:
+	case FR_CODE_COA_NAK:
+		original[0] = FR_CODE_COA_REQUEST;
+		break;
+
+	case FR_CODE_DISCONNECT_ACK:
+	case FR_CODE_DISCONNECT_NAK:
+		original[0] = FR_CODE_DISCONNECT_REQUEST;
+		break;
+
+	default:
+		return NULL;
+	}
+
+	original[1] = 0;
+	fr_net_from_uint16(original + 2, RADIUS_HEADER_LENGTH);
+	memcpy(original + 4, test_ctx->vector, RADIUS_AUTH_VECTOR_LENGTH);
+
+	return original;
+}
+
 static ssize_t fr_radius_encode_proto(UNUSED TALLOC_CTX *ctx, VALUE_PAIR *vps, uint8_t *data, size_t data_len, void *proto_ctx)
 {
 	fr_radius_ctx_t	*test_ctx = talloc_get_type_abort(proto_ctx, fr_radius_ctx_t);
 	int packet_type = FR_CODE_ACCESS_REQUEST;
+	uint8_t buffer[RADIUS_HEADER_LENGTH];
+	uint8_t const *original;
 	VALUE_PAIR *vp;
 	ssize_t slen;
 
@@ -1514,17 +1968,41 @@ static ssize_t fr_radius_encode_proto(UNUSED TALLOC_CTX *ctx, VALUE_PAIR *vps, u
 	 *	@todo - pass in test_ctx to this function, so that we
 	 *	can leverage a consistent random number generator.
 	 */
-	slen = fr_radius_encode(data, data_len, NULL, test_ctx->secret, talloc_array_length(test_ctx->secret) - 1,
+	original = encode_test_original(buffer, test_ctx, packet_type);
+
+	slen = fr_radius_encode(data, data_len, original, test_ctx->secret, talloc_array_length(test_ctx->secret) - 1,
 				packet_type, 0, vps);
 	if (slen <= 0) return slen;
 
-	if (fr_radius_sign(data, NULL, (uint8_t const *) test_ctx->secret, talloc_array_length(test_ctx->secret) - 1) < 0) {
+	if (fr_radius_sign(data, original, (uint8_t const *) test_ctx->secret, talloc_array_length(test_ctx->secret) - 1) < 0) {
 		return -1;
 	}
 
 	return slen;
 }
 
+static ssize_t fr_radius_encode_reply_proto(UNUSED TALLOC_CTX *ctx, VALUE_PAIR *vps, uint8_t *data, size_t data_len, void *proto_ctx)
+{
+	fr_radius_ctx_t	*test_ctx = talloc_get_type_abort(proto_ctx, fr_radius_ctx_t);
+	int packet_type = FR_CODE_ACCESS_ACCEPT;
+	uint8_t buffer[RADIUS_HEADER_LENGTH];
+	uint8_t const *original;
+	VALUE_PAIR *vp;
+
+	vp = fr_pair_find_by_da(vps, attr_packet_type, TAG_ANY);
+	if (vp) packet_type = vp->vp_uint32;
+
+	original = encode_test_original(buffer, test_ctx, packet_type);
+	if (!original) {
+		fr_strerror_printf("Packet-Type must be a reply");
+		return -1;
+	}
+
+	return fr_radius_encode_reply(&FR_DBUFF_TMP(data, data_len), original,
+				      test_ctx->secret, talloc_array_length(test_ctx->secret) - 1, NULL,
+				      packet_type, 0, vps);
+}
+
 /*
  *	Test points
  */
@@ -1540,3 +2018,9 @@ fr_test_point_proto_encode_t radius_tp_encode_proto = {
 	.test_ctx	= encode_test_ctx,
 	.func		= fr_radius_encode_proto
 };
+
+extern fr_test_point_proto_encode_t radius_tp_encode_reply;
+fr_test_point_proto_encode_t radius_tp_encode_reply = {
+	.test_ctx	= encode_test_ctx,
+	.func		= fr_radius_encode_reply_proto
+};
@@ -873,7 +873,7 @@ void fr_packet_header_log(fr_log_t const *log, RADIUS_PACKET *packet, bool recei
 void fr_packet_log(fr_log_t const *log, RADIUS_PACKET *packet, bool received)
 {
 	fr_packet_header_log(log, packet, received);
-	if (fr_debug_lvl >= L_DBG_LVL_1) fr_pair_list_log(log, packet->vps);
+	if (fr_debug_lvl >= L_DBG_LVL_1) fr_pair_list_log(log, fr_pair_list_head(&packet->vps));
 #ifndef NDEBUG
 	if (fr_debug_lvl >= L_DBG_LVL_4) fr_radius_packet_log_hex(log, packet);
 #endif
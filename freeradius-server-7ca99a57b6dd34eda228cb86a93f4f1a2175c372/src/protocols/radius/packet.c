@@ -80,7 +80,7 @@ ssize_t fr_radius_packet_encode(RADIUS_PACKET *packet, RADIUS_PACKET const *orig
 	memcpy(data + 4, packet->vector, sizeof(packet->vector));
 
 	slen = fr_radius_encode(data, sizeof(data), original_data, secret, talloc_array_length(secret) - 1,
-				packet->code, packet->id, packet->vps);
+				packet->code, packet->id, fr_pair_list_head(&packet->vps));
 	if (slen < 0) return slen;
 
 	/*
@@ -228,7 +228,7 @@ int fr_radius_packet_decode(RADIUS_PACKET *packet, RADIUS_PACKET *original,
 		talloc_free_children(packet_ctx.tmp_ctx);
 	}
 
-	fr_cursor_init(&out, &packet->vps);
+	fr_pair_list_cursor_init(&out, &packet->vps);
 	fr_cursor_tail(&out);		/* Move insertion point to the end of the list */
 	fr_cursor_head(&cursor);
 	fr_cursor_merge(&out, &cursor);
@@ -449,11 +449,6 @@ RADIUS_PACKET *fr_radius_packet_recv(TALLOC_CTX *ctx, int fd, int flags, uint32_
 	 *	how to do this properly for all possible clients...
 	 */
 
-	/*
-	 *	Explicitely set the VP list to empty.
-	 */
-	packet->vps = NULL;
-
 	return packet;
 }
 
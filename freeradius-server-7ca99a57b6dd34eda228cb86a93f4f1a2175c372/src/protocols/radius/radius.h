@@ -25,9 +25,11 @@
  */
 #include <freeradius-devel/radius/defs.h>
 #include <freeradius-devel/util/cursor.h>
+#include <freeradius-devel/util/dbuff.h>
 #include <freeradius-devel/util/packet.h>
 #include <freeradius-devel/util/rand.h>
 #include <freeradius-devel/util/log.h>
+#include <freeradius-devel/util/md5.h>
 
 #define RADIUS_AUTH_VECTOR_OFFSET      		4
 #define RADIUS_HEADER_LENGTH			20
@@ -110,7 +112,12 @@ ssize_t		fr_radius_encode(uint8_t *packet, size_t packet_len, uint8_t const *ori
 				 char const *secret, UNUSED size_t secret_len, int code, int id, VALUE_PAIR *vps);
 
 ssize_t		fr_radius_decode(TALLOC_CTX *ctx, uint8_t const *packet, size_t packet_len, uint8_t const *original,
-				 char const *secret, UNUSED size_t secret_len, VALUE_PAIR **vps) CC_HINT(nonnull(1,2,5,7));
+				 char const *secret, UNUSED size_t secret_len, fr_md5_state_t const *secret_md5,
+				 VALUE_PAIR **vps) CC_HINT(nonnull(1,2,5,8));
+
+ssize_t		fr_radius_decode_borrowed(TALLOC_CTX *ctx, uint8_t const *packet, size_t packet_len, uint8_t const *original,
+					  char const *secret, UNUSED size_t secret_len, fr_md5_state_t const *secret_md5,
+					  VALUE_PAIR **vps) CC_HINT(nonnull(1,2,5,8));
 
 int		fr_radius_init(void);
 
@@ -144,11 +151,35 @@ typedef struct {
 	TALLOC_CTX		*tmp_ctx;		//!< for temporary things cleaned up during decoding
 	uint8_t const		*vector;		//!< vector for encryption / decryption of data
 	char const		*secret;		//!< shared secret.  MUST be talloc'd
+	fr_md5_state_t const	*secret_md5;		//!< MD5 state with the secret already hashed in,
+							///< or NULL to hash the secret for each attribute.
 	fr_fast_rand_t		rand_ctx;		//!< for tunnel passwords
 	int			salt_offset;		//!< for tunnel passwords
 	bool 			tunnel_password_zeros;
+	uint8_t const		*borrow;		//!< talloced buffer being decoded.  If set, octets
+							///< values reference it instead of being copied.
 } fr_radius_ctx_t;
 
+/** Start an MD5 digest which is prefixed with the shared secret
+ *
+ * Clones the pre-hashed secret if the caller has one, so the secret
+ * isn't re-hashed for every password attribute in every packet.
+ *
+ * @param[out] md5		state to initialise.
+ * @param[in] secret_md5	pre-hashed secret, may be NULL.
+ * @param[in] secret		shared secret.  MUST be talloc'd.
+ */
+static inline void fr_radius_secret_md5_init(fr_md5_state_t *md5, fr_md5_state_t const *secret_md5, char const *secret)
+{
+	if (secret_md5) {
+		*md5 = *secret_md5;
+		return;
+	}
+
+	fr_md5_state_init(md5);
+	fr_md5_state_update(md5, (uint8_t const *) secret, talloc_array_length(secret) - 1);
+}
+
 /*
  *	protocols/radius/encode.c
  */
@@ -158,15 +189,25 @@ void		fr_radius_encode_chap_password(uint8_t out[static 1 + RADIUS_CHAP_CHALLENG
 
 ssize_t		fr_radius_encode_pair(uint8_t *out, size_t outlen, fr_cursor_t *cursor, void *encoder_ctx);
 
+int		fr_radius_encode_hdr_init(void);
+
+void		fr_radius_encode_hdr_free(void);
+
+ssize_t		fr_radius_encode_reply(fr_dbuff_t *dbuff, uint8_t const *original,
+				       char const *secret, size_t secret_len, fr_md5_state_t const *secret_md5,
+				       int code, int id, VALUE_PAIR *vps) CC_HINT(nonnull(1,2,3));
+
 /*
  *	protocols/radius/decode.c
  */
 int		fr_radius_decode_tlv_ok(uint8_t const *data, size_t length, size_t dv_type, size_t dv_length);
 
-ssize_t		fr_radius_decode_password(char *encpw, size_t len, char const *secret, uint8_t const *vector);
+ssize_t		fr_radius_decode_password(char *encpw, size_t len, char const *secret,
+					  fr_md5_state_t const *secret_md5, uint8_t const *vector);
 
 
 ssize_t		fr_radius_decode_tunnel_password(uint8_t *encpw, size_t *len, char const *secret,
+						 fr_md5_state_t const *secret_md5,
 						 uint8_t const *vector, bool tunnel_password_zeros);
 
 ssize_t		fr_radius_decode_pair_value(TALLOC_CTX *ctx, fr_cursor_t *cursor, fr_dict_t const *dict,
@@ -59,6 +59,7 @@ test: \
 		test.auth	\
 		test.digest	\
 		test.radmin	\
+		test.detail	\
 		test.eap	\
 		| build.raddb
 
@@ -0,0 +1,97 @@
+#
+#	Replay detail files through the detail file reader.
+#
+#	Each test is named after a virtual server in config/detail.conf,
+#	which reads detail files from $(OUTPUT)/<name>.  The test writes
+#	a detail file there, and waits for the server to finish with it.
+#
+#	Every tenth entry is already marked "Done", and must be skipped.
+#	Every other entry must be logged exactly once, and marked "Done"
+#	in the file.  A hard link to the file is kept, so that it can be
+#	checked after the server deletes it.
+#
+
+#
+#	Test name
+#
+TEST  := test.detail
+FILES := $(subst $(DIR)/,,$(wildcard $(DIR)/*.txt))
+
+$(eval $(call TEST_BOOTSTRAP))
+
+#
+#  Generic rules to start / stop the radius service.
+#
+CLIENT := radiusd
+include src/tests/radiusd.mk
+$(eval $(call RADIUSD_SERVICE,detail,$(OUTPUT)))
+
+#
+#  inotify needs the directories to exist before the server starts.
+#  The "fallback" directory is created by its test.
+#
+$(OUTPUT)/radiusd.pid: | $(OUTPUT)/inotify $(OUTPUT)/poll
+
+$(OUTPUT)/inotify $(OUTPUT)/poll:
+	${Q}mkdir -p $@
+
+#
+#  How long we wait for the server to finish with a file.
+#
+DETAIL_TIMEOUT := 60
+
+$(OUTPUT)/%.txt: $(DIR)/%.txt | $(TEST).radiusd_kill $(TEST).radiusd_start
+	@echo "DETAIL-TEST $(notdir $@)"
+	${Q} [ -f $(dir $@)/radiusd.pid ] || exit 1
+	$(eval NAME     := $(patsubst %.txt,%,$(notdir $@)))
+	$(eval ENTRIES  := $(shell grep "^#.*ENTRIES:" $< | cut -f2 -d ':'))
+	$(eval WORK_DIR := $(OUTPUT)/$(NAME))
+	${Q}rm -f $(OUTPUT)/$(NAME).log $(OUTPUT)/$(NAME).detail
+	${Q}mkdir -p $(WORK_DIR)
+	${Q}awk -v n=$(ENTRIES) 'BEGIN { \
+		for (i = 1; i <= n; i++) { \
+			printf "Wed Jan  1 00:00:00 2020\n"; \
+			printf "\tAcct-Session-Id = \"%08d\"\n", i; \
+			printf "\tAcct-Status-Type = Start\n"; \
+			printf "\tUser-Name = \"user%d\"\n", i; \
+			printf "\tNAS-IP-Address = 127.0.0.1\n"; \
+			printf "\t%s = %d\n\n", (i % 10) ? "Timestamp" : "Donestamp", 1577836800 + i; \
+		} }' > $(WORK_DIR)/tmp-detail
+	${Q}awk -v n=$(ENTRIES) 'BEGIN { for (i = 1; i <= n; i++) if (i % 10) printf "%08d\n", i }' > $(OUTPUT)/$(NAME).expected
+	${Q}ln $(WORK_DIR)/tmp-detail $(OUTPUT)/$(NAME).detail
+	${Q}mv $(WORK_DIR)/tmp-detail $(WORK_DIR)/detail-1
+	${Q}i=0; while [ -e $(WORK_DIR)/detail-1 ] || [ -e $(WORK_DIR)/detail.work ]; do \
+		if [ $$i -ge $(DETAIL_TIMEOUT) ]; then \
+			echo "DETAIL FAILED $@"; \
+			echo "ERROR: $(WORK_DIR) still has a detail file after $(DETAIL_TIMEOUT)s"; \
+			echo "RADIUSD: $(RADIUSD_RUN)"; \
+			tail -n 40 $(OUTPUT)/radiusd.log; \
+			$(MAKE) --no-print-directory $(TEST).radiusd_kill; \
+			exit 1; \
+		fi; \
+		sleep 1; \
+		i=`expr $$i + 1`; \
+	done
+	${Q}if ! sort $(OUTPUT)/$(NAME).log 2>/dev/null | cmp -s - $(OUTPUT)/$(NAME).expected; then \
+		echo "DETAIL FAILED $@"; \
+		echo "ERROR: Entries weren't each processed exactly once"; \
+		echo "Processed more than once:"; \
+		sort $(OUTPUT)/$(NAME).log 2>/dev/null | uniq -d | head -n 10; \
+		echo "Missing, or processed when already done:"; \
+		sort -u $(OUTPUT)/$(NAME).log 2>/dev/null | diff - $(OUTPUT)/$(NAME).expected | head -n 10; \
+		$(MAKE) --no-print-directory $(TEST).radiusd_kill; \
+		exit 1; \
+	fi
+	${Q}if grep -q "^	Timestamp" $(OUTPUT)/$(NAME).detail || \
+	    [ `grep -c "^	Done" $(OUTPUT)/$(NAME).detail` -ne $(ENTRIES) ]; then \
+		echo "DETAIL FAILED $@"; \
+		echo "ERROR: Entries in $(OUTPUT)/$(NAME).detail weren't all marked as Done"; \
+		grep -c "^	Timestamp" $(OUTPUT)/$(NAME).detail; \
+		$(MAKE) --no-print-directory $(TEST).radiusd_kill; \
+		exit 1; \
+	fi
+	${Q}touch $@
+
+$(TEST):
+	${Q}$(MAKE) --no-print-directory $@.radiusd_stop
+	@touch $(BUILD_DIR)/tests/$@
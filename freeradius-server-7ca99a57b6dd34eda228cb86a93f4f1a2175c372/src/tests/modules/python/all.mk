@@ -5,5 +5,13 @@
 PYTHONPATH := $(top_builddir)/src/tests/modules/python/
 export PYTHONPATH
 
+#
+#  per_thread_interpreter needs Python 3.12 or later.  We assume
+#  the python3 in the PATH is the one the module was built against.
+#
+ifneq "$(shell python3 -c 'import sys; print(sys.version_info >= (3, 12))' 2>/dev/null)" "True"
+  FILES_SKIP += $(filter python/per_thread/%,$(FILES))
+endif
+
 #  MODULE.test is the main target for this module.
 python.test:
\ No newline at end of file
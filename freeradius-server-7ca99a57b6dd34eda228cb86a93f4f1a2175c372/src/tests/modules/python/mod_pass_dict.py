@@ -0,0 +1,15 @@
+import radiusd
+
+def authorize(p):
+    # Attributes which appear more than once are passed as a list
+    if p.get('Filter-Id') != ['one', 'two']:
+        return radiusd.RLM_MODULE_FAIL
+
+    # and attributes which appear once as a single value
+    if p.get('User-Name') != 'bob':
+        return radiusd.RLM_MODULE_FAIL
+
+    # A str is added with '=', and each str in a list with '+='
+    return (radiusd.RLM_MODULE_OK,
+            { 'Reply-Message': [ 'one', 'two' ], 'Filter-Id': p['User-Name'] },
+            { 'Tmp-String-0': 'from python' })
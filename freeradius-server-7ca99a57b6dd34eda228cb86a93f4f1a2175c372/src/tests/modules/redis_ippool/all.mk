@@ -0,0 +1,6 @@
+#
+#  Test the "redis_ippool" module
+#
+
+# Don't test redis_ippool if TEST_SERVER ENV is not set
+redis_ippool_require_test_server := 1
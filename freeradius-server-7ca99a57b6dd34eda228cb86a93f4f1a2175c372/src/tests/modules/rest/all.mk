@@ -0,0 +1,6 @@
+#
+#  Test the "rest" module
+#
+
+# Don't test rest if REST_TEST_SERVER ENV is not set
+rest_require_test_server := 1